@@ -45,9 +45,11 @@ namespace CloudVeil.Core.Windows
             try
             {
                 logger.Info("Starting update process " + filename + " " + args);
-                if (!ProcessCreation.CreateElevatedProcessInCurrentSession(filename, args))
+
+                int error = SessionBroker.Default.Launch(filename, args);
+                if (error != 0)
                 {
-                    logger.Error($"Failed to create elevated process with {System.Runtime.InteropServices.Marshal.GetLastWin32Error()}");
+                    logger.Error($"Failed to create elevated process with {error}");
                 }
             } catch(Exception ex)
             {
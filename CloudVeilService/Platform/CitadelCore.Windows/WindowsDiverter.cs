@@ -8,7 +8,10 @@
 using CloudVeilCore.Extensions;
 using CloudVeilCore.Net.Proxy;
 using CloudVeilCore.Windows.WinAPI;
+using Filter.Platform.Common;
+using Filter.Platform.Common.Types;
 using Filter.Platform.Common.Util;
+using FilterNativeWindows;
 using Sentry.Protocol;
 using Swan;
 using System;
@@ -164,6 +167,28 @@ namespace CloudVeilCore.Windows.Diversion
         }
         
 
+        /// <summary>
+        /// Passes on the ID of a process that an application rule matches, for one that started after the lists were
+        /// filled. Its later connections are then handled by the driver like those of processes that were running.
+        /// </summary>
+        private void addAttributedProcess(AttributedConnection owner)
+        {
+            switch (owner.Verdict)
+            {
+                case AppVerdict.Whitelisted:
+                    WinDivert.WinDivertAddWhitelistedPID(diversionHandle, (ulong)owner.ProcessId);
+                    break;
+
+                case AppVerdict.Blacklisted:
+                    WinDivert.WinDivertAddBlacklistedPID(diversionHandle, (ulong)owner.ProcessId);
+                    break;
+
+                case AppVerdict.Blocked:
+                    WinDivert.WinDivertAddBlockedPID(diversionHandle, (ulong)owner.ProcessId);
+                    break;
+            }
+        }
+
         private unsafe void RunDiversion()
         {
             var packet = new WinDivertBuffer();
@@ -185,6 +210,8 @@ namespace CloudVeilCore.Windows.Diversion
 
             Span<byte> payloadBufferPtr = null;
 
+            IHotPathMetrics metrics = HotPathMetrics.Default;
+
             while (isRunning)
             {
                 try
@@ -226,7 +253,9 @@ namespace CloudVeilCore.Windows.Diversion
 
                         recvLength = recvAsyncIoLen;
                     }
-                    
+
+                    long diversionStart = Stopwatch.GetTimestamp();
+
                     var localPort = (int)IPAddress.HostToNetworkOrder((short)addr.LocalPort);
                     var remotePort = (int)IPAddress.HostToNetworkOrder((short)addr.RemotePort);
 
@@ -252,9 +281,18 @@ namespace CloudVeilCore.Windows.Diversion
                     var port = (int)IPAddress.HostToNetworkOrder((short)remotePort);
 
                     GoproxyWrapper.GoProxy.Instance.SetDestPortForLocalPort(localPort, remotePort, ip.ToString());
+
+                    AttributedConnection owner = ConnectionIndex.Default.OnRedirect(localPort);
+                    if (owner.FirstConnection)
+                    {
+                        addAttributedProcess(owner);
+                    }
+
+                    metrics?.Record(HotPathMetric.DiversionEvent, Stopwatch.GetTimestamp() - diversionStart);
                 }
                 catch (Exception loopException)
                 {
+                    metrics?.Add(HotPathCounter.DiversionErrors, 1);
                     logger.Error(loopException);
                 }
             } 
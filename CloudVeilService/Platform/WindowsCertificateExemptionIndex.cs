@@ -0,0 +1,35 @@
+/*
+* Copyright © 2019 Cloudveil Technology Inc.
+* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+using FilterNativeWindows;
+using FilterProvider.Common.Platform;
+using System;
+
+namespace CloudVeilService.Platform
+{
+    public class WindowsCertificateExemptionIndex : ICertificateExemptionIndex
+    {
+        private CertificateExemptionIndex index = new CertificateExemptionIndex();
+
+        public int Count => index.Count;
+
+        public bool IsExempted(byte[] thumbprint, string host)
+        {
+            return index.IsExempted(thumbprint, host, DateTime.UtcNow);
+        }
+
+        public bool Set(byte[] thumbprint, string host, DateTime? expiresUtc)
+        {
+            return index.Set(thumbprint, host, expiresUtc ?? DateTime.MaxValue);
+        }
+
+        public void Dispose()
+        {
+            index.Dispose();
+        }
+    }
+}
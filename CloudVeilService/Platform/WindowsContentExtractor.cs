@@ -0,0 +1,20 @@
+/*
+* Copyright © 2019 Cloudveil Technology Inc.
+* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+using FilterNativeWindows;
+using FilterProvider.Common.Platform;
+
+namespace CloudVeilService.Platform
+{
+    public class WindowsContentExtractor : IContentExtractor
+    {
+        public string ExtractJsonStrings(byte[] data, int offset, int count, char separator)
+        {
+            return ContentExtraction.ExtractJsonStringValues(data, offset, count, separator);
+        }
+    }
+}
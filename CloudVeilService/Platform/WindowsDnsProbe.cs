@@ -0,0 +1,71 @@
+/*
+* Copyright © 2019 Cloudveil Technology Inc.
+* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+
+using FilterNativeWindows;
+using FilterProvider.Common.Platform;
+using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Net;
+
+namespace CloudVeilService.Platform
+{
+    public class WindowsDnsProbe : IDnsProbe
+    {
+        // Answers are kept for their TTL but no longer than the old fixed recheck interval.
+        private static readonly TimeSpan maxCacheTtl = TimeSpan.FromMinutes(5);
+
+        // Short enough that filtering comes back soon after the servers do.
+        private static readonly TimeSpan failureCacheTtl = TimeSpan.FromSeconds(30);
+
+        private DnsHealthProbe probe = new DnsHealthProbe(maxCacheTtl, failureCacheTtl);
+
+        public void SetServers(IEnumerable<IPAddress> servers)
+        {
+            if (servers == null)
+            {
+                throw new ArgumentNullException(nameof(servers));
+            }
+
+            probe.SetServers(servers.ToArray());
+        }
+
+        public DnsProbeResult Probe(string name, TimeSpan timeout)
+        {
+            return toResult(probe.Probe(name, false, timeout));
+        }
+
+        public DnsProbeResult Resolve(string name, TimeSpan timeout)
+        {
+            return toResult(probe.Resolve(name, false, timeout));
+        }
+
+        public void FlushCache()
+        {
+            probe.FlushCache();
+        }
+
+        public void Dispose()
+        {
+            probe.Dispose();
+        }
+
+        private static DnsProbeResult toResult(DnsProbeVerdict verdict)
+        {
+            return new DnsProbeResult()
+            {
+                IsUp = verdict.Up,
+                Server = verdict.Server,
+                FromCache = verdict.FromCache,
+                Elapsed = TimeSpan.FromMilliseconds(verdict.ElapsedMs),
+                Addresses = verdict.Addresses,
+                Ttl = TimeSpan.FromSeconds(verdict.TtlSeconds)
+            };
+        }
+    }
+}
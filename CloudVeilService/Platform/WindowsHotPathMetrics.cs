@@ -0,0 +1,59 @@
+﻿/*
+* Copyright © 2019 Cloudveil Technology Inc.
+* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+using Filter.Platform.Common;
+using Filter.Platform.Common.Types;
+using FilterNativeWindows;
+using System;
+
+using HotPathCounter = Filter.Platform.Common.Types.HotPathCounter;
+using HotPathMetric = Filter.Platform.Common.Types.HotPathMetric;
+
+namespace CloudVeilService.Platform
+{
+    public class WindowsHotPathMetrics : IHotPathMetrics
+    {
+        public void Record(HotPathMetric metric, long elapsedTicks)
+        {
+            NativeMetrics.Record((FilterNativeWindows.HotPathMetric)metric, elapsedTicks);
+        }
+
+        public void Add(HotPathCounter counter, long amount)
+        {
+            NativeMetrics.Add((FilterNativeWindows.HotPathCounter)counter, amount);
+        }
+
+        public HotPathMetricsSnapshot Snapshot()
+        {
+            NativeMetricsSnapshot native = NativeMetrics.Snapshot();
+
+            var latencies = new LatencySummary[native.Latencies.Length];
+            for (int i = 0; i < latencies.Length; i++)
+            {
+                LatencyHistogram histogram = native.Latencies[i];
+                latencies[i] = new LatencySummary()
+                {
+                    Count = histogram.Count,
+                    TotalNanoseconds = histogram.TotalNanoseconds,
+                    MaxNanoseconds = histogram.MaxNanoseconds,
+                    P50Nanoseconds = histogram.ValueAtPercentile(50),
+                    P90Nanoseconds = histogram.ValueAtPercentile(90),
+                    P99Nanoseconds = histogram.ValueAtPercentile(99),
+                    P999Nanoseconds = histogram.ValueAtPercentile(99.9)
+                };
+            }
+
+            return new HotPathMetricsSnapshot()
+            {
+                TakenAt = DateTime.Now,
+                Latencies = latencies,
+                Counters = native.Counters,
+                Threads = native.Threads
+            };
+        }
+    }
+}
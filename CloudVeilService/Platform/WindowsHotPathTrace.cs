@@ -0,0 +1,70 @@
+﻿/*
+* Copyright © 2019 Cloudveil Technology Inc.
+* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+using Filter.Platform.Common;
+using Filter.Platform.Common.Types;
+using FilterNativeWindows;
+using System;
+
+using TraceOverflow = Filter.Platform.Common.Types.TraceOverflow;
+using TraceRecord = Filter.Platform.Common.Types.TraceRecord;
+
+namespace CloudVeilService.Platform
+{
+    public class WindowsHotPathTrace : IHotPathTrace
+    {
+        // Reused between drains, which never overlap.
+        private FilterNativeWindows.TraceRecord[] nativeRecords = new FilterNativeWindows.TraceRecord[0];
+
+        public TraceOverflow Overflow
+        {
+            get { return (TraceOverflow)NativeTrace.Overflow; }
+            set { NativeTrace.Overflow = (FilterNativeWindows.TraceOverflow)value; }
+        }
+
+        public long Lost => NativeTrace.Lost;
+
+        public bool Write(TraceEventId id) => NativeTrace.Write((int)id);
+
+        public bool Write(TraceEventId id, long arg0) => NativeTrace.Write((int)id, arg0);
+
+        public bool Write(TraceEventId id, long arg0, long arg1) => NativeTrace.Write((int)id, arg0, arg1);
+
+        public bool Write(TraceEventId id, long arg0, long arg1, long arg2) => NativeTrace.Write((int)id, arg0, arg1, arg2);
+
+        public int Drain(TraceRecord[] records)
+        {
+            if (nativeRecords.Length != records.Length)
+            {
+                nativeRecords = new FilterNativeWindows.TraceRecord[records.Length];
+            }
+
+            int drained = NativeTrace.Drain(nativeRecords);
+
+            for (int i = 0; i < drained; i++)
+            {
+                FilterNativeWindows.TraceRecord record = nativeRecords[i];
+
+                records[i] = new TraceRecord()
+                {
+                    Timestamp = record.Timestamp,
+                    Thread = record.Thread,
+                    EventId = record.EventId,
+                    ArgCount = record.ArgCount,
+                    Arg0 = record.Arg0,
+                    Arg1 = record.Arg1,
+                    Arg2 = record.Arg2,
+                    Arg3 = record.Arg3
+                };
+            }
+
+            return drained;
+        }
+
+        public DateTime ToDateTime(long timestamp) => NativeTrace.ToDateTime(timestamp);
+    }
+}
@@ -0,0 +1,64 @@
+﻿/*
+* Copyright © 2019 Cloudveil Technology Inc.
+* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+using Filter.Platform.Common;
+using Filter.Platform.Common.Types;
+using FilterNativeWindows;
+using System;
+using System.Diagnostics;
+
+using MemoryTag = Filter.Platform.Common.Types.MemoryTag;
+using MemoryTagUsage = Filter.Platform.Common.Types.MemoryTagUsage;
+
+namespace CloudVeilService.Platform
+{
+    public class WindowsMemoryBudget : IMemoryBudget
+    {
+        public void SetLimits(MemoryTag tag, long softLimit, long hardLimit)
+        {
+            NativeMemory.SetLimits((FilterNativeWindows.MemoryTag)tag, softLimit, hardLimit);
+        }
+
+        public MemoryUsageSnapshot Snapshot()
+        {
+            FilterNativeWindows.MemoryTagUsage[] native = NativeMemory.Snapshot();
+
+            var tags = new MemoryTagUsage[native.Length];
+            for (int i = 0; i < tags.Length; i++)
+            {
+                tags[i] = new MemoryTagUsage()
+                {
+                    Tag = (MemoryTag)native[i].Tag,
+                    LiveBytes = native[i].LiveBytes,
+                    PeakBytes = native[i].PeakBytes,
+                    SoftLimit = native[i].SoftLimit,
+                    HardLimit = native[i].HardLimit,
+                    Refused = native[i].Refused,
+                    ForcedOverLimit = native[i].ForcedOverLimit,
+                    Compactions = native[i].Compactions
+                };
+            }
+
+            using (Process process = Process.GetCurrentProcess())
+            {
+                return new MemoryUsageSnapshot()
+                {
+                    TakenAt = DateTime.Now,
+                    Tags = tags,
+                    ManagedHeapBytes = GC.GetTotalMemory(false),
+                    WorkingSetBytes = process.WorkingSet64,
+                    PrivateBytes = process.PrivateMemorySize64
+                };
+            }
+        }
+
+        public int Relieve()
+        {
+            return NativeMemory.Relieve();
+        }
+    }
+}
@@ -0,0 +1,42 @@
+/*
+* Copyright © 2019 Cloudveil Technology Inc.
+* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+using FilterNativeWindows;
+using FilterProvider.Common.Platform;
+using System;
+
+namespace CloudVeilService.Platform
+{
+    public class WindowsPageTemplate : IPageTemplate
+    {
+        private PageTemplateRenderer renderer;
+
+        public void Compile(byte[] source, string[] slotNames)
+        {
+            PageTemplateRenderer compiled = new PageTemplateRenderer(source, slotNames);
+
+            renderer?.Dispose();
+            renderer = compiled;
+        }
+
+        public byte[] Render(object[] values)
+        {
+            if (renderer == null)
+            {
+                throw new InvalidOperationException("The template has not been compiled.");
+            }
+
+            return renderer.Render(values);
+        }
+
+        public void Dispose()
+        {
+            renderer?.Dispose();
+            renderer = null;
+        }
+    }
+}
@@ -0,0 +1,121 @@
+/*
+* Copyright © 2019 Cloudveil Technology Inc.
+* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+
+using Filter.Platform.Common.Util;
+using FilterNativeWindows;
+using FilterProvider.Common.Platform;
+using System;
+
+namespace CloudVeilService.Platform
+{
+    public class WindowsServiceScheduler : IServiceScheduler
+    {
+        private ServiceScheduler scheduler = new ServiceScheduler();
+
+        public int AddJob(Func<bool> job, TimeSpan period, TimeSpan slack, double jitter = 0, TimeSpan maxBackoff = default(TimeSpan))
+        {
+            if (job == null)
+            {
+                throw new ArgumentNullException(nameof(job));
+            }
+
+            // The native scheduler counts an exception as a failure but has nowhere to log it.
+            Func<bool> logged = () =>
+            {
+                try
+                {
+                    return job();
+                }
+                catch (Exception ex)
+                {
+                    LoggerUtil.GetAppWideLogger()?.Error(ex, "Scheduled job failed.");
+                    return false;
+                }
+            };
+
+            return scheduler.AddJob(logged, milliseconds(period), milliseconds(slack), jitter, milliseconds(maxBackoff));
+        }
+
+        public void Start(int job, TimeSpan delay)
+        {
+            scheduler.Start(job, milliseconds(delay));
+        }
+
+        public void Stop(int job)
+        {
+            scheduler.Stop(job);
+        }
+
+        public void SetPeriod(int job, TimeSpan period)
+        {
+            scheduler.SetPeriod(job, milliseconds(period));
+        }
+
+        public ISlidingWindowCounter NewCounter(TimeSpan window)
+        {
+            return new WindowsSlidingWindowCounter(window);
+        }
+
+        public SchedulerCounters GetCounters()
+        {
+            ServiceSchedulerCounters counters = scheduler.GetCounters();
+
+            return new SchedulerCounters()
+            {
+                Wakeups = counters.Wakeups,
+                IdleWakeups = counters.IdleWakeups,
+                Runs = counters.Runs,
+                Failures = counters.Failures,
+                Coalesced = counters.Coalesced,
+                Deferred = counters.Deferred
+            };
+        }
+
+        public void Dispose()
+        {
+            scheduler.Dispose();
+        }
+
+        private static int milliseconds(TimeSpan span)
+        {
+            if (span <= TimeSpan.Zero)
+            {
+                return 0;
+            }
+
+            return span.TotalMilliseconds >= int.MaxValue ? int.MaxValue : (int)span.TotalMilliseconds;
+        }
+
+        private class WindowsSlidingWindowCounter : ISlidingWindowCounter
+        {
+            private SlidingWindowCounter counter;
+
+            public WindowsSlidingWindowCounter(TimeSpan window)
+            {
+                counter = new SlidingWindowCounter(window);
+            }
+
+            public long Total => counter.Total;
+
+            public long Add(long amount = 1)
+            {
+                return counter.Add(amount);
+            }
+
+            public void Reset()
+            {
+                counter.Reset();
+            }
+
+            public void Dispose()
+            {
+                counter.Dispose();
+            }
+        }
+    }
+}
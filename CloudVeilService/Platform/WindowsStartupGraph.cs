@@ -0,0 +1,94 @@
+/*
+* Copyright © 2019 Cloudveil Technology Inc.
+* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+
+using Filter.Platform.Common.Types;
+using Filter.Platform.Common.Util;
+using FilterNativeWindows;
+using FilterProvider.Common.Platform;
+using System;
+using System.Diagnostics;
+
+using StartupPhaseState = Filter.Platform.Common.Types.StartupPhaseState;
+
+namespace CloudVeilService.Platform
+{
+    public class WindowsStartupGraph : IStartupGraph
+    {
+        private StartupGraph graph = new StartupGraph();
+
+        public void AddPhase(string name, Func<bool> run, params string[] dependsOn)
+        {
+            if (run == null)
+            {
+                throw new ArgumentNullException(nameof(run));
+            }
+
+            // The native graph counts an exception as a failure but has nowhere to log it.
+            Func<bool> logged = () =>
+            {
+                try
+                {
+                    return run();
+                }
+                catch (Exception ex)
+                {
+                    LoggerUtil.GetAppWideLogger()?.Error(ex, "Startup phase {0} failed.", name);
+                    return false;
+                }
+            };
+
+            graph.AddPhase(name, logged, dependsOn ?? new string[0]);
+        }
+
+        public StartupTrace Run()
+        {
+            DateTime startedAt = DateTime.Now;
+
+            try
+            {
+                StartupPhaseResult[] results = graph.Run();
+
+                var phases = new StartupPhaseTiming[results.Length];
+                for (int i = 0; i < phases.Length; i++)
+                {
+                    phases[i] = new StartupPhaseTiming()
+                    {
+                        Name = results[i].Name,
+                        DependsOn = results[i].DependsOn,
+                        State = (StartupPhaseState)results[i].State,
+                        StartMs = results[i].StartMs,
+                        EndMs = results[i].EndMs,
+                        CpuMs = results[i].CpuMs,
+                        WaitedOn = results[i].WaitedOn,
+                        Critical = results[i].Critical
+                    };
+                }
+
+                return new StartupTrace()
+                {
+                    StartedAt = startedAt,
+                    SinceProcessStartMs = sinceProcessStart(startedAt),
+                    TotalMs = graph.TotalMs,
+                    Phases = phases
+                };
+            }
+            finally
+            {
+                graph.Dispose();
+            }
+        }
+
+        private static double sinceProcessStart(DateTime startedAt)
+        {
+            using (Process process = Process.GetCurrentProcess())
+            {
+                return Math.Max(0, (startedAt - process.StartTime).TotalMilliseconds);
+            }
+        }
+    }
+}
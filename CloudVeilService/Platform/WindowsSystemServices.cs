@@ -134,7 +134,7 @@ namespace CloudVeilService.Platform
 
             BCCertificateMaker certMaker = new BCCertificateMaker();
 
-            AsymmetricCipherKeyPair pair = BCCertificateMaker.CreateKeyPair(2048);
+            AsymmetricCipherKeyPair pair = config.RootKeyPair ?? BCCertificateMaker.CreateKeyPair(2048);
 
             using (StreamWriter writer = new StreamWriter(new FileStream(keyPath, FileMode.Create, FileAccess.Write)))
             { 
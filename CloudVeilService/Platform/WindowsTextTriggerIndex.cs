@@ -0,0 +1,124 @@
+/*
+* Copyright © 2019 Cloudveil Technology Inc.
+* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+using FilterNativeWindows;
+using FilterProvider.Common.Platform;
+using System;
+using ScanOverBudget = FilterProvider.Common.Platform.ScanOverBudget;
+using TriggerScanOutcome = FilterProvider.Common.Platform.TriggerScanOutcome;
+using WarmStartStatus = FilterProvider.Common.Platform.WarmStartStatus;
+
+namespace CloudVeilService.Platform
+{
+    public class WindowsTextTriggerIndex : ITextTriggerIndex
+    {
+        private TextTriggerIndex index = new TextTriggerIndex();
+
+        public int ParallelThreshold
+        {
+            get { return index.ParallelThreshold; }
+            set { index.ParallelThreshold = value; }
+        }
+
+        public int ChunkSize
+        {
+            get { return index.ChunkSize; }
+            set { index.ChunkSize = value; }
+        }
+
+        public int VerdictCacheSize
+        {
+            get { return index.VerdictCacheSize; }
+            set { index.VerdictCacheSize = value; }
+        }
+
+        public bool AddTrigger(string trigger, short categoryId)
+        {
+            return index.AddTrigger(trigger, categoryId);
+        }
+
+        public int TriggerCount => index.TriggerCount;
+
+        public int RefusedTriggers => index.RefusedTriggers;
+
+        public bool HasCategory(short categoryId)
+        {
+            return index.HasCategory(categoryId);
+        }
+
+        public bool ContainsTrigger(byte[] data, int offset, int count, bool jsonStringsOnly, Func<short, bool> categoryAppliesCb, int maxPhraseWords, out short firstMatchCategory, out string matchedTrigger)
+        {
+            return index.ContainsTrigger(data, offset, count, jsonStringsOnly, categoryAppliesCb, maxPhraseWords, out firstMatchCategory, out matchedTrigger);
+        }
+
+        public TriggerScanOutcome ScanForTrigger(byte[] data, int offset, int count, bool jsonStringsOnly, bool document, Func<short, bool> categoryAppliesCb, int maxPhraseWords, out short firstMatchCategory, out string matchedTrigger)
+        {
+            return (TriggerScanOutcome)index.ScanForTrigger(data, offset, count, jsonStringsOnly, document, categoryAppliesCb, maxPhraseWords, out firstMatchCategory, out matchedTrigger);
+        }
+
+        public void SetScanLimits(TriggerScanLimits limits)
+        {
+            ScanLimits native = new ScanLimits();
+
+            if (limits != null && limits.Enabled)
+            {
+                native.Slots = limits.Slots > 0 ? limits.Slots : Math.Max(1, Environment.ProcessorCount - 1);
+                native.HeadSize = limits.HeadSize;
+                native.RequestBudgetMs = limits.RequestBudgetMs;
+                native.GlobalBudget = limits.ProcessorShare * Environment.ProcessorCount;
+                native.WindowMs = limits.WindowMs;
+                native.MaxWaitMs = limits.MaxWaitMs;
+                native.MaxQueued = limits.MaxQueued;
+                native.OverBudget = (FilterNativeWindows.ScanOverBudget)limits.OverBudget;
+                native.MaxDeferMs = limits.MaxDeferMs;
+            }
+
+            index.SetScanLimits(native);
+        }
+
+        public TriggerScanCounters GetScanCounters()
+        {
+            ScanSchedulerCounters counters = index.GetScanCounters();
+
+            return new TriggerScanCounters()
+            {
+                Queued = counters.Queued,
+                MaxQueued = counters.MaxQueued,
+                Running = counters.Running,
+                Bodies = counters.Bodies,
+                Parts = counters.Parts,
+                Matched = counters.Matched,
+                Truncated = counters.Truncated,
+                Refused = counters.Refused,
+                OverRequestBudget = counters.OverRequestBudget,
+                OverGlobalBudget = counters.OverGlobalBudget,
+                OverQueueLimit = counters.OverQueueLimit,
+                OverWaitLimit = counters.OverWaitLimit,
+                Deferred = counters.Deferred,
+                DeferExpired = counters.DeferExpired,
+                TotalWait = TimeSpan.FromTicks(counters.WaitNanoseconds / 100),
+                MaxWait = TimeSpan.FromTicks(counters.MaxWaitNanoseconds / 100),
+                ScanTime = TimeSpan.FromTicks(counters.ScanNanoseconds / 100)
+            };
+        }
+
+        public byte[] SaveSnapshot(byte[] policyHash, int maxVerdicts)
+        {
+            return index.SaveSnapshot(policyHash, maxVerdicts);
+        }
+
+        public WarmStartStatus LoadSnapshot(byte[] snapshot, byte[] policyHash)
+        {
+            return (WarmStartStatus)index.LoadSnapshot(snapshot, policyHash);
+        }
+
+        public void Dispose()
+        {
+            index.Dispose();
+        }
+    }
+}
@@ -74,7 +74,7 @@ namespace CloudVeilService
                             });
 
                             // When someone logs on, start up a GUI for them.
-                            s.WhenSessionChanged((fsp, hostCtl) => fsp.OnSessionChanged());
+                            s.WhenSessionChanged((fsp, hostCtl, args) => fsp.OnSessionChanged((int)args.ReasonCode, args.SessionId));
                         });
 
                         x.EnableShutdown();
@@ -15,6 +15,7 @@ using System;
 using System.Collections.Generic;
 using System.Diagnostics;
 using System.IO;
+using System.Linq;
 using System.Reflection;
 using System.Threading;
 using System.Threading.Tasks;
@@ -33,6 +34,8 @@ using System.Security.Principal;
 using FilterProvider.Common.Util;
 using static Filter.Platform.Common.Util.ConnectivityCheck;
 
+using HotPathMetric = Filter.Platform.Common.Types.HotPathMetric;
+
 namespace CloudVeilService.Services
 {
     public class FilterServiceProvider
@@ -109,8 +112,11 @@ namespace CloudVeilService.Services
             return provider.Shutdown();
         }
 
-        public void OnSessionChanged()
+        public void OnSessionChanged(int reason, int sessionId)
         {
+            // Keeps elevated launches into the user's session from having to look it up each time.
+            SessionBroker.Default.OnSessionChange(reason, sessionId);
+
             provider.OnSessionChanged();
         }
 
@@ -159,77 +165,22 @@ namespace CloudVeilService.Services
             PlatformTypes.Register<IPlatformTrust>((arr) => new TrustManager());
             PlatformTypes.Register<ISystemServices>((arr) => new WindowsSystemServices(this));
             PlatformTypes.Register<IVersionProvider>((arr) => new VersionProvider());
+            PlatformTypes.Register<IContentExtractor>((arr) => new WindowsContentExtractor());
+            PlatformTypes.Register<ITextTriggerIndex>((arr) => new WindowsTextTriggerIndex());
+            PlatformTypes.Register<IHotPathMetrics>((arr) => new WindowsHotPathMetrics());
+            PlatformTypes.Register<IHotPathTrace>((arr) => new WindowsHotPathTrace());
+            PlatformTypes.Register<IMemoryBudget>((arr) => new WindowsMemoryBudget());
+            PlatformTypes.Register<ICertificateExemptionIndex>((arr) => new WindowsCertificateExemptionIndex());
+            PlatformTypes.Register<IPageTemplate>((arr) => new WindowsPageTemplate());
+            PlatformTypes.Register<IServiceScheduler>((arr) => new WindowsServiceScheduler());
+            PlatformTypes.Register<IStartupGraph>((arr) => new WindowsStartupGraph());
+            PlatformTypes.Register<IDnsProbe>((arr) => new WindowsDnsProbe());
 
             CloudVeil.Core.Windows.Platform.Init();
 
             provider = new CommonFilterServiceProvider(OnExtension);
         }
 
-        const string SystemAccountIdentifier = "S-1-5-18";
-        const string EveryoneIdentifier = "S-1-1-0";
-
-        private void SetDirectoryAsSystemOnly(string name)
-        {
-            SecurityIdentifier si = new SecurityIdentifier(SystemAccountIdentifier);
-            IdentityReference userId = si.Translate(typeof(NTAccount));
-
-            DirectorySecurity security = Directory.GetAccessControl(name);
-            FileSystemAccessRule rule = new FileSystemAccessRule(userId, FileSystemRights.FullControl, InheritanceFlags.ObjectInherit, PropagationFlags.InheritOnly, AccessControlType.Allow);
-
-            security.SetAccessRule(rule);
-            security.SetAccessRuleProtection(true, false);
-
-            Directory.SetAccessControl(name, security);
-        }
-
-        private void SetFileAsSystemOnly(string name)
-        {
-            SecurityIdentifier si = new SecurityIdentifier(SystemAccountIdentifier);
-            IdentityReference userId = si.Translate(typeof(NTAccount));
-
-            FileSecurity security = File.GetAccessControl(name);
-            FileSystemAccessRule rule = new FileSystemAccessRule(userId, FileSystemRights.FullControl, InheritanceFlags.ObjectInherit, PropagationFlags.InheritOnly, AccessControlType.Allow);
-
-            security.SetAccessRule(rule);
-            security.SetAccessRuleProtection(true, false);
-            File.SetAccessControl(name, security);
-        }
-
-        private void SetServicePermissions(string name)
-        {
-            SecurityIdentifier si = new SecurityIdentifier(SystemAccountIdentifier);
-            SecurityIdentifier everyone = new SecurityIdentifier(EveryoneIdentifier);
-
-            RawSecurityDescriptor securityDescriptor = null;
-            if(!Security.GetServiceSecurity(name, out securityDescriptor))
-            {
-                logger.Warn($"Unable to get proper service permissions for {name} because of Win32 error {Marshal.GetLastWin32Error()}");
-            }
-            else
-            {
-                while(securityDescriptor.DiscretionaryAcl.Count > 0)
-                {
-                    securityDescriptor.DiscretionaryAcl.RemoveAce(0);
-                }
-
-                ServiceAccessFlags systemFlags = ServiceAccessFlags.WriteOwner | ServiceAccessFlags.WriteDac | ServiceAccessFlags.ReadControl |
-                    ServiceAccessFlags.Delete | ServiceAccessFlags.UserDefinedControl | ServiceAccessFlags.Interrogate | ServiceAccessFlags.PauseContinue |
-                    ServiceAccessFlags.Stop | ServiceAccessFlags.Start | ServiceAccessFlags.EnumerateDependents | ServiceAccessFlags.QueryStatus |
-                    ServiceAccessFlags.QueryConfig;
-
-                ServiceAccessFlags everyoneFlags = ServiceAccessFlags.QueryConfig | ServiceAccessFlags.QueryStatus | ServiceAccessFlags.EnumerateDependents |
-                    ServiceAccessFlags.Start | ServiceAccessFlags.Stop | ServiceAccessFlags.PauseContinue | ServiceAccessFlags.Interrogate | ServiceAccessFlags.UserDefinedControl;
-
-                securityDescriptor.DiscretionaryAcl.InsertAce(0, new CommonAce(AceFlags.None, AceQualifier.AccessAllowed, (int)systemFlags, si, false, null));
-                securityDescriptor.DiscretionaryAcl.InsertAce(1, new CommonAce(AceFlags.None, AceQualifier.AccessAllowed, (int)everyoneFlags, everyone, false, null));
-
-                if(!Security.SetServiceSecurity(name, securityDescriptor))
-                {
-                    logger.Warn($"Unable to set proper service permissions for {name} because of Win32 error {Marshal.GetLastWin32Error()}");
-                }
-            }
-        }
-
         WindowsDiverter diverter = new WindowsDiverter();
         private void OnExtension(CommonFilterServiceProvider provider)
         {
@@ -237,15 +188,28 @@ namespace CloudVeilService.Services
 
             IPathProvider paths = PlatformTypes.New<IPathProvider>();
 
-            Task.Run(async () =>
+            ConnectivityCheck.Accessible accessible = ConnectivityCheck.Accessible.Yes;
+
+            // The saved configuration loads alongside these phases, so this has to be hooked before any of them run.
+            this.provider.PolicyConfiguration.OnConfigurationLoaded += (sender, e) =>
             {
-                ConnectivityCheck.Accessible accessible = ConnectivityCheck.Accessible.Yes;
+                FillApplicationLists();
+            };
+
+            provider.Startup.AddPhase(StartupPhases.Conflicts, () =>
+            {
+                long conflictScanStart = Stopwatch.GetTimestamp();
+                List<ConflictReason> conflicts = ConflictDetection.SearchConflictReason();
+                HotPathMetrics.Default?.Record(HotPathMetric.ConflictScan, Stopwatch.GetTimestamp() - conflictScanStart);
+
+                server.Send<List<ConflictReason>>(IpcCall.ConflictsDetected, conflicts);
+                return true;
+            });
 
+            provider.Startup.AddPhase(StartupPhases.Connectivity, () =>
+            {
                 try
                 {
-                    List<ConflictReason> conflicts = ConflictDetection.SearchConflictReason();
-                    server.Send<List<ConflictReason>>(IpcCall.ConflictsDetected, conflicts);
-
                     IFilterAgent agent = PlatformTypes.New<IFilterAgent>();
 
                     accessible = agent.CheckConnectivity();
@@ -255,6 +219,11 @@ namespace CloudVeilService.Services
                     logger.Error(ex, "Failed to check connectivity.");
                 }
 
+                return true;
+            }, StartupPhases.Firewall);
+
+            provider.Startup.AddPhase(StartupPhases.Diverter, () =>
+            {
                 try
                 {
                     diverter.UpdatePorts(AppSettings.Default.HttpsPort);
@@ -263,11 +232,6 @@ namespace CloudVeilService.Services
                         diverter.UpdatePorts(AppSettings.Default.HttpsPort);
                     };
 
-                    this.provider.PolicyConfiguration.OnConfigurationLoaded += (sender, e) =>
-                    {
-                        FillApplicationLists();
-                    };
-                    
                     WebServiceUtil.Default.AuthTokenRejected += () =>
                     {
                         diverter.Stop();
@@ -281,15 +245,16 @@ namespace CloudVeilService.Services
                             StartDiverter(accessible, server);
                         }
                     };
+
+                    return true;
                 }
                 catch(Exception ex)
                 {
                     logger.Error($"Error occurred while starting the diverter.");
                     LoggerUtil.RecursivelyLogException(logger, ex);
+                    return false;
                 }
-                
-            });
-
+            }, StartupPhases.Connectivity);
         }
 
         private void StartDiverter(ConnectivityCheck.Accessible accessible, IPCServer server)
@@ -320,6 +285,17 @@ namespace CloudVeilService.Services
                 return;
             }
 
+            var config = provider.PolicyConfiguration.Configuration;
+
+            // Processes that start later are attributed by their connections. Rules match process names, so
+            // the system32 folder is left to the driver's own whitelist.
+            ConnectionIndex.Default.SetPolicy(
+                config.WhitelistedApplications.ToArray(),
+                config.BlacklistedApplications.ToArray(),
+                config.BlockedApplications.Concat(config.CustomBlockedApps).ToArray());
+
+            logger.Info("Connection attribution: {0}", ConnectionIndex.Default.GetCounters());
+
             diverter.CleanApplist();
             var allProcesess = Process.GetProcesses();
             foreach(var app in provider.PolicyConfiguration.Configuration.BlacklistedApplications)
@@ -0,0 +1,241 @@
+/*
+* Copyright © 2019 Cloudveil Technology Inc.
+* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+using CloudVeil.IPC.Messages;
+using System;
+using System.Collections.Generic;
+using System.IO;
+
+namespace DiagnosticsCollector.Capture
+{
+    /// <summary>
+    /// Layout of a capture segment file:
+    ///
+    ///   segment header   SegmentMagic, FormatVersion
+    ///   blocks           BlockMagic, compressed length, raw length, record count, then the LZ4 compressed block
+    ///   footer           BlockMagic-style header with FooterMagic, then the LZ4 compressed dictionary and index
+    ///   trailer          offset of the footer, TrailerMagic
+    ///
+    /// A raw block is the header lines it adds to the segment's dictionary followed by its records. A record stores
+    /// each header block as dictionary ids, one per line, so a header line that repeats across requests is only
+    /// stored once per segment.
+    ///
+    /// The footer and trailer are only written when a segment is closed cleanly. Readers rebuild the index of a
+    /// segment without them by walking its blocks up to the first incomplete one.
+    /// </summary>
+    internal static class CaptureFormat
+    {
+        public const string SegmentExtension = ".cvcap";
+
+        public const uint SegmentMagic = 0x50414356; // "VCAP"
+        public const uint BlockMagic = 0x4B4C4256;   // "VBLK"
+        public const uint FooterMagic = 0x54465456;  // "VTFT"
+        public const uint TrailerMagic = 0x444E4556; // "VEND"
+
+        public const int FormatVersion = 1;
+
+        public const int SegmentHeaderSize = 8;
+        public const int BlockHeaderSize = 16;
+        public const int TrailerSize = 12;
+
+        public static string SegmentFileName(int number)
+        {
+            return $"segment-{number:D6}{SegmentExtension}";
+        }
+
+        public static void WriteRecord(BinaryWriter writer, DiagnosticsInfoV1 info, HeaderDictionary dictionary, out int hostId)
+        {
+            hostId = info.Host == null ? -1 : dictionary.Add(info.Host);
+
+            writer.Write((byte)info.DiagnosticsType);
+            writer.Write(info.StatusCode);
+            writer.Write(info.DateStarted.ToBinary());
+            writer.Write(info.DateEnded.ToBinary());
+            writer.Write(hostId);
+
+            writeString(writer, info.ClientRequestUri);
+            writeString(writer, info.ServerRequestUri);
+            writeString(writer, info.RequestUri?.OriginalString);
+
+            writeHeaders(writer, info.ClientRequestHeaders, dictionary);
+            writeHeaders(writer, info.ServerRequestHeaders, dictionary);
+            writeHeaders(writer, info.ServerResponseHeaders, dictionary);
+
+            writeBytes(writer, info.ClientRequestBody);
+            writeBytes(writer, info.ServerRequestBody);
+            writeBytes(writer, info.ServerResponseBody);
+        }
+
+        public static DiagnosticsInfoV1 ReadRecord(BinaryReader reader, IReadOnlyList<string> dictionary, out int hostId)
+        {
+            var info = new DiagnosticsInfoV1();
+
+            info.DiagnosticsType = (DiagnosticsType)reader.ReadByte();
+            info.StatusCode = reader.ReadInt32();
+            info.DateStarted = DateTime.FromBinary(reader.ReadInt64());
+            info.DateEnded = DateTime.FromBinary(reader.ReadInt64());
+
+            hostId = reader.ReadInt32();
+            info.Host = hostId < 0 ? null : lookup(dictionary, hostId);
+
+            info.ClientRequestUri = readString(reader);
+            info.ServerRequestUri = readString(reader);
+
+            string requestUri = readString(reader);
+            info.RequestUri = requestUri == null ? null : new Uri(requestUri, UriKind.RelativeOrAbsolute);
+
+            info.ClientRequestHeaders = readHeaders(reader, dictionary);
+            info.ServerRequestHeaders = readHeaders(reader, dictionary);
+            info.ServerResponseHeaders = readHeaders(reader, dictionary);
+
+            info.ClientRequestBody = readBytes(reader);
+            info.ServerRequestBody = readBytes(reader);
+            info.ServerResponseBody = readBytes(reader);
+
+            return info;
+        }
+
+        private static void writeString(BinaryWriter writer, string value)
+        {
+            writer.Write(value != null);
+
+            if (value != null)
+            {
+                writer.Write(value);
+            }
+        }
+
+        private static string readString(BinaryReader reader)
+        {
+            return reader.ReadBoolean() ? reader.ReadString() : null;
+        }
+
+        private static void writeBytes(BinaryWriter writer, byte[] value)
+        {
+            // Length plus one, so that zero can mean null.
+            writer.Write(value == null ? 0 : value.Length + 1);
+
+            if (value != null)
+            {
+                writer.Write(value);
+            }
+        }
+
+        private static byte[] readBytes(BinaryReader reader)
+        {
+            int length = reader.ReadInt32();
+
+            if (length == 0)
+            {
+                return null;
+            }
+
+            byte[] value = reader.ReadBytes(length - 1);
+            if (value.Length != length - 1)
+            {
+                throw new InvalidDataException("Capture record ends inside a body.");
+            }
+
+            return value;
+        }
+
+        private static void writeHeaders(BinaryWriter writer, string headers, HeaderDictionary dictionary)
+        {
+            if (headers == null)
+            {
+                writer.Write(-1);
+                return;
+            }
+
+            // Split on '\n' only, so that '\r' stays part of each line and the text comes back exactly as it went in.
+            string[] lines = headers.Split('\n');
+            writer.Write(lines.Length);
+
+            foreach (string line in lines)
+            {
+                writer.Write(dictionary.Add(line));
+            }
+        }
+
+        private static string readHeaders(BinaryReader reader, IReadOnlyList<string> dictionary)
+        {
+            int count = reader.ReadInt32();
+
+            if (count < 0)
+            {
+                return null;
+            }
+
+            string[] lines = new string[count];
+            for (int i = 0; i < count; i++)
+            {
+                lines[i] = lookup(dictionary, reader.ReadInt32());
+            }
+
+            return string.Join("\n", lines);
+        }
+
+        private static string lookup(IReadOnlyList<string> dictionary, int id)
+        {
+            if (id < 0 || id >= dictionary.Count)
+            {
+                throw new InvalidDataException($"Capture record refers to dictionary entry {id}, which does not exist.");
+            }
+
+            return dictionary[id];
+        }
+    }
+
+    /// <summary>
+    /// Strings a segment has stored so far, numbered in the order they were first seen.
+    /// </summary>
+    internal class HeaderDictionary
+    {
+        private Dictionary<string, int> ids = new Dictionary<string, int>(StringComparer.Ordinal);
+        private List<string> entries = new List<string>();
+
+        // Entries added since the last WriteNew(), which have to go out with the next block.
+        private int firstNew = 0;
+
+        public IReadOnlyList<string> Entries => entries;
+
+        public int Add(string value)
+        {
+            int id;
+            if (!ids.TryGetValue(value, out id))
+            {
+                id = entries.Count;
+                entries.Add(value);
+                ids.Add(value, id);
+            }
+
+            return id;
+        }
+
+        public void WriteNew(BinaryWriter writer)
+        {
+            writer.Write(entries.Count - firstNew);
+
+            for (int i = firstNew; i < entries.Count; i++)
+            {
+                writer.Write(entries[i]);
+            }
+
+            firstNew = entries.Count;
+        }
+
+        public void WriteAll(BinaryWriter writer)
+        {
+            writer.Write(entries.Count);
+
+            foreach (string entry in entries)
+            {
+                writer.Write(entry);
+            }
+        }
+    }
+}
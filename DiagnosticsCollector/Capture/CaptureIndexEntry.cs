@@ -0,0 +1,55 @@
+/*
+* Copyright © 2019 Cloudveil Technology Inc.
+* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+using CloudVeil.IPC.Messages;
+using System.IO;
+
+namespace DiagnosticsCollector.Capture
+{
+    /// <summary>
+    /// What a segment's index knows about one record without decompressing its block.
+    /// </summary>
+    internal struct CaptureIndexEntry
+    {
+        public long BlockOffset;
+
+        // Position of the record within its block.
+        public int Slot;
+
+        public long StartedUtcTicks;
+
+        public int StatusCode;
+
+        // Dictionary id of the host, or -1.
+        public int HostId;
+
+        public DiagnosticsType DiagnosticsType;
+
+        public void Write(BinaryWriter writer)
+        {
+            writer.Write(BlockOffset);
+            writer.Write(Slot);
+            writer.Write(StartedUtcTicks);
+            writer.Write(StatusCode);
+            writer.Write(HostId);
+            writer.Write((byte)DiagnosticsType);
+        }
+
+        public static CaptureIndexEntry Read(BinaryReader reader)
+        {
+            return new CaptureIndexEntry()
+            {
+                BlockOffset = reader.ReadInt64(),
+                Slot = reader.ReadInt32(),
+                StartedUtcTicks = reader.ReadInt64(),
+                StatusCode = reader.ReadInt32(),
+                HostId = reader.ReadInt32(),
+                DiagnosticsType = (DiagnosticsType)reader.ReadByte()
+            };
+        }
+    }
+}
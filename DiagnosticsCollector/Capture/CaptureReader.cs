@@ -0,0 +1,143 @@
+/*
+* Copyright © 2019 Cloudveil Technology Inc.
+* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+using CloudVeil.IPC.Messages;
+using System;
+using System.Collections.Generic;
+using System.IO;
+using System.Linq;
+
+namespace DiagnosticsCollector.Capture
+{
+    /// <summary>
+    /// Reads a directory written by CaptureWriter. Segments are memory mapped, and queries are answered from each
+    /// segment's index, so only the blocks holding matching records are decompressed.
+    /// </summary>
+    public class CaptureReader : IDisposable
+    {
+        private List<CaptureSegment> segments = new List<CaptureSegment>();
+
+        public CaptureReader(string directory)
+        {
+            if (directory == null)
+            {
+                throw new ArgumentNullException(nameof(directory));
+            }
+
+            try
+            {
+                foreach (string path in segmentPaths(directory))
+                {
+                    if (new FileInfo(path).Length < CaptureFormat.SegmentHeaderSize)
+                    {
+                        // The writer stopped before the segment header went out. Nothing to read.
+                        continue;
+                    }
+
+                    segments.Add(new CaptureSegment(path));
+                }
+            }
+            catch
+            {
+                Dispose();
+                throw;
+            }
+        }
+
+        public int Count => segments.Sum(s => s.Index.Count);
+
+        public int SegmentCount => segments.Count;
+
+        /// <summary>
+        /// Segments that were not closed cleanly, whose index had to be rebuilt from their blocks.
+        /// </summary>
+        public int RecoveredSegmentCount => segments.Count(s => !s.Complete);
+
+        public IEnumerable<DiagnosticsInfoV1> Records()
+        {
+            return Query();
+        }
+
+        /// <summary>
+        /// Records in the order they were written that match every filter given.
+        /// </summary>
+        /// <param name="host">Matched without regard to case.</param>
+        /// <param name="from">Inclusive lower bound on DateStarted.</param>
+        /// <param name="to">Exclusive upper bound on DateStarted.</param>
+        public IEnumerable<DiagnosticsInfoV1> Query(string host = null, DateTime? from = null, DateTime? to = null, int? statusCode = null)
+        {
+            long fromTicks = from.HasValue ? from.Value.ToUniversalTime().Ticks : long.MinValue;
+            long toTicks = to.HasValue ? to.Value.ToUniversalTime().Ticks : long.MaxValue;
+
+            foreach (CaptureSegment segment in segments)
+            {
+                int hostId = -1;
+
+                if (host != null)
+                {
+                    hostId = segment.FindHost(host);
+                    if (hostId < 0)
+                    {
+                        continue;
+                    }
+                }
+
+                foreach (CaptureIndexEntry entry in segment.Index)
+                {
+                    if ((host != null && entry.HostId != hostId) ||
+                        entry.StartedUtcTicks < fromTicks || entry.StartedUtcTicks >= toTicks ||
+                        (statusCode.HasValue && entry.StatusCode != statusCode.Value))
+                    {
+                        continue;
+                    }
+
+                    yield return segment.Read(entry);
+                }
+            }
+        }
+
+        public void Dispose()
+        {
+            foreach (CaptureSegment segment in segments)
+            {
+                segment.Dispose();
+            }
+
+            segments.Clear();
+        }
+
+        /// <summary>
+        /// Number of the newest segment in directory, or zero if there are none.
+        /// </summary>
+        internal static int LastSegmentNumber(string directory)
+        {
+            int last = 0;
+
+            foreach (string path in segmentPaths(directory))
+            {
+                last = Math.Max(last, segmentNumber(path));
+            }
+
+            return last;
+        }
+
+        private static IEnumerable<string> segmentPaths(string directory)
+        {
+            return Directory.EnumerateFiles(directory, "segment-*" + CaptureFormat.SegmentExtension)
+                .Where(path => segmentNumber(path) > 0)
+                .OrderBy(segmentNumber);
+        }
+
+        private static int segmentNumber(string path)
+        {
+            string name = Path.GetFileNameWithoutExtension(path);
+
+            int number;
+            return int.TryParse(name.Substring("segment-".Length), out number) ? number : 0;
+        }
+    }
+}
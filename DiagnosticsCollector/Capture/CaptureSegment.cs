@@ -0,0 +1,276 @@
+/*
+* Copyright © 2019 Cloudveil Technology Inc.
+* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+using CloudVeil.IPC.Messages;
+using System;
+using System.Collections.Generic;
+using System.IO;
+using System.IO.MemoryMappedFiles;
+
+namespace DiagnosticsCollector.Capture
+{
+    /// <summary>
+    /// One memory mapped segment file. Keeps the segment's dictionary and index in memory, and the records of the block
+    /// it read last, since queries tend to read several records from the same block in a row.
+    /// </summary>
+    internal class CaptureSegment : IDisposable
+    {
+        private MemoryMappedFile file;
+        private MemoryMappedViewAccessor view;
+
+        // The view is rounded up to a whole page, so this is the only reliable end of the data.
+        private long length;
+
+        private List<string> dictionary = new List<string>();
+        private List<CaptureIndexEntry> index = new List<CaptureIndexEntry>();
+
+        private long cachedBlockOffset = -1;
+        private List<DiagnosticsInfoV1> cachedBlock;
+
+        public CaptureSegment(string path)
+        {
+            Path = path;
+            length = new FileInfo(path).Length;
+
+            file = MemoryMappedFile.CreateFromFile(path, FileMode.Open, null, 0, MemoryMappedFileAccess.Read);
+
+            try
+            {
+                view = file.CreateViewAccessor(0, 0, MemoryMappedFileAccess.Read);
+
+                if (view.ReadUInt32(0) != CaptureFormat.SegmentMagic)
+                {
+                    throw new InvalidDataException($"{path} is not a diagnostics capture segment.");
+                }
+
+                int version = view.ReadInt32(4);
+                if (version != CaptureFormat.FormatVersion)
+                {
+                    throw new InvalidDataException($"{path} has capture format version {version}, which this collector cannot read.");
+                }
+
+                Complete = readFooter();
+
+                if (!Complete)
+                {
+                    scanBlocks();
+                }
+            }
+            catch
+            {
+                Dispose();
+                throw;
+            }
+        }
+
+        public string Path { get; private set; }
+
+        /// <summary>
+        /// False if the segment was never closed and its index was rebuilt by reading every block.
+        /// </summary>
+        public bool Complete { get; private set; }
+
+        public IReadOnlyList<CaptureIndexEntry> Index => index;
+
+        public int FindHost(string host)
+        {
+            foreach (CaptureIndexEntry entry in index)
+            {
+                if (entry.HostId >= 0 && string.Equals(dictionary[entry.HostId], host, StringComparison.OrdinalIgnoreCase))
+                {
+                    return entry.HostId;
+                }
+            }
+
+            return -1;
+        }
+
+        public DiagnosticsInfoV1 Read(CaptureIndexEntry entry)
+        {
+            if (entry.BlockOffset != cachedBlockOffset)
+            {
+                cachedBlock = readBlock(entry.BlockOffset);
+                cachedBlockOffset = entry.BlockOffset;
+            }
+
+            return cachedBlock[entry.Slot];
+        }
+
+        public void Dispose()
+        {
+            view?.Dispose();
+            view = null;
+
+            file?.Dispose();
+            file = null;
+        }
+
+        private bool readFooter()
+        {
+            if (length < CaptureFormat.SegmentHeaderSize + CaptureFormat.BlockHeaderSize + CaptureFormat.TrailerSize)
+            {
+                return false;
+            }
+
+            long trailer = length - CaptureFormat.TrailerSize;
+            long footerOffset = view.ReadInt64(trailer);
+
+            if (view.ReadUInt32(trailer + 8) != CaptureFormat.TrailerMagic ||
+                footerOffset < CaptureFormat.SegmentHeaderSize || footerOffset > trailer - CaptureFormat.BlockHeaderSize)
+            {
+                return false;
+            }
+
+            try
+            {
+                using (BinaryReader reader = decompress(footerOffset, CaptureFormat.FooterMagic, trailer))
+                {
+                    if (reader == null)
+                    {
+                        return false;
+                    }
+
+                    readDictionary(reader);
+
+                    int count = reader.ReadInt32();
+                    for (int i = 0; i < count; i++)
+                    {
+                        index.Add(CaptureIndexEntry.Read(reader));
+                    }
+                }
+
+                return true;
+            }
+            catch (Exception ex) when (ex is InvalidDataException || ex is EndOfStreamException)
+            {
+                // Damaged footer. The blocks can still be read.
+                return false;
+            }
+        }
+
+        // Rebuilds the dictionary and index of a segment the writer never closed, up to its last whole block.
+        private void scanBlocks()
+        {
+            dictionary.Clear();
+            index.Clear();
+
+            long offset = CaptureFormat.SegmentHeaderSize;
+
+            while (true)
+            {
+                int dictionaryCount = dictionary.Count;
+                int indexCount = index.Count;
+
+                try
+                {
+                    using (BinaryReader reader = decompress(offset, CaptureFormat.BlockMagic, length))
+                    {
+                        if (reader == null)
+                        {
+                            break;
+                        }
+
+                        readDictionary(reader);
+
+                        int count = reader.ReadInt32();
+                        for (int slot = 0; slot < count; slot++)
+                        {
+                            int hostId;
+                            DiagnosticsInfoV1 info = CaptureFormat.ReadRecord(reader, dictionary, out hostId);
+
+                            index.Add(new CaptureIndexEntry()
+                            {
+                                BlockOffset = offset,
+                                Slot = slot,
+                                StartedUtcTicks = info.DateStarted.ToUniversalTime().Ticks,
+                                StatusCode = info.StatusCode,
+                                HostId = hostId,
+                                DiagnosticsType = info.DiagnosticsType
+                            });
+                        }
+                    }
+                }
+                catch (Exception ex) when (ex is InvalidDataException || ex is EndOfStreamException)
+                {
+                    // Where the writer was cut off. Forget whatever this block added.
+                    dictionary.RemoveRange(dictionaryCount, dictionary.Count - dictionaryCount);
+                    index.RemoveRange(indexCount, index.Count - indexCount);
+                    break;
+                }
+
+                offset += CaptureFormat.BlockHeaderSize + view.ReadInt32(offset + 4);
+            }
+        }
+
+        private List<DiagnosticsInfoV1> readBlock(long offset)
+        {
+            using (BinaryReader reader = decompress(offset, CaptureFormat.BlockMagic, length))
+            {
+                if (reader == null)
+                {
+                    throw new InvalidDataException($"{Path} has no block at offset {offset}.");
+                }
+
+                // Already part of the segment's dictionary. Only needed when scanning.
+                int newEntries = reader.ReadInt32();
+                for (int i = 0; i < newEntries; i++)
+                {
+                    reader.ReadString();
+                }
+
+                int count = reader.ReadInt32();
+                var records = new List<DiagnosticsInfoV1>(count);
+
+                for (int i = 0; i < count; i++)
+                {
+                    int hostId;
+                    records.Add(CaptureFormat.ReadRecord(reader, dictionary, out hostId));
+                }
+
+                return records;
+            }
+        }
+
+        private void readDictionary(BinaryReader reader)
+        {
+            int count = reader.ReadInt32();
+
+            for (int i = 0; i < count; i++)
+            {
+                dictionary.Add(reader.ReadString());
+            }
+        }
+
+        /// <summary>
+        /// Decompresses the block at offset, which has to end by limit.
+        /// </summary>
+        /// <returns>A reader over the raw block, or null if there is no whole block with the given magic there.</returns>
+        private BinaryReader decompress(long offset, uint magic, long limit)
+        {
+            if (offset + CaptureFormat.BlockHeaderSize > limit || view.ReadUInt32(offset) != magic)
+            {
+                return null;
+            }
+
+            int compressedLength = view.ReadInt32(offset + 4);
+            int rawLength = view.ReadInt32(offset + 8);
+
+            if (compressedLength < 0 || rawLength < 0 || offset + CaptureFormat.BlockHeaderSize + compressedLength > limit)
+            {
+                return null;
+            }
+
+            byte[] compressed = new byte[compressedLength];
+            view.ReadArray(offset + CaptureFormat.BlockHeaderSize, compressed, 0, compressedLength);
+
+            byte[] raw = new byte[rawLength];
+            Lz4Block.Decompress(compressed, 0, compressedLength, raw, rawLength);
+
+            return new BinaryReader(new MemoryStream(raw, false));
+        }
+    }
+}
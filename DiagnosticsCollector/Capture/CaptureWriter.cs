@@ -0,0 +1,351 @@
+/*
+* Copyright © 2019 Cloudveil Technology Inc.
+* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+using CloudVeil.IPC.Messages;
+using System;
+using System.Collections.Concurrent;
+using System.Collections.Generic;
+using System.IO;
+using System.Threading;
+
+namespace DiagnosticsCollector.Capture
+{
+    /// <summary>
+    /// Appends diagnostics records to a directory of segment files. Append() only queues the record; a background thread
+    /// groups queued records into blocks, compresses each block and appends it to the current segment, and starts a new
+    /// segment once the current one passes the segment size.
+    ///
+    /// Records reach the disk within FlushDelayMilliseconds of the last Append(), or as soon as a block fills up. The
+    /// segment being written only gets its index when it is closed, by rolling over or by Dispose().
+    /// </summary>
+    public class CaptureWriter : IDisposable
+    {
+        public const long DefaultSegmentSize = 64L * 1024 * 1024;
+
+        // Uncompressed record bytes that make up one block. Big enough for LZ4 to find repeats across requests.
+        private const int BlockSize = 256 * 1024;
+
+        private const int FlushDelayMilliseconds = 200;
+
+        // Append() blocks once this many records are waiting, rather than letting the queue grow without bound.
+        private const int QueueCapacity = 4096;
+
+        private string directory;
+        private long segmentSize;
+
+        private BlockingCollection<DiagnosticsInfoV1> queue = new BlockingCollection<DiagnosticsInfoV1>(QueueCapacity);
+        private Thread thread;
+
+        private volatile Exception failure;
+
+        private long recordsWritten;
+        private long rawBytesWritten;
+        private long bytesWritten;
+
+        // Everything below is only used by the writer thread.
+
+        private int segmentNumber;
+        private FileStream segment;
+        private HeaderDictionary dictionary;
+        private List<CaptureIndexEntry> index;
+
+        private List<CaptureIndexEntry> blockEntries = new List<CaptureIndexEntry>();
+        private MemoryStream records = new MemoryStream();
+        private BinaryWriter recordWriter;
+        private MemoryStream raw = new MemoryStream();
+        private BinaryWriter rawWriter;
+
+        private byte[] compressed = new byte[0];
+        private int[] hashTable = Lz4Block.NewHashTable();
+        private byte[] header = new byte[CaptureFormat.BlockHeaderSize];
+
+        /// <param name="directory">Created if it does not exist. Segments already in it are kept, and new ones are numbered after them.</param>
+        public CaptureWriter(string directory, long segmentSize = DefaultSegmentSize)
+        {
+            if (directory == null)
+            {
+                throw new ArgumentNullException(nameof(directory));
+            }
+
+            if (segmentSize <= 0)
+            {
+                throw new ArgumentOutOfRangeException(nameof(segmentSize));
+            }
+
+            this.directory = directory;
+            this.segmentSize = segmentSize;
+
+            Directory.CreateDirectory(directory);
+            segmentNumber = CaptureReader.LastSegmentNumber(directory);
+
+            recordWriter = new BinaryWriter(records);
+            rawWriter = new BinaryWriter(raw);
+
+            thread = new Thread(writeLoop);
+            thread.IsBackground = true;
+            thread.Name = "Capture writer";
+            thread.Start();
+        }
+
+        public string CaptureDirectory => directory;
+
+        /// <summary>
+        /// The error that stopped the writer, if any. Records appended after a failure are dropped.
+        /// </summary>
+        public Exception Failure => failure;
+
+        public long RecordsWritten => Interlocked.Read(ref recordsWritten);
+
+        /// <summary>
+        /// Size of the blocks written so far before compression. Header lines are already deduplicated at this point.
+        /// </summary>
+        public long RawBytesWritten => Interlocked.Read(ref rawBytesWritten);
+
+        /// <summary>
+        /// Bytes written to segment files so far, including block headers and footers.
+        /// </summary>
+        public long BytesWritten => Interlocked.Read(ref bytesWritten);
+
+        /// <exception cref="IOException">The writer has failed. The inner exception says why.</exception>
+        /// <exception cref="InvalidOperationException">The writer has been disposed.</exception>
+        public void Append(DiagnosticsInfoV1 info)
+        {
+            if (info == null)
+            {
+                throw new ArgumentNullException(nameof(info));
+            }
+
+            Exception error = failure;
+            if (error != null)
+            {
+                throw new IOException("Writing the diagnostics capture failed.", error);
+            }
+
+            queue.Add(info);
+        }
+
+        /// <summary>
+        /// Writes out everything that has been appended and closes the current segment.
+        /// </summary>
+        public void Dispose()
+        {
+            if (queue.IsAddingCompleted)
+            {
+                return;
+            }
+
+            queue.CompleteAdding();
+            thread.Join();
+            queue.Dispose();
+        }
+
+        private void writeLoop()
+        {
+            while (true)
+            {
+                DiagnosticsInfoV1 info;
+
+                // Wait as long as it takes for the first record of a block, but only a little for the rest of it.
+                if (!queue.TryTake(out info, blockEntries.Count == 0 ? Timeout.Infinite : FlushDelayMilliseconds))
+                {
+                    guard(flushBlock);
+
+                    if (queue.IsCompleted)
+                    {
+                        break;
+                    }
+
+                    continue;
+                }
+
+                if (failure != null)
+                {
+                    // Keep draining, so that Append() never blocks on a queue nobody is emptying.
+                    continue;
+                }
+
+                guard(() =>
+                {
+                    appendRecord(info);
+
+                    if (records.Length >= BlockSize)
+                    {
+                        flushBlock();
+                    }
+                });
+            }
+
+            guard(closeSegment);
+
+            if (segment != null)
+            {
+                // Only left open by a failure. The segment can still be read up to its last whole block.
+                segment.Dispose();
+                segment = null;
+            }
+        }
+
+        private void guard(Action action)
+        {
+            if (failure != null)
+            {
+                return;
+            }
+
+            try
+            {
+                action();
+            }
+            catch (Exception ex)
+            {
+                failure = ex;
+            }
+        }
+
+        private void appendRecord(DiagnosticsInfoV1 info)
+        {
+            if (segment == null)
+            {
+                openSegment();
+            }
+
+            int hostId;
+            CaptureFormat.WriteRecord(recordWriter, info, dictionary, out hostId);
+
+            blockEntries.Add(new CaptureIndexEntry()
+            {
+                Slot = blockEntries.Count,
+                StartedUtcTicks = info.DateStarted.ToUniversalTime().Ticks,
+                StatusCode = info.StatusCode,
+                HostId = hostId,
+                DiagnosticsType = info.DiagnosticsType
+            });
+        }
+
+        private void flushBlock()
+        {
+            if (blockEntries.Count == 0)
+            {
+                return;
+            }
+
+            recordWriter.Flush();
+
+            raw.SetLength(0);
+            dictionary.WriteNew(rawWriter);
+            rawWriter.Write(blockEntries.Count);
+            rawWriter.Flush();
+            records.WriteTo(raw);
+
+            long offset = segment.Position;
+            writeCompressed(CaptureFormat.BlockMagic, blockEntries.Count);
+
+            Interlocked.Add(ref rawBytesWritten, raw.Length);
+
+            for (int i = 0; i < blockEntries.Count; i++)
+            {
+                CaptureIndexEntry entry = blockEntries[i];
+                entry.BlockOffset = offset;
+                index.Add(entry);
+            }
+
+            Interlocked.Add(ref recordsWritten, blockEntries.Count);
+
+            blockEntries.Clear();
+            records.SetLength(0);
+
+            if (segment.Length >= segmentSize)
+            {
+                closeSegment();
+            }
+        }
+
+        private void openSegment()
+        {
+            string path = Path.Combine(directory, CaptureFormat.SegmentFileName(++segmentNumber));
+
+            segment = new FileStream(path, FileMode.CreateNew, FileAccess.Write, FileShare.Read, 64 * 1024);
+            dictionary = new HeaderDictionary();
+            index = new List<CaptureIndexEntry>();
+
+            var writer = new BinaryWriter(segment);
+            writer.Write(CaptureFormat.SegmentMagic);
+            writer.Write(CaptureFormat.FormatVersion);
+            writer.Flush();
+
+            Interlocked.Add(ref bytesWritten, CaptureFormat.SegmentHeaderSize);
+        }
+
+        private void closeSegment()
+        {
+            if (segment == null)
+            {
+                return;
+            }
+
+            raw.SetLength(0);
+            dictionary.WriteAll(rawWriter);
+            rawWriter.Write(index.Count);
+
+            foreach (CaptureIndexEntry entry in index)
+            {
+                entry.Write(rawWriter);
+            }
+
+            rawWriter.Flush();
+
+            long footerOffset = segment.Position;
+            writeCompressed(CaptureFormat.FooterMagic, index.Count);
+
+            var writer = new BinaryWriter(segment);
+            writer.Write(footerOffset);
+            writer.Write(CaptureFormat.TrailerMagic);
+            writer.Flush();
+
+            Interlocked.Add(ref bytesWritten, CaptureFormat.TrailerSize);
+
+            segment.Flush(true);
+            segment.Dispose();
+            segment = null;
+            dictionary = null;
+            index = null;
+        }
+
+        // Compresses whatever is in raw and appends it to the segment behind a block header.
+        private void writeCompressed(uint magic, int recordCount)
+        {
+            int rawLength = (int)raw.Length;
+
+            int bound = Lz4Block.MaxCompressedLength(rawLength);
+            if (compressed.Length < bound)
+            {
+                compressed = new byte[bound];
+            }
+
+            int compressedLength = Lz4Block.Compress(raw.GetBuffer(), rawLength, compressed, hashTable);
+
+            writeInt(header, 0, (int)magic);
+            writeInt(header, 4, compressedLength);
+            writeInt(header, 8, rawLength);
+            writeInt(header, 12, recordCount);
+
+            segment.Write(header, 0, header.Length);
+            segment.Write(compressed, 0, compressedLength);
+            segment.Flush();
+
+            Interlocked.Add(ref bytesWritten, header.Length + compressedLength);
+        }
+
+        private static void writeInt(byte[] buffer, int offset, int value)
+        {
+            buffer[offset] = (byte)value;
+            buffer[offset + 1] = (byte)(value >> 8);
+            buffer[offset + 2] = (byte)(value >> 16);
+            buffer[offset + 3] = (byte)(value >> 24);
+        }
+    }
+}
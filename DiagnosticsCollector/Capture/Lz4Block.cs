@@ -0,0 +1,271 @@
+/*
+* Copyright © 2019 Cloudveil Technology Inc.
+* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+using System;
+using System.IO;
+
+namespace DiagnosticsCollector.Capture
+{
+    /// <summary>
+    /// LZ4 block format compression. Trades ratio for speed, which is what a capture that has to keep up with the filter
+    /// needs. Blocks written here can be read by any LZ4 block decoder and vice versa.
+    /// </summary>
+    public static class Lz4Block
+    {
+        private const int MinMatch = 4;
+
+        // The format requires the last match to start at least this far from the end of the input,
+        // and the last five bytes to be literals.
+        private const int MatchFindLimit = 12;
+        private const int LastLiterals = 5;
+
+        private const int MaxOffset = 65535;
+
+        private const int HashBits = 12;
+
+        // After this many misses in a row the search starts skipping ahead, so incompressible data goes quickly.
+        private const int SkipTrigger = 6;
+
+        public static int MaxCompressedLength(int length)
+        {
+            return length + length / 255 + 16;
+        }
+
+        /// <summary>
+        /// Compresses source[0, length) into destination, which must hold at least MaxCompressedLength(length) bytes.
+        /// </summary>
+        /// <returns>The number of bytes written.</returns>
+        public static int Compress(byte[] source, int length, byte[] destination, int[] hashTable)
+        {
+            if (source == null) throw new ArgumentNullException(nameof(source));
+            if (destination == null) throw new ArgumentNullException(nameof(destination));
+            if (length < 0 || length > source.Length) throw new ArgumentOutOfRangeException(nameof(length));
+            if (destination.Length < MaxCompressedLength(length)) throw new ArgumentException("Destination is too small.", nameof(destination));
+            if (hashTable == null || hashTable.Length != (1 << HashBits)) throw new ArgumentException("Hash table must come from NewHashTable().", nameof(hashTable));
+
+            int output = 0;
+            int anchor = 0;
+
+            if (length >= MatchFindLimit + 1)
+            {
+                // Positions are stored off by one, so that zero means empty.
+                Array.Clear(hashTable, 0, hashTable.Length);
+
+                int position = 0;
+                int matchLimit = length - LastLiterals;
+                int findLimit = length - MatchFindLimit;
+
+                while (position < findLimit)
+                {
+                    int hash = hashAt(source, position);
+                    int candidate = hashTable[hash] - 1;
+                    hashTable[hash] = position + 1;
+
+                    if (candidate < 0 || position - candidate > MaxOffset || readInt(source, candidate) != readInt(source, position))
+                    {
+                        position += 1 + ((position - anchor) >> SkipTrigger);
+                        continue;
+                    }
+
+                    // Extend backwards over literals that also match.
+                    while (position > anchor && candidate > 0 && source[position - 1] == source[candidate - 1])
+                    {
+                        position--;
+                        candidate--;
+                    }
+
+                    int matchLength = MinMatch;
+                    while (position + matchLength < matchLimit && source[position + matchLength] == source[candidate + matchLength])
+                    {
+                        matchLength++;
+                    }
+
+                    int token = output;
+                    output = writeSequence(source, anchor, position - anchor, destination, output);
+
+                    int offset = position - candidate;
+                    destination[output++] = (byte)offset;
+                    destination[output++] = (byte)(offset >> 8);
+
+                    output = writeMatchLength(destination, token, output, matchLength - MinMatch);
+
+                    position += matchLength;
+                    anchor = position;
+
+                    if (position < findLimit)
+                    {
+                        // Cheap to do and catches runs that start just inside the match.
+                        hashTable[hashAt(source, position - 2)] = position - 1;
+                    }
+                }
+            }
+
+            // Everything after the last match goes out as one literal run with no match.
+            return writeSequence(source, anchor, length - anchor, destination, output);
+        }
+
+        /// <summary>
+        /// Decompresses a whole block into destination[0, decompressedLength).
+        /// </summary>
+        /// <exception cref="InvalidDataException">The block is malformed or does not decompress to exactly decompressedLength bytes.</exception>
+        public static void Decompress(byte[] source, int sourceOffset, int sourceLength, byte[] destination, int decompressedLength)
+        {
+            if (source == null) throw new ArgumentNullException(nameof(source));
+            if (destination == null) throw new ArgumentNullException(nameof(destination));
+            if (sourceOffset < 0 || sourceLength < 0 || sourceOffset + sourceLength > source.Length) throw new ArgumentOutOfRangeException(nameof(sourceLength));
+            if (decompressedLength < 0 || decompressedLength > destination.Length) throw new ArgumentOutOfRangeException(nameof(decompressedLength));
+
+            int input = sourceOffset;
+            int inputEnd = sourceOffset + sourceLength;
+            int output = 0;
+
+            while (input < inputEnd)
+            {
+                int token = source[input++];
+
+                int literalLength = token >> 4;
+                if (literalLength == 15)
+                {
+                    literalLength += readLength(source, ref input, inputEnd);
+                }
+
+                if (literalLength > inputEnd - input || literalLength > decompressedLength - output)
+                {
+                    throw new InvalidDataException("LZ4 literal run goes past the end of the block.");
+                }
+
+                Buffer.BlockCopy(source, input, destination, output, literalLength);
+                input += literalLength;
+                output += literalLength;
+
+                if (input == inputEnd)
+                {
+                    // The last sequence has no match.
+                    break;
+                }
+
+                if (inputEnd - input < 2)
+                {
+                    throw new InvalidDataException("LZ4 block ends inside a match offset.");
+                }
+
+                int offset = source[input] | (source[input + 1] << 8);
+                input += 2;
+
+                int matchLength = token & 0xF;
+                if (matchLength == 15)
+                {
+                    matchLength += readLength(source, ref input, inputEnd);
+                }
+
+                matchLength += MinMatch;
+
+                if (offset == 0 || offset > output || matchLength > decompressedLength - output)
+                {
+                    throw new InvalidDataException("LZ4 match points outside the block.");
+                }
+
+                int match = output - offset;
+
+                if (offset >= matchLength)
+                {
+                    Buffer.BlockCopy(destination, match, destination, output, matchLength);
+                    output += matchLength;
+                }
+                else
+                {
+                    // Overlapping copy, which is how runs are encoded. Has to go byte by byte.
+                    for (int i = 0; i < matchLength; i++)
+                    {
+                        destination[output++] = destination[match + i];
+                    }
+                }
+            }
+
+            if (output != decompressedLength)
+            {
+                throw new InvalidDataException($"LZ4 block decompressed to {output} bytes, expected {decompressedLength}.");
+            }
+        }
+
+        public static int[] NewHashTable()
+        {
+            return new int[1 << HashBits];
+        }
+
+        private static int readInt(byte[] buffer, int offset)
+        {
+            return buffer[offset] | (buffer[offset + 1] << 8) | (buffer[offset + 2] << 16) | (buffer[offset + 3] << 24);
+        }
+
+        private static int hashAt(byte[] buffer, int offset)
+        {
+            return (int)(((uint)readInt(buffer, offset) * 2654435761U) >> (32 - HashBits));
+        }
+
+        private static int writeSequence(byte[] source, int literalStart, int literalLength, byte[] destination, int output)
+        {
+            int token = output++;
+
+            if (literalLength >= 15)
+            {
+                destination[token] = 0xF0;
+                output = writeLength(destination, output, literalLength - 15);
+            }
+            else
+            {
+                destination[token] = (byte)(literalLength << 4);
+            }
+
+            Buffer.BlockCopy(source, literalStart, destination, output, literalLength);
+            return output + literalLength;
+        }
+
+        private static int writeMatchLength(byte[] destination, int token, int output, int length)
+        {
+            if (length >= 15)
+            {
+                destination[token] |= 0xF;
+                return writeLength(destination, output, length - 15);
+            }
+
+            destination[token] |= (byte)length;
+            return output;
+        }
+
+        private static int writeLength(byte[] destination, int output, int length)
+        {
+            while (length >= 255)
+            {
+                destination[output++] = 255;
+                length -= 255;
+            }
+
+            destination[output++] = (byte)length;
+            return output;
+        }
+
+        private static int readLength(byte[] source, ref int input, int inputEnd)
+        {
+            int length = 0;
+            int next;
+
+            do
+            {
+                if (input >= inputEnd)
+                {
+                    throw new InvalidDataException("LZ4 block ends inside a length.");
+                }
+
+                next = source[input++];
+                length += next;
+            } while (next == 255);
+
+            return length;
+        }
+    }
+}
@@ -0,0 +1,98 @@
+/*
+* Copyright © 2019 Cloudveil Technology Inc.
+* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+using CloudVeil.IPC.Messages;
+using System;
+using System.Text;
+
+namespace DiagnosticsCollector.Capture
+{
+    /// <summary>
+    /// Made up request sessions for benchmarking capture storage. A fixed seed gives the same sequence every run. Hosts,
+    /// headers and body text are drawn from small pools, roughly the way real browsing repeats itself.
+    /// </summary>
+    public class SyntheticTraffic
+    {
+        private static readonly string[] hosts =
+        {
+            "www.example.com", "cdn.example.com", "api.example.net", "static.example.org", "news.example.com",
+            "mail.example.net", "images.example.org", "video.example.com", "search.example.com", "ads.example.net"
+        };
+
+        private static readonly string[] contentTypes = { "text/html; charset=utf-8", "application/json", "text/css", "application/javascript" };
+
+        private static readonly string[] words =
+        {
+            "filter", "request", "response", "category", "trigger", "session", "content", "policy", "update", "service",
+            "window", "browser", "account", "picture", "message", "network", "private", "display", "default", "section"
+        };
+
+        private static readonly int[] statusCodes = { 200, 200, 200, 200, 200, 200, 304, 301, 404, 500 };
+
+        private Random random;
+        private DateTime clock = new DateTime(2019, 1, 1, 0, 0, 0, DateTimeKind.Utc);
+
+        public SyntheticTraffic(int seed = 1)
+        {
+            random = new Random(seed);
+        }
+
+        public DiagnosticsInfoV1 Next()
+        {
+            string host = hosts[random.Next(hosts.Length)];
+            string path = $"/{words[random.Next(words.Length)]}/{random.Next(100000)}";
+            string uri = $"https://{host}{path}";
+
+            clock = clock.AddMilliseconds(random.Next(1, 50));
+
+            string contentType = contentTypes[random.Next(contentTypes.Length)];
+            int statusCode = statusCodes[random.Next(statusCodes.Length)];
+
+            string requestHeaders =
+                $"GET {path} HTTP/1.1\r\n" +
+                $"Host: {host}\r\n" +
+                "User-Agent: Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/76.0.3809.132 Safari/537.36\r\n" +
+                "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/webp,*/*;q=0.8\r\n" +
+                "Accept-Encoding: gzip, deflate, br\r\n" +
+                "Accept-Language: en-US,en;q=0.9\r\n" +
+                $"Cookie: session={random.Next(16)}\r\n";
+
+            return new DiagnosticsInfoV1()
+            {
+                DiagnosticsType = DiagnosticsType.RequestSession,
+                ClientRequestHeaders = requestHeaders,
+                ServerRequestHeaders = requestHeaders + "X-Filter-Request: 1\r\n",
+                ClientRequestUri = uri,
+                ServerRequestUri = uri,
+                ServerResponseHeaders =
+                    $"HTTP/1.1 {statusCode}\r\n" +
+                    $"Content-Type: {contentType}\r\n" +
+                    "Cache-Control: max-age=3600\r\n" +
+                    "Server: nginx\r\n",
+                ServerResponseBody = body(random.Next(512, 32 * 1024)),
+                DateStarted = clock,
+                DateEnded = clock.AddMilliseconds(random.Next(5, 500)),
+                Host = host,
+                RequestUri = new Uri(uri),
+                StatusCode = statusCode
+            };
+        }
+
+        private byte[] body(int length)
+        {
+            var builder = new StringBuilder(length + 16);
+
+            while (builder.Length < length)
+            {
+                builder.Append(words[random.Next(words.Length)]);
+                builder.Append(random.Next(8) == 0 ? ".\n" : " ");
+            }
+
+            return Encoding.UTF8.GetBytes(builder.ToString());
+        }
+    }
+}
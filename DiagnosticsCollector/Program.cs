@@ -7,13 +7,17 @@
 
 ﻿using CloudVeil.IPC;
 using CloudVeil.IPC.Messages;
+using DiagnosticsCollector.Capture;
 using Filter.Platform.Common.Types;
 using Microsoft.Data.Sqlite;
 using System;
 using System.Collections.Generic;
+using System.Diagnostics;
+using System.Globalization;
 using System.IO;
 using System.Linq;
 using System.Text;
+using System.Threading;
 using System.Threading.Tasks;
 
 namespace DiagnosticsCollector
@@ -69,8 +73,8 @@ namespace DiagnosticsCollector
             Console.WriteLine("This program was designed to be a diagnostics collector for CloudVeil for Windows.");
             Console.WriteLine("Use this program when you want to collect data on sites that aren't behaving properly while the filter is running.");
             Console.WriteLine("Here are the common commands:");
-            Console.WriteLine("\tstart-diag [filename]: Use this to start collecting diagnostics information from CloudVeil for Windows");
-            Console.WriteLine("\tstop-diag: Stops the diagnostic data collection and saves it to the file specified by start-diag");
+            Console.WriteLine("\tstart-diag [directory]: Use this to start collecting diagnostics information from CloudVeil for Windows");
+            Console.WriteLine("\tstop-diag: Stops the diagnostic data collection and saves it to the directory specified by start-diag");
             Console.WriteLine("\tquit: Quits the program.");
             Console.WriteLine("Use 'help' to get a comprehensive list of commands.");
 
@@ -146,9 +150,53 @@ namespace DiagnosticsCollector
                         
 
                     case "stop-diag":
-                        StopDiagnostics();
+                        {
+                            string directory = StopDiagnostics();
+
+                            if (directory != null)
+                            {
+                                LoadDiagnostics(directory);
+                            }
+
+                            break;
+                        }
+
+                    case "export-diag":
+                        if (commandParts.Length > 1)
+                        {
+                            ExportDiagnostics(string.Join(" ", commandParts.Skip(1).ToArray()));
+                        }
+                        else
+                        {
+                            Console.WriteLine("export-diag requires a filename.");
+                        }
+                        break;
+
+                    case "import-diag":
+                        if (commandParts.Length > 1)
+                        {
+                            ImportDiagnostics(commandParts[1], commandParts.Length > 2 ? commandParts[2] : null);
+                        }
+                        else
+                        {
+                            Console.WriteLine("import-diag requires a filename.");
+                        }
                         break;
 
+                    case "bench-capture":
+                        {
+                            int count = 20000;
+
+                            if (commandParts.Length > 1 && !int.TryParse(commandParts[1], out count))
+                            {
+                                Console.WriteLine("Usage: bench-capture [count]");
+                                break;
+                            }
+
+                            BenchmarkCapture(count);
+                            break;
+                        }
+
                     case "compare-client-server-requests":
                         {
                             string filename = null;
@@ -162,6 +210,32 @@ namespace DiagnosticsCollector
                         }
                         break;
 
+                    case "metrics":
+                        PrintHotPathMetrics();
+                        break;
+
+                    case "memory":
+                        PrintMemoryUsage();
+                        break;
+
+                    case "startup":
+                        PrintStartupTrace();
+                        break;
+
+                    case "trace":
+                        {
+                            int count = 100;
+
+                            if (commandParts.Length > 1 && !int.TryParse(commandParts[1], out count))
+                            {
+                                Console.WriteLine("Usage: trace [count]");
+                                break;
+                            }
+
+                            PrintTraceEvents(count);
+                            break;
+                        }
+
                     case "help":
                         Help();
                         break;
@@ -182,21 +256,213 @@ namespace DiagnosticsCollector
         static void Help()
         {
             Console.WriteLine("Here are all the available commands:");
-            Console.WriteLine("\tstart-diag [filename]: Use this to start collecting diagnostics information from CloudVeil for Windows");
-            Console.WriteLine("\tstop-diag: Stopts the diagnostic data collection and saves it to the file specified by start-diag");
-            Console.WriteLine("\tload-diag [filename]: Loads diagnostics data from the specified file.");
+            Console.WriteLine("\tstart-diag [directory]: Use this to start collecting diagnostics information from CloudVeil for Windows");
+            Console.WriteLine("\tstop-diag: Stops the diagnostic data collection and loads what was saved to the directory specified by start-diag");
+            Console.WriteLine("\tload-diag [directory or filename]: Loads diagnostics data from a capture directory, or from a SQLite file written by export-diag or older versions.");
+            Console.WriteLine("\texport-diag [filename]: Writes the loaded capture to a SQLite file.");
+            Console.WriteLine("\timport-diag [filename] [directory]: Converts a SQLite diagnostics file into a capture directory.");
+            Console.WriteLine("\tbench-capture [count]: Measures how fast synthetic requests can be captured and how much disk they take.");
             /*Console.WriteLine("\tunexpected-empty-responses: Prints a list of all responses with a content-length of 0 and a status code other than 204");
             Console.WriteLine("\tall-empty-responses: Prints a list of all responses with a content-length of 0, including 204s");
             Console.WriteLine("\terror-responses: Prints a list of all responses which returned an error status.");*/
             Console.WriteLine("\tcompare-client-server-requests: Prints a list of all requests whose client and server sides did not match each other.");
+            Console.WriteLine("\tmetrics: Prints latency percentiles and counters for the filter's hot paths since the service started.");
+            Console.WriteLine("\ttrace [count]: Prints the most recent hot path trace events from the filter service, 100 by default.");
+            Console.WriteLine("\tmemory: Prints the memory each native filtering subsystem holds, its peak and its limits.");
+            Console.WriteLine("\tstartup: Prints when each phase of the filter service's startup ran, what it waited on and which phases held startup up.");
+        }
+
+        static string formatNanoseconds(double nanoseconds)
+        {
+            if (nanoseconds >= 1000000000)
+            {
+                return $"{nanoseconds / 1000000000:0.00}s";
+            }
+            else if (nanoseconds >= 1000000)
+            {
+                return $"{nanoseconds / 1000000:0.00}ms";
+            }
+            else if (nanoseconds >= 1000)
+            {
+                return $"{nanoseconds / 1000:0.00}us";
+            }
+            else
+            {
+                return $"{nanoseconds:0}ns";
+            }
+        }
+
+        static void PrintHotPathMetrics()
+        {
+            HotPathMetricsSnapshot snapshot = null;
+
+            // Not disposed, since a late reply can still set it after we give up waiting.
+            var received = new ManualResetEventSlim(false);
+
+            ipcClient.Request(IpcCall.HotPathMetrics).OnReply((h, msg) =>
+            {
+                snapshot = msg.DataObject as HotPathMetricsSnapshot;
+                received.Set();
+                return true;
+            });
+
+            if (!received.Wait(TimeSpan.FromSeconds(10)))
+            {
+                Console.WriteLine("The filter service did not reply.");
+                return;
+            }
+
+            if (snapshot == null)
+            {
+                Console.WriteLine("The filter service does not collect hot path metrics.");
+                return;
+            }
+
+            Console.WriteLine($"Hot path metrics as of {snapshot.TakenAt}, from {snapshot.Threads} threads:");
+            Console.WriteLine($"\t{"Metric",-16}{"Count",12}{"Mean",12}{"p50",12}{"p90",12}{"p99",12}{"p99.9",12}{"Max",12}");
+
+            for (int i = 0; i < snapshot.Latencies.Length; i++)
+            {
+                LatencySummary latency = snapshot.Latencies[i];
+
+                Console.WriteLine($"\t{(HotPathMetric)i,-16}{latency.Count,12}{formatNanoseconds(latency.MeanNanoseconds),12}" +
+                    $"{formatNanoseconds(latency.P50Nanoseconds),12}{formatNanoseconds(latency.P90Nanoseconds),12}" +
+                    $"{formatNanoseconds(latency.P99Nanoseconds),12}{formatNanoseconds(latency.P999Nanoseconds),12}{formatNanoseconds(latency.MaxNanoseconds),12}");
+            }
+
+            for (int i = 0; i < snapshot.Counters.Length; i++)
+            {
+                Console.WriteLine($"\t{(HotPathCounter)i}: {snapshot.Counters[i]}");
+            }
+        }
+
+        static string formatBytes(long bytes)
+        {
+            if (bytes >= 1024 * 1024)
+            {
+                return $"{bytes / (1024.0 * 1024.0):0.0}MB";
+            }
+            else if (bytes >= 1024)
+            {
+                return $"{bytes / 1024.0:0.0}KB";
+            }
+            else
+            {
+                return $"{bytes}B";
+            }
+        }
+
+        static void PrintMemoryUsage()
+        {
+            MemoryUsageSnapshot usage = null;
+
+            var received = new ManualResetEventSlim(false);
+
+            ipcClient.Request(IpcCall.MemoryUsage).OnReply((h, msg) =>
+            {
+                usage = msg.DataObject as MemoryUsageSnapshot;
+                received.Set();
+                return true;
+            });
+
+            if (!received.Wait(TimeSpan.FromSeconds(10)))
+            {
+                Console.WriteLine("The filter service did not reply.");
+                return;
+            }
+
+            if (usage == null)
+            {
+                Console.WriteLine("The filter service does not account for its native memory.");
+                return;
+            }
+
+            Console.WriteLine($"Memory as of {usage.TakenAt}: {formatBytes(usage.WorkingSetBytes)} working set, {formatBytes(usage.PrivateBytes)} private, {formatBytes(usage.ManagedHeapBytes)} managed heap.");
+            Console.WriteLine($"\t{"Subsystem",-16}{"Live",12}{"Peak",12}{"Soft",12}{"Hard",12}{"Refused",12}{"Forced",12}{"Compactions",12}");
+
+            foreach (MemoryTagUsage tag in usage.Tags)
+            {
+                string soft = tag.SoftLimit > 0 ? formatBytes(tag.SoftLimit) : "-";
+                string hard = tag.HardLimit > 0 ? formatBytes(tag.HardLimit) : "-";
+
+                Console.WriteLine($"\t{tag.Tag,-16}{formatBytes(tag.LiveBytes),12}{formatBytes(tag.PeakBytes),12}{soft,12}{hard,12}{tag.Refused,12}{tag.ForcedOverLimit,12}{tag.Compactions,12}");
+            }
+        }
+
+        static void PrintStartupTrace()
+        {
+            StartupTrace trace = null;
+
+            var received = new ManualResetEventSlim(false);
+
+            ipcClient.Request(IpcCall.StartupTrace).OnReply((h, msg) =>
+            {
+                trace = msg.DataObject as StartupTrace;
+                received.Set();
+                return true;
+            });
+
+            if (!received.Wait(TimeSpan.FromSeconds(10)))
+            {
+                Console.WriteLine("The filter service did not reply.");
+                return;
+            }
+
+            if (trace == null)
+            {
+                Console.WriteLine("The filter service is still starting up.");
+                return;
+            }
+
+            Console.WriteLine($"Startup at {trace.StartedAt}, {trace.SinceProcessStartMs:0} ms after the process started, took {trace.TotalMs:0} ms. Critical phases are marked with *.");
+            Console.WriteLine($"\t{"Phase",-20}{"State",-11}{"Start",10}{"End",10}{"CPU",10}  Waited on");
+
+            foreach (StartupPhaseTiming phase in trace.Phases)
+            {
+                string name = (phase.Critical ? "* " : "  ") + phase.Name;
+
+                Console.WriteLine($"\t{name,-20}{phase.State,-11}{phase.StartMs,8:0}ms{phase.EndMs,8:0}ms{phase.CpuMs,8:0}ms  {phase.WaitedOn ?? "-"}");
+            }
+        }
+
+        static void PrintTraceEvents(int count)
+        {
+            List<string> events = null;
+
+            var received = new ManualResetEventSlim(false);
+
+            ipcClient.Request(IpcCall.TraceEvents, count).OnReply((h, msg) =>
+            {
+                events = msg.DataObject as List<string>;
+                received.Set();
+                return true;
+            });
+
+            if (!received.Wait(TimeSpan.FromSeconds(10)))
+            {
+                Console.WriteLine("The filter service did not reply.");
+                return;
+            }
+
+            if (events == null || events.Count == 0)
+            {
+                Console.WriteLine("The filter service has no trace events.");
+                return;
+            }
+
+            foreach (string line in events)
+            {
+                Console.WriteLine($"\t{line}");
+            }
         }
 
         private static SqliteParameter getParameter(string name, object value) => new SqliteParameter(name, value ?? DBNull.Value);
 
-        static void AddDiagnosticsEntryV1(SqliteConnection connection, DiagnosticsInfoV1 info)
+        static void AddDiagnosticsEntryV1(SqliteConnection connection, DiagnosticsInfoV1 info, SqliteTransaction transaction = null)
         {
             using (SqliteCommand command = connection.CreateCommand())
             {
+                command.Transaction = transaction;
                 command.CommandText = "INSERT INTO diagnostics (client_request_body, server_request_body, client_request_headers," +
                         "server_request_headers, client_request_uri, server_request_uri, server_response_body, server_response_headers," +
                         "status_code, date_started, date_ended, host, request_uri, diagnostics_type) VALUES" +
@@ -216,20 +482,45 @@ namespace DiagnosticsCollector
                 command.Parameters.Add(getParameter("$date_started", info.DateStarted.ToString("o")));
                 command.Parameters.Add(getParameter("$date_ended", info.DateEnded.ToString("o")));
                 command.Parameters.Add(getParameter("$host", info.Host));
-                command.Parameters.Add(getParameter("$request_uri", info.RequestUri));
+                command.Parameters.Add(getParameter("$request_uri", info.RequestUri?.ToString()));
                 command.Parameters.Add(getParameter("$diagnostics_type", info.DiagnosticsType));
 
                 command.ExecuteNonQuery();
             }
         }
 
+        // Loaded diagnostics, either a capture directory or a SQLite file. Only one is set at a time.
+        static CaptureReader currentCapture = null;
         static SqliteConnection currentConnection = null;
+
+        static CaptureWriter captureWriter = null;
+
         static void StartDiagnostics(string filename)
         {
-            ipcClient.SendDiagnosticsEnable(true);
+            if (captureWriter != null)
+            {
+                Console.WriteLine("Diagnostics are already being collected. Use stop-diag first.");
+                return;
+            }
+
+            if (filename == null)
+            {
+                filename = $"diag-{DateTime.Now.ToString("dd-MM-yyyy-hh-mm-ss")}";
+            }
 
-            SqliteConnection connection = GetDiagnosticsSqlConnection(filename);
-            currentConnection = connection;
+            CaptureWriter writer;
+
+            try
+            {
+                writer = new CaptureWriter(filename);
+            }
+            catch (Exception ex)
+            {
+                Console.WriteLine("Failed to start diagnostics: {0}", ex.Message);
+                return;
+            }
+
+            captureWriter = writer;
 
             ipcClient.OnDiagnosticsInfo = (msg) =>
             {
@@ -238,36 +529,355 @@ namespace DiagnosticsCollector
                     case CloudVeil.IPC.Messages.DiagnosticsVersion.V1:
                         var info = msg.Info as CloudVeil.IPC.Messages.DiagnosticsInfoV1;
 
-                        AddDiagnosticsEntryV1(connection, info);
+                        try
+                        {
+                            writer.Append(info);
+                        }
+                        catch (IOException ex)
+                        {
+                            Console.WriteLine("Diagnostics collection stopped: {0}", ex.InnerException?.Message ?? ex.Message);
+                            StopDiagnostics();
+                        }
 
                         break;
                 }
             };
+
+            ipcClient.SendDiagnosticsEnable(true);
+            Console.WriteLine($"Collecting diagnostics into {Path.GetFullPath(filename)}");
         }
 
-        static void StopDiagnostics()
+        /// <returns>The directory diagnostics were being collected into, or null if they weren't being collected.</returns>
+        static string StopDiagnostics()
         {
             ipcClient.SendDiagnosticsEnable(false);
             ipcClient.OnDiagnosticsInfo = null;
+
+            CaptureWriter writer = Interlocked.Exchange(ref captureWriter, null);
+
+            if (writer == null)
+            {
+                return null;
+            }
+
+            writer.Dispose();
+
+            if (writer.Failure != null)
+            {
+                Console.WriteLine("Some diagnostics could not be saved: {0}", writer.Failure.Message);
+            }
+
+            Console.WriteLine($"Saved {writer.RecordsWritten} requests to {writer.CaptureDirectory} ({formatMegabytes(writer.BytesWritten)}).");
+            return writer.CaptureDirectory;
         }
 
         static void LoadDiagnostics(string filename)
         {
-            if(!File.Exists(filename))
+            try
+            {
+                if (Directory.Exists(filename))
+                {
+                    CaptureReader reader = new CaptureReader(filename);
+
+                    unloadDiagnostics();
+                    currentCapture = reader;
+
+                    Console.WriteLine($"Diagnostics loaded: {reader.Count} requests in {reader.SegmentCount} segments.");
+
+                    if (reader.RecoveredSegmentCount > 0)
+                    {
+                        Console.WriteLine($"{reader.RecoveredSegmentCount} segments were not closed properly. Loaded everything up to where they stopped.");
+                    }
+                }
+                else if (File.Exists(filename))
+                {
+                    SqliteConnection connection = GetDiagnosticsSqlConnection(filename, false);
+
+                    unloadDiagnostics();
+                    currentConnection = connection;
+
+                    Console.WriteLine("Diagnostics loaded");
+                }
+                else
+                {
+                    Console.WriteLine($"File '{filename}' does not exist.");
+                }
+            }
+            catch (Exception ex)
+            {
+                Console.WriteLine("Failed to load diagnostics: {0}", ex);
+            }
+        }
+
+        static void unloadDiagnostics()
+        {
+            currentCapture?.Dispose();
+            currentCapture = null;
+
+            currentConnection?.Dispose();
+            currentConnection = null;
+        }
+
+        /// <summary>
+        /// Every request in the loaded diagnostics. Requests from a SQLite file only have their request headers and client URI.
+        /// </summary>
+        static IEnumerable<DiagnosticsInfoV1> loadedRequests()
+        {
+            if (currentCapture != null)
+            {
+                foreach (DiagnosticsInfoV1 info in currentCapture.Records())
+                {
+                    yield return info;
+                }
+
+                yield break;
+            }
+
+            if (currentConnection == null)
+            {
+                throw new InvalidOperationException("No diagnostics are loaded. Use load-diag first.");
+            }
+
+            using (SqliteCommand command = currentConnection.CreateCommand())
+            {
+                command.CommandText = "SELECT client_request_headers, server_request_headers, client_request_uri FROM diagnostics;";
+
+                using (SqliteDataReader reader = command.ExecuteReader())
+                {
+                    while (reader.Read())
+                    {
+                        yield return new DiagnosticsInfoV1()
+                        {
+                            ClientRequestHeaders = readText(reader, 0),
+                            ServerRequestHeaders = readText(reader, 1),
+                            ClientRequestUri = readText(reader, 2)
+                        };
+                    }
+                }
+            }
+        }
+
+        static void ExportDiagnostics(string filename)
+        {
+            if (currentCapture == null)
+            {
+                Console.WriteLine("Load a capture directory with load-diag first.");
+                return;
+            }
+
+            try
+            {
+                int count = 0;
+
+                using (SqliteConnection connection = GetDiagnosticsSqlConnection(filename))
+                using (SqliteTransaction transaction = connection.BeginTransaction())
+                {
+                    foreach (DiagnosticsInfoV1 info in currentCapture.Records())
+                    {
+                        AddDiagnosticsEntryV1(connection, info, transaction);
+                        count++;
+                    }
+
+                    transaction.Commit();
+                }
+
+                Console.WriteLine($"Exported {count} requests to {filename}.");
+            }
+            catch (Exception ex)
+            {
+                Console.WriteLine("Failed to export diagnostics: {0}", ex);
+            }
+        }
+
+        static void ImportDiagnostics(string filename, string directory)
+        {
+            if (!File.Exists(filename))
             {
                 Console.WriteLine($"File '{filename}' does not exist.");
+                return;
+            }
+
+            if (directory == null)
+            {
+                directory = Path.Combine(Path.GetDirectoryName(Path.GetFullPath(filename)), Path.GetFileNameWithoutExtension(filename) + "-capture");
             }
 
             try
             {
-                SqliteConnection connection = GetDiagnosticsSqlConnection(filename, false);
-                currentConnection = connection;
-                Console.WriteLine("Diagnostics loaded");
+                CaptureWriter writer;
+
+                using (SqliteConnection connection = GetDiagnosticsSqlConnection(filename, false))
+                using (writer = new CaptureWriter(directory))
+                using (SqliteCommand command = connection.CreateCommand())
+                {
+                    command.CommandText = "SELECT client_request_body, server_request_body, client_request_headers, server_request_headers, " +
+                        "client_request_uri, server_request_uri, server_response_body, server_response_headers, status_code, date_started, " +
+                        "date_ended, host, request_uri, diagnostics_type FROM diagnostics;";
 
+                    using (SqliteDataReader reader = command.ExecuteReader())
+                    {
+                        while (reader.Read())
+                        {
+                            Uri requestUri;
+                            Uri.TryCreate(readText(reader, 12), UriKind.RelativeOrAbsolute, out requestUri);
+
+                            writer.Append(new DiagnosticsInfoV1()
+                            {
+                                ClientRequestBody = readBlob(reader, 0),
+                                ServerRequestBody = readBlob(reader, 1),
+                                ClientRequestHeaders = readText(reader, 2),
+                                ServerRequestHeaders = readText(reader, 3),
+                                ClientRequestUri = readText(reader, 4),
+                                ServerRequestUri = readText(reader, 5),
+                                ServerResponseBody = readBlob(reader, 6),
+                                ServerResponseHeaders = readText(reader, 7),
+                                StatusCode = reader.IsDBNull(8) ? 0 : reader.GetInt32(8),
+                                DateStarted = readDate(reader, 9),
+                                DateEnded = readDate(reader, 10),
+                                Host = readText(reader, 11),
+                                RequestUri = requestUri,
+                                DiagnosticsType = reader.IsDBNull(13) ? DiagnosticsType.RequestSession : (DiagnosticsType)reader.GetInt32(13)
+                            });
+                        }
+                    }
+                }
+
+                if (writer.Failure != null)
+                {
+                    Console.WriteLine("Failed to import diagnostics: {0}", writer.Failure);
+                    return;
+                }
+
+                Console.WriteLine($"Imported {writer.RecordsWritten} requests into {directory}.");
             }
             catch (Exception ex)
             {
-                Console.WriteLine("Failed to load diagnostics: {0}", ex);
+                Console.WriteLine("Failed to import diagnostics: {0}", ex);
+            }
+        }
+
+        // Older files have text in some BLOB columns and the other way round, so both come back either way.
+        static string readText(SqliteDataReader reader, int ordinal)
+        {
+            if (reader.IsDBNull(ordinal))
+            {
+                return null;
+            }
+
+            object value = reader.GetValue(ordinal);
+            byte[] bytes = value as byte[];
+
+            return bytes != null ? Encoding.UTF8.GetString(bytes) : value.ToString();
+        }
+
+        static byte[] readBlob(SqliteDataReader reader, int ordinal)
+        {
+            if (reader.IsDBNull(ordinal))
+            {
+                return null;
+            }
+
+            object value = reader.GetValue(ordinal);
+            return value as byte[] ?? Encoding.UTF8.GetBytes(value.ToString());
+        }
+
+        static DateTime readDate(SqliteDataReader reader, int ordinal)
+        {
+            DateTime date;
+            DateTime.TryParse(readText(reader, ordinal), CultureInfo.InvariantCulture, DateTimeStyles.RoundtripKind, out date);
+            return date;
+        }
+
+        static string formatMegabytes(long bytes)
+        {
+            return $"{bytes / (1024.0 * 1024.0):0.0} MB";
+        }
+
+        /// <summary>
+        /// Captures synthetic requests as fast as the store takes them, then writes some of the same requests one INSERT
+        /// at a time the way older versions of this collector did, for comparison.
+        /// </summary>
+        static void BenchmarkCapture(int count)
+        {
+            if (count <= 0)
+            {
+                Console.WriteLine("bench-capture needs a positive count.");
+                return;
+            }
+
+            var traffic = new SyntheticTraffic();
+            var requests = new List<DiagnosticsInfoV1>(count);
+            long payloadBytes = 0;
+
+            for (int i = 0; i < count; i++)
+            {
+                DiagnosticsInfoV1 info = traffic.Next();
+                requests.Add(info);
+
+                payloadBytes += info.ServerResponseBody.Length + info.ClientRequestHeaders.Length +
+                    info.ServerRequestHeaders.Length + info.ServerResponseHeaders.Length;
+            }
+
+            string directory = Path.Combine(Path.GetTempPath(), $"capture-bench-{Guid.NewGuid():N}");
+            string sqliteFile = directory + ".sqlite";
+
+            try
+            {
+                Stopwatch stopwatch = Stopwatch.StartNew();
+
+                CaptureWriter writer;
+                using (writer = new CaptureWriter(directory))
+                {
+                    foreach (DiagnosticsInfoV1 info in requests)
+                    {
+                        writer.Append(info);
+                    }
+                }
+
+                stopwatch.Stop();
+
+                double seconds = stopwatch.Elapsed.TotalSeconds;
+                Console.WriteLine($"Capture store: {count} requests ({formatMegabytes(payloadBytes)}) in {seconds:0.00}s, " +
+                    $"{count / seconds:0} requests/s, {payloadBytes / seconds / (1024 * 1024):0.0} MB/s");
+                Console.WriteLine($"	on disk {formatMegabytes(writer.BytesWritten)}, {writer.BytesWritten / count} bytes per request, " +
+                    $"{(double)payloadBytes / writer.BytesWritten:0.00}x smaller than the payload");
+
+                // Without a transaction every INSERT is its own journal commit, so a sample is plenty.
+                int sqliteCount = Math.Min(count, 1000);
+
+                stopwatch.Restart();
+
+                using (SqliteConnection connection = GetDiagnosticsSqlConnection(sqliteFile))
+                {
+                    for (int i = 0; i < sqliteCount; i++)
+                    {
+                        AddDiagnosticsEntryV1(connection, requests[i]);
+                    }
+                }
+
+                stopwatch.Stop();
+
+                seconds = stopwatch.Elapsed.TotalSeconds;
+                long sqliteBytes = new FileInfo(sqliteFile).Length;
+
+                Console.WriteLine($"SQLite, one INSERT per request: {sqliteCount} requests in {seconds:0.00}s, {sqliteCount / seconds:0} requests/s");
+                Console.WriteLine($"	on disk {formatMegabytes(sqliteBytes)}, {sqliteBytes / sqliteCount} bytes per request");
+            }
+            catch (Exception ex)
+            {
+                Console.WriteLine("Benchmark failed: {0}", ex);
+            }
+            finally
+            {
+                if (Directory.Exists(directory))
+                {
+                    Directory.Delete(directory, true);
+                }
+
+                if (File.Exists(sqliteFile))
+                {
+                    File.Delete(sqliteFile);
+                }
             }
         }
 
@@ -288,42 +898,30 @@ namespace DiagnosticsCollector
 
                 List<HeaderComparisons> comparisonResults = new List<HeaderComparisons>();
 
-                using (SqliteCommand command = currentConnection.CreateCommand())
+                foreach (DiagnosticsInfoV1 info in loadedRequests())
                 {
-                    command.CommandText = "SELECT client_request_headers, server_request_headers, client_request_uri FROM diagnostics;";
+                    var clientHeaderList = HeaderParser.Parse(info.ClientRequestHeaders);
+                    var serverHeaderList = HeaderParser.Parse(info.ServerRequestHeaders);
 
-                    using (SqliteDataReader reader = command.ExecuteReader())
+                    if (clientHeaderList == null || serverHeaderList == null)
                     {
-                        while (reader.Read())
+                        comparisonResults.Add(new HeaderComparisons()
                         {
-                            string clientHeaders = reader.IsDBNull(0) ? null : reader.GetString(0);
-                            string serverHeaders = reader.IsDBNull(1) ? null : reader.GetString(1);
-                            string clientUri = reader.IsDBNull(2) ? null : reader.GetString(2);
-
-                            var clientHeaderList = HeaderParser.Parse(clientHeaders);
-                            var serverHeaderList = HeaderParser.Parse(serverHeaders);
-
-                            if (clientHeaderList == null || serverHeaderList == null)
-                            {
-                                comparisonResults.Add(new HeaderComparisons()
-                                {
-                                    Uri = clientUri,
-                                    Comparisons = null
-                                });
-                            }
-                            else
-                            {
-                                var headerComparisonResults = HeaderParser.Compare(clientHeaderList, serverHeaderList);
+                            Uri = info.ClientRequestUri,
+                            Comparisons = null
+                        });
+                    }
+                    else
+                    {
+                        var headerComparisonResults = HeaderParser.Compare(clientHeaderList, serverHeaderList);
 
-                                var headerComparisons = new HeaderComparisons()
-                                {
-                                    Uri = clientUri,
-                                    Comparisons = headerComparisonResults
-                                };
+                        var headerComparisons = new HeaderComparisons()
+                        {
+                            Uri = info.ClientRequestUri,
+                            Comparisons = headerComparisonResults
+                        };
 
-                                comparisonResults.Add(headerComparisons);
-                            }
-                        }
+                        comparisonResults.Add(headerComparisons);
                     }
                 }
 
@@ -0,0 +1,72 @@
+#include "ExemptionTable.h"
+#include "CertificateExemptionIndex.h"
+
+#include <vcclr.h>
+
+namespace FilterNativeWindows {
+    static unsigned long long hashHost(String^ host) {
+        pin_ptr<const wchar_t> chars = PtrToStringChars(host);
+        return ExemptionTable::HashHost(chars, (size_t)host->Length);
+    }
+
+    static long long toTicks(DateTime time) {
+        return time == DateTime::MaxValue ? EXEMPTION_NEVER_EXPIRES : time.ToUniversalTime().Ticks;
+    }
+
+    CertificateExemptionIndex::CertificateExemptionIndex() {
+        table = new ExemptionTable();
+    }
+
+    CertificateExemptionIndex::~CertificateExemptionIndex() {
+        this->!CertificateExemptionIndex();
+    }
+
+    CertificateExemptionIndex::!CertificateExemptionIndex() {
+        if (table != NULL) {
+            delete table;
+            table = NULL;
+        }
+    }
+
+    bool CertificateExemptionIndex::IsExempted(array<Byte>^ thumbprint, String^ host, DateTime nowUtc) {
+        if (thumbprint == nullptr) {
+            throw gcnew ArgumentNullException("thumbprint");
+        }
+
+        if (host == nullptr) {
+            throw gcnew ArgumentNullException("host");
+        }
+
+        if (thumbprint->Length == 0) {
+            return false;
+        }
+
+        unsigned long long hostHash = hashHost(host);
+
+        pin_ptr<Byte> pinnedThumbprint = &thumbprint[0];
+        return table->IsExempted(pinnedThumbprint, (size_t)thumbprint->Length, hostHash, toTicks(nowUtc));
+    }
+
+    bool CertificateExemptionIndex::Set(array<Byte>^ thumbprint, String^ host, DateTime expiresUtc) {
+        if (thumbprint == nullptr) {
+            throw gcnew ArgumentNullException("thumbprint");
+        }
+
+        if (host == nullptr) {
+            throw gcnew ArgumentNullException("host");
+        }
+
+        if (thumbprint->Length == 0) {
+            return false;
+        }
+
+        unsigned long long hostHash = hashHost(host);
+
+        pin_ptr<Byte> pinnedThumbprint = &thumbprint[0];
+        return table->Set(pinnedThumbprint, (size_t)thumbprint->Length, hostHash, toTicks(expiresUtc));
+    }
+
+    int CertificateExemptionIndex::Count::get() {
+        return (int)table->Count();
+    }
+}
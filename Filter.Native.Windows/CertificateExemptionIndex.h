@@ -0,0 +1,36 @@
+#pragma once
+
+class ExemptionTable;
+
+using namespace System;
+
+namespace FilterNativeWindows {
+    /// <summary>
+    /// Certificates the user has chosen to trust for particular hosts, kept in native memory so that TLS handshakes can
+    /// check them without taking a lock. Checks can run on any number of threads at once, including while Set() runs.
+    /// </summary>
+    public ref class CertificateExemptionIndex {
+    public:
+        CertificateExemptionIndex();
+        ~CertificateExemptionIndex();
+        !CertificateExemptionIndex();
+
+        /// <param name="thumbprint">The certificate's hash, as returned by X509Certificate.GetCertHash().</param>
+        /// <param name="nowUtc">Exemptions that expire at or before this time don't count.</param>
+        bool IsExempted(array<Byte>^ thumbprint, String^ host, DateTime nowUtc);
+
+        /// <summary>
+        /// Adds an exemption, or moves the expiry of an existing one. Use DateTime.MaxValue for one that never expires,
+        /// and any past time to revoke one.
+        /// </summary>
+        /// <returns>False if the thumbprint is empty or longer than any hash the index keys on.</returns>
+        bool Set(array<Byte>^ thumbprint, String^ host, DateTime expiresUtc);
+
+        property int Count {
+            int get();
+        }
+
+    private:
+        ExemptionTable* table;
+    };
+}
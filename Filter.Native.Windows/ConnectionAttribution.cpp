@@ -0,0 +1,500 @@
+#include "ConnectionAttribution.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cwctype>
+#include <mutex>
+#include <unordered_map>
+
+namespace {
+    typedef struct Connection {
+        // Zero while the owner isn't known.
+        unsigned int pid;
+
+        bool redirected;
+
+        // Whether the last table read had the port.
+        bool inTable;
+
+        // The last read that had the port, or the redirect, whichever came later.
+        unsigned long long seenUs;
+        unsigned long long readSequence;
+    } Connection;
+
+    typedef struct Process {
+        unsigned long long startTime;
+
+        // The image's file name, lowercased and without ".exe", which is what rules are matched
+        // against.
+        std::wstring name;
+
+        int verdict;
+
+        // The policy the verdict was worked out with. Zero for none yet.
+        unsigned long long policyGeneration;
+
+        bool announced;
+
+        // Queried at least once, so the fields above mean something. Until then its connections
+        // miss.
+        bool identified;
+
+        bool checked;
+        unsigned long long checkedUs;
+
+        // The PID may have been given to another process since it was last checked. Its
+        // connections miss until the query running for it says which process it is now.
+        bool suspect;
+
+        unsigned long long seenUs;
+
+        // The last read with a row for it, and the read with a row for it before that.
+        unsigned long long rowSequence;
+        unsigned long long previousRowSequence;
+
+        // The last read in which it still had a row it had in the read before.
+        unsigned long long carriedSequence;
+    } Process;
+
+    typedef struct QueryResult {
+        unsigned int pid;
+        bool succeeded;
+        unsigned long long startTime;
+        std::wstring imagePath;
+    } QueryResult;
+
+    std::wstring lowercase(const std::wstring& text) {
+        std::wstring lowered(text);
+
+        for (size_t i = 0; i < lowered.size(); i++) {
+            lowered[i] = (wchar_t)towlower(lowered[i]);
+        }
+
+        return lowered;
+    }
+
+    // Removes every ".exe" from text, which is already lowercased.
+    void removeExe(std::wstring& text) {
+        for (size_t found = text.find(L".exe"); found != std::wstring::npos; found = text.find(L".exe", found)) {
+            text.erase(found, 4);
+        }
+    }
+
+    // The file name of a full image path, lowercased and without ".exe", like the process names the
+    // application rules were matched against before.
+    std::wstring processName(const std::wstring& imagePath) {
+        size_t separator = imagePath.find_last_of(L"\\/");
+        std::wstring name = lowercase(separator == std::wstring::npos ? imagePath : imagePath.substr(separator + 1));
+
+        if (name.size() >= 4 && name.compare(name.size() - 4, 4, L".exe") == 0) {
+            name.resize(name.size() - 4);
+        }
+
+        return name;
+    }
+}
+
+struct ConnectionAttribution::Impl {
+    AttributionBackend* backend;
+
+    unsigned long long graceUs;
+    unsigned long long recheckUs;
+
+    mutable std::mutex lock;
+
+    // Signalled when a miss asks for a read.
+    std::condition_variable missed;
+    bool readWanted;
+
+    std::unordered_map<unsigned short, Connection> connections;
+    std::unordered_map<unsigned int, Process> processes;
+
+    std::vector<std::wstring> patterns;
+    std::vector<int> verdicts;
+    unsigned long long policyGeneration;
+
+    bool refreshing;
+    unsigned long long readSequence;
+
+    ConnectionAttributionStats stats;
+
+    // Counts a miss and asks for a read. Called with the lock held.
+    void miss() {
+        stats.misses++;
+
+        if (readWanted) {
+            stats.coalescedRefreshes++;
+            return;
+        }
+
+        readWanted = true;
+        missed.notify_one();
+    }
+
+    int verdictFor(const std::wstring& name) const {
+        int verdict = APP_VERDICT_FILTER;
+
+        for (size_t i = 0; i < patterns.size(); i++) {
+            if (verdicts[i] > verdict && name.find(patterns[i]) != std::wstring::npos) {
+                verdict = verdicts[i];
+            }
+        }
+
+        return verdict;
+    }
+
+    // Fills in the owner of the connection on localPort if the port and its process are both known.
+    // Called with the lock held.
+    bool resolve(unsigned short localPort, ConnectionOwner* owner) {
+        owner->verdict = APP_VERDICT_UNKNOWN;
+        owner->pid = 0;
+        owner->processStartTime = 0;
+        owner->firstConnection = false;
+
+        std::unordered_map<unsigned short, Connection>::iterator connection = connections.find(localPort);
+        if (connection == connections.end() || connection->second.pid == 0) {
+            return false;
+        }
+
+        std::unordered_map<unsigned int, Process>::iterator found = processes.find(connection->second.pid);
+        if (found == processes.end() || !found->second.identified || found->second.suspect) {
+            return false;
+        }
+
+        Process& process = found->second;
+
+        if (process.policyGeneration != policyGeneration) {
+            process.verdict = verdictFor(process.name);
+            process.policyGeneration = policyGeneration;
+            process.announced = false;
+        }
+
+        owner->verdict = process.verdict;
+        owner->pid = connection->second.pid;
+        owner->processStartTime = process.startTime;
+        owner->firstConnection = !process.announced;
+
+        process.announced = true;
+        return true;
+    }
+
+    // Applies a table read and lists the PIDs whose process has to be queried. Called with the lock
+    // held.
+    void apply(const std::vector<TcpOwnerRow>& rows, unsigned long long nowUs, std::vector<unsigned int>& toQuery) {
+        readSequence++;
+
+        stats.refreshes++;
+        stats.rowsRead += rows.size();
+
+        for (size_t i = 0; i < rows.size(); i++) {
+            const TcpOwnerRow& row = rows[i];
+
+            // Connections in TIME_WAIT and the like have no owner left.
+            if (row.pid == 0) {
+                continue;
+            }
+
+            std::pair<std::unordered_map<unsigned short, Connection>::iterator, bool> added =
+                connections.insert(std::make_pair(row.localPort, Connection()));
+
+            Connection& connection = added.first->second;
+
+            if (added.second) {
+                connection.redirected = false;
+            }
+
+            bool carried = !added.second && connection.pid == row.pid && connection.readSequence + 1 == readSequence;
+
+            connection.pid = row.pid;
+            connection.inTable = true;
+            connection.seenUs = nowUs;
+            connection.readSequence = readSequence;
+
+            std::unordered_map<unsigned int, Process>::iterator found = processes.find(row.pid);
+
+            if (found == processes.end()) {
+                found = processes.insert(std::make_pair(row.pid, Process())).first;
+            }
+
+            Process& process = found->second;
+
+            if (process.rowSequence != readSequence) {
+                process.previousRowSequence = process.rowSequence;
+                process.rowSequence = readSequence;
+            }
+
+            if (carried) {
+                process.carriedSequence = readSequence;
+            }
+
+            process.seenUs = nowUs;
+        }
+
+        for (std::unordered_map<unsigned short, Connection>::iterator i = connections.begin(); i != connections.end();) {
+            Connection& connection = i->second;
+
+            if (connection.readSequence == readSequence) {
+                ++i;
+                continue;
+            }
+
+            connection.inTable = false;
+
+            if (connection.seenUs + graceUs <= nowUs) {
+                i = connections.erase(i);
+                stats.evictedConnections++;
+            }
+            else {
+                ++i;
+            }
+        }
+
+        for (std::unordered_map<unsigned int, Process>::iterator i = processes.begin(); i != processes.end();) {
+            Process& process = i->second;
+
+            if (process.rowSequence == readSequence) {
+                // Windows only hands a PID out again once the process that had it is gone, and its
+                // connections with it. So a PID that had no rows in the read before, or whose rows
+                // are all new, may be another process now, and is checked before it is trusted.
+                bool returned = process.previousRowSequence + 1 < readSequence;
+                bool replaced = process.previousRowSequence + 1 == readSequence && process.carriedSequence != readSequence;
+
+                if (process.checked && (returned || replaced)) {
+                    process.suspect = true;
+                }
+
+                if (!process.checked || process.suspect || process.checkedUs + recheckUs <= nowUs) {
+                    toQuery.push_back(i->first);
+                }
+
+                ++i;
+            }
+            else if (process.seenUs + graceUs <= nowUs) {
+                i = processes.erase(i);
+                stats.evictedProcesses++;
+            }
+            else {
+                ++i;
+            }
+        }
+    }
+
+    // Records what the process queries found. Called with the lock held.
+    void identify(const std::vector<QueryResult>& results, unsigned long long nowUs) {
+        for (size_t i = 0; i < results.size(); i++) {
+            const QueryResult& result = results[i];
+
+            stats.processQueries++;
+
+            std::unordered_map<unsigned int, Process>::iterator found = processes.find(result.pid);
+
+            // Evicted while it was being queried.
+            if (found == processes.end()) {
+                continue;
+            }
+
+            Process& process = found->second;
+            process.checked = true;
+            process.checkedUs = nowUs;
+
+            bool suspect = process.suspect;
+            process.suspect = false;
+
+            if (!result.succeeded) {
+                stats.processQueryFailures++;
+
+                // Protected processes can't be opened. They keep the identity they had unless the
+                // PID may have changed hands, and otherwise get an empty one that no rule matches,
+                // so that their connections are attributed rather than missed again.
+                if (!process.identified || suspect) {
+                    process.identified = true;
+                    process.startTime = 0;
+                    process.name.clear();
+                    process.policyGeneration = 0;
+                    process.announced = false;
+                }
+
+                continue;
+            }
+
+            if (!process.identified || process.startTime != result.startTime) {
+                // A new process, or a PID that was reused.
+                process.identified = true;
+                process.startTime = result.startTime;
+                process.name = processName(result.imagePath);
+                process.policyGeneration = 0;
+                process.announced = false;
+            }
+        }
+    }
+};
+
+ConnectionAttribution::ConnectionAttribution(AttributionBackend* backend, unsigned long long graceUs, unsigned long long recheckUs) {
+    impl = new Impl();
+
+    impl->backend = backend;
+    impl->graceUs = graceUs;
+    impl->recheckUs = recheckUs;
+
+    impl->readWanted = false;
+    impl->policyGeneration = 1;
+
+    impl->refreshing = false;
+    impl->readSequence = 0;
+
+    impl->stats = ConnectionAttributionStats();
+}
+
+ConnectionAttribution::~ConnectionAttribution() {
+    delete impl;
+}
+
+void ConnectionAttribution::SetPolicy(const std::vector<std::wstring>& patterns, const std::vector<int>& verdicts) {
+    std::vector<std::wstring> normalized;
+    std::vector<int> kept;
+
+    for (size_t i = 0; i < patterns.size() && i < verdicts.size(); i++) {
+        std::wstring pattern = lowercase(patterns[i]);
+        removeExe(pattern);
+
+        if (pattern.empty()) {
+            continue;
+        }
+
+        normalized.push_back(pattern);
+        kept.push_back(verdicts[i]);
+    }
+
+    std::lock_guard<std::mutex> guard(impl->lock);
+
+    impl->patterns.swap(normalized);
+    impl->verdicts.swap(kept);
+
+    // Zero means no verdict yet, so the generation skips it when it wraps.
+    if (++impl->policyGeneration == 0) {
+        impl->policyGeneration = 1;
+    }
+}
+
+ConnectionOwner ConnectionAttribution::OnRedirect(unsigned short localPort, unsigned long long nowUs) {
+    ConnectionOwner owner;
+
+    std::lock_guard<std::mutex> guard(impl->lock);
+
+    impl->stats.redirects++;
+
+    std::pair<std::unordered_map<unsigned short, Connection>::iterator, bool> added =
+        impl->connections.insert(std::make_pair(localPort, Connection()));
+
+    Connection& connection = added.first->second;
+
+    if (added.second) {
+        connection.pid = 0;
+        connection.inTable = false;
+        connection.readSequence = 0;
+    }
+    else if (connection.redirected) {
+        // The port went back to the system and a new connection has it. Whatever a read says about
+        // it may still be the old connection, so it waits for a new one.
+        impl->stats.portReuses++;
+        connection.pid = 0;
+        connection.inTable = false;
+    }
+    else if (!connection.inTable) {
+        // Only kept for the grace period, so the owner is from a connection that has closed.
+        connection.pid = 0;
+    }
+
+    connection.redirected = true;
+    connection.seenUs = nowUs;
+
+    if (impl->resolve(localPort, &owner)) {
+        impl->stats.hits++;
+    }
+    else {
+        impl->miss();
+    }
+
+    return owner;
+}
+
+bool ConnectionAttribution::Lookup(unsigned short localPort, ConnectionOwner* owner) {
+    std::lock_guard<std::mutex> guard(impl->lock);
+
+    impl->stats.lookups++;
+
+    if (impl->resolve(localPort, owner)) {
+        impl->stats.hits++;
+        return true;
+    }
+
+    impl->miss();
+    return false;
+}
+
+bool ConnectionAttribution::WaitForMiss(unsigned int timeoutMs) {
+    std::unique_lock<std::mutex> guard(impl->lock);
+
+    if (!impl->readWanted && timeoutMs > 0) {
+        impl->missed.wait_for(guard, std::chrono::milliseconds(timeoutMs));
+    }
+
+    bool wanted = impl->readWanted;
+    impl->readWanted = false;
+
+    return wanted;
+}
+
+void ConnectionAttribution::OnClosed(unsigned short localPort) {
+    std::lock_guard<std::mutex> guard(impl->lock);
+
+    if (impl->connections.erase(localPort) > 0) {
+        impl->stats.evictedConnections++;
+    }
+}
+
+ConnectionAttributionStats ConnectionAttribution::Stats() const {
+    std::lock_guard<std::mutex> guard(impl->lock);
+
+    ConnectionAttributionStats stats = impl->stats;
+    stats.connections = impl->connections.size();
+    stats.processes = impl->processes.size();
+
+    return stats;
+}
+
+void ConnectionAttribution::Refresh(unsigned long long nowUs) {
+    {
+        std::lock_guard<std::mutex> guard(impl->lock);
+
+        if (impl->refreshing) {
+            impl->stats.coalescedRefreshes++;
+            return;
+        }
+
+        impl->refreshing = true;
+    }
+
+    std::vector<TcpOwnerRow> rows;
+    std::vector<unsigned int> toQuery;
+
+    bool read = impl->backend->ReadTcpTable(rows);
+
+    if (read) {
+        std::lock_guard<std::mutex> guard(impl->lock);
+        impl->apply(rows, nowUs, toQuery);
+    }
+
+    std::vector<QueryResult> results(toQuery.size());
+
+    for (size_t i = 0; i < toQuery.size(); i++) {
+        results[i].pid = toQuery[i];
+        results[i].startTime = 0;
+        results[i].succeeded = impl->backend->QueryProcess(toQuery[i], &results[i].startTime, results[i].imagePath);
+    }
+
+    std::lock_guard<std::mutex> guard(impl->lock);
+
+    impl->identify(results, nowUs);
+    impl->refreshing = false;
+}
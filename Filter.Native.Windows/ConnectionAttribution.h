@@ -0,0 +1,144 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// What the application policy says about the process behind a connection, from least to most
+// restrictive. A process that several rules match gets the most restrictive of them.
+#define APP_VERDICT_UNKNOWN 0
+#define APP_VERDICT_FILTER 1
+#define APP_VERDICT_WHITELISTED 2
+#define APP_VERDICT_BLACKLISTED 3
+#define APP_VERDICT_BLOCKED 4
+
+// How long a port the TCP table hasn't shown yet, or no longer shows, is kept. Covers a redirect
+// that comes in before its row is visible, and a lookup that comes in just after the connection
+// closed.
+#define ATTRIBUTION_DEFAULT_GRACE_US (2 * 1000 * 1000)
+
+// Least time between two reads of the TCP table on a miss. Misses within it wait for the next
+// read, so that a burst of new connections costs one read rather than one each.
+#define ATTRIBUTION_DEFAULT_MIN_REFRESH_US (5 * 1000)
+
+// How often the table is read when nothing misses, to evict closed connections and recheck
+// processes.
+#define ATTRIBUTION_DEFAULT_IDLE_REFRESH_MS 1000
+
+// How long a process identity is trusted before it is checked again, in case the PID was reused.
+#define ATTRIBUTION_DEFAULT_RECHECK_US (30 * 1000 * 1000)
+
+typedef struct TcpOwnerRow {
+    unsigned short localPort;
+    unsigned int pid;
+} TcpOwnerRow;
+
+/// What ConnectionAttribution needs from the OS. The Windows one is WindowsAttributionBackend in
+/// ConnectionOwners.h; anything else can stand in for it to replay synthetic connections.
+class AttributionBackend {
+public:
+    virtual ~AttributionBackend() {}
+
+    /// Lists the owner of every TCP connection, IPv4 and IPv6.
+    virtual bool ReadTcpTable(std::vector<TcpOwnerRow>& rows) = 0;
+
+    /// Gets the start time and full image path of a running process. Fails once it has exited.
+    virtual bool QueryProcess(unsigned int pid, unsigned long long* startTime, std::wstring& imagePath) = 0;
+};
+
+typedef struct ConnectionOwner {
+    int verdict;
+
+    // Zero while the owner isn't known.
+    unsigned int pid;
+    unsigned long long processStartTime;
+
+    // Set on the first connection attributed to this process since it was first seen or the policy
+    // last changed, so that a caller pushing PIDs elsewhere only does so once.
+    bool firstConnection;
+} ConnectionOwner;
+
+typedef struct ConnectionAttributionStats {
+    unsigned long long redirects;
+    unsigned long long lookups;
+
+    // Lookups and redirects that found the owner, and those that asked for a table read.
+    unsigned long long hits;
+    unsigned long long misses;
+
+    // Redirects on a port that had already been redirected, so a new connection reusing it.
+    unsigned long long portReuses;
+
+    unsigned long long refreshes;
+    unsigned long long rowsRead;
+
+    // Misses that asked for a read while one was already asked for, and reads that found one
+    // already running.
+    unsigned long long coalescedRefreshes;
+
+    unsigned long long processQueries;
+    unsigned long long processQueryFailures;
+
+    unsigned long long evictedConnections;
+    unsigned long long evictedProcesses;
+
+    size_t connections;
+    size_t processes;
+} ConnectionAttributionStats;
+
+/// Maps local TCP ports to the process that owns the connection and what the application policy
+/// says about it, for the connections the diverter redirects to the proxy.
+///
+/// Three sources are joined. Redirect events say a new connection is using a port. The TCP table
+/// says which PID owns it. The backend's process query gives the process start time, which tells
+/// reused PIDs apart, and its image path, whose file name the policy rules are matched against.
+///
+/// The table is read in full, but applied as a difference from the last read: new rows are added,
+/// changed owners replaced, and ports that are gone evicted once they have been gone for the grace
+/// period. Lookups and redirects never read the table themselves. A miss asks for a read and
+/// answers unknown, and the thread that waits in WaitForMiss() runs the read with Refresh(), at
+/// most once every minRefreshUs, and periodically even when nothing misses.
+///
+/// Reads and process queries happen outside the lock, so lookups never wait on the OS. Times are
+/// monotonic microseconds from the caller, so that replays can run on their own clock. Safe to use
+/// from any number of threads. The threading types live in the .cpp so that this header can be
+/// included from /clr code.
+class ConnectionAttribution {
+public:
+    /// backend is not owned.
+    ConnectionAttribution(AttributionBackend* backend, unsigned long long graceUs, unsigned long long recheckUs);
+    ~ConnectionAttribution();
+
+    /// Replaces the application rules. A rule matches when its pattern, lowercased and without
+    /// ".exe", is part of the image's file name, lowercased and without ".exe", as rules were
+    /// matched against process names before. Every process's verdict is worked out again on its
+    /// next connection.
+    void SetPolicy(const std::vector<std::wstring>& patterns, const std::vector<int>& verdicts);
+
+    /// A new connection was redirected from localPort. Returns its owner if it is known already,
+    /// and otherwise asks for a read.
+    ConnectionOwner OnRedirect(unsigned short localPort, unsigned long long nowUs);
+
+    /// Returns false, with owner->verdict APP_VERDICT_UNKNOWN, and asks for a read if the owner of
+    /// the connection on localPort isn't known yet.
+    bool Lookup(unsigned short localPort, ConnectionOwner* owner);
+
+    /// Waits up to timeoutMs for a miss to ask for a read, and returns whether one did. Either way,
+    /// the request is taken, so the caller runs Refresh() next. For the one thread that reads.
+    bool WaitForMiss(unsigned int timeoutMs);
+
+    /// Reads the TCP table and applies it, unless another thread is doing so already.
+    void Refresh(unsigned long long nowUs);
+
+    /// The connection on localPort closed. Its entry goes without waiting for the grace period.
+    void OnClosed(unsigned short localPort);
+
+    ConnectionAttributionStats Stats() const;
+
+private:
+    ConnectionAttribution(const ConnectionAttribution&);
+    ConnectionAttribution& operator=(const ConnectionAttribution&);
+
+    struct Impl;
+    Impl* impl;
+};
@@ -0,0 +1,113 @@
+#include "ConnectionIndex.h"
+#include "ConnectionOwners.h"
+
+#include <string>
+#include <vector>
+
+#include <vcclr.h>
+
+namespace FilterNativeWindows {
+    String^ ConnectionIndexCounters::ToString() {
+        return String::Format("redirects={0} lookups={1} hits={2} misses={3} portReuses={4} refreshes={5} rowsRead={6} coalescedRefreshes={7} "
+            "processQueries={8} processQueryFailures={9} evictedConnections={10} evictedProcesses={11} connections={12} processes={13}",
+            gcnew array<Object^> { Redirects, Lookups, Hits, Misses, PortReuses, Refreshes, RowsRead, CoalescedRefreshes,
+                ProcessQueries, ProcessQueryFailures, EvictedConnections, EvictedProcesses, Connections, Processes });
+    }
+
+    // Adds each name with the verdict.
+    static void addRules(array<String^>^ names, int verdict, std::vector<std::wstring>& patterns, std::vector<int>& verdicts) {
+        if (names == nullptr) {
+            return;
+        }
+
+        for (int i = 0; i < names->Length; i++) {
+            if (String::IsNullOrEmpty(names[i])) {
+                continue;
+            }
+
+            pin_ptr<const wchar_t> c_name = PtrToStringChars(names[i]);
+
+            patterns.push_back(std::wstring(c_name, names[i]->Length));
+            verdicts.push_back(verdict);
+        }
+    }
+
+    ConnectionIndex::ConnectionIndex() {
+    }
+
+    ConnectionIndex^ ConnectionIndex::Default::get() {
+        return defaultIndex;
+    }
+
+    void ConnectionIndex::SetPolicy(array<String^>^ whitelisted, array<String^>^ blacklisted, array<String^>^ blocked) {
+        std::vector<std::wstring> patterns;
+        std::vector<int> verdicts;
+
+        addRules(whitelisted, APP_VERDICT_WHITELISTED, patterns, verdicts);
+        addRules(blacklisted, APP_VERDICT_BLACKLISTED, patterns, verdicts);
+        addRules(blocked, APP_VERDICT_BLOCKED, patterns, verdicts);
+
+        GetConnectionAttribution()->SetPolicy(patterns, verdicts);
+    }
+
+    AttributedConnection ConnectionIndex::OnRedirect(int localPort) {
+        if (localPort < 0 || localPort > 0xFFFF) {
+            throw gcnew ArgumentOutOfRangeException("localPort");
+        }
+
+        return toManaged(GetConnectionAttribution()->OnRedirect((unsigned short)localPort, AttributionNowUs()));
+    }
+
+    bool ConnectionIndex::TryLookup(int localPort, AttributedConnection% connection) {
+        if (localPort < 0 || localPort > 0xFFFF) {
+            throw gcnew ArgumentOutOfRangeException("localPort");
+        }
+
+        ::ConnectionOwner owner;
+        bool found = GetConnectionAttribution()->Lookup((unsigned short)localPort, &owner);
+
+        connection = toManaged(owner);
+        return found;
+    }
+
+    void ConnectionIndex::OnClosed(int localPort) {
+        if (localPort < 0 || localPort > 0xFFFF) {
+            throw gcnew ArgumentOutOfRangeException("localPort");
+        }
+
+        GetConnectionAttribution()->OnClosed((unsigned short)localPort);
+    }
+
+    ConnectionIndexCounters ConnectionIndex::GetCounters() {
+        ConnectionAttributionStats stats = GetConnectionAttribution()->Stats();
+        ConnectionIndexCounters counters = ConnectionIndexCounters();
+
+        counters.Redirects = (long long)stats.redirects;
+        counters.Lookups = (long long)stats.lookups;
+        counters.Hits = (long long)stats.hits;
+        counters.Misses = (long long)stats.misses;
+        counters.PortReuses = (long long)stats.portReuses;
+        counters.Refreshes = (long long)stats.refreshes;
+        counters.RowsRead = (long long)stats.rowsRead;
+        counters.CoalescedRefreshes = (long long)stats.coalescedRefreshes;
+        counters.ProcessQueries = (long long)stats.processQueries;
+        counters.ProcessQueryFailures = (long long)stats.processQueryFailures;
+        counters.EvictedConnections = (long long)stats.evictedConnections;
+        counters.EvictedProcesses = (long long)stats.evictedProcesses;
+        counters.Connections = (long long)stats.connections;
+        counters.Processes = (long long)stats.processes;
+
+        return counters;
+    }
+
+    AttributedConnection ConnectionIndex::toManaged(const ::ConnectionOwner& owner) {
+        AttributedConnection connection = AttributedConnection();
+
+        connection.Verdict = (AppVerdict)owner.verdict;
+        connection.ProcessId = (int)owner.pid;
+        connection.ProcessStartTime = (long long)owner.processStartTime;
+        connection.FirstConnection = owner.firstConnection;
+
+        return connection;
+    }
+}
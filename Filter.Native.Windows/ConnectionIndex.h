@@ -0,0 +1,115 @@
+#pragma once
+
+#include "ConnectionAttribution.h"
+
+using namespace System;
+using namespace System::Runtime::InteropServices;
+
+namespace FilterNativeWindows {
+    public enum class AppVerdict {
+        /// <summary>
+        /// The owner of the connection isn't known yet.
+        /// </summary>
+        Unknown = APP_VERDICT_UNKNOWN,
+
+        /// <summary>
+        /// No application rule matches the owner, so it is filtered like anything else.
+        /// </summary>
+        Filter = APP_VERDICT_FILTER,
+
+        Whitelisted = APP_VERDICT_WHITELISTED,
+        Blacklisted = APP_VERDICT_BLACKLISTED,
+        Blocked = APP_VERDICT_BLOCKED
+    };
+
+    public value struct AttributedConnection {
+        AppVerdict Verdict;
+
+        /// <summary>
+        /// Zero while the owner isn't known.
+        /// </summary>
+        int ProcessId;
+
+        /// <summary>
+        /// Creation time of the owner, as a FILETIME. Tells processes with the same ID apart.
+        /// </summary>
+        long long ProcessStartTime;
+
+        /// <summary>
+        /// The first connection attributed to this process since it started or the policy changed, so the time to
+        /// pass its ID on to anything that works by process ID.
+        /// </summary>
+        bool FirstConnection;
+    };
+
+    public value struct ConnectionIndexCounters {
+        long long Redirects;
+        long long Lookups;
+        long long Hits;
+        long long Misses;
+
+        /// <summary>
+        /// Redirects from a port that another redirected connection had used.
+        /// </summary>
+        long long PortReuses;
+
+        long long Refreshes;
+        long long RowsRead;
+
+        /// <summary>
+        /// Misses that asked for a table read while one was already asked for, and reads that found one running.
+        /// </summary>
+        long long CoalescedRefreshes;
+
+        long long ProcessQueries;
+        long long ProcessQueryFailures;
+
+        long long EvictedConnections;
+        long long EvictedProcesses;
+
+        long long Connections;
+        long long Processes;
+
+        virtual String^ ToString() override;
+    };
+
+    /// <summary>
+    /// Knows which process owns each connection the diverter redirects, by local port, and what the application
+    /// policy says about it. Kept current from redirects and from the TCP table, so that connections from processes
+    /// started after the policy was loaded are attributed too.
+    /// </summary>
+    public ref class ConnectionIndex {
+    public:
+        static property ConnectionIndex^ Default {
+            ConnectionIndex^ get();
+        }
+
+        /// <summary>
+        /// Replaces the application rules. Names match anywhere in the process's file name, ignoring case and ".exe". A
+        /// process several rules match gets the most restrictive verdict.
+        /// </summary>
+        void SetPolicy(array<String^>^ whitelisted, array<String^>^ blacklisted, array<String^>^ blocked);
+
+        /// <summary>
+        /// A connection from localPort was redirected. Returns its owner if it is known already. Otherwise the TCP table is
+        /// read in the background, and a later redirect or lookup finds it.
+        /// </summary>
+        AttributedConnection OnRedirect(int localPort);
+
+        /// <summary>
+        /// Looks up the owner of the connection from localPort. Returns false if it isn't known yet.
+        /// </summary>
+        bool TryLookup(int localPort, [Out] AttributedConnection% connection);
+
+        void OnClosed(int localPort);
+
+        ConnectionIndexCounters GetCounters();
+
+    private:
+        ConnectionIndex();
+
+        static AttributedConnection toManaged(const ::ConnectionOwner& owner);
+
+        static ConnectionIndex^ defaultIndex = gcnew ConnectionIndex();
+    };
+}
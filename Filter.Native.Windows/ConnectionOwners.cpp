@@ -0,0 +1,138 @@
+#include <winsock2.h>
+#include <ws2ipdef.h>
+#include <Windows.h>
+#include <iphlpapi.h>
+
+#include <thread>
+
+#include "ConnectionOwners.h"
+
+static ConnectionAttribution* volatile connectionAttribution = NULL;
+
+static LONGLONG counterFrequency() {
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+
+    return frequency.QuadPart;
+}
+
+unsigned long long AttributionNowUs() {
+    static const LONGLONG frequency = counterFrequency();
+
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+
+    return (unsigned long long)(counter.QuadPart / frequency * 1000000 + counter.QuadPart % frequency * 1000000 / frequency);
+}
+
+// Reads the table when a lookup or redirect misses, so that they never wait on it, and every
+// ATTRIBUTION_DEFAULT_IDLE_REFRESH_MS otherwise. Misses while it reads, or shortly after, are
+// answered by the next read.
+static void refreshLoop(ConnectionAttribution* index) {
+    for (;;) {
+        index->WaitForMiss(ATTRIBUTION_DEFAULT_IDLE_REFRESH_MS);
+        index->Refresh(AttributionNowUs());
+
+        Sleep(ATTRIBUTION_DEFAULT_MIN_REFRESH_US / 1000);
+    }
+}
+
+ConnectionAttribution* GetConnectionAttribution() {
+    ConnectionAttribution* index = connectionAttribution;
+    if (index != NULL) {
+        return index;
+    }
+
+    // Never freed, like the index that uses it.
+    static WindowsAttributionBackend backend;
+
+    index = new ConnectionAttribution(&backend, ATTRIBUTION_DEFAULT_GRACE_US, ATTRIBUTION_DEFAULT_RECHECK_US);
+
+    ConnectionAttribution* existing = (ConnectionAttribution*)InterlockedCompareExchangePointer((PVOID volatile*)&connectionAttribution, index, NULL);
+    if (existing != NULL) {
+        delete index;
+        return existing;
+    }
+
+    // Runs for as long as the process, like the index.
+    std::thread(refreshLoop, index).detach();
+
+    return index;
+}
+
+// Reads a table into buffer, growing it until the table fits.
+template<typename Table>
+static bool readTable(std::vector<unsigned char>& buffer, ULONG (WINAPI *getTable)(Table*, PULONG, BOOL)) {
+    for (int attempt = 0; attempt < 4; attempt++) {
+        ULONG size = (ULONG)buffer.size();
+        ULONG result = getTable(buffer.empty() ? NULL : (Table*)&buffer[0], &size, FALSE);
+
+        if (result == NO_ERROR) {
+            return true;
+        }
+
+        if (result != ERROR_INSUFFICIENT_BUFFER) {
+            return false;
+        }
+
+        // Connections open between the two calls, so leave some room.
+        buffer.resize(size + size / 4);
+    }
+
+    return false;
+}
+
+bool WindowsAttributionBackend::ReadTcpTable(std::vector<TcpOwnerRow>& rows) {
+    bool read = false;
+
+    if (readTable<MIB_TCPTABLE2>(buffer, GetTcpTable2)) {
+        const MIB_TCPTABLE2* table = (const MIB_TCPTABLE2*)&buffer[0];
+
+        for (DWORD i = 0; i < table->dwNumEntries; i++) {
+            TcpOwnerRow row;
+            row.localPort = ntohs((u_short)(table->table[i].dwLocalPort & 0xFFFF));
+            row.pid = table->table[i].dwOwningPid;
+            rows.push_back(row);
+        }
+
+        read = true;
+    }
+
+    if (readTable<MIB_TCP6TABLE2>(buffer, GetTcp6Table2)) {
+        const MIB_TCP6TABLE2* table = (const MIB_TCP6TABLE2*)&buffer[0];
+
+        for (DWORD i = 0; i < table->dwNumEntries; i++) {
+            TcpOwnerRow row;
+            row.localPort = ntohs((u_short)(table->table[i].dwLocalPort & 0xFFFF));
+            row.pid = table->table[i].dwOwningPid;
+            rows.push_back(row);
+        }
+
+        read = true;
+    }
+
+    return read;
+}
+
+bool WindowsAttributionBackend::QueryProcess(unsigned int pid, unsigned long long* startTime, std::wstring& imagePath) {
+    HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+    if (process == NULL) {
+        return false;
+    }
+
+    bool succeeded = false;
+
+    FILETIME creation, exit, kernel, user;
+    wchar_t path[MAX_PATH * 4];
+    DWORD length = sizeof(path) / sizeof(path[0]);
+
+    if (GetProcessTimes(process, &creation, &exit, &kernel, &user) && QueryFullProcessImageNameW(process, 0, path, &length)) {
+        *startTime = ((unsigned long long)creation.dwHighDateTime << 32) | creation.dwLowDateTime;
+        imagePath.assign(path, length);
+
+        succeeded = true;
+    }
+
+    CloseHandle(process);
+    return succeeded;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <vector>
+
+#include "ConnectionAttribution.h"
+
+/// Reads the owners of TCP connections with GetTcpTable2() and GetTcp6Table2(), and identifies
+/// processes with their creation time and QueryFullProcessImageNameW().
+class WindowsAttributionBackend : public AttributionBackend {
+public:
+    virtual bool ReadTcpTable(std::vector<TcpOwnerRow>& rows);
+    virtual bool QueryProcess(unsigned int pid, unsigned long long* startTime, std::wstring& imagePath);
+
+private:
+    // Only used by ReadTcpTable(), which ConnectionAttribution never runs on two threads at once.
+    std::vector<unsigned char> buffer;
+};
+
+/// Index shared by the diverter and everything that asks who owns a connection. The first call
+/// starts the thread that reads the TCP table for it.
+ConnectionAttribution* GetConnectionAttribution();
+
+/// The monotonic clock the shared index runs on, in microseconds.
+unsigned long long AttributionNowUs();
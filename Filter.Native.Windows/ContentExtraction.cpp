@@ -0,0 +1,40 @@
+#include "JsonStringScanner.h"
+#include "ContentExtraction.h"
+
+using namespace System::Text;
+
+namespace FilterNativeWindows {
+    String^ ContentExtraction::ExtractJsonStringValues(array<Byte>^ data, int offset, int count, Char separator) {
+        if (data == nullptr) {
+            throw gcnew ArgumentNullException("data");
+        }
+
+        if (offset < 0 || count < 0 || offset > data->Length - count) {
+            throw gcnew ArgumentOutOfRangeException("count");
+        }
+
+        if (separator > 0x7F) {
+            throw gcnew ArgumentOutOfRangeException("separator", "separator must be an ASCII character.");
+        }
+
+        if (count == 0) {
+            return String::Empty;
+        }
+
+        JsonStringScanner scanner((unsigned char)separator);
+
+        {
+            pin_ptr<Byte> pinnedData = &data[offset];
+            scanner.Feed(pinnedData, (size_t)count);
+        }
+
+        scanner.Finish();
+
+        const std::vector<unsigned char>& text = scanner.Text();
+        if (text.empty()) {
+            return String::Empty;
+        }
+
+        return gcnew String(reinterpret_cast<char*>(const_cast<unsigned char*>(text.data())), 0, (int)text.size(), Encoding::UTF8);
+    }
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+using namespace System;
+
+namespace FilterNativeWindows {
+    public ref class ContentExtraction {
+    public:
+        /// <summary>
+        /// Pulls the decoded string values out of a JSON document. Keys, numbers and punctuation are dropped.
+        /// Truncated or malformed JSON returns whatever values could be recovered.
+        /// </summary>
+        /// <param name="separator">ASCII character placed after each value.</param>
+        static String^ ExtractJsonStringValues(array<Byte>^ data, int offset, int count, Char separator);
+    };
+}
@@ -0,0 +1,102 @@
+#include "ContentHash.h"
+
+#include <cstring>
+
+#define MURMUR_C1 0x87c37b91114253d5ULL
+#define MURMUR_C2 0x4cf5ad432745937fULL
+
+static inline unsigned long long rotateLeft(unsigned long long value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+static inline unsigned long long finalMix(unsigned long long h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// Little endian load that doesn't care about alignment. Compilers turn it into a single move.
+static inline unsigned long long load64(const unsigned char* p) {
+    unsigned long long value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+ContentHash HashContent(const unsigned char* data, size_t length, unsigned long long seed) {
+    unsigned long long h1 = seed;
+    unsigned long long h2 = seed ^ MURMUR_C1;
+
+    size_t blocks = length / 16;
+
+    for (size_t i = 0; i < blocks; i++) {
+        unsigned long long k1 = load64(data + i * 16);
+        unsigned long long k2 = load64(data + i * 16 + 8);
+
+        k1 *= MURMUR_C1;
+        k1 = rotateLeft(k1, 31);
+        k1 *= MURMUR_C2;
+        h1 ^= k1;
+
+        h1 = rotateLeft(h1, 27);
+        h1 += h2;
+        h1 = h1 * 5 + 0x52dce729;
+
+        k2 *= MURMUR_C2;
+        k2 = rotateLeft(k2, 33);
+        k2 *= MURMUR_C1;
+        h2 ^= k2;
+
+        h2 = rotateLeft(h2, 31);
+        h2 += h1;
+        h2 = h2 * 5 + 0x38495ab5;
+    }
+
+    const unsigned char* tail = data + blocks * 16;
+    unsigned long long k1 = 0;
+    unsigned long long k2 = 0;
+
+    // Tail bytes go in little endian, the same as a zero padded block would.
+    size_t rest = length & 15;
+
+    for (size_t i = rest; i > 8; i--) {
+        k2 = (k2 << 8) | tail[i - 1];
+    }
+
+    for (size_t i = rest < 8 ? rest : 8; i > 0; i--) {
+        k1 = (k1 << 8) | tail[i - 1];
+    }
+
+    if (rest > 8) {
+        k2 *= MURMUR_C2;
+        k2 = rotateLeft(k2, 33);
+        k2 *= MURMUR_C1;
+        h2 ^= k2;
+    }
+
+    if (rest > 0) {
+        k1 *= MURMUR_C1;
+        k1 = rotateLeft(k1, 31);
+        k1 *= MURMUR_C2;
+        h1 ^= k1;
+    }
+
+    h1 ^= (unsigned long long)length;
+    h2 ^= (unsigned long long)length;
+
+    h1 += h2;
+    h2 += h1;
+
+    h1 = finalMix(h1);
+    h2 = finalMix(h2);
+
+    h1 += h2;
+    h2 += h1;
+
+    ContentHash hash;
+    hash.low = h1;
+    hash.high = h2;
+    return hash;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+
+typedef struct ContentHash {
+    unsigned long long low;
+    unsigned long long high;
+} ContentHash;
+
+/// 128 bit MurmurHash3 (x64 variant) of a byte range, with both halves of the state seeded from
+/// seed. Not cryptographic: content that is crafted to collide can, but random content won't in
+/// any amount a process will ever see, which is what caching verdicts by fingerprint relies on.
+ContentHash HashContent(const unsigned char* data, size_t length, unsigned long long seed);
+
+inline bool operator==(const ContentHash& a, const ContentHash& b) {
+    return a.low == b.low && a.high == b.high;
+}
+
+inline bool operator!=(const ContentHash& a, const ContentHash& b) {
+    return !(a == b);
+}
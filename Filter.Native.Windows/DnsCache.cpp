@@ -0,0 +1,137 @@
+#include "DnsCache.h"
+
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace {
+    typedef struct Entry {
+        bool up;
+        DnsAnswer answer;
+        unsigned long long storedAt;
+        unsigned long long expiresAt;
+    } Entry;
+}
+
+struct DnsCache::Impl {
+    unsigned long long maxTtlMs;
+    unsigned long long failureTtlMs;
+
+    mutable std::mutex lock;
+    std::unordered_map<std::string, Entry> entries;
+};
+
+// Names are case-insensitive and may or may not end in a dot, so both are taken out of the key.
+static std::string makeKey(const char* name, unsigned short type) {
+    std::string key;
+
+    for (const char* c = name; *c != 0; c++) {
+        key.push_back(*c >= 'A' && *c <= 'Z' ? (char)(*c + ('a' - 'A')) : *c);
+    }
+
+    if (!key.empty() && key[key.size() - 1] == '.') {
+        key.resize(key.size() - 1);
+    }
+
+    key.push_back('/');
+    key.append(std::to_string(type));
+
+    return key;
+}
+
+static void put(std::unordered_map<std::string, Entry>& entries, const std::string& key, const Entry& entry, unsigned long long now) {
+    if (entries.size() >= DNS_CACHE_CAPACITY && entries.find(key) == entries.end()) {
+        for (std::unordered_map<std::string, Entry>::iterator i = entries.begin(); i != entries.end();) {
+            if (i->second.expiresAt <= now) {
+                i = entries.erase(i);
+            }
+            else {
+                ++i;
+            }
+        }
+
+        if (entries.size() >= DNS_CACHE_CAPACITY) {
+            entries.clear();
+        }
+    }
+
+    entries[key] = entry;
+}
+
+DnsCache::DnsCache(unsigned long long maxTtlMs, unsigned long long failureTtlMs) {
+    impl = new Impl();
+    impl->maxTtlMs = maxTtlMs;
+    impl->failureTtlMs = failureTtlMs;
+}
+
+DnsCache::~DnsCache() {
+    delete impl;
+}
+
+bool DnsCache::Find(const char* name, unsigned short type, unsigned long long now, bool* up, DnsAnswer* answer) const {
+    std::string key = makeKey(name, type);
+
+    std::lock_guard<std::mutex> guard(impl->lock);
+
+    std::unordered_map<std::string, Entry>::const_iterator found = impl->entries.find(key);
+    if (found == impl->entries.end() || found->second.expiresAt <= now) {
+        return false;
+    }
+
+    *up = found->second.up;
+    *answer = found->second.answer;
+
+    if (found->second.up) {
+        unsigned long long age = (now - found->second.storedAt) / 1000;
+        answer->ttl = age >= answer->ttl ? 0 : answer->ttl - (unsigned int)age;
+    }
+
+    return true;
+}
+
+void DnsCache::Store(const char* name, unsigned short type, const DnsAnswer& answer, unsigned long long now) {
+    if (answer.addressCount == 0 || answer.ttl == 0) {
+        return;
+    }
+
+    unsigned long long ttlMs = (unsigned long long)answer.ttl * 1000;
+
+    Entry entry;
+    entry.up = true;
+    entry.answer = answer;
+    entry.storedAt = now;
+    entry.expiresAt = now + (ttlMs < impl->maxTtlMs ? ttlMs : impl->maxTtlMs);
+
+    std::string key = makeKey(name, type);
+
+    std::lock_guard<std::mutex> guard(impl->lock);
+    put(impl->entries, key, entry, now);
+}
+
+void DnsCache::StoreFailure(const char* name, unsigned short type, unsigned long long now) {
+    if (impl->failureTtlMs == 0) {
+        return;
+    }
+
+    Entry entry;
+    memset(&entry.answer, 0, sizeof(entry.answer));
+    entry.up = false;
+    entry.storedAt = now;
+    entry.expiresAt = now + impl->failureTtlMs;
+
+    std::string key = makeKey(name, type);
+
+    std::lock_guard<std::mutex> guard(impl->lock);
+    put(impl->entries, key, entry, now);
+}
+
+void DnsCache::Clear() {
+    std::lock_guard<std::mutex> guard(impl->lock);
+    impl->entries.clear();
+}
+
+size_t DnsCache::Count() const {
+    std::lock_guard<std::mutex> guard(impl->lock);
+    return impl->entries.size();
+}
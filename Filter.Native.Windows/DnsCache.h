@@ -0,0 +1,38 @@
+#pragma once
+
+#include "DnsMessage.h"
+
+// Entries kept before expired ones are swept out, and then everything if none had expired.
+#define DNS_CACHE_CAPACITY 256
+
+/// Probe verdicts keyed by name and query type. An answer is kept for its TTL, capped at maxTtlMs,
+/// and a failure for failureTtlMs, so that a dead resolver isn't asked again on every check but
+/// is tried again soon after it comes back.
+///
+/// Times are in milliseconds on whatever clock the caller uses, as long as it never goes back.
+/// Safe to use from any number of threads.
+class DnsCache {
+public:
+    DnsCache(unsigned long long maxTtlMs, unsigned long long failureTtlMs);
+    ~DnsCache();
+
+    /// Returns false if there is no live entry. Otherwise up says whether the name resolved, and
+    /// answer holds what it resolved to with its TTL counted down to now.
+    bool Find(const char* name, unsigned short type, unsigned long long now, bool* up, DnsAnswer* answer) const;
+
+    /// Stores an answer. One without addresses, or with a TTL of zero, is not kept.
+    void Store(const char* name, unsigned short type, const DnsAnswer& answer, unsigned long long now);
+
+    void StoreFailure(const char* name, unsigned short type, unsigned long long now);
+
+    void Clear();
+
+    size_t Count() const;
+
+private:
+    DnsCache(const DnsCache&);
+    DnsCache& operator=(const DnsCache&);
+
+    struct Impl;
+    Impl* impl;
+};
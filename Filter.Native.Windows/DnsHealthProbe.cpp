@@ -0,0 +1,133 @@
+#include "DnsHealthProbe.h"
+#include "DnsProbe.h"
+
+#include <climits>
+#include <string>
+
+using namespace System::Net::Sockets;
+using namespace System::Runtime::InteropServices;
+
+namespace FilterNativeWindows {
+    static unsigned long long milliseconds(TimeSpan span) {
+        return span <= TimeSpan::Zero ? 0 : (unsigned long long)span.TotalMilliseconds;
+    }
+
+    DnsHealthProbe::DnsHealthProbe(TimeSpan maxCacheTtl, TimeSpan failureCacheTtl) {
+        probe = new DnsProbe(milliseconds(maxCacheTtl), milliseconds(failureCacheTtl));
+        servers = gcnew array<IPAddress^>(0);
+    }
+
+    DnsHealthProbe::~DnsHealthProbe() {
+        this->!DnsHealthProbe();
+    }
+
+    DnsHealthProbe::!DnsHealthProbe() {
+        delete probe;
+        probe = NULL;
+    }
+
+    void DnsHealthProbe::SetServers(array<IPAddress^>^ servers) {
+        if (servers == nullptr) {
+            throw gcnew ArgumentNullException("servers");
+        }
+
+        if (probe == NULL) {
+            throw gcnew ObjectDisposedException("DnsHealthProbe");
+        }
+
+        if (servers->Length > DNS_PROBE_MAX_SERVERS) {
+            throw gcnew ArgumentOutOfRangeException("servers");
+        }
+
+        DnsAddress addresses[DNS_PROBE_MAX_SERVERS];
+
+        for (int i = 0; i < servers->Length; i++) {
+            if (servers[i] == nullptr) {
+                throw gcnew ArgumentNullException("servers");
+            }
+
+            if (servers[i]->AddressFamily != AddressFamily::InterNetwork && servers[i]->AddressFamily != AddressFamily::InterNetworkV6) {
+                throw gcnew ArgumentException("Servers must be IPv4 or IPv6 addresses.", "servers");
+            }
+
+            array<Byte>^ bytes = servers[i]->GetAddressBytes();
+
+            addresses[i].length = (unsigned char)bytes->Length;
+            Marshal::Copy(bytes, 0, IntPtr(addresses[i].bytes), bytes->Length);
+        }
+
+        probe->SetServers(addresses, (size_t)servers->Length, 53);
+        this->servers = (array<IPAddress^>^)servers->Clone();
+    }
+
+    DnsProbeVerdict DnsHealthProbe::Probe(String^ name, bool ipv6, TimeSpan timeout) {
+        return run(name, ipv6, timeout, false);
+    }
+
+    DnsProbeVerdict DnsHealthProbe::Resolve(String^ name, bool ipv6, TimeSpan timeout) {
+        return run(name, ipv6, timeout, true);
+    }
+
+    void DnsHealthProbe::FlushCache() {
+        if (probe != NULL) {
+            probe->FlushCache();
+        }
+    }
+
+    DnsProbeVerdict DnsHealthProbe::run(String^ name, bool ipv6, TimeSpan timeout, bool cached) {
+        if (name == nullptr) {
+            throw gcnew ArgumentNullException("name");
+        }
+
+        if (probe == NULL) {
+            throw gcnew ObjectDisposedException("DnsHealthProbe");
+        }
+
+        // Host names are ASCII; IdnMapping has already run on anything that wasn't.
+        std::string host;
+        for (int i = 0; i < name->Length; i++) {
+            if (name[i] > 0x7F) {
+                throw gcnew ArgumentException("Names must be ASCII.", "name");
+            }
+
+            host.push_back((char)name[i]);
+        }
+
+        unsigned long long timeoutMs = milliseconds(timeout);
+        unsigned short type = ipv6 ? DNS_TYPE_AAAA : DNS_TYPE_A;
+
+        // Taken before the probe, which can't tell us which list it ran against.
+        array<IPAddress^>^ probed = servers;
+
+        DnsProbeResult result;
+        bool ran;
+
+        if (cached) {
+            ran = probe->Resolve(host.c_str(), type, (unsigned int)(timeoutMs > UINT_MAX ? UINT_MAX : timeoutMs), &result);
+        }
+        else {
+            ran = probe->Probe(host.c_str(), type, (unsigned int)(timeoutMs > UINT_MAX ? UINT_MAX : timeoutMs), &result);
+        }
+
+        if (!ran) {
+            throw gcnew ArgumentException("Not a host name that can be queried.", "name");
+        }
+
+        DnsProbeVerdict verdict;
+        verdict.Up = result.up;
+        verdict.Server = result.server >= 0 && result.server < probed->Length ? probed[result.server] : nullptr;
+        verdict.FromCache = result.fromCache;
+        verdict.ElapsedMs = (int)result.elapsedMs;
+        verdict.TtlSeconds = result.answer.ttl > INT_MAX ? INT_MAX : (int)result.answer.ttl;
+        verdict.Addresses = gcnew array<IPAddress^>((int)result.answer.addressCount);
+
+        for (size_t i = 0; i < result.answer.addressCount; i++) {
+            array<Byte>^ bytes = gcnew array<Byte>(result.answer.addresses[i].length);
+            Marshal::Copy(IntPtr(result.answer.addresses[i].bytes), bytes, 0, bytes->Length);
+
+            verdict.Addresses[(int)i] = gcnew IPAddress(bytes);
+        }
+
+        return verdict;
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+class DnsProbe;
+
+using namespace System;
+using namespace System::Net;
+
+namespace FilterNativeWindows {
+    public value struct DnsProbeVerdict {
+        /// <summary>
+        /// True if a server answered the query with at least one address.
+        /// </summary>
+        bool Up;
+
+        /// <summary>
+        /// The server that answered, or null if none did or the verdict came from the cache.
+        /// </summary>
+        IPAddress^ Server;
+
+        bool FromCache;
+        int ElapsedMs;
+
+        /// <summary>
+        /// What the name resolved to, and for how many more seconds the answer holds.
+        /// </summary>
+        array<IPAddress^>^ Addresses;
+        int TtlSeconds;
+    };
+
+    /// <summary>
+    /// Checks DNS servers by querying all of them at once and taking the first good answer. Servers that are down are
+    /// found out as soon as they refuse the query or stop answering retransmissions timed from their own round trips,
+    /// instead of after a fixed timeout each.
+    /// </summary>
+    public ref class DnsHealthProbe {
+    public:
+        /// <param name="maxCacheTtl">Longest that Resolve() keeps an answer, whatever its TTL.</param>
+        /// <param name="failureCacheTtl">How long Resolve() remembers that no server answered.</param>
+        DnsHealthProbe(TimeSpan maxCacheTtl, TimeSpan failureCacheTtl);
+        ~DnsHealthProbe();
+        !DnsHealthProbe();
+
+        /// <summary>
+        /// Replaces the servers to query on port 53. Round trip times of servers still in the list are kept.
+        /// </summary>
+        void SetServers(array<IPAddress^>^ servers);
+
+        /// <summary>
+        /// Asks every server for an address of name and waits up to timeout for a verdict.
+        /// </summary>
+        /// <param name="ipv6">Ask for AAAA records instead of A. Either can be asked of servers of either family.</param>
+        DnsProbeVerdict Probe(String^ name, bool ipv6, TimeSpan timeout);
+
+        /// <summary>
+        /// Like Probe(), but answers from the cache while the last answer's TTL lasts.
+        /// </summary>
+        DnsProbeVerdict Resolve(String^ name, bool ipv6, TimeSpan timeout);
+
+        void FlushCache();
+
+    private:
+        DnsProbeVerdict run(String^ name, bool ipv6, TimeSpan timeout, bool cached);
+
+        DnsProbe* probe;
+        array<IPAddress^>^ servers;
+    };
+}
@@ -0,0 +1,166 @@
+#include "DnsMessage.h"
+
+#include <cstring>
+
+#define HEADER_SIZE 12
+#define FLAG_RESPONSE 0x8000
+#define FLAG_RECURSION_DESIRED 0x0100
+#define CLASS_IN 1
+
+static unsigned short readShort(const unsigned char* at) {
+    return (unsigned short)((at[0] << 8) | at[1]);
+}
+
+static unsigned int readInt(const unsigned char* at) {
+    return ((unsigned int)at[0] << 24) | ((unsigned int)at[1] << 16) | ((unsigned int)at[2] << 8) | at[3];
+}
+
+static void writeShort(unsigned char* at, unsigned short value) {
+    at[0] = (unsigned char)(value >> 8);
+    at[1] = (unsigned char)value;
+}
+
+// Returns the offset just past the name at offset, or zero if it runs off the end. Compression
+// pointers aren't followed, since only where the name ends matters here.
+static size_t skipName(const unsigned char* message, size_t length, size_t offset) {
+    while (offset < length) {
+        unsigned char label = message[offset];
+
+        if (label == 0) {
+            return offset + 1;
+        }
+
+        if ((label & 0xC0) == 0xC0) {
+            // A compression pointer always ends the name.
+            return offset + 2 <= length ? offset + 2 : 0;
+        }
+
+        if ((label & 0xC0) != 0) {
+            return 0;
+        }
+
+        offset += 1 + label;
+    }
+
+    return 0;
+}
+
+size_t DnsMessage::BuildQuery(unsigned short id, const char* name, unsigned short type, unsigned char* out, size_t capacity) {
+    size_t nameLength = strlen(name);
+
+    if (nameLength > 0 && name[nameLength - 1] == '.') {
+        nameLength--;
+    }
+
+    // Each label gains a length byte in place of its dot, plus the root label at the end.
+    size_t total = HEADER_SIZE + nameLength + 2 + 4;
+
+    if (nameLength == 0 || nameLength > 253 || total > capacity) {
+        return 0;
+    }
+
+    memset(out, 0, HEADER_SIZE);
+    writeShort(out, id);
+    writeShort(out + 2, FLAG_RECURSION_DESIRED);
+    writeShort(out + 4, 1);
+
+    size_t offset = HEADER_SIZE;
+    size_t labelStart = 0;
+
+    for (size_t i = 0; i <= nameLength; i++) {
+        if (i == nameLength || name[i] == '.') {
+            size_t labelLength = i - labelStart;
+
+            if (labelLength == 0 || labelLength > 63) {
+                return 0;
+            }
+
+            out[offset++] = (unsigned char)labelLength;
+            memcpy(out + offset, name + labelStart, labelLength);
+            offset += labelLength;
+
+            labelStart = i + 1;
+        }
+    }
+
+    out[offset++] = 0;
+    writeShort(out + offset, type);
+    writeShort(out + offset + 2, CLASS_IN);
+
+    return offset + 4;
+}
+
+bool DnsMessage::ParseResponse(const unsigned char* message, size_t length, unsigned short id, unsigned short type, DnsAnswer* answer) {
+    if (length < HEADER_SIZE || readShort(message) != id) {
+        return false;
+    }
+
+    unsigned short flags = readShort(message + 2);
+
+    if ((flags & FLAG_RESPONSE) == 0) {
+        return false;
+    }
+
+    unsigned short questions = readShort(message + 4);
+    unsigned short answers = readShort(message + 6);
+
+    memset(answer, 0, sizeof(*answer));
+    answer->rcode = flags & 0x000F;
+
+    size_t offset = HEADER_SIZE;
+
+    for (unsigned short i = 0; i < questions; i++) {
+        offset = skipName(message, length, offset);
+
+        if (offset == 0 || offset + 4 > length) {
+            return false;
+        }
+
+        offset += 4;
+    }
+
+    bool haveTtl = false;
+
+    for (unsigned short i = 0; i < answers; i++) {
+        offset = skipName(message, length, offset);
+
+        if (offset == 0 || offset + 10 > length) {
+            return false;
+        }
+
+        unsigned short recordType = readShort(message + offset);
+        unsigned short recordClass = readShort(message + offset + 2);
+        unsigned int ttl = readInt(message + offset + 4);
+        unsigned short dataLength = readShort(message + offset + 8);
+
+        offset += 10;
+
+        if (offset + dataLength > length) {
+            return false;
+        }
+
+        // CNAMEs on the way to the address are skipped, but their TTL still bounds the answer's.
+        if (recordClass == CLASS_IN) {
+            if (!haveTtl || ttl < answer->ttl) {
+                answer->ttl = ttl;
+                haveTtl = true;
+            }
+
+            size_t addressLength = type == DNS_TYPE_A ? 4 : 16;
+
+            if (recordType == type && dataLength == addressLength && answer->addressCount < DNS_MAX_ADDRESSES) {
+                DnsAddress& address = answer->addresses[answer->addressCount++];
+                address.length = (unsigned char)addressLength;
+                memcpy(address.bytes, message + offset, addressLength);
+            }
+        }
+
+        offset += dataLength;
+    }
+
+    if (answer->addressCount == 0) {
+        answer->ttl = 0;
+    }
+
+    return true;
+}
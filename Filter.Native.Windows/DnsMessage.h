@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+
+#define DNS_TYPE_A 1
+#define DNS_TYPE_AAAA 28
+
+#define DNS_RCODE_NOERROR 0
+#define DNS_RCODE_SERVFAIL 2
+#define DNS_RCODE_NXDOMAIN 3
+#define DNS_RCODE_REFUSED 5
+
+// Largest UDP message without EDNS.
+#define DNS_MAX_MESSAGE 512
+
+#define DNS_MAX_ADDRESSES 8
+
+typedef struct DnsAddress {
+    // 4 or 16.
+    unsigned char length;
+    unsigned char bytes[16];
+} DnsAddress;
+
+typedef struct DnsAnswer {
+    int rcode;
+
+    // Addresses of the queried type, in the order the server gave them. Extra ones are dropped.
+    size_t addressCount;
+    DnsAddress addresses[DNS_MAX_ADDRESSES];
+
+    // Smallest TTL of the records kept, in seconds. Zero if there are none.
+    unsigned int ttl;
+} DnsAnswer;
+
+/// Just enough of the DNS wire format to ask a server for one name and read back its addresses.
+class DnsMessage {
+public:
+    /// Writes a recursive query for name into out and returns its length, or zero if name is not a
+    /// valid host name or out is too small.
+    static size_t BuildQuery(unsigned short id, const char* name, unsigned short type, unsigned char* out, size_t capacity);
+
+    /// Reads a response to the query with the given id and type. Returns false if the message is
+    /// not one, or is malformed.
+    static bool ParseResponse(const unsigned char* message, size_t length, unsigned short id, unsigned short type, DnsAnswer* answer);
+
+private:
+    DnsMessage();
+};
@@ -0,0 +1,507 @@
+#include "DnsCache.h"
+#include "DnsProbe.h"
+
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+typedef WSAPOLLFD PollDescriptor;
+#else
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+typedef int SOCKET;
+typedef struct pollfd PollDescriptor;
+
+#define INVALID_SOCKET (-1)
+#endif
+
+namespace {
+    typedef struct Server {
+        DnsAddress address;
+        DnsServerStats stats;
+    } Server;
+
+    typedef enum Outcome {
+        OUTCOME_PENDING,
+        OUTCOME_ANSWERED,
+        OUTCOME_FAILED,
+
+        // Still waiting when another server settled the probe.
+        OUTCOME_ABANDONED
+    } Outcome;
+
+    typedef struct Query {
+        DnsAddress address;
+        SOCKET socket;
+        unsigned short id;
+        unsigned char message[DNS_MAX_MESSAGE];
+        size_t length;
+
+        int sends;
+        unsigned int rto;
+        unsigned long long firstSentAt;
+        unsigned long long nextSendAt;
+
+        Outcome outcome;
+        bool timedOut;
+
+        // Round trip of an answer to the first send, or zero if it can't be told which send was answered.
+        unsigned int rtt;
+    } Query;
+}
+
+struct DnsProbe::Impl {
+    Impl(unsigned long long maxCacheTtlMs, unsigned long long failureCacheTtlMs) : cache(maxCacheTtlMs, failureCacheTtlMs) {
+    }
+
+    bool socketsStarted;
+
+    mutable std::mutex lock;
+    std::vector<Server> servers;
+    unsigned short port;
+    unsigned long long random;
+
+    DnsCache cache;
+};
+
+static unsigned long long milliseconds() {
+    return (unsigned long long)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool sameAddress(const DnsAddress& a, const DnsAddress& b) {
+    return a.length == b.length && memcmp(a.bytes, b.bytes, a.length) == 0;
+}
+
+static unsigned int clampRto(unsigned long long rto) {
+    if (rto < DNS_PROBE_MIN_RTO_MS) {
+        return DNS_PROBE_MIN_RTO_MS;
+    }
+
+    return rto > DNS_PROBE_MAX_RTO_MS ? DNS_PROBE_MAX_RTO_MS : (unsigned int)rto;
+}
+
+static void closeSocket(SOCKET socket) {
+#if defined(_MSC_VER)
+    closesocket(socket);
+#else
+    close(socket);
+#endif
+}
+
+static bool wouldBlock() {
+#if defined(_MSC_VER)
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
+// Opens a non-blocking UDP socket connected to the server, so that only its datagrams are received
+// and an ICMP port unreachable from it fails the next receive.
+static SOCKET openSocket(const DnsAddress& address, unsigned short port) {
+    sockaddr_storage remote;
+    memset(&remote, 0, sizeof(remote));
+
+    socklen_t remoteLength;
+
+    if (address.length == 4) {
+        sockaddr_in* v4 = reinterpret_cast<sockaddr_in*>(&remote);
+        v4->sin_family = AF_INET;
+        v4->sin_port = htons(port);
+        memcpy(&v4->sin_addr, address.bytes, 4);
+        remoteLength = sizeof(sockaddr_in);
+    }
+    else {
+        sockaddr_in6* v6 = reinterpret_cast<sockaddr_in6*>(&remote);
+        v6->sin6_family = AF_INET6;
+        v6->sin6_port = htons(port);
+        memcpy(&v6->sin6_addr, address.bytes, 16);
+        remoteLength = sizeof(sockaddr_in6);
+    }
+
+    SOCKET handle = socket(remote.ss_family, SOCK_DGRAM, IPPROTO_UDP);
+    if (handle == INVALID_SOCKET) {
+        return INVALID_SOCKET;
+    }
+
+#if defined(_MSC_VER)
+    u_long nonBlocking = 1;
+    bool ready = ioctlsocket(handle, FIONBIO, &nonBlocking) == 0;
+#else
+    bool ready = fcntl(handle, F_SETFL, fcntl(handle, F_GETFL, 0) | O_NONBLOCK) == 0;
+#endif
+
+    if (!ready || connect(handle, reinterpret_cast<sockaddr*>(&remote), remoteLength) != 0) {
+        closeSocket(handle);
+        return INVALID_SOCKET;
+    }
+
+    return handle;
+}
+
+static void transmit(Query& query, unsigned long long now) {
+    query.sends++;
+
+    if (query.sends == 1) {
+        query.firstSentAt = now;
+    }
+    else {
+        // Back off as RFC 6298 does after a timeout.
+        query.rto = clampRto((unsigned long long)query.rto * 2);
+    }
+
+    query.nextSendAt = now + query.rto;
+
+    // A send that fails outright, say for want of a route, is the same to us as a lost datagram.
+    send(query.socket, reinterpret_cast<const char*>(query.message), (int)query.length, 0);
+}
+
+// Reads everything waiting on the query's socket. Returns true once it has settled the query.
+static bool receive(Query& query, unsigned short type, unsigned long long now, DnsAnswer* answer) {
+    unsigned char buffer[DNS_MAX_MESSAGE];
+
+    while (true) {
+        int received = (int)recv(query.socket, reinterpret_cast<char*>(buffer), sizeof(buffer), 0);
+
+        if (received < 0) {
+            if (wouldBlock()) {
+                return false;
+            }
+
+            // Refused or reset: nothing is listening there.
+            query.outcome = OUTCOME_FAILED;
+            return true;
+        }
+
+        // Anything that isn't a response to this query is ignored, like a datagram that never came.
+        if (!DnsMessage::ParseResponse(buffer, (size_t)received, query.id, type, answer)) {
+            continue;
+        }
+
+        if (query.sends == 1) {
+            unsigned long long rtt = now - query.firstSentAt;
+            query.rtt = rtt == 0 ? 1 : (unsigned int)rtt;
+        }
+
+        query.outcome = answer->rcode == DNS_RCODE_NOERROR && answer->addressCount > 0 ? OUTCOME_ANSWERED : OUTCOME_FAILED;
+        return true;
+    }
+}
+
+static void updateStats(Server& server, const Query& query) {
+    DnsServerStats& stats = server.stats;
+
+    if (query.sends == 0) {
+        return;
+    }
+
+    stats.queries++;
+    stats.retransmits += (unsigned long long)(query.sends - 1);
+
+    if (query.outcome == OUTCOME_ANSWERED) {
+        stats.answers++;
+    }
+    else if (query.outcome == OUTCOME_FAILED) {
+        stats.failures++;
+    }
+
+    if (query.rtt != 0) {
+        if (stats.srttMs == 0) {
+            stats.srttMs = query.rtt;
+            stats.rttvarMs = query.rtt / 2;
+        }
+        else {
+            unsigned int deviation = stats.srttMs > query.rtt ? stats.srttMs - query.rtt : query.rtt - stats.srttMs;
+            stats.rttvarMs = (3 * stats.rttvarMs + deviation) / 4;
+            stats.srttMs = (7 * stats.srttMs + query.rtt) / 8;
+        }
+
+        stats.rtoMs = clampRto((unsigned long long)stats.srttMs + 4ULL * stats.rttvarMs);
+    }
+    else if (query.timedOut) {
+        // Keep the backed-off timeout until an answer measures the server again.
+        stats.rtoMs = query.rto;
+    }
+}
+
+DnsProbe::DnsProbe(unsigned long long maxCacheTtlMs, unsigned long long failureCacheTtlMs) {
+    impl = new Impl(maxCacheTtlMs, failureCacheTtlMs);
+    impl->port = 53;
+    impl->random = milliseconds() ^ (unsigned long long)reinterpret_cast<size_t>(impl) ^ 0x9e3779b97f4a7c15ULL;
+
+#if defined(_MSC_VER)
+    WSADATA data;
+    impl->socketsStarted = WSAStartup(MAKEWORD(2, 2), &data) == 0;
+#else
+    impl->socketsStarted = true;
+#endif
+}
+
+DnsProbe::~DnsProbe() {
+#if defined(_MSC_VER)
+    if (impl->socketsStarted) {
+        WSACleanup();
+    }
+#endif
+
+    delete impl;
+}
+
+bool DnsProbe::SetServers(const DnsAddress* servers, size_t count, unsigned short port) {
+    if (count > DNS_PROBE_MAX_SERVERS) {
+        return false;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (servers[i].length != 4 && servers[i].length != 16) {
+            return false;
+        }
+    }
+
+    std::lock_guard<std::mutex> guard(impl->lock);
+
+    std::vector<Server> replaced(count);
+    bool changed = count != impl->servers.size() || port != impl->port;
+
+    for (size_t i = 0; i < count; i++) {
+        Server& server = replaced[i];
+        memset(&server, 0, sizeof(server));
+        server.address = servers[i];
+        server.stats.rtoMs = DNS_PROBE_INITIAL_RTO_MS;
+
+        bool known = false;
+
+        for (size_t k = 0; k < impl->servers.size() && !known; k++) {
+            if (sameAddress(impl->servers[k].address, servers[i])) {
+                server.stats = impl->servers[k].stats;
+                known = true;
+                changed |= k != i;
+            }
+        }
+
+        changed |= !known;
+    }
+
+    impl->servers.swap(replaced);
+    impl->port = port;
+
+    if (changed) {
+        impl->cache.Clear();
+    }
+
+    return true;
+}
+
+size_t DnsProbe::ServerCount() const {
+    std::lock_guard<std::mutex> guard(impl->lock);
+    return impl->servers.size();
+}
+
+bool DnsProbe::Probe(const char* name, unsigned short type, unsigned int timeoutMs, DnsProbeResult* result) {
+    memset(result, 0, sizeof(*result));
+    result->server = -1;
+
+    if (!impl->socketsStarted || (type != DNS_TYPE_A && type != DNS_TYPE_AAAA)) {
+        return false;
+    }
+
+    std::vector<Query> queries;
+    unsigned short port;
+
+    {
+        std::lock_guard<std::mutex> guard(impl->lock);
+
+        queries.resize(impl->servers.size());
+        port = impl->port;
+
+        for (size_t i = 0; i < queries.size(); i++) {
+            Query& query = queries[i];
+            memset(&query, 0, sizeof(query));
+
+            impl->random ^= impl->random << 13;
+            impl->random ^= impl->random >> 7;
+            impl->random ^= impl->random << 17;
+
+            query.address = impl->servers[i].address;
+            query.id = (unsigned short)impl->random;
+            query.rto = impl->servers[i].stats.rtoMs;
+            query.outcome = OUTCOME_PENDING;
+        }
+    }
+
+    for (size_t i = 0; i < queries.size(); i++) {
+        queries[i].length = DnsMessage::BuildQuery(queries[i].id, name, type, queries[i].message, sizeof(queries[i].message));
+
+        if (queries[i].length == 0) {
+            return false;
+        }
+    }
+
+    unsigned long long start = milliseconds();
+    unsigned long long deadline = start + timeoutMs;
+
+    for (size_t i = 0; i < queries.size(); i++) {
+        queries[i].socket = openSocket(queries[i].address, port);
+
+        if (queries[i].socket == INVALID_SOCKET) {
+            queries[i].outcome = OUTCOME_FAILED;
+        }
+        else {
+            transmit(queries[i], start);
+        }
+    }
+
+    std::vector<PollDescriptor> descriptors;
+    std::vector<size_t> polled;
+
+    while (result->server < 0) {
+        unsigned long long now = milliseconds();
+        unsigned long long wakeAt = deadline;
+
+        descriptors.clear();
+        polled.clear();
+
+        for (size_t i = 0; i < queries.size(); i++) {
+            Query& query = queries[i];
+
+            if (query.outcome != OUTCOME_PENDING) {
+                continue;
+            }
+
+            if (now >= query.nextSendAt) {
+                if (query.sends >= DNS_PROBE_MAX_ATTEMPTS) {
+                    query.outcome = OUTCOME_FAILED;
+                    query.timedOut = true;
+                    continue;
+                }
+
+                transmit(query, now);
+            }
+
+            if (query.nextSendAt < wakeAt) {
+                wakeAt = query.nextSendAt;
+            }
+
+            PollDescriptor descriptor;
+            memset(&descriptor, 0, sizeof(descriptor));
+            descriptor.fd = query.socket;
+            descriptor.events = POLLIN;
+
+            descriptors.push_back(descriptor);
+            polled.push_back(i);
+        }
+
+        if (descriptors.empty() || now >= deadline) {
+            break;
+        }
+
+        int waitMs = wakeAt > now ? (int)(wakeAt - now) : 0;
+
+#if defined(_MSC_VER)
+        int ready = WSAPoll(descriptors.data(), (ULONG)descriptors.size(), waitMs);
+#else
+        int ready = poll(descriptors.data(), (nfds_t)descriptors.size(), waitMs);
+#endif
+
+        if (ready <= 0) {
+            continue;
+        }
+
+        now = milliseconds();
+
+        for (size_t k = 0; k < descriptors.size(); k++) {
+            if (descriptors[k].revents == 0) {
+                continue;
+            }
+
+            Query& query = queries[polled[k]];
+            DnsAnswer answer;
+
+            if (receive(query, type, now, &answer) && query.outcome == OUTCOME_ANSWERED) {
+                result->up = true;
+                result->server = (int)polled[k];
+                result->answer = answer;
+                break;
+            }
+        }
+    }
+
+    result->elapsedMs = (unsigned int)(milliseconds() - start);
+
+    for (size_t i = 0; i < queries.size(); i++) {
+        if (queries[i].outcome == OUTCOME_PENDING) {
+            queries[i].outcome = OUTCOME_ABANDONED;
+        }
+
+        if (queries[i].socket != INVALID_SOCKET) {
+            closeSocket(queries[i].socket);
+        }
+    }
+
+    std::lock_guard<std::mutex> guard(impl->lock);
+
+    // The list may have been replaced while the probe ran.
+    for (size_t i = 0; i < queries.size(); i++) {
+        for (size_t k = 0; k < impl->servers.size(); k++) {
+            if (sameAddress(impl->servers[k].address, queries[i].address)) {
+                updateStats(impl->servers[k], queries[i]);
+                break;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool DnsProbe::Resolve(const char* name, unsigned short type, unsigned int timeoutMs, DnsProbeResult* result) {
+    bool up;
+    DnsAnswer answer;
+
+    if (impl->cache.Find(name, type, milliseconds(), &up, &answer)) {
+        memset(result, 0, sizeof(*result));
+        result->up = up;
+        result->server = -1;
+        result->fromCache = true;
+        result->answer = answer;
+        return true;
+    }
+
+    if (!Probe(name, type, timeoutMs, result)) {
+        return false;
+    }
+
+    if (result->up) {
+        impl->cache.Store(name, type, result->answer, milliseconds());
+    }
+    else if (ServerCount() > 0) {
+        impl->cache.StoreFailure(name, type, milliseconds());
+    }
+
+    return true;
+}
+
+void DnsProbe::FlushCache() {
+    impl->cache.Clear();
+}
+
+bool DnsProbe::GetStats(size_t server, DnsServerStats* stats) const {
+    std::lock_guard<std::mutex> guard(impl->lock);
+
+    if (server >= impl->servers.size()) {
+        return false;
+    }
+
+    *stats = impl->servers[server].stats;
+    return true;
+}
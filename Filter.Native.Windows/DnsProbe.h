@@ -0,0 +1,87 @@
+#pragma once
+
+#include "DnsMessage.h"
+
+#define DNS_PROBE_MAX_SERVERS 8
+
+// Sends of one query to a server before it counts as not answering.
+#define DNS_PROBE_MAX_ATTEMPTS 3
+
+// Bounds on the retransmission timeout, and where it starts before a server has been timed.
+#define DNS_PROBE_MIN_RTO_MS 50
+#define DNS_PROBE_MAX_RTO_MS 1000
+#define DNS_PROBE_INITIAL_RTO_MS 250
+
+typedef struct DnsServerStats {
+    // Smoothed round trip and its mean deviation, both zero until the server has answered once.
+    unsigned int srttMs;
+    unsigned int rttvarMs;
+    unsigned int rtoMs;
+
+    unsigned long long queries;
+    unsigned long long retransmits;
+    unsigned long long answers;
+
+    // Probes where the server refused the query, answered without an address, or never answered.
+    unsigned long long failures;
+} DnsServerStats;
+
+typedef struct DnsProbeResult {
+    // True if a server answered with at least one address.
+    bool up;
+
+    // Index of the server that answered, or -1.
+    int server;
+
+    bool fromCache;
+    unsigned int elapsedMs;
+
+    DnsAnswer answer;
+} DnsProbeResult;
+
+/// Checks that the configured resolvers are answering by asking all of them at once over UDP, and
+/// returns as soon as one answers with an address or every one of them has failed.
+///
+/// Each server gets its own connected socket, so a closed port comes back as an error at once
+/// instead of waiting out a timeout. Queries a server doesn't answer are sent again after its
+/// retransmission timeout, which follows its measured round trip times (RFC 6298, with Karn's rule)
+/// and carries over from one probe to the next.
+///
+/// Resolve() puts a TTL-respecting cache in front of the probe, so repeated checks of the same name
+/// don't go to the network while the last answer is still good.
+///
+/// Any number of probes can run at once. The socket and threading types live in the .cpp so that
+/// this header can be included from /clr code.
+class DnsProbe {
+public:
+    /// See DnsCache for the TTLs.
+    DnsProbe(unsigned long long maxCacheTtlMs, unsigned long long failureCacheTtlMs);
+    ~DnsProbe();
+
+    /// Replaces the servers to probe. Each address is 4 or 16 bytes. Timing of servers that were
+    /// already in the list is kept, and the cache is cleared if the list changed.
+    /// Returns false, leaving the list as it was, if an address is the wrong length or there are more
+    /// than DNS_PROBE_MAX_SERVERS.
+    bool SetServers(const DnsAddress* servers, size_t count, unsigned short port);
+
+    size_t ServerCount() const;
+
+    /// Queries every server for name and waits up to timeoutMs for a verdict.
+    /// Returns false if name can't be put in a query, type is neither A nor AAAA, or sockets aren't
+    /// available. A server whose socket can't be opened just counts as failed.
+    bool Probe(const char* name, unsigned short type, unsigned int timeoutMs, DnsProbeResult* result);
+
+    /// Like Probe(), but answers from the cache while it can and stores what the probe finds.
+    bool Resolve(const char* name, unsigned short type, unsigned int timeoutMs, DnsProbeResult* result);
+
+    void FlushCache();
+
+    bool GetStats(size_t server, DnsServerStats* stats) const;
+
+private:
+    DnsProbe(const DnsProbe&);
+    DnsProbe& operator=(const DnsProbe&);
+
+    struct Impl;
+    Impl* impl;
+};
@@ -0,0 +1,187 @@
+#include "ExemptionTable.h"
+
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#define INITIAL_CAPACITY 256
+
+namespace {
+    typedef struct Entry {
+        unsigned char thumbprint[EXEMPTION_MAX_THUMBPRINT];
+        size_t length;
+        unsigned long long hostHash;
+        std::atomic<long long> expiresAt;
+    } Entry;
+
+    // Open addressing with linear probing. Kept at most half full, so every probe ends on an empty slot.
+    typedef struct Slots {
+        size_t mask;
+        std::atomic<Entry*>* slots;
+    } Slots;
+}
+
+struct ExemptionTableState {
+    std::atomic<Slots*> current;
+
+    // Everything below is only touched with writeLock held.
+    std::mutex writeLock;
+    std::vector<Entry*> entries;
+
+    // Tables that have been replaced by a bigger one. A lookup that started before the switch can
+    // still be probing them, so they live as long as the table does.
+    std::vector<Slots*> retired;
+};
+
+static Slots* newSlots(size_t capacity) {
+    Slots* slots = new Slots();
+    slots->mask = capacity - 1;
+    slots->slots = new std::atomic<Entry*>[capacity];
+
+    for (size_t i = 0; i < capacity; i++) {
+        slots->slots[i].store(NULL, std::memory_order_relaxed);
+    }
+
+    return slots;
+}
+
+static void deleteSlots(Slots* slots) {
+    delete[] slots->slots;
+    delete slots;
+}
+
+static size_t slotHash(const unsigned char* thumbprint, size_t length, unsigned long long hostHash) {
+    // Thumbprints are already uniformly distributed, so their first bytes are as good as any hash of them.
+    unsigned long long value = 0;
+    memcpy(&value, thumbprint, length < sizeof(value) ? length : sizeof(value));
+
+    value ^= hostHash;
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdULL;
+    value ^= value >> 33;
+
+    return (size_t)value;
+}
+
+static bool matches(const Entry* entry, const unsigned char* thumbprint, size_t length, unsigned long long hostHash) {
+    return entry->hostHash == hostHash && entry->length == length && memcmp(entry->thumbprint, thumbprint, length) == 0;
+}
+
+static Entry* find(const Slots* slots, const unsigned char* thumbprint, size_t length, unsigned long long hostHash) {
+    size_t index = slotHash(thumbprint, length, hostHash) & slots->mask;
+
+    while (true) {
+        Entry* entry = slots->slots[index].load(std::memory_order_acquire);
+
+        if (entry == NULL || matches(entry, thumbprint, length, hostHash)) {
+            return entry;
+        }
+
+        index = (index + 1) & slots->mask;
+    }
+}
+
+static void insert(Slots* slots, Entry* entry) {
+    size_t index = slotHash(entry->thumbprint, entry->length, entry->hostHash) & slots->mask;
+
+    while (slots->slots[index].load(std::memory_order_relaxed) != NULL) {
+        index = (index + 1) & slots->mask;
+    }
+
+    // Publishes the entry's fields along with it.
+    slots->slots[index].store(entry, std::memory_order_release);
+}
+
+ExemptionTable::ExemptionTable() {
+    state = new ExemptionTableState();
+    state->current.store(newSlots(INITIAL_CAPACITY), std::memory_order_relaxed);
+}
+
+ExemptionTable::~ExemptionTable() {
+    deleteSlots(state->current.load(std::memory_order_relaxed));
+
+    for (size_t i = 0; i < state->retired.size(); i++) {
+        deleteSlots(state->retired[i]);
+    }
+
+    for (size_t i = 0; i < state->entries.size(); i++) {
+        delete state->entries[i];
+    }
+
+    delete state;
+}
+
+bool ExemptionTable::IsExempted(const unsigned char* thumbprint, size_t length, unsigned long long hostHash, long long now) const {
+    if (length == 0 || length > EXEMPTION_MAX_THUMBPRINT) {
+        return false;
+    }
+
+    const Entry* entry = find(state->current.load(std::memory_order_acquire), thumbprint, length, hostHash);
+
+    return entry != NULL && now < entry->expiresAt.load(std::memory_order_relaxed);
+}
+
+bool ExemptionTable::Set(const unsigned char* thumbprint, size_t length, unsigned long long hostHash, long long expiresAt) {
+    if (length == 0 || length > EXEMPTION_MAX_THUMBPRINT) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> guard(state->writeLock);
+
+    Slots* slots = state->current.load(std::memory_order_relaxed);
+
+    Entry* existing = find(slots, thumbprint, length, hostHash);
+    if (existing != NULL) {
+        existing->expiresAt.store(expiresAt, std::memory_order_relaxed);
+        return true;
+    }
+
+    if ((state->entries.size() + 1) * 2 > slots->mask + 1) {
+        Slots* bigger = newSlots((slots->mask + 1) * 2);
+
+        for (size_t i = 0; i < state->entries.size(); i++) {
+            insert(bigger, state->entries[i]);
+        }
+
+        state->current.store(bigger, std::memory_order_release);
+        state->retired.push_back(slots);
+        slots = bigger;
+    }
+
+    Entry* entry = new Entry();
+    memcpy(entry->thumbprint, thumbprint, length);
+    entry->length = length;
+    entry->hostHash = hostHash;
+    entry->expiresAt.store(expiresAt, std::memory_order_relaxed);
+
+    state->entries.push_back(entry);
+    insert(slots, entry);
+
+    return true;
+}
+
+size_t ExemptionTable::Count() const {
+    std::lock_guard<std::mutex> guard(state->writeLock);
+    return state->entries.size();
+}
+
+unsigned long long ExemptionTable::HashHost(const wchar_t* host, size_t length) {
+    // FNV-1a over the UTF-16 code units.
+    unsigned long long hash = 0xcbf29ce484222325ULL;
+
+    for (size_t i = 0; i < length; i++) {
+        unsigned int c = (unsigned int)host[i];
+
+        if (c >= 'A' && c <= 'Z') {
+            c += 'a' - 'A';
+        }
+
+        hash ^= c & 0xFF;
+        hash *= 0x100000001b3ULL;
+        hash ^= (c >> 8) & 0xFF;
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
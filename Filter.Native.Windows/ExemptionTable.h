@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+
+// Longest certificate hash the table keys on. SHA-1 thumbprints are 20 bytes.
+#define EXEMPTION_MAX_THUMBPRINT 32
+
+#define EXEMPTION_NEVER_EXPIRES 0x7FFFFFFFFFFFFFFFLL
+
+struct ExemptionTableState;
+
+/// Certificate exemptions keyed by (certificate thumbprint, host hash), each with the time it stops
+/// applying. Times are whatever units the caller passes in, as long as they are the same for
+/// Set() and IsExempted().
+///
+/// Lookups take no lock and write nothing shared, so any number of threads can check at once
+/// without contending. Set() is serialized internally and can run alongside lookups. Entries are
+/// never removed, only expired, so a lookup never reads freed memory.
+class ExemptionTable {
+public:
+    ExemptionTable();
+
+    /// Must not overlap with any other call.
+    ~ExemptionTable();
+
+    bool IsExempted(const unsigned char* thumbprint, size_t length, unsigned long long hostHash, long long now) const;
+
+    /// Adds an exemption or changes when an existing one expires. Returns false if the thumbprint
+    /// is empty or longer than EXEMPTION_MAX_THUMBPRINT.
+    bool Set(const unsigned char* thumbprint, size_t length, unsigned long long hostHash, long long expiresAt);
+
+    size_t Count() const;
+
+    /// Case-insensitive for ASCII, like host names.
+    static unsigned long long HashHost(const wchar_t* host, size_t length);
+
+private:
+    ExemptionTable(const ExemptionTable&);
+    ExemptionTable& operator=(const ExemptionTable&);
+
+    ExemptionTableState* state;
+};
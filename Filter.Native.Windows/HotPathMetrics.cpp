@@ -0,0 +1,251 @@
+#include "HotPathMetrics.h"
+
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#define HOT_PATH_MAX_VALUE ((1ULL << HOT_PATH_MAX_VALUE_BITS) - 1)
+
+namespace {
+    // Only the owning thread writes these, so a relaxed load and store stands in for an atomic
+    // add without the locked instruction. The atomics are there so that snapshots read whole values.
+    typedef std::atomic<unsigned long long> Cell;
+
+    struct MetricSlot {
+        Cell count;
+        Cell total;
+        Cell max;
+        Cell buckets[HOT_PATH_HISTOGRAM_BUCKETS];
+    };
+
+    struct ThreadMetrics {
+        MetricSlot metrics[HOT_PATH_METRIC_COUNT];
+        Cell counters[HOT_PATH_COUNTER_COUNT];
+    };
+
+    struct Registry {
+        std::mutex lock;
+        std::vector<ThreadMetrics*> live;
+
+        // Everything recorded by threads that have exited.
+        HotPathSnapshot retired;
+        unsigned long long threads;
+    };
+
+    // Registers the calling thread's slot on first use and retires it when the thread exits.
+    class ThreadSlot {
+    public:
+        ThreadSlot() : metrics(NULL) {
+        }
+
+        ~ThreadSlot();
+
+        ThreadMetrics* Get() {
+            if (metrics == NULL) {
+                metrics = registerThread();
+            }
+
+            return metrics;
+        }
+
+    private:
+        static ThreadMetrics* registerThread();
+
+        ThreadMetrics* metrics;
+    };
+}
+
+static Registry& registry() {
+    // Never destroyed, since threads can still exit after static destructors have run.
+    static Registry* shared = NULL;
+    static std::once_flag created;
+
+    std::call_once(created, [] {
+        shared = new Registry();
+        memset(&shared->retired, 0, sizeof(shared->retired));
+        shared->threads = 0;
+    });
+
+    return *shared;
+}
+
+static inline void bump(Cell& cell, unsigned long long amount) {
+    cell.store(cell.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+static inline unsigned int highestBit(unsigned long long value) {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return (unsigned int)index;
+#elif defined(_MSC_VER)
+    unsigned long index;
+    if (_BitScanReverse(&index, (unsigned long)(value >> 32))) {
+        return (unsigned int)index + 32;
+    }
+
+    _BitScanReverse(&index, (unsigned long)value);
+    return (unsigned int)index;
+#else
+    return 63 - (unsigned int)__builtin_clzll(value);
+#endif
+}
+
+static void addSlot(HotPathSnapshot* snapshot, const ThreadMetrics* metrics) {
+    for (int i = 0; i < HOT_PATH_METRIC_COUNT; i++) {
+        const MetricSlot& slot = metrics->metrics[i];
+        HotPathHistogram& histogram = snapshot->metrics[i];
+
+        unsigned long long count = slot.count.load(std::memory_order_relaxed);
+        if (count == 0) {
+            continue;
+        }
+
+        histogram.count += count;
+        histogram.totalNanoseconds += slot.total.load(std::memory_order_relaxed);
+
+        unsigned long long max = slot.max.load(std::memory_order_relaxed);
+        if (max > histogram.maxNanoseconds) {
+            histogram.maxNanoseconds = max;
+        }
+
+        for (size_t b = 0; b < HOT_PATH_HISTOGRAM_BUCKETS; b++) {
+            histogram.buckets[b] += slot.buckets[b].load(std::memory_order_relaxed);
+        }
+    }
+
+    for (int i = 0; i < HOT_PATH_COUNTER_COUNT; i++) {
+        snapshot->counters[i] += metrics->counters[i].load(std::memory_order_relaxed);
+    }
+}
+
+ThreadMetrics* ThreadSlot::registerThread() {
+    ThreadMetrics* metrics = new ThreadMetrics();
+    memset(static_cast<void*>(metrics), 0, sizeof(ThreadMetrics));
+
+    Registry& shared = registry();
+    std::lock_guard<std::mutex> guard(shared.lock);
+    shared.live.push_back(metrics);
+    shared.threads++;
+
+    return metrics;
+}
+
+ThreadSlot::~ThreadSlot() {
+    if (metrics == NULL) {
+        return;
+    }
+
+    Registry& shared = registry();
+    std::lock_guard<std::mutex> guard(shared.lock);
+
+    addSlot(&shared.retired, metrics);
+
+    for (size_t i = 0; i < shared.live.size(); i++) {
+        if (shared.live[i] == metrics) {
+            shared.live[i] = shared.live.back();
+            shared.live.pop_back();
+            break;
+        }
+    }
+
+    delete metrics;
+}
+
+static ThreadMetrics* currentThread() {
+    static thread_local ThreadSlot slot;
+    return slot.Get();
+}
+
+size_t HotPathMetrics::BucketIndex(unsigned long long nanoseconds) {
+    if (nanoseconds > HOT_PATH_MAX_VALUE) {
+        nanoseconds = HOT_PATH_MAX_VALUE;
+    }
+
+    if (nanoseconds < 2 * HOT_PATH_SUB_BUCKETS) {
+        return (size_t)nanoseconds;
+    }
+
+    unsigned int shift = highestBit(nanoseconds) - HOT_PATH_SUB_BUCKET_BITS;
+    return (size_t)shift * HOT_PATH_SUB_BUCKETS + (size_t)(nanoseconds >> shift);
+}
+
+unsigned long long HotPathMetrics::BucketLowerBound(size_t index) {
+    if (index < 2 * HOT_PATH_SUB_BUCKETS) {
+        return index;
+    }
+
+    unsigned int shift = (unsigned int)(index / HOT_PATH_SUB_BUCKETS) - 1;
+    unsigned long long mantissa = index - (size_t)shift * HOT_PATH_SUB_BUCKETS;
+    return mantissa << shift;
+}
+
+void HotPathMetrics::Record(int metric, unsigned long long nanoseconds) {
+    if (metric < 0 || metric >= HOT_PATH_METRIC_COUNT) {
+        return;
+    }
+
+    MetricSlot& slot = currentThread()->metrics[metric];
+
+    bump(slot.count, 1);
+    bump(slot.total, nanoseconds);
+    bump(slot.buckets[BucketIndex(nanoseconds)], 1);
+
+    if (nanoseconds > slot.max.load(std::memory_order_relaxed)) {
+        slot.max.store(nanoseconds, std::memory_order_relaxed);
+    }
+}
+
+void HotPathMetrics::Add(int counter, unsigned long long amount) {
+    if (counter < 0 || counter >= HOT_PATH_COUNTER_COUNT) {
+        return;
+    }
+
+    bump(currentThread()->counters[counter], amount);
+}
+
+void HotPathMetrics::Snapshot(HotPathSnapshot* snapshot) {
+    Registry& shared = registry();
+    std::lock_guard<std::mutex> guard(shared.lock);
+
+    memcpy(snapshot, &shared.retired, sizeof(HotPathSnapshot));
+
+    for (size_t i = 0; i < shared.live.size(); i++) {
+        addSlot(snapshot, shared.live[i]);
+    }
+
+    snapshot->threads = shared.threads;
+}
+
+unsigned long long HotPathMetrics::ValueAtPercentile(const HotPathHistogram& histogram, double percentile) {
+    if (histogram.count == 0) {
+        return 0;
+    }
+
+    if (percentile > 100.0) {
+        percentile = 100.0;
+    }
+
+    // Buckets are summed one at a time while threads record, so they can run a little ahead of
+    // count. Rank against count and fall through to the max if the buckets never reach it.
+    unsigned long long rank = (unsigned long long)(percentile / 100.0 * (double)histogram.count + 0.5);
+    if (rank == 0) {
+        rank = 1;
+    }
+
+    unsigned long long seen = 0;
+    for (size_t b = 0; b < HOT_PATH_HISTOGRAM_BUCKETS; b++) {
+        seen += histogram.buckets[b];
+        if (seen >= rank) {
+            unsigned long long highest = BucketLowerBound(b + 1) - 1;
+            return highest < histogram.maxNanoseconds ? highest : histogram.maxNanoseconds;
+        }
+    }
+
+    return histogram.maxNanoseconds;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+
+// Latency metrics. Each one keeps a histogram of its samples in nanoseconds.
+#define HOT_PATH_TRIGGER_SCAN 0
+#define HOT_PATH_URL_LOOKUP 1
+#define HOT_PATH_DIVERSION_EVENT 2
+#define HOT_PATH_LIST_RELOAD 3
+#define HOT_PATH_IPC_SEND 4
+#define HOT_PATH_CONFLICT_SCAN 5
+#define HOT_PATH_SCAN_WAIT 6
+#define HOT_PATH_METRIC_COUNT 7
+
+// Monotonic counters.
+#define HOT_PATH_BYTES_SCANNED 0
+#define HOT_PATH_TRIGGER_MATCHES 1
+#define HOT_PATH_URLS_BLOCKED 2
+#define HOT_PATH_DIVERSION_ERRORS 3
+#define HOT_PATH_VERDICT_HITS 4
+#define HOT_PATH_VERDICT_MISSES 5
+#define HOT_PATH_VERDICT_BYTES_SKIPPED 6
+#define HOT_PATH_SCANS_TRUNCATED 7
+#define HOT_PATH_SCANS_DEFERRED 8
+#define HOT_PATH_SCANS_REFUSED 9
+#define HOT_PATH_TRIGGERS_LEFT_OUT 10
+#define HOT_PATH_COUNTER_COUNT 11
+
+// Buckets are exact below 2^(SUB_BUCKET_BITS + 1) ns. Above that every power of two is split into
+// 2^SUB_BUCKET_BITS buckets, so any value is reported within 1/16th of itself.
+#define HOT_PATH_SUB_BUCKET_BITS 4
+#define HOT_PATH_SUB_BUCKETS (1 << HOT_PATH_SUB_BUCKET_BITS)
+
+// Samples are clamped to 2^40 ns, a bit over 18 minutes.
+#define HOT_PATH_MAX_VALUE_BITS 40
+#define HOT_PATH_HISTOGRAM_BUCKETS (HOT_PATH_SUB_BUCKETS * (HOT_PATH_MAX_VALUE_BITS - HOT_PATH_SUB_BUCKET_BITS + 1))
+
+typedef struct HotPathHistogram {
+    unsigned long long count;
+    unsigned long long totalNanoseconds;
+    unsigned long long maxNanoseconds;
+    unsigned long long buckets[HOT_PATH_HISTOGRAM_BUCKETS];
+} HotPathHistogram;
+
+typedef struct HotPathSnapshot {
+    HotPathHistogram metrics[HOT_PATH_METRIC_COUNT];
+    unsigned long long counters[HOT_PATH_COUNTER_COUNT];
+
+    // Threads that have recorded something since the process started, live or not.
+    unsigned long long threads;
+} HotPathSnapshot;
+
+/// Process-wide latency histograms and counters for the filtering hot paths.
+///
+/// Every thread records into its own slot with plain relaxed stores, so recording never takes a
+/// lock or contends on a cache line. Snapshot() sums the slots of live threads with whatever
+/// threads that have exited left behind. A snapshot taken while other threads record can be a
+/// few samples behind, but counts never go backwards between snapshots.
+class HotPathMetrics {
+public:
+    static void Record(int metric, unsigned long long nanoseconds);
+
+    static void Add(int counter, unsigned long long amount);
+
+    static void Snapshot(HotPathSnapshot* snapshot);
+
+    static size_t BucketIndex(unsigned long long nanoseconds);
+
+    // Smallest value that lands in a bucket.
+    static unsigned long long BucketLowerBound(size_t index);
+
+    /// Highest value a histogram could have at the given percentile, in (0, 100]. Zero for an
+    /// empty histogram.
+    static unsigned long long ValueAtPercentile(const HotPathHistogram& histogram, double percentile);
+
+private:
+    HotPathMetrics();
+};
@@ -0,0 +1,250 @@
+#include "JobSchedule.h"
+
+#include <cstring>
+
+static unsigned long long alignmentFor(unsigned int slackMs) {
+    unsigned long long alignment = 1;
+
+    while (alignment * 2 <= slackMs) {
+        alignment *= 2;
+    }
+
+    return alignment;
+}
+
+JobSchedule::JobSchedule(unsigned long long now, unsigned long long seed) : wheel(now), random(seed != 0 ? seed : 0x9E3779B97F4A7C15ULL) {
+    memset(&stats, 0, sizeof(stats));
+}
+
+unsigned int JobSchedule::AddJob(unsigned int periodMs, unsigned int slackMs, double jitter, unsigned int maxBackoffMs) {
+    Job job;
+    memset(&job, 0, sizeof(job));
+
+    job.periodMs = periodMs;
+    job.slackMs = slackMs;
+    job.jitter = jitter < 0 ? 0 : (jitter > 0.99 ? 0.99 : jitter);
+    job.maxBackoffMs = maxBackoffMs;
+
+    jobs.push_back(job);
+    return (unsigned int)(jobs.size() - 1);
+}
+
+void JobSchedule::Start(unsigned int job, unsigned long long delayMs, unsigned long long now) {
+    if (job >= jobs.size()) {
+        return;
+    }
+
+    Job& state = jobs[job];
+
+    if (state.running) {
+        if (!state.startPending) {
+            stats.deferred++;
+        }
+
+        // Nothing runs until the current run completes, so there is no point waking up for it.
+        wheel.Disarm(job);
+
+        state.periodArmed = false;
+        state.overrun = false;
+        state.startPending = true;
+        state.stopPending = false;
+        state.pendingDelayMs = delayMs;
+        return;
+    }
+
+    state.periodArmed = false;
+    arm(job, delayMs, now);
+}
+
+void JobSchedule::Stop(unsigned int job) {
+    if (job >= jobs.size()) {
+        return;
+    }
+
+    Job& state = jobs[job];
+
+    wheel.Disarm(job);
+
+    state.periodArmed = false;
+    state.overrun = false;
+
+    if (state.running) {
+        state.startPending = false;
+        state.stopPending = true;
+    }
+}
+
+void JobSchedule::SetPeriod(unsigned int job, unsigned int periodMs) {
+    if (job >= jobs.size()) {
+        return;
+    }
+
+    Job& state = jobs[job];
+    state.periodMs = periodMs;
+
+    if (state.running && state.periodArmed) {
+        if (periodMs > 0) {
+            arm(job, periodMs, state.startedAt);
+        }
+        else {
+            wheel.Disarm(job);
+            state.periodArmed = false;
+        }
+    }
+}
+
+void JobSchedule::Expire(unsigned long long now, std::vector<unsigned int>& due) {
+    expired.clear();
+    wheel.Advance(now, expired);
+
+    size_t started = 0;
+
+    for (size_t i = 0; i < expired.size(); i++) {
+        unsigned int job = expired[i];
+        Job& state = jobs[job];
+
+        if (state.running) {
+            // Still busy with the last one. Complete() schedules the next.
+            state.overrun = true;
+            state.periodArmed = false;
+            stats.deferred++;
+            continue;
+        }
+
+        state.running = true;
+        state.startedAt = now;
+        state.periodArmed = state.periodMs > 0;
+
+        if (state.periodArmed) {
+            arm(job, state.periodMs, now);
+        }
+
+        due.push_back(job);
+        started++;
+    }
+
+    stats.runs += started;
+
+    if (started > 1) {
+        stats.coalesced += started - 1;
+    }
+}
+
+void JobSchedule::Complete(unsigned int job, bool succeeded, unsigned long long now) {
+    if (job >= jobs.size() || !jobs[job].running) {
+        return;
+    }
+
+    Job& state = jobs[job];
+    state.running = false;
+
+    if (succeeded) {
+        state.failures = 0;
+    }
+    else {
+        stats.failures++;
+
+        if (state.failures < JOB_MAX_BACKOFF_DOUBLINGS) {
+            state.failures++;
+        }
+    }
+
+    if (state.stopPending) {
+        state.stopPending = false;
+        return;
+    }
+
+    if (state.startPending) {
+        state.startPending = false;
+        arm(job, state.pendingDelayMs, now);
+        return;
+    }
+
+    if (state.overrun && state.periodMs > 0) {
+        state.overrun = false;
+        state.periodArmed = true;
+        arm(job, nextDelay(state), now);
+        return;
+    }
+
+    if (!succeeded && state.periodArmed && nextDelay(state) > state.periodMs) {
+        arm(job, nextDelay(state), now);
+    }
+}
+
+void JobSchedule::CountWakeup(bool idle) {
+    stats.wakeups++;
+
+    if (idle) {
+        stats.idleWakeups++;
+    }
+}
+
+unsigned long long JobSchedule::NextDeadline() const {
+    return wheel.NextExpiry();
+}
+
+bool JobSchedule::IsRunning(unsigned int job) const {
+    return job < jobs.size() && jobs[job].running;
+}
+
+unsigned long long JobSchedule::nextDelay(const Job& state) const {
+    unsigned long long delay = state.periodMs;
+
+    if (state.failures > 0 && state.maxBackoffMs > state.periodMs) {
+        delay = (unsigned long long)state.periodMs << state.failures;
+
+        if (delay > state.maxBackoffMs) {
+            delay = state.maxBackoffMs;
+        }
+    }
+
+    return delay;
+}
+
+void JobSchedule::arm(unsigned int job, unsigned long long delayMs, unsigned long long now) {
+    const Job& state = jobs[job];
+
+    if (state.jitter > 0 && delayMs > 0) {
+        // Only ever earlier, so that a job never runs later than its period plus its slack.
+        unsigned long long spread = (unsigned long long)(delayMs * state.jitter);
+
+        if (spread > 0) {
+            delayMs -= nextRandom() % (spread + 1);
+        }
+    }
+
+    unsigned long long deadline = now + delayMs;
+
+    if (state.slackMs > 1) {
+        // There are only ever a handful of jobs, so looking at all of them is cheaper than keeping
+        // the deadlines sorted.
+        unsigned long long partner = TIMER_WHEEL_NEVER;
+
+        for (unsigned int other = 0; other < jobs.size(); other++) {
+            unsigned long long expiry = wheel.ExpiryOf(other);
+
+            if (other != job && expiry >= deadline && expiry <= deadline + state.slackMs && expiry < partner) {
+                partner = expiry;
+            }
+        }
+
+        if (partner != TIMER_WHEEL_NEVER) {
+            deadline = partner;
+        }
+        else {
+            unsigned long long alignment = alignmentFor(state.slackMs);
+            deadline = (deadline + alignment - 1) & ~(alignment - 1);
+        }
+    }
+
+    wheel.Arm(job, deadline);
+}
+
+unsigned long long JobSchedule::nextRandom() {
+    // xorshift64. Only spreads deadlines, so it needs to be cheap, not good.
+    random ^= random << 13;
+    random ^= random >> 7;
+    random ^= random << 17;
+    return random;
+}
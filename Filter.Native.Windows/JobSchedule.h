@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "TimerWheel.h"
+
+// Longest a failing job's backoff doubles for, whatever its maximum.
+#define JOB_MAX_BACKOFF_DOUBLINGS 16
+
+typedef struct JobScheduleStats {
+    // Times the dispatcher woke up, and how many of those found nothing due.
+    unsigned long long wakeups;
+    unsigned long long idleWakeups;
+
+    unsigned long long runs;
+    unsigned long long failures;
+
+    // Runs that shared their wakeup with an earlier job in the same batch.
+    unsigned long long coalesced;
+
+    // Runs and starts that came while the job was still running and were held until it finished.
+    unsigned long long deferred;
+} JobScheduleStats;
+
+/// When each of a fixed set of recurring jobs runs next, on top of a TimerWheel with millisecond
+/// ticks. Times are passed in rather than read so that the same schedule can be replayed against
+/// a simulated clock.
+///
+/// Periodic jobs are re-armed for their next run as soon as they are handed out, so finishing a run
+/// normally changes nothing and needs no wakeup. A job never runs twice at once: if it comes due
+/// while it is still running, that run waits until the current one completes and starts a period
+/// after it. Not thread safe; TimerDispatcher adds the locking and the clock.
+class JobSchedule {
+public:
+    JobSchedule(unsigned long long now, unsigned long long seed);
+
+    /// Registers a job and returns its id. A period of zero means it only runs when started.
+    ///
+    /// slackMs is how late the job may run so that it can share a wakeup with others. The job joins
+    /// the earliest deadline already set within its slack, or if there is none, rounds its own up
+    /// to the largest power of two no bigger than the slack, so that later jobs can find it. jitter in [0, 1) is the fraction
+    /// of each delay that may randomly be taken off it, to spread jobs that talk to the same server
+    /// across clients. A non-zero maxBackoffMs makes failed runs double the period, up to that.
+    unsigned int AddJob(unsigned int periodMs, unsigned int slackMs, double jitter, unsigned int maxBackoffMs);
+
+    /// Runs the job once after delayMs and then every period. Replaces any earlier start. If the job
+    /// is running, takes effect when it completes.
+    void Start(unsigned int job, unsigned long long delayMs, unsigned long long now);
+
+    /// Cancels the next run. A run in progress finishes, but is not followed by another.
+    void Stop(unsigned int job);
+
+    /// If the job is running, its next run moves to a period after this one started. Otherwise the
+    /// period applies from the next time the job is armed.
+    void SetPeriod(unsigned int job, unsigned int periodMs);
+
+    /// Moves the clock to now, marks every job due by then as running and arms their next runs.
+    void Expire(unsigned long long now, std::vector<unsigned int>& due);
+
+    /// Records the end of a run. Only moves the job's next run if the run failed and the job backs
+    /// off, or if something was held until the run finished.
+    void Complete(unsigned int job, bool succeeded, unsigned long long now);
+
+    void CountWakeup(bool idle);
+
+    /// Earliest deadline of any armed job, or TIMER_WHEEL_NEVER.
+    unsigned long long NextDeadline() const;
+
+    bool IsRunning(unsigned int job) const;
+
+    size_t JobCount() const { return jobs.size(); }
+
+    JobScheduleStats Stats() const { return stats; }
+
+private:
+    JobSchedule(const JobSchedule&);
+    JobSchedule& operator=(const JobSchedule&);
+
+    typedef struct Job {
+        unsigned int periodMs;
+        unsigned int slackMs;
+        double jitter;
+        unsigned int maxBackoffMs;
+
+        unsigned int failures;
+        bool running;
+        unsigned long long startedAt;
+
+        // Whether the job's current deadline is its period after the run that started at startedAt,
+        // as opposed to one asked for by Start().
+        bool periodArmed;
+
+        // Set when the job came due during its own run. It runs again a period after that run ends.
+        bool overrun;
+
+        // Set by Start() during a run. The delay it asked for is applied when the run completes.
+        bool startPending;
+        unsigned long long pendingDelayMs;
+
+        // Set by Stop() during a run, so that completing it does not re-arm the job.
+        bool stopPending;
+    } Job;
+
+    void arm(unsigned int job, unsigned long long delayMs, unsigned long long now);
+
+    // The period, doubled for every failure in a row if the job backs off.
+    unsigned long long nextDelay(const Job& state) const;
+
+    unsigned long long nextRandom();
+
+    TimerWheel wheel;
+    std::vector<Job> jobs;
+    std::vector<unsigned int> expired;
+
+    unsigned long long random;
+    JobScheduleStats stats;
+};
@@ -0,0 +1,450 @@
+#include <cstring>
+
+#include "JsonStringScanner.h"
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#include <emmintrin.h>
+#define JSON_SCAN_SSE2
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#include <arm_neon.h>
+#define JSON_SCAN_NEON
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#define ESCAPE_NONE 0
+#define ESCAPE_BACKSLASH 1
+#define ESCAPE_HEX_FIRST 2
+#define ESCAPE_HEX_DONE 6
+
+#define REPLACEMENT_CHARACTER 0xFFFD
+
+static inline unsigned int lowestSetBit(unsigned int mask) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (unsigned int)index;
+#else
+    return (unsigned int)__builtin_ctz(mask);
+#endif
+}
+
+#if defined(JSON_SCAN_NEON)
+// Returns the index of the first lane set in a NEON comparison result, or 16 if there is none.
+static inline size_t firstNeonLane(uint8x16_t matches) {
+    uint64_t bits = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(matches), 4)), 0);
+    if (bits == 0) {
+        return 16;
+    }
+
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, bits);
+    return index >> 2;
+#else
+    return (size_t)__builtin_ctzll(bits) >> 2;
+#endif
+}
+#endif
+
+// Finds the next byte that can change the structural state outside of a string.
+// OR-ing with 0x20 folds '[' onto '{' and ']' onto '}', so five compares cover all seven
+// structural characters. The few control characters that fold onto the same values are
+// filtered out again in onStructural().
+static size_t findStructural(const unsigned char* data, size_t length) {
+    size_t i = 0;
+
+#if defined(JSON_SCAN_SSE2)
+    const __m128i fold = _mm_set1_epi8(0x20);
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i openBrace = _mm_set1_epi8('{');
+    const __m128i closeBrace = _mm_set1_epi8('}');
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i colon = _mm_set1_epi8(':');
+
+    for (; i + 16 <= length; i += 16) {
+        __m128i v = _mm_or_si128(_mm_loadu_si128((const __m128i*)(data + i)), fold);
+
+        __m128i matches = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, openBrace)),
+            _mm_or_si128(_mm_cmpeq_epi8(v, closeBrace), _mm_or_si128(_mm_cmpeq_epi8(v, comma), _mm_cmpeq_epi8(v, colon))));
+
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(matches);
+        if (mask != 0) {
+            return i + lowestSetBit(mask);
+        }
+    }
+#elif defined(JSON_SCAN_NEON)
+    const uint8x16_t fold = vdupq_n_u8(0x20);
+
+    for (; i + 16 <= length; i += 16) {
+        uint8x16_t v = vorrq_u8(vld1q_u8(data + i), fold);
+
+        uint8x16_t matches = vorrq_u8(
+            vorrq_u8(vceqq_u8(v, vdupq_n_u8('"')), vceqq_u8(v, vdupq_n_u8('{'))),
+            vorrq_u8(vceqq_u8(v, vdupq_n_u8('}')), vorrq_u8(vceqq_u8(v, vdupq_n_u8(',')), vceqq_u8(v, vdupq_n_u8(':')))));
+
+        size_t lane = firstNeonLane(matches);
+        if (lane < 16) {
+            return i + lane;
+        }
+    }
+#endif
+
+    for (; i < length; i++) {
+        unsigned char c = data[i] | 0x20;
+        if (c == '"' || c == '{' || c == '}' || c == ',' || c == ':') {
+            return i;
+        }
+    }
+
+    return length;
+}
+
+// Finds the next quote or backslash inside a string.
+static size_t findStringSpecial(const unsigned char* data, size_t length) {
+    size_t i = 0;
+
+#if defined(JSON_SCAN_SSE2)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+
+    for (; i + 16 <= length; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)));
+        if (mask != 0) {
+            return i + lowestSetBit(mask);
+        }
+    }
+#elif defined(JSON_SCAN_NEON)
+    const uint8x16_t quote = vdupq_n_u8('"');
+    const uint8x16_t backslash = vdupq_n_u8('\\');
+
+    for (; i + 16 <= length; i += 16) {
+        uint8x16_t v = vld1q_u8(data + i);
+        size_t lane = firstNeonLane(vorrq_u8(vceqq_u8(v, quote), vceqq_u8(v, backslash)));
+        if (lane < 16) {
+            return i + lane;
+        }
+    }
+#endif
+
+    for (; i < length; i++) {
+        if (data[i] == '"' || data[i] == '\\') {
+            return i;
+        }
+    }
+
+    return length;
+}
+
+static inline int hexValue(unsigned char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+
+    c |= 0x20;
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+
+    return -1;
+}
+
+JsonStringScanner::JsonStringScanner(unsigned char separator) : separator(separator) {
+    Reset();
+}
+
+void JsonStringScanner::Reset() {
+    text.clear();
+    spans.clear();
+
+    inString = false;
+    isKey = false;
+    expectKey = false;
+    valueStart = 0;
+
+    escapeState = ESCAPE_NONE;
+    escapeValue = 0;
+    highSurrogate = 0;
+
+    objectBits = 0;
+    depth = 0;
+
+    bytesScanned = 0;
+    keysSkipped = 0;
+}
+
+bool JsonStringScanner::inObject() const {
+    if (depth <= 0 || depth > JSON_SCAN_MAX_DEPTH) {
+        return false;
+    }
+
+    return ((objectBits >> (depth - 1)) & 1) != 0;
+}
+
+void JsonStringScanner::Feed(const unsigned char* data, size_t length) {
+    if (data == NULL) {
+        return;
+    }
+
+    bytesScanned += length;
+
+    size_t i = 0;
+    while (i < length) {
+        if (inString) {
+            i += scanString(data + i, length - i);
+            continue;
+        }
+
+        i += findStructural(data + i, length - i);
+        if (i >= length) {
+            break;
+        }
+
+        unsigned char c = data[i++];
+        if (c == '"') {
+            beginString();
+        }
+        else {
+            onStructural(c);
+        }
+    }
+}
+
+void JsonStringScanner::Finish() {
+    if (inString) {
+        endString(false);
+    }
+}
+
+void JsonStringScanner::onStructural(unsigned char c) {
+    switch (c) {
+    case '{':
+        if (depth < JSON_SCAN_MAX_DEPTH) {
+            objectBits |= (1ULL << depth);
+        }
+
+        depth++;
+        expectKey = true;
+        break;
+
+    case '[':
+        if (depth < JSON_SCAN_MAX_DEPTH) {
+            objectBits &= ~(1ULL << depth);
+        }
+
+        depth++;
+        expectKey = false;
+        break;
+
+    case '}':
+    case ']':
+        if (depth > 0) {
+            depth--;
+        }
+
+        expectKey = false;
+        break;
+
+    case ',':
+        expectKey = inObject();
+        break;
+
+    case ':':
+        expectKey = false;
+        break;
+    }
+}
+
+void JsonStringScanner::beginString() {
+    inString = true;
+    isKey = expectKey && inObject();
+    valueStart = text.size();
+
+    escapeState = ESCAPE_NONE;
+    highSurrogate = 0;
+}
+
+void JsonStringScanner::endString(bool complete) {
+    if (highSurrogate != 0) {
+        appendCodePoint(REPLACEMENT_CHARACTER);
+        highSurrogate = 0;
+    }
+
+    if (isKey) {
+        keysSkipped++;
+        expectKey = false;
+    }
+    else if (text.size() > valueStart) {
+        JsonStringSpan span;
+        span.offset = valueStart;
+        span.length = text.size() - valueStart;
+        span.complete = complete;
+        spans.push_back(span);
+
+        if (separator != 0) {
+            text.push_back(separator);
+        }
+    }
+
+    inString = false;
+    escapeState = ESCAPE_NONE;
+}
+
+void JsonStringScanner::appendCodePoint(unsigned int codePoint) {
+    if (isKey) {
+        return;
+    }
+
+    if (codePoint < 0x80) {
+        text.push_back((unsigned char)codePoint);
+    }
+    else if (codePoint < 0x800) {
+        text.push_back((unsigned char)(0xC0 | (codePoint >> 6)));
+        text.push_back((unsigned char)(0x80 | (codePoint & 0x3F)));
+    }
+    else if (codePoint < 0x10000) {
+        text.push_back((unsigned char)(0xE0 | (codePoint >> 12)));
+        text.push_back((unsigned char)(0x80 | ((codePoint >> 6) & 0x3F)));
+        text.push_back((unsigned char)(0x80 | (codePoint & 0x3F)));
+    }
+    else {
+        text.push_back((unsigned char)(0xF0 | (codePoint >> 18)));
+        text.push_back((unsigned char)(0x80 | ((codePoint >> 12) & 0x3F)));
+        text.push_back((unsigned char)(0x80 | ((codePoint >> 6) & 0x3F)));
+        text.push_back((unsigned char)(0x80 | (codePoint & 0x3F)));
+    }
+}
+
+size_t JsonStringScanner::scanString(const unsigned char* data, size_t length) {
+    size_t consumed = 0;
+
+    while (consumed < length) {
+        if (escapeState != ESCAPE_NONE) {
+            consumed += scanEscape(data + consumed, length - consumed);
+            continue;
+        }
+
+        const unsigned char* p = data + consumed;
+        size_t run = findStringSpecial(p, length - consumed);
+
+        if (run > 0) {
+            if (highSurrogate != 0) {
+                appendCodePoint(REPLACEMENT_CHARACTER);
+                highSurrogate = 0;
+            }
+
+            if (!isKey) {
+                text.insert(text.end(), p, p + run);
+            }
+
+            consumed += run;
+            if (consumed >= length) {
+                break;
+            }
+
+            p += run;
+        }
+
+        consumed++;
+
+        if (*p == '"') {
+            endString(true);
+            break;
+        }
+
+        escapeState = ESCAPE_BACKSLASH;
+    }
+
+    return consumed;
+}
+
+size_t JsonStringScanner::scanEscape(const unsigned char* data, size_t length) {
+    size_t i = 0;
+
+    while (i < length && escapeState != ESCAPE_NONE) {
+        unsigned char c = data[i++];
+
+        if (escapeState == ESCAPE_BACKSLASH) {
+            if (c == 'u') {
+                escapeState = ESCAPE_HEX_FIRST;
+                escapeValue = 0;
+                continue;
+            }
+
+            escapeState = ESCAPE_NONE;
+
+            if (highSurrogate != 0) {
+                appendCodePoint(REPLACEMENT_CHARACTER);
+                highSurrogate = 0;
+            }
+
+            switch (c) {
+            case 'b': appendCodePoint(0x08); break;
+            case 'f': appendCodePoint(0x0C); break;
+            case 'n': appendCodePoint('\n'); break;
+            case 'r': appendCodePoint('\r'); break;
+            case 't': appendCodePoint('\t'); break;
+
+            default:
+                // Covers \" \\ \/ and passes anything malformed through untouched.
+                if (!isKey) {
+                    text.push_back(c);
+                }
+                break;
+            }
+
+            continue;
+        }
+
+        int digit = hexValue(c);
+        if (digit < 0) {
+            // Malformed \u escape. Drop what we have and let the caller look at c again.
+            escapeState = ESCAPE_NONE;
+            if (highSurrogate != 0) {
+                appendCodePoint(REPLACEMENT_CHARACTER);
+                highSurrogate = 0;
+            }
+
+            return i - 1;
+        }
+
+        escapeValue = (escapeValue << 4) | (unsigned int)digit;
+
+        if (++escapeState < ESCAPE_HEX_DONE) {
+            continue;
+        }
+
+        escapeState = ESCAPE_NONE;
+
+        if (escapeValue >= 0xD800 && escapeValue <= 0xDBFF) {
+            if (highSurrogate != 0) {
+                appendCodePoint(REPLACEMENT_CHARACTER);
+            }
+
+            highSurrogate = escapeValue;
+        }
+        else if (escapeValue >= 0xDC00 && escapeValue <= 0xDFFF) {
+            if (highSurrogate != 0) {
+                appendCodePoint(0x10000 + ((highSurrogate - 0xD800) << 10) + (escapeValue - 0xDC00));
+                highSurrogate = 0;
+            }
+            else {
+                appendCodePoint(REPLACEMENT_CHARACTER);
+            }
+        }
+        else {
+            if (highSurrogate != 0) {
+                appendCodePoint(REPLACEMENT_CHARACTER);
+                highSurrogate = 0;
+            }
+
+            appendCodePoint(escapeValue);
+        }
+    }
+
+    return i;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// A decoded JSON string value. offset and length index into JsonStringScanner::Text().
+typedef struct JsonStringSpan {
+    size_t offset;
+    size_t length;
+
+    // False when the input ended before the closing quote of this value.
+    bool complete;
+} JsonStringSpan;
+
+// Maximum object/array nesting that is tracked precisely. Anything deeper is treated as an array,
+// which means strings in it are reported as values.
+#define JSON_SCAN_MAX_DEPTH 64
+
+/// Structural scanner that pulls only the string values out of a JSON document. Keys, numbers,
+/// literals and punctuation are dropped, and escapes (including \uXXXX surrogate pairs) are decoded
+/// to UTF-8.
+///
+/// The scanner never rejects input. Data can be fed in pieces as it streams in, and truncated or
+/// malformed documents produce whatever values could be recovered.
+class JsonStringScanner {
+public:
+    // separator: if non-zero, this byte is written into Text() after every completed value.
+    explicit JsonStringScanner(unsigned char separator = 0);
+
+    void Feed(const unsigned char* data, size_t length);
+
+    // Closes a value that was left open by truncated input so that it shows up in Spans().
+    void Finish();
+
+    void Reset();
+
+    const std::vector<unsigned char>& Text() const { return text; }
+    const std::vector<JsonStringSpan>& Spans() const { return spans; }
+
+    size_t BytesScanned() const { return bytesScanned; }
+    size_t KeysSkipped() const { return keysSkipped; }
+
+private:
+    void beginString();
+    void endString(bool complete);
+    void appendCodePoint(unsigned int codePoint);
+    size_t scanString(const unsigned char* data, size_t length);
+    size_t scanEscape(const unsigned char* data, size_t length);
+    void onStructural(unsigned char c);
+
+    bool inObject() const;
+
+    std::vector<unsigned char> text;
+    std::vector<JsonStringSpan> spans;
+
+    unsigned char separator;
+
+    bool inString;
+    bool isKey;
+    bool expectKey;
+    size_t valueStart;
+
+    // Escape decoding state, kept across Feed() calls.
+    int escapeState;
+    unsigned int escapeValue;
+    unsigned int highSurrogate;
+
+    unsigned long long objectBits;
+    int depth;
+
+    size_t bytesScanned;
+    size_t keysSkipped;
+};
@@ -0,0 +1,178 @@
+#include "MemoryBudget.h"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace {
+    // Zero initialized before any code runs, so subsystems built by static constructors can
+    // charge as well.
+    struct TagState {
+        std::atomic<size_t> live;
+        std::atomic<size_t> peak;
+        std::atomic<size_t> softLimit;
+        std::atomic<size_t> hardLimit;
+        std::atomic<unsigned long long> refused;
+        std::atomic<unsigned long long> forcedOver;
+        std::atomic<unsigned long long> compactions;
+    };
+
+    typedef struct Compaction {
+        int tag;
+        MemoryCompaction run;
+        void* context;
+    } Compaction;
+
+    struct Registry {
+        std::mutex lock;
+        std::vector<Compaction> compactions;
+    };
+}
+
+static TagState tags[MEMORY_TAG_COUNT];
+
+static const char* tagNames[MEMORY_TAG_COUNT] = {
+    "triggerIndex",
+    "verdictCache",
+    "scanBuffers",
+    "warmStart"
+};
+
+static Registry& registry() {
+    // Never destroyed, since subsystems can still remove their compactions after static
+    // destructors have run.
+    static Registry* shared = NULL;
+    static std::once_flag created;
+
+    std::call_once(created, [] {
+        shared = new Registry();
+    });
+
+    return *shared;
+}
+
+static void raisePeak(TagState& state, size_t live) {
+    size_t peak = state.peak.load(std::memory_order_relaxed);
+    while (live > peak && !state.peak.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+    }
+}
+
+bool MemoryBudget::TryCharge(int tag, size_t bytes) {
+    TagState& state = tags[tag];
+    size_t hardLimit = state.hardLimit.load(std::memory_order_relaxed);
+    size_t live = state.live.load(std::memory_order_relaxed);
+
+    do {
+        if (hardLimit != 0 && (bytes > hardLimit || live > hardLimit - bytes)) {
+            state.refused.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+    } while (!state.live.compare_exchange_weak(live, live + bytes, std::memory_order_relaxed));
+
+    raisePeak(state, live + bytes);
+    return true;
+}
+
+void MemoryBudget::Charge(int tag, size_t bytes) {
+    TagState& state = tags[tag];
+    size_t live = state.live.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    size_t hardLimit = state.hardLimit.load(std::memory_order_relaxed);
+
+    if (hardLimit != 0 && live > hardLimit) {
+        state.forcedOver.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    raisePeak(state, live);
+}
+
+void MemoryBudget::Release(int tag, size_t bytes) {
+    tags[tag].live.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+size_t MemoryBudget::Headroom(int tag) {
+    TagState& state = tags[tag];
+    size_t hardLimit = state.hardLimit.load(std::memory_order_relaxed);
+    size_t live = state.live.load(std::memory_order_relaxed);
+
+    if (hardLimit == 0) {
+        return SIZE_MAX;
+    }
+
+    return live < hardLimit ? hardLimit - live : 0;
+}
+
+void MemoryBudget::SetLimits(int tag, size_t softLimit, size_t hardLimit) {
+    tags[tag].softLimit.store(softLimit, std::memory_order_relaxed);
+    tags[tag].hardLimit.store(hardLimit, std::memory_order_relaxed);
+}
+
+void MemoryBudget::GetStats(int tag, MemoryTagStats* stats) {
+    TagState& state = tags[tag];
+
+    stats->liveBytes = state.live.load(std::memory_order_relaxed);
+    stats->peakBytes = state.peak.load(std::memory_order_relaxed);
+    stats->softLimit = state.softLimit.load(std::memory_order_relaxed);
+    stats->hardLimit = state.hardLimit.load(std::memory_order_relaxed);
+    stats->refused = state.refused.load(std::memory_order_relaxed);
+    stats->forcedOver = state.forcedOver.load(std::memory_order_relaxed);
+    stats->compactions = state.compactions.load(std::memory_order_relaxed);
+}
+
+void MemoryBudget::AddCompaction(int tag, MemoryCompaction compaction, void* context) {
+    Registry& shared = registry();
+    std::lock_guard<std::mutex> guard(shared.lock);
+
+    Compaction added;
+    added.tag = tag;
+    added.run = compaction;
+    added.context = context;
+    shared.compactions.push_back(added);
+}
+
+void MemoryBudget::RemoveCompaction(int tag, MemoryCompaction compaction, void* context) {
+    Registry& shared = registry();
+    std::lock_guard<std::mutex> guard(shared.lock);
+
+    for (size_t i = 0; i < shared.compactions.size(); i++) {
+        const Compaction& entry = shared.compactions[i];
+
+        if (entry.tag == tag && entry.run == compaction && entry.context == context) {
+            shared.compactions.erase(shared.compactions.begin() + i);
+            return;
+        }
+    }
+}
+
+int MemoryBudget::Relieve() {
+    Registry& shared = registry();
+    int relieved = 0;
+
+    for (int tag = 0; tag < MEMORY_TAG_COUNT; tag++) {
+        TagState& state = tags[tag];
+        size_t softLimit = state.softLimit.load(std::memory_order_relaxed);
+
+        if (softLimit == 0 || state.live.load(std::memory_order_relaxed) <= softLimit) {
+            continue;
+        }
+
+        // Held while the compactions run, so that none of them can be removed, and its context
+        // freed, halfway through.
+        std::lock_guard<std::mutex> guard(shared.lock);
+
+        for (size_t i = 0; i < shared.compactions.size(); i++) {
+            if (shared.compactions[i].tag == tag) {
+                shared.compactions[i].run(shared.compactions[i].context);
+            }
+        }
+
+        state.compactions.fetch_add(1, std::memory_order_relaxed);
+        relieved++;
+    }
+
+    return relieved;
+}
+
+const char* MemoryBudget::TagName(int tag) {
+    return tag >= 0 && tag < MEMORY_TAG_COUNT ? tagNames[tag] : "unknown";
+}
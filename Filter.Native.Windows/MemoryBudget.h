@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+
+// Subsystems that account for the memory they hold.
+#define MEMORY_TAG_TRIGGER_INDEX 0
+#define MEMORY_TAG_VERDICT_CACHE 1
+#define MEMORY_TAG_SCAN_BUFFERS 2
+#define MEMORY_TAG_WARM_START 3
+#define MEMORY_TAG_COUNT 4
+
+typedef struct MemoryTagStats {
+    unsigned long long liveBytes;
+    unsigned long long peakBytes;
+
+    // Zero for no limit.
+    unsigned long long softLimit;
+    unsigned long long hardLimit;
+
+    // Charges turned down because they would have gone past the hard limit.
+    unsigned long long refused;
+
+    // Charges that couldn't be turned down and went past the hard limit anyway. Any at all mean
+    // the limit is too tight for what the subsystem can't do without.
+    unsigned long long forcedOver;
+
+    // Times the tag's compactions ran because it was past its soft limit.
+    unsigned long long compactions;
+} MemoryTagStats;
+
+// Asked to give back what it can of the memory charged to its tag.
+typedef void (*MemoryCompaction)(void* context);
+
+/// Process-wide accounting of the memory each native subsystem holds, with optional limits.
+///
+/// Subsystems charge what they allocate to their tag and release it when they free it. A charge
+/// that would go past the tag's hard limit is refused and the subsystem does without, so the hard
+/// limit is a cap that holds. Charges that can't be refused, like the memory a scan already needs,
+/// are forced through and only counted.
+///
+/// Going past the soft limit refuses nothing. Relieve() runs the compactions registered for every
+/// tag that is past it. It is called on a timer rather than from the charge itself, so a
+/// compaction never runs inside code that holds the lock it needs.
+class MemoryBudget {
+public:
+    /// Charges bytes to a tag unless that would take it past its hard limit. Returns false, having
+    /// charged nothing, if it would.
+    static bool TryCharge(int tag, size_t bytes);
+
+    static void Charge(int tag, size_t bytes);
+
+    static void Release(int tag, size_t bytes);
+
+    // What can still be charged before the hard limit, or SIZE_MAX without one.
+    static size_t Headroom(int tag);
+
+    /// Zero for either limit means none. Lowering the hard limit below what is live releases
+    /// nothing; it only refuses charges until enough is released.
+    static void SetLimits(int tag, size_t softLimit, size_t hardLimit);
+
+    static void GetStats(int tag, MemoryTagStats* stats);
+
+    /// A compaction can run on any thread, at the same time as the subsystem is used, and must not
+    /// add or remove compactions itself.
+    static void AddCompaction(int tag, MemoryCompaction compaction, void* context);
+
+    static void RemoveCompaction(int tag, MemoryCompaction compaction, void* context);
+
+    /// Runs the compactions of every tag past its soft limit and returns how many tags that was.
+    static int Relieve();
+
+    static const char* TagName(int tag);
+
+private:
+    MemoryBudget();
+};
@@ -0,0 +1,46 @@
+#include "NativeMemory.h"
+
+namespace FilterNativeWindows {
+    void NativeMemory::SetLimits(MemoryTag tag, long long softLimit, long long hardLimit) {
+        if ((int)tag < 0 || (int)tag >= MEMORY_TAG_COUNT) {
+            throw gcnew ArgumentOutOfRangeException("tag");
+        }
+
+        if (softLimit < 0) {
+            throw gcnew ArgumentOutOfRangeException("softLimit");
+        }
+
+        if (hardLimit < 0) {
+            throw gcnew ArgumentOutOfRangeException("hardLimit");
+        }
+
+        MemoryBudget::SetLimits((int)tag, (size_t)softLimit, (size_t)hardLimit);
+    }
+
+    array<MemoryTagUsage^>^ NativeMemory::Snapshot() {
+        array<MemoryTagUsage^>^ usage = gcnew array<MemoryTagUsage^>(MEMORY_TAG_COUNT);
+
+        for (int i = 0; i < MEMORY_TAG_COUNT; i++) {
+            MemoryTagStats stats;
+            MemoryBudget::GetStats(i, &stats);
+
+            MemoryTagUsage^ tag = gcnew MemoryTagUsage();
+            tag->Tag = (MemoryTag)i;
+            tag->LiveBytes = (long long)stats.liveBytes;
+            tag->PeakBytes = (long long)stats.peakBytes;
+            tag->SoftLimit = (long long)stats.softLimit;
+            tag->HardLimit = (long long)stats.hardLimit;
+            tag->Refused = (long long)stats.refused;
+            tag->ForcedOverLimit = (long long)stats.forcedOver;
+            tag->Compactions = (long long)stats.compactions;
+
+            usage[i] = tag;
+        }
+
+        return usage;
+    }
+
+    int NativeMemory::Relieve() {
+        return MemoryBudget::Relieve();
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "MemoryBudget.h"
+
+using namespace System;
+
+namespace FilterNativeWindows {
+    public enum class MemoryTag {
+        TriggerIndex = MEMORY_TAG_TRIGGER_INDEX,
+        VerdictCache = MEMORY_TAG_VERDICT_CACHE,
+        ScanBuffers = MEMORY_TAG_SCAN_BUFFERS,
+        WarmStart = MEMORY_TAG_WARM_START
+    };
+
+    public ref class MemoryTagUsage {
+    public:
+        property MemoryTag Tag;
+        property long long LiveBytes;
+        property long long PeakBytes;
+
+        /// <summary>
+        /// Zero for no limit.
+        /// </summary>
+        property long long SoftLimit;
+        property long long HardLimit;
+
+        /// <summary>
+        /// Allocations turned down because they would have gone past the hard limit.
+        /// </summary>
+        property long long Refused;
+
+        /// <summary>
+        /// Allocations the subsystem couldn't do without that went past the hard limit anyway. Any at all mean the limit is
+        /// too tight.
+        /// </summary>
+        property long long ForcedOverLimit;
+
+        property long long Compactions;
+    };
+
+    /// <summary>
+    /// Memory held by each native subsystem, and the limits it is kept to. A subsystem past its hard limit goes without
+    /// the memory rather than take it: the trigger index leaves triggers out, the verdict cache is made smaller and scan
+    /// buffers aren't kept between scans.
+    /// </summary>
+    public ref class NativeMemory abstract sealed {
+    public:
+        /// <summary>
+        /// Zero for either limit means none. Limits only hold for what is allocated after they are set, so set them
+        /// before the lists are loaded.
+        /// </summary>
+        static void SetLimits(MemoryTag tag, long long softLimit, long long hardLimit);
+
+        /// <returns>One entry per MemoryTag, indexed by its value.</returns>
+        static array<MemoryTagUsage^>^ Snapshot();
+
+        /// <summary>
+        /// Asks every subsystem past its soft limit to give memory back.
+        /// </summary>
+        /// <returns>How many subsystems were asked.</returns>
+        static int Relieve();
+    };
+}
@@ -0,0 +1,101 @@
+#include "NativeMetrics.h"
+
+namespace FilterNativeWindows {
+    void NativeMetrics::Record(HotPathMetric metric, long long elapsedTicks) {
+        if (elapsedTicks < 0) {
+            elapsedTicks = 0;
+        }
+
+        HotPathMetrics::Record((int)metric, (unsigned long long)((double)elapsedTicks * nanosecondsPerTick));
+    }
+
+    void NativeMetrics::RecordNanoseconds(HotPathMetric metric, long long nanoseconds) {
+        HotPathMetrics::Record((int)metric, nanoseconds < 0 ? 0 : (unsigned long long)nanoseconds);
+    }
+
+    void NativeMetrics::Add(HotPathCounter counter, long long amount) {
+        if (amount < 0) {
+            throw gcnew ArgumentOutOfRangeException("amount", "Counters only go up.");
+        }
+
+        HotPathMetrics::Add((int)counter, (unsigned long long)amount);
+    }
+
+    NativeMetricsSnapshot^ NativeMetrics::Snapshot() {
+        // Too big for the stack once every metric has its buckets.
+        HotPathSnapshot* native = new HotPathSnapshot();
+
+        try {
+            HotPathMetrics::Snapshot(native);
+
+            NativeMetricsSnapshot^ snapshot = gcnew NativeMetricsSnapshot();
+            snapshot->Latencies = gcnew array<LatencyHistogram^>(HOT_PATH_METRIC_COUNT);
+            snapshot->Counters = gcnew array<long long>(HOT_PATH_COUNTER_COUNT);
+            snapshot->Threads = (long long)native->threads;
+
+            for (int i = 0; i < HOT_PATH_METRIC_COUNT; i++) {
+                const HotPathHistogram& source = native->metrics[i];
+
+                int used = HOT_PATH_HISTOGRAM_BUCKETS;
+                while (used > 0 && source.buckets[used - 1] == 0) {
+                    used--;
+                }
+
+                LatencyHistogram^ histogram = gcnew LatencyHistogram();
+                histogram->Count = (long long)source.count;
+                histogram->TotalNanoseconds = (long long)source.totalNanoseconds;
+                histogram->MaxNanoseconds = (long long)source.maxNanoseconds;
+                histogram->Buckets = gcnew array<long long>(used);
+
+                for (int b = 0; b < used; b++) {
+                    histogram->Buckets[b] = (long long)source.buckets[b];
+                }
+
+                snapshot->Latencies[i] = histogram;
+            }
+
+            for (int i = 0; i < HOT_PATH_COUNTER_COUNT; i++) {
+                snapshot->Counters[i] = (long long)native->counters[i];
+            }
+
+            return snapshot;
+        }
+        finally {
+            delete native;
+        }
+    }
+
+    long long LatencyHistogram::ValueAtPercentile(double percentile) {
+        if (percentile <= 0.0 || percentile > 100.0) {
+            throw gcnew ArgumentOutOfRangeException("percentile");
+        }
+
+        HotPathHistogram* native = new HotPathHistogram();
+
+        try {
+            native->count = (unsigned long long)Count;
+            native->totalNanoseconds = (unsigned long long)TotalNanoseconds;
+            native->maxNanoseconds = (unsigned long long)MaxNanoseconds;
+
+            array<long long>^ buckets = Buckets;
+            int used = buckets == nullptr ? 0 : Math::Min(buckets->Length, HOT_PATH_HISTOGRAM_BUCKETS);
+
+            for (int b = 0; b < used; b++) {
+                native->buckets[b] = (unsigned long long)buckets[b];
+            }
+
+            return (long long)HotPathMetrics::ValueAtPercentile(*native, percentile);
+        }
+        finally {
+            delete native;
+        }
+    }
+
+    long long LatencyHistogram::BucketLowerBound(int index) {
+        if (index < 0 || index > HOT_PATH_HISTOGRAM_BUCKETS) {
+            throw gcnew ArgumentOutOfRangeException("index");
+        }
+
+        return (long long)HotPathMetrics::BucketLowerBound((size_t)index);
+    }
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "HotPathMetrics.h"
+
+using namespace System;
+
+namespace FilterNativeWindows {
+    public enum class HotPathMetric {
+        TriggerScan = HOT_PATH_TRIGGER_SCAN,
+        UrlLookup = HOT_PATH_URL_LOOKUP,
+        DiversionEvent = HOT_PATH_DIVERSION_EVENT,
+        ListReload = HOT_PATH_LIST_RELOAD,
+        IpcSend = HOT_PATH_IPC_SEND,
+        ConflictScan = HOT_PATH_CONFLICT_SCAN,
+        ScanWait = HOT_PATH_SCAN_WAIT
+    };
+
+    public enum class HotPathCounter {
+        BytesScanned = HOT_PATH_BYTES_SCANNED,
+        TriggerMatches = HOT_PATH_TRIGGER_MATCHES,
+        UrlsBlocked = HOT_PATH_URLS_BLOCKED,
+        DiversionErrors = HOT_PATH_DIVERSION_ERRORS,
+        VerdictHits = HOT_PATH_VERDICT_HITS,
+        VerdictMisses = HOT_PATH_VERDICT_MISSES,
+        VerdictBytesSkipped = HOT_PATH_VERDICT_BYTES_SKIPPED,
+        ScansTruncated = HOT_PATH_SCANS_TRUNCATED,
+        ScansDeferred = HOT_PATH_SCANS_DEFERRED,
+        ScansRefused = HOT_PATH_SCANS_REFUSED,
+        TriggersLeftOut = HOT_PATH_TRIGGERS_LEFT_OUT
+    };
+
+    /// <summary>
+    /// Merged latency samples of one metric. Buckets are exact up to 32ns and within 1/16th of the value above that.
+    /// </summary>
+    public ref class LatencyHistogram {
+    public:
+        property long long Count;
+        property long long TotalNanoseconds;
+        property long long MaxNanoseconds;
+
+        /// <summary>
+        /// Sample counts by bucket, up to the last bucket that has any.
+        /// </summary>
+        property array<long long>^ Buckets;
+
+        /// <summary>
+        /// Highest latency a sample at this percentile could have had, in nanoseconds. Zero if there are no samples.
+        /// </summary>
+        long long ValueAtPercentile(double percentile);
+
+        static long long BucketLowerBound(int index);
+    };
+
+    public ref class NativeMetricsSnapshot {
+    public:
+        /// <summary>
+        /// One histogram per HotPathMetric, indexed by its value.
+        /// </summary>
+        property array<LatencyHistogram^>^ Latencies;
+
+        /// <summary>
+        /// One total per HotPathCounter, indexed by its value.
+        /// </summary>
+        property array<long long>^ Counters;
+
+        property long long Threads;
+    };
+
+    /// <summary>
+    /// Process-wide latency histograms and counters for the filtering hot paths. Recording is lock free and only touches
+    /// the calling thread's own slot. Everything is cumulative from process start.
+    /// </summary>
+    public ref class NativeMetrics abstract sealed {
+    public:
+        /// <param name="elapsedTicks">Duration in Stopwatch ticks.</param>
+        static void Record(HotPathMetric metric, long long elapsedTicks);
+
+        static void RecordNanoseconds(HotPathMetric metric, long long nanoseconds);
+
+        static void Add(HotPathCounter counter, long long amount);
+
+        static NativeMetricsSnapshot^ Snapshot();
+
+    private:
+        static NativeMetrics() {
+            nanosecondsPerTick = 1000000000.0 / (double)System::Diagnostics::Stopwatch::Frequency;
+        }
+
+        static double nanosecondsPerTick;
+    };
+}
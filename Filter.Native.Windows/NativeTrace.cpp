@@ -0,0 +1,79 @@
+#include "NativeTrace.h"
+
+// Events copied out of the rings per native call while draining.
+#define DRAIN_BATCH 128
+
+namespace FilterNativeWindows {
+    bool NativeTrace::Write(int eventId) {
+        return TraceRing::Write((unsigned short)eventId, NULL, 0);
+    }
+
+    bool NativeTrace::Write(int eventId, long long arg0) {
+        long long args[] = { arg0 };
+        return TraceRing::Write((unsigned short)eventId, args, 1);
+    }
+
+    bool NativeTrace::Write(int eventId, long long arg0, long long arg1) {
+        long long args[] = { arg0, arg1 };
+        return TraceRing::Write((unsigned short)eventId, args, 2);
+    }
+
+    bool NativeTrace::Write(int eventId, long long arg0, long long arg1, long long arg2) {
+        long long args[] = { arg0, arg1, arg2 };
+        return TraceRing::Write((unsigned short)eventId, args, 3);
+    }
+
+    bool NativeTrace::Write(int eventId, long long arg0, long long arg1, long long arg2, long long arg3) {
+        long long args[] = { arg0, arg1, arg2, arg3 };
+        return TraceRing::Write((unsigned short)eventId, args, 4);
+    }
+
+    int NativeTrace::Drain(array<TraceRecord>^ records) {
+        if (records == nullptr) {
+            throw gcnew ArgumentNullException("records");
+        }
+
+        TraceEvent batch[DRAIN_BATCH];
+        int filled = 0;
+
+        while (filled < records->Length) {
+            size_t wanted = (size_t)Math::Min(records->Length - filled, DRAIN_BATCH);
+            size_t drained = TraceRing::Drain(batch, wanted);
+
+            for (size_t i = 0; i < drained; i++) {
+                TraceRecord% record = records[filled++];
+                record.Timestamp = (long long)batch[i].timestamp;
+                record.Thread = (int)batch[i].thread;
+                record.EventId = batch[i].eventId;
+                record.ArgCount = batch[i].argCount;
+                record.Arg0 = batch[i].args[0];
+                record.Arg1 = batch[i].args[1];
+                record.Arg2 = batch[i].args[2];
+                record.Arg3 = batch[i].args[3];
+            }
+
+            if (drained < wanted) {
+                break;
+            }
+        }
+
+        return filled;
+    }
+
+    DateTime NativeTrace::ToDateTime(long long timestamp) {
+        // TimeSpan ticks are 100ns.
+        return clockBase.AddTicks((timestamp - timestampBase) / 100);
+    }
+
+    TraceOverflow NativeTrace::Overflow::get() {
+        return (TraceOverflow)TraceRing::Overflow();
+    }
+
+    void NativeTrace::Overflow::set(TraceOverflow value) {
+        TraceRing::SetOverflow((int)value);
+    }
+
+    long long NativeTrace::Lost::get() {
+        return (long long)TraceRing::Lost();
+    }
+}
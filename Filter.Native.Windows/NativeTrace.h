@@ -0,0 +1,78 @@
+#pragma once
+
+#include "TraceRing.h"
+
+using namespace System;
+
+namespace FilterNativeWindows {
+    public enum class TraceOverflow {
+        DropNewest = TRACE_OVERFLOW_DROP_NEWEST,
+        OverwriteOldest = TRACE_OVERFLOW_OVERWRITE_OLDEST
+    };
+
+    public value struct TraceRecord {
+        /// <summary>
+        /// Native clock at the time of the event. Use NativeTrace.ToDateTime() to turn it into a date.
+        /// </summary>
+        long long Timestamp;
+
+        int Thread;
+        int EventId;
+        int ArgCount;
+
+        long long Arg0;
+        long long Arg1;
+        long long Arg2;
+        long long Arg3;
+    };
+
+    /// <summary>
+    /// Binary event trace kept in a native ring per thread. Writing an event doesn't format or allocate anything, so it
+    /// can stay on in hot paths. Events are formatted later by whoever drains them.
+    /// </summary>
+    public ref class NativeTrace abstract sealed {
+    public:
+        /// <summary>
+        /// Writes an event to the calling thread's ring.
+        /// </summary>
+        /// <returns>True when the ring has just filled to the point where it should be drained soon. This happens once
+        /// each time it fills that far.</returns>
+        static bool Write(int eventId);
+        static bool Write(int eventId, long long arg0);
+        static bool Write(int eventId, long long arg0, long long arg1);
+        static bool Write(int eventId, long long arg0, long long arg1, long long arg2);
+        static bool Write(int eventId, long long arg0, long long arg1, long long arg2, long long arg3);
+
+        /// <summary>
+        /// Moves pending events into records. Only one thread should drain at a time.
+        /// </summary>
+        /// <returns>The number of records filled in.</returns>
+        static int Drain(array<TraceRecord>^ records);
+
+        static DateTime ToDateTime(long long timestamp);
+
+        /// <summary>
+        /// What a thread does with new events while its ring is full.
+        /// </summary>
+        static property TraceOverflow Overflow {
+            TraceOverflow get();
+            void set(TraceOverflow value);
+        }
+
+        /// <summary>
+        /// Events dropped or overwritten before they could be drained, since the process started.
+        /// </summary>
+        static property long long Lost {
+            long long get();
+        }
+
+    private:
+        static NativeTrace() {
+            clockBase = DateTime::Now;
+            timestampBase = (long long)TraceRing::Now();
+        }
+
+        static DateTime clockBase;
+        static long long timestampBase;
+    };
+}
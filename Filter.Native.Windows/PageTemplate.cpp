@@ -0,0 +1,360 @@
+#include "PageTemplate.h"
+
+#include <cstring>
+
+#define SEGMENT_LITERAL 0
+#define SEGMENT_VALUE 1
+#define SEGMENT_RAW_VALUE 2
+#define SEGMENT_ITEM 3
+#define SEGMENT_RAW_ITEM 4
+#define SEGMENT_IF 5
+#define SEGMENT_EACH 6
+#define SEGMENT_ELSE 7
+#define SEGMENT_END 8
+
+// Deepest nesting of #if and #each a template may use.
+#define MAX_BLOCK_DEPTH 32
+
+static bool isSpace(unsigned char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static bool isNameChar(unsigned char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+static const unsigned char* findBytes(const unsigned char* begin, const unsigned char* end, const char* needle) {
+    size_t needleLength = strlen(needle);
+
+    while ((size_t)(end - begin) >= needleLength) {
+        const unsigned char* candidate = static_cast<const unsigned char*>(memchr(begin, needle[0], (size_t)(end - begin) - needleLength + 1));
+        if (candidate == NULL) {
+            return NULL;
+        }
+
+        if (memcmp(candidate, needle, needleLength) == 0) {
+            return candidate;
+        }
+
+        begin = candidate + 1;
+    }
+
+    return NULL;
+}
+
+static bool equals(const unsigned char* text, size_t length, const char* word) {
+    return strlen(word) == length && memcmp(text, word, length) == 0;
+}
+
+static int findSlot(const unsigned char* name, size_t length, const char* const* slotNames, size_t slotCount) {
+    for (size_t i = 0; i < slotCount; i++) {
+        if (equals(name, length, slotNames[i])) {
+            return (int)i;
+        }
+    }
+
+    return -1;
+}
+
+static void append(const unsigned char* text, size_t length, std::vector<unsigned char>& output) {
+    if (length > 0) {
+        output.insert(output.end(), text, text + length);
+    }
+}
+
+static const char* escapeFor(unsigned char c) {
+    switch (c) {
+    case '&': return "&amp;";
+    case '<': return "&lt;";
+    case '>': return "&gt;";
+    case '"': return "&quot;";
+    case '\'': return "&#x27;";
+    case '`': return "&#x60;";
+    case '=': return "&#x3D;";
+    default: return NULL;
+    }
+}
+
+void AppendHtmlEscaped(const unsigned char* text, size_t length, std::vector<unsigned char>& output) {
+    size_t runStart = 0;
+
+    for (size_t i = 0; i < length; i++) {
+        const char* escaped = escapeFor(text[i]);
+        if (escaped == NULL) {
+            continue;
+        }
+
+        append(text + runStart, i - runStart, output);
+        append(reinterpret_cast<const unsigned char*>(escaped), strlen(escaped), output);
+        runStart = i + 1;
+    }
+
+    append(text + runStart, length - runStart, output);
+}
+
+PageTemplate::PageTemplate() : slotCount(0), literalLength(0) {
+}
+
+bool PageTemplate::Compile(const unsigned char* text, size_t length, const char* const* slotNames, size_t slotNameCount, const char** error) {
+    source.assign(text, text + length);
+    segments.clear();
+    slotCount = slotNameCount;
+    literalLength = 0;
+
+    const unsigned char* begin = source.data();
+    const unsigned char* end = begin + source.size();
+    const unsigned char* literal = begin;
+
+    // Segment index of each open #if or #each, innermost last.
+    size_t open[MAX_BLOCK_DEPTH];
+    size_t depth = 0;
+    size_t eachDepth = 0;
+
+    while (true) {
+        const unsigned char* tag = findBytes(literal, end, "{{");
+        const unsigned char* literalEnd = tag == NULL ? end : tag;
+
+        if (literalEnd > literal) {
+            PageSegment segment = { SEGMENT_LITERAL, -1, (size_t)(literal - begin), (size_t)(literalEnd - literal), 0, 0 };
+            segments.push_back(segment);
+            literalLength += segment.length;
+        }
+
+        if (tag == NULL) {
+            break;
+        }
+
+        bool raw = tag + 2 < end && tag[2] == '{';
+        const unsigned char* nameStart = tag + (raw ? 3 : 2);
+        const unsigned char* close = findBytes(nameStart, end, raw ? "}}}" : "}}");
+
+        if (close == NULL) {
+            *error = "A tag is never closed.";
+            return false;
+        }
+
+        literal = close + (raw ? 3 : 2);
+
+        const unsigned char* nameEnd = close;
+        while (nameStart < nameEnd && isSpace(*nameStart)) {
+            nameStart++;
+        }
+
+        while (nameEnd > nameStart && isSpace(nameEnd[-1])) {
+            nameEnd--;
+        }
+
+        if (nameStart == nameEnd) {
+            *error = "A tag is empty.";
+            return false;
+        }
+
+        if (*nameStart == '!') {
+            // Comment.
+            continue;
+        }
+
+        PageSegment segment = { SEGMENT_VALUE, -1, 0, 0, 0, 0 };
+        size_t index = segments.size();
+
+        if (*nameStart == '#') {
+            const unsigned char* keyword = nameStart + 1;
+            const unsigned char* keywordEnd = keyword;
+            while (keywordEnd < nameEnd && isNameChar(*keywordEnd)) {
+                keywordEnd++;
+            }
+
+            if (equals(keyword, (size_t)(keywordEnd - keyword), "if")) {
+                segment.kind = SEGMENT_IF;
+            }
+            else if (equals(keyword, (size_t)(keywordEnd - keyword), "each")) {
+                segment.kind = SEGMENT_EACH;
+                eachDepth++;
+            }
+            else {
+                *error = "Only the #if and #each block helpers are supported.";
+                return false;
+            }
+
+            nameStart = keywordEnd;
+            while (nameStart < nameEnd && isSpace(*nameStart)) {
+                nameStart++;
+            }
+
+            segment.slot = findSlot(nameStart, (size_t)(nameEnd - nameStart), slotNames, slotNameCount);
+            if (segment.slot < 0) {
+                *error = "A block helper names an unknown slot.";
+                return false;
+            }
+
+            if (depth == MAX_BLOCK_DEPTH) {
+                *error = "Blocks are nested too deeply.";
+                return false;
+            }
+
+            open[depth++] = index;
+        }
+        else if (equals(nameStart, (size_t)(nameEnd - nameStart), "else")) {
+            if (depth == 0 || segments[open[depth - 1]].elseIndex != 0) {
+                *error = "An {{else}} is outside a block or repeated.";
+                return false;
+            }
+
+            segment.kind = SEGMENT_ELSE;
+            segments[open[depth - 1]].elseIndex = index;
+        }
+        else if (*nameStart == '/') {
+            if (depth == 0) {
+                *error = "A block is closed that was never opened.";
+                return false;
+            }
+
+            PageSegment& opener = segments[open[--depth]];
+            const char* keyword = opener.kind == SEGMENT_IF ? "if" : "each";
+
+            const unsigned char* closing = nameStart + 1;
+            while (closing < nameEnd && isSpace(*closing)) {
+                closing++;
+            }
+
+            if (!equals(closing, (size_t)(nameEnd - closing), keyword)) {
+                *error = "A block is closed by the wrong tag.";
+                return false;
+            }
+
+            if (opener.kind == SEGMENT_EACH) {
+                eachDepth--;
+            }
+
+            if (opener.elseIndex == 0) {
+                opener.elseIndex = index;
+            }
+
+            opener.endIndex = index;
+            segment.kind = SEGMENT_END;
+        }
+        else if (equals(nameStart, (size_t)(nameEnd - nameStart), "@value") ||
+            equals(nameStart, (size_t)(nameEnd - nameStart), "this") ||
+            equals(nameStart, (size_t)(nameEnd - nameStart), ".")) {
+            if (eachDepth == 0) {
+                *error = "The current item is used outside an #each block.";
+                return false;
+            }
+
+            segment.kind = raw ? SEGMENT_RAW_ITEM : SEGMENT_ITEM;
+        }
+        else {
+            segment.kind = raw ? SEGMENT_RAW_VALUE : SEGMENT_VALUE;
+            segment.slot = findSlot(nameStart, (size_t)(nameEnd - nameStart), slotNames, slotNameCount);
+
+            if (segment.slot < 0) {
+                *error = "A tag names an unknown slot.";
+                return false;
+            }
+        }
+
+        segments.push_back(segment);
+    }
+
+    if (depth != 0) {
+        *error = "A block is never closed.";
+        return false;
+    }
+
+    return true;
+}
+
+void PageTemplate::Render(const PageValue* values, std::vector<unsigned char>& output) const {
+    output.reserve(output.size() + literalLength + 1024);
+    renderRange(0, segments.size(), values, NULL, output);
+}
+
+void PageTemplate::renderRange(size_t begin, size_t end, const PageValue* values, const PageValue* item, std::vector<unsigned char>& output) const {
+    const unsigned char* text = source.data();
+
+    size_t i = begin;
+    while (i < end) {
+        const PageSegment& segment = segments[i];
+
+        switch (segment.kind) {
+        case SEGMENT_LITERAL:
+            append(text + segment.offset, segment.length, output);
+            i++;
+            break;
+
+        case SEGMENT_VALUE:
+            AppendHtmlEscaped(values[segment.slot].text, values[segment.slot].length, output);
+            i++;
+            break;
+
+        case SEGMENT_RAW_VALUE:
+            append(values[segment.slot].text, values[segment.slot].length, output);
+            i++;
+            break;
+
+        case SEGMENT_ITEM:
+            AppendHtmlEscaped(item->text, item->length, output);
+            i++;
+            break;
+
+        case SEGMENT_RAW_ITEM:
+            append(item->text, item->length, output);
+            i++;
+            break;
+
+        case SEGMENT_IF:
+            if (values[segment.slot].truthy) {
+                renderRange(i + 1, segment.elseIndex, values, item, output);
+            }
+            else if (segment.elseIndex != segment.endIndex) {
+                renderRange(segment.elseIndex + 1, segment.endIndex, values, item, output);
+            }
+
+            i = segment.endIndex + 1;
+            break;
+
+        case SEGMENT_EACH: {
+            const PageValue& list = values[segment.slot];
+
+            if (list.itemCount == 0) {
+                if (segment.elseIndex != segment.endIndex) {
+                    renderRange(segment.elseIndex + 1, segment.endIndex, values, item, output);
+                }
+            }
+            else {
+                for (size_t k = 0; k < list.itemCount; k++) {
+                    renderRange(i + 1, segment.elseIndex, values, &list.items[k], output);
+                }
+            }
+
+            i = segment.endIndex + 1;
+            break;
+        }
+
+        default:
+            // {{else}} and closing tags are only reached by jumping past them.
+            i++;
+            break;
+        }
+    }
+}
+
+static void trim(std::vector<unsigned char>& buffer) {
+    if (buffer.capacity() > PAGE_SCRATCH_LIMIT) {
+        // Don't let one huge page pin its buffer to the thread forever.
+        std::vector<unsigned char>().swap(buffer);
+    }
+
+    buffer.clear();
+}
+
+PageScratch& PageTemplate::Scratch() {
+    static thread_local PageScratch scratch;
+
+    trim(scratch.text);
+    trim(scratch.output);
+    scratch.values.clear();
+    scratch.items.clear();
+
+    return scratch;
+}
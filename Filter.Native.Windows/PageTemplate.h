@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Largest scratch buffer a thread holds on to between renders.
+#define PAGE_SCRATCH_LIMIT (256 * 1024)
+
+/// A value bound to one slot for a render. Text is UTF-8 and is HTML escaped by {{name}} and
+/// copied as-is by {{{name}}}. A list has items, each of which is text.
+typedef struct PageValue {
+    const unsigned char* text;
+    size_t length;
+
+    const struct PageValue* items;
+    size_t itemCount;
+
+    // What {{#if name}} tests. The caller decides, following Handlebars: false, null, empty text
+    // and empty lists are falsy.
+    bool truthy;
+} PageValue;
+
+/// Per-thread buffers for binding values and rendering, reused by every render on the thread.
+typedef struct PageScratch {
+    std::vector<unsigned char> text;
+    std::vector<PageValue> values;
+    std::vector<PageValue> items;
+    std::vector<unsigned char> output;
+} PageScratch;
+
+typedef struct PageSegment {
+    int kind;
+    int slot;
+
+    // Literal bytes, as an offset into the template source.
+    size_t offset;
+    size_t length;
+
+    // For #if and #each: the segment index of {{else}}, or of the closing tag if there is none.
+    size_t elseIndex;
+    size_t endIndex;
+} PageSegment;
+
+/// The subset of Handlebars the block pages use, compiled once into a flat list of literal runs
+/// and typed slots: {{name}}, {{{name}}}, {{#if name}}...{{else}}...{{/if}}, and
+/// {{#each name}}...{{/each}} with {{@value}} or {{this}} for the current item.
+///
+/// Slots are named when the template is compiled and bound by index when it is rendered, so a
+/// render never looks anything up by name. A compiled template is read only and can render on any
+/// number of threads at once.
+class PageTemplate {
+public:
+    PageTemplate();
+
+    /// Returns false, with a description of the problem in error, if the source uses syntax
+    /// outside the supported subset, an unbalanced block, or a name not in slotNames.
+    bool Compile(const unsigned char* source, size_t length, const char* const* slotNames, size_t slotCount, const char** error);
+
+    /// Appends the page to output in one pass. values holds one entry per slot name.
+    void Render(const PageValue* values, std::vector<unsigned char>& output) const;
+
+    size_t SlotCount() const { return slotCount; }
+
+    /// Bytes of literal text. A page is at least this long.
+    size_t LiteralLength() const { return literalLength; }
+
+    /// This thread's scratch buffers, emptied. They keep their capacity between renders unless one
+    /// has grown past PAGE_SCRATCH_LIMIT.
+    static PageScratch& Scratch();
+
+private:
+    void renderRange(size_t begin, size_t end, const PageValue* values, const PageValue* item, std::vector<unsigned char>& output) const;
+
+    std::vector<unsigned char> source;
+    std::vector<PageSegment> segments;
+
+    size_t slotCount;
+    size_t literalLength;
+};
+
+/// Appends text with &, <, >, ", ', ` and = replaced by character references, like Handlebars.
+void AppendHtmlEscaped(const unsigned char* text, size_t length, std::vector<unsigned char>& output);
@@ -0,0 +1,189 @@
+#include "PageTemplate.h"
+#include "PageTemplateRenderer.h"
+
+#include <cstring>
+#include <string>
+#include <vcclr.h>
+
+using namespace System::Collections::Generic;
+using namespace System::Runtime::InteropServices;
+using namespace System::Text;
+
+namespace FilterNativeWindows {
+    static size_t maxLength(Object^ value) {
+        String^ text = dynamic_cast<String^>(value);
+        if (text != nullptr) {
+            return (size_t)Encoding::UTF8->GetMaxByteCount(text->Length);
+        }
+
+        array<Byte>^ bytes = dynamic_cast<array<Byte>^>(value);
+        return bytes == nullptr ? 0 : (size_t)bytes->Length;
+    }
+
+    // Copies value into scratch at offset as UTF-8 and returns how many bytes it took.
+    static size_t encode(Object^ value, std::vector<unsigned char>& scratch, size_t offset) {
+        String^ text = dynamic_cast<String^>(value);
+        if (text != nullptr) {
+            if (text->Length == 0) {
+                return 0;
+            }
+
+            pin_ptr<const wchar_t> chars = PtrToStringChars(text);
+            return (size_t)Encoding::UTF8->GetBytes(const_cast<wchar_t*>(chars), text->Length, scratch.data() + offset, (int)(scratch.size() - offset));
+        }
+
+        array<Byte>^ bytes = dynamic_cast<array<Byte>^>(value);
+        if (bytes != nullptr && bytes->Length > 0) {
+            pin_ptr<Byte> pinnedBytes = &bytes[0];
+            memcpy(scratch.data() + offset, pinnedBytes, (size_t)bytes->Length);
+            return (size_t)bytes->Length;
+        }
+
+        return 0;
+    }
+
+    PageTemplateRenderer::PageTemplateRenderer(array<Byte>^ source, array<String^>^ slotNames) {
+        if (source == nullptr) {
+            throw gcnew ArgumentNullException("source");
+        }
+
+        if (slotNames == nullptr) {
+            throw gcnew ArgumentNullException("slotNames");
+        }
+
+        std::vector<std::string> names(slotNames->Length);
+        std::vector<const char*> namePointers(slotNames->Length);
+
+        for (int i = 0; i < slotNames->Length; i++) {
+            if (slotNames[i] == nullptr) {
+                throw gcnew ArgumentNullException("slotNames");
+            }
+
+            array<Byte>^ name = Encoding::UTF8->GetBytes(slotNames[i]);
+            if (name->Length > 0) {
+                pin_ptr<Byte> pinnedName = &name[0];
+                names[i].assign(reinterpret_cast<const char*>(static_cast<Byte*>(pinnedName)), (size_t)name->Length);
+            }
+
+            namePointers[i] = names[i].c_str();
+        }
+
+        page = new PageTemplate();
+
+        const char* error = NULL;
+        bool compiled;
+
+        if (source->Length == 0) {
+            compiled = page->Compile(NULL, 0, namePointers.data(), namePointers.size(), &error);
+        }
+        else {
+            pin_ptr<Byte> pinnedSource = &source[0];
+            compiled = page->Compile(pinnedSource, (size_t)source->Length, namePointers.data(), namePointers.size(), &error);
+        }
+
+        if (!compiled) {
+            delete page;
+            page = NULL;
+
+            throw gcnew FormatException(gcnew String(error));
+        }
+    }
+
+    PageTemplateRenderer::~PageTemplateRenderer() {
+        this->!PageTemplateRenderer();
+    }
+
+    PageTemplateRenderer::!PageTemplateRenderer() {
+        if (page != NULL) {
+            delete page;
+            page = NULL;
+        }
+    }
+
+    int PageTemplateRenderer::SlotCount::get() {
+        return (int)page->SlotCount();
+    }
+
+    array<Byte>^ PageTemplateRenderer::Render(array<Object^>^ values) {
+        if (values == nullptr) {
+            throw gcnew ArgumentNullException("values");
+        }
+
+        if (values->Length != (int)page->SlotCount()) {
+            throw gcnew ArgumentOutOfRangeException("values");
+        }
+
+        PageScratch& scratch = PageTemplate::Scratch();
+
+        // Size everything first, so the scratch buffers don't move while values point into them.
+        size_t textLength = 0;
+        size_t itemCount = 0;
+
+        for (int i = 0; i < values->Length; i++) {
+            IList<String^>^ list = dynamic_cast<IList<String^>^>(values[i]);
+
+            if (list != nullptr) {
+                for (int k = 0; k < list->Count; k++) {
+                    textLength += maxLength(list[k]);
+                }
+
+                itemCount += (size_t)list->Count;
+            }
+            else if (values[i] == nullptr || dynamic_cast<String^>(values[i]) != nullptr || dynamic_cast<array<Byte>^>(values[i]) != nullptr) {
+                textLength += maxLength(values[i]);
+            }
+            else if (dynamic_cast<Boolean^>(values[i]) == nullptr) {
+                throw gcnew ArgumentException("Values must be strings, UTF-8 byte arrays, booleans, lists of strings or null.", "values");
+            }
+        }
+
+        scratch.text.resize(textLength);
+        scratch.items.resize(itemCount);
+        scratch.values.resize((size_t)values->Length);
+
+        size_t textUsed = 0;
+        size_t itemsUsed = 0;
+
+        for (int i = 0; i < values->Length; i++) {
+            PageValue& value = scratch.values[(size_t)i];
+            memset(&value, 0, sizeof(value));
+
+            IList<String^>^ list = dynamic_cast<IList<String^>^>(values[i]);
+            Boolean^ flag = dynamic_cast<Boolean^>(values[i]);
+
+            if (list != nullptr) {
+                value.items = scratch.items.data() + itemsUsed;
+                value.itemCount = (size_t)list->Count;
+                value.truthy = list->Count > 0;
+
+                for (int k = 0; k < list->Count; k++) {
+                    PageValue& item = scratch.items[itemsUsed++];
+                    memset(&item, 0, sizeof(item));
+
+                    item.length = encode(list[k], scratch.text, textUsed);
+                    item.text = scratch.text.data() + textUsed;
+                    item.truthy = item.length > 0;
+                    textUsed += item.length;
+                }
+            }
+            else if (flag != nullptr) {
+                value.truthy = *flag;
+            }
+            else {
+                value.length = encode(values[i], scratch.text, textUsed);
+                value.text = scratch.text.data() + textUsed;
+                value.truthy = value.length > 0;
+                textUsed += value.length;
+            }
+        }
+
+        page->Render(scratch.values.data(), scratch.output);
+
+        array<Byte>^ rendered = gcnew array<Byte>((int)scratch.output.size());
+        if (rendered->Length > 0) {
+            Marshal::Copy(IntPtr(scratch.output.data()), rendered, 0, rendered->Length);
+        }
+
+        return rendered;
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+class PageTemplate;
+
+using namespace System;
+
+namespace FilterNativeWindows {
+    /// <summary>
+    /// A block page template compiled once into literal runs and typed slots, rendered to UTF-8 in a single pass.
+    /// Supports {{name}}, {{{name}}}, {{#if name}}, {{else}} and {{#each name}} with {{@value}}.
+    /// </summary>
+    /// <remarks>
+    /// Any number of renders can run at once. The only managed allocation a render makes is the page it returns.
+    /// </remarks>
+    public ref class PageTemplateRenderer {
+    public:
+        /// <param name="source">The template, UTF-8 encoded.</param>
+        /// <param name="slotNames">Names the template may use. Values are passed to Render() in the same order.</param>
+        /// <exception cref="FormatException">The template uses something outside the supported subset, or a name not in slotNames.</exception>
+        PageTemplateRenderer(array<Byte>^ source, array<String^>^ slotNames);
+        ~PageTemplateRenderer();
+        !PageTemplateRenderer();
+
+        property int SlotCount {
+            int get();
+        }
+
+        /// <summary>
+        /// Renders the page with one value per slot. A value may be a String, a Byte array holding UTF-8 text, a Boolean,
+        /// a list of strings for #each, or null.
+        /// </summary>
+        array<Byte>^ Render(array<Object^>^ values);
+
+    private:
+        PageTemplate* page;
+    };
+}
@@ -1,81 +1,145 @@
 #include <Windows.h>
+#include <TlHelp32.h>
 #include <WtsApi32.h>
 
-#include "Filter.Native.Windows.h"
+#include <cwchar>
+#include <vector>
 
-unsigned int GetActiveSessionId() {
-    PWTS_SESSION_INFOW pSessionInfo = NULL;
-    DWORD activeSessionId = -1;
+#include "ProcessCreation.h"
+
+static SessionTable* volatile sessionTable = NULL;
+
+SessionTable* GetSessionTable() {
+    SessionTable* table = sessionTable;
+    if (table != NULL) {
+        return table;
+    }
+
+    // Never freed, so cached tokens last as long as the service.
+    static WindowsSessionBackend backend;
+
+    table = new SessionTable(&backend);
+
+    SessionTable* existing = (SessionTable*)InterlockedCompareExchangePointer((PVOID volatile*)&sessionTable, table, NULL);
+    if (existing != NULL) {
+        delete table;
+        return existing;
+    }
+
+    return table;
+}
+
+bool WindowsSessionBackend::EnumerateSessions(std::vector<SessionInfo>& sessions) {
+    PWTS_SESSION_INFOW sessionInfo = NULL;
     DWORD sessionCount = 0;
+    bool foundActive = false;
 
-    if (WTSEnumerateSessionsW(WTS_CURRENT_SERVER_HANDLE, 0, 1, &pSessionInfo, &sessionCount) != 0) {
+    // Tells the console's session from remote ones, which are WTSActive as well.
+    DWORD consoleSessionId = WTSGetActiveConsoleSessionId();
+
+    if (WTSEnumerateSessionsW(WTS_CURRENT_SERVER_HANDLE, 0, 1, &sessionInfo, &sessionCount) != 0) {
         for (DWORD i = 0; i < sessionCount; i++) {
-            if (pSessionInfo[i].State == WTSActive) {
-                activeSessionId = pSessionInfo[i].SessionId;
-            }
+            SessionInfo session;
+            session.id = sessionInfo[i].SessionId;
+            session.active = sessionInfo[i].State == WTSActive;
+            session.console = session.active && session.id == consoleSessionId;
+            session.loggedOn = sessionInfo[i].State == WTSActive || sessionInfo[i].State == WTSDisconnected;
+
+            foundActive |= session.active;
+            sessions.push_back(session);
         }
+
+        WTSFreeMemory(sessionInfo);
     }
 
     // If enumerating did not work, fall back to the old method.
-    if (activeSessionId == -1) {
-        activeSessionId = WTSGetActiveConsoleSessionId();
+    if (!foundActive) {
+        if (consoleSessionId != 0xFFFFFFFF) {
+            SessionInfo session;
+            session.id = consoleSessionId;
+            session.active = true;
+            session.console = true;
+            session.loggedOn = true;
+
+            sessions.push_back(session);
+            foundActive = true;
+        }
     }
 
-    return activeSessionId;
+    return foundActive;
 }
 
-static BOOL GetSessionUserToken(PHANDLE phUserToken) {
-    HANDLE hImpersonationToken = NULL;
-    PWTS_SESSION_INFOW pSessionInfo = NULL;
-    BOOL bResult = false;
+unsigned int WindowsSessionBackend::FindWinlogon(unsigned int sessionId) {
+    HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+    if (snapshot == INVALID_HANDLE_VALUE) {
+        return 0;
+    }
 
-    DWORD activeSessionId = GetActiveSessionId();
+    unsigned int pid = 0;
 
-    if (WTSQueryUserToken(activeSessionId, &hImpersonationToken) != 0) {
-        bResult = DuplicateTokenEx(hImpersonationToken, 0, NULL, SecurityImpersonation, TokenPrimary, phUserToken);
+    PROCESSENTRY32W entry;
+    entry.dwSize = sizeof(entry);
 
-        CloseHandle(hImpersonationToken);
-    }
+    for (BOOL more = Process32FirstW(snapshot, &entry); more && pid == 0; more = Process32NextW(snapshot, &entry)) {
+        DWORD processSessionId;
 
-    return bResult;
-}
-
-int CreateProcessInCurrentSession(wchar_t* filename, wchar_t* cmdline, int winlogonPid) {
-    if (winlogonPid < 0) {
-        return false;
+        if (_wcsicmp(entry.szExeFile, L"winlogon.exe") == 0 && ProcessIdToSessionId(entry.th32ProcessID, &processSessionId) && processSessionId == sessionId) {
+            pid = entry.th32ProcessID;
+        }
     }
 
-    HANDLE winlogon = OpenProcess(MAXIMUM_ALLOWED, false, winlogonPid);
+    CloseHandle(snapshot);
+    return pid;
+}
 
+void* WindowsSessionBackend::OpenToken(unsigned int pid, unsigned int* error) {
+    HANDLE winlogon = OpenProcess(MAXIMUM_ALLOWED, false, pid);
     if (winlogon == NULL) {
-        return false;
+        *error = GetLastError();
+        return NULL;
     }
 
     HANDLE tokenHandle = NULL, duplicatedToken = NULL;
-    if (!OpenProcessToken(winlogon, TOKEN_DUPLICATE, &tokenHandle)) {
-        CloseHandle(winlogon);
-        return false;
+
+    // With a duplicate of winlogon's token we can start an elevated process in its session.
+    if (!OpenProcessToken(winlogon, TOKEN_DUPLICATE, &tokenHandle)
+        || !DuplicateTokenEx(tokenHandle, MAXIMUM_ALLOWED, NULL, SecurityIdentification, TokenPrimary, &duplicatedToken)) {
+        *error = GetLastError();
+        duplicatedToken = NULL;
     }
 
-    // Now that we have access to winlogon's token, we can duplicate it and use that duplicate to start an elevated process in the current session.
-    if (!DuplicateTokenEx(tokenHandle, MAXIMUM_ALLOWED, NULL, SecurityIdentification, TokenPrimary, &duplicatedToken)) {
-        CloseHandle(winlogon);
+    if (tokenHandle != NULL) {
         CloseHandle(tokenHandle);
-
-        return false;
     }
 
+    CloseHandle(winlogon);
+    return duplicatedToken;
+}
+
+void WindowsSessionBackend::CloseToken(void* token) {
+    CloseHandle((HANDLE)token);
+}
+
+unsigned int WindowsSessionBackend::Launch(void* token, const wchar_t* filename, const wchar_t* commandLine) {
+    // CreateProcessAsUserW() may write to the command line.
+    std::vector<wchar_t> mutableCommandLine(commandLine, commandLine + wcslen(commandLine) + 1);
+
     PROCESS_INFORMATION newProcessInfo;
 
-    STARTUPINFO si;
-    memset(&si, 0, sizeof(STARTUPINFO));
-    si.cb = sizeof(STARTUPINFO);
+    STARTUPINFOW si;
+    memset(&si, 0, sizeof(STARTUPINFOW));
+    si.cb = sizeof(STARTUPINFOW);
 
     // Interactive window station parameter; this indicates that the process can display a GUI on the desktop.
-    si.lpDesktop = L"winsta0\\default";
+    si.lpDesktop = const_cast<LPWSTR>(L"winsta0\\default");
 
-    BOOL result = CreateProcessAsUser(duplicatedToken, filename, cmdline, NULL, NULL, false,
-        NORMAL_PRIORITY_CLASS | CREATE_NEW_CONSOLE, NULL, NULL, &si, &newProcessInfo);
+    if (!CreateProcessAsUserW((HANDLE)token, filename, mutableCommandLine.data(), NULL, NULL, false,
+        NORMAL_PRIORITY_CLASS | CREATE_NEW_CONSOLE, NULL, NULL, &si, &newProcessInfo)) {
+        return GetLastError();
+    }
+
+    CloseHandle(newProcessInfo.hThread);
+    CloseHandle(newProcessInfo.hProcess);
 
-    return result;
-}
\ No newline at end of file
+    return 0;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "SessionTable.h"
+
+/// Finds sessions through WTS, winlogon through a Toolhelp snapshot, and launches with
+/// CreateProcessAsUserW() onto winsta0\default.
+class WindowsSessionBackend : public SessionBackend {
+public:
+    virtual bool EnumerateSessions(std::vector<SessionInfo>& sessions);
+    virtual unsigned int FindWinlogon(unsigned int sessionId);
+
+    virtual void* OpenToken(unsigned int pid, unsigned int* error);
+    virtual void CloseToken(void* token);
+
+    virtual unsigned int Launch(void* token, const wchar_t* filename, const wchar_t* commandLine);
+};
+
+/// Table shared by everything in the process that launches into the user's session.
+SessionTable* GetSessionTable();
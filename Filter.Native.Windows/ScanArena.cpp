@@ -0,0 +1,25 @@
+#include "ScanArena.h"
+
+#include <cstdlib>
+
+ScanArena::ScanArena(size_t capacity) : capacity(capacity), used(0) {
+    block = static_cast<unsigned char*>(malloc(capacity));
+    if (block == NULL) {
+        this->capacity = 0;
+    }
+}
+
+ScanArena::~ScanArena() {
+    free(block);
+}
+
+void* ScanArena::Allocate(size_t size, size_t alignment) {
+    // malloc's block is aligned for any fundamental type, so aligning the offset is enough.
+    size_t start = (used + alignment - 1) & ~(alignment - 1);
+    if (start > capacity || size > capacity - start) {
+        return NULL;
+    }
+
+    used = start + size;
+    return block + start;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+
+/// Bump pointer allocator over a single block that is reserved up front and never grows.
+/// Releasing back to a mark is O(1), and nothing is freed individually.
+class ScanArena {
+public:
+    explicit ScanArena(size_t capacity);
+    ~ScanArena();
+
+    // Returns NULL when the block doesn't have room left. Callers fall back to the heap.
+    void* Allocate(size_t size, size_t alignment);
+
+    size_t Mark() const { return used; }
+    void Release(size_t mark) { used = mark; }
+
+    size_t Used() const { return used; }
+    size_t Capacity() const { return capacity; }
+
+private:
+    ScanArena(const ScanArena&);
+    ScanArena& operator=(const ScanArena&);
+
+    unsigned char* block;
+    size_t capacity;
+    size_t used;
+};
@@ -0,0 +1,177 @@
+#include "MemoryBudget.h"
+#include "ScanContext.h"
+
+#include <atomic>
+#include <mutex>
+#include <new>
+
+// Room in front of each spilled block for the list link, keeping the block 16 byte aligned.
+#define SPILL_HEADER_SIZE 16
+
+static std::atomic<unsigned long long> totalScans(0);
+static std::atomic<unsigned long long> totalArenaAllocations(0);
+static std::atomic<unsigned long long> totalArenaBytes(0);
+static std::atomic<unsigned long long> totalHeapAllocations(0);
+static std::atomic<unsigned long long> totalOversizedScans(0);
+static std::atomic<unsigned long long> liveContexts(0);
+static std::atomic<unsigned long long> reservedBytes(0);
+
+// Bumped by every compaction. Contexts that trimmed for an older one trim again after their next scan.
+static std::atomic<unsigned long long> trimGeneration(0);
+
+static void requestTrim(void*) {
+    trimGeneration.fetch_add(1, std::memory_order_relaxed);
+}
+
+static size_t jsonBufferBytes(const JsonStringScanner& json) {
+    return json.Text().capacity() + json.Spans().capacity() * sizeof(JsonStringSpan);
+}
+
+ScanContext::ScanContext()
+    : arena(SCAN_ARENA_CAPACITY), json('"'), depth(0), oversized(false), charged(0),
+    scans(0), arenaAllocations(0), arenaBytes(0), heapAllocations(0), oversizedScans(0) {
+    static std::once_flag compactionAdded;
+    std::call_once(compactionAdded, [] {
+        MemoryBudget::AddCompaction(MEMORY_TAG_SCAN_BUFFERS, requestTrim, NULL);
+    });
+
+    trimmed = trimGeneration.load(std::memory_order_relaxed);
+
+    // The arena block itself is the one allocation every thread pays for once. A thread can't scan
+    // without it, so it is charged whatever the budget says.
+    heapAllocations = 1;
+    MemoryBudget::Charge(MEMORY_TAG_SCAN_BUFFERS, arena.Capacity());
+
+    liveContexts.fetch_add(1, std::memory_order_relaxed);
+    reservedBytes.fetch_add(arena.Capacity(), std::memory_order_relaxed);
+}
+
+ScanContext::~ScanContext() {
+    publish();
+
+    MemoryBudget::Release(MEMORY_TAG_SCAN_BUFFERS, arena.Capacity() + charged);
+
+    liveContexts.fetch_sub(1, std::memory_order_relaxed);
+    reservedBytes.fetch_sub(arena.Capacity(), std::memory_order_relaxed);
+}
+
+ScanContext& ScanContext::Current() {
+    static thread_local ScanContext context;
+    return context;
+}
+
+const std::vector<unsigned char>& ScanContext::ExtractJson(const unsigned char* data, size_t length) {
+    size_t textCapacity = json.Text().capacity();
+    size_t spanCapacity = json.Spans().capacity();
+
+    json.Reset();
+    json.Feed(data, length);
+    json.Finish();
+
+    if (json.Text().capacity() != textCapacity) {
+        heapAllocations++;
+    }
+
+    if (json.Spans().capacity() != spanCapacity) {
+        heapAllocations++;
+    }
+
+    return json.Text();
+}
+
+void ScanContext::publish() {
+    if (json.Text().capacity() > SCAN_JSON_BUFFER_LIMIT) {
+        // Don't let one huge document pin its buffers to the thread forever.
+        json = JsonStringScanner('"');
+        oversized = true;
+    }
+
+    unsigned long long generation = trimGeneration.load(std::memory_order_relaxed);
+    if (generation != trimmed) {
+        json = JsonStringScanner('"');
+        trimmed = generation;
+    }
+
+    size_t bytes = jsonBufferBytes(json);
+    if (bytes > charged && !MemoryBudget::TryCharge(MEMORY_TAG_SCAN_BUFFERS, bytes - charged)) {
+        // The next JSON document on this thread grows them again, but they aren't kept past it.
+        json = JsonStringScanner('"');
+        bytes = jsonBufferBytes(json);
+    }
+
+    if (bytes < charged) {
+        MemoryBudget::Release(MEMORY_TAG_SCAN_BUFFERS, charged - bytes);
+    }
+
+    charged = bytes;
+
+    if (oversized) {
+        oversizedScans++;
+        oversized = false;
+    }
+
+    totalScans.fetch_add(scans, std::memory_order_relaxed);
+    totalArenaAllocations.fetch_add(arenaAllocations, std::memory_order_relaxed);
+    totalArenaBytes.fetch_add(arenaBytes, std::memory_order_relaxed);
+    totalHeapAllocations.fetch_add(heapAllocations, std::memory_order_relaxed);
+    totalOversizedScans.fetch_add(oversizedScans, std::memory_order_relaxed);
+
+    scans = 0;
+    arenaAllocations = 0;
+    arenaBytes = 0;
+    heapAllocations = 0;
+    oversizedScans = 0;
+}
+
+void ScanContext::GetStats(ScanAllocationStats* stats) {
+    stats->scans = totalScans.load(std::memory_order_relaxed);
+    stats->arenaAllocations = totalArenaAllocations.load(std::memory_order_relaxed);
+    stats->arenaBytes = totalArenaBytes.load(std::memory_order_relaxed);
+    stats->heapAllocations = totalHeapAllocations.load(std::memory_order_relaxed);
+    stats->oversizedScans = totalOversizedScans.load(std::memory_order_relaxed);
+    stats->contexts = liveContexts.load(std::memory_order_relaxed);
+    stats->reservedBytes = reservedBytes.load(std::memory_order_relaxed);
+}
+
+ScanScope::ScanScope() : context(ScanContext::Current()), spilled(NULL), spilledBytes(0) {
+    mark = context.arena.Mark();
+    context.depth++;
+}
+
+ScanScope::~ScanScope() {
+    while (spilled != NULL) {
+        void* next = *static_cast<void**>(spilled);
+        delete[] static_cast<unsigned char*>(spilled);
+        spilled = next;
+    }
+
+    MemoryBudget::Release(MEMORY_TAG_SCAN_BUFFERS, spilledBytes);
+
+    context.arena.Release(mark);
+
+    if (--context.depth == 0) {
+        context.publish();
+    }
+}
+
+void* ScanScope::allocate(size_t size, size_t alignment) {
+    void* memory = context.arena.Allocate(size, alignment);
+    if (memory != NULL) {
+        context.arenaAllocations++;
+        context.arenaBytes += size;
+        return memory;
+    }
+
+    // The arena is full. Take it from the heap and remember to free it with the scope.
+    unsigned char* block = new unsigned char[SPILL_HEADER_SIZE + size];
+    *reinterpret_cast<void**>(block) = spilled;
+    spilled = block;
+
+    // Already allocated and only held until the scope ends, so it is counted but never refused.
+    spilledBytes += SPILL_HEADER_SIZE + size;
+    MemoryBudget::Charge(MEMORY_TAG_SCAN_BUFFERS, SPILL_HEADER_SIZE + size);
+
+    context.heapAllocations++;
+    context.oversized = true;
+    return block + SPILL_HEADER_SIZE;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "JsonStringScanner.h"
+#include "ScanArena.h"
+
+// Scratch space each thread keeps for scanning. Scans that need more spill to the heap.
+#define SCAN_ARENA_CAPACITY (64 * 1024)
+
+// Largest JSON text buffer a thread holds on to between scans.
+#define SCAN_JSON_BUFFER_LIMIT (1024 * 1024)
+
+typedef struct ScanAllocationStats {
+    unsigned long long scans;
+
+    unsigned long long arenaAllocations;
+    unsigned long long arenaBytes;
+
+    // Every allocation scanning made from the heap: arena spills and growth of reusable buffers.
+    // Once each thread's buffers have warmed up, this stays flat.
+    unsigned long long heapAllocations;
+
+    // Scans that spilled out of the arena or outgrew the JSON buffer limit.
+    unsigned long long oversizedScans;
+
+    unsigned long long contexts;
+    unsigned long long reservedBytes;
+} ScanAllocationStats;
+
+/// Per-thread state reused by every scan that runs on the thread: a bump arena for short lived
+/// arrays and a JSON scanner whose buffers keep their capacity between scans.
+///
+/// Only the owning thread touches a context. Counters are published to process-wide totals when
+/// the thread's outermost ScanScope ends.
+///
+/// The arena, arena spills and the JSON buffers kept between scans are charged to
+/// MEMORY_TAG_SCAN_BUFFERS. Buffers the hard limit has no room for are dropped once the scan that
+/// grew them is done, and a compaction has every thread drop its buffers after its next scan.
+class ScanContext {
+public:
+    static ScanContext& Current();
+
+    static void GetStats(ScanAllocationStats* stats);
+
+    ScanArena& Arena() { return arena; }
+
+    /// Decodes the string values of a JSON document into the reused buffer, separated by quotes.
+    /// The result is valid until the next call on this thread.
+    const std::vector<unsigned char>& ExtractJson(const unsigned char* data, size_t length);
+
+    void CountScan() { scans++; }
+
+private:
+    friend class ScanScope;
+
+    ScanContext();
+    ~ScanContext();
+
+    ScanContext(const ScanContext&);
+    ScanContext& operator=(const ScanContext&);
+
+    void publish();
+
+    ScanArena arena;
+    JsonStringScanner json;
+
+    int depth;
+    bool oversized;
+
+    // JSON buffer bytes charged to the memory budget, and the compaction they were last trimmed for.
+    size_t charged;
+    unsigned long long trimmed;
+
+    unsigned long long scans;
+    unsigned long long arenaAllocations;
+    unsigned long long arenaBytes;
+    unsigned long long heapAllocations;
+    unsigned long long oversizedScans;
+};
+
+/// Everything allocated through a scope is released when it ends. Scopes nest, so a thread that
+/// helps with chunks of its own scan doesn't free the caller's arrays.
+class ScanScope {
+public:
+    ScanScope();
+    ~ScanScope();
+
+    ScanContext& Context() { return context; }
+
+    // Uninitialized storage for count plain values.
+    template<typename T> T* Allocate(size_t count) {
+        return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+    }
+
+private:
+    ScanScope(const ScanScope&);
+    ScanScope& operator=(const ScanScope&);
+
+    void* allocate(size_t size, size_t alignment);
+
+    ScanContext& context;
+    size_t mark;
+
+    // Heap blocks used when the arena was full, freed with the scope.
+    void* spilled;
+    size_t spilledBytes;
+};
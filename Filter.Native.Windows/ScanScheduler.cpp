@@ -0,0 +1,466 @@
+#include "ScanScheduler.h"
+#include "HotPathMetrics.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+
+// Queues in the order they are served.
+#define SCAN_CLASS_DOCUMENT_HEAD 0
+#define SCAN_CLASS_HEAD 1
+#define SCAN_CLASS_DOCUMENT_REST 2
+#define SCAN_CLASS_REST 3
+#define SCAN_CLASS_DEFERRED 4
+#define SCAN_CLASS_COUNT 5
+
+// Why acquire() gave up on a slot.
+#define ADMIT_GRANTED 0
+#define ADMIT_OVER_GLOBAL 1
+#define ADMIT_OVER_QUEUE 2
+#define ADMIT_TIMED_OUT 3
+#define ADMIT_OVER_REQUEST 4
+
+namespace {
+    // Lives on the stack of the thread that waits.
+    struct Waiter {
+        unsigned long long ticket;
+        bool granted;
+        std::condition_variable wake;
+        Waiter* next;
+    };
+
+    struct WaitList {
+        Waiter* first;
+        Waiter* last;
+    };
+
+    struct SchedulerState {
+        ScanSchedulerLimits limits;
+
+        mutable std::mutex lock;
+        WaitList waiting[SCAN_CLASS_COUNT];
+
+        // Waiting parts past the head, which maxQueued applies to.
+        size_t restQueued;
+
+        // Handed to each body as it arrives. Lists are kept in ticket order.
+        unsigned long long tickets;
+
+        // Nanoseconds of scanning the global budget has left. Goes negative when heads run in debt.
+        double tokens;
+        double capacity;
+        unsigned long long refilled;
+
+        ScanSchedulerStats stats;
+    };
+}
+
+struct ScanScheduler::Impl : SchedulerState {
+};
+
+static unsigned long long now() {
+    return (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool isHead(int scanClass) {
+    return scanClass == SCAN_CLASS_DOCUMENT_HEAD || scanClass == SCAN_CLASS_HEAD;
+}
+
+static void refill(SchedulerState* impl, unsigned long long time) {
+    if (impl->limits.globalBudget > 0 && time > impl->refilled) {
+        impl->tokens += (double)(time - impl->refilled) * impl->limits.globalBudget;
+
+        if (impl->tokens > impl->capacity) {
+            impl->tokens = impl->capacity;
+        }
+    }
+
+    impl->refilled = time;
+}
+
+static bool hasTokens(const SchedulerState* impl) {
+    return impl->limits.globalBudget <= 0 || impl->tokens > 0;
+}
+
+static void unlink(SchedulerState* impl, int scanClass, Waiter* waiter) {
+    WaitList& list = impl->waiting[scanClass];
+    Waiter* previous = NULL;
+
+    for (Waiter* w = list.first; w != NULL; previous = w, w = w->next) {
+        if (w == waiter) {
+            if (previous == NULL) {
+                list.first = w->next;
+            }
+            else {
+                previous->next = w->next;
+            }
+
+            if (list.last == w) {
+                list.last = previous;
+            }
+
+            break;
+        }
+    }
+
+    impl->stats.queued--;
+    if (!isHead(scanClass)) {
+        impl->restQueued--;
+    }
+}
+
+// Hands free slots to waiters in priority order. Stops at the first waiter that can't go, since
+// everything behind it needs at least as much.
+static void dispatch(SchedulerState* impl) {
+    for (int c = 0; c < SCAN_CLASS_COUNT; c++) {
+        WaitList& list = impl->waiting[c];
+
+        while (list.first != NULL) {
+            if (impl->stats.running >= impl->limits.slots || (!isHead(c) && !hasTokens(impl))) {
+                return;
+            }
+
+            Waiter* waiter = list.first;
+            unlink(impl, c, waiter);
+
+            waiter->granted = true;
+            impl->stats.running++;
+            waiter->wake.notify_one();
+        }
+    }
+}
+
+// Puts a waiter behind every part of the bodies that arrived before it. A body's next part goes
+// back where the body was, so the oldest body in a class finishes first instead of every body in
+// it taking turns and all of them finishing last.
+static void enqueue(SchedulerState* impl, int scanClass, Waiter* waiter) {
+    WaitList& list = impl->waiting[scanClass];
+
+    if (list.last == NULL) {
+        list.first = waiter;
+        list.last = waiter;
+    }
+    else if (list.last->ticket <= waiter->ticket) {
+        list.last->next = waiter;
+        list.last = waiter;
+    }
+    else if (waiter->ticket < list.first->ticket) {
+        waiter->next = list.first;
+        list.first = waiter;
+    }
+    else {
+        Waiter* w = list.first;
+
+        while (w->next->ticket <= waiter->ticket) {
+            w = w->next;
+        }
+
+        waiter->next = w->next;
+        w->next = waiter;
+    }
+
+    impl->stats.queued++;
+
+    if (impl->stats.queued > impl->stats.maxQueued) {
+        impl->stats.maxQueued = impl->stats.queued;
+    }
+
+    if (!isHead(scanClass)) {
+        impl->restQueued++;
+    }
+}
+
+// Waits for a slot. A deadline of zero waits for as long as it takes. A body's first call gets it
+// a ticket.
+static int acquire(SchedulerState* impl, int scanClass, unsigned long long deadline, unsigned long long* ticket, unsigned long long* waited) {
+    unsigned long long start = now();
+    std::unique_lock<std::mutex> guard(impl->lock);
+
+    refill(impl, start);
+    *waited = 0;
+
+    if (*ticket == 0) {
+        *ticket = ++impl->tickets;
+    }
+
+    if (scanClass == SCAN_CLASS_DOCUMENT_REST || scanClass == SCAN_CLASS_REST) {
+        if (!hasTokens(impl)) {
+            return ADMIT_OVER_GLOBAL;
+        }
+
+        if (impl->limits.maxQueued > 0 && impl->restQueued >= impl->limits.maxQueued) {
+            return ADMIT_OVER_QUEUE;
+        }
+    }
+
+    Waiter waiter;
+    waiter.ticket = *ticket;
+    waiter.granted = false;
+    waiter.next = NULL;
+
+    enqueue(impl, scanClass, &waiter);
+    dispatch(impl);
+
+    while (!waiter.granted) {
+        unsigned long long time = now();
+
+        if (deadline != 0 && time >= deadline) {
+            unlink(impl, scanClass, &waiter);
+            *waited = time - start;
+            return ADMIT_TIMED_OUT;
+        }
+
+        // Nothing wakes a part that waits for the budget to refill, so it looks again once it has.
+        unsigned long long until = deadline;
+
+        if (!isHead(scanClass) && !hasTokens(impl)) {
+            unsigned long long refilledAt = time + (unsigned long long)(-impl->tokens / impl->limits.globalBudget) + 1;
+
+            if (until == 0 || refilledAt < until) {
+                until = refilledAt;
+            }
+        }
+
+        if (until == 0) {
+            waiter.wake.wait(guard);
+        }
+        else {
+            waiter.wake.wait_until(guard, std::chrono::steady_clock::time_point(std::chrono::nanoseconds(until)));
+        }
+
+        if (!waiter.granted) {
+            refill(impl, now());
+            dispatch(impl);
+        }
+    }
+
+    *waited = now() - start;
+    return ADMIT_GRANTED;
+}
+
+// Whether a part of nextClass, for the body with ticket, should go ahead of everything waiting.
+static bool isNext(const SchedulerState* impl, int nextClass, unsigned long long ticket) {
+    for (int c = 0; c < nextClass; c++) {
+        if (impl->waiting[c].first != NULL) {
+            return false;
+        }
+    }
+
+    const Waiter* first = impl->waiting[nextClass].first;
+    return first == NULL || first->ticket > ticket;
+}
+
+// Charges a finished part and gives up its slot, unless nextClass is the class of the body's next
+// part and that part would be let in ahead of every waiter anyway. Keeping the slot then saves the
+// handoff, and keeps the slot from going to a younger body in the moment before the next part
+// queues. A nextClass below zero always gives it up. Returns whether the slot was kept.
+static bool release(SchedulerState* impl, int nextClass, unsigned long long ticket, unsigned long long waited, unsigned long long cost) {
+    std::lock_guard<std::mutex> guard(impl->lock);
+
+    impl->stats.parts++;
+    impl->stats.scanNanoseconds += cost;
+    impl->stats.waitNanoseconds += waited;
+
+    if (waited > impl->stats.maxWaitNanoseconds) {
+        impl->stats.maxWaitNanoseconds = waited;
+    }
+
+    refill(impl, now());
+    impl->tokens -= (double)cost;
+
+    if (nextClass >= 0 && (isHead(nextClass) || hasTokens(impl)) && isNext(impl, nextClass, ticket)) {
+        return true;
+    }
+
+    impl->stats.running--;
+    dispatch(impl);
+    return false;
+}
+
+ScanScheduler::ScanScheduler(const ScanSchedulerLimits& limits) : impl(new Impl()) {
+    impl->limits = limits;
+
+    if (impl->limits.slots == 0) {
+        impl->limits.slots = 1;
+    }
+
+    for (int c = 0; c < SCAN_CLASS_COUNT; c++) {
+        impl->waiting[c].first = NULL;
+        impl->waiting[c].last = NULL;
+    }
+
+    impl->restQueued = 0;
+    impl->tickets = 0;
+
+    // A full bucket is one window's worth, so an idle scheduler can take a burst that long.
+    impl->capacity = limits.globalBudget * (double)limits.window;
+    impl->tokens = impl->capacity;
+    impl->refilled = now();
+
+    memset(&impl->stats, 0, sizeof(impl->stats));
+}
+
+ScanScheduler::~ScanScheduler() {
+    delete impl;
+}
+
+int ScanScheduler::Run(size_t length, int priority, ScanPartTask task, void* context) {
+    const ScanSchedulerLimits& limits = impl->limits;
+    bool document = priority == SCAN_PRIORITY_DOCUMENT;
+    size_t partBytes = limits.headBytes > 0 ? limits.headBytes : length;
+
+    unsigned long long ticket = 0;
+    unsigned long long spent = 0;
+    size_t begin = 0;
+    bool head = true;
+    bool holding = false;
+    bool deferring = false;
+    bool found = false;
+    int outcome = SCAN_OUTCOME_CLEAN;
+
+    while (begin < length && !found) {
+        int scanClass;
+        unsigned long long deadline = 0;
+        unsigned long long waited = 0;
+        int admitted;
+
+        if (head) {
+            scanClass = document ? SCAN_CLASS_DOCUMENT_HEAD : SCAN_CLASS_HEAD;
+        }
+        else if (deferring) {
+            scanClass = SCAN_CLASS_DEFERRED;
+        }
+        else {
+            scanClass = document ? SCAN_CLASS_DOCUMENT_REST : SCAN_CLASS_REST;
+        }
+
+        if (!head && !deferring && limits.requestBudget > 0 && spent >= limits.requestBudget) {
+            admitted = ADMIT_OVER_REQUEST;
+        }
+        else if (holding) {
+            admitted = ADMIT_GRANTED;
+        }
+        else {
+            if (scanClass == SCAN_CLASS_DEFERRED) {
+                deadline = limits.maxDefer > 0 ? now() + limits.maxDefer : 0;
+            }
+            else if (!head && limits.maxWait > 0) {
+                deadline = now() + limits.maxWait;
+            }
+
+            admitted = acquire(impl, scanClass, deadline, &ticket, &waited);
+            HotPathMetrics::Record(HOT_PATH_SCAN_WAIT, waited);
+        }
+
+        if (admitted != ADMIT_GRANTED) {
+            std::lock_guard<std::mutex> guard(impl->lock);
+
+            // Only SCAN_OVER_BUDGET_HEAD_ONLY lets the rest of a body through unscanned.
+            if (deferring) {
+                impl->stats.deferExpired++;
+                outcome = SCAN_OUTCOME_REFUSED;
+                break;
+            }
+
+            switch (admitted) {
+            case ADMIT_OVER_GLOBAL:
+                impl->stats.overGlobalBudget++;
+                break;
+
+            case ADMIT_OVER_QUEUE:
+                impl->stats.overQueueLimit++;
+                break;
+
+            case ADMIT_TIMED_OUT:
+                impl->stats.overWaitLimit++;
+                break;
+
+            default:
+                impl->stats.overRequestBudget++;
+                break;
+            }
+
+            if (limits.overBudget == SCAN_OVER_BUDGET_DEFER) {
+                impl->stats.deferred++;
+                HotPathMetrics::Add(HOT_PATH_SCANS_DEFERRED, 1);
+                deferring = true;
+                continue;
+            }
+
+            outcome = limits.overBudget == SCAN_OVER_BUDGET_FAIL_CLOSED ? SCAN_OUTCOME_REFUSED : SCAN_OUTCOME_TRUNCATED;
+            break;
+        }
+
+        size_t end = length - begin > partBytes ? begin + partBytes : length;
+        size_t next = end;
+
+        unsigned long long start = now();
+        found = task(context, begin, end, &next);
+        unsigned long long cost = now() - start;
+
+        spent += cost;
+        begin = next;
+        head = false;
+
+        // The next part keeps the slot only if it would get one without going over budget.
+        int nextClass = -1;
+
+        if (!found && begin < length && (deferring || limits.requestBudget == 0 || spent < limits.requestBudget)) {
+            nextClass = deferring ? SCAN_CLASS_DEFERRED : document ? SCAN_CLASS_DOCUMENT_REST : SCAN_CLASS_REST;
+        }
+
+        holding = release(impl, nextClass, ticket, waited, cost);
+    }
+
+    if (found) {
+        outcome = SCAN_OUTCOME_MATCHED;
+    }
+
+    std::lock_guard<std::mutex> guard(impl->lock);
+    impl->stats.bodies++;
+
+    switch (outcome) {
+    case SCAN_OUTCOME_MATCHED:
+        impl->stats.matched++;
+        break;
+
+    case SCAN_OUTCOME_TRUNCATED:
+        impl->stats.truncated++;
+        HotPathMetrics::Add(HOT_PATH_SCANS_TRUNCATED, 1);
+        break;
+
+    case SCAN_OUTCOME_REFUSED:
+        impl->stats.refused++;
+        HotPathMetrics::Add(HOT_PATH_SCANS_REFUSED, 1);
+        break;
+
+    default:
+        impl->stats.clean++;
+        break;
+    }
+
+    return outcome;
+}
+
+void ScanScheduler::GetStats(ScanSchedulerStats* stats) const {
+    std::lock_guard<std::mutex> guard(impl->lock);
+    *stats = impl->stats;
+}
+
+void ScanScheduler::ResetStats() {
+    std::lock_guard<std::mutex> guard(impl->lock);
+
+    size_t queued = impl->stats.queued;
+    unsigned int running = impl->stats.running;
+
+    memset(&impl->stats, 0, sizeof(impl->stats));
+    impl->stats.queued = queued;
+    impl->stats.maxQueued = queued;
+    impl->stats.running = running;
+}
+
+const ScanSchedulerLimits& ScanScheduler::Limits() const {
+    return impl->limits;
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstddef>
+
+// What a body is, for the order parts wait in. Documents are top-level pages, which the user is
+// looking at; everything else is what they load.
+#define SCAN_PRIORITY_DOCUMENT 0
+#define SCAN_PRIORITY_SUBRESOURCE 1
+
+// What happens to the rest of a body once scanning it would go over budget.
+#define SCAN_OVER_BUDGET_HEAD_ONLY 0
+#define SCAN_OVER_BUDGET_DEFER 1
+#define SCAN_OVER_BUDGET_FAIL_CLOSED 2
+
+// How a scheduled scan ended.
+#define SCAN_OUTCOME_CLEAN 0
+#define SCAN_OUTCOME_MATCHED 1
+
+// Only part of the body was scanned and nothing matched in that part.
+#define SCAN_OUTCOME_TRUNCATED 2
+
+// The body went over budget under SCAN_OVER_BUDGET_FAIL_CLOSED, or was still deferred after
+// maxDefer under SCAN_OVER_BUDGET_DEFER.
+#define SCAN_OUTCOME_REFUSED 3
+
+/// Scans [begin, end) of a body, where begin is 0 or the *next of the part before. Sets *next to
+/// where the following part starts, which may be past end, and returns true on a match.
+typedef bool (*ScanPartTask)(void* context, size_t begin, size_t end, size_t* next);
+
+typedef struct ScanSchedulerLimits {
+    // Parts scanned at once, across every body.
+    unsigned int slots;
+
+    // The first headBytes of every body are scanned ahead of the rest of any body, and are never
+    // cut short. The rest is scanned in parts of this size, so a head that arrives waits for at
+    // most one part.
+    size_t headBytes;
+
+    // Scan time one body may use, in nanoseconds. Zero for no limit.
+    unsigned long long requestBudget;
+
+    // Scan time all bodies together may use, in processors' worth, averaged over window
+    // nanoseconds. Zero for no limit.
+    double globalBudget;
+    unsigned long long window;
+
+    // How long a part past the head may wait for a slot, and how many may wait at once, before
+    // they count as over budget. Zero for no limit.
+    unsigned long long maxWait;
+    size_t maxQueued;
+
+    // SCAN_OVER_BUDGET_*. Deferred parts wait behind everything else until the global budget has
+    // room again, for up to maxDefer nanoseconds, and the body is refused after that.
+    int overBudget;
+    unsigned long long maxDefer;
+} ScanSchedulerLimits;
+
+typedef struct ScanSchedulerStats {
+    // Parts waiting for a slot now, and the most there ever were.
+    size_t queued;
+    size_t maxQueued;
+    unsigned int running;
+
+    unsigned long long bodies;
+    unsigned long long parts;
+
+    // Bodies by SCAN_OUTCOME_*.
+    unsigned long long clean;
+    unsigned long long matched;
+    unsigned long long truncated;
+    unsigned long long refused;
+
+    // Times a part went over budget, by reason. One body can go over more than once when it is
+    // deferred.
+    unsigned long long overRequestBudget;
+    unsigned long long overGlobalBudget;
+    unsigned long long overQueueLimit;
+    unsigned long long overWaitLimit;
+
+    unsigned long long deferred;
+
+    // Deferred parts that were dropped after waiting maxDefer.
+    unsigned long long deferExpired;
+
+    // Total and longest time parts waited for a slot, in nanoseconds.
+    unsigned long long waitNanoseconds;
+    unsigned long long maxWaitNanoseconds;
+
+    // Time spent scanning parts, in nanoseconds.
+    unsigned long long scanNanoseconds;
+} ScanSchedulerStats;
+
+/// Admission control for content scans. Every scan is split into its head and the rest, and each
+/// part waits for one of a fixed number of slots before it runs on the calling thread. Waiting
+/// parts go in strict priority order: document heads, other heads, the rest of documents, the rest
+/// of everything else, then deferred parts. Within each, parts go in the order their bodies arrived,
+/// so a body that got past its head runs to the end before younger ones do.
+///
+/// A body's scan time is charged to its own budget and to a shared token bucket that refills at
+/// globalBudget nanoseconds per nanosecond. Heads always run, even in debt. A part past the head
+/// that would go over either budget, or that finds the queue full or waits too long, is handled by
+/// the overBudget policy instead.
+///
+/// Wait times are also recorded in HotPathMetrics as HOT_PATH_SCAN_WAIT. Any number of threads can
+/// schedule scans at once.
+class ScanScheduler {
+public:
+    explicit ScanScheduler(const ScanSchedulerLimits& limits);
+    ~ScanScheduler();
+
+    /// Scans a body of length bytes through task, a part at a time, and returns a SCAN_OUTCOME_*.
+    int Run(size_t length, int priority, ScanPartTask task, void* context);
+
+    void GetStats(ScanSchedulerStats* stats) const;
+
+    /// Zeroes every count but the parts waiting and running now.
+    void ResetStats();
+
+    const ScanSchedulerLimits& Limits() const;
+
+private:
+    ScanScheduler(const ScanScheduler&);
+    ScanScheduler& operator=(const ScanScheduler&);
+
+    struct Impl;
+    Impl* impl;
+};
@@ -22,7 +22,7 @@ namespace FilterNativeWindows {
         wcscpy(mutable_objectName, c_objectName);
 
         int ret = ::SetObjectAsSystemOnly(mutable_objectName, (SE_OBJECT_TYPE)objectType);
-        delete mutable_objectName;
+        delete[] mutable_objectName;
     }
 
     bool Security::SetServiceSecurity(String^ serviceName, RawSecurityDescriptor^ securityDescriptor) {
@@ -30,6 +30,10 @@ namespace FilterNativeWindows {
             throw gcnew ArgumentNullException("serviceName");
         }
 
+        if (securityDescriptor == nullptr) {
+            throw gcnew ArgumentNullException("securityDescriptor");
+        }
+
         wchar_t* name = NULL;
         SC_HANDLE service = NULL;
         SECURITY_DESCRIPTOR* descriptor = NULL;
@@ -37,6 +41,8 @@ namespace FilterNativeWindows {
         try {
             name = getCStringFromString(serviceName);
 
+            descriptor = (SECURITY_DESCRIPTOR*)new unsigned char[securityDescriptor->BinaryLength];
+
             array<unsigned char>^ binaryForm = gcnew array<unsigned char>(securityDescriptor->BinaryLength);
             securityDescriptor->GetBinaryForm(binaryForm, 0);
             Marshal::Copy(binaryForm, 0, IntPtr::IntPtr(descriptor), securityDescriptor->BinaryLength);
@@ -54,7 +60,7 @@ namespace FilterNativeWindows {
         }
         finally {
             if (name != NULL) {
-                delete name;
+                delete[] name;
             }
 
             if (service != NULL) {
@@ -62,7 +68,7 @@ namespace FilterNativeWindows {
             }
 
             if (descriptor != NULL) {
-                delete descriptor;
+                delete[] (unsigned char*)descriptor;
             }
         }
     }
@@ -91,7 +97,7 @@ namespace FilterNativeWindows {
             while (true) {
                 if (!QueryServiceObjectSecurity(service, DACL_SECURITY_INFORMATION, descriptor, bufSize, &bytesNeeded)) {
                     if (bytesNeeded > bufSize) {
-                        delete descriptor;
+                        delete[] (unsigned char*)descriptor;
 
                         bufSize = bytesNeeded;
                         descriptor = (SECURITY_DESCRIPTOR*)new unsigned char[bufSize];
@@ -114,7 +120,7 @@ namespace FilterNativeWindows {
         }
         finally {
             if (name != NULL) {
-                delete name;
+                delete[] name;
             }
 
             if (service != NULL) {
@@ -122,7 +128,7 @@ namespace FilterNativeWindows {
             }
 
             if (descriptor != NULL) {
-                delete descriptor;
+                delete[] (unsigned char*)descriptor;
             }
         }
     }
@@ -0,0 +1,200 @@
+#include "TimerDispatcher.h"
+#include "ServiceScheduler.h"
+
+#define DISPATCH_BATCH 16
+
+namespace FilterNativeWindows {
+    ServiceScheduler::ServiceScheduler() {
+        dispatcher = new TimerDispatcher();
+        jobs = gcnew List<Func<bool>^>();
+        sync = gcnew Object();
+
+        thread = gcnew Thread(gcnew ThreadStart(this, &ServiceScheduler::dispatch));
+        thread->IsBackground = true;
+        thread->Name = "ServiceScheduler";
+        thread->Start();
+    }
+
+    ServiceScheduler::~ServiceScheduler() {
+        this->!ServiceScheduler();
+    }
+
+    ServiceScheduler::!ServiceScheduler() {
+        Monitor::Enter(sync);
+
+        try {
+            if (dispatcher == NULL) {
+                return;
+            }
+
+            dispatcher->Shutdown();
+            thread->Join();
+
+            delete dispatcher;
+            dispatcher = NULL;
+        }
+        finally {
+            Monitor::Exit(sync);
+        }
+    }
+
+    int ServiceScheduler::AddJob(Func<bool>^ job, int periodMs, int slackMs, double jitter, int maxBackoffMs) {
+        if (job == nullptr) {
+            throw gcnew ArgumentNullException("job");
+        }
+
+        if (periodMs < 0) {
+            throw gcnew ArgumentOutOfRangeException("periodMs");
+        }
+
+        if (slackMs < 0) {
+            throw gcnew ArgumentOutOfRangeException("slackMs");
+        }
+
+        if (jitter < 0 || jitter >= 1) {
+            throw gcnew ArgumentOutOfRangeException("jitter");
+        }
+
+        Monitor::Enter(sync);
+
+        try {
+            if (dispatcher == NULL) {
+                throw gcnew ObjectDisposedException("ServiceScheduler");
+            }
+
+            // Added before the id exists anywhere else, so the dispatcher thread never sees an id
+            // without its job.
+            jobs->Add(job);
+
+            return (int)dispatcher->AddJob((unsigned int)periodMs, (unsigned int)slackMs, jitter,
+                maxBackoffMs > 0 ? (unsigned int)maxBackoffMs : 0);
+        }
+        finally {
+            Monitor::Exit(sync);
+        }
+    }
+
+    void ServiceScheduler::Start(int job, long long delayMs) {
+        Monitor::Enter(sync);
+
+        try {
+            if (dispatcher == NULL) {
+                throw gcnew ObjectDisposedException("ServiceScheduler");
+            }
+
+            if (job < 0 || job >= jobs->Count) {
+                throw gcnew ArgumentOutOfRangeException("job");
+            }
+
+            dispatcher->Start((unsigned int)job, delayMs > 0 ? (unsigned long long)delayMs : 0);
+        }
+        finally {
+            Monitor::Exit(sync);
+        }
+    }
+
+    void ServiceScheduler::Stop(int job) {
+        Monitor::Enter(sync);
+
+        try {
+            if (dispatcher != NULL) {
+                dispatcher->Stop((unsigned int)job);
+            }
+        }
+        finally {
+            Monitor::Exit(sync);
+        }
+    }
+
+    void ServiceScheduler::SetPeriod(int job, int periodMs) {
+        if (periodMs < 0) {
+            throw gcnew ArgumentOutOfRangeException("periodMs");
+        }
+
+        Monitor::Enter(sync);
+
+        try {
+            if (dispatcher != NULL) {
+                dispatcher->SetPeriod((unsigned int)job, (unsigned int)periodMs);
+            }
+        }
+        finally {
+            Monitor::Exit(sync);
+        }
+    }
+
+    ServiceSchedulerCounters ServiceScheduler::GetCounters() {
+        ServiceSchedulerCounters counters = ServiceSchedulerCounters();
+
+        Monitor::Enter(sync);
+
+        try {
+            if (dispatcher != NULL) {
+                JobScheduleStats stats = dispatcher->Stats();
+
+                counters.Wakeups = (long long)stats.wakeups;
+                counters.IdleWakeups = (long long)stats.idleWakeups;
+                counters.Runs = (long long)stats.runs;
+                counters.Failures = (long long)stats.failures;
+                counters.Coalesced = (long long)stats.coalesced;
+                counters.Deferred = (long long)stats.deferred;
+            }
+        }
+        finally {
+            Monitor::Exit(sync);
+        }
+
+        return counters;
+    }
+
+    void ServiceScheduler::dispatch() {
+        // Disposing joins this thread before deleting the dispatcher.
+        TimerDispatcher* waiter = dispatcher;
+        unsigned int due[DISPATCH_BATCH];
+
+        while (true) {
+            size_t count = waiter->WaitForDue(due, DISPATCH_BATCH);
+            if (count == 0) {
+                break;
+            }
+
+            for (size_t i = 0; i < count; i++) {
+                ThreadPool::QueueUserWorkItem(gcnew WaitCallback(this, &ServiceScheduler::run), (int)due[i]);
+            }
+        }
+    }
+
+    void ServiceScheduler::run(Object^ state) {
+        int job = (int)state;
+        bool succeeded = false;
+
+        try {
+            Func<bool>^ callback;
+
+            Monitor::Enter(sync);
+            try {
+                callback = jobs[job];
+            }
+            finally {
+                Monitor::Exit(sync);
+            }
+
+            succeeded = callback();
+        }
+        catch (Exception^) {
+            succeeded = false;
+        }
+        finally {
+            Monitor::Enter(sync);
+
+            try {
+                if (dispatcher != NULL) {
+                    dispatcher->Complete((unsigned int)job, succeeded);
+                }
+            }
+            finally {
+                Monitor::Exit(sync);
+            }
+        }
+    }
+}
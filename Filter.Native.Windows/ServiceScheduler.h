@@ -0,0 +1,81 @@
+#pragma once
+
+class TimerDispatcher;
+
+using namespace System;
+using namespace System::Collections::Generic;
+using namespace System::Threading;
+
+namespace FilterNativeWindows {
+    public value struct ServiceSchedulerCounters {
+        /// <summary>
+        /// Times the dispatcher thread woke up, and how many of those found nothing to run.
+        /// </summary>
+        long long Wakeups;
+        long long IdleWakeups;
+
+        long long Runs;
+        long long Failures;
+
+        /// <summary>
+        /// Runs that shared a wakeup with another job.
+        /// </summary>
+        long long Coalesced;
+
+        /// <summary>
+        /// Runs and starts that came while the job was still running and were held until it finished.
+        /// </summary>
+        long long Deferred;
+    };
+
+    /// <summary>
+    /// Runs the service's periodic jobs from one hierarchical timer wheel and one dispatcher thread, instead of a
+    /// thread pool timer each. Jobs run on the thread pool, never two runs of the same job at once.
+    /// </summary>
+    public ref class ServiceScheduler {
+    public:
+        ServiceScheduler();
+        ~ServiceScheduler();
+        !ServiceScheduler();
+
+        /// <summary>
+        /// Registers a job. It does not run until Start() is called.
+        /// </summary>
+        /// <param name="job">Returns false if the run failed. Exceptions count as failures and are otherwise ignored, so
+        /// jobs should log their own.</param>
+        /// <param name="periodMs">Time from the start of one run to the start of the next, or from the end of a run that
+        /// overran it. Zero for a job that only runs when started.</param>
+        /// <param name="slackMs">How late the job may run so that it can share a wakeup with others.</param>
+        /// <param name="jitter">Fraction of each delay, below 1, that may randomly be taken off it.</param>
+        /// <param name="maxBackoffMs">If above the period, failed runs double the period up to this.</param>
+        /// <returns>The id to start and stop the job with.</returns>
+        int AddJob(Func<bool>^ job, int periodMs, int slackMs, double jitter, int maxBackoffMs);
+
+        /// <summary>
+        /// Runs the job after delayMs and then every period, replacing any earlier start.
+        /// </summary>
+        void Start(int job, long long delayMs);
+
+        void Stop(int job);
+
+        /// <summary>
+        /// Called from a running job, moves its next run to periodMs after this one started.
+        /// </summary>
+        void SetPeriod(int job, int periodMs);
+
+        ServiceSchedulerCounters GetCounters();
+
+    private:
+        void dispatch();
+        void run(Object^ state);
+
+        TimerDispatcher* dispatcher;
+
+        List<Func<bool>^>^ jobs;
+        Thread^ thread;
+
+        // Held while the dispatcher is used from outside the dispatcher thread, so that disposing can't
+        // delete it under a job that is completing.
+        Object^ sync;
+    };
+}
@@ -0,0 +1,78 @@
+#include "ProcessCreation.h"
+#include "SessionBroker.h"
+
+#include <vcclr.h>
+
+using namespace System::Threading;
+
+namespace FilterNativeWindows {
+    // Carries the arguments of a LaunchAsync() to the thread pool.
+    ref class LaunchRequest {
+    public:
+        LaunchRequest(String^ filename, String^ commandLine) {
+            this->filename = filename;
+            this->commandLine = commandLine;
+        }
+
+        int Run() {
+            return SessionBroker::Default->Launch(filename, commandLine);
+        }
+
+    private:
+        String^ filename;
+        String^ commandLine;
+    };
+
+    SessionBroker::SessionBroker() {
+    }
+
+    SessionBroker^ SessionBroker::Default::get() {
+        return defaultBroker;
+    }
+
+    void SessionBroker::OnSessionChange(int reason, int sessionId) {
+        GetSessionTable()->OnEvent((unsigned int)reason, (unsigned int)sessionId);
+
+        // Get the token ready while nobody is waiting on it, rather than on the first launch.
+        if (reason == SESSION_EVENT_CONSOLE_CONNECT || reason == SESSION_EVENT_REMOTE_CONNECT || reason == SESSION_EVENT_LOGON) {
+            ThreadPool::QueueUserWorkItem(gcnew WaitCallback(this, &SessionBroker::prepare));
+        }
+    }
+
+    int SessionBroker::ActiveSessionId::get() {
+        unsigned int id = GetSessionTable()->ActiveSession();
+        return id == SESSION_NONE ? -1 : (int)id;
+    }
+
+    int SessionBroker::Launch(String^ filename, String^ commandLine) {
+        if (filename == nullptr) {
+            throw gcnew ArgumentNullException("filename");
+        }
+
+        if (commandLine == nullptr) {
+            throw gcnew ArgumentNullException("commandLine");
+        }
+
+        pin_ptr<const wchar_t> c_filename = PtrToStringChars(filename);
+        pin_ptr<const wchar_t> c_commandLine = PtrToStringChars(commandLine);
+
+        return (int)GetSessionTable()->Launch(c_filename, c_commandLine);
+    }
+
+    Task<int>^ SessionBroker::LaunchAsync(String^ filename, String^ commandLine) {
+        if (filename == nullptr) {
+            throw gcnew ArgumentNullException("filename");
+        }
+
+        if (commandLine == nullptr) {
+            throw gcnew ArgumentNullException("commandLine");
+        }
+
+        LaunchRequest^ request = gcnew LaunchRequest(filename, commandLine);
+        return Task::Run(gcnew Func<int>(request, &LaunchRequest::Run));
+    }
+
+    void SessionBroker::prepare(Object^ state) {
+        GetSessionTable()->Prepare();
+    }
+}
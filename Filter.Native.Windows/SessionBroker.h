@@ -0,0 +1,49 @@
+#pragma once
+
+using namespace System;
+using namespace System::Threading::Tasks;
+
+namespace FilterNativeWindows {
+    /// <summary>
+    /// Launches elevated processes into the user's session. It follows the service's session change notifications to
+    /// know which session is active, and keeps that session's winlogon token open from logon on, so that a launch
+    /// doesn't have to enumerate sessions and processes first.
+    /// </summary>
+    public ref class SessionBroker {
+    public:
+        static property SessionBroker^ Default {
+            SessionBroker^ get();
+        }
+
+        /// <summary>
+        /// Passes on a session change notification.
+        /// </summary>
+        /// <param name="reason">The WTS_* reason code, as in SessionChangeReason.</param>
+        void OnSessionChange(int reason, int sessionId);
+
+        /// <summary>
+        /// The active session, or -1 if there is none.
+        /// </summary>
+        property int ActiveSessionId {
+            int get();
+        }
+
+        /// <summary>
+        /// Starts a process elevated in the active session.
+        /// </summary>
+        /// <returns>Zero, or the Win32 error code it failed with.</returns>
+        int Launch(String^ filename, String^ commandLine);
+
+        /// <summary>
+        /// Like Launch(), on the thread pool.
+        /// </summary>
+        Task<int>^ LaunchAsync(String^ filename, String^ commandLine);
+
+    private:
+        SessionBroker();
+
+        void prepare(Object^ state);
+
+        static SessionBroker^ defaultBroker = gcnew SessionBroker();
+    };
+}
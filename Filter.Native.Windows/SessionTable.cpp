@@ -0,0 +1,291 @@
+#include "SessionTable.h"
+
+#include <map>
+#include <mutex>
+
+namespace {
+    typedef struct Session {
+        bool console;
+        bool remote;
+        bool loggedOn;
+        bool locked;
+
+        // Order of the last connect, so the newest remote session wins when nobody is on the console.
+        unsigned long long connectedAt;
+
+        void* token;
+    } Session;
+}
+
+struct SessionTable::Impl {
+    SessionBackend* backend;
+
+    mutable std::mutex lock;
+    std::map<unsigned int, Session> sessions;
+
+    // Only meaningful while activeKnown. Cleared when events leave no session to pick, so that the
+    // next launch asks the backend.
+    unsigned int active;
+    bool activeKnown;
+
+    // Set once the backend has listed the sessions. From then on events keep the table current.
+    bool seeded;
+
+    unsigned long long sequence;
+    SessionTableStats stats;
+
+    Session& find(unsigned int id) {
+        std::map<unsigned int, Session>::iterator found = sessions.find(id);
+
+        if (found == sessions.end()) {
+            Session session = Session();
+            found = sessions.insert(std::make_pair(id, session)).first;
+        }
+
+        return found->second;
+    }
+
+    void dropToken(Session& session) {
+        if (session.token != NULL) {
+            backend->CloseToken(session.token);
+            session.token = NULL;
+            stats.tokensDropped++;
+        }
+    }
+
+    void pickActive() {
+        unsigned int console = SESSION_NONE;
+        unsigned int remote = SESSION_NONE;
+        unsigned long long remoteAt = 0;
+
+        for (std::map<unsigned int, Session>::const_iterator i = sessions.begin(); i != sessions.end(); ++i) {
+            if (i->second.console) {
+                console = i->first;
+            }
+            else if (i->second.remote && (remote == SESSION_NONE || i->second.connectedAt > remoteAt)) {
+                remote = i->first;
+                remoteAt = i->second.connectedAt;
+            }
+        }
+
+        active = console != SESSION_NONE ? console : remote;
+        activeKnown = active != SESSION_NONE;
+    }
+
+    unsigned int ensureActive() {
+        if (activeKnown) {
+            return active;
+        }
+
+        std::vector<SessionInfo> listed;
+        stats.enumerations++;
+
+        if (!backend->EnumerateSessions(listed)) {
+            return SESSION_NONE;
+        }
+
+        seeded = true;
+
+        for (size_t i = 0; i < listed.size(); i++) {
+            Session& session = find(listed[i].id);
+            session.loggedOn = listed[i].loggedOn;
+
+            if (listed[i].console) {
+                for (std::map<unsigned int, Session>::iterator k = sessions.begin(); k != sessions.end(); ++k) {
+                    k->second.console = false;
+                }
+
+                session.console = true;
+                session.connectedAt = ++sequence;
+            }
+            else if (listed[i].active) {
+                // Any other active session is connected remotely. Which of several connected last
+                // isn't listed, so they are taken in the order they come.
+                session.remote = true;
+                session.connectedAt = ++sequence;
+            }
+        }
+
+        pickActive();
+        return active;
+    }
+
+    unsigned int prepare(unsigned int id, Session& session) {
+        if (session.token != NULL) {
+            return 0;
+        }
+
+        unsigned int pid = backend->FindWinlogon(id);
+        if (pid == 0) {
+            return SESSION_ERROR_NO_WINLOGON;
+        }
+
+        unsigned int error = 0;
+
+        session.token = backend->OpenToken(pid, &error);
+        if (session.token == NULL) {
+            return error != 0 ? error : SESSION_ERROR_NO_WINLOGON;
+        }
+
+        stats.tokensOpened++;
+        return 0;
+    }
+};
+
+SessionTable::SessionTable(SessionBackend* backend) {
+    impl = new Impl();
+    impl->backend = backend;
+    impl->active = SESSION_NONE;
+    impl->activeKnown = false;
+    impl->seeded = false;
+    impl->sequence = 0;
+    impl->stats = SessionTableStats();
+}
+
+SessionTable::~SessionTable() {
+    for (std::map<unsigned int, Session>::iterator i = impl->sessions.begin(); i != impl->sessions.end(); ++i) {
+        if (i->second.token != NULL) {
+            impl->backend->CloseToken(i->second.token);
+        }
+    }
+
+    delete impl;
+}
+
+void SessionTable::OnEvent(unsigned int event, unsigned int sessionId) {
+    std::lock_guard<std::mutex> guard(impl->lock);
+
+    impl->stats.events++;
+
+    if (event == SESSION_EVENT_TERMINATE) {
+        std::map<unsigned int, Session>::iterator found = impl->sessions.find(sessionId);
+
+        if (found != impl->sessions.end()) {
+            impl->dropToken(found->second);
+            impl->sessions.erase(found);
+        }
+    }
+    else {
+        Session& session = impl->find(sessionId);
+
+        switch (event) {
+        case SESSION_EVENT_CONSOLE_CONNECT:
+            // Only one session has the console at a time.
+            for (std::map<unsigned int, Session>::iterator i = impl->sessions.begin(); i != impl->sessions.end(); ++i) {
+                i->second.console = false;
+            }
+
+            session.console = true;
+            session.connectedAt = ++impl->sequence;
+            break;
+
+        case SESSION_EVENT_CONSOLE_DISCONNECT:
+            session.console = false;
+            break;
+
+        case SESSION_EVENT_REMOTE_CONNECT:
+            session.remote = true;
+            session.connectedAt = ++impl->sequence;
+            break;
+
+        case SESSION_EVENT_REMOTE_DISCONNECT:
+            session.remote = false;
+            break;
+
+        case SESSION_EVENT_LOGON:
+            session.loggedOn = true;
+            break;
+
+        case SESSION_EVENT_LOGOFF:
+            // The next logon may come with a new winlogon.
+            session.loggedOn = false;
+            impl->dropToken(session);
+            break;
+
+        case SESSION_EVENT_LOCK:
+            session.locked = true;
+            break;
+
+        case SESSION_EVENT_UNLOCK:
+            session.locked = false;
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    // Until something has seeded the table, events only fill in what they touch; which session is
+    // active still comes from the backend.
+    if (impl->seeded || event == SESSION_EVENT_CONSOLE_CONNECT) {
+        impl->pickActive();
+    }
+}
+
+unsigned int SessionTable::ActiveSession() {
+    std::lock_guard<std::mutex> guard(impl->lock);
+    return impl->ensureActive();
+}
+
+unsigned int SessionTable::Prepare() {
+    std::lock_guard<std::mutex> guard(impl->lock);
+
+    unsigned int id = impl->ensureActive();
+    if (id == SESSION_NONE) {
+        return SESSION_ERROR_NO_SESSION;
+    }
+
+    return impl->prepare(id, impl->find(id));
+}
+
+unsigned int SessionTable::Launch(const wchar_t* filename, const wchar_t* commandLine) {
+    std::lock_guard<std::mutex> guard(impl->lock);
+
+    impl->stats.launches++;
+
+    unsigned int id = impl->ensureActive();
+    if (id == SESSION_NONE) {
+        impl->stats.failedLaunches++;
+        return SESSION_ERROR_NO_SESSION;
+    }
+
+    Session& session = impl->find(id);
+    bool prepared = session.token != NULL;
+
+    unsigned int error = impl->prepare(id, session);
+
+    if (error == 0) {
+        if (prepared) {
+            impl->stats.preparedLaunches++;
+        }
+
+        error = impl->backend->Launch(session.token, filename, commandLine);
+
+        if (error != 0 && prepared) {
+            impl->dropToken(session);
+
+            error = impl->prepare(id, session);
+            if (error == 0) {
+                error = impl->backend->Launch(session.token, filename, commandLine);
+            }
+        }
+    }
+
+    if (error != 0) {
+        impl->stats.failedLaunches++;
+    }
+
+    return error;
+}
+
+bool SessionTable::IsLocked(unsigned int sessionId) const {
+    std::lock_guard<std::mutex> guard(impl->lock);
+
+    std::map<unsigned int, Session>::const_iterator found = impl->sessions.find(sessionId);
+    return found != impl->sessions.end() && found->second.locked;
+}
+
+SessionTableStats SessionTable::Stats() const {
+    std::lock_guard<std::mutex> guard(impl->lock);
+    return impl->stats;
+}
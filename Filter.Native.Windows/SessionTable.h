@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Session change events, numbered as WTS_CONSOLE_CONNECT through WTS_SESSION_TERMINATE.
+#define SESSION_EVENT_CONSOLE_CONNECT 1
+#define SESSION_EVENT_CONSOLE_DISCONNECT 2
+#define SESSION_EVENT_REMOTE_CONNECT 3
+#define SESSION_EVENT_REMOTE_DISCONNECT 4
+#define SESSION_EVENT_LOGON 5
+#define SESSION_EVENT_LOGOFF 6
+#define SESSION_EVENT_LOCK 7
+#define SESSION_EVENT_UNLOCK 8
+#define SESSION_EVENT_REMOTE_CONTROL 9
+#define SESSION_EVENT_CREATE 10
+#define SESSION_EVENT_TERMINATE 11
+
+#define SESSION_NONE 0xFFFFFFFFu
+
+// Launch results besides what the backend returns, with the values of ERROR_NO_SUCH_LOGON_SESSION
+// and ERROR_NOT_FOUND so that every result reads as a Win32 error code.
+#define SESSION_ERROR_NO_SESSION 1312
+#define SESSION_ERROR_NO_WINLOGON 1168
+
+typedef struct SessionInfo {
+    unsigned int id;
+
+    // A user is connected and working in the session, at the console or remotely.
+    bool active;
+
+    // The session attached to the physical console, as WTSGetActiveConsoleSessionId() reports it.
+    // Only set for one that is also active.
+    bool console;
+
+    bool loggedOn;
+} SessionInfo;
+
+/// What SessionTable needs from the OS. The Windows one is WindowsSessionBackend in
+/// ProcessCreation.h; anything else can stand in for it to test the table.
+class SessionBackend {
+public:
+    virtual ~SessionBackend() {}
+
+    /// Lists the sessions that exist now. Only called when events haven't said which one is active.
+    virtual bool EnumerateSessions(std::vector<SessionInfo>& sessions) = 0;
+
+    /// Returns the PID of the session's winlogon, or zero.
+    virtual unsigned int FindWinlogon(unsigned int sessionId) = 0;
+
+    /// Returns a primary token duplicated from the process, or NULL with error set.
+    virtual void* OpenToken(unsigned int pid, unsigned int* error) = 0;
+    virtual void CloseToken(void* token) = 0;
+
+    /// Starts a process with the token on the session's interactive desktop. Returns zero or a Win32
+    /// error code.
+    virtual unsigned int Launch(void* token, const wchar_t* filename, const wchar_t* commandLine) = 0;
+};
+
+typedef struct SessionTableStats {
+    unsigned long long events;
+    unsigned long long enumerations;
+
+    unsigned long long launches;
+    unsigned long long failedLaunches;
+
+    // Launches that found the active session's token already open.
+    unsigned long long preparedLaunches;
+
+    // Times winlogon's token was opened, and times a cached one was dropped.
+    unsigned long long tokensOpened;
+    unsigned long long tokensDropped;
+} SessionTableStats;
+
+/// Follows session change events to know which session is active without enumerating sessions on
+/// every launch, and keeps the primary token of each session's winlogon open so that a launch into
+/// that session is a single CreateProcessAsUser().
+///
+/// A token is dropped when its session logs off or ends. If a launch with a cached token fails, the
+/// token is opened again and the launch retried once, in case winlogon was restarted.
+///
+/// Safe to use from any number of threads. The threading types live in the .cpp so that this header
+/// can be included from /clr code.
+class SessionTable {
+public:
+    /// backend is not owned.
+    explicit SessionTable(SessionBackend* backend);
+    ~SessionTable();
+
+    void OnEvent(unsigned int event, unsigned int sessionId);
+
+    /// Returns the active session, or SESSION_NONE if there is none.
+    unsigned int ActiveSession();
+
+    /// Opens the active session's winlogon token ahead of a launch, if it isn't already. Returns zero
+    /// or a Win32 error code.
+    unsigned int Prepare();
+
+    /// Starts a process elevated in the active session. Returns zero or a Win32 error code.
+    unsigned int Launch(const wchar_t* filename, const wchar_t* commandLine);
+
+    bool IsLocked(unsigned int sessionId) const;
+
+    SessionTableStats Stats() const;
+
+private:
+    SessionTable(const SessionTable&);
+    SessionTable& operator=(const SessionTable&);
+
+    struct Impl;
+    Impl* impl;
+};
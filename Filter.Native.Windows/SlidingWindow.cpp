@@ -0,0 +1,83 @@
+#include "SlidingWindow.h"
+
+#include <mutex>
+
+namespace {
+    typedef struct Bucket {
+        // now / bucketMs of the time the bucket was last written. A bucket whose epoch has fallen
+        // out of the window counts as empty, so nothing ever has to clear it.
+        unsigned long long epoch;
+        long long count;
+    } Bucket;
+}
+
+struct SlidingWindow::Impl {
+    mutable std::mutex lock;
+
+    unsigned long long windowMs;
+    unsigned long long bucketMs;
+
+    Bucket buckets[SLIDING_WINDOW_BUCKETS];
+};
+
+static long long totalAt(const Bucket* buckets, unsigned long long epoch) {
+    long long total = 0;
+
+    for (int i = 0; i < SLIDING_WINDOW_BUCKETS; i++) {
+        if (buckets[i].count != 0 && buckets[i].epoch + SLIDING_WINDOW_BUCKETS > epoch) {
+            total += buckets[i].count;
+        }
+    }
+
+    return total;
+}
+
+SlidingWindow::SlidingWindow(unsigned long long windowMs) {
+    impl = new Impl();
+    impl->windowMs = windowMs;
+    impl->bucketMs = windowMs / SLIDING_WINDOW_BUCKETS;
+
+    if (impl->bucketMs == 0) {
+        impl->bucketMs = 1;
+    }
+
+    Reset();
+}
+
+SlidingWindow::~SlidingWindow() {
+    delete impl;
+}
+
+long long SlidingWindow::Add(unsigned long long now, long long amount) {
+    std::lock_guard<std::mutex> guard(impl->lock);
+
+    unsigned long long epoch = now / impl->bucketMs;
+    Bucket& bucket = impl->buckets[epoch % SLIDING_WINDOW_BUCKETS];
+
+    if (bucket.epoch != epoch) {
+        bucket.epoch = epoch;
+        bucket.count = 0;
+    }
+
+    bucket.count += amount;
+
+    return totalAt(impl->buckets, epoch);
+}
+
+long long SlidingWindow::Total(unsigned long long now) const {
+    std::lock_guard<std::mutex> guard(impl->lock);
+    return totalAt(impl->buckets, now / impl->bucketMs);
+}
+
+void SlidingWindow::Reset() {
+    std::lock_guard<std::mutex> guard(impl->lock);
+
+    for (int i = 0; i < SLIDING_WINDOW_BUCKETS; i++) {
+        impl->buckets[i].epoch = 0;
+        impl->buckets[i].count = 0;
+    }
+}
+
+unsigned long long SlidingWindow::WindowMs() const {
+    return impl->windowMs;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+// Buckets a window is divided into. Counts leave the window one bucket at a time, so a count is
+// forgotten somewhere between (1 - 1/SLIDING_WINDOW_BUCKETS) windows and one window after it was added.
+#define SLIDING_WINDOW_BUCKETS 16
+
+/// Running total of what was added over the last window of time. Replaces counters that were
+/// reset by a timer every period: nothing has to run for old counts to drop out, and a burst is not
+/// cut in half by a reset landing in the middle of it.
+///
+/// Times are in milliseconds on whatever clock the caller uses, as long as it never goes back.
+/// Safe to use from any number of threads. The threading types live in the .cpp so that this
+/// header can be included from /clr code.
+class SlidingWindow {
+public:
+    explicit SlidingWindow(unsigned long long windowMs);
+    ~SlidingWindow();
+
+    /// Adds amount at time now and returns the total over the window ending then.
+    long long Add(unsigned long long now, long long amount);
+
+    long long Total(unsigned long long now) const;
+
+    void Reset();
+
+    unsigned long long WindowMs() const;
+
+private:
+    SlidingWindow(const SlidingWindow&);
+    SlidingWindow& operator=(const SlidingWindow&);
+
+    struct Impl;
+    Impl* impl;
+};
@@ -0,0 +1,44 @@
+#include "SlidingWindow.h"
+#include "SlidingWindowCounter.h"
+#include "TimerDispatcher.h"
+
+namespace FilterNativeWindows {
+    SlidingWindowCounter::SlidingWindowCounter(TimeSpan window) {
+        if (window <= TimeSpan::Zero) {
+            throw gcnew ArgumentOutOfRangeException("window");
+        }
+
+        this->window = new SlidingWindow((unsigned long long)window.TotalMilliseconds);
+    }
+
+    SlidingWindowCounter::~SlidingWindowCounter() {
+        this->!SlidingWindowCounter();
+    }
+
+    SlidingWindowCounter::!SlidingWindowCounter() {
+        delete window;
+        window = NULL;
+    }
+
+    long long SlidingWindowCounter::Add(long long amount) {
+        if (window == NULL) {
+            throw gcnew ObjectDisposedException("SlidingWindowCounter");
+        }
+
+        return window->Add(TimerDispatcher::Milliseconds(), amount);
+    }
+
+    long long SlidingWindowCounter::Total::get() {
+        if (window == NULL) {
+            throw gcnew ObjectDisposedException("SlidingWindowCounter");
+        }
+
+        return window->Total(TimerDispatcher::Milliseconds());
+    }
+
+    void SlidingWindowCounter::Reset() {
+        if (window != NULL) {
+            window->Reset();
+        }
+    }
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+class SlidingWindow;
+
+using namespace System;
+
+namespace FilterNativeWindows {
+    /// <summary>
+    /// Total of the amounts added over the last window of time. Older amounts drop out on their own, a sixteenth of the
+    /// window at a time, so nothing has to reset the counter. Safe to use from any thread.
+    /// </summary>
+    public ref class SlidingWindowCounter {
+    public:
+        SlidingWindowCounter(TimeSpan window);
+        ~SlidingWindowCounter();
+        !SlidingWindowCounter();
+
+        /// <returns>The total including amount.</returns>
+        long long Add(long long amount);
+
+        property long long Total {
+            long long get();
+        }
+
+        void Reset();
+
+    private:
+        SlidingWindow* window;
+    };
+}
@@ -0,0 +1,193 @@
+#include <vector>
+
+#include "StartupGraph.h"
+
+namespace FilterNativeWindows {
+    StartupGraph::StartupGraph() {
+        plan = new StartupPlan();
+
+        names = gcnew List<String^>();
+        phases = gcnew List<Func<bool>^>();
+        ids = gcnew Dictionary<String^, int>(StringComparer::OrdinalIgnoreCase);
+
+        started = false;
+        sync = gcnew Object();
+    }
+
+    StartupGraph::~StartupGraph() {
+        this->!StartupGraph();
+    }
+
+    StartupGraph::!StartupGraph() {
+        Monitor::Enter(sync);
+
+        try {
+            // Run() holds the lock except while it waits, and only returns once every phase has completed, so
+            // the graph mustn't be disposed from another thread while it runs.
+            delete plan;
+            plan = NULL;
+        }
+        finally {
+            Monitor::Exit(sync);
+        }
+    }
+
+    void StartupGraph::AddPhase(String^ name, Func<bool>^ run, array<String^>^ dependsOn) {
+        if (String::IsNullOrEmpty(name)) {
+            throw gcnew ArgumentNullException("name");
+        }
+
+        if (run == nullptr) {
+            throw gcnew ArgumentNullException("run");
+        }
+
+        Monitor::Enter(sync);
+
+        try {
+            if (plan == NULL) {
+                throw gcnew ObjectDisposedException("StartupGraph");
+            }
+
+            if (started) {
+                throw gcnew InvalidOperationException("Phases can't be added once the graph has run.");
+            }
+
+            if (ids->ContainsKey(name)) {
+                throw gcnew ArgumentException("There is already a phase named " + name + ".", "name");
+            }
+
+            int count = dependsOn != nullptr ? dependsOn->Length : 0;
+            std::vector<int> dependencies(count > 0 ? count : 1);
+
+            for (int i = 0; i < count; i++) {
+                int dependency;
+
+                if (dependsOn[i] == nullptr || !ids->TryGetValue(dependsOn[i], dependency)) {
+                    throw gcnew ArgumentException(name + " depends on " + dependsOn[i] + ", which hasn't been added.", "dependsOn");
+                }
+
+                dependencies[i] = dependency;
+            }
+
+            int id = plan->AddPhase(&dependencies[0], (size_t)count);
+
+            names->Add(name);
+            phases->Add(run);
+            ids->Add(name, id);
+        }
+        finally {
+            Monitor::Exit(sync);
+        }
+    }
+
+    array<StartupPhaseResult^>^ StartupGraph::Run() {
+        Monitor::Enter(sync);
+
+        try {
+            if (plan == NULL) {
+                throw gcnew ObjectDisposedException("StartupGraph");
+            }
+
+            if (started) {
+                throw gcnew InvalidOperationException("The graph has already run.");
+            }
+
+            started = true;
+
+            plan->Begin(StartupPlan::MonotonicMicroseconds());
+            dispatchReady();
+
+            while (!plan->Finished()) {
+                Monitor::Wait(sync);
+            }
+
+            array<StartupPhaseResult^>^ results = gcnew array<StartupPhaseResult^>(names->Count);
+
+            for (int i = 0; i < names->Count; i++) {
+                const StartupPhaseTiming& timing = plan->Timing(i);
+                const std::vector<int>& dependencies = plan->Dependencies(i);
+
+                StartupPhaseResult^ result = gcnew StartupPhaseResult();
+                result->Name = names[i];
+                result->DependsOn = gcnew array<String^>((int)dependencies.size());
+                result->State = (StartupPhaseState)timing.state;
+                result->StartMs = timing.startUs / 1000.0;
+                result->EndMs = timing.endUs / 1000.0;
+                result->CpuMs = timing.cpuUs / 1000.0;
+                result->WaitedOn = timing.waitedOn >= 0 ? names[timing.waitedOn] : nullptr;
+                result->Critical = timing.critical;
+
+                for (size_t j = 0; j < dependencies.size(); j++) {
+                    result->DependsOn[(int)j] = names[dependencies[j]];
+                }
+
+                results[i] = result;
+            }
+
+            return results;
+        }
+        finally {
+            Monitor::Exit(sync);
+        }
+    }
+
+    double StartupGraph::TotalMs::get() {
+        Monitor::Enter(sync);
+
+        try {
+            return plan != NULL && plan->Finished() ? plan->TotalUs() / 1000.0 : 0;
+        }
+        finally {
+            Monitor::Exit(sync);
+        }
+    }
+
+    void StartupGraph::dispatchReady() {
+        std::vector<int> ready;
+        plan->TakeReady(ready);
+
+        for (size_t i = 0; i < ready.size(); i++) {
+            ThreadPool::QueueUserWorkItem(gcnew WaitCallback(this, &StartupGraph::runPhase), ready[i]);
+        }
+    }
+
+    void StartupGraph::runPhase(Object^ state) {
+        int phase = (int)state;
+        Func<bool>^ run;
+
+        Monitor::Enter(sync);
+
+        try {
+            run = phases[phase];
+        }
+        finally {
+            Monitor::Exit(sync);
+        }
+
+        unsigned long long startUs = StartupPlan::MonotonicMicroseconds();
+        unsigned long long startCpu = StartupPlan::ThreadCpuMicroseconds();
+        bool succeeded = false;
+
+        try {
+            succeeded = run();
+        }
+        catch (Exception^) {
+            succeeded = false;
+        }
+
+        unsigned long long endCpu = StartupPlan::ThreadCpuMicroseconds();
+        unsigned long long endUs = StartupPlan::MonotonicMicroseconds();
+
+        Monitor::Enter(sync);
+
+        try {
+            plan->Complete(phase, succeeded, startUs, endUs, endCpu > startCpu ? endCpu - startCpu : 0);
+            dispatchReady();
+
+            Monitor::PulseAll(sync);
+        }
+        finally {
+            Monitor::Exit(sync);
+        }
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "StartupPlan.h"
+
+using namespace System;
+using namespace System::Collections::Generic;
+using namespace System::Threading;
+
+namespace FilterNativeWindows {
+    public enum class StartupPhaseState {
+        Pending = STARTUP_PHASE_PENDING,
+        Running = STARTUP_PHASE_RUNNING,
+        Succeeded = STARTUP_PHASE_SUCCEEDED,
+        Failed = STARTUP_PHASE_FAILED
+    };
+
+    public ref class StartupPhaseResult {
+    public:
+        property String^ Name;
+        property array<String^>^ DependsOn;
+        property StartupPhaseState State;
+
+        /// <summary>
+        /// Milliseconds from the start of the run.
+        /// </summary>
+        property double StartMs;
+        property double EndMs;
+
+        property double CpuMs;
+
+        /// <summary>
+        /// The dependency that finished last, or null if the phase had none.
+        /// </summary>
+        property String^ WaitedOn;
+
+        /// <summary>
+        /// Whether the phase is on the chain of waits that ends with the last phase to finish.
+        /// </summary>
+        property bool Critical;
+    };
+
+    /// <summary>
+    /// Runs startup phases on the thread pool, each as soon as every phase it depends on has finished, and records when
+    /// each one ran and how much CPU it took.
+    /// </summary>
+    public ref class StartupGraph {
+    public:
+        StartupGraph();
+        ~StartupGraph();
+        !StartupGraph();
+
+        /// <summary>
+        /// Adds a phase. Dependencies are named, and must have been added already.
+        /// </summary>
+        /// <param name="run">Returns false if the phase failed. Exceptions count as failures and are otherwise ignored, so
+        /// phases should log their own. Phases that depend on it run all the same.</param>
+        void AddPhase(String^ name, Func<bool>^ run, array<String^>^ dependsOn);
+
+        /// <summary>
+        /// Runs every phase and returns once all of them have finished, in the order they were added. A graph only runs
+        /// once.
+        /// </summary>
+        array<StartupPhaseResult^>^ Run();
+
+        /// <summary>
+        /// Milliseconds from the start of the run to the end of the last phase.
+        /// </summary>
+        property double TotalMs {
+            double get();
+        }
+
+    private:
+        // Queues every phase that has become ready. Called with sync held.
+        void dispatchReady();
+
+        void runPhase(Object^ state);
+
+        StartupPlan* plan;
+
+        List<String^>^ names;
+        List<Func<bool>^>^ phases;
+        Dictionary<String^, int>^ ids;
+
+        bool started;
+
+        Object^ sync;
+    };
+}
@@ -0,0 +1,154 @@
+#include "StartupPlan.h"
+
+#include <chrono>
+#include <cstring>
+
+#if defined(_MSC_VER)
+#include <Windows.h>
+#else
+#include <time.h>
+#endif
+
+StartupPlan::StartupPlan() : begun(false), finished(0), beginUs(0), totalUs(0) {
+}
+
+int StartupPlan::AddPhase(const int* dependsOn, size_t count) {
+    if (begun) {
+        return STARTUP_PHASE_INVALID;
+    }
+
+    int id = (int)phases.size();
+
+    for (size_t i = 0; i < count; i++) {
+        if (dependsOn[i] < 0 || dependsOn[i] >= id) {
+            return STARTUP_PHASE_INVALID;
+        }
+    }
+
+    Phase phase;
+    memset(&phase.timing, 0, sizeof(phase.timing));
+    phase.timing.state = STARTUP_PHASE_PENDING;
+    phase.timing.waitedOn = -1;
+
+    for (size_t i = 0; i < count; i++) {
+        bool duplicate = false;
+
+        for (size_t j = 0; j < phase.dependsOn.size(); j++) {
+            duplicate = duplicate || phase.dependsOn[j] == dependsOn[i];
+        }
+
+        if (!duplicate) {
+            phase.dependsOn.push_back(dependsOn[i]);
+        }
+    }
+
+    phase.waitingFor = phase.dependsOn.size();
+    phases.push_back(phase);
+
+    for (size_t i = 0; i < phases[id].dependsOn.size(); i++) {
+        phases[phases[id].dependsOn[i]].dependents.push_back(id);
+    }
+
+    return id;
+}
+
+void StartupPlan::Begin(unsigned long long nowUs) {
+    if (begun) {
+        return;
+    }
+
+    begun = true;
+    beginUs = nowUs;
+
+    for (size_t i = 0; i < phases.size(); i++) {
+        if (phases[i].waitingFor == 0) {
+            ready.push_back((int)i);
+        }
+    }
+}
+
+void StartupPlan::TakeReady(std::vector<int>& taken) {
+    for (size_t i = 0; i < ready.size(); i++) {
+        phases[ready[i]].timing.state = STARTUP_PHASE_RUNNING;
+        taken.push_back(ready[i]);
+    }
+
+    ready.clear();
+}
+
+void StartupPlan::Complete(int phase, bool succeeded, unsigned long long startUs, unsigned long long endUs, unsigned long long cpuUs) {
+    if (phase < 0 || (size_t)phase >= phases.size() || phases[phase].timing.state != STARTUP_PHASE_RUNNING) {
+        return;
+    }
+
+    Phase& done = phases[phase];
+
+    done.timing.state = succeeded ? STARTUP_PHASE_SUCCEEDED : STARTUP_PHASE_FAILED;
+    done.timing.startUs = startUs > beginUs ? startUs - beginUs : 0;
+    done.timing.endUs = endUs > startUs ? done.timing.startUs + (endUs - startUs) : done.timing.startUs;
+    done.timing.cpuUs = cpuUs;
+
+    for (size_t i = 0; i < done.dependents.size(); i++) {
+        Phase& dependent = phases[done.dependents[i]];
+
+        // Dependencies complete in the order they finish, so the last one to get here is the one
+        // the dependent was waiting on.
+        dependent.timing.waitedOn = phase;
+
+        if (--dependent.waitingFor == 0) {
+            ready.push_back(done.dependents[i]);
+        }
+    }
+
+    if (done.timing.endUs > totalUs) {
+        totalUs = done.timing.endUs;
+    }
+
+    if (++finished == phases.size()) {
+        markCriticalPath();
+    }
+}
+
+void StartupPlan::markCriticalPath() {
+    int last = -1;
+
+    for (size_t i = 0; i < phases.size(); i++) {
+        if (last < 0 || phases[i].timing.endUs > phases[last].timing.endUs) {
+            last = (int)i;
+        }
+    }
+
+    while (last >= 0) {
+        phases[last].timing.critical = true;
+        last = phases[last].timing.waitedOn;
+    }
+}
+
+unsigned long long StartupPlan::MonotonicMicroseconds() {
+    return (unsigned long long)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+unsigned long long StartupPlan::ThreadCpuMicroseconds() {
+#if defined(_MSC_VER)
+    FILETIME creation, exit, kernel, user;
+
+    if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user)) {
+        return 0;
+    }
+
+    // In 100 nanosecond units.
+    unsigned long long kernelTime = ((unsigned long long)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime;
+    unsigned long long userTime = ((unsigned long long)user.dwHighDateTime << 32) | user.dwLowDateTime;
+
+    return (kernelTime + userTime) / 10;
+#else
+    struct timespec now;
+
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now) != 0) {
+        return 0;
+    }
+
+    return (unsigned long long)now.tv_sec * 1000000 + (unsigned long long)now.tv_nsec / 1000;
+#endif
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#define STARTUP_PHASE_PENDING 0
+#define STARTUP_PHASE_RUNNING 1
+#define STARTUP_PHASE_SUCCEEDED 2
+#define STARTUP_PHASE_FAILED 3
+
+// Returned by StartupPlan::AddPhase() for a dependency that hasn't been added.
+#define STARTUP_PHASE_INVALID -1
+
+typedef struct StartupPhaseTiming {
+    int state;
+
+    // Microseconds from StartupPlan::Begin() to when the phase started and ended. Time spent
+    // waiting for a thread after it became ready counts for neither.
+    unsigned long long startUs;
+    unsigned long long endUs;
+
+    // CPU time of the thread the phase ran on, while it ran.
+    unsigned long long cpuUs;
+
+    // Dependency that finished last, so the one the phase waited on. -1 if it had none.
+    int waitedOn;
+
+    bool critical;
+} StartupPhaseTiming;
+
+/// Which startup phases can run, given the ones that have finished. Each phase names the phases it
+/// depends on, and those must have been added first, so the plan can't have a cycle and the order
+/// they were added in is always one they can run in.
+///
+/// A phase becomes ready once all its dependencies have finished, whether they succeeded or not.
+/// Startup goes on past a step that fails, so it is up to the phase to cope without what a failed
+/// dependency would have given it.
+///
+/// Times are passed in so that a plan can be replayed against mocked phases. Not thread safe;
+/// StartupGraph adds the locking and runs the phases.
+class StartupPlan {
+public:
+    StartupPlan();
+
+    /// Returns the phase's id, or STARTUP_PHASE_INVALID if a dependency isn't one. Phases can't be
+    /// added once Begin() has been called.
+    int AddPhase(const int* dependsOn, size_t count);
+
+    void Begin(unsigned long long nowUs);
+
+    /// Appends every phase that has become ready since the last call, and marks them running.
+    void TakeReady(std::vector<int>& ready);
+
+    /// Times are on the same clock as the one passed to Begin().
+    void Complete(int phase, bool succeeded, unsigned long long startUs, unsigned long long endUs, unsigned long long cpuUs);
+
+    bool Finished() const { return finished == phases.size(); }
+
+    size_t PhaseCount() const { return phases.size(); }
+
+    const std::vector<int>& Dependencies(int phase) const { return phases[phase].dependsOn; }
+
+    const StartupPhaseTiming& Timing(int phase) const { return phases[phase].timing; }
+
+    /// Microseconds from Begin() to the end of the last phase, once Finished().
+    unsigned long long TotalUs() const { return totalUs; }
+
+    static unsigned long long MonotonicMicroseconds();
+
+    /// CPU time the calling thread has used, in user and kernel mode.
+    static unsigned long long ThreadCpuMicroseconds();
+
+private:
+    StartupPlan(const StartupPlan&);
+    StartupPlan& operator=(const StartupPlan&);
+
+    typedef struct Phase {
+        std::vector<int> dependsOn;
+        std::vector<int> dependents;
+
+        // Dependencies that haven't finished yet.
+        size_t waitingFor;
+
+        StartupPhaseTiming timing;
+    } Phase;
+
+    // Follows waitedOn back from the phase that finished last, which is the chain that made
+    // startup take as long as it did.
+    void markCriticalPath();
+
+    std::vector<Phase> phases;
+
+    // Phases whose dependencies have all finished and haven't been handed out yet.
+    std::vector<int> ready;
+
+    bool begun;
+    size_t finished;
+
+    unsigned long long beginUs;
+    unsigned long long totalUs;
+};
@@ -0,0 +1,376 @@
+#include "ScanContext.h"
+#include "ScanScheduler.h"
+#include "TriggerScanner.h"
+#include "VerdictCache.h"
+#include "WarmStartSnapshot.h"
+#include "WorkPool.h"
+#include "TextTriggerIndex.h"
+
+#include <cstring>
+#include <string>
+
+using namespace System::Text;
+
+#define DEFAULT_PARALLEL_THRESHOLD (1024 * 1024)
+#define DEFAULT_CHUNK_SIZE (256 * 1024)
+#define DEFAULT_VERDICT_CACHE_SIZE (8 * 1024 * 1024)
+
+// Folds the caller's policy hash, whatever its length, into the fingerprint snapshots are kept under.
+#define POLICY_FINGERPRINT_SEED 0x706f6c6963796964ULL
+
+namespace FilterNativeWindows {
+    TextTriggerIndex::TextTriggerIndex() {
+        scanner = new TriggerScanner();
+        verdictCache = NULL;
+        scheduler = NULL;
+        restoredVerdicts = 0;
+
+        ParallelThreshold = DEFAULT_PARALLEL_THRESHOLD;
+        ChunkSize = DEFAULT_CHUNK_SIZE;
+        VerdictCacheSize = DEFAULT_VERDICT_CACHE_SIZE;
+    }
+
+    TextTriggerIndex::~TextTriggerIndex() {
+        this->!TextTriggerIndex();
+    }
+
+    TextTriggerIndex::!TextTriggerIndex() {
+        if (scanner != NULL) {
+            delete scanner;
+            scanner = NULL;
+        }
+
+        if (verdictCache != NULL) {
+            delete verdictCache;
+            verdictCache = NULL;
+        }
+
+        if (scheduler != NULL) {
+            delete scheduler;
+            scheduler = NULL;
+        }
+    }
+
+    bool TextTriggerIndex::AddTrigger(String^ trigger, short category) {
+        if (trigger == nullptr) {
+            throw gcnew ArgumentNullException("trigger");
+        }
+
+        array<Byte>^ text = Encoding::UTF8->GetBytes(trigger);
+        if (text->Length == 0) {
+            return false;
+        }
+
+        triggerText = nullptr;
+
+        pin_ptr<Byte> pinnedText = &text[0];
+        return scanner->AddTrigger(pinnedText, (size_t)text->Length, category);
+    }
+
+    void TextTriggerIndex::Clear() {
+        triggerText = nullptr;
+        scanner->Clear();
+
+        // Verdicts for the old triggers could never be hit again, so make room for new ones right away.
+        if (verdictCache != NULL) {
+            verdictCache->Clear();
+        }
+    }
+
+    int TextTriggerIndex::TriggerCount::get() {
+        return (int)scanner->TriggerCount();
+    }
+
+    int TextTriggerIndex::RefusedTriggers::get() {
+        return (int)scanner->RefusedTriggers();
+    }
+
+    bool TextTriggerIndex::HasCategory(short category) {
+        return scanner->HasCategory(category);
+    }
+
+    int TextTriggerIndex::VerdictCacheSize::get() {
+        return verdictCacheSize;
+    }
+
+    void TextTriggerIndex::VerdictCacheSize::set(int value) {
+        if (value < 0) {
+            throw gcnew ArgumentOutOfRangeException("value");
+        }
+
+        if (verdictCache != NULL) {
+            delete verdictCache;
+            verdictCache = NULL;
+        }
+
+        verdictCacheSize = value;
+
+        if (value > 0) {
+            verdictCache = new VerdictCache((size_t)value, VERDICT_CACHE_DEFAULT_CHUNK_SIZE);
+        }
+    }
+
+    void TextTriggerIndex::SetScanLimits(ScanLimits limits) {
+        if (limits.Slots < 0 || limits.HeadSize < 0 || limits.RequestBudgetMs < 0 || limits.GlobalBudget < 0 || limits.WindowMs < 0 ||
+            limits.MaxWaitMs < 0 || limits.MaxQueued < 0 || limits.MaxDeferMs < 0) {
+            throw gcnew ArgumentOutOfRangeException("limits");
+        }
+
+        if (scheduler != NULL) {
+            delete scheduler;
+            scheduler = NULL;
+        }
+
+        if (limits.Slots == 0) {
+            return;
+        }
+
+        ScanSchedulerLimits native;
+        native.slots = (unsigned int)limits.Slots;
+        native.headBytes = (size_t)limits.HeadSize;
+        native.requestBudget = (unsigned long long)(limits.RequestBudgetMs * 1000000);
+        native.globalBudget = limits.GlobalBudget;
+        native.window = (unsigned long long)limits.WindowMs * 1000000;
+        native.maxWait = (unsigned long long)limits.MaxWaitMs * 1000000;
+        native.maxQueued = (size_t)limits.MaxQueued;
+        native.overBudget = (int)limits.OverBudget;
+        native.maxDefer = (unsigned long long)limits.MaxDeferMs * 1000000;
+
+        scheduler = new ScanScheduler(native);
+    }
+
+    ScanSchedulerCounters TextTriggerIndex::GetScanCounters() {
+        ScanSchedulerCounters counters;
+
+        if (scheduler == NULL) {
+            return counters;
+        }
+
+        ScanSchedulerStats stats;
+        scheduler->GetStats(&stats);
+
+        counters.Queued = (long long)stats.queued;
+        counters.MaxQueued = (long long)stats.maxQueued;
+        counters.Running = (long long)stats.running;
+        counters.Bodies = (long long)stats.bodies;
+        counters.Parts = (long long)stats.parts;
+        counters.NoMatch = (long long)stats.clean;
+        counters.Matched = (long long)stats.matched;
+        counters.Truncated = (long long)stats.truncated;
+        counters.Refused = (long long)stats.refused;
+        counters.OverRequestBudget = (long long)stats.overRequestBudget;
+        counters.OverGlobalBudget = (long long)stats.overGlobalBudget;
+        counters.OverQueueLimit = (long long)stats.overQueueLimit;
+        counters.OverWaitLimit = (long long)stats.overWaitLimit;
+        counters.Deferred = (long long)stats.deferred;
+        counters.DeferExpired = (long long)stats.deferExpired;
+        counters.WaitNanoseconds = (long long)stats.waitNanoseconds;
+        counters.MaxWaitNanoseconds = (long long)stats.maxWaitNanoseconds;
+        counters.ScanNanoseconds = (long long)stats.scanNanoseconds;
+        return counters;
+    }
+
+    static ContentHash policyFingerprint(array<Byte>^ policyHash) {
+        if (policyHash == nullptr) {
+            throw gcnew ArgumentNullException("policyHash");
+        }
+
+        if (policyHash->Length == 0) {
+            return HashContent(NULL, 0, POLICY_FINGERPRINT_SEED);
+        }
+
+        pin_ptr<Byte> pinned = &policyHash[0];
+        return HashContent(pinned, (size_t)policyHash->Length, POLICY_FINGERPRINT_SEED);
+    }
+
+    array<Byte>^ TextTriggerIndex::SaveSnapshot(array<Byte>^ policyHash, int maxVerdicts) {
+        ContentHash policy = policyFingerprint(policyHash);
+
+        // It would come back as the whole of the lists, even after the limit was raised.
+        if (scanner->RefusedTriggers() > 0) {
+            return nullptr;
+        }
+
+        WarmStartWriter writer;
+        scanner->Save(&writer);
+
+        if (verdictCache != NULL && maxVerdicts > 0) {
+            verdictCache->Save(&writer, (size_t)maxVerdicts);
+        }
+
+        std::vector<unsigned char> bytes;
+        if (!writer.WriteTo(bytes, policy)) {
+            return nullptr;
+        }
+
+        array<Byte>^ snapshot = gcnew array<Byte>((int)bytes.size());
+        if (bytes.size() > 0) {
+            pin_ptr<Byte> pinned = &snapshot[0];
+            memcpy(pinned, &bytes[0], bytes.size());
+        }
+
+        return snapshot;
+    }
+
+    WarmStartStatus TextTriggerIndex::LoadSnapshot(array<Byte>^ snapshotBytes, array<Byte>^ policyHash) {
+        if (snapshotBytes == nullptr) {
+            throw gcnew ArgumentNullException("snapshotBytes");
+        }
+
+        ContentHash policy = policyFingerprint(policyHash);
+
+        triggerText = nullptr;
+        restoredVerdicts = 0;
+
+        if (verdictCache != NULL) {
+            verdictCache->Clear();
+        }
+
+        WarmStartSnapshot snapshot;
+        int status = WARM_START_CORRUPT;
+
+        if (snapshotBytes->Length > 0) {
+            pin_ptr<Byte> pinned = &snapshotBytes[0];
+            status = snapshot.Load(pinned, (size_t)snapshotBytes->Length, policy);
+        }
+
+        if (status != WARM_START_LOADED) {
+            scanner->Clear();
+            return (WarmStartStatus)status;
+        }
+
+        status = scanner->Restore(snapshot);
+        if (status != WARM_START_LOADED) {
+            return (WarmStartStatus)status;
+        }
+
+        if (verdictCache != NULL) {
+            restoredVerdicts = (int)verdictCache->Restore(snapshot);
+        }
+
+        return WarmStartStatus::Loaded;
+    }
+
+    int TextTriggerIndex::RestoredVerdicts::get() {
+        return restoredVerdicts;
+    }
+
+    bool TextTriggerIndex::ContainsTrigger(array<Byte>^ data, int offset, int count, bool jsonStringsOnly, Func<short, bool>^ categoryApplies, int maxPhraseWords, [Out] short% category, [Out] String^% trigger) {
+        return scan(data, offset, count, jsonStringsOnly, NULL, 0, categoryApplies, maxPhraseWords, category, trigger) == TriggerScanOutcome::Matched;
+    }
+
+    TriggerScanOutcome TextTriggerIndex::ScanForTrigger(array<Byte>^ data, int offset, int count, bool jsonStringsOnly, bool document, Func<short, bool>^ categoryApplies, int maxPhraseWords, [Out] short% category, [Out] String^% trigger) {
+        int priority = document ? SCAN_PRIORITY_DOCUMENT : SCAN_PRIORITY_SUBRESOURCE;
+        return scan(data, offset, count, jsonStringsOnly, scheduler, priority, categoryApplies, maxPhraseWords, category, trigger);
+    }
+
+    TriggerScanOutcome TextTriggerIndex::scan(array<Byte>^ data, int offset, int count, bool jsonStringsOnly, ScanScheduler* admission, int priority, Func<short, bool>^ categoryApplies, int maxPhraseWords, short% category, String^% trigger) {
+        category = -1;
+        trigger = nullptr;
+
+        if (data == nullptr) {
+            throw gcnew ArgumentNullException("data");
+        }
+
+        if (categoryApplies == nullptr) {
+            throw gcnew ArgumentNullException("categoryApplies");
+        }
+
+        if (offset < 0 || count < 0 || offset > data->Length - count) {
+            throw gcnew ArgumentOutOfRangeException("count");
+        }
+
+        if (count == 0 || scanner->TriggerCount() == 0) {
+            return TriggerScanOutcome::NoMatch;
+        }
+
+        // Nothing in here may allocate per scan: scratch memory comes from this thread's arena and the
+        // trigger strings handed back are cached.
+        ScanScope scope;
+
+        // Ask about each category once up front, rather than calling back into managed code for every hit.
+        const std::vector<short>& categories = scanner->Categories();
+        short maxCategory = 0;
+        for (size_t i = 0; i < categories.size(); i++) {
+            if (categories[i] > maxCategory) {
+                maxCategory = categories[i];
+            }
+        }
+
+        size_t enabledLength = (size_t)(maxCategory >> 3) + 1;
+        unsigned char* enabled = scope.Allocate<unsigned char>(enabledLength);
+        memset(enabled, 0, enabledLength);
+
+        for (size_t i = 0; i < categories.size(); i++) {
+            short id = categories[i];
+            if (id >= 0 && categoryApplies->Invoke(id)) {
+                enabled[id >> 3] |= (unsigned char)(1 << (id & 7));
+            }
+        }
+
+        TriggerScanOptions options;
+        options.enabledCategories = enabled;
+        options.enabledCategoriesLength = enabledLength;
+        options.maxPhraseWords = maxPhraseWords;
+        options.parallelThreshold = ParallelThreshold > 0 ? (size_t)ParallelThreshold : 0;
+        options.chunkSize = ChunkSize > 0 ? (size_t)ChunkSize : 0;
+        options.pool = options.parallelThreshold > 0 ? WorkPool::Shared() : NULL;
+        options.cache = verdictCache;
+
+        TriggerMatch match;
+        int outcome;
+
+        {
+            pin_ptr<Byte> pinnedData = &data[offset];
+
+            if (admission != NULL) {
+                outcome = scanner->ScanScheduled(pinnedData, (size_t)count, jsonStringsOnly, options, admission, priority, &match);
+            }
+            else if (jsonStringsOnly) {
+                outcome = scanner->ScanJsonStrings(pinnedData, (size_t)count, options, &match) ? SCAN_OUTCOME_MATCHED : SCAN_OUTCOME_CLEAN;
+            }
+            else {
+                outcome = scanner->Scan(pinnedData, (size_t)count, options, &match) ? SCAN_OUTCOME_MATCHED : SCAN_OUTCOME_CLEAN;
+            }
+        }
+
+        if (outcome != SCAN_OUTCOME_MATCHED) {
+            return (TriggerScanOutcome)outcome;
+        }
+
+        // Racing scans may both fill the same slot, which is harmless since they'd store equal strings.
+        array<String^>^ names = triggerText;
+        if (names == nullptr || names->Length != (int)scanner->TriggerCount()) {
+            names = gcnew array<String^>((int)scanner->TriggerCount());
+            triggerText = names;
+        }
+
+        String^ name = names[match.trigger];
+        if (name == nullptr) {
+            size_t textLength = 0;
+            const unsigned char* text = scanner->TriggerText(match.trigger, &textLength);
+
+            name = gcnew String(reinterpret_cast<char*>(const_cast<unsigned char*>(text)), 0, (int)textLength, Encoding::UTF8);
+            names[match.trigger] = name;
+        }
+
+        category = match.category;
+        trigger = name;
+        return TriggerScanOutcome::Matched;
+    }
+
+    ScanAllocationCounters TextTriggerIndex::GetAllocationCounters() {
+        ScanAllocationStats stats;
+        ScanContext::GetStats(&stats);
+
+        ScanAllocationCounters counters;
+        counters.Scans = (long long)stats.scans;
+        counters.ArenaAllocations = (long long)stats.arenaAllocations;
+        counters.ArenaBytes = (long long)stats.arenaBytes;
+        counters.HeapAllocations = (long long)stats.heapAllocations;
+        counters.OversizedScans = (long long)stats.oversizedScans;
+        counters.Contexts = (long long)stats.contexts;
+        counters.ReservedBytes = (long long)stats.reservedBytes;
+        return counters;
+    }
+}
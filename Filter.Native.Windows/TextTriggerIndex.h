@@ -0,0 +1,259 @@
+#pragma once
+
+#include "ScanScheduler.h"
+#include "WarmStartSnapshot.h"
+
+class TriggerScanner;
+class VerdictCache;
+
+using namespace System;
+using namespace System::Runtime::InteropServices;
+
+namespace FilterNativeWindows {
+    /// <summary>
+    /// Process-wide allocation totals for native scans. HeapAllocations stays flat once every scanning thread has warmed up,
+    /// except for scans that are too big for the per-thread buffers, which are counted in OversizedScans.
+    /// </summary>
+    public value struct ScanAllocationCounters {
+        long long Scans;
+        long long ArenaAllocations;
+        long long ArenaBytes;
+        long long HeapAllocations;
+        long long OversizedScans;
+        long long Contexts;
+        long long ReservedBytes;
+    };
+
+    public enum class TriggerScanOutcome {
+        NoMatch = SCAN_OUTCOME_CLEAN,
+        Matched = SCAN_OUTCOME_MATCHED,
+
+        /// <summary>
+        /// Only the start of the content was scanned, and nothing matched there.
+        /// </summary>
+        Truncated = SCAN_OUTCOME_TRUNCATED,
+
+        /// <summary>
+        /// The content went over budget and the policy is to block what couldn't be scanned.
+        /// </summary>
+        Refused = SCAN_OUTCOME_REFUSED
+    };
+
+    public enum class WarmStartStatus {
+        Loaded = WARM_START_LOADED,
+        Missing = WARM_START_MISSING,
+
+        /// <summary>
+        /// Damaged, or cut short while it was written.
+        /// </summary>
+        Corrupt = WARM_START_CORRUPT,
+
+        /// <summary>
+        /// Written by a build with another snapshot layout.
+        /// </summary>
+        Incompatible = WARM_START_INCOMPATIBLE,
+
+        /// <summary>
+        /// Written for other lists.
+        /// </summary>
+        Stale = WARM_START_STALE,
+
+        /// <summary>
+        /// Bigger than the trigger index's memory budget allows.
+        /// </summary>
+        OverBudget = WARM_START_OVER_BUDGET
+    };
+
+    public enum class ScanOverBudget {
+        HeadOnly = SCAN_OVER_BUDGET_HEAD_ONLY,
+        Defer = SCAN_OVER_BUDGET_DEFER,
+        FailClosed = SCAN_OVER_BUDGET_FAIL_CLOSED
+    };
+
+    /// <summary>
+    /// How much scanning ScanForTrigger may do. See ScanScheduler.h for how each limit applies.
+    /// </summary>
+    public value struct ScanLimits {
+        /// <summary>
+        /// Parts of bodies scanned at once. Zero turns scheduling off, so that every scan runs in full as soon as it comes.
+        /// </summary>
+        int Slots;
+
+        /// <summary>
+        /// Bytes at the start of every body that are scanned ahead of the rest of any body, and the size of the parts the rest
+        /// is scanned in.
+        /// </summary>
+        int HeadSize;
+
+        /// <summary>
+        /// Scan time one body may use. Zero for no limit.
+        /// </summary>
+        double RequestBudgetMs;
+
+        /// <summary>
+        /// Processors' worth of scan time all bodies together may use, averaged over WindowMs. Zero for no limit.
+        /// </summary>
+        double GlobalBudget;
+        int WindowMs;
+
+        /// <summary>
+        /// How long a part past the head may wait for a slot, and how many may wait at once. Zero for no limit.
+        /// </summary>
+        int MaxWaitMs;
+        int MaxQueued;
+
+        ScanOverBudget OverBudget;
+
+        /// <summary>
+        /// How long a deferred part waits for the global budget before its body is refused.
+        /// </summary>
+        int MaxDeferMs;
+    };
+
+    public value struct ScanSchedulerCounters {
+        /// <summary>
+        /// Parts waiting for a slot now, the most that ever waited, and the parts being scanned.
+        /// </summary>
+        long long Queued;
+        long long MaxQueued;
+        long long Running;
+
+        long long Bodies;
+        long long Parts;
+
+        long long NoMatch;
+        long long Matched;
+        long long Truncated;
+        long long Refused;
+
+        /// <summary>
+        /// Times a part went over budget, by reason.
+        /// </summary>
+        long long OverRequestBudget;
+        long long OverGlobalBudget;
+        long long OverQueueLimit;
+        long long OverWaitLimit;
+
+        long long Deferred;
+
+        /// <summary>
+        /// Bodies refused because a deferred part waited MaxDeferMs.
+        /// </summary>
+        long long DeferExpired;
+
+        long long WaitNanoseconds;
+        long long MaxWaitNanoseconds;
+        long long ScanNanoseconds;
+    };
+
+    /// <summary>
+    /// Native text trigger index. Scans response bodies in place without decoding them to strings first.
+    /// </summary>
+    /// <remarks>
+    /// Triggers must not be added while a scan is running. Any number of scans can run at once.
+    /// </remarks>
+    public ref class TextTriggerIndex {
+    public:
+        TextTriggerIndex();
+        ~TextTriggerIndex();
+        !TextTriggerIndex();
+
+        /// <returns>False if the trigger has no words in it.</returns>
+        bool AddTrigger(String^ trigger, short category);
+
+        void Clear();
+
+        property int TriggerCount {
+            int get();
+        }
+
+        /// <summary>
+        /// Triggers left out since the last Clear because the memory budget had no room for them. They never match.
+        /// </summary>
+        property int RefusedTriggers {
+            int get();
+        }
+
+        /// <returns>True if at least one trigger is in the category.</returns>
+        bool HasCategory(short category);
+
+        /// <summary>
+        /// Bodies larger than this many bytes are split into chunks and scanned on the shared work pool. Zero disables chunking.
+        /// </summary>
+        property int ParallelThreshold;
+
+        /// <summary>
+        /// Approximate size of each chunk when a body is scanned in parallel.
+        /// </summary>
+        property int ChunkSize;
+
+        /// <summary>
+        /// Memory budget in bytes for remembering the verdicts of content scanned before, so that bodies or parts of bodies that
+        /// come back byte for byte aren't scanned again. Zero disables the cache. Must not be changed while a scan is running.
+        /// </summary>
+        property int VerdictCacheSize {
+            int get();
+            void set(int value);
+        }
+
+        /// <summary>
+        /// Looks for a trigger in an enabled category within UTF-8 content.
+        /// </summary>
+        /// <param name="jsonStringsOnly">If true, the content is JSON and only its string values are scanned.</param>
+        /// <param name="maxPhraseWords">Longest phrase to try, in words. Anything below 1 means single words only.</param>
+        bool ContainsTrigger(array<Byte>^ data, int offset, int count, bool jsonStringsOnly, Func<short, bool>^ categoryApplies, int maxPhraseWords, [Out] short% category, [Out] String^% trigger);
+
+        /// <summary>
+        /// Like ContainsTrigger, but waits its turn and keeps to the limits set with SetScanLimits.
+        /// </summary>
+        /// <param name="document">True for a top-level page, which is scanned ahead of everything else.</param>
+        TriggerScanOutcome ScanForTrigger(array<Byte>^ data, int offset, int count, bool jsonStringsOnly, bool document, Func<short, bool>^ categoryApplies, int maxPhraseWords, [Out] short% category, [Out] String^% trigger);
+
+        /// <summary>
+        /// Must not be called while a scan is running.
+        /// </summary>
+        void SetScanLimits(ScanLimits limits);
+
+        ScanSchedulerCounters GetScanCounters();
+
+        /// <summary>
+        /// Lays the triggers out as they are in memory, along with up to maxVerdicts of the cached verdicts that were looked up
+        /// most, so that LoadSnapshot can bring both back after a restart. The bytes hold the trigger text, so the caller has
+        /// to encrypt them before they are stored. Must not be called while triggers are being added.
+        /// </summary>
+        /// <param name="policyHash">Identifies the lists the triggers came from. LoadSnapshot only takes the snapshot back with
+        /// the same hash.</param>
+        /// <returns>Null if it couldn't be saved, which includes when the memory budget left triggers out.</returns>
+        array<Byte>^ SaveSnapshot(array<Byte>^ policyHash, int maxVerdicts);
+
+        /// <summary>
+        /// Replaces the triggers with the ones in a snapshot SaveSnapshot made and adds its verdicts to the cache. The snapshot
+        /// is checked in full first, and anything but Loaded leaves the index empty. Must not be called while a scan is
+        /// running.
+        /// </summary>
+        WarmStartStatus LoadSnapshot(array<Byte>^ snapshotBytes, array<Byte>^ policyHash);
+
+        /// <summary>
+        /// Verdicts the last LoadSnapshot added to the cache.
+        /// </summary>
+        property int RestoredVerdicts {
+            int get();
+        }
+
+        static ScanAllocationCounters GetAllocationCounters();
+
+    private:
+        TriggerScanOutcome scan(array<Byte>^ data, int offset, int count, bool jsonStringsOnly, ScanScheduler* admission, int priority, Func<short, bool>^ categoryApplies, int maxPhraseWords, short% category, String^% trigger);
+
+        TriggerScanner* scanner;
+        VerdictCache* verdictCache;
+        int verdictCacheSize;
+        int restoredVerdicts;
+
+        // NULL while scheduling is off.
+        ScanScheduler* scheduler;
+
+        // Matched trigger strings, created the first time each one matches.
+        array<String^>^ triggerText;
+    };
+}
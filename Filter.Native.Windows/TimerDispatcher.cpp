@@ -0,0 +1,142 @@
+#include "TimerDispatcher.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+struct TimerDispatcher::Impl {
+    Impl() : schedule(TimerDispatcher::Milliseconds(), TimerDispatcher::Milliseconds()), handedOut(0), sleepingUntil(0), waiting(false), stopping(false) {
+    }
+
+    mutable std::mutex lock;
+    std::condition_variable wake;
+
+    JobSchedule schedule;
+
+    // Jobs that expired but did not fit in the caller's buffer yet.
+    std::vector<unsigned int> due;
+    size_t handedOut;
+
+    unsigned long long sleepingUntil;
+    bool waiting;
+    bool stopping;
+};
+
+TimerDispatcher::TimerDispatcher() {
+    impl = new Impl();
+}
+
+TimerDispatcher::~TimerDispatcher() {
+    delete impl;
+}
+
+unsigned int TimerDispatcher::AddJob(unsigned int periodMs, unsigned int slackMs, double jitter, unsigned int maxBackoffMs) {
+    std::lock_guard<std::mutex> guard(impl->lock);
+    return impl->schedule.AddJob(periodMs, slackMs, jitter, maxBackoffMs);
+}
+
+void TimerDispatcher::Start(unsigned int job, unsigned long long delayMs) {
+    std::lock_guard<std::mutex> guard(impl->lock);
+
+    impl->schedule.Start(job, delayMs, Milliseconds());
+    wakeIfEarlier();
+}
+
+void TimerDispatcher::Stop(unsigned int job) {
+    // A later deadline never needs the dispatcher woken. It finds out when it next wakes anyway.
+    std::lock_guard<std::mutex> guard(impl->lock);
+    impl->schedule.Stop(job);
+}
+
+void TimerDispatcher::SetPeriod(unsigned int job, unsigned int periodMs) {
+    std::lock_guard<std::mutex> guard(impl->lock);
+
+    impl->schedule.SetPeriod(job, periodMs);
+    wakeIfEarlier();
+}
+
+void TimerDispatcher::Complete(unsigned int job, bool succeeded) {
+    std::lock_guard<std::mutex> guard(impl->lock);
+
+    impl->schedule.Complete(job, succeeded, Milliseconds());
+    wakeIfEarlier();
+}
+
+size_t TimerDispatcher::WaitForDue(unsigned int* jobs, size_t capacity) {
+    std::unique_lock<std::mutex> guard(impl->lock);
+
+    bool woken = false;
+
+    while (!impl->stopping) {
+        if (impl->handedOut < impl->due.size()) {
+            size_t count = impl->due.size() - impl->handedOut;
+            if (count > capacity) {
+                count = capacity;
+            }
+
+            for (size_t i = 0; i < count; i++) {
+                jobs[i] = impl->due[impl->handedOut + i];
+            }
+
+            impl->handedOut += count;
+            return count;
+        }
+
+        impl->due.clear();
+        impl->handedOut = 0;
+
+        impl->schedule.Expire(Milliseconds(), impl->due);
+
+        if (woken) {
+            impl->schedule.CountWakeup(impl->due.empty());
+            woken = false;
+        }
+
+        if (!impl->due.empty()) {
+            continue;
+        }
+
+        unsigned long long next = impl->schedule.NextDeadline();
+
+        impl->sleepingUntil = next;
+        impl->waiting = true;
+
+        if (next == TIMER_WHEEL_NEVER) {
+            impl->wake.wait(guard);
+        }
+        else {
+            impl->wake.wait_until(guard, std::chrono::steady_clock::time_point(std::chrono::milliseconds(next)));
+        }
+
+        impl->waiting = false;
+        woken = true;
+    }
+
+    return 0;
+}
+
+void TimerDispatcher::Shutdown() {
+    std::lock_guard<std::mutex> guard(impl->lock);
+
+    impl->stopping = true;
+    impl->wake.notify_all();
+}
+
+JobScheduleStats TimerDispatcher::Stats() const {
+    std::lock_guard<std::mutex> guard(impl->lock);
+    return impl->schedule.Stats();
+}
+
+unsigned long long TimerDispatcher::Milliseconds() {
+    return (unsigned long long)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void TimerDispatcher::wakeIfEarlier() {
+    if (impl->waiting && impl->schedule.NextDeadline() < impl->sleepingUntil) {
+        // So that a second change before the dispatcher runs does not wake it again.
+        impl->sleepingUntil = impl->schedule.NextDeadline();
+        impl->wake.notify_one();
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+
+#include "JobSchedule.h"
+
+/// A JobSchedule on the steady clock, shared between the threads that start and stop jobs and one
+/// dispatcher thread that sleeps in WaitForDue() until the next deadline. The dispatcher is only
+/// woken early when a change moves that deadline earlier, so starting a job that is due later than
+/// everything else costs no wakeup at all.
+///
+/// The threading types live in the .cpp so that this header can be included from /clr code.
+class TimerDispatcher {
+public:
+    TimerDispatcher();
+    ~TimerDispatcher();
+
+    unsigned int AddJob(unsigned int periodMs, unsigned int slackMs, double jitter, unsigned int maxBackoffMs);
+
+    void Start(unsigned int job, unsigned long long delayMs);
+    void Stop(unsigned int job);
+    void SetPeriod(unsigned int job, unsigned int periodMs);
+
+    /// Must be called once for every job WaitForDue() hands out, when it has finished running.
+    void Complete(unsigned int job, bool succeeded);
+
+    /// Blocks until at least one job is due and copies up to capacity of them into jobs. Returns
+    /// zero once Shutdown() has been called. Only one thread may wait at a time.
+    size_t WaitForDue(unsigned int* jobs, size_t capacity);
+
+    void Shutdown();
+
+    JobScheduleStats Stats() const;
+
+    /// Monotonic milliseconds, the clock jobs are scheduled on.
+    static unsigned long long Milliseconds();
+
+private:
+    TimerDispatcher(const TimerDispatcher&);
+    TimerDispatcher& operator=(const TimerDispatcher&);
+
+    // Wakes the dispatcher if the schedule now has a deadline before the one it is sleeping until.
+    // Called with the lock held.
+    void wakeIfEarlier();
+
+    struct Impl;
+    Impl* impl;
+};
@@ -0,0 +1,255 @@
+#include "TimerWheel.h"
+
+#define TIMER_WHEEL_NONE 0xFFFFFFFFU
+#define SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+
+static int lowestBit(unsigned long long bits) {
+    // De Bruijn multiplication, for compilers without a bit scan intrinsic.
+    static const int positions[64] = {
+        0, 1, 48, 2, 57, 49, 28, 3, 61, 58, 50, 42, 38, 29, 17, 4,
+        62, 55, 59, 36, 53, 51, 43, 22, 45, 39, 33, 30, 24, 18, 12, 5,
+        63, 47, 56, 27, 60, 41, 37, 16, 54, 35, 52, 21, 44, 32, 23, 11,
+        46, 26, 40, 15, 34, 20, 31, 10, 25, 14, 19, 9, 13, 8, 7, 6
+    };
+
+    return positions[((bits & (~bits + 1)) * 0x03f79d71b4cb0a89ULL) >> 58];
+}
+
+// First occupied slot after index on a level, or -1.
+static int nextOccupied(unsigned long long occupied, int index) {
+    if (index >= SLOT_MASK) {
+        return -1;
+    }
+
+    unsigned long long later = occupied & (~0ULL << (index + 1));
+    return later == 0 ? -1 : lowestBit(later);
+}
+
+static int shiftFor(int level) {
+    return TIMER_WHEEL_SLOT_BITS * level;
+}
+
+TimerWheel::TimerWheel(unsigned long long now) : overflow(TIMER_WHEEL_NONE), current(now), armedCount(0) {
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        occupied[level] = 0;
+
+        for (int slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+            heads[level][slot] = TIMER_WHEEL_NONE;
+        }
+    }
+}
+
+void TimerWheel::Arm(unsigned int id, unsigned long long expiry) {
+    if (id >= nodes.size()) {
+        TimerNode empty = { 0, TIMER_WHEEL_NONE, TIMER_WHEEL_NONE, 0, 0, false };
+        nodes.resize((size_t)id + 1, empty);
+    }
+
+    if (nodes[id].armed) {
+        unlink(id);
+    }
+    else {
+        armedCount++;
+    }
+
+    nodes[id].expiry = expiry > current ? expiry : current + 1;
+    nodes[id].armed = true;
+    link(id);
+}
+
+void TimerWheel::Disarm(unsigned int id) {
+    if (id < nodes.size() && nodes[id].armed) {
+        unlink(id);
+        nodes[id].armed = false;
+        armedCount--;
+    }
+}
+
+bool TimerWheel::IsArmed(unsigned int id) const {
+    return id < nodes.size() && nodes[id].armed;
+}
+
+unsigned long long TimerWheel::ExpiryOf(unsigned int id) const {
+    return IsArmed(id) ? nodes[id].expiry : TIMER_WHEEL_NEVER;
+}
+
+void TimerWheel::link(unsigned int id) {
+    TimerNode& node = nodes[id];
+
+    // The lowest level on which the timer is in the same turn of the next level up as the present.
+    int level = 0;
+    while (level < TIMER_WHEEL_LEVELS && (node.expiry >> shiftFor(level + 1)) != (current >> shiftFor(level + 1))) {
+        level++;
+    }
+
+    node.prev = TIMER_WHEEL_NONE;
+    node.level = level;
+
+    if (level == TIMER_WHEEL_LEVELS) {
+        node.slot = 0;
+        node.next = overflow;
+
+        if (node.next != TIMER_WHEEL_NONE) {
+            nodes[node.next].prev = id;
+        }
+
+        overflow = id;
+        return;
+    }
+
+    int slot = (int)((node.expiry >> shiftFor(level)) & SLOT_MASK);
+
+    node.slot = slot;
+    node.next = heads[level][slot];
+
+    if (node.next != TIMER_WHEEL_NONE) {
+        nodes[node.next].prev = id;
+    }
+
+    heads[level][slot] = id;
+    occupied[level] |= 1ULL << slot;
+}
+
+void TimerWheel::unlink(unsigned int id) {
+    TimerNode& node = nodes[id];
+
+    if (node.prev != TIMER_WHEEL_NONE) {
+        nodes[node.prev].next = node.next;
+    }
+    else if (node.level == TIMER_WHEEL_LEVELS) {
+        overflow = node.next;
+    }
+    else {
+        heads[node.level][node.slot] = node.next;
+
+        if (node.next == TIMER_WHEEL_NONE) {
+            occupied[node.level] &= ~(1ULL << node.slot);
+        }
+    }
+
+    if (node.next != TIMER_WHEEL_NONE) {
+        nodes[node.next].prev = node.prev;
+    }
+
+    node.prev = TIMER_WHEEL_NONE;
+    node.next = TIMER_WHEEL_NONE;
+}
+
+unsigned long long TimerWheel::nextActivity() const {
+    unsigned long long next = TIMER_WHEEL_NEVER;
+
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        int index = (int)((current >> shiftFor(level)) & SLOT_MASK);
+        int slot = nextOccupied(occupied[level], index);
+
+        if (slot < 0) {
+            continue;
+        }
+
+        unsigned long long turn = (current >> shiftFor(level + 1)) << shiftFor(level + 1);
+        unsigned long long start = turn + ((unsigned long long)slot << shiftFor(level));
+
+        if (start < next) {
+            next = start;
+        }
+    }
+
+    if (next == TIMER_WHEEL_NEVER && overflow != TIMER_WHEEL_NONE) {
+        next = ((current >> shiftFor(TIMER_WHEEL_LEVELS)) + 1) << shiftFor(TIMER_WHEEL_LEVELS);
+    }
+
+    return next;
+}
+
+unsigned long long TimerWheel::NextExpiry() const {
+    unsigned long long next = TIMER_WHEEL_NEVER;
+
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        int index = (int)((current >> shiftFor(level)) & SLOT_MASK);
+        int slot = nextOccupied(occupied[level], index);
+
+        if (slot < 0) {
+            continue;
+        }
+
+        // Everything in a level's first occupied slot expires before anything in its later slots,
+        // so only that one list needs looking at.
+        for (unsigned int id = heads[level][slot]; id != TIMER_WHEEL_NONE; id = nodes[id].next) {
+            if (nodes[id].expiry < next) {
+                next = nodes[id].expiry;
+            }
+        }
+    }
+
+    if (next == TIMER_WHEEL_NEVER) {
+        for (unsigned int id = overflow; id != TIMER_WHEEL_NONE; id = nodes[id].next) {
+            if (nodes[id].expiry < next) {
+                next = nodes[id].expiry;
+            }
+        }
+    }
+
+    return next;
+}
+
+void TimerWheel::Advance(unsigned long long now, std::vector<unsigned int>& expired) {
+    while (current < now) {
+        unsigned long long next = nextActivity();
+
+        if (next > now) {
+            current = now;
+            break;
+        }
+
+        current = next;
+
+        // Hand down the timers of every level whose slot starts here, highest first, so that they
+        // settle on the level they now belong to before level 0 fires.
+        if ((current & ((1ULL << shiftFor(TIMER_WHEEL_LEVELS)) - 1)) == 0) {
+            unsigned int id = overflow;
+            overflow = TIMER_WHEEL_NONE;
+
+            while (id != TIMER_WHEEL_NONE) {
+                unsigned int next = nodes[id].next;
+                link(id);
+                id = next;
+            }
+        }
+
+        for (int level = TIMER_WHEEL_LEVELS - 1; level > 0; level--) {
+            if ((current & ((1ULL << shiftFor(level)) - 1)) != 0) {
+                continue;
+            }
+
+            int slot = (int)((current >> shiftFor(level)) & SLOT_MASK);
+            unsigned int id = heads[level][slot];
+
+            heads[level][slot] = TIMER_WHEEL_NONE;
+            occupied[level] &= ~(1ULL << slot);
+
+            while (id != TIMER_WHEEL_NONE) {
+                unsigned int next = nodes[id].next;
+                link(id);
+                id = next;
+            }
+        }
+
+        int slot = (int)(current & SLOT_MASK);
+        unsigned int id = heads[0][slot];
+
+        heads[0][slot] = TIMER_WHEEL_NONE;
+        occupied[0] &= ~(1ULL << slot);
+
+        while (id != TIMER_WHEEL_NONE) {
+            unsigned int next = nodes[id].next;
+
+            nodes[id].armed = false;
+            nodes[id].prev = TIMER_WHEEL_NONE;
+            nodes[id].next = TIMER_WHEEL_NONE;
+            armedCount--;
+            expired.push_back(id);
+
+            id = next;
+        }
+    }
+}
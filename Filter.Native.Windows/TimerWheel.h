@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#define TIMER_WHEEL_LEVELS 5
+#define TIMER_WHEEL_SLOT_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_SLOT_BITS)
+
+#define TIMER_WHEEL_NEVER 0xFFFFFFFFFFFFFFFFULL
+
+typedef struct TimerNode {
+    unsigned long long expiry;
+
+    // Neighbours in the slot's list, or TIMER_WHEEL_NONE.
+    unsigned int prev;
+    unsigned int next;
+
+    int level;
+    int slot;
+    bool armed;
+} TimerNode;
+
+/// Hierarchical timing wheel over abstract ticks. Level n has 64 slots of 64^n ticks each, so five
+/// levels reach about 10^9 ticks ahead. Timers further out wait on an overflow list that is sorted
+/// back into the wheel each time it comes round. Arming and disarming are O(1). Advancing jumps straight between occupied
+/// slots rather than stepping every tick, so a long sleep costs nothing.
+///
+/// Timers are identified by small integers chosen by the caller, and storage grows to fit the
+/// largest one. Not thread safe.
+class TimerWheel {
+public:
+    explicit TimerWheel(unsigned long long now);
+
+    /// Sets timer id to expire at the given tick, moving it if it was already armed. Anything at or
+    /// before Now() expires on the next tick.
+    void Arm(unsigned int id, unsigned long long expiry);
+
+    void Disarm(unsigned int id);
+
+    bool IsArmed(unsigned int id) const;
+
+    /// When timer id expires, or TIMER_WHEEL_NEVER if it is not armed.
+    unsigned long long ExpiryOf(unsigned int id) const;
+
+    /// Moves time forward to now and appends every timer that expired on the way, in expiry order.
+    void Advance(unsigned long long now, std::vector<unsigned int>& expired);
+
+    /// Tick of the earliest armed timer, or TIMER_WHEEL_NEVER if there are none.
+    unsigned long long NextExpiry() const;
+
+    unsigned long long Now() const { return current; }
+
+    size_t ArmedCount() const { return armedCount; }
+
+private:
+    TimerWheel(const TimerWheel&);
+    TimerWheel& operator=(const TimerWheel&);
+
+    void link(unsigned int id);
+    void unlink(unsigned int id);
+
+    // Tick at which the next occupied slot on any level starts.
+    unsigned long long nextActivity() const;
+
+    std::vector<TimerNode> nodes;
+
+    unsigned int heads[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+    unsigned long long occupied[TIMER_WHEEL_LEVELS];
+
+    // Timers beyond the current turn of the top level.
+    unsigned int overflow;
+
+    unsigned long long current;
+    size_t armedCount;
+};
@@ -0,0 +1,220 @@
+#include "TraceRing.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+#define TRACE_RING_MASK (TRACE_RING_CAPACITY - 1)
+
+// Timestamp, then event id and argument count, then the arguments.
+#define TRACE_SLOT_WORDS (2 + TRACE_MAX_ARGS)
+
+// Keeps the writer's and drainer's positions off each other's cache line.
+#define CACHE_LINE_SIZE 64
+
+namespace {
+    struct Slot {
+        // Position + 1 once the event at that position is complete, zero while it is being written.
+        std::atomic<unsigned long long> sequence;
+        std::atomic<unsigned long long> words[TRACE_SLOT_WORDS];
+    };
+
+    struct Ring {
+        Slot slots[TRACE_RING_CAPACITY];
+
+        // Only the owning thread writes head, and only the drainer writes tail.
+        std::atomic<unsigned long long> head;
+        char headPadding[CACHE_LINE_SIZE];
+        std::atomic<unsigned long long> tail;
+        char tailPadding[CACHE_LINE_SIZE];
+
+        // Set when the owning thread exits. The drainer frees the ring once it is empty.
+        std::atomic<bool> retired;
+
+        unsigned int thread;
+    };
+
+    struct Registry {
+        std::mutex lock;
+        std::vector<Ring*> rings;
+        unsigned int nextThread;
+    };
+
+    class ThreadRing {
+    public:
+        ThreadRing() : ring(NULL) {
+        }
+
+        ~ThreadRing() {
+            if (ring != NULL) {
+                ring->retired.store(true, std::memory_order_release);
+            }
+        }
+
+        Ring* Get() {
+            if (ring == NULL) {
+                ring = registerThread();
+            }
+
+            return ring;
+        }
+
+    private:
+        static Ring* registerThread();
+
+        Ring* ring;
+    };
+}
+
+static std::atomic<int> overflow(TRACE_OVERFLOW_DROP_NEWEST);
+static std::atomic<unsigned long long> lost(0);
+
+static Registry& registry() {
+    // Never destroyed, since threads can still exit after static destructors have run.
+    static Registry* shared = NULL;
+    static std::once_flag created;
+
+    std::call_once(created, [] {
+        shared = new Registry();
+        shared->nextThread = 0;
+    });
+
+    return *shared;
+}
+
+Ring* ThreadRing::registerThread() {
+    // Value-initialized, so every slot, position and flag starts at zero.
+    Ring* ring = new Ring();
+
+    Registry& shared = registry();
+    std::lock_guard<std::mutex> guard(shared.lock);
+    ring->thread = ++shared.nextThread;
+    shared.rings.push_back(ring);
+
+    return ring;
+}
+
+static Ring* currentRing() {
+    static thread_local ThreadRing ring;
+    return ring.Get();
+}
+
+unsigned long long TraceRing::Now() {
+    return (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool TraceRing::Write(unsigned short eventId, const long long* args, unsigned short argCount) {
+    if (argCount > TRACE_MAX_ARGS) {
+        argCount = TRACE_MAX_ARGS;
+    }
+
+    Ring* ring = currentRing();
+    unsigned long long position = ring->head.load(std::memory_order_relaxed);
+    unsigned long long tail = ring->tail.load(std::memory_order_acquire);
+
+    if (overflow.load(std::memory_order_relaxed) == TRACE_OVERFLOW_DROP_NEWEST && position - tail >= TRACE_RING_CAPACITY) {
+        lost.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    Slot& slot = ring->slots[position & TRACE_RING_MASK];
+
+    slot.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.words[0].store(Now(), std::memory_order_relaxed);
+    slot.words[1].store((unsigned long long)eventId | ((unsigned long long)argCount << 16), std::memory_order_relaxed);
+
+    for (unsigned short i = 0; i < argCount; i++) {
+        slot.words[2 + i].store((unsigned long long)args[i], std::memory_order_relaxed);
+    }
+
+    slot.sequence.store(position + 1, std::memory_order_release);
+    ring->head.store(position + 1, std::memory_order_release);
+
+    // Pending events rise by at most one per write, however the drainer moves the tail, so they
+    // land on the mark each time they climb past it.
+    return position + 1 - tail == TRACE_RING_FILL_MARK;
+}
+
+size_t TraceRing::Drain(TraceEvent* events, size_t maxEvents) {
+    Registry& shared = registry();
+
+    // Also keeps a second drainer from moving the same tails.
+    std::lock_guard<std::mutex> guard(shared.lock);
+
+    size_t count = 0;
+
+    for (size_t r = 0; r < shared.rings.size() && count < maxEvents; ) {
+        Ring* ring = shared.rings[r];
+
+        // Checked before head, so that a retired ring's head is final by the time it is read.
+        bool retired = ring->retired.load(std::memory_order_acquire);
+
+        unsigned long long head = ring->head.load(std::memory_order_acquire);
+        unsigned long long tail = ring->tail.load(std::memory_order_relaxed);
+
+        if (head - tail > TRACE_RING_CAPACITY) {
+            // Overwritten before we got to them.
+            lost.fetch_add(head - tail - TRACE_RING_CAPACITY, std::memory_order_relaxed);
+            tail = head - TRACE_RING_CAPACITY;
+        }
+
+        while (tail < head && count < maxEvents) {
+            Slot& slot = ring->slots[tail & TRACE_RING_MASK];
+            unsigned long long words[TRACE_SLOT_WORDS];
+
+            unsigned long long before = slot.sequence.load(std::memory_order_acquire);
+            for (int i = 0; i < TRACE_SLOT_WORDS; i++) {
+                words[i] = slot.words[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            unsigned long long after = slot.sequence.load(std::memory_order_relaxed);
+
+            tail++;
+
+            if (before != tail || after != before) {
+                // The writer lapped us while we were reading this slot.
+                lost.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+
+            TraceEvent& event = events[count++];
+            event.timestamp = words[0];
+            event.thread = ring->thread;
+            event.eventId = (unsigned short)(words[1] & 0xFFFF);
+            event.argCount = (unsigned short)((words[1] >> 16) & 0xFFFF);
+
+            for (int i = 0; i < TRACE_MAX_ARGS; i++) {
+                event.args[i] = i < event.argCount ? (long long)words[2 + i] : 0;
+            }
+        }
+
+        ring->tail.store(tail, std::memory_order_release);
+
+        if (retired && tail == head) {
+            delete ring;
+            shared.rings[r] = shared.rings.back();
+            shared.rings.pop_back();
+            continue;
+        }
+
+        r++;
+    }
+
+    return count;
+}
+
+void TraceRing::SetOverflow(int mode) {
+    overflow.store(mode == TRACE_OVERFLOW_OVERWRITE_OLDEST ? TRACE_OVERFLOW_OVERWRITE_OLDEST : TRACE_OVERFLOW_DROP_NEWEST, std::memory_order_relaxed);
+}
+
+int TraceRing::Overflow() {
+    return overflow.load(std::memory_order_relaxed);
+}
+
+unsigned long long TraceRing::Lost() {
+    return lost.load(std::memory_order_relaxed);
+}
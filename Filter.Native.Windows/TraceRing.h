@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+
+#define TRACE_MAX_ARGS 4
+
+// Events each thread can hold before the drainer catches up. Must be a power of two.
+#define TRACE_RING_CAPACITY 1024
+
+// Pending events at which Write() asks for a drain. Half the capacity leaves the drainer time to get
+// there before anything is dropped.
+#define TRACE_RING_FILL_MARK (TRACE_RING_CAPACITY / 2)
+
+// What a thread does when its ring is full.
+#define TRACE_OVERFLOW_DROP_NEWEST 0
+#define TRACE_OVERFLOW_OVERWRITE_OLDEST 1
+
+typedef struct TraceEvent {
+    // TraceRing::Now() at the time the event was written.
+    unsigned long long timestamp;
+
+    // Small number given to each thread the first time it writes, in order.
+    unsigned int thread;
+
+    unsigned short eventId;
+    unsigned short argCount;
+    long long args[TRACE_MAX_ARGS];
+} TraceEvent;
+
+/// Per-thread rings of fixed-size binary events. Writing copies a few words into the calling
+/// thread's ring and never formats, allocates (after the first event on a thread) or takes a lock.
+///
+/// One drainer at a time reads every ring in Drain(). A slot the writer is overwriting while the
+/// drainer reads it is detected through its sequence number and counted as lost rather than
+/// returned torn.
+///
+/// Nothing needs to poll the rings quickly: Write() says when a ring is filling up, and the caller
+/// wakes the drainer.
+class TraceRing {
+public:
+    /// Returns true when this event brought the calling thread's ring to TRACE_RING_FILL_MARK
+    /// pending events. That happens once each time the ring fills that far, and means the drainer
+    /// should run soon.
+    static bool Write(unsigned short eventId, const long long* args, unsigned short argCount);
+
+    /// Moves up to maxEvents pending events out of the rings, oldest first within each thread.
+    /// Events from different threads are not ordered against each other.
+    static size_t Drain(TraceEvent* events, size_t maxEvents);
+
+    static void SetOverflow(int mode);
+    static int Overflow();
+
+    // Events that were dropped, overwritten or read torn since the process started.
+    static unsigned long long Lost();
+
+    // Monotonic nanoseconds, the clock used for event timestamps.
+    static unsigned long long Now();
+
+private:
+    TraceRing();
+};
@@ -0,0 +1,1403 @@
+#include "ContentHash.h"
+#include "HotPathMetrics.h"
+#include "MemoryBudget.h"
+#include "ScanContext.h"
+#include "ScanScheduler.h"
+#include "TriggerScanner.h"
+#include "VerdictCache.h"
+#include "WarmStartSnapshot.h"
+#include "WorkPool.h"
+
+#include <atomic>
+#include <cstring>
+
+#define TOKEN_END 0
+#define TOKEN_WORD 1
+#define TOKEN_BREAK 2
+
+#define MODE_TEXT 0
+#define MODE_TAG 1
+#define MODE_ATTRIBUTE 2
+
+#define RAW_TEXT_NONE 0
+#define RAW_TEXT_SCRIPT 1
+#define RAW_TEXT_STYLE 2
+
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+// Phrase hashes are a polynomial over the word hashes, so the hash of every phrase ending at a word
+// can be built up one word at a time going backwards.
+#define PHRASE_HASH_BASE 0x9E3779B97F4A7C15ULL
+
+#define WORD_FILTER_BITS 20
+
+// How many tokens a chunk scans between checks for an earlier chunk having already matched.
+#define CANCEL_CHECK_INTERVAL 64
+
+// Content shorter than this is scanned without looking in the verdict cache, since hashing and
+// locking cost about as much as the scan.
+#define VERDICT_CACHE_MIN_LENGTH 256
+
+// Cached chunks are between 3/4 and 2 times the cache's chunk size long, cut where a rolling hash
+// of the bytes picks. An edit early in a page moves the cuts only until the hash is past it. The
+// hash only runs past the minimum, so a high minimum keeps it cheap on content that never repeats.
+#define VERDICT_CHUNK_SPREAD_DIVISOR 4
+#define VERDICT_CHUNK_MAX_MULTIPLE 2
+
+// Bytes after a cut that a chunk's fingerprint covers. The scan of a chunk reads on past the cut
+// to the next spot a chunk can start and to finish the phrases started before it, which has to
+// happen within this for the verdict to be cached.
+#define VERDICT_SEAM_BYTES 512
+
+// The tokenizer looks at most a few bytes past where it stops, to see how markup continues.
+#define VERDICT_READ_MARGIN 64
+
+// Keep whole documents, JSON documents and chunks with the same bytes apart.
+#define VERDICT_WHOLE_SEED 0x77686f6c65646f63ULL
+#define VERDICT_JSON_SEED 0x6a736f6e76616c73ULL
+
+// Epoch of a scanner with no triggers.
+#define EMPTY_EPOCH 0x656d707479736574ULL
+
+// Lowercased value of every byte that can be part of a word, zero for everything else.
+static const unsigned char wordCharacters[256] = {
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x2d, 0x2e, 0x00,
+    0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x61, 0x62, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x6b, 0x6c, 0x6d, 0x6e, 0x6f,
+    0x70, 0x71, 0x72, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x61, 0x62, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x6b, 0x6c, 0x6d, 0x6e, 0x6f,
+    0x70, 0x71, 0x72, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+
+static inline bool isSpace(unsigned char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\f';
+}
+
+static inline bool isAlpha(unsigned char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+static inline unsigned char toLower(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? (unsigned char)(c | 0x20) : c;
+}
+
+static bool equalsIgnoreCase(const unsigned char* data, size_t length, const char* lowered) {
+    size_t i = 0;
+    for (; i < length && lowered[i] != '\0'; i++) {
+        if (toLower(data[i]) != (unsigned char)lowered[i]) {
+            return false;
+        }
+    }
+
+    return i == length && lowered[i] == '\0';
+}
+
+static inline unsigned long long mixHash(unsigned long long h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// Random value for every byte, for the rolling hash that places chunk cuts.
+static const struct GearTable {
+    unsigned long long values[256];
+
+    GearTable() {
+        for (int i = 0; i < 256; i++) {
+            values[i] = mixHash(PHRASE_HASH_BASE * (unsigned long long)(i + 1));
+        }
+    }
+} gearTable;
+
+static const unsigned char* findByte(const unsigned char* data, size_t from, size_t length, unsigned char c) {
+    if (from >= length) {
+        return nullptr;
+    }
+
+    return (const unsigned char*)memchr(data + from, c, length - from);
+}
+
+namespace {
+    typedef struct Token {
+        int type;
+        size_t offset;
+        size_t length;
+        unsigned long long hash;
+    } Token;
+
+    /// Pull tokenizer over a whole document. It can start at any offset where a chunk may start
+    /// (see SkipTo), and produces from there exactly what a tokenizer started at zero would.
+    class Tokenizer {
+    public:
+        Tokenizer(const unsigned char* data, size_t length, size_t pos)
+            : data(data), length(length), pos(pos), mode(MODE_TEXT), attributeEnd(0), rawText(RAW_TEXT_NONE) {
+        }
+
+        int Next(Token& token);
+
+        /// Moves to the first offset at or after target that is in text, outside of a word. Returns
+        /// false if the document ends first.
+        bool SkipTo(size_t target);
+
+        size_t Position() const { return pos; }
+
+        // True where a chunk could start: in text, outside of a word.
+        bool AtChunkStart() const {
+            return mode == MODE_TEXT && pos < length &&
+                (pos == 0 || wordCharacters[data[pos]] == 0 || wordCharacters[data[pos - 1]] == 0);
+        }
+
+    private:
+        bool beginMarkup();
+        bool nextAttribute();
+        void skipRawText();
+
+        const unsigned char* data;
+        size_t length;
+        size_t pos;
+
+        int mode;
+        size_t attributeEnd;
+        int rawText;
+    };
+
+    int Tokenizer::Next(Token& token) {
+        for (;;) {
+            if (mode == MODE_TAG) {
+                size_t at = pos;
+                if (nextAttribute()) {
+                    token.type = TOKEN_BREAK;
+                    token.offset = at;
+                    return TOKEN_BREAK;
+                }
+
+                return TOKEN_END;
+            }
+
+            size_t limit = mode == MODE_ATTRIBUTE ? attributeEnd : length;
+
+            while (pos < limit) {
+                unsigned char c = data[pos];
+                if (wordCharacters[c] != 0) {
+                    break;
+                }
+
+                if (c == '"' || c == '\'' || c == '>') {
+                    token.type = TOKEN_BREAK;
+                    token.offset = pos++;
+                    return TOKEN_BREAK;
+                }
+
+                if (c == '<' && mode == MODE_TEXT) {
+                    size_t at = pos;
+                    if (beginMarkup()) {
+                        token.type = TOKEN_BREAK;
+                        token.offset = at;
+                        return TOKEN_BREAK;
+                    }
+
+                    continue;
+                }
+
+                pos++;
+            }
+
+            if (pos >= limit) {
+                if (mode != MODE_ATTRIBUTE) {
+                    return TOKEN_END;
+                }
+
+                // The closing quote ends the phrase like any other quote.
+                token.type = TOKEN_BREAK;
+                token.offset = pos;
+                pos = attributeEnd < length ? attributeEnd + 1 : length;
+                mode = MODE_TAG;
+                return TOKEN_BREAK;
+            }
+
+            size_t start = pos;
+            unsigned long long hash = FNV_OFFSET_BASIS;
+            unsigned char lowered;
+
+            while (pos < limit && (lowered = wordCharacters[data[pos]]) != 0) {
+                hash ^= lowered;
+                hash *= FNV_PRIME;
+                pos++;
+            }
+
+            token.type = TOKEN_WORD;
+            token.offset = start;
+            token.length = pos - start;
+            token.hash = mixHash(hash);
+            return TOKEN_WORD;
+        }
+    }
+
+    // Called at a '<' in text. Returns true if an opening tag started, which ends the current phrase.
+    bool Tokenizer::beginMarkup() {
+        size_t next = pos + 1;
+        if (next >= length) {
+            pos = length;
+            return false;
+        }
+
+        unsigned char c = data[next];
+
+        if (c == '!' && length - next >= 3 && data[next + 1] == '-' && data[next + 2] == '-') {
+            for (size_t i = next + 3; ; i++) {
+                const unsigned char* dash = findByte(data, i, length, '-');
+                if (dash == nullptr || (size_t)(dash - data) + 2 >= length) {
+                    pos = length;
+                    return false;
+                }
+
+                i = dash - data;
+                if (data[i + 1] == '-' && data[i + 2] == '>') {
+                    pos = i + 3;
+                    return false;
+                }
+            }
+        }
+
+        if (c == '/' || c == '!' || c == '?') {
+            // Closing tags, doctypes and processing instructions carry no text.
+            const unsigned char* close = findByte(data, next, length, '>');
+            pos = close != nullptr ? (size_t)(close - data) + 1 : length;
+            return false;
+        }
+
+        if (!isAlpha(c)) {
+            // A lone '<' is just punctuation.
+            pos = next;
+            return false;
+        }
+
+        size_t nameStart = next;
+        pos = next;
+        while (pos < length && (isAlpha(data[pos]) || (data[pos] >= '0' && data[pos] <= '9'))) {
+            pos++;
+        }
+
+        if (equalsIgnoreCase(data + nameStart, pos - nameStart, "script")) {
+            rawText = RAW_TEXT_SCRIPT;
+        }
+        else if (equalsIgnoreCase(data + nameStart, pos - nameStart, "style")) {
+            rawText = RAW_TEXT_STYLE;
+        }
+        else {
+            rawText = RAW_TEXT_NONE;
+        }
+
+        mode = MODE_TAG;
+        return true;
+    }
+
+    // Walks the attributes of an opening tag. Returns true when the tag ends or an alt, title or href
+    // value starts, both of which end the current phrase, and false if the document ends first.
+    bool Tokenizer::nextAttribute() {
+        while (pos < length) {
+            unsigned char c = data[pos];
+
+            if (c == '>') {
+                pos++;
+                mode = MODE_TEXT;
+
+                if (rawText != RAW_TEXT_NONE) {
+                    skipRawText();
+                }
+
+                return true;
+            }
+
+            if (isSpace(c) || c == '/' || c == '=') {
+                pos++;
+                continue;
+            }
+
+            size_t nameStart = pos;
+            while (pos < length && !isSpace(data[pos]) && data[pos] != '/' && data[pos] != '>' && data[pos] != '=') {
+                pos++;
+            }
+
+            size_t nameLength = pos - nameStart;
+            bool important = equalsIgnoreCase(data + nameStart, nameLength, "alt") ||
+                equalsIgnoreCase(data + nameStart, nameLength, "title") ||
+                equalsIgnoreCase(data + nameStart, nameLength, "href");
+
+            while (pos < length && isSpace(data[pos])) {
+                pos++;
+            }
+
+            if (pos >= length || data[pos] != '=') {
+                continue;
+            }
+
+            pos++;
+            while (pos < length && isSpace(data[pos])) {
+                pos++;
+            }
+
+            if (pos >= length) {
+                break;
+            }
+
+            c = data[pos];
+            if (c == '"' || c == '\'') {
+                const unsigned char* close = findByte(data, pos + 1, length, c);
+                size_t valueEnd = close != nullptr ? (size_t)(close - data) : length;
+
+                if (important) {
+                    mode = MODE_ATTRIBUTE;
+                    attributeEnd = valueEnd;
+                    pos++;
+                    return true;
+                }
+
+                pos = valueEnd < length ? valueEnd + 1 : length;
+            }
+            else {
+                // Unquoted values are never scanned, so they can't hold a phrase.
+                while (pos < length && !isSpace(data[pos]) && data[pos] != '>') {
+                    pos++;
+                }
+            }
+        }
+
+        pos = length;
+        mode = MODE_TEXT;
+        return false;
+    }
+
+    void Tokenizer::skipRawText() {
+        const char* closeName = rawText == RAW_TEXT_SCRIPT ? "script" : "style";
+        size_t closeNameLength = strlen(closeName);
+
+        rawText = RAW_TEXT_NONE;
+
+        for (;;) {
+            const unsigned char* open = findByte(data, pos, length, '<');
+            if (open == nullptr) {
+                pos = length;
+                return;
+            }
+
+            pos = (size_t)(open - data) + 1;
+
+            if (length - pos > closeNameLength + 1 && data[pos] == '/' &&
+                equalsIgnoreCase(data + pos + 1, closeNameLength, closeName) &&
+                wordCharacters[data[pos + 1 + closeNameLength]] == 0) {
+                const unsigned char* close = findByte(data, pos, length, '>');
+                pos = close != nullptr ? (size_t)(close - data) + 1 : length;
+                return;
+            }
+        }
+    }
+
+    bool Tokenizer::SkipTo(size_t target) {
+        while (pos < target || mode != MODE_TEXT) {
+            if (pos >= length) {
+                return false;
+            }
+
+            if (mode != MODE_TEXT) {
+                Token token;
+                if (Next(token) == TOKEN_END) {
+                    return false;
+                }
+
+                continue;
+            }
+
+            // Words and punctuation in text don't change the tokenizer's state, so only markup
+            // needs to be looked at on the way.
+            const unsigned char* open = findByte(data, pos, target, '<');
+            if (open == nullptr) {
+                pos = target;
+                break;
+            }
+
+            pos = (size_t)(open - data);
+            beginMarkup();
+        }
+
+        while (pos > 0 && pos < length && wordCharacters[data[pos]] != 0 && wordCharacters[data[pos - 1]] != 0) {
+            pos++;
+        }
+
+        return pos < length;
+    }
+}
+
+struct TriggerScanner::ChunkScan {
+    const TriggerScanner* scanner;
+    const unsigned char* data;
+    size_t length;
+    const TriggerScanOptions* options;
+
+    size_t* starts;
+    size_t chunks;
+
+    // Start offset of the earliest match found by any chunk so far. Chunks that begin after it
+    // can't do better and give up.
+    std::atomic<size_t> earliestMatch;
+
+    TriggerMatch* matches;
+    bool* found;
+};
+
+TriggerScanner::TriggerScanner() : longestTrigger(0), accounted(0), refusedTriggers(0) {
+    Clear();
+}
+
+TriggerScanner::~TriggerScanner() {
+    MemoryBudget::Release(MEMORY_TAG_TRIGGER_INDEX, accounted);
+}
+
+void TriggerScanner::Clear() {
+    // Swapped out rather than cleared, so that their memory goes back along with the charge.
+    std::vector<PhraseEntry>().swap(phrases);
+    std::vector<CategoryLink>().swap(categoryLinks);
+    std::vector<unsigned char>().swap(phraseText);
+    std::vector<short>().swap(categories);
+    std::vector<int>(1024, -1).swap(table);
+
+    wordFilter.assign(((size_t)1 << WORD_FILTER_BITS) / 64, 0);
+    knownCategories.assign(65536 / 8, 0);
+
+    longestTrigger = 0;
+    epoch = EMPTY_EPOCH;
+    refusedTriggers = 0;
+
+    // The empty index is always there, so it is charged whatever the budget says.
+    settle();
+}
+
+template <typename T>
+static size_t vectorBytes(const std::vector<T>& values) {
+    return values.capacity() * sizeof(T);
+}
+
+// Capacity a vector grows to when extra more values are pushed onto it one by one.
+template <typename T>
+static size_t grownCapacity(const std::vector<T>& values, size_t extra) {
+    size_t needed = values.size() + extra;
+    if (needed <= values.capacity()) {
+        return values.capacity();
+    }
+
+    return needed > values.capacity() * 2 ? needed : values.capacity() * 2;
+}
+
+size_t TriggerScanner::footprint() const {
+    return vectorBytes(phrases) + vectorBytes(categoryLinks) + vectorBytes(phraseText) + vectorBytes(table) +
+        vectorBytes(wordFilter) + vectorBytes(categories) + vectorBytes(knownCategories);
+}
+
+// Brings the charge in line with what the vectors really hold, which is what the budget reports.
+void TriggerScanner::settle() {
+    size_t bytes = footprint();
+
+    if (bytes > accounted) {
+        MemoryBudget::Charge(MEMORY_TAG_TRIGGER_INDEX, bytes - accounted);
+    }
+    else {
+        MemoryBudget::Release(MEMORY_TAG_TRIGGER_INDEX, accounted - bytes);
+    }
+
+    accounted = bytes;
+}
+
+// Charges and reserves everything one more trigger could grow, before any of it is touched.
+bool TriggerScanner::makeRoom(size_t textBytes, bool newPhrase) {
+    size_t links = grownCapacity(categoryLinks, 1);
+    size_t entries = newPhrase ? grownCapacity(phrases, 1) : phrases.capacity();
+    size_t text = newPhrase ? grownCapacity(phraseText, textBytes) : phraseText.capacity();
+    bool growsTable = newPhrase && (phrases.size() + 1) * 2 > table.size();
+
+    // Categories are a few dozen at most. They are left to settle().
+    size_t bytes = (links - categoryLinks.capacity()) * sizeof(CategoryLink) +
+        (entries - phrases.capacity()) * sizeof(PhraseEntry) +
+        (text - phraseText.capacity()) + (growsTable ? table.size() * sizeof(int) : 0);
+
+    if (bytes == 0) {
+        return true;
+    }
+
+    if (!MemoryBudget::TryCharge(MEMORY_TAG_TRIGGER_INDEX, bytes)) {
+        return false;
+    }
+
+    accounted += bytes;
+    categoryLinks.reserve(links);
+    phrases.reserve(entries);
+    phraseText.reserve(text);
+    return true;
+}
+
+bool TriggerScanner::mayBeInTrigger(unsigned long long wordHash) const {
+    size_t bit = (size_t)(wordHash >> (64 - WORD_FILTER_BITS));
+    return ((wordFilter[bit >> 6] >> (bit & 63)) & 1) != 0;
+}
+
+int TriggerScanner::findPhrase(unsigned long long hash, const unsigned char* data, const size_t* wordOffsets, const size_t* wordLengths, int words) const {
+    size_t mask = table.size() - 1;
+
+    for (size_t slot = (size_t)mixHash(hash) & mask; ; slot = (slot + 1) & mask) {
+        int index = table[slot];
+        if (index < 0) {
+            return -1;
+        }
+
+        const PhraseEntry& entry = phrases[index];
+        if (entry.hash != hash || entry.words != words) {
+            continue;
+        }
+
+        // Same hash, so compare the actual words to rule out a collision.
+        const unsigned char* text = &phraseText[entry.textOffset];
+        size_t t = 0;
+        bool same = true;
+
+        for (int w = 0; same && w < words; w++) {
+            if (w > 0 && (t >= entry.textLength || text[t++] != ' ')) {
+                same = false;
+                break;
+            }
+
+            const unsigned char* word = data + wordOffsets[w];
+            for (size_t i = 0; i < wordLengths[w]; i++) {
+                if (t >= entry.textLength || text[t++] != wordCharacters[word[i]]) {
+                    same = false;
+                    break;
+                }
+            }
+        }
+
+        if (same && t == entry.textLength) {
+            return index;
+        }
+    }
+}
+
+void TriggerScanner::growTable() {
+    std::vector<int>(table.size() * 2, -1).swap(table);
+    size_t mask = table.size() - 1;
+
+    for (size_t i = 0; i < phrases.size(); i++) {
+        size_t slot = (size_t)mixHash(phrases[i].hash) & mask;
+        while (table[slot] >= 0) {
+            slot = (slot + 1) & mask;
+        }
+
+        table[slot] = (int)i;
+    }
+}
+
+bool TriggerScanner::AddTrigger(const unsigned char* text, size_t length, short category) {
+    std::vector<size_t> offsets;
+    std::vector<size_t> lengths;
+    std::vector<unsigned long long> wordHashes;
+
+    // Triggers are plain text, so every byte that can't be in a word is a separator.
+    for (size_t pos = 0; pos < length; ) {
+        if (wordCharacters[text[pos]] == 0) {
+            pos++;
+            continue;
+        }
+
+        size_t start = pos;
+        unsigned long long hash = FNV_OFFSET_BASIS;
+        while (pos < length && wordCharacters[text[pos]] != 0) {
+            hash ^= wordCharacters[text[pos]];
+            hash *= FNV_PRIME;
+            pos++;
+        }
+
+        offsets.push_back(start);
+        lengths.push_back(pos - start);
+        wordHashes.push_back(mixHash(hash));
+    }
+
+    if (offsets.empty()) {
+        return false;
+    }
+
+    int words = (int)offsets.size();
+    unsigned long long phraseHash = 0;
+
+    for (int w = 0; w < words; w++) {
+        phraseHash = phraseHash * PHRASE_HASH_BASE + wordHashes[w];
+    }
+
+    int index = findPhrase(phraseHash, text, &offsets[0], &lengths[0], words);
+
+    size_t textBytes = words - 1;
+    for (int w = 0; w < words; w++) {
+        textBytes += lengths[w];
+    }
+
+    if (!makeRoom(textBytes, index < 0)) {
+        refusedTriggers++;
+        return false;
+    }
+
+    if (index < 0) {
+        PhraseEntry entry;
+        entry.hash = phraseHash;
+        entry.textOffset = phraseText.size();
+        entry.words = words;
+        entry.firstCategory = -1;
+
+        for (int w = 0; w < words; w++) {
+            if (w > 0) {
+                phraseText.push_back(' ');
+            }
+
+            for (size_t i = 0; i < lengths[w]; i++) {
+                phraseText.push_back(wordCharacters[text[offsets[w] + i]]);
+            }
+
+            size_t bit = (size_t)(wordHashes[w] >> (64 - WORD_FILTER_BITS));
+            wordFilter[bit >> 6] |= 1ULL << (bit & 63);
+        }
+
+        entry.textLength = phraseText.size() - entry.textOffset;
+
+        if ((phrases.size() + 1) * 2 > table.size()) {
+            growTable();
+        }
+
+        index = (int)phrases.size();
+        phrases.push_back(entry);
+
+        size_t mask = table.size() - 1;
+        size_t slot = (size_t)mixHash(phraseHash) & mask;
+        while (table[slot] >= 0) {
+            slot = (slot + 1) & mask;
+        }
+
+        table[slot] = index;
+
+        if (words > longestTrigger) {
+            longestTrigger = words;
+        }
+    }
+
+    // Categories keep the order they were loaded in, which decides which one is reported.
+    int* link = &phrases[index].firstCategory;
+    while (*link >= 0) {
+        if (categoryLinks[*link].category == category) {
+            return true;
+        }
+
+        link = &categoryLinks[*link].next;
+    }
+
+    CategoryLink added;
+    added.category = category;
+    added.next = -1;
+    *link = (int)categoryLinks.size();
+    categoryLinks.push_back(added);
+
+    unsigned short id = (unsigned short)category;
+    if ((knownCategories[id >> 3] & (1 << (id & 7))) == 0) {
+        knownCategories[id >> 3] |= (unsigned char)(1 << (id & 7));
+        categories.push_back(category);
+    }
+
+    epoch = mixHash(mixHash(epoch ^ phraseHash) ^ (unsigned long long)id);
+
+    settle();
+    return true;
+}
+
+bool TriggerScanner::HasCategory(short category) const {
+    unsigned short id = (unsigned short)category;
+    return (knownCategories[id >> 3] & (1 << (id & 7))) != 0;
+}
+
+namespace {
+    typedef struct TriggerSnapshotInfo {
+        unsigned long long epoch;
+        int longestTrigger;
+
+        // The filter is saved as is, so it only fits a scanner with the same number of buckets.
+        int wordFilterBits;
+    } TriggerSnapshotInfo;
+}
+
+template <typename T>
+static bool readSection(const WarmStartSnapshot& snapshot, unsigned int type, std::vector<T>& values) {
+    size_t length;
+    const unsigned char* data = snapshot.Section(type, &length);
+
+    if (data == NULL || length % sizeof(T) != 0) {
+        return false;
+    }
+
+    values.resize(length / sizeof(T));
+    if (length > 0) {
+        memcpy(&values[0], data, length);
+    }
+
+    return true;
+}
+
+template <typename T>
+static void addSection(WarmStartWriter* writer, unsigned int type, const std::vector<T>& values) {
+    writer->Add(type, values.empty() ? NULL : &values[0], values.size() * sizeof(T));
+}
+
+void TriggerScanner::Save(WarmStartWriter* writer) const {
+    TriggerSnapshotInfo info;
+    memset(&info, 0, sizeof(info));
+    info.epoch = epoch;
+    info.longestTrigger = longestTrigger;
+    info.wordFilterBits = WORD_FILTER_BITS;
+
+    writer->Add(WARM_START_SECTION_TRIGGER_INFO, &info, sizeof(info));
+    addSection(writer, WARM_START_SECTION_TRIGGER_PHRASES, phrases);
+    addSection(writer, WARM_START_SECTION_TRIGGER_LINKS, categoryLinks);
+    addSection(writer, WARM_START_SECTION_TRIGGER_TEXT, phraseText);
+    addSection(writer, WARM_START_SECTION_TRIGGER_TABLE, table);
+    addSection(writer, WARM_START_SECTION_TRIGGER_WORDS, wordFilter);
+    addSection(writer, WARM_START_SECTION_TRIGGER_CATEGORIES, categories);
+}
+
+int TriggerScanner::Restore(const WarmStartSnapshot& snapshot) {
+    Clear();
+
+    size_t infoLength;
+    const unsigned char* infoData = snapshot.Section(WARM_START_SECTION_TRIGGER_INFO, &infoLength);
+
+    TriggerSnapshotInfo info;
+    if (infoData == NULL || infoLength != sizeof(info)) {
+        return WARM_START_CORRUPT;
+    }
+
+    memcpy(&info, infoData, sizeof(info));
+
+    // The sections are copied in as they are, so they are all the room the index needs, less the
+    // empty table and the filter that they replace.
+    static const unsigned int sections[] = {
+        WARM_START_SECTION_TRIGGER_PHRASES, WARM_START_SECTION_TRIGGER_LINKS, WARM_START_SECTION_TRIGGER_TEXT,
+        WARM_START_SECTION_TRIGGER_TABLE, WARM_START_SECTION_TRIGGER_WORDS, WARM_START_SECTION_TRIGGER_CATEGORIES
+    };
+
+    size_t needed = 0;
+    for (size_t i = 0; i < sizeof(sections) / sizeof(sections[0]); i++) {
+        size_t length;
+        if (snapshot.Section(sections[i], &length) != NULL) {
+            needed += length;
+        }
+    }
+
+    size_t replaced = vectorBytes(table) + vectorBytes(wordFilter);
+    needed = needed > replaced ? needed - replaced : 0;
+
+    if (needed > 0 && !MemoryBudget::TryCharge(MEMORY_TAG_TRIGGER_INDEX, needed)) {
+        return WARM_START_OVER_BUDGET;
+    }
+
+    accounted += needed;
+
+    bool whole = info.wordFilterBits == WORD_FILTER_BITS && info.longestTrigger >= 0 &&
+        readSection(snapshot, WARM_START_SECTION_TRIGGER_PHRASES, phrases) &&
+        readSection(snapshot, WARM_START_SECTION_TRIGGER_LINKS, categoryLinks) &&
+        readSection(snapshot, WARM_START_SECTION_TRIGGER_TEXT, phraseText) &&
+        readSection(snapshot, WARM_START_SECTION_TRIGGER_TABLE, table) &&
+        readSection(snapshot, WARM_START_SECTION_TRIGGER_WORDS, wordFilter) &&
+        readSection(snapshot, WARM_START_SECTION_TRIGGER_CATEGORIES, categories);
+
+    // The checksums rule out damage, so these only catch a snapshot whose layout doesn't match the
+    // code, which would otherwise read out of bounds or loop forever.
+    whole = whole && wordFilter.size() == ((size_t)1 << WORD_FILTER_BITS) / 64 &&
+        table.size() >= 2 && (table.size() & (table.size() - 1)) == 0 && phrases.size() * 2 <= table.size();
+
+    for (size_t i = 0; whole && i < table.size(); i++) {
+        whole = table[i] >= -1 && table[i] < (int)phrases.size();
+    }
+
+    for (size_t i = 0; whole && i < phrases.size(); i++) {
+        const PhraseEntry& entry = phrases[i];
+
+        whole = entry.textOffset <= phraseText.size() && entry.textLength <= phraseText.size() - entry.textOffset &&
+            entry.words >= 1 && entry.words <= info.longestTrigger &&
+            entry.firstCategory >= -1 && entry.firstCategory < (int)categoryLinks.size();
+    }
+
+    // Links are only ever appended, so each one points further on and they can't form a cycle.
+    for (size_t i = 0; whole && i < categoryLinks.size(); i++) {
+        whole = categoryLinks[i].next == -1 || (categoryLinks[i].next > (int)i && categoryLinks[i].next < (int)categoryLinks.size());
+    }
+
+    for (size_t i = 0; whole && i < categories.size(); i++) {
+        unsigned short id = (unsigned short)categories[i];
+
+        whole = (knownCategories[id >> 3] & (1 << (id & 7))) == 0;
+        knownCategories[id >> 3] |= (unsigned char)(1 << (id & 7));
+    }
+
+    if (!whole) {
+        Clear();
+        return WARM_START_CORRUPT;
+    }
+
+    longestTrigger = info.longestTrigger;
+    epoch = info.epoch;
+
+    settle();
+    return WARM_START_LOADED;
+}
+
+const unsigned char* TriggerScanner::TriggerText(int trigger, size_t* length) const {
+    if (trigger < 0 || (size_t)trigger >= phrases.size()) {
+        *length = 0;
+        return nullptr;
+    }
+
+    *length = phrases[trigger].textLength;
+    return &phraseText[phrases[trigger].textOffset];
+}
+
+int TriggerScanner::enabledCategory(int phrase, const TriggerScanOptions& options) const {
+    for (int link = phrases[phrase].firstCategory; link >= 0; link = categoryLinks[link].next) {
+        short category = categoryLinks[link].category;
+        if (category < 0 || (size_t)(category >> 3) >= options.enabledCategoriesLength) {
+            continue;
+        }
+
+        if ((options.enabledCategories[category >> 3] >> (category & 7)) & 1) {
+            return category;
+        }
+    }
+
+    return -1;
+}
+
+// Finds the earliest match that starts at a word inside [begin, end). Words past end are read only as
+// far as a phrase starting inside the range could reach, which is the overlap between chunks.
+//
+// With an extent, end is only where to start looking for the end of the range: the range runs to
+// the first spot at or after it where a chunk could start, which goes in extent->next. That spot
+// depends on nothing before begin, so a chunk cached with it can be skipped without tokenizing.
+bool TriggerScanner::scanRange(const unsigned char* data, size_t length, size_t begin, size_t end, const TriggerScanOptions& options, ChunkScan* shared, TriggerMatch* match, RangeExtent* extent) const {
+    int maxWords = options.maxPhraseWords < 1 ? 1 : options.maxPhraseWords;
+    if (maxWords > longestTrigger) {
+        maxWords = longestTrigger;
+    }
+
+    ScanScope scope;
+
+    // The current run of words that could all be in a trigger, oldest first.
+    size_t* offsets = scope.Allocate<size_t>(maxWords);
+    size_t* lengths = scope.Allocate<size_t>(maxWords);
+    unsigned long long* wordHashes = scope.Allocate<unsigned long long>(maxWords);
+    unsigned long long* phraseHashes = scope.Allocate<unsigned long long>(maxWords);
+    int run = 0;
+
+    Tokenizer tokenizer(data, length, begin);
+    Token token;
+
+    size_t word = 0;
+    size_t matchWord = 0;
+    bool found = false;
+    int untilCancelCheck = CANCEL_CHECK_INTERVAL;
+
+    // Where the range ends, once it's known.
+    size_t limit = extent != nullptr ? (size_t)-1 : end;
+
+    while (tokenizer.Next(token) != TOKEN_END) {
+        if (shared != nullptr && --untilCancelCheck == 0) {
+            untilCancelCheck = CANCEL_CHECK_INTERVAL;
+            if (shared->earliestMatch.load(std::memory_order_relaxed) < begin) {
+                return false;
+            }
+        }
+
+        // The token just read ends at or before the cut, so it's still in the range.
+        if (limit == (size_t)-1 && tokenizer.Position() >= end && tokenizer.AtChunkStart()) {
+            limit = tokenizer.Position();
+        }
+
+        bool owned = token.offset < limit;
+
+        if (token.type == TOKEN_BREAK || !mayBeInTrigger(token.hash)) {
+            // No phrase runs through this token, so nothing that starts later can beat a match
+            // already found, and nothing started inside the range can still be completed.
+            if (found || !owned) {
+                break;
+            }
+
+            if (token.type == TOKEN_WORD) {
+                word++;
+            }
+
+            run = 0;
+            continue;
+        }
+
+        if (run == maxWords) {
+            for (int i = 1; i < run; i++) {
+                offsets[i - 1] = offsets[i];
+                lengths[i - 1] = lengths[i];
+                wordHashes[i - 1] = wordHashes[i];
+            }
+
+            run--;
+        }
+
+        offsets[run] = token.offset;
+        lengths[run] = token.length;
+        wordHashes[run] = token.hash;
+        run++;
+
+        size_t oldestWord = word + 1 - run;
+        word++;
+
+        if (offsets[0] >= limit || (found && oldestWord > matchWord)) {
+            break;
+        }
+
+        unsigned long long hash = 0;
+        unsigned long long power = 1;
+        for (int words = 1; words <= run; words++) {
+            hash += wordHashes[run - words] * power;
+            power *= PHRASE_HASH_BASE;
+            phraseHashes[words - 1] = hash;
+        }
+
+        // Longest first, so the first hit is the earliest starting phrase that ends here.
+        for (int words = run; words >= 1; words--) {
+            int first = run - words;
+            if (offsets[first] >= limit) {
+                continue;
+            }
+
+            if (found && offsets[first] >= match->offset) {
+                break;
+            }
+
+            int phrase = findPhrase(phraseHashes[words - 1], data, &offsets[first], &lengths[first], words);
+            if (phrase < 0) {
+                continue;
+            }
+
+            int category = enabledCategory(phrase, options);
+            if (category < 0) {
+                continue;
+            }
+
+            match->category = (short)category;
+            match->trigger = phrase;
+            match->offset = offsets[first];
+            match->length = offsets[run - 1] + lengths[run - 1] - offsets[first];
+            matchWord = oldestWord + first;
+            found = true;
+
+            if (shared != nullptr) {
+                size_t earliest = shared->earliestMatch.load(std::memory_order_relaxed);
+                while (match->offset < earliest && !shared->earliestMatch.compare_exchange_weak(earliest, match->offset, std::memory_order_relaxed)) {
+                }
+            }
+
+            break;
+        }
+    }
+
+    if (extent != nullptr) {
+        extent->next = limit < length ? limit : length;
+        extent->reach = tokenizer.Position();
+    }
+
+    return found;
+}
+
+void TriggerScanner::scanChunk(void* context, size_t index) {
+    ChunkScan* scan = static_cast<ChunkScan*>(context);
+
+    size_t begin = scan->starts[index];
+    size_t end = index + 1 < scan->chunks ? scan->starts[index + 1] : scan->length;
+
+    if (scan->earliestMatch.load(std::memory_order_relaxed) < begin) {
+        return;
+    }
+
+    scan->found[index] = scan->scanner->scanRange(scan->data, scan->length, begin, end, *scan->options, scan, &scan->matches[index], nullptr);
+}
+
+size_t TriggerScanner::PlanChunks(const unsigned char* data, size_t length, size_t chunkSize, size_t* starts, size_t maxStarts) {
+    if (maxStarts == 0) {
+        return 0;
+    }
+
+    size_t count = 0;
+    starts[count++] = 0;
+
+    if (chunkSize == 0 || length <= chunkSize) {
+        return count;
+    }
+
+    // Chunks may only start in text and between words. Finding those spots means following the
+    // markup from the top, which is much cheaper than tokenizing since text is skipped with memchr.
+    Tokenizer tokenizer(data, length, 0);
+
+    for (size_t target = chunkSize; target < length && count < maxStarts; target = tokenizer.Position() + chunkSize) {
+        if (!tokenizer.SkipTo(target)) {
+            break;
+        }
+
+        starts[count++] = tokenizer.Position();
+    }
+
+    return count;
+}
+
+bool TriggerScanner::Scan(const unsigned char* data, size_t length, const TriggerScanOptions& options, TriggerMatch* match) const {
+    if (phrases.empty() || length == 0) {
+        return false;
+    }
+
+    ScanContext::Current().CountScan();
+
+    bool parallel = options.pool != nullptr && options.parallelThreshold > 0 && options.chunkSize > 0 &&
+        length > options.parallelThreshold;
+
+    if (options.cache != nullptr && length >= VERDICT_CACHE_MIN_LENGTH) {
+        if (parallel) {
+            // Cached chunks are only found one after the other, which would serialize the scan, so
+            // content this big is only looked up whole.
+            return scanWhole(data, length, options, cacheSeed(options) ^ VERDICT_WHOLE_SEED, false, match);
+        }
+
+        return scanCached(data, length, 0, length, options, match, nullptr);
+    }
+
+    if (!parallel) {
+        return scanRange(data, length, 0, length, options, nullptr, match, nullptr);
+    }
+
+    return scanParallel(data, length, options, match);
+}
+
+bool TriggerScanner::scanParallel(const unsigned char* data, size_t length, const TriggerScanOptions& options, TriggerMatch* match) const {
+    ScanScope scope;
+
+    // Every chunk but the last is at least chunkSize long.
+    size_t maxChunks = length / options.chunkSize + 1;
+
+    ChunkScan scan;
+    scan.scanner = this;
+    scan.data = data;
+    scan.length = length;
+    scan.options = &options;
+    scan.earliestMatch = (size_t)-1;
+
+    scan.starts = scope.Allocate<size_t>(maxChunks);
+    scan.chunks = PlanChunks(data, length, options.chunkSize, scan.starts, maxChunks);
+
+    if (scan.chunks < 2) {
+        return scanRange(data, length, 0, length, options, nullptr, match, nullptr);
+    }
+
+    scan.matches = scope.Allocate<TriggerMatch>(scan.chunks);
+    scan.found = scope.Allocate<bool>(scan.chunks);
+    for (size_t i = 0; i < scan.chunks; i++) {
+        scan.found[i] = false;
+    }
+
+    options.pool->ParallelFor(scan.chunks, scanChunk, &scan);
+
+    // Chunks don't overlap in where their matches start, and the first one with a match has the
+    // earliest.
+    for (size_t i = 0; i < scan.chunks; i++) {
+        if (scan.found[i]) {
+            *match = scan.matches[i];
+            return true;
+        }
+    }
+
+    return false;
+}
+
+unsigned long long TriggerScanner::cacheSeed(const TriggerScanOptions& options) const {
+    int maxWords = options.maxPhraseWords < 1 ? 1 : options.maxPhraseWords;
+    if (maxWords > longestTrigger) {
+        maxWords = longestTrigger;
+    }
+
+    // Trailing zero bytes don't enable anything, so bitmaps that only differ in them are equal.
+    size_t used = options.enabledCategoriesLength;
+    while (used > 0 && options.enabledCategories[used - 1] == 0) {
+        used--;
+    }
+
+    unsigned long long seed = mixHash(epoch ^ mixHash((unsigned long long)maxWords));
+    return HashContent(options.enabledCategories, used, seed).low;
+}
+
+// Where to start looking for the end of the chunk that starts at begin: the first byte past the
+// minimum length where a rolling hash of the bytes up to it has no bits of mask set.
+static size_t findCut(const unsigned char* data, size_t length, size_t begin, size_t minimum, size_t maximum, unsigned long long mask) {
+    if (length - begin <= minimum) {
+        return length;
+    }
+
+    size_t limit = length - begin > maximum ? begin + maximum : length;
+    size_t pos = begin + minimum;
+
+    // Every byte shifts the older ones up by one, so only the last 64 are left in the hash and
+    // the bytes before them don't need to be hashed at all.
+    unsigned long long gear = 0;
+    for (size_t i = minimum > 64 ? pos - 64 : begin; i < pos; i++) {
+        gear = (gear << 1) + gearTable.values[data[i]];
+    }
+
+    for (; pos < limit; pos++) {
+        gear = (gear << 1) + gearTable.values[data[pos]];
+        if ((gear & mask) == 0) {
+            return pos + 1;
+        }
+    }
+
+    return limit;
+}
+
+bool TriggerScanner::scanCached(const unsigned char* data, size_t length, size_t begin, size_t end, const TriggerScanOptions& options, TriggerMatch* match, size_t* next) const {
+    VerdictCache* cache = options.cache;
+    unsigned long long seed = cacheSeed(options);
+
+    size_t chunkSize = cache->ChunkSize();
+    size_t minimum = chunkSize - chunkSize / VERDICT_CHUNK_SPREAD_DIVISOR;
+    size_t maximum = chunkSize * VERDICT_CHUNK_MAX_MULTIPLE;
+
+    if (minimum == 0) {
+        minimum = 1;
+    }
+
+    // One cut per (chunkSize - minimum) bytes past the minimum, on average.
+    unsigned long long mask = 1;
+    while (mask * 2 <= chunkSize - minimum) {
+        mask *= 2;
+    }
+
+    mask--;
+
+    size_t looked = 0;
+    size_t hits = 0;
+    size_t skipped = 0;
+    bool found = false;
+
+    while (begin < end && !found) {
+        size_t cut = findCut(data, length, begin, minimum, maximum, mask);
+        size_t covered = length - cut > VERDICT_SEAM_BYTES ? cut + VERDICT_SEAM_BYTES : length;
+
+        ContentHash key = HashContent(data + begin, covered - begin, seed ^ mixHash(cut - begin));
+        looked++;
+
+        CachedVerdict verdict;
+        if (cache->Find(key, &verdict)) {
+            hits++;
+            skipped += verdict.next;
+
+            if (verdict.found) {
+                match->category = verdict.category;
+                match->trigger = verdict.trigger;
+                match->offset = begin + verdict.offset;
+                match->length = verdict.length;
+                found = true;
+            }
+
+            begin += verdict.next;
+            continue;
+        }
+
+        RangeExtent extent;
+        found = scanRange(data, length, begin, cut, options, nullptr, match, &extent);
+
+        // A scan that read past what the fingerprint covers could come out differently next time.
+        if ((covered == length || extent.reach + VERDICT_READ_MARGIN <= covered) && extent.next - begin <= 0xFFFFFFFFU) {
+            memset(&verdict, 0, sizeof(verdict));
+            verdict.found = found;
+            verdict.next = (unsigned int)(extent.next - begin);
+
+            if (found) {
+                verdict.category = match->category;
+                verdict.trigger = match->trigger;
+                verdict.offset = (unsigned int)(match->offset - begin);
+                verdict.length = (unsigned int)match->length;
+            }
+
+            cache->Insert(key, verdict);
+        }
+
+        begin = extent.next;
+    }
+
+    HotPathMetrics::Add(HOT_PATH_VERDICT_HITS, hits);
+    HotPathMetrics::Add(HOT_PATH_VERDICT_MISSES, looked - hits);
+
+    if (skipped > 0) {
+        HotPathMetrics::Add(HOT_PATH_VERDICT_BYTES_SKIPPED, skipped);
+        cache->CountSkipped(skipped);
+    }
+
+    if (next != nullptr) {
+        *next = begin;
+    }
+
+    return found;
+}
+
+bool TriggerScanner::scanWhole(const unsigned char* data, size_t length, const TriggerScanOptions& options, unsigned long long seed, bool json, TriggerMatch* match) const {
+    VerdictCache* cache = options.cache;
+    ContentHash key = HashContent(data, length, seed);
+
+    CachedVerdict verdict;
+    if (cache->Find(key, &verdict)) {
+        HotPathMetrics::Add(HOT_PATH_VERDICT_HITS, 1);
+        HotPathMetrics::Add(HOT_PATH_VERDICT_BYTES_SKIPPED, length);
+        cache->CountSkipped(length);
+
+        if (!verdict.found) {
+            return false;
+        }
+
+        match->category = verdict.category;
+        match->trigger = verdict.trigger;
+        match->offset = verdict.offset;
+        match->length = verdict.length;
+        return true;
+    }
+
+    HotPathMetrics::Add(HOT_PATH_VERDICT_MISSES, 1);
+
+    bool found;
+
+    if (json) {
+        // Values are separated by a quote so that a phrase can't run from one into the next.
+        const std::vector<unsigned char>& text = ScanContext::Current().ExtractJson(data, length);
+        found = !text.empty() && Scan(text.data(), text.size(), options, match);
+    }
+    else {
+        found = scanParallel(data, length, options, match);
+    }
+
+    if (!found || match->offset + match->length <= 0xFFFFFFFFU) {
+        memset(&verdict, 0, sizeof(verdict));
+        verdict.found = found;
+
+        if (found) {
+            verdict.category = match->category;
+            verdict.trigger = match->trigger;
+            verdict.offset = (unsigned int)match->offset;
+            verdict.length = (unsigned int)match->length;
+        }
+
+        cache->Insert(key, verdict);
+    }
+
+    return found;
+}
+
+bool TriggerScanner::ScanJsonStrings(const unsigned char* data, size_t length, const TriggerScanOptions& options, TriggerMatch* match) const {
+    if (phrases.empty() || length == 0) {
+        return false;
+    }
+
+    if (options.cache != nullptr && length >= VERDICT_CACHE_MIN_LENGTH) {
+        return scanWhole(data, length, options, cacheSeed(options) ^ VERDICT_JSON_SEED, true, match);
+    }
+
+    const std::vector<unsigned char>& text = ScanContext::Current().ExtractJson(data, length);
+    return !text.empty() && Scan(text.data(), text.size(), options, match);
+}
+
+struct TriggerScanner::PartScan {
+    const TriggerScanner* scanner;
+    const unsigned char* data;
+    size_t length;
+    bool json;
+    const TriggerScanOptions* options;
+    TriggerMatch* match;
+};
+
+bool TriggerScanner::scanPart(void* context, size_t begin, size_t end, size_t* next) {
+    PartScan* part = static_cast<PartScan*>(context);
+    const TriggerScanner* self = part->scanner;
+    const TriggerScanOptions& options = *part->options;
+
+    // Content that fits in one part is scanned like any other, so it still gets looked up whole.
+    if (begin == 0 && end >= part->length) {
+        *next = part->length;
+
+        if (part->json) {
+            return self->ScanJsonStrings(part->data, part->length, options, part->match);
+        }
+
+        return self->Scan(part->data, part->length, options, part->match);
+    }
+
+    if (begin == 0) {
+        ScanContext::Current().CountScan();
+    }
+
+    if (options.cache != nullptr && part->length >= VERDICT_CACHE_MIN_LENGTH) {
+        return self->scanCached(part->data, part->length, begin, end, options, part->match, next);
+    }
+
+    RangeExtent extent;
+    bool found = self->scanRange(part->data, part->length, begin, end, options, nullptr, part->match, &extent);
+
+    *next = extent.next;
+    return found;
+}
+
+int TriggerScanner::ScanScheduled(const unsigned char* data, size_t length, bool jsonStrings, const TriggerScanOptions& options, ScanScheduler* scheduler, int priority, TriggerMatch* match) const {
+    if (phrases.empty() || length == 0) {
+        return SCAN_OUTCOME_CLEAN;
+    }
+
+    TriggerScanOptions sequential = options;
+    sequential.pool = nullptr;
+
+    PartScan part;
+    part.scanner = this;
+    part.data = data;
+    part.length = length;
+    part.json = jsonStrings;
+    part.options = &sequential;
+    part.match = match;
+
+    // Parts have to be cut in the text that is scanned, so a document bigger than one part has its
+    // values extracted before it is scheduled.
+    size_t headBytes = scheduler->Limits().headBytes;
+
+    if (jsonStrings && headBytes > 0 && length > headBytes) {
+        const std::vector<unsigned char>& text = ScanContext::Current().ExtractJson(data, length);
+
+        if (text.empty()) {
+            return SCAN_OUTCOME_CLEAN;
+        }
+
+        part.data = text.data();
+        part.length = text.size();
+        part.json = false;
+    }
+
+    return scheduler->Run(part.length, priority, scanPart, &part);
+}
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+class ScanScheduler;
+class VerdictCache;
+class WarmStartSnapshot;
+class WarmStartWriter;
+class WorkPool;
+
+typedef struct TriggerMatch {
+    short category;
+
+    // Index of the matched trigger, for TriggerScanner::TriggerText().
+    int trigger;
+
+    // Byte range of the matching words within the scanned content.
+    size_t offset;
+    size_t length;
+} TriggerMatch;
+
+typedef struct TriggerScanOptions {
+    // Bitmap of enabled category ids, bit (id & 7) of byte (id >> 3). Ids past the end are disabled.
+    const unsigned char* enabledCategories;
+    size_t enabledCategoriesLength;
+
+    // Longest phrase, in words, to look for. Anything below 1 means single words only.
+    int maxPhraseWords;
+
+    // Content longer than parallelThreshold is cut into chunks of about chunkSize bytes that are
+    // scanned on pool. A zero threshold or a null pool scans everything on the calling thread.
+    size_t parallelThreshold;
+    size_t chunkSize;
+    WorkPool* pool;
+
+    // Verdicts of content scanned before, by fingerprint, or NULL to scan everything.
+    VerdictCache* cache;
+} TriggerScanOptions;
+
+/// In-memory index of text triggers that scans UTF-8 content in place.
+///
+/// Content is split into lowercase words of [a-z0-9.-] the same way BagOfTextTriggers does it.
+/// Quotes, '>' and opening tags end a phrase, closing tags are skipped, script and style bodies are
+/// ignored and only the alt, title and href attributes are read from inside tags.
+///
+/// When several triggers match, the one that starts earliest wins (the shortest, if they start at
+/// the same word), so a chunked scan always reports the same match as a sequential one.
+///
+/// With a verdict cache, content is fingerprinted in chunks that are cut where the bytes pick, and
+/// only chunks that weren't seen before are scanned. A chunk's fingerprint covers its bytes and the
+/// few after it that its scan reads, so a cached verdict is exactly what scanning it again would
+/// give. Content big enough to be scanned in parallel is only fingerprinted whole.
+///
+/// Adding triggers must not overlap with scans. Any number of scans can run at once. Scans take
+/// their scratch memory from the calling thread's ScanContext, so they don't touch the heap once
+/// the thread has warmed up.
+///
+/// The index is charged to MEMORY_TAG_TRIGGER_INDEX. Room for a trigger is charged before any of
+/// it is added, so a trigger the budget can't take is left out whole and the index stays usable.
+class TriggerScanner {
+public:
+    TriggerScanner();
+    ~TriggerScanner();
+
+    /// Adds one trigger line. Returns false if the line has no words in it, or if the memory
+    /// budget has no room for it. Adding a trigger that is already indexed under another category
+    /// makes it match for both, first category first.
+    bool AddTrigger(const unsigned char* text, size_t length, short category);
+
+    void Clear();
+
+    size_t TriggerCount() const { return phrases.size(); }
+
+    // Triggers left out since the last Clear() because the memory budget had no room for them.
+    size_t RefusedTriggers() const { return refusedTriggers; }
+
+    // Number of words in the longest trigger.
+    int LongestTrigger() const { return longestTrigger; }
+
+    // Every category that has at least one trigger, in the order they were first added.
+    const std::vector<short>& Categories() const { return categories; }
+
+    bool HasCategory(short category) const;
+
+    // Normalized trigger text: words lowercased and separated by single spaces.
+    const unsigned char* TriggerText(int trigger, size_t* length) const;
+
+    bool Scan(const unsigned char* data, size_t length, const TriggerScanOptions& options, TriggerMatch* match) const;
+
+    /// Scans the string values of a JSON document, as extracted by ScanContext::ExtractJson(). The
+    /// match is within the extracted text. With a verdict cache, a document seen before is looked
+    /// up by its fingerprint and not even extracted.
+    bool ScanJsonStrings(const unsigned char* data, size_t length, const TriggerScanOptions& options, TriggerMatch* match) const;
+
+    /// Scans content, or the string values of a JSON document, a part at a time as the scheduler
+    /// admits them, and returns a SCAN_OUTCOME_*. Parts are scanned on the calling thread, never on
+    /// options.pool, since the scheduler's slots are what bound the scanning done at once.
+    int ScanScheduled(const unsigned char* data, size_t length, bool jsonStrings, const TriggerScanOptions& options, ScanScheduler* scheduler, int priority, TriggerMatch* match) const;
+
+    /// Adds the index to a snapshot, laid out as it is in memory.
+    void Save(WarmStartWriter* writer) const;
+
+    /// Replaces the index with the one in a snapshot, without hashing a single trigger. Returns
+    /// WARM_START_LOADED, or leaves the index empty and returns WARM_START_CORRUPT if the snapshot
+    /// has no index or its index doesn't hold together, or WARM_START_OVER_BUDGET if the memory
+    /// budget has no room for it.
+    int Restore(const WarmStartSnapshot& snapshot);
+
+    /// Chunk start offsets that a parallel scan of this content would use, at most maxStarts of
+    /// them. Returns how many were written. Exposed so that the chunking can be checked against a
+    /// sequential scan.
+    static size_t PlanChunks(const unsigned char* data, size_t length, size_t chunkSize, size_t* starts, size_t maxStarts);
+
+    struct ChunkScan;
+
+private:
+    TriggerScanner(const TriggerScanner&);
+    TriggerScanner& operator=(const TriggerScanner&);
+
+    typedef struct PhraseEntry {
+        unsigned long long hash;
+        size_t textOffset;
+        size_t textLength;
+        int words;
+
+        // Head of this phrase's list in categoryLinks.
+        int firstCategory;
+    } PhraseEntry;
+
+    typedef struct CategoryLink {
+        short category;
+        int next;
+    } CategoryLink;
+
+    int findPhrase(unsigned long long hash, const unsigned char* data, const size_t* wordOffsets, const size_t* wordLengths, int words) const;
+    int enabledCategory(int phrase, const TriggerScanOptions& options) const;
+    bool mayBeInTrigger(unsigned long long wordHash) const;
+    void growTable();
+
+    bool makeRoom(size_t textBytes, bool newPhrase);
+    size_t footprint() const;
+    void settle();
+
+    typedef struct RangeExtent {
+        // Where the next chunk starts.
+        size_t next;
+
+        // Where the tokenizer stopped. Nothing much past it was read.
+        size_t reach;
+    } RangeExtent;
+
+    bool scanRange(const unsigned char* data, size_t length, size_t begin, size_t end, const TriggerScanOptions& options, ChunkScan* shared, TriggerMatch* match, RangeExtent* extent) const;
+    static void scanChunk(void* context, size_t index);
+    bool scanParallel(const unsigned char* data, size_t length, const TriggerScanOptions& options, TriggerMatch* match) const;
+
+    bool scanCached(const unsigned char* data, size_t length, size_t begin, size_t end, const TriggerScanOptions& options, TriggerMatch* match, size_t* next) const;
+    bool scanWhole(const unsigned char* data, size_t length, const TriggerScanOptions& options, unsigned long long seed, bool json, TriggerMatch* match) const;
+    unsigned long long cacheSeed(const TriggerScanOptions& options) const;
+
+    struct PartScan;
+    static bool scanPart(void* context, size_t begin, size_t end, size_t* next);
+
+    std::vector<PhraseEntry> phrases;
+    std::vector<CategoryLink> categoryLinks;
+    std::vector<unsigned char> phraseText;
+
+    // Open addressing table of indexes into phrases, -1 for empty slots.
+    std::vector<int> table;
+
+    // One bit per word hash bucket, set for every word that appears in some trigger. Words that
+    // miss here can't be part of a match, which is most of them.
+    std::vector<unsigned long long> wordFilter;
+
+    std::vector<short> categories;
+
+    // One bit per possible category id, to keep categories free of duplicates.
+    std::vector<unsigned char> knownCategories;
+
+    int longestTrigger;
+
+    // Hash of every trigger added, in order, so that verdicts cached for other triggers never
+    // match. Scanners given the same lists get the same epoch, in any process, which is what lets
+    // verdicts cached by one be saved and used by the next.
+    unsigned long long epoch;
+
+    // Bytes charged to the memory budget.
+    size_t accounted;
+    size_t refusedTriggers;
+};
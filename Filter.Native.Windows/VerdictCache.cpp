@@ -0,0 +1,511 @@
+#include "MemoryBudget.h"
+#include "VerdictCache.h"
+#include "WarmStartSnapshot.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+// Power of two. Picked by the top bits of the fingerprint.
+#define VERDICT_CACHE_SHARD_BITS 4
+#define VERDICT_CACHE_SHARDS (1 << VERDICT_CACHE_SHARD_BITS)
+
+#define VERDICT_CACHE_MIN_SHARD_ENTRIES 8
+
+// Share of each shard's entries that is kept for the probation queue, in percent.
+#define VERDICT_CACHE_SMALL_PERCENT 10
+
+// Lookups an entry can bank while queued. Each one buys it another pass through the main queue.
+#define VERDICT_CACHE_MAX_FREQUENCY 3
+
+#define QUEUE_NONE 0
+#define QUEUE_SMALL 1
+#define QUEUE_MAIN 2
+
+namespace {
+    typedef struct VerdictSnapshotInfo {
+        unsigned long long chunkSize;
+        unsigned long long count;
+    } VerdictSnapshotInfo;
+
+    typedef struct Entry {
+        ContentHash key;
+        CachedVerdict verdict;
+        unsigned char frequency;
+        unsigned char queue;
+    } Entry;
+
+    // FIFO of entry indexes over a fixed ring.
+    class Queue {
+    public:
+        Queue() : head(0), count(0) {
+        }
+
+        void Reset(size_t capacity) {
+            slots.assign(capacity, -1);
+            head = 0;
+            count = 0;
+        }
+
+        void Push(int index) {
+            slots[(head + count) % slots.size()] = index;
+            count++;
+        }
+
+        int Pop() {
+            int index = slots[head];
+            head = (head + 1) % slots.size();
+            count--;
+            return index;
+        }
+
+        void Clear() {
+            head = 0;
+            count = 0;
+        }
+
+        size_t Count() const { return count; }
+        size_t MemoryBytes() const { return slots.capacity() * sizeof(int); }
+
+    private:
+        std::vector<int> slots;
+        size_t head;
+        size_t count;
+    };
+
+    class Shard {
+    public:
+        void Reset(size_t capacity);
+        void Clear();
+
+        bool Find(const ContentHash& key, CachedVerdict* verdict);
+        void Insert(const ContentHash& key, const CachedVerdict& verdict, bool proven);
+
+        // Appends every cached entry, with how hot it is.
+        void Collect(std::vector<std::pair<int, VerdictCacheEntry> >& collected) const;
+
+        size_t MemoryBytes() const;
+
+        std::mutex lock;
+
+        unsigned long long lookups;
+        unsigned long long hits;
+        unsigned long long inserts;
+        unsigned long long evictions;
+        unsigned long long ghostHits;
+
+    private:
+        size_t homeSlot(const ContentHash& key) const { return (size_t)key.low & (table.size() - 1); }
+        size_t ghostSlot(const ContentHash& key) const { return (size_t)key.high & (ghosts.size() - 1); }
+        static unsigned long long ghostTag(const ContentHash& key) { return key.low | 1; }
+
+        // Slot in table that holds key, or table.size() if it isn't cached.
+        size_t findSlot(const ContentHash& key) const;
+        void unlink(size_t slot);
+        void evict();
+        void remove(int index);
+
+        std::vector<Entry> entries;
+
+        // Open addressing index into entries, -1 for empty slots. Kept at most half full.
+        std::vector<int> table;
+
+        std::vector<int> freeEntries;
+
+        Queue small;
+        Queue main;
+        size_t smallTarget;
+
+        // Direct mapped fingerprints recently evicted from the small queue. Losing one to a
+        // collision only means its next insert starts on probation again.
+        std::vector<unsigned long long> ghosts;
+    };
+
+    void Shard::Reset(size_t capacity) {
+        entries.resize(capacity);
+
+        size_t tableSize = 1;
+        while (tableSize < capacity * 2) {
+            tableSize <<= 1;
+        }
+
+        table.resize(tableSize);
+
+        size_t ghostSize = 1;
+        while (ghostSize < capacity) {
+            ghostSize <<= 1;
+        }
+
+        ghosts.resize(ghostSize);
+
+        freeEntries.reserve(capacity);
+        small.Reset(capacity);
+        main.Reset(capacity);
+
+        smallTarget = capacity * VERDICT_CACHE_SMALL_PERCENT / 100;
+        if (smallTarget == 0) {
+            smallTarget = 1;
+        }
+
+        Clear();
+    }
+
+    void Shard::Clear() {
+        table.assign(table.size(), -1);
+        ghosts.assign(ghosts.size(), 0);
+        small.Clear();
+        main.Clear();
+
+        freeEntries.clear();
+        for (size_t i = entries.size(); i > 0; i--) {
+            entries[i - 1].queue = QUEUE_NONE;
+            freeEntries.push_back((int)(i - 1));
+        }
+
+        lookups = 0;
+        hits = 0;
+        inserts = 0;
+        evictions = 0;
+        ghostHits = 0;
+    }
+
+    size_t Shard::findSlot(const ContentHash& key) const {
+        size_t mask = table.size() - 1;
+
+        for (size_t slot = homeSlot(key); ; slot = (slot + 1) & mask) {
+            int index = table[slot];
+            if (index < 0) {
+                return table.size();
+            }
+
+            if (entries[index].key == key) {
+                return slot;
+            }
+        }
+    }
+
+    // Empties a table slot, shifting later entries of the same probe run back so that lookups
+    // never stop short of them.
+    void Shard::unlink(size_t slot) {
+        size_t mask = table.size() - 1;
+        size_t hole = slot;
+
+        for (size_t next = (hole + 1) & mask; table[next] >= 0; next = (next + 1) & mask) {
+            size_t home = homeSlot(entries[table[next]].key);
+
+            if (((next - home) & mask) >= ((next - hole) & mask)) {
+                table[hole] = table[next];
+                hole = next;
+            }
+        }
+
+        table[hole] = -1;
+    }
+
+    void Shard::remove(int index) {
+        unlink(findSlot(entries[index].key));
+        entries[index].queue = QUEUE_NONE;
+        freeEntries.push_back(index);
+        evictions++;
+    }
+
+    // Frees exactly one entry.
+    void Shard::evict() {
+        for (;;) {
+            if (small.Count() > 0 && (small.Count() >= smallTarget || main.Count() == 0)) {
+                int index = small.Pop();
+                Entry& entry = entries[index];
+
+                if (entry.frequency > 0) {
+                    // Looked up while on probation, so it's worth keeping.
+                    entry.frequency = 0;
+                    entry.queue = QUEUE_MAIN;
+                    main.Push(index);
+                    continue;
+                }
+
+                ghosts[ghostSlot(entry.key)] = ghostTag(entry.key);
+                remove(index);
+                return;
+            }
+
+            int index = main.Pop();
+            Entry& entry = entries[index];
+
+            if (entry.frequency > 0) {
+                entry.frequency--;
+                main.Push(index);
+                continue;
+            }
+
+            remove(index);
+            return;
+        }
+    }
+
+    bool Shard::Find(const ContentHash& key, CachedVerdict* verdict) {
+        lookups++;
+
+        size_t slot = findSlot(key);
+        if (slot == table.size()) {
+            return false;
+        }
+
+        Entry& entry = entries[table[slot]];
+        if (entry.frequency < VERDICT_CACHE_MAX_FREQUENCY) {
+            entry.frequency++;
+        }
+
+        *verdict = entry.verdict;
+        hits++;
+        return true;
+    }
+
+    void Shard::Insert(const ContentHash& key, const CachedVerdict& verdict, bool proven) {
+        size_t slot = findSlot(key);
+        if (slot != table.size()) {
+            // Another thread scanned the same content at the same time.
+            entries[table[slot]].verdict = verdict;
+            return;
+        }
+
+        if (freeEntries.empty()) {
+            evict();
+        }
+
+        int index = freeEntries.back();
+        freeEntries.pop_back();
+
+        Entry& entry = entries[index];
+        entry.key = key;
+        entry.verdict = verdict;
+        entry.frequency = 0;
+
+        unsigned long long& ghost = ghosts[ghostSlot(key)];
+        if (proven) {
+            entry.queue = QUEUE_MAIN;
+            main.Push(index);
+        }
+        else if (ghost == ghostTag(key)) {
+            ghost = 0;
+            entry.queue = QUEUE_MAIN;
+            main.Push(index);
+            ghostHits++;
+        }
+        else {
+            entry.queue = QUEUE_SMALL;
+            small.Push(index);
+        }
+
+        size_t mask = table.size() - 1;
+        for (slot = homeSlot(key); table[slot] >= 0; slot = (slot + 1) & mask) {
+        }
+
+        table[slot] = index;
+        inserts++;
+    }
+
+    void Shard::Collect(std::vector<std::pair<int, VerdictCacheEntry> >& collected) const {
+        for (size_t i = 0; i < entries.size(); i++) {
+            const Entry& entry = entries[i];
+            if (entry.queue == QUEUE_NONE) {
+                continue;
+            }
+
+            // Zeroed first, so that padding doesn't make two saves of the same cache differ.
+            VerdictCacheEntry exported;
+            memset(&exported, 0, sizeof(exported));
+            exported.key = entry.key;
+            exported.verdict = entry.verdict;
+            exported.proven = entry.queue == QUEUE_MAIN;
+
+            int heat = (exported.proven ? VERDICT_CACHE_MAX_FREQUENCY + 1 : 0) + entry.frequency;
+            collected.push_back(std::make_pair(heat, exported));
+        }
+    }
+
+    bool hotter(const std::pair<int, VerdictCacheEntry>& a, const std::pair<int, VerdictCacheEntry>& b) {
+        return a.first > b.first;
+    }
+
+    size_t Shard::MemoryBytes() const {
+        return entries.capacity() * sizeof(Entry) + table.capacity() * sizeof(int) + freeEntries.capacity() * sizeof(int) +
+            small.MemoryBytes() + main.MemoryBytes() + ghosts.capacity() * sizeof(unsigned long long);
+    }
+}
+
+struct VerdictCache::Impl {
+    Shard shards[VERDICT_CACHE_SHARDS];
+    std::atomic<unsigned long long> bytesSkipped;
+
+    Shard& ShardFor(const ContentHash& key) {
+        return shards[(size_t)(key.high >> (64 - VERDICT_CACHE_SHARD_BITS))];
+    }
+};
+
+VerdictCache::VerdictCache(size_t budgetBytes, size_t chunkSize) : impl(new Impl()), chunkSize(chunkSize) {
+    if (this->chunkSize == 0) {
+        this->chunkSize = VERDICT_CACHE_DEFAULT_CHUNK_SIZE;
+    }
+
+    size_t shardEntries = budgetBytes / EntryBytes() / VERDICT_CACHE_SHARDS;
+
+    // Under a hard limit, only what the limit has left is used. Each entry is counted at the most
+    // its share of the power of two tables can come to, so the cache can't end up over the limit.
+    size_t headroom = MemoryBudget::Headroom(MEMORY_TAG_VERDICT_CACHE);
+    if (headroom != SIZE_MAX) {
+        size_t room = headroom > sizeof(Impl) ? headroom - sizeof(Impl) : 0;
+        size_t fits = room / (EntryBytes() + sizeof(int) + sizeof(unsigned long long)) / VERDICT_CACHE_SHARDS;
+
+        if (shardEntries > fits) {
+            shardEntries = fits;
+        }
+    }
+
+    if (shardEntries < VERDICT_CACHE_MIN_SHARD_ENTRIES) {
+        shardEntries = VERDICT_CACHE_MIN_SHARD_ENTRIES;
+    }
+
+    capacity = shardEntries * VERDICT_CACHE_SHARDS;
+    accounted = sizeof(Impl);
+
+    for (int i = 0; i < VERDICT_CACHE_SHARDS; i++) {
+        impl->shards[i].Reset(shardEntries);
+        accounted += impl->shards[i].MemoryBytes();
+    }
+
+    impl->bytesSkipped = 0;
+
+    // Allocated already, so there is nothing to refuse.
+    MemoryBudget::Charge(MEMORY_TAG_VERDICT_CACHE, accounted);
+}
+
+VerdictCache::~VerdictCache() {
+    delete impl;
+
+    MemoryBudget::Release(MEMORY_TAG_VERDICT_CACHE, accounted);
+}
+
+size_t VerdictCache::EntryBytes() {
+    // The index is sized to between two and four slots per entry.
+    return sizeof(Entry) + 3 * sizeof(int) + 3 * sizeof(int) + sizeof(unsigned long long);
+}
+
+bool VerdictCache::Find(const ContentHash& key, CachedVerdict* verdict) {
+    Shard& shard = impl->ShardFor(key);
+    std::lock_guard<std::mutex> guard(shard.lock);
+
+    return shard.Find(key, verdict);
+}
+
+void VerdictCache::Insert(const ContentHash& key, const CachedVerdict& verdict) {
+    Shard& shard = impl->ShardFor(key);
+    std::lock_guard<std::mutex> guard(shard.lock);
+
+    shard.Insert(key, verdict, false);
+}
+
+size_t VerdictCache::Export(VerdictCacheEntry* entries, size_t maxEntries) const {
+    std::vector<std::pair<int, VerdictCacheEntry> > collected;
+
+    for (int i = 0; i < VERDICT_CACHE_SHARDS; i++) {
+        Shard& shard = impl->shards[i];
+        std::lock_guard<std::mutex> guard(shard.lock);
+
+        shard.Collect(collected);
+    }
+
+    size_t count = collected.size() < maxEntries ? collected.size() : maxEntries;
+    std::partial_sort(collected.begin(), collected.begin() + count, collected.end(), hotter);
+
+    for (size_t i = 0; i < count; i++) {
+        entries[i] = collected[i].second;
+    }
+
+    return count;
+}
+
+void VerdictCache::Import(const VerdictCacheEntry* entries, size_t count) {
+    // Coldest first, so that if they don't all fit, the hottest are the ones left.
+    for (size_t i = count; i > 0; i--) {
+        const VerdictCacheEntry& entry = entries[i - 1];
+        Shard& shard = impl->ShardFor(entry.key);
+        std::lock_guard<std::mutex> guard(shard.lock);
+
+        shard.Insert(entry.key, entry.verdict, entry.proven);
+    }
+}
+
+void VerdictCache::Save(WarmStartWriter* writer, size_t maxEntries) const {
+    std::vector<VerdictCacheEntry> entries(maxEntries > 0 ? maxEntries : 1);
+
+    VerdictSnapshotInfo info;
+    info.chunkSize = chunkSize;
+    info.count = Export(&entries[0], maxEntries);
+
+    writer->Add(WARM_START_SECTION_VERDICT_INFO, &info, sizeof(info));
+    writer->Add(WARM_START_SECTION_VERDICTS, &entries[0], (size_t)info.count * sizeof(VerdictCacheEntry));
+}
+
+size_t VerdictCache::Restore(const WarmStartSnapshot& snapshot) {
+    size_t infoLength;
+    size_t entriesLength;
+    const unsigned char* infoData = snapshot.Section(WARM_START_SECTION_VERDICT_INFO, &infoLength);
+    const unsigned char* entriesData = snapshot.Section(WARM_START_SECTION_VERDICTS, &entriesLength);
+
+    VerdictSnapshotInfo info;
+    if (infoData == NULL || infoLength != sizeof(info) || entriesData == NULL) {
+        return 0;
+    }
+
+    memcpy(&info, infoData, sizeof(info));
+
+    if (info.chunkSize != chunkSize || info.count != entriesLength / sizeof(VerdictCacheEntry)) {
+        return 0;
+    }
+
+    // Sections start aligned for any of our structs, so the entries are read in place.
+    Import(reinterpret_cast<const VerdictCacheEntry*>(entriesData), (size_t)info.count);
+    return (size_t)info.count;
+}
+
+void VerdictCache::Clear() {
+    for (int i = 0; i < VERDICT_CACHE_SHARDS; i++) {
+        std::lock_guard<std::mutex> guard(impl->shards[i].lock);
+        impl->shards[i].Clear();
+    }
+
+    impl->bytesSkipped = 0;
+}
+
+void VerdictCache::CountSkipped(size_t bytes) {
+    impl->bytesSkipped.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void VerdictCache::GetStats(VerdictCacheStats* stats) const {
+    stats->lookups = 0;
+    stats->hits = 0;
+    stats->inserts = 0;
+    stats->evictions = 0;
+    stats->ghostHits = 0;
+    stats->bytesSkipped = impl->bytesSkipped.load(std::memory_order_relaxed);
+    stats->entries = 0;
+    stats->capacity = capacity;
+    stats->memoryBytes = sizeof(Impl);
+
+    for (int i = 0; i < VERDICT_CACHE_SHARDS; i++) {
+        Shard& shard = impl->shards[i];
+        std::lock_guard<std::mutex> guard(shard.lock);
+
+        stats->lookups += shard.lookups;
+        stats->hits += shard.hits;
+        stats->inserts += shard.inserts;
+        stats->evictions += shard.evictions;
+        stats->ghostHits += shard.ghostHits;
+        stats->entries += shard.inserts - shard.evictions;
+        stats->memoryBytes += shard.MemoryBytes();
+    }
+}
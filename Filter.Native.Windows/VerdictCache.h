@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstddef>
+
+#include "ContentHash.h"
+
+class WarmStartSnapshot;
+class WarmStartWriter;
+
+// Chunk size used when the cache isn't given one. Small enough that an edit to one part of a
+// page leaves most of its chunks unchanged, big enough that hashing and lookups stay well below
+// the cost of the scan they save.
+#define VERDICT_CACHE_DEFAULT_CHUNK_SIZE (4 * 1024)
+
+typedef struct CachedVerdict {
+    bool found;
+    short category;
+    int trigger;
+
+    // Of the match, relative to the start of the content the verdict was cached for.
+    unsigned int offset;
+    unsigned int length;
+
+    // For a chunk, where the chunk after it starts, relative to its own start.
+    unsigned int next;
+} CachedVerdict;
+
+/// An entry as VerdictCache::Export() hands it out, for saving across restarts.
+typedef struct VerdictCacheEntry {
+    ContentHash key;
+    CachedVerdict verdict;
+
+    // Looked up again after it was cached, so it went past probation.
+    bool proven;
+} VerdictCacheEntry;
+
+typedef struct VerdictCacheStats {
+    unsigned long long lookups;
+    unsigned long long hits;
+    unsigned long long inserts;
+    unsigned long long evictions;
+
+    // Inserts that went straight to the main queue because their fingerprint was evicted from the
+    // probation queue not long before.
+    unsigned long long ghostHits;
+
+    // Content that a hit saved from being scanned.
+    unsigned long long bytesSkipped;
+
+    size_t entries;
+    size_t capacity;
+    size_t memoryBytes;
+} VerdictCacheStats;
+
+/// Fixed size map from content fingerprints to trigger scan verdicts.
+///
+/// Eviction is S3-FIFO: new fingerprints go into a small probation queue and only move to the
+/// main queue if they are looked up again before they reach its head. A burst of one-off pages
+/// therefore cycles through the probation queue without pushing out content that keeps coming
+/// back. Fingerprints evicted from probation are remembered for a while, and come back straight
+/// into the main queue.
+///
+/// Entries are split across shards by fingerprint, each with its own lock, so that scans on
+/// different threads rarely wait for each other. All memory is allocated up front from the budget,
+/// and charged to MEMORY_TAG_VERDICT_CACHE. A hard limit on that tag shrinks the budget to fit.
+///
+/// The cache knows nothing about what a fingerprint covers. Callers fold everything the verdict
+/// depends on (triggers, enabled categories, options) into the hash seed.
+class VerdictCache {
+public:
+    VerdictCache(size_t budgetBytes, size_t chunkSize);
+    ~VerdictCache();
+
+    bool Find(const ContentHash& key, CachedVerdict* verdict);
+
+    void Insert(const ContentHash& key, const CachedVerdict& verdict);
+
+    void Clear();
+
+    /// Copies out up to maxEntries entries, the ones that proved themselves first and within those
+    /// the ones looked up most, and returns how many it wrote.
+    size_t Export(VerdictCacheEntry* entries, size_t maxEntries) const;
+
+    /// Inserts exported entries. Proven ones skip probation, so a burst of new content right after
+    /// they come back doesn't push them out before they are looked up.
+    void Import(const VerdictCacheEntry* entries, size_t count);
+
+    /// Exports up to maxEntries entries into a snapshot.
+    void Save(WarmStartWriter* writer, size_t maxEntries) const;
+
+    /// Imports the entries a snapshot holds and returns how many. Verdicts for chunks only line up
+    /// with a cache that cuts content the same way, so a snapshot saved with another chunk size is
+    /// passed over.
+    size_t Restore(const WarmStartSnapshot& snapshot);
+
+    void CountSkipped(size_t bytes);
+
+    void GetStats(VerdictCacheStats* stats) const;
+
+    size_t ChunkSize() const { return chunkSize; }
+    size_t Capacity() const { return capacity; }
+
+    // Memory one entry takes, counting its share of the index, queues and ghost table.
+    static size_t EntryBytes();
+
+private:
+    VerdictCache(const VerdictCache&);
+    VerdictCache& operator=(const VerdictCache&);
+
+    struct Impl;
+    Impl* impl;
+
+    size_t chunkSize;
+    size_t capacity;
+
+    // Bytes charged to the memory budget.
+    size_t accounted;
+};
@@ -0,0 +1,432 @@
+#include "MemoryBudget.h"
+#include "WarmStartSnapshot.h"
+
+#include <cstring>
+#include <string>
+
+#if defined(_MSC_VER)
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define WARM_START_ALIGNMENT 8
+
+// Seeds the checksums, so that a file of some other kind that happens to have our layout doesn't
+// pass for a snapshot.
+#define WARM_START_CHECKSUM_SEED 0x63767761726d7374ULL
+
+static const unsigned char warmStartMagic[8] = { 'C', 'V', 'W', 'A', 'R', 'M', 'S', 'T' };
+
+namespace {
+    typedef struct FileHeader {
+        unsigned char magic[8];
+        unsigned int version;
+
+        // sizeof(size_t) of the build that wrote the file. Sections hold structs with size_t
+        // fields, so 32 and 64 bit builds can't read each other's.
+        unsigned int wordSize;
+
+        unsigned int sectionCount;
+        unsigned int reserved;
+        unsigned long long fileLength;
+
+        ContentHash policy;
+
+        // Of the header up to here and the section table after it.
+        ContentHash checksum;
+    } FileHeader;
+
+    typedef struct FileSection {
+        unsigned int type;
+        unsigned int reserved;
+        unsigned long long offset;
+        unsigned long long length;
+        ContentHash checksum;
+    } FileSection;
+}
+
+struct WarmStartSnapshot::Mapping {
+#if defined(_MSC_VER)
+    HANDLE file;
+    HANDLE view;
+#else
+    int file;
+#endif
+};
+
+static size_t aligned(size_t offset) {
+    return (offset + WARM_START_ALIGNMENT - 1) & ~(size_t)(WARM_START_ALIGNMENT - 1);
+}
+
+// Hash of the header with its checksum left out, followed by the section table.
+static ContentHash tableChecksum(const FileHeader* header, const FileSection* sections, unsigned int count) {
+    ContentHash first = HashContent(reinterpret_cast<const unsigned char*>(header), offsetof(FileHeader, checksum), WARM_START_CHECKSUM_SEED);
+    return HashContent(reinterpret_cast<const unsigned char*>(sections), count * sizeof(FileSection), first.low ^ first.high);
+}
+
+#if defined(_MSC_VER)
+static std::wstring widePath(const char* path) {
+    int length = MultiByteToWideChar(CP_UTF8, 0, path, -1, NULL, 0);
+    if (length <= 0) {
+        return std::wstring();
+    }
+
+    std::wstring wide((size_t)length, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, path, -1, &wide[0], length);
+    wide.resize((size_t)length - 1);
+    return wide;
+}
+
+static bool writeAll(HANDLE file, const unsigned char* data, size_t length) {
+    bool written = true;
+
+    for (size_t offset = 0; written && offset < length; ) {
+        DWORD chunk = length - offset > 0x40000000 ? 0x40000000 : (DWORD)(length - offset);
+        DWORD done = 0;
+
+        written = WriteFile(file, data + offset, chunk, &done, NULL) && done == chunk;
+        offset += done;
+    }
+
+    return written;
+}
+
+static bool writeFile(const std::string& path, const std::string& finalPath, const unsigned char* head, size_t headLength, const unsigned char* body, size_t bodyLength) {
+    std::wstring wide = widePath(path.c_str());
+    HANDLE file = CreateFileW(wide.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    bool written = writeAll(file, head, headLength) && writeAll(file, body, bodyLength);
+
+    written = written && FlushFileBuffers(file);
+    CloseHandle(file);
+
+    if (!written || !MoveFileExW(wide.c_str(), widePath(finalPath.c_str()).c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        DeleteFileW(wide.c_str());
+        return false;
+    }
+
+    return true;
+}
+#else
+static bool writeAll(int file, const unsigned char* data, size_t length) {
+    bool written = true;
+
+    for (size_t offset = 0; written && offset < length; ) {
+        ssize_t done = write(file, data + offset, length - offset);
+
+        written = done > 0;
+        offset += written ? (size_t)done : 0;
+    }
+
+    return written;
+}
+
+static bool writeFile(const std::string& path, const std::string& finalPath, const unsigned char* head, size_t headLength, const unsigned char* body, size_t bodyLength) {
+    int file = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (file < 0) {
+        return false;
+    }
+
+    bool written = writeAll(file, head, headLength) && writeAll(file, body, bodyLength);
+
+    written = written && fsync(file) == 0;
+    close(file);
+
+    if (!written || rename(path.c_str(), finalPath.c_str()) != 0) {
+        unlink(path.c_str());
+        return false;
+    }
+
+    return true;
+}
+#endif
+
+WarmStartWriter::WarmStartWriter() : accounted(0), overBudget(false) {
+}
+
+WarmStartWriter::~WarmStartWriter() {
+    MemoryBudget::Release(MEMORY_TAG_WARM_START, accounted);
+}
+
+void WarmStartWriter::Add(unsigned int type, const void* bytes, size_t length) {
+    PendingSection section;
+    section.type = type;
+    section.offset = aligned(data.size());
+    section.length = length;
+
+    if (overBudget) {
+        return;
+    }
+
+    size_t needed = section.offset + length;
+    if (needed > data.capacity()) {
+        size_t grown = needed > data.capacity() * 2 ? needed : data.capacity() * 2;
+
+        if (!MemoryBudget::TryCharge(MEMORY_TAG_WARM_START, grown - data.capacity())) {
+            overBudget = true;
+            return;
+        }
+
+        accounted += grown - data.capacity();
+        data.reserve(grown);
+    }
+
+    data.resize(needed);
+    if (length > 0) {
+        memcpy(&data[section.offset], bytes, length);
+    }
+
+    sections.push_back(section);
+}
+
+void WarmStartWriter::buildHead(const ContentHash& policy, std::vector<unsigned char>& head) const {
+    size_t tableLength = sections.size() * sizeof(FileSection);
+    size_t dataOffset = aligned(sizeof(FileHeader) + tableLength);
+
+    head.assign(dataOffset, 0);
+
+    FileHeader* header = reinterpret_cast<FileHeader*>(&head[0]);
+    FileSection* table = reinterpret_cast<FileSection*>(&head[sizeof(FileHeader)]);
+
+    memcpy(header->magic, warmStartMagic, sizeof(header->magic));
+    header->version = WARM_START_VERSION;
+    header->wordSize = sizeof(size_t);
+    header->sectionCount = (unsigned int)sections.size();
+    header->fileLength = dataOffset + data.size();
+    header->policy = policy;
+
+    for (size_t i = 0; i < sections.size(); i++) {
+        const PendingSection& section = sections[i];
+
+        table[i].type = section.type;
+        table[i].offset = dataOffset + section.offset;
+        table[i].length = section.length;
+        table[i].checksum = HashContent(data.empty() ? NULL : &data[section.offset], section.length, WARM_START_CHECKSUM_SEED);
+    }
+
+    header->checksum = tableChecksum(header, table, header->sectionCount);
+}
+
+bool WarmStartWriter::Write(const char* path, const ContentHash& policy) const {
+    if (overBudget) {
+        return false;
+    }
+
+    // Only the header and table are built here. The sections are written straight from where they
+    // were added, so saving never holds two copies of them.
+    std::vector<unsigned char> head;
+    buildHead(policy, head);
+
+    std::string finalPath = path;
+    return writeFile(finalPath + ".tmp", finalPath, &head[0], head.size(), data.empty() ? NULL : &data[0], data.size());
+}
+
+bool WarmStartWriter::WriteTo(std::vector<unsigned char>& bytes, const ContentHash& policy) const {
+    if (overBudget) {
+        return false;
+    }
+
+    buildHead(policy, bytes);
+    bytes.insert(bytes.end(), data.begin(), data.end());
+    return true;
+}
+
+WarmStartSnapshot::WarmStartSnapshot() : mapping(NULL), accounted(0), base(NULL), length(0) {
+}
+
+WarmStartSnapshot::~WarmStartSnapshot() {
+    Close();
+}
+
+int WarmStartSnapshot::Open(const char* path, const ContentHash& policy) {
+    Close();
+
+    mapping = new Mapping();
+
+#if defined(_MSC_VER)
+    mapping->view = NULL;
+    mapping->file = CreateFileW(widePath(path).c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    LARGE_INTEGER size;
+    if (mapping->file == INVALID_HANDLE_VALUE) {
+        delete mapping;
+        mapping = NULL;
+        return WARM_START_MISSING;
+    }
+
+    if (!GetFileSizeEx(mapping->file, &size) || size.QuadPart < (LONGLONG)sizeof(FileHeader) || (unsigned long long)size.QuadPart > (size_t)-1) {
+        Close();
+        return WARM_START_CORRUPT;
+    }
+
+    mapping->view = CreateFileMappingW(mapping->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping->view != NULL) {
+        base = static_cast<const unsigned char*>(MapViewOfFile(mapping->view, FILE_MAP_READ, 0, 0, 0));
+    }
+
+    length = (size_t)size.QuadPart;
+#else
+    mapping->file = open(path, O_RDONLY);
+
+    struct stat status;
+    if (mapping->file < 0) {
+        delete mapping;
+        mapping = NULL;
+        return WARM_START_MISSING;
+    }
+
+    if (fstat(mapping->file, &status) != 0 || status.st_size < (off_t)sizeof(FileHeader)) {
+        Close();
+        return WARM_START_CORRUPT;
+    }
+
+    length = (size_t)status.st_size;
+
+    void* view = mmap(NULL, length, PROT_READ, MAP_PRIVATE, mapping->file, 0);
+    base = view == MAP_FAILED ? NULL : static_cast<const unsigned char*>(view);
+#endif
+
+    if (base == NULL) {
+        Close();
+        return WARM_START_CORRUPT;
+    }
+
+    int checked = check(policy);
+    if (checked != WARM_START_LOADED) {
+        Close();
+    }
+
+    return checked;
+}
+
+int WarmStartSnapshot::Load(const unsigned char* bytes, size_t byteLength, const ContentHash& policy) {
+    Close();
+
+    if (byteLength < sizeof(FileHeader)) {
+        return WARM_START_CORRUPT;
+    }
+
+    size_t words = (byteLength + sizeof(unsigned long long) - 1) / sizeof(unsigned long long);
+
+    if (!MemoryBudget::TryCharge(MEMORY_TAG_WARM_START, words * sizeof(unsigned long long))) {
+        return WARM_START_OVER_BUDGET;
+    }
+
+    accounted = words * sizeof(unsigned long long);
+
+    copy.assign(words, 0);
+    memcpy(&copy[0], bytes, byteLength);
+
+    base = reinterpret_cast<const unsigned char*>(&copy[0]);
+    length = byteLength;
+
+    int status = check(policy);
+    if (status != WARM_START_LOADED) {
+        Close();
+    }
+
+    return status;
+}
+
+int WarmStartSnapshot::check(const ContentHash& policy) const {
+    const FileHeader* header = reinterpret_cast<const FileHeader*>(base);
+
+    if (memcmp(header->magic, warmStartMagic, sizeof(header->magic)) != 0 || header->fileLength != length) {
+        return WARM_START_CORRUPT;
+    }
+
+    if (header->version != WARM_START_VERSION || header->wordSize != sizeof(size_t)) {
+        return WARM_START_INCOMPATIBLE;
+    }
+
+    if (header->sectionCount > (length - sizeof(FileHeader)) / sizeof(FileSection)) {
+        return WARM_START_CORRUPT;
+    }
+
+    const FileSection* table = reinterpret_cast<const FileSection*>(base + sizeof(FileHeader));
+
+    if (tableChecksum(header, table, header->sectionCount) != header->checksum) {
+        return WARM_START_CORRUPT;
+    }
+
+    for (unsigned int i = 0; i < header->sectionCount; i++) {
+        const FileSection& section = table[i];
+
+        if (section.offset > length || section.length > length - section.offset || section.offset % WARM_START_ALIGNMENT != 0 ||
+            HashContent(base + section.offset, (size_t)section.length, WARM_START_CHECKSUM_SEED) != section.checksum) {
+            return WARM_START_CORRUPT;
+        }
+    }
+
+    // Only a snapshot that is intact can be told apart from one for other lists.
+    if (header->policy != policy) {
+        return WARM_START_STALE;
+    }
+
+    return WARM_START_LOADED;
+}
+
+void WarmStartSnapshot::Close() {
+    if (accounted > 0) {
+        std::vector<unsigned long long>().swap(copy);
+        MemoryBudget::Release(MEMORY_TAG_WARM_START, accounted);
+
+        accounted = 0;
+        base = NULL;
+        length = 0;
+    }
+
+    if (mapping == NULL) {
+        return;
+    }
+
+#if defined(_MSC_VER)
+    if (base != NULL) {
+        UnmapViewOfFile(base);
+    }
+
+    if (mapping->view != NULL) {
+        CloseHandle(mapping->view);
+    }
+
+    CloseHandle(mapping->file);
+#else
+    if (base != NULL) {
+        munmap(const_cast<unsigned char*>(base), length);
+    }
+
+    close(mapping->file);
+#endif
+
+    delete mapping;
+    mapping = NULL;
+    base = NULL;
+    length = 0;
+}
+
+const unsigned char* WarmStartSnapshot::Section(unsigned int type, size_t* sectionLength) const {
+    *sectionLength = 0;
+
+    if (base == NULL) {
+        return NULL;
+    }
+
+    const FileHeader* header = reinterpret_cast<const FileHeader*>(base);
+    const FileSection* table = reinterpret_cast<const FileSection*>(base + sizeof(FileHeader));
+
+    for (unsigned int i = 0; i < header->sectionCount; i++) {
+        if (table[i].type == type) {
+            *sectionLength = (size_t)table[i].length;
+            return base + table[i].offset;
+        }
+    }
+
+    return NULL;
+}
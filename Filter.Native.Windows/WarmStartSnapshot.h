@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "ContentHash.h"
+
+// Bumped whenever the file layout, or the layout of any section, changes. Snapshots written with
+// another version are ignored, never converted.
+#define WARM_START_VERSION 1
+
+// What WarmStartSnapshot::Open() made of a file.
+#define WARM_START_LOADED 0
+#define WARM_START_MISSING 1
+
+// Cut short, overwritten or otherwise not what was written.
+#define WARM_START_CORRUPT 2
+
+// Written by a build with another version or word size.
+#define WARM_START_INCOMPATIBLE 3
+
+// Written for other lists.
+#define WARM_START_STALE 4
+
+// Sound, but bigger than the memory budget of what it restores has room for. Only restores and
+// Load() return it, never Open().
+#define WARM_START_OVER_BUDGET 5
+
+// Section types, in a range per owner.
+#define WARM_START_SECTION_TRIGGER_INFO 0x100
+#define WARM_START_SECTION_TRIGGER_PHRASES 0x101
+#define WARM_START_SECTION_TRIGGER_LINKS 0x102
+#define WARM_START_SECTION_TRIGGER_TEXT 0x103
+#define WARM_START_SECTION_TRIGGER_TABLE 0x104
+#define WARM_START_SECTION_TRIGGER_WORDS 0x105
+#define WARM_START_SECTION_TRIGGER_CATEGORIES 0x106
+
+#define WARM_START_SECTION_VERDICT_INFO 0x200
+#define WARM_START_SECTION_VERDICTS 0x201
+
+/// Collects sections in memory and writes them out as one snapshot file.
+class WarmStartWriter {
+public:
+    WarmStartWriter();
+    ~WarmStartWriter();
+
+    /// Copies length bytes in as a section of the given type. The copies are charged to
+    /// MEMORY_TAG_WARM_START, and once the budget refuses one, nothing more is added and Write()
+    /// fails instead of writing a snapshot with sections missing.
+    void Add(unsigned int type, const void* data, size_t length);
+
+    /// Writes every section added so far to path, which is UTF-8. The file is written next to path
+    /// first and only replaces it once it is complete, so a crash midway leaves the old snapshot.
+    /// policy is what the sections were built from; Open() refuses the file for any other.
+    bool Write(const char* path, const ContentHash& policy) const;
+
+    /// Lays the snapshot out in bytes the same way Write() does in the file, for a caller that
+    /// stores it some other way, such as encrypted.
+    bool WriteTo(std::vector<unsigned char>& bytes, const ContentHash& policy) const;
+
+private:
+    WarmStartWriter(const WarmStartWriter&);
+    WarmStartWriter& operator=(const WarmStartWriter&);
+
+    typedef struct PendingSection {
+        unsigned int type;
+        size_t offset;
+        size_t length;
+    } PendingSection;
+
+    // The file header and section table that go in front of the sections.
+    void buildHead(const ContentHash& policy, std::vector<unsigned char>& head) const;
+
+    std::vector<PendingSection> sections;
+    std::vector<unsigned char> data;
+
+    // Bytes charged to the memory budget.
+    size_t accounted;
+    bool overBudget;
+};
+
+/// A snapshot file mapped into memory, or a copy of one WarmStartWriter::WriteTo() laid out.
+/// Open() and Load() check the whole snapshot before any of it is used: every section has a
+/// checksum, and the table of sections has one of its own.
+///
+/// Sections start 8 byte aligned, so their owners can read arrays of their own structs straight
+/// from the mapping.
+class WarmStartSnapshot {
+public:
+    WarmStartSnapshot();
+    ~WarmStartSnapshot();
+
+    /// Maps the file at path, which is UTF-8, and returns a WARM_START_*. Sections can only be read
+    /// after WARM_START_LOADED.
+    int Open(const char* path, const ContentHash& policy);
+
+    /// Copies length bytes in and returns a WARM_START_*, as Open() does for a file. The copy is
+    /// charged to MEMORY_TAG_WARM_START until Close().
+    int Load(const unsigned char* bytes, size_t length, const ContentHash& policy);
+
+    void Close();
+
+    /// A section's bytes, valid until Close(), or NULL if the snapshot has no such section.
+    const unsigned char* Section(unsigned int type, size_t* length) const;
+
+    size_t FileLength() const { return length; }
+
+private:
+    WarmStartSnapshot(const WarmStartSnapshot&);
+    WarmStartSnapshot& operator=(const WarmStartSnapshot&);
+
+    // Checks the snapshot at base and returns a WARM_START_*.
+    int check(const ContentHash& policy) const;
+
+    struct Mapping;
+    Mapping* mapping;
+
+    // What Load() copied in, in words so that it starts aligned.
+    std::vector<unsigned long long> copy;
+    size_t accounted;
+
+    const unsigned char* base;
+    size_t length;
+};
@@ -0,0 +1,224 @@
+#include "WorkPool.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+    struct Batch {
+        WorkPoolTask task;
+        void* context;
+
+        // Guarded by doneLock. The last job to finish must not touch the batch after releasing the
+        // lock, since the owner's stack frame goes away as soon as it sees zero.
+        size_t remaining;
+
+        std::mutex doneLock;
+        std::condition_variable done;
+    };
+
+    struct Job {
+        Batch* batch;
+        size_t index;
+    };
+
+    struct Worker {
+        std::mutex lock;
+        std::deque<Job> jobs;
+        std::thread thread;
+    };
+
+    struct PoolState {
+        std::vector<Worker*> workers;
+
+        // Jobs queued across all deques. Workers sleep while this is zero.
+        std::atomic<size_t> queued;
+
+        std::mutex sleepLock;
+        std::condition_variable wake;
+        bool stopping;
+
+        std::atomic<unsigned int> nextWorker;
+    };
+}
+
+struct WorkPool::Impl : PoolState {
+};
+
+static void runJob(const Job& job) {
+    Batch* batch = job.batch;
+
+    batch->task(batch->context, job.index);
+
+    std::lock_guard<std::mutex> guard(batch->doneLock);
+    if (--batch->remaining == 0) {
+        batch->done.notify_all();
+    }
+}
+
+static bool popOwn(Worker* worker, Job& job) {
+    std::lock_guard<std::mutex> guard(worker->lock);
+    if (worker->jobs.empty()) {
+        return false;
+    }
+
+    job = worker->jobs.back();
+    worker->jobs.pop_back();
+    return true;
+}
+
+static bool steal(Worker* victim, Job& job) {
+    std::lock_guard<std::mutex> guard(victim->lock);
+    if (victim->jobs.empty()) {
+        return false;
+    }
+
+    job = victim->jobs.front();
+    victim->jobs.pop_front();
+    return true;
+}
+
+// Used by ParallelFor callers, which must only help with their own batch.
+static bool stealFromBatch(Worker* victim, Batch* batch, Job& job) {
+    std::lock_guard<std::mutex> guard(victim->lock);
+    for (std::deque<Job>::iterator it = victim->jobs.begin(); it != victim->jobs.end(); ++it) {
+        if (it->batch == batch) {
+            job = *it;
+            victim->jobs.erase(it);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void workerLoop(PoolState* impl, size_t self) {
+    Worker* own = impl->workers[self];
+    size_t workerCount = impl->workers.size();
+
+    for (;;) {
+        Job job;
+        bool found = popOwn(own, job);
+
+        for (size_t i = 1; !found && i < workerCount; i++) {
+            found = steal(impl->workers[(self + i) % workerCount], job);
+        }
+
+        if (found) {
+            impl->queued.fetch_sub(1, std::memory_order_relaxed);
+            runJob(job);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> sleep(impl->sleepLock);
+        impl->wake.wait(sleep, [impl] { return impl->stopping || impl->queued.load(std::memory_order_relaxed) > 0; });
+
+        if (impl->stopping) {
+            return;
+        }
+    }
+}
+
+WorkPool::WorkPool(unsigned int threadCount) : impl(new Impl()) {
+    impl->queued = 0;
+    impl->stopping = false;
+    impl->nextWorker = 0;
+
+    for (unsigned int i = 0; i < threadCount; i++) {
+        impl->workers.push_back(new Worker());
+    }
+
+    // Start the threads only once every deque exists, since they steal from each other.
+    for (unsigned int i = 0; i < threadCount; i++) {
+        impl->workers[i]->thread = std::thread(workerLoop, static_cast<PoolState*>(impl), (size_t)i);
+    }
+}
+
+WorkPool::~WorkPool() {
+    {
+        std::lock_guard<std::mutex> guard(impl->sleepLock);
+        impl->stopping = true;
+    }
+
+    impl->wake.notify_all();
+
+    for (size_t i = 0; i < impl->workers.size(); i++) {
+        impl->workers[i]->thread.join();
+        delete impl->workers[i];
+    }
+
+    delete impl;
+}
+
+unsigned int WorkPool::ThreadCount() const {
+    return (unsigned int)impl->workers.size();
+}
+
+void WorkPool::ParallelFor(size_t count, WorkPoolTask task, void* context) {
+    if (count == 0) {
+        return;
+    }
+
+    size_t workerCount = impl->workers.size();
+
+    if (count == 1 || workerCount == 0) {
+        for (size_t i = 0; i < count; i++) {
+            task(context, i);
+        }
+
+        return;
+    }
+
+    Batch batch;
+    batch.task = task;
+    batch.context = context;
+    batch.remaining = count;
+
+    // Deal the jobs out round-robin, starting where the last batch stopped so that small batches
+    // don't all land on the first worker.
+    size_t first = impl->nextWorker.fetch_add((unsigned int)count, std::memory_order_relaxed);
+    for (size_t i = 0; i < count; i++) {
+        Worker* worker = impl->workers[(first + i) % workerCount];
+        Job job = { &batch, i };
+
+        std::lock_guard<std::mutex> guard(worker->lock);
+        worker->jobs.push_back(job);
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(impl->sleepLock);
+        impl->queued.fetch_add(count, std::memory_order_relaxed);
+    }
+
+    impl->wake.notify_all();
+
+    for (size_t i = 0; i < workerCount; ) {
+        Job job;
+        if (stealFromBatch(impl->workers[(first + i) % workerCount], &batch, job)) {
+            impl->queued.fetch_sub(1, std::memory_order_relaxed);
+            runJob(job);
+        }
+        else {
+            i++;
+        }
+    }
+
+    std::unique_lock<std::mutex> wait(batch.doneLock);
+    batch.done.wait(wait, [&batch] { return batch.remaining == 0; });
+}
+
+WorkPool* WorkPool::Shared() {
+    // Never destroyed: joining the workers while the DLL is being unloaded would wait on the loader lock.
+    static WorkPool* shared = nullptr;
+    static std::once_flag created;
+
+    std::call_once(created, [] {
+        unsigned int cores = std::thread::hardware_concurrency();
+        shared = new WorkPool(cores > 1 ? cores - 1 : 1);
+    });
+
+    return shared;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+
+// Runs one index of a WorkPool::ParallelFor() batch.
+typedef void (*WorkPoolTask)(void* context, size_t index);
+
+/// Fixed set of worker threads with one job deque each. Workers take from the back of their own
+/// deque and steal from the front of the others when it runs dry, so a batch queued by one busy
+/// request spreads across every idle core.
+///
+/// The threading types live in the .cpp so that this header can be included from /clr code.
+class WorkPool {
+public:
+    explicit WorkPool(unsigned int threadCount);
+    ~WorkPool();
+
+    /// Runs task(context, i) for every i in [0, count) and returns when all of them have finished.
+    /// The calling thread works on its own batch while it waits, so this never deadlocks when every
+    /// worker is busy with other batches.
+    void ParallelFor(size_t count, WorkPoolTask task, void* context);
+
+    unsigned int ThreadCount() const;
+
+    /// Pool shared by every engine in the process, sized to leave one core for the caller.
+    static WorkPool* Shared();
+
+private:
+    WorkPool(const WorkPool&);
+    WorkPool& operator=(const WorkPool&);
+
+    struct Impl;
+    Impl* impl;
+};
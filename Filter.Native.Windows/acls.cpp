@@ -1,156 +1,84 @@
 #include "acls.h"
 
-HRESULT GetSid(LPCWSTR accountName, PSID* ppSid);
+static SC_HANDLE volatile serviceManager = NULL;
 
-SC_HANDLE GetServiceHandleFromName(wchar_t* name) {
-    SC_HANDLE ret = NULL;
-
-    SC_HANDLE manager = OpenSCManagerW(NULL, NULL, SC_MANAGER_ALL_ACCESS);
-    if (manager == NULL) {
-        goto cleanup;
+SC_HANDLE GetServiceManager() {
+    SC_HANDLE manager = serviceManager;
+    if (manager != NULL) {
+        return manager;
     }
 
-    SC_HANDLE service = OpenServiceW(manager, name, ACCESS_SYSTEM_SECURITY | READ_CONTROL | WRITE_DAC);
-    if (service == NULL) {
-        goto cleanup;
-    }
-    else {
-        ret = service;
+    // Connecting is all OpenServiceW() needs. What can be done to a service is decided by the
+    // access asked for when opening it.
+    manager = OpenSCManagerW(NULL, NULL, SC_MANAGER_CONNECT);
+    if (manager == NULL) {
+        return NULL;
     }
 
-cleanup:
-    if (manager != NULL) {
+    SC_HANDLE existing = (SC_HANDLE)InterlockedCompareExchangePointer((PVOID volatile*)&serviceManager, manager, NULL);
+    if (existing != NULL) {
         CloseServiceHandle(manager);
+        return existing;
     }
 
-    return ret;
+    return manager;
 }
 
-int SetObjectAsSystemOnly(LPWSTR objectName, SE_OBJECT_TYPE objectType) {
-    PACL pDacl = NULL, pSacl = NULL;
-    PSECURITY_DESCRIPTOR pSecurityDescriptor = NULL;
-    PSID pSidOwner = NULL, pSidGroup = NULL;
-
-    SID_IDENTIFIER_AUTHORITY SIDAuthNT = SECURITY_NT_AUTHORITY;
-
-    int returnVal = 0;
-
-    DWORD ret = 0;
-    if ((ret = GetNamedSecurityInfoW(objectName, objectType, DACL_SECURITY_INFORMATION, NULL, NULL, &pDacl, NULL, NULL)) != ERROR_SUCCESS) {
-        return ERROR_WAYPOINT_1;
-    }
-
-    PSID pSidSystem = NULL;
-    HRESULT hr = GetSid(L"SYSTEM", &pSidSystem);
-    if (FAILED(hr)) {
-        return ERROR_WAYPOINT_2;
+SC_HANDLE GetServiceHandleFromName(wchar_t* name) {
+    SC_HANDLE manager = GetServiceManager();
+    if (manager == NULL) {
+        return NULL;
     }
 
-    PACL pNewDacl = NULL;
-    EXPLICIT_ACCESSW ea;
-
-    ZeroMemory(&ea, sizeof(EXPLICIT_ACCESSW));
-    ea.grfAccessPermissions = KEY_ALL_ACCESS;
-    ea.grfAccessMode = SET_ACCESS;
-    ea.grfInheritance = 
-    ea.Trustee.TrusteeForm = TRUSTEE_IS_SID;
-    ea.Trustee.TrusteeType = TRUSTEE_IS_USER;
-    ea.Trustee.ptstrName = L"SYSTEM";
-    
-    DWORD dwRes = SetEntriesInAcl(1, &ea, NULL, &pNewDacl);
-    if (dwRes != ERROR_SUCCESS) {
-        returnVal = ERROR_WAYPOINT_3;
-        goto cleanup;
-    }
+    return OpenServiceW(manager, name, ACCESS_SYSTEM_SECURITY | READ_CONTROL | WRITE_DAC);
+}
 
-    dwRes = SetNamedSecurityInfoW(objectName, objectType, DACL_SECURITY_INFORMATION, NULL, NULL, pNewDacl, NULL);
-    if (dwRes != ERROR_SUCCESS) {
-        returnVal = ERROR_WAYPOINT_4;
-        goto cleanup;
-    }
+int SetObjectAsSystemOnly(LPWSTR objectName, SE_OBJECT_TYPE objectType) {
+    // A well-known SID is built locally, so nothing goes to LookupAccountName() or a domain controller.
+    BYTE systemSid[SECURITY_MAX_SID_SIZE];
+    DWORD sidSize = sizeof(systemSid);
 
-cleanup:
-    if (pSidSystem != NULL) {
-        FreeSid(pSidSystem);
+    if (!CreateWellKnownSid(WinLocalSystemSid, NULL, systemSid, &sidSize)) {
+        return (int)GetLastError();
     }
 
-    if (pNewDacl != NULL) {
-        LocalFree((HLOCAL)pNewDacl);
-    }
+    EXPLICIT_ACCESSW access;
+    ZeroMemory(&access, sizeof(access));
+    access.grfAccessPermissions = GENERIC_ALL;
+    access.grfAccessMode = SET_ACCESS;
+    access.grfInheritance = NO_INHERITANCE;
+    access.Trustee.TrusteeForm = TRUSTEE_IS_SID;
+    access.Trustee.TrusteeType = TRUSTEE_IS_WELL_KNOWN_GROUP;
+    access.Trustee.ptstrName = (LPWSTR)systemSid;
 
-    return returnVal;
-}
+    PACL acl = NULL;
 
-HRESULT GetSid(LPCWSTR accountName, PSID* ppSid) {
-    if (accountName == NULL || ppSid == NULL) {
-        return ERROR_INVALID_PARAMETER;
+    DWORD result = SetEntriesInAclW(1, &access, NULL, &acl);
+    if (result != ERROR_SUCCESS) {
+        return (int)result;
     }
 
-    // Create buffers that may be large enough.  
-    // If a buffer is too small, the count parameter will be set to the size needed.  
-    const DWORD INITIAL_SIZE = 32;
-    DWORD cbSid = 0;
-    DWORD dwSidBufferSize = INITIAL_SIZE;
-    DWORD cchDomainName = 0;
-    DWORD dwDomainBufferSize = INITIAL_SIZE;
-    WCHAR * domainName = NULL;
-    SID_NAME_USE eSidType;
-    DWORD dwErrorCode = 0;
-    HRESULT hr = ERROR_SUCCESS;
-
-    *ppSid = (PSID) new BYTE[dwSidBufferSize];
-    if (*ppSid == NULL) {
-        return ACL_INSUFFICIENT_MEMORY;
+    if (objectType != SE_SERVICE) {
+        result = SetNamedSecurityInfoW(objectName, objectType, DACL_SECURITY_INFORMATION, NULL, NULL, acl, NULL);
     }
-    memset(*ppSid, 0, dwSidBufferSize);
+    else {
+        // Through the cached handle to the service control manager, rather than one opened for each call.
+        SC_HANDLE service = NULL;
+        SC_HANDLE manager = GetServiceManager();
 
-    domainName = new WCHAR[dwDomainBufferSize];
-    if (domainName == NULL) {
-        return ACL_INSUFFICIENT_MEMORY;
-    }
-    memset(domainName, 0, dwDomainBufferSize * sizeof(WCHAR));
-
-    for (;;) {
-        cbSid = dwSidBufferSize;
-        cchDomainName = dwDomainBufferSize;
-        if (LookupAccountNameW(NULL, accountName, *ppSid, &cbSid, domainName, &cchDomainName, &eSidType)) {
-            if(IsValidSid(*ppSid) == FALSE) {
-                dwErrorCode = ACL_UNKNOWN_ERROR;
-                break;
-            }
+        if (manager != NULL) {
+            service = OpenServiceW(manager, objectName, READ_CONTROL | WRITE_DAC);
         }
 
-        dwErrorCode = GetLastError();
-
-        if (dwErrorCode == ERROR_INSUFFICIENT_BUFFER) {
-            if (cbSid > dwSidBufferSize) {
-                FreeSid(*ppSid);
-                *ppSid = (PSID) new BYTE[cbSid];
-                if (*ppSid == NULL) {
-                    return ACL_INSUFFICIENT_MEMORY;
-                }
-
-                memset(*ppSid, 0, cbSid);
-                dwSidBufferSize = cbSid;
-            }
-
-            if (cchDomainName > dwDomainBufferSize) {
-                delete[] domainName;
-                domainName = new WCHAR[cchDomainName];
-                if (domainName == NULL) {
-                    return ACL_INSUFFICIENT_MEMORY;
-                }
-                memset(domainName, 0, cchDomainName * sizeof(WCHAR));
-                dwDomainBufferSize = cchDomainName;
-            }
+        if (service == NULL) {
+            result = GetLastError();
         }
         else {
-            hr = HRESULT_FROM_WIN32(dwErrorCode);
-            break;
+            result = SetSecurityInfo(service, SE_SERVICE, DACL_SECURITY_INFORMATION, NULL, NULL, acl, NULL);
+            CloseServiceHandle(service);
         }
     }
 
-    delete[] domainName;
-    return hr;
-
+    LocalFree((HLOCAL)acl);
+    return (int)result;
 }
@@ -4,14 +4,11 @@
 #include <AccCtrl.h>
 #include <AclAPI.h>
 
-#define ERROR_WAYPOINT_1 1
-#define ERROR_WAYPOINT_2 2
-#define ERROR_WAYPOINT_3 3
-#define ERROR_WAYPOINT_4 4
-
-#define ACL_INSUFFICIENT_MEMORY 2L
-#define ACL_UNKNOWN_ERROR 3L
-
+/// Gives SYSTEM, and nobody else, full control of the object. Returns zero or a Win32 error code.
 int SetObjectAsSystemOnly(LPWSTR objectName, SE_OBJECT_TYPE objectType);
 
-SC_HANDLE GetServiceHandleFromName(wchar_t* name);
\ No newline at end of file
+/// Opens a service for reading and writing its security descriptor. Close it with CloseServiceHandle().
+SC_HANDLE GetServiceHandleFromName(wchar_t* name);
+
+/// The service control manager, opened once with SC_MANAGER_CONNECT and kept for the life of the process.
+SC_HANDLE GetServiceManager();
@@ -0,0 +1,28 @@
+﻿/*
+* Copyright © 2019 Cloudveil Technology Inc.
+* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+using Filter.Platform.Common.Types;
+using System;
+using System.Collections.Generic;
+using System.Text;
+
+namespace Filter.Platform.Common
+{
+    /// <summary>
+    /// Latency histograms and counters for the code that runs on every request. Implementations must be cheap enough to
+    /// call on every sample from any thread. Use HotPathMetrics.Default to get the shared instance.
+    /// </summary>
+    public interface IHotPathMetrics
+    {
+        /// <param name="elapsedTicks">Duration in Stopwatch ticks, usually the difference of two Stopwatch.GetTimestamp() calls.</param>
+        void Record(HotPathMetric metric, long elapsedTicks);
+
+        void Add(HotPathCounter counter, long amount);
+
+        HotPathMetricsSnapshot Snapshot();
+    }
+}
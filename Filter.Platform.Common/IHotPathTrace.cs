@@ -0,0 +1,46 @@
+﻿/*
+* Copyright © 2019 Cloudveil Technology Inc.
+* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+using Filter.Platform.Common.Types;
+using System;
+using System.Collections.Generic;
+using System.Text;
+
+namespace Filter.Platform.Common
+{
+    /// <summary>
+    /// Buffered binary trace for events that happen too often to log one by one. Writes must be cheap and must not format
+    /// anything. A TraceDrainer reads the events back and formats them in the background.
+    /// </summary>
+    public interface IHotPathTrace
+    {
+        /// <summary>
+        /// Buffers an event.
+        /// </summary>
+        /// <returns>True when the buffer has filled far enough that it should be drained soon. This is returned once each
+        /// time it fills that far, so that nothing has to poll it often.</returns>
+        bool Write(TraceEventId id);
+        bool Write(TraceEventId id, long arg0);
+        bool Write(TraceEventId id, long arg0, long arg1);
+        bool Write(TraceEventId id, long arg0, long arg1, long arg2);
+
+        /// <summary>
+        /// Moves pending events into records. Only one thread drains at a time.
+        /// </summary>
+        /// <returns>The number of records filled in.</returns>
+        int Drain(TraceRecord[] records);
+
+        DateTime ToDateTime(long timestamp);
+
+        TraceOverflow Overflow { get; set; }
+
+        /// <summary>
+        /// Events dropped or overwritten before they could be drained.
+        /// </summary>
+        long Lost { get; }
+    }
+}
@@ -0,0 +1,33 @@
+﻿/*
+* Copyright © 2019 Cloudveil Technology Inc.
+* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+using Filter.Platform.Common.Types;
+using System;
+using System.Collections.Generic;
+using System.Text;
+
+namespace Filter.Platform.Common
+{
+    /// <summary>
+    /// Accounts for the memory the native filtering subsystems hold, and keeps each one to its limits. A subsystem that
+    /// reaches its hard limit does without rather than allocate past it. One past its soft limit is only asked to give
+    /// memory back when Relieve() is called.
+    /// </summary>
+    public interface IMemoryBudget
+    {
+        /// <summary>
+        /// Zero for either limit means none. Set limits before the lists are loaded, since they don't take back what is
+        /// already allocated.
+        /// </summary>
+        void SetLimits(MemoryTag tag, long softLimit, long hardLimit);
+
+        MemoryUsageSnapshot Snapshot();
+
+        /// <returns>How many subsystems were past their soft limit and asked to give memory back.</returns>
+        int Relieve();
+    }
+}
@@ -13,6 +13,7 @@ using Filter.Platform.Common.Util;
 using NLog;
 using System;
 using System.Collections.Generic;
+using System.Diagnostics;
 using System.Security;
 namespace CloudVeil.IPC
 {
@@ -280,6 +281,8 @@ namespace CloudVeil.IPC
         /// </summary>
         private readonly Logger logger;
 
+        private readonly IHotPathMetrics metrics;
+
         public bool WaitingForAuth
         {
             get
@@ -297,6 +300,7 @@ namespace CloudVeil.IPC
         public IPCServer()
         {
             logger = LoggerUtil.GetAppWideLogger();
+            metrics = HotPathMetrics.Default;
 
             var channel = string.Format("{0}.{1}", nameof(CloudVeil.IPC), FingerprintService.Default.Value2).ToLower();
 
@@ -705,6 +709,15 @@ namespace CloudVeil.IPC
             }
         }
 
+        private void pushToServer(BaseMessage msg)
+        {
+            long start = Stopwatch.GetTimestamp();
+
+            server.PushMessage(msg);
+
+            metrics?.Record(HotPathMetric.IpcSend, Stopwatch.GetTimestamp() - start);
+        }
+
         public override void PushMessage(BaseMessage msg, ReplyHandlerClass handler = null, int retryNum = 0)
         {
             if(waitingForAuth)
@@ -713,23 +726,23 @@ namespace CloudVeil.IPC
                 // been confirmed.
                 if(msg.GetType() == typeof(AuthenticationMessage))
                 {
-                    server.PushMessage(msg);
+                    pushToServer(msg);
                     addMessageHandler(msg, handler);
                 }
                 else if(msg.GetType() == typeof(RelaxedPolicyMessage))
                 {
-                    server.PushMessage(msg);
+                    pushToServer(msg);
                     addMessageHandler(msg, handler);
                 }
                 else if(msg.GetType() == typeof(NotifyBlockActionMessage))
                 {
-                    server.PushMessage(msg);
+                    pushToServer(msg);
                     addMessageHandler(msg, handler);
                 }
             }
             else
             {
-                server.PushMessage(msg);
+                pushToServer(msg);
             }
         }
 
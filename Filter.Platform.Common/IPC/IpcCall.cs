@@ -29,6 +29,10 @@ namespace CloudVeil.IPC
         SendEventLog,
         BugReportConfirmationValue,
         PortsValue,
-        RandomizePortsValue
+        RandomizePortsValue,
+        HotPathMetrics,
+        TraceEvents,
+        MemoryUsage,
+        StartupTrace
     }
 }
@@ -11,6 +11,7 @@ using System.Runtime.Serialization;
 using System.Runtime.Serialization.Formatters.Binary;
 using System.Threading;
 using CloudVeil.IPC.Messages;
+using Filter.Platform.Common.Types;
 using Filter.Platform.Common.Util;
 
 namespace Filter.Platform.Common.IPC
@@ -41,7 +42,7 @@ namespace Filter.Platform.Common.IPC
 
         public void PushMessage(BaseMessage msg)
         {
-            logger.Info($"PushMessage({msg.GetType().Name})");
+            HotPathTrace.Write(TraceEventId.IpcClientMessagePushed, HotPathTrace.Intern(msg.GetType().Name));
 
             IFormatter formatter = new BinaryFormatter();
 
@@ -70,7 +71,7 @@ namespace Filter.Platform.Common.IPC
 
         internal void ProcessMessageBytes(byte[] buffer)
         {
-            logger.Info("Message bytes received.");
+            HotPathTrace.Write(TraceEventId.IpcMessageReceived, buffer.Length);
 
             IFormatter formatter = new BinaryFormatter();
 
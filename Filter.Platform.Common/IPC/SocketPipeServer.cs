@@ -14,6 +14,7 @@ using System.Runtime.Serialization.Formatters.Binary;
 using System.Threading.Tasks;
 
 using CloudVeil.IPC.Messages;
+using Filter.Platform.Common.Types;
 using Filter.Platform.Common.Util;
 
 namespace Filter.Platform.Common.IPC
@@ -240,7 +241,7 @@ namespace Filter.Platform.Common.IPC
         {
             try
             {
-                logger.Info($"PushMessage({msg.GetType().Name}) {connectedClients.Count}");
+                HotPathTrace.Write(TraceEventId.IpcMessagePushed, HotPathTrace.Intern(msg.GetType().Name), connectedClients.Count);
 
                 IFormatter formatter = new BinaryFormatter();
 
@@ -301,7 +302,7 @@ namespace Filter.Platform.Common.IPC
 
         internal void ProcessMessageBytes(byte[] buffer)
         {
-            logger.Info("ProcessMessageBytes()");
+            HotPathTrace.Write(TraceEventId.IpcMessageReceived, buffer.Length);
 
             IFormatter formatter = new BinaryFormatter();
 
@@ -0,0 +1,42 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Text;
+
+namespace Filter.Platform.Common.Types
+{
+    /// <summary>
+    /// Latency metrics kept by IHotPathMetrics. The values index HotPathMetricsSnapshot.Latencies.
+    /// </summary>
+    public enum HotPathMetric
+    {
+        TriggerScan,
+        UrlLookup,
+        DiversionEvent,
+        ListReload,
+        IpcSend,
+        ConflictScan,
+        ScanWait
+    }
+
+    /// <summary>
+    /// Monotonic counters kept by IHotPathMetrics. The values index HotPathMetricsSnapshot.Counters.
+    /// </summary>
+    public enum HotPathCounter
+    {
+        BytesScanned,
+        TriggerMatches,
+        UrlsBlocked,
+        DiversionErrors,
+        VerdictHits,
+        VerdictMisses,
+        VerdictBytesSkipped,
+        ScansTruncated,
+        ScansDeferred,
+        ScansRefused,
+
+        /// <summary>
+        /// Text triggers the trigger index's memory limit kept out, over every list load.
+        /// </summary>
+        TriggersLeftOut
+    }
+}
@@ -0,0 +1,45 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Text;
+
+namespace Filter.Platform.Common.Types
+{
+    [Serializable]
+    public class LatencySummary
+    {
+        public long Count { get; set; }
+        public long TotalNanoseconds { get; set; }
+        public long MaxNanoseconds { get; set; }
+
+        public long P50Nanoseconds { get; set; }
+        public long P90Nanoseconds { get; set; }
+        public long P99Nanoseconds { get; set; }
+        public long P999Nanoseconds { get; set; }
+
+        public double MeanNanoseconds => Count == 0 ? 0 : (double)TotalNanoseconds / Count;
+    }
+
+    /// <summary>
+    /// Hot path metrics as of TakenAt, cumulative from service start. Subtract two snapshots to get the counts in between.
+    /// </summary>
+    [Serializable]
+    public class HotPathMetricsSnapshot
+    {
+        public DateTime TakenAt { get; set; }
+
+        /// <summary>
+        /// Indexed by HotPathMetric.
+        /// </summary>
+        public LatencySummary[] Latencies { get; set; }
+
+        /// <summary>
+        /// Indexed by HotPathCounter.
+        /// </summary>
+        public long[] Counters { get; set; }
+
+        /// <summary>
+        /// Threads that have recorded anything since the service started.
+        /// </summary>
+        public long Threads { get; set; }
+    }
+}
@@ -0,0 +1,21 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Text;
+
+namespace Filter.Platform.Common.Types
+{
+    /// <summary>
+    /// Subsystems whose memory IMemoryBudget accounts for. The values index MemoryUsageSnapshot.Tags.
+    /// </summary>
+    public enum MemoryTag
+    {
+        TriggerIndex,
+        VerdictCache,
+        ScanBuffers,
+
+        /// <summary>
+        /// Snapshots being saved.
+        /// </summary>
+        WarmStart
+    }
+}
@@ -0,0 +1,55 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Text;
+
+namespace Filter.Platform.Common.Types
+{
+    [Serializable]
+    public class MemoryTagUsage
+    {
+        public MemoryTag Tag { get; set; }
+
+        public long LiveBytes { get; set; }
+        public long PeakBytes { get; set; }
+
+        /// <summary>
+        /// Zero for no limit.
+        /// </summary>
+        public long SoftLimit { get; set; }
+        public long HardLimit { get; set; }
+
+        /// <summary>
+        /// Allocations turned down because they would have gone past the hard limit.
+        /// </summary>
+        public long Refused { get; set; }
+
+        /// <summary>
+        /// Allocations the subsystem couldn't do without that went past the hard limit anyway. Any at all mean the limit is
+        /// too tight.
+        /// </summary>
+        public long ForcedOverLimit { get; set; }
+
+        /// <summary>
+        /// Times the subsystem was asked to give memory back for being past its soft limit.
+        /// </summary>
+        public long Compactions { get; set; }
+    }
+
+    /// <summary>
+    /// Memory held by the service as of TakenAt. Peaks and counts are from service start.
+    /// </summary>
+    [Serializable]
+    public class MemoryUsageSnapshot
+    {
+        public DateTime TakenAt { get; set; }
+
+        /// <summary>
+        /// Indexed by MemoryTag.
+        /// </summary>
+        public MemoryTagUsage[] Tags { get; set; }
+
+        public long ManagedHeapBytes { get; set; }
+        public long WorkingSetBytes { get; set; }
+        public long PrivateBytes { get; set; }
+    }
+}
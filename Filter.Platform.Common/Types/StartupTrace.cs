@@ -0,0 +1,79 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Text;
+
+namespace Filter.Platform.Common.Types
+{
+    public enum StartupPhaseState
+    {
+        Pending,
+        Running,
+        Succeeded,
+        Failed
+    }
+
+    [Serializable]
+    public class StartupPhaseTiming
+    {
+        public string Name { get; set; }
+
+        public string[] DependsOn { get; set; }
+
+        public StartupPhaseState State { get; set; }
+
+        /// <summary>
+        /// Milliseconds from the start of the startup graph.
+        /// </summary>
+        public double StartMs { get; set; }
+        public double EndMs { get; set; }
+
+        /// <summary>
+        /// CPU time of the thread the phase ran on. Zero where the platform doesn't measure it.
+        /// </summary>
+        public double CpuMs { get; set; }
+
+        /// <summary>
+        /// The dependency that finished last, which is the one the phase was held up by. Null if it had none.
+        /// </summary>
+        public string WaitedOn { get; set; }
+
+        /// <summary>
+        /// On the chain of waits that ends with the last phase to finish, so one that made startup take longer.
+        /// </summary>
+        public bool Critical { get; set; }
+    }
+
+    /// <summary>
+    /// When each phase of the service's startup ran, in the order the phases were added.
+    /// </summary>
+    [Serializable]
+    public class StartupTrace
+    {
+        public DateTime StartedAt { get; set; }
+
+        /// <summary>
+        /// Milliseconds from the process starting to the startup graph starting.
+        /// </summary>
+        public double SinceProcessStartMs { get; set; }
+
+        /// <summary>
+        /// Milliseconds from the start of the graph to the end of its last phase.
+        /// </summary>
+        public double TotalMs { get; set; }
+
+        public StartupPhaseTiming[] Phases { get; set; }
+
+        public StartupPhaseTiming Phase(string name)
+        {
+            foreach (StartupPhaseTiming phase in Phases ?? new StartupPhaseTiming[0])
+            {
+                if (string.Equals(phase.Name, name, StringComparison.OrdinalIgnoreCase))
+                {
+                    return phase;
+                }
+            }
+
+            return null;
+        }
+    }
+}
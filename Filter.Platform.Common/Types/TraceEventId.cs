@@ -0,0 +1,44 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Text;
+
+namespace Filter.Platform.Common.Types
+{
+    /// <summary>
+    /// Events written to the hot path trace. String arguments are ids from HotPathTrace.Intern(). Add new events at the end
+    /// and give each one a format in HotPathTrace.
+    /// </summary>
+    public enum TraceEventId : ushort
+    {
+        None,
+
+        /// <summary>
+        /// Arg0: message size in bytes.
+        /// </summary>
+        IpcMessageReceived,
+
+        /// <summary>
+        /// Arg0: message type name. Arg1: number of connected clients.
+        /// </summary>
+        IpcMessagePushed,
+
+        /// <summary>
+        /// Arg0: message type name.
+        /// </summary>
+        IpcClientMessagePushed,
+
+        /// <summary>
+        /// Arg0: category id. Arg1: body size in bytes. The trigger itself isn't traced, since there are too many to
+        /// intern.
+        /// </summary>
+        TriggerMatched,
+
+        NoTriggersLoaded,
+
+        /// <summary>
+        /// Arg0: body size in bytes. Only its start was scanned, and the rest was let through under
+        /// ScanOverBudget.HeadOnly.
+        /// </summary>
+        TriggerScanTruncated
+    }
+}
@@ -0,0 +1,32 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Text;
+
+namespace Filter.Platform.Common.Types
+{
+    /// <summary>
+    /// What a thread does with new trace events while its buffer is full.
+    /// </summary>
+    public enum TraceOverflow
+    {
+        DropNewest,
+        OverwriteOldest
+    }
+
+    /// <summary>
+    /// One unformatted trace event. What the arguments mean depends on the TraceEventId.
+    /// </summary>
+    [Serializable]
+    public struct TraceRecord
+    {
+        public long Timestamp;
+        public int Thread;
+        public int EventId;
+        public int ArgCount;
+
+        public long Arg0;
+        public long Arg1;
+        public long Arg2;
+        public long Arg3;
+    }
+}
@@ -0,0 +1,48 @@
+﻿using Filter.Platform.Common.Types;
+using System;
+using System.Collections.Generic;
+using System.Text;
+
+namespace Filter.Platform.Common.Util
+{
+    public static class HotPathMetrics
+    {
+        private static object instanceLock = new object();
+        private static volatile bool resolved = false;
+        private static IHotPathMetrics instance = null;
+
+        /// <summary>
+        /// The platform's IHotPathMetrics, or null if it doesn't have one. Resolved once, the first time it is used after
+        /// the platform types have been registered.
+        /// </summary>
+        public static IHotPathMetrics Default
+        {
+            get
+            {
+                if (resolved)
+                {
+                    return instance;
+                }
+
+                lock (instanceLock)
+                {
+                    if (!resolved)
+                    {
+                        try
+                        {
+                            instance = PlatformTypes.New<IHotPathMetrics>();
+                        }
+                        catch (Exception ex)
+                        {
+                            LoggerUtil.GetAppWideLogger()?.Warn(ex, "Hot path metrics are not available on this platform.");
+                        }
+
+                        resolved = true;
+                    }
+
+                    return instance;
+                }
+            }
+        }
+    }
+}
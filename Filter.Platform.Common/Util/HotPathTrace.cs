@@ -0,0 +1,238 @@
+﻿using Filter.Platform.Common.Types;
+using System;
+using System.Collections.Concurrent;
+using System.Collections.Generic;
+using System.Text;
+
+namespace Filter.Platform.Common.Util
+{
+    /// <summary>
+    /// Writes events to the platform's IHotPathTrace. Platforms that don't have one get the events logged straight away
+    /// instead, the same way they were before the trace existed.
+    /// </summary>
+    public static class HotPathTrace
+    {
+        private class EventFormat
+        {
+            public EventFormat(string format, params int[] stringArgs)
+            {
+                Format = format;
+                StringArgs = stringArgs;
+            }
+
+            public string Format { get; private set; }
+
+            // Indexes of arguments that are interned strings.
+            public int[] StringArgs { get; private set; }
+        }
+
+        private static readonly Dictionary<TraceEventId, EventFormat> formats = new Dictionary<TraceEventId, EventFormat>()
+        {
+            { TraceEventId.IpcMessageReceived, new EventFormat("ProcessMessageBytes({0} bytes)") },
+            { TraceEventId.IpcMessagePushed, new EventFormat("PushMessage({0}) {1}", 0) },
+            { TraceEventId.IpcClientMessagePushed, new EventFormat("PushMessage({0})", 0) },
+            { TraceEventId.TriggerMatched, new EventFormat("Triggers successfully run. matchedCategory = {0}, {1} byte body") },
+            { TraceEventId.NoTriggersLoaded, new EventFormat("No text triggers loaded") },
+            { TraceEventId.TriggerScanTruncated, new EventFormat("Over scan budget, passed {0} byte body with only its head scanned") }
+        };
+
+        private static object instanceLock = new object();
+        private static volatile bool resolved = false;
+        private static IHotPathTrace instance = null;
+
+        /// <summary>
+        /// Raised on the writing thread when the trace has filled far enough that it should be drained soon. Handlers
+        /// should only wake the drainer.
+        /// </summary>
+        public static event EventHandler FillMarkReached;
+
+        private static ConcurrentDictionary<string, int> internIds = new ConcurrentDictionary<string, int>();
+        private static List<string> internedStrings = new List<string>() { null };
+
+        /// <summary>
+        /// The platform's IHotPathTrace, or null if it doesn't have one.
+        /// </summary>
+        public static IHotPathTrace Default
+        {
+            get
+            {
+                if (resolved)
+                {
+                    return instance;
+                }
+
+                lock (instanceLock)
+                {
+                    if (!resolved)
+                    {
+                        try
+                        {
+                            instance = PlatformTypes.New<IHotPathTrace>();
+                        }
+                        catch (Exception ex)
+                        {
+                            LoggerUtil.GetAppWideLogger()?.Warn(ex, "Hot path trace is not available on this platform. Trace events will be logged directly.");
+                        }
+
+                        resolved = true;
+                    }
+
+                    return instance;
+                }
+            }
+        }
+
+        /// <summary>
+        /// Returns a small id standing for text, for use as a trace argument. The same text always gets the same id, and
+        /// ids are never released, so only pass strings that come from a limited set.
+        /// </summary>
+        public static int Intern(string text)
+        {
+            if (text == null)
+            {
+                return 0;
+            }
+
+            int id;
+            if (internIds.TryGetValue(text, out id))
+            {
+                return id;
+            }
+
+            lock (internedStrings)
+            {
+                if (!internIds.TryGetValue(text, out id))
+                {
+                    id = internedStrings.Count;
+                    internedStrings.Add(text);
+                    internIds[text] = id;
+                }
+
+                return id;
+            }
+        }
+
+        public static string Lookup(long id)
+        {
+            lock (internedStrings)
+            {
+                return id > 0 && id < internedStrings.Count ? internedStrings[(int)id] : null;
+            }
+        }
+
+        public static void Write(TraceEventId id)
+        {
+            IHotPathTrace trace = Default;
+            if (trace != null)
+            {
+                if (trace.Write(id))
+                {
+                    fillMarkReached();
+                }
+            }
+            else
+            {
+                logDirectly(id, 0, 0, 0, 0);
+            }
+        }
+
+        public static void Write(TraceEventId id, long arg0)
+        {
+            IHotPathTrace trace = Default;
+            if (trace != null)
+            {
+                if (trace.Write(id, arg0))
+                {
+                    fillMarkReached();
+                }
+            }
+            else
+            {
+                logDirectly(id, 1, arg0, 0, 0);
+            }
+        }
+
+        public static void Write(TraceEventId id, long arg0, long arg1)
+        {
+            IHotPathTrace trace = Default;
+            if (trace != null)
+            {
+                if (trace.Write(id, arg0, arg1))
+                {
+                    fillMarkReached();
+                }
+            }
+            else
+            {
+                logDirectly(id, 2, arg0, arg1, 0);
+            }
+        }
+
+        public static void Write(TraceEventId id, long arg0, long arg1, long arg2)
+        {
+            IHotPathTrace trace = Default;
+            if (trace != null)
+            {
+                if (trace.Write(id, arg0, arg1, arg2))
+                {
+                    fillMarkReached();
+                }
+            }
+            else
+            {
+                logDirectly(id, 3, arg0, arg1, arg2);
+            }
+        }
+
+        private static void fillMarkReached()
+        {
+            try
+            {
+                FillMarkReached?.Invoke(null, EventArgs.Empty);
+            }
+            catch (Exception ex)
+            {
+                LoggerUtil.GetAppWideLogger()?.Warn(ex, "Failed to wake the hot path trace drainer.");
+            }
+        }
+
+        private static void logDirectly(TraceEventId id, int argCount, long arg0, long arg1, long arg2)
+        {
+            LoggerUtil.GetAppWideLogger()?.Info(Format(new TraceRecord()
+            {
+                EventId = (int)id,
+                ArgCount = argCount,
+                Arg0 = arg0,
+                Arg1 = arg1,
+                Arg2 = arg2
+            }));
+        }
+
+        public static string Format(TraceRecord record)
+        {
+            object[] args = new object[record.ArgCount];
+            long[] values = { record.Arg0, record.Arg1, record.Arg2, record.Arg3 };
+
+            for (int i = 0; i < args.Length && i < values.Length; i++)
+            {
+                args[i] = values[i];
+            }
+
+            EventFormat format;
+            if (!formats.TryGetValue((TraceEventId)record.EventId, out format))
+            {
+                return $"Trace event {record.EventId}: {string.Join(", ", args)}";
+            }
+
+            foreach (int index in format.StringArgs)
+            {
+                if (index < args.Length)
+                {
+                    args[index] = Lookup(values[index]);
+                }
+            }
+
+            return string.Format(format.Format, args);
+        }
+    }
+}
@@ -0,0 +1,159 @@
+﻿using Filter.Platform.Common.Types;
+using NLog;
+using System;
+using System.Collections.Generic;
+using System.Text;
+using System.Threading;
+
+namespace Filter.Platform.Common.Util
+{
+    /// <summary>
+    /// Periodically moves events out of an IHotPathTrace. The most recent ones are kept unformatted for Recent(), and
+    /// every event is formatted and written to the trace log if WriteToLog is set.
+    /// </summary>
+    public class TraceDrainer : IDisposable
+    {
+        /// <summary>
+        /// Name of the NLog logger that drained events are written to.
+        /// </summary>
+        public const string TraceLoggerName = "CloudVeilTrace";
+
+        private const int DrainBatchSize = 1024;
+
+        private IHotPathTrace trace;
+        private Logger traceLogger;
+        private Timer drainTimer;
+
+        private object drainLock = new object();
+        private TraceRecord[] batch = new TraceRecord[DrainBatchSize];
+
+        // Circular buffer of the most recently drained events. Guarded by recentLock.
+        private object recentLock = new object();
+        private TraceRecord[] recent;
+        private int recentNext = 0;
+        private int recentCount = 0;
+
+        private long lastLost = 0;
+
+        public TraceDrainer(IHotPathTrace trace, int recentCapacity = 8192)
+        {
+            if (trace == null)
+            {
+                throw new ArgumentNullException(nameof(trace));
+            }
+
+            this.trace = trace;
+            recent = new TraceRecord[recentCapacity];
+            traceLogger = LogManager.GetLogger(TraceLoggerName);
+        }
+
+        /// <summary>
+        /// If true, every drained event is formatted and written to the trace log.
+        /// </summary>
+        public bool WriteToLog { get; set; } = true;
+
+        public void Start(TimeSpan interval)
+        {
+            drainTimer?.Dispose();
+            drainTimer = new Timer((state) => Flush(), null, interval, interval);
+        }
+
+        /// <summary>
+        /// Drains everything that is pending right now.
+        /// </summary>
+        public void Flush()
+        {
+            // A slow log target shouldn't pile up timer callbacks behind each other.
+            if (!Monitor.TryEnter(drainLock))
+            {
+                return;
+            }
+
+            try
+            {
+                int drained;
+                do
+                {
+                    drained = trace.Drain(batch);
+                    keepRecent(batch, drained);
+
+                    if (WriteToLog)
+                    {
+                        for (int i = 0; i < drained; i++)
+                        {
+                            LogEventInfo info = new LogEventInfo(LogLevel.Info, TraceLoggerName, HotPathTrace.Format(batch[i]));
+                            info.TimeStamp = trace.ToDateTime(batch[i].Timestamp);
+                            traceLogger.Log(info);
+                        }
+                    }
+                } while (drained == batch.Length);
+
+                long lost = trace.Lost;
+                if (lost != lastLost)
+                {
+                    traceLogger.Warn("{0} trace events were lost because the trace buffers filled up.", lost - lastLost);
+                    lastLost = lost;
+                }
+            }
+            catch (Exception ex)
+            {
+                LoggerUtil.GetAppWideLogger()?.Error(ex, "Failed to drain hot path trace.");
+            }
+            finally
+            {
+                Monitor.Exit(drainLock);
+            }
+        }
+
+        private void keepRecent(TraceRecord[] records, int count)
+        {
+            lock (recentLock)
+            {
+                for (int i = 0; i < count; i++)
+                {
+                    recent[recentNext] = records[i];
+                    recentNext = (recentNext + 1) % recent.Length;
+                }
+
+                recentCount = Math.Min(recent.Length, recentCount + count);
+            }
+        }
+
+        /// <summary>
+        /// Formats up to count of the most recently drained events, oldest first.
+        /// </summary>
+        public List<string> Recent(int count)
+        {
+            Flush();
+
+            TraceRecord[] records;
+            lock (recentLock)
+            {
+                count = Math.Max(0, Math.Min(count, recentCount));
+                records = new TraceRecord[count];
+
+                int start = (recentNext - count + recent.Length) % recent.Length;
+                for (int i = 0; i < count; i++)
+                {
+                    records[i] = recent[(start + i) % recent.Length];
+                }
+            }
+
+            var lines = new List<string>(count);
+            foreach (var record in records)
+            {
+                lines.Add($"{trace.ToDateTime(record.Timestamp):yyyy-MM-dd HH:mm:ss.ffff} [{record.Thread}] {HotPathTrace.Format(record)}");
+            }
+
+            return lines;
+        }
+
+        public void Dispose()
+        {
+            drainTimer?.Dispose();
+            drainTimer = null;
+
+            Flush();
+        }
+    }
+}
@@ -25,8 +25,10 @@ using System.Collections.Concurrent;
 
 using Filter.Platform.Common.Util;
 using FilterProvider.Common.Data.Filtering;
+using FilterProvider.Common.Platform;
 using FilterProvider.Common.Util;
 using Filter.Platform.Common;
+using Filter.Platform.Common.Types;
 using System.Text.RegularExpressions;
 using DotNet.Globbing;
 using GoProxyWrapper;
@@ -80,6 +82,12 @@ namespace FilterProvider.Common.Configuration
 
         private BagOfTextTriggers textTriggers;
 
+        /// <summary>
+        /// What the triggers in textTriggers were loaded from, as computeTriggerPolicyHash has it. Null while warm start
+        /// snapshots are off.
+        /// </summary>
+        private byte[] triggerPolicyHash;
+
         /// <summary>
         /// Whenever we load filtering rules, we simply make up numbers for categories as we go
         /// along. We use this object to store what strings we map to numbers.
@@ -130,6 +138,7 @@ namespace FilterProvider.Common.Configuration
 
         public TimeRestrictionModel[] TimeRestrictions { get; private set; }
         public bool AreAnyTimeRestrictionsEnabled { get; private set; }
+        public TimeRestrictionSchedule TimeRestrictionSchedule { get; private set; }
 
         public event EventHandler OnConfigurationLoaded;
 
@@ -206,6 +215,147 @@ namespace FilterProvider.Common.Configuration
         private string getListFilePath(FilteringPlainTextListModel listModel)
             => getListFilePath(listModel.RelativeListPath);
 
+        private string getWarmStartPath() => paths.GetPath("triggers.warm");
+
+        /// <summary>
+        /// The snapshot holds every trigger in the clear, so it is stored sealed like the lists are, and authenticated so
+        /// that a file someone replaced with fewer triggers is never started from.
+        /// </summary>
+        private WarmStartStatus restoreWarmStartSnapshot(byte[] policyHash)
+        {
+            string path = getWarmStartPath();
+
+            if (!File.Exists(path))
+            {
+                return WarmStartStatus.Missing;
+            }
+
+            byte[] snapshot = RulesetEncryption.Unseal(File.ReadAllBytes(path));
+
+            if (snapshot == null)
+            {
+                logger.Warn("The warm start snapshot at {0} failed authentication. The trigger lists will be loaded instead.", path);
+                return WarmStartStatus.Unauthenticated;
+            }
+
+            return textTriggers.RestoreSnapshot(snapshot, policyHash);
+        }
+
+        private bool writeWarmStartSnapshot(byte[] snapshot)
+        {
+            byte[] sealedSnapshot = RulesetEncryption.Seal(snapshot);
+
+            if (sealedSnapshot == null)
+            {
+                return false;
+            }
+
+            // Written beside the file and moved over it, so that a crash never leaves part of a snapshot behind.
+            string path = getWarmStartPath();
+            string temporary = path + ".tmp";
+
+            File.WriteAllBytes(temporary, sealedSnapshot);
+
+            if (File.Exists(path))
+            {
+                File.Replace(temporary, path, null);
+            }
+            else
+            {
+                File.Move(temporary, path);
+            }
+
+            return true;
+        }
+
+        /// <summary>
+        /// Hashes everything the compiled text triggers depend on. Category ids are handed out in list order to lists of
+        /// every type, so every list counts, but only the trigger lists and custom triggers count byte for byte.
+        /// </summary>
+        private byte[] computeTriggerPolicyHash()
+        {
+            using (SHA256 sha = SHA256.Create())
+            {
+                byte[] buffer = new byte[64 * 1024];
+
+                Action<byte[]> add = (bytes) => sha.TransformBlock(bytes, 0, bytes.Length, null, 0);
+
+                foreach (var listModel in Configuration.ConfiguredLists)
+                {
+                    string path = getListFilePath(listModel);
+                    bool exists = File.Exists(path);
+
+                    add(Encoding.UTF8.GetBytes($"{listModel.ListType}\n{listModel.RelativeListPath}\n{(exists ? new FileInfo(path).Length : -1)}\n"));
+
+                    if (exists && listModel.ListType == PlainTextFilteringListType.TextTrigger)
+                    {
+                        using (var stream = File.OpenRead(path))
+                        {
+                            int read;
+
+                            while ((read = stream.Read(buffer, 0, buffer.Length)) > 0)
+                            {
+                                sha.TransformBlock(buffer, 0, read, null, 0);
+                            }
+                        }
+                    }
+                }
+
+                if (Configuration.CustomTriggerBlacklist != null)
+                {
+                    foreach (string trigger in Configuration.CustomTriggerBlacklist)
+                    {
+                        add(Encoding.UTF8.GetBytes($"{trigger}\n"));
+                    }
+                }
+
+                sha.TransformFinalBlock(buffer, 0, 0);
+                return sha.Hash;
+            }
+        }
+
+        public bool SaveWarmStartSnapshot()
+        {
+            if (!AppSettings.Default.WarmStartSnapshot)
+            {
+                return false;
+            }
+
+            try
+            {
+                policyLock.EnterReadLock();
+
+                if (textTriggers == null || triggerPolicyHash == null)
+                {
+                    return false;
+                }
+
+                long start = Stopwatch.GetTimestamp();
+                byte[] snapshot = textTriggers.SaveSnapshot(triggerPolicyHash, AppSettings.Default.WarmStartSnapshotVerdicts);
+                bool saved = snapshot != null && writeWarmStartSnapshot(snapshot);
+
+                if (saved)
+                {
+                    logger.Info("Saved the warm start snapshot in {0:F0} ms.", (Stopwatch.GetTimestamp() - start) * 1000.0 / Stopwatch.Frequency);
+                }
+                else
+                {
+                    logger.Warn("Could not save the warm start snapshot to {0}.", getWarmStartPath());
+                }
+
+                return saved;
+            }
+            catch (Exception ex)
+            {
+                LoggerUtil.RecursivelyLogException(logger, ex);
+                return false;
+            }
+            finally
+            {
+                policyLock.ExitReadLock();
+            }
+        }
+
         Dictionary<string, bool?> lastFilterListResults = null;
 
         public bool? VerifyLists()
@@ -487,6 +637,9 @@ namespace FilterProvider.Common.Configuration
 
         public bool LoadLists()
         {
+            long start = Stopwatch.GetTimestamp();
+            bool saveWarmStart = false;
+
             try
             {
                 policyLock.EnterWriteLock();
@@ -512,6 +665,17 @@ namespace FilterProvider.Common.Configuration
 
                     textTriggers = new BagOfTextTriggers(Path.Combine(AppDomain.CurrentDomain.BaseDirectory, "t.dat"), true, true, logger);
 
+                    // Trigger lists that haven't changed since the snapshot was saved don't have to be loaded again.
+                    triggerPolicyHash = AppSettings.Default.WarmStartSnapshot ? computeTriggerPolicyHash() : null;
+                    WarmStartStatus warmStart = WarmStartStatus.Missing;
+
+                    if (triggerPolicyHash != null)
+                    {
+                        warmStart = restoreWarmStartSnapshot(triggerPolicyHash);
+                    }
+
+                    bool triggersRestored = warmStart == WarmStartStatus.Loaded;
+
                     // Now clear all generated categories. These will be re-generated as needed.
                     generatedCategoriesMap.Clear();
 
@@ -569,7 +733,14 @@ namespace FilterProvider.Common.Configuration
                                 case PlainTextFilteringListType.TextTrigger:
                                     {
                                         // Always load triggers as blacklists.
-                                        if (TryFetchOrCreateCategoryMap(thisListCategoryName, listModel.ListType, out categoryModel))
+                                        if (triggersRestored)
+                                        {
+                                            if (TryFetchOrCreateCategoryMap(thisListCategoryName, listModel.ListType, out categoryModel) && textTriggers.HasCategory(categoryModel.CategoryId))
+                                            {
+                                                categoryIndex.SetIsCategoryEnabled(categoryModel.CategoryId, true);
+                                            }
+                                        }
+                                        else if (TryFetchOrCreateCategoryMap(thisListCategoryName, listModel.ListType, out categoryModel))
                                         {
                                             using (var listStream = File.OpenRead(rulesetPath))
                                             {
@@ -615,7 +786,14 @@ namespace FilterProvider.Common.Configuration
                         MappedFilterListCategoryModel categoryModel = null;
 
                         // Always load triggers as blacklists.
-                        if(TryFetchOrCreateCategoryMap("/user/trigger_blacklist", PlainTextFilteringListType.TextTrigger, out categoryModel))
+                        if(triggersRestored)
+                        {
+                            if(TryFetchOrCreateCategoryMap("/user/trigger_blacklist", PlainTextFilteringListType.TextTrigger, out categoryModel) && textTriggers.HasCategory(categoryModel.CategoryId))
+                            {
+                                categoryIndex.SetIsCategoryEnabled(categoryModel.CategoryId, true);
+                            }
+                        }
+                        else if(TryFetchOrCreateCategoryMap("/user/trigger_blacklist", PlainTextFilteringListType.TextTrigger, out categoryModel))
                         {
                             var triggersLoaded = textTriggers.LoadStoreFromList(Configuration.CustomTriggerBlacklist, categoryModel.CategoryId).Result;
 
@@ -630,6 +808,19 @@ namespace FilterProvider.Common.Configuration
                         }
                     }
 
+                    if (triggersRestored)
+                    {
+                        totalTriggersLoaded = (uint)textTriggers.NativeTriggerCount;
+                    }
+
+                    if (triggerPolicyHash != null)
+                    {
+                        logger.Info("Warm start snapshot {0}. Text triggers ready {1:F0} ms after lists started loading.", warmStart, (Stopwatch.GetTimestamp() - start) * 1000.0 / Stopwatch.Frequency);
+
+                        // The next start can then skip loading them, even if this run ends without a clean shutdown.
+                        saveWarmStart = !triggersRestored;
+                    }
+
                     if(Configuration != null && Configuration.CustomWhitelist != null && Configuration.CustomWhitelist.Count > 0)
                     {
                         AddCustomConfiguredSiteList(Configuration.CustomWhitelist, tempFolder, ".user.custowhitelist.rules.txt", "/user/custowhitelist", PlainTextFilteringListType.Whitelist, ListType.Whitelist);
@@ -648,6 +839,13 @@ namespace FilterProvider.Common.Configuration
                     textTriggers.FinalizeForRead();
                     textTriggers.InitializeBloomFilters();
 
+                    int triggersLeftOut = textTriggers.NativeRefusedTriggers;
+                    if (triggersLeftOut > 0)
+                    {
+                        logger.Error("The trigger index is at its memory limit. {0} text triggers were left out and won't be matched. Raise MemoryBudgets.TriggerIndex to load them.", triggersLeftOut);
+                        HotPathMetrics.Default?.Add(HotPathCounter.TriggersLeftOut, triggersLeftOut);
+                    }
+
                     ListsReloaded?.Invoke(this, new EventArgs());
 
                     logger.Info("Loaded {0} rules, {1} rules failed most likely due to being malformed, and {2} text triggers loaded.", totalFilterRulesLoaded, totalFilterRulesFailed, totalTriggersLoaded);
@@ -666,6 +864,13 @@ namespace FilterProvider.Common.Configuration
                 policyLock.ExitWriteLock();
 
                 deleteTemporaryLists();
+
+                HotPathMetrics.Default?.Record(HotPathMetric.ListReload, Stopwatch.GetTimestamp() - start);
+
+                if (saveWarmStart)
+                {
+                    SaveWarmStartSnapshot();
+                }
             }
         }
 
@@ -785,7 +990,8 @@ namespace FilterProvider.Common.Configuration
                         TimeRestrictions[i] = restriction;
                     }
 
-                    AreAnyTimeRestrictionsEnabled = TimeRestrictions.Any(r => r?.RestrictionsEnabled == true);
+                    TimeRestrictionSchedule = new TimeRestrictionSchedule(TimeRestrictions);
+                    AreAnyTimeRestrictionsEnabled = TimeRestrictionSchedule.AnyEnabled;
 
                     if (Configuration.CannotTerminate)
                     {
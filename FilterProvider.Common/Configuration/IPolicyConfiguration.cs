@@ -13,6 +13,7 @@ using System.Linq;
 using System.Text;
 using System.Threading.Tasks;
 using FilterProvider.Common.Data.Filtering;
+using FilterProvider.Common.Util;
 using DotNet.Globbing;
 using System.Threading;
 
@@ -58,6 +59,13 @@ namespace FilterProvider.Common.Configuration
         /// <returns></returns>
         bool LoadLists();
 
+        /// <summary>
+        /// Saves the compiled text triggers and the most used trigger verdicts, so that the next LoadLists with the same
+        /// lists starts from them.
+        /// </summary>
+        /// <returns>False if warm start snapshots are off, nothing is loaded, or the snapshot couldn't be written.</returns>
+        bool SaveWarmStartSnapshot();
+
         event EventHandler OnConfigurationLoaded;
 
         event EventHandler ListsReloaded;
@@ -94,5 +102,10 @@ namespace FilterProvider.Common.Configuration
         /// A cached boolean so we don't have to recalculate time restrictions enabled every time we want to get the value.
         /// </summary>
         bool AreAnyTimeRestrictionsEnabled { get; }
+
+        /// <summary>
+        /// TimeRestrictions compiled into a weekly bitmap when the configuration is loaded. Null until then.
+        /// </summary>
+        TimeRestrictionSchedule TimeRestrictionSchedule { get; }
     }
 }
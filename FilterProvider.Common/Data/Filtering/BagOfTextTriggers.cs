@@ -17,7 +17,10 @@ using System.Reflection;
 using NLog;
 using System.Diagnostics;
 using CloudVeil.Core.Windows.Util;
+using Filter.Platform.Common;
 using Filter.Platform.Common.Util;
+using FilterProvider.Common.Platform;
+using FilterProvider.Common.Util;
 
 namespace FilterProvider.Common.Data.Filtering
 {
@@ -64,6 +67,17 @@ namespace FilterProvider.Common.Data.Filtering
 
         private Logger logger;
 
+        /// <summary>
+        /// Platform trigger index that mirrors the database. When this is available, byte content is scanned with it
+        /// instead of the database.
+        /// </summary>
+        private ITextTriggerIndex nativeIndex;
+
+        /// <summary>
+        /// Used to pull the string values out of JSON content when there is no native index.
+        /// </summary>
+        private IContentExtractor contentExtractor;
+
         /// <summary>
         /// Constructs a new BagOfTextTriggers.
         /// </summary>
@@ -121,6 +135,35 @@ namespace FilterProvider.Common.Data.Filtering
             ConfigureDatabase();
 
             CreateTables();
+
+            try
+            {
+                nativeIndex = PlatformTypes.New<ITextTriggerIndex>();
+                nativeIndex.ParallelThreshold = AppSettings.Default.ParallelScanThreshold;
+                nativeIndex.ChunkSize = AppSettings.Default.ParallelScanChunkSize;
+                nativeIndex.VerdictCacheSize = AppSettings.Default.TriggerVerdictCacheSize;
+                nativeIndex.SetScanLimits(AppSettings.Default.TriggerScanLimits);
+
+                TriggerScanLimits limits = AppSettings.Default.TriggerScanLimits;
+                if (limits != null && limits.Enabled && limits.OverBudget == ScanOverBudget.HeadOnly)
+                {
+                    logger?.Warn("Trigger scans are set to HeadOnly. Under load, bodies past their first {0} bytes are let through unscanned.", limits.HeadSize);
+                }
+            }
+            catch(Exception ex)
+            {
+                nativeIndex = null;
+                logger?.Warn(ex, "No platform text trigger index available. Triggers will be matched from the database.");
+            }
+
+            try
+            {
+                contentExtractor = PlatformTypes.New<IContentExtractor>();
+            }
+            catch(Exception ex)
+            {
+                logger?.Warn(ex, "No platform content extractor available. JSON will be scanned raw.");
+            }
         }
 
         /// <summary>
@@ -279,13 +322,15 @@ namespace FilterProvider.Common.Data.Filtering
         private class StoreCommands : IDisposable
         {
             SqliteConnection connection;
+            ITextTriggerIndex nativeIndex;
 
             SqliteCommand firstWordCommand;
             SqliteCommand triggerCommand;
 
-            public StoreCommands(SqliteConnection connection)
+            public StoreCommands(SqliteConnection connection, ITextTriggerIndex nativeIndex)
             {
                 this.connection = connection;
+                this.nativeIndex = nativeIndex;
 
                 firstWordCommand = connection.CreateCommand();
                 triggerCommand = connection.CreateCommand();
@@ -322,6 +367,8 @@ namespace FilterProvider.Common.Data.Filtering
                     await triggerCommand.ExecuteNonQueryAsync();
                     await firstWordCommand.ExecuteNonQueryAsync();
 
+                    nativeIndex?.AddTrigger(trimmedLine, categoryId);
+
                     return true;
                 }
                 else
@@ -372,7 +419,7 @@ namespace FilterProvider.Common.Data.Filtering
             int loaded = 0;
             using (var transaction = connection.BeginTransaction())
             {
-                using (var storeCommands = new StoreCommands(connection))
+                using (var storeCommands = new StoreCommands(connection, nativeIndex))
                 {
                     foreach(string line in inputList)
                     {
@@ -407,7 +454,7 @@ namespace FilterProvider.Common.Data.Filtering
             int loaded = 0;
             using(var transaction = connection.BeginTransaction())
             {
-                using (var storeCommands = new StoreCommands(connection))
+                using (var storeCommands = new StoreCommands(connection, nativeIndex))
                 {
                     string line = null;
                     using (var sw = new StreamReader(inputStream))
@@ -721,6 +768,114 @@ namespace FilterProvider.Common.Data.Filtering
             return false;
         }
 
+        /// <summary>
+        /// Checks UTF-8 content for a trigger. This scans the bytes in place with the platform trigger index when there is
+        /// one, and otherwise decodes them and falls back to the string overload.
+        /// </summary>
+        /// <param name="isJson">
+        /// If true, only the string values of the JSON document are checked.
+        /// </param>
+        /// <remarks>
+        /// The platform index reports the trigger that starts earliest in the content, which is not always the one the
+        /// string overload finds first.
+        /// </remarks>
+        public bool ContainsTrigger(ArraySegment<byte> data, bool isJson, out short firstMatchCategory, out string matchedTrigger, Func<short, bool> categoryAppliesCb, bool rebuildAndTestFragments = false, int maxRebuildLen = -1)
+        {
+            firstMatchCategory = -1;
+            matchedTrigger = null;
+
+            if(!hasTriggers)
+            {
+                return false;
+            }
+
+            if(nativeIndex != null)
+            {
+                // Phrases are only ever assembled up to maxRebuildLen words, see the string overload.
+                return nativeIndex.ContainsTrigger(data.Array, data.Offset, data.Count, isJson, categoryAppliesCb, rebuildAndTestFragments ? maxRebuildLen : 1, out firstMatchCategory, out matchedTrigger);
+            }
+
+            string input;
+            if(isJson && contentExtractor != null)
+            {
+                // Only the string values of a JSON body can carry a trigger. Values are separated by a quote
+                // so that a phrase can't run across two of them, same as when the raw JSON was scanned.
+                input = contentExtractor.ExtractJsonStrings(data.Array, data.Offset, data.Count, '"');
+            }
+            else
+            {
+                input = Encoding.UTF8.GetString(data.Array, data.Offset, data.Count);
+            }
+
+            return ContainsTrigger(input, out firstMatchCategory, out matchedTrigger, categoryAppliesCb, rebuildAndTestFragments, maxRebuildLen);
+        }
+
+        /// <summary>
+        /// Like the ArraySegment overload of ContainsTrigger, but with the platform index the scan waits its turn and keeps
+        /// to AppSettings.TriggerScanLimits, so it may end before the whole body was checked.
+        /// </summary>
+        /// <param name="isDocument">
+        /// True for a top-level page, which is scanned ahead of everything it loads.
+        /// </param>
+        public TriggerScanOutcome ScanForTrigger(ArraySegment<byte> data, bool isJson, bool isDocument, out short firstMatchCategory, out string matchedTrigger, Func<short, bool> categoryAppliesCb, bool rebuildAndTestFragments = false, int maxRebuildLen = -1)
+        {
+            if(nativeIndex != null && hasTriggers)
+            {
+                return nativeIndex.ScanForTrigger(data.Array, data.Offset, data.Count, isJson, isDocument, categoryAppliesCb, rebuildAndTestFragments ? maxRebuildLen : 1, out firstMatchCategory, out matchedTrigger);
+            }
+
+            bool found = ContainsTrigger(data, isJson, out firstMatchCategory, out matchedTrigger, categoryAppliesCb, rebuildAndTestFragments, maxRebuildLen);
+            return found ? TriggerScanOutcome.Matched : TriggerScanOutcome.NoMatch;
+        }
+
+        /// <returns>Null without a platform index.</returns>
+        public TriggerScanCounters GetScanCounters()
+        {
+            return nativeIndex?.GetScanCounters();
+        }
+
+        /// <summary>
+        /// Starts the platform index from a snapshot SaveSnapshot wrote for the same policy hash, in place of loading the
+        /// trigger lists. Only the platform index is restored, so on Loaded the database stays empty and must not be
+        /// loaded on top; scans never reach it while the platform index is there.
+        /// </summary>
+        /// <returns>Missing without a platform index.</returns>
+        public WarmStartStatus RestoreSnapshot(byte[] snapshot, byte[] policyHash)
+        {
+            if(nativeIndex == null)
+            {
+                return WarmStartStatus.Missing;
+            }
+
+            WarmStartStatus status = nativeIndex.LoadSnapshot(snapshot, policyHash);
+            hasTriggers = status == WarmStartStatus.Loaded && nativeIndex.TriggerCount > 0;
+
+            return status;
+        }
+
+        /// <returns>Null without a platform index, or if the snapshot could not be made. It holds the trigger text in
+        /// the clear.</returns>
+        public byte[] SaveSnapshot(byte[] policyHash, int maxVerdicts)
+        {
+            return nativeIndex?.SaveSnapshot(policyHash, maxVerdicts);
+        }
+
+        /// <summary>
+        /// Triggers held by the platform index, which after RestoreSnapshot is the only place they are.
+        /// </summary>
+        public int NativeTriggerCount => nativeIndex?.TriggerCount ?? 0;
+
+        /// <summary>
+        /// Triggers the platform index left out for want of memory. Nothing matches them.
+        /// </summary>
+        public int NativeRefusedTriggers => nativeIndex?.RefusedTriggers ?? 0;
+
+        /// <returns>True if the platform index has a trigger in the category.</returns>
+        public bool HasCategory(short categoryId)
+        {
+            return nativeIndex != null && nativeIndex.HasCategory(categoryId);
+        }
+
         private static List<string> Split(string input)
         {
             var sb = new StringBuilder();
@@ -872,6 +1027,12 @@ namespace FilterProvider.Common.Data.Filtering
                         connection.Close();
                         connection = null;
                     }
+
+                    if(nativeIndex != null)
+                    {
+                        nativeIndex.Dispose();
+                        nativeIndex = null;
+                    }
                 }
 
                 // TODO: free unmanaged resources (unmanaged objects) and override a finalizer below.
@@ -6,6 +6,7 @@
 */
 
 using GoProxyWrapper;
+using Org.BouncyCastle.Crypto;
 using System;
 using System.Collections.Generic;
 using System.Text;
@@ -20,6 +21,11 @@ namespace FilterProvider.Common.Data
     {
         public string AuthorityName { get; set; }
 
+        /// <summary>
+        /// Key for the root certificate. Generated when the proxy starts if null.
+        /// </summary>
+        public AsymmetricCipherKeyPair RootKeyPair { get; set; }
+
         public NewHttpMessageHandler NewHttpMessageHandler { get; set; }
 
         public WholeBodyResponseHandler HttpMessageWholeBodyInspectionHandler { get; set; }
@@ -0,0 +1,42 @@
+/*
+* Copyright © 2019 Cloudveil Technology Inc.
+* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+
+using System;
+using System.Collections.Generic;
+using System.Net;
+using System.Text;
+
+namespace FilterProvider.Common.Platform
+{
+    /// <summary>
+    /// What an IDnsProbe found out about a name.
+    /// </summary>
+    public class DnsProbeResult
+    {
+        /// <summary>
+        /// True if a server answered with at least one address.
+        /// </summary>
+        public bool IsUp { get; set; }
+
+        /// <summary>
+        /// The server that answered, or null if none did or the result was cached.
+        /// </summary>
+        public IPAddress Server { get; set; }
+
+        public bool FromCache { get; set; }
+
+        public TimeSpan Elapsed { get; set; }
+
+        public IList<IPAddress> Addresses { get; set; }
+
+        /// <summary>
+        /// How much longer the answer holds.
+        /// </summary>
+        public TimeSpan Ttl { get; set; }
+    }
+}
@@ -0,0 +1,30 @@
+/*
+* Copyright © 2019 Cloudveil Technology Inc.
+* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+using System;
+
+namespace FilterProvider.Common.Platform
+{
+    /// <summary>
+    /// Platform-specific in-memory index of certificate exemptions. When the platform has one, CertificateExemptions
+    /// answers every check from it and only goes to its database to load at startup and to save new exemptions.
+    /// </summary>
+    public interface ICertificateExemptionIndex : IDisposable
+    {
+        /// <param name="thumbprint">The certificate's hash, as returned by X509Certificate.GetCertHash().</param>
+        bool IsExempted(byte[] thumbprint, string host);
+
+        /// <summary>
+        /// Adds an exemption, or changes when an existing one expires.
+        /// </summary>
+        /// <param name="expiresUtc">Null for an exemption that never expires.</param>
+        /// <returns>False if the index can't hold a thumbprint of this length.</returns>
+        bool Set(byte[] thumbprint, string host, DateTime? expiresUtc);
+
+        int Count { get; }
+    }
+}
@@ -0,0 +1,28 @@
+/*
+* Copyright © 2019 Cloudveil Technology Inc.
+* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+using System;
+using System.Collections.Generic;
+using System.Text;
+
+namespace FilterProvider.Common.Platform
+{
+    /// <summary>
+    /// Platform-specific fast paths for pulling classifiable text out of response bodies.
+    /// </summary>
+    public interface IContentExtractor
+    {
+        /// <summary>
+        /// Returns only the string values of a JSON document, with escapes decoded. Keys, numbers and punctuation are dropped.
+        /// </summary>
+        /// <remarks>
+        /// Must tolerate truncated and malformed JSON, returning whatever values could be recovered.
+        /// </remarks>
+        /// <param name="separator">Placed after each value so that callers can keep values apart.</param>
+        string ExtractJsonStrings(byte[] data, int offset, int count, char separator);
+    }
+}
@@ -0,0 +1,40 @@
+/*
+* Copyright © 2019 Cloudveil Technology Inc.
+* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+
+using System;
+using System.Collections.Generic;
+using System.Net;
+using System.Text;
+
+namespace FilterProvider.Common.Platform
+{
+    /// <summary>
+    /// Checks whether DNS servers are answering by querying all of them at once. Safe to use from any thread.
+    /// </summary>
+    public interface IDnsProbe : IDisposable
+    {
+        /// <summary>
+        /// Replaces the servers to query. What the probe has learned about servers still in the list is kept.
+        /// </summary>
+        void SetServers(IEnumerable<IPAddress> servers);
+
+        /// <summary>
+        /// Asks every server for the name's IPv4 addresses and returns as soon as one answers, or all have failed, or the
+        /// timeout passes.
+        /// </summary>
+        DnsProbeResult Probe(string name, TimeSpan timeout);
+
+        /// <summary>
+        /// Like Probe(), but reuses the last verdict for the name while its answer's TTL lasts, or for a short while
+        /// after no server answered.
+        /// </summary>
+        DnsProbeResult Resolve(string name, TimeSpan timeout);
+
+        void FlushCache();
+    }
+}
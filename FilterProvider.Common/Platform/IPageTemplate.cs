@@ -0,0 +1,30 @@
+/*
+* Copyright © 2019 Cloudveil Technology Inc.
+* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+using System;
+using System.Collections.Generic;
+using System.Text;
+
+namespace FilterProvider.Common.Platform
+{
+    /// <summary>
+    /// Platform-specific block page template that is compiled once and renders straight to UTF-8. Templates uses one for
+    /// each page when the platform has it, in place of Handlebars and string replacement.
+    /// </summary>
+    public interface IPageTemplate : IDisposable
+    {
+        /// <summary>
+        /// Compiles a template that uses {{name}}, {{{name}}}, {{#if name}}, {{else}} and {{#each name}} with {{@value}}.
+        /// </summary>
+        /// <param name="slotNames">Names the template may use. Values are passed to Render() in the same order.</param>
+        /// <exception cref="FormatException">The template uses anything else, or a name not in slotNames.</exception>
+        void Compile(byte[] source, string[] slotNames);
+
+        /// <param name="values">One per slot: a string, a byte array of UTF-8 text, a bool, a list of strings, or null.</param>
+        byte[] Render(object[] values);
+    }
+}
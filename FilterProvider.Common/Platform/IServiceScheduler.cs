@@ -0,0 +1,58 @@
+/*
+* Copyright © 2019 Cloudveil Technology Inc.
+* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+
+using System;
+using System.Collections.Generic;
+using System.Text;
+
+namespace FilterProvider.Common.Platform
+{
+    /// <summary>
+    /// Runs the service's periodic work from one timer wheel and one dispatcher thread, instead of a thread pool timer per
+    /// job. Near-simultaneous deadlines share a wakeup, a job never overlaps itself, and failing jobs can back off.
+    /// </summary>
+    public interface IServiceScheduler : IDisposable
+    {
+        /// <summary>
+        /// Registers a job. It does not run until started.
+        /// </summary>
+        /// <param name="job">Runs on the thread pool. Returns false if the run failed, which counts towards backoff.</param>
+        /// <param name="period">Time between runs. A run that takes longer than this delays the next one rather than
+        /// overlapping it. Zero for a job that only runs when started.</param>
+        /// <param name="slack">How late the job may run so that it can share a wakeup with other jobs.</param>
+        /// <param name="jitter">Fraction of each delay, below 1, that may randomly be taken off it. For jobs that call
+        /// our servers, so that clients don't all call at once.</param>
+        /// <param name="maxBackoff">If longer than the period, each failed run doubles the period, up to this.</param>
+        /// <returns>The id to start and stop the job with.</returns>
+        int AddJob(Func<bool> job, TimeSpan period, TimeSpan slack, double jitter = 0, TimeSpan maxBackoff = default(TimeSpan));
+
+        /// <summary>
+        /// Runs the job after delay and then every period, replacing any earlier start. If the job is running, this takes
+        /// effect once it finishes.
+        /// </summary>
+        void Start(int job, TimeSpan delay);
+
+        /// <summary>
+        /// Cancels the job's next run. A run in progress is not interrupted.
+        /// </summary>
+        void Stop(int job);
+
+        /// <summary>
+        /// Called from the job itself, moves its next run to period after this one. Otherwise takes effect the next
+        /// time the job is scheduled.
+        /// </summary>
+        void SetPeriod(int job, TimeSpan period);
+
+        /// <summary>
+        /// A counter of what happened over the last window, for thresholds that used to be reset by a timer.
+        /// </summary>
+        ISlidingWindowCounter NewCounter(TimeSpan window);
+
+        SchedulerCounters GetCounters();
+    }
+}
@@ -0,0 +1,28 @@
+/*
+* Copyright © 2019 Cloudveil Technology Inc.
+* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+
+using System;
+using System.Collections.Generic;
+using System.Text;
+
+namespace FilterProvider.Common.Platform
+{
+    /// <summary>
+    /// Total of what was added over a sliding window of time. Old amounts drop out on their own. Safe to use from any
+    /// thread.
+    /// </summary>
+    public interface ISlidingWindowCounter : IDisposable
+    {
+        /// <returns>The total over the window, including amount.</returns>
+        long Add(long amount = 1);
+
+        long Total { get; }
+
+        void Reset();
+    }
+}
@@ -0,0 +1,35 @@
+/*
+* Copyright © 2019 Cloudveil Technology Inc.
+* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+
+using Filter.Platform.Common.Types;
+using System;
+using System.Collections.Generic;
+using System.Text;
+
+namespace FilterProvider.Common.Platform
+{
+    /// <summary>
+    /// Runs the service's startup as a graph of phases. Each phase names the phases that have to finish before it, and
+    /// runs on the thread pool as soon as they have, so phases that don't need each other overlap.
+    /// </summary>
+    public interface IStartupGraph
+    {
+        /// <summary>
+        /// Adds a phase. Phases can't be added once the graph has run.
+        /// </summary>
+        /// <param name="run">Returns false if the phase failed. Phases that depend on it run all the same, since startup
+        /// carries on past a failed step, so they have to cope without whatever it would have done.</param>
+        /// <param name="dependsOn">Names of phases that have already been added.</param>
+        void AddPhase(string name, Func<bool> run, params string[] dependsOn);
+
+        /// <summary>
+        /// Runs every phase and returns once all of them have finished. A graph only runs once.
+        /// </summary>
+        StartupTrace Run();
+    }
+}
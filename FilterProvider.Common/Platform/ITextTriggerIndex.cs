@@ -0,0 +1,86 @@
+/*
+* Copyright © 2019 Cloudveil Technology Inc.
+* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+using System;
+using System.Collections.Generic;
+using System.Text;
+
+namespace FilterProvider.Common.Platform
+{
+    /// <summary>
+    /// Platform-specific trigger index that scans raw response bytes. BagOfTextTriggers mirrors every trigger it loads into
+    /// one of these when the platform has it, and uses it in place of the database lookups.
+    /// </summary>
+    public interface ITextTriggerIndex : IDisposable
+    {
+        /// <returns>False if the trigger has no words in it.</returns>
+        bool AddTrigger(string trigger, short categoryId);
+
+        int TriggerCount { get; }
+
+        /// <summary>
+        /// Triggers that were left out because the memory budget had no room for them, since the index was last cleared.
+        /// </summary>
+        int RefusedTriggers { get; }
+
+        /// <returns>True if at least one trigger is in the category.</returns>
+        bool HasCategory(short categoryId);
+
+        /// <summary>
+        /// Bodies larger than this many bytes are split into chunks and scanned in parallel. Zero disables chunking.
+        /// </summary>
+        int ParallelThreshold { get; set; }
+
+        /// <summary>
+        /// Approximate size of each chunk when a body is scanned in parallel.
+        /// </summary>
+        int ChunkSize { get; set; }
+
+        /// <summary>
+        /// Memory budget in bytes for the verdicts of content scanned before. Content that comes back byte for byte is not
+        /// scanned again. Zero disables the cache.
+        /// </summary>
+        int VerdictCacheSize { get; set; }
+
+        /// <summary>
+        /// Looks for a trigger in an enabled category within UTF-8 content. When several match, the one that starts
+        /// earliest in the content is reported.
+        /// </summary>
+        /// <param name="jsonStringsOnly">If true, the content is JSON and only its string values are scanned.</param>
+        /// <param name="maxPhraseWords">Longest phrase to try, in words. Anything below 1 means single words only.</param>
+        bool ContainsTrigger(byte[] data, int offset, int count, bool jsonStringsOnly, Func<short, bool> categoryAppliesCb, int maxPhraseWords, out short firstMatchCategory, out string matchedTrigger);
+
+        /// <summary>
+        /// Like ContainsTrigger, but waits for its turn and keeps to the limits given to SetScanLimits. Without limits it
+        /// scans everything, the same as ContainsTrigger.
+        /// </summary>
+        /// <param name="document">True for a top-level page, which is scanned ahead of what it loads.</param>
+        TriggerScanOutcome ScanForTrigger(byte[] data, int offset, int count, bool jsonStringsOnly, bool document, Func<short, bool> categoryAppliesCb, int maxPhraseWords, out short firstMatchCategory, out string matchedTrigger);
+
+        /// <summary>
+        /// Must not be called while a scan is running.
+        /// </summary>
+        void SetScanLimits(TriggerScanLimits limits);
+
+        TriggerScanCounters GetScanCounters();
+
+        /// <summary>
+        /// Lays out the compiled triggers, and up to maxVerdicts of the cached verdicts that were looked up most, as a
+        /// snapshot that LoadSnapshot can start from instead of adding every trigger again. The snapshot holds the trigger
+        /// text in the clear. Must not be called while triggers are being added.
+        /// </summary>
+        /// <param name="policyHash">Identifies the lists the triggers came from.</param>
+        /// <returns>Null if it couldn't be made.</returns>
+        byte[] SaveSnapshot(byte[] policyHash, int maxVerdicts);
+
+        /// <summary>
+        /// Replaces the triggers with the ones in a snapshot saved for the same policy hash. Anything but Loaded leaves the
+        /// index empty. Must not be called while a scan is running.
+        /// </summary>
+        WarmStartStatus LoadSnapshot(byte[] snapshot, byte[] policyHash);
+    }
+}
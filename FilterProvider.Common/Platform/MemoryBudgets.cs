@@ -0,0 +1,74 @@
+/*
+* Copyright © 2019 Cloudveil Technology Inc.
+* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+using Filter.Platform.Common.Types;
+using System;
+using System.Collections.Generic;
+using System.Text;
+
+namespace FilterProvider.Common.Platform
+{
+    /// <summary>
+    /// Limits in bytes for one subsystem. Zero for no limit.
+    /// </summary>
+    public class MemoryLimit
+    {
+        /// <summary>
+        /// Past this, the subsystem is asked to give memory back every time memory use is logged.
+        /// </summary>
+        public long Soft { get; set; }
+
+        /// <summary>
+        /// The subsystem never goes past this. It leaves out whatever doesn't fit instead.
+        /// </summary>
+        public long Hard { get; set; }
+    }
+
+    /// <summary>
+    /// How much memory each of the native filtering subsystems may hold. Applied once, before the lists are loaded.
+    /// </summary>
+    public class MemoryBudgets
+    {
+        public bool Enabled { get; set; } = true;
+
+        /// <summary>
+        /// Text triggers that don't fit are not loaded, and a warm start snapshot that doesn't fit is loaded the slow way.
+        /// Triggers left out are logged as an error and counted in HotPathCounter.TriggersLeftOut, since pages with them
+        /// get through.
+        /// </summary>
+        public MemoryLimit TriggerIndex { get; set; } = new MemoryLimit() { Hard = 256L * 1024 * 1024 };
+
+        /// <summary>
+        /// The cache is made smaller than AppSettings.TriggerVerdictCacheSize if that doesn't fit.
+        /// </summary>
+        public MemoryLimit VerdictCache { get; set; } = new MemoryLimit() { Hard = 64L * 1024 * 1024 };
+
+        /// <summary>
+        /// Scratch memory kept by the threads that scan bodies. Buffers that don't fit are freed after every scan.
+        /// </summary>
+        public MemoryLimit ScanBuffers { get; set; } = new MemoryLimit() { Soft = 16L * 1024 * 1024, Hard = 64L * 1024 * 1024 };
+
+        /// <summary>
+        /// The copy of the triggers and verdicts held while a warm start snapshot is saved. A snapshot that doesn't fit
+        /// isn't saved.
+        /// </summary>
+        public MemoryLimit WarmStart { get; set; } = new MemoryLimit() { Hard = 256L * 1024 * 1024 };
+
+        /// <returns>The limits for a tag, or null if it has none configured.</returns>
+        public MemoryLimit For(MemoryTag tag)
+        {
+            switch (tag)
+            {
+                case MemoryTag.TriggerIndex: return TriggerIndex;
+                case MemoryTag.VerdictCache: return VerdictCache;
+                case MemoryTag.ScanBuffers: return ScanBuffers;
+                case MemoryTag.WarmStart: return WarmStart;
+                default: return null;
+            }
+        }
+    }
+}
@@ -0,0 +1,49 @@
+/*
+* Copyright © 2019 Cloudveil Technology Inc.
+* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+
+using System;
+using System.Collections.Generic;
+using System.Text;
+
+namespace FilterProvider.Common.Platform
+{
+    /// <summary>
+    /// What an IServiceScheduler has done since it was created.
+    /// </summary>
+    public class SchedulerCounters
+    {
+        /// <summary>
+        /// Times the scheduler woke up to look for due jobs.
+        /// </summary>
+        public long Wakeups { get; set; }
+
+        /// <summary>
+        /// Wakeups that found nothing to run.
+        /// </summary>
+        public long IdleWakeups { get; set; }
+
+        public long Runs { get; set; }
+
+        public long Failures { get; set; }
+
+        /// <summary>
+        /// Runs that shared a wakeup with another job.
+        /// </summary>
+        public long Coalesced { get; set; }
+
+        /// <summary>
+        /// Runs and starts that came while the job was still running and waited for it to finish.
+        /// </summary>
+        public long Deferred { get; set; }
+
+        public override string ToString()
+        {
+            return $"{Wakeups} wakeups ({IdleWakeups} idle), {Runs} runs ({Failures} failed, {Coalesced} coalesced), {Deferred} deferred";
+        }
+    }
+}
@@ -0,0 +1,65 @@
+/*
+* Copyright © 2019 Cloudveil Technology Inc.
+* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+
+namespace FilterProvider.Common.Platform
+{
+    /// <summary>
+    /// Names of the startup phases the common service adds, for platform extensions to depend on, and of the ones the
+    /// platform extensions add. Trust, Update and LogCleanup are in the background graph, so nothing in the foreground
+    /// one can depend on them.
+    /// </summary>
+    public static class StartupPhases
+    {
+        /// <summary>
+        /// The firewall lets the service through. Anything that goes to the network depends on it.
+        /// </summary>
+        public const string Firewall = "firewall";
+
+        public const string RootKey = "rootKey";
+        public const string ServerKey = "serverKey";
+
+        /// <summary>
+        /// The configuration saved by the last run is loaded, if there is one.
+        /// </summary>
+        public const string Configuration = "configuration";
+
+        /// <summary>
+        /// The filter lists saved by the last run are loaded, if there was a configuration to load them with.
+        /// </summary>
+        public const string Lists = "lists";
+
+        public const string Proxy = "proxy";
+        public const string Filtering = "filtering";
+        public const string ControlServer = "controlServer";
+        public const string Trust = "trust";
+        public const string ProtectiveServices = "protectiveServices";
+        public const string LogCleanup = "logCleanup";
+        public const string Dns = "dns";
+
+        /// <summary>
+        /// Configuration and lists are checked with the server, and reloaded if they changed. Being in the background
+        /// graph, it runs after Diverter, which has to hook the auth token events before the check can raise them.
+        /// </summary>
+        public const string Update = "update";
+
+        /// <summary>
+        /// Software known to conflict with the filter is looked for and reported to the GUI. Windows only.
+        /// </summary>
+        public const string Conflicts = "conflicts";
+
+        /// <summary>
+        /// Whether the internet can be reached before the diverter starts, to compare with afterwards. Windows only.
+        /// </summary>
+        public const string Connectivity = "connectivity";
+
+        /// <summary>
+        /// The diverter follows port changes and the auth token events, which start and stop it. Windows only.
+        /// </summary>
+        public const string Diverter = "diverter";
+    }
+}
@@ -0,0 +1,80 @@
+/*
+* Copyright © 2019 Cloudveil Technology Inc.
+* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+
+using System;
+using System.Collections.Generic;
+using System.Text;
+
+namespace FilterProvider.Common.Platform
+{
+    /// <summary>
+    /// How an ITextTriggerIndex.ScanForTrigger call ended.
+    /// </summary>
+    public enum TriggerScanOutcome
+    {
+        NoMatch,
+        Matched,
+
+        /// <summary>
+        /// Only the start of the body was scanned, and nothing matched there.
+        /// </summary>
+        Truncated,
+
+        /// <summary>
+        /// The body went over budget under ScanOverBudget.FailClosed, or waited out MaxDeferMs under
+        /// ScanOverBudget.Defer, and has to be blocked.
+        /// </summary>
+        Refused
+    }
+
+    /// <summary>
+    /// What the scan scheduler of an ITextTriggerIndex has done since its limits were last set.
+    /// </summary>
+    public class TriggerScanCounters
+    {
+        /// <summary>
+        /// Parts of bodies waiting to be scanned now, and the most that ever waited.
+        /// </summary>
+        public long Queued { get; set; }
+        public long MaxQueued { get; set; }
+
+        public long Running { get; set; }
+
+        public long Bodies { get; set; }
+        public long Parts { get; set; }
+
+        public long Matched { get; set; }
+        public long Truncated { get; set; }
+        public long Refused { get; set; }
+
+        /// <summary>
+        /// Times a body went over budget, by reason.
+        /// </summary>
+        public long OverRequestBudget { get; set; }
+        public long OverGlobalBudget { get; set; }
+        public long OverQueueLimit { get; set; }
+        public long OverWaitLimit { get; set; }
+
+        public long Deferred { get; set; }
+        public long DeferExpired { get; set; }
+
+        public TimeSpan TotalWait { get; set; }
+        public TimeSpan MaxWait { get; set; }
+        public TimeSpan ScanTime { get; set; }
+
+        public override string ToString()
+        {
+            double meanWaitMs = Parts > 0 ? TotalWait.TotalMilliseconds / Parts : 0;
+
+            return $"{Bodies} bodies in {Parts} parts ({Matched} matched, {Truncated} truncated, {Refused} refused), " +
+                $"over budget {OverRequestBudget} per body, {OverGlobalBudget} global, {OverQueueLimit} queue full, {OverWaitLimit} waited too long, " +
+                $"{Deferred} deferred ({DeferExpired} expired), {Queued} queued (max {MaxQueued}), " +
+                $"wait {meanWaitMs:0.###} ms mean, {MaxWait.TotalMilliseconds:0.###} ms max, {ScanTime.TotalMilliseconds:0} ms scanning";
+        }
+    }
+}
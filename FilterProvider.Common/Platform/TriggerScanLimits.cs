@@ -0,0 +1,83 @@
+/*
+* Copyright © 2019 Cloudveil Technology Inc.
+* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+
+using System;
+using System.Collections.Generic;
+using System.Text;
+
+namespace FilterProvider.Common.Platform
+{
+    /// <summary>
+    /// How ITextTriggerIndex.ScanForTrigger finishes a body once scanning the rest of it would go over budget.
+    /// </summary>
+    public enum ScanOverBudget
+    {
+        /// <summary>
+        /// Only what was scanned so far counts, and the rest of the body is let through unscanned. This fails open, so
+        /// it is only for machines where page latency matters more than what gets past the filter.
+        /// </summary>
+        HeadOnly,
+
+        /// <summary>
+        /// The rest of the body waits behind everything else until there is budget for it. A body still waiting after
+        /// MaxDeferMs is blocked, as under FailClosed.
+        /// </summary>
+        Defer,
+
+        /// <summary>
+        /// A body that can't be scanned in full is blocked.
+        /// </summary>
+        FailClosed
+    }
+
+    /// <summary>
+    /// How ITextTriggerIndex.ScanForTrigger shares the processors between bodies. The first HeadSize bytes of every body
+    /// are scanned ahead of the rest of any body, top-level pages first. The rest is scanned in parts of the same size
+    /// while there is budget for it.
+    /// </summary>
+    public class TriggerScanLimits
+    {
+        /// <summary>
+        /// False to scan every body in full on its own request thread, as soon as it comes.
+        /// </summary>
+        public bool Enabled { get; set; } = true;
+
+        /// <summary>
+        /// Parts of bodies scanned at once. Zero for one less than the number of processors, but at least one.
+        /// </summary>
+        public int Slots { get; set; } = 0;
+
+        public int HeadSize { get; set; } = 64 * 1024;
+
+        /// <summary>
+        /// Scan time one body may use. Zero for no limit.
+        /// </summary>
+        public double RequestBudgetMs { get; set; } = 50;
+
+        /// <summary>
+        /// Fraction of all processors that scans together may use, averaged over WindowMs. Zero for no limit.
+        /// </summary>
+        public double ProcessorShare { get; set; } = 0.5;
+
+        public int WindowMs { get; set; } = 250;
+
+        /// <summary>
+        /// How long a part past the head may wait for a slot before the body counts as over budget. Zero for no limit.
+        /// </summary>
+        public int MaxWaitMs { get; set; } = 200;
+
+        /// <summary>
+        /// How many parts past the head may wait at once. Zero for no limit.
+        /// </summary>
+        public int MaxQueued { get; set; } = 64;
+
+        public ScanOverBudget OverBudget { get; set; } = ScanOverBudget.Defer;
+
+        public int MaxDeferMs { get; set; } = 2000;
+    }
+}
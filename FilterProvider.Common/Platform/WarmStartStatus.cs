@@ -0,0 +1,48 @@
+/*
+* Copyright © 2019 Cloudveil Technology Inc.
+* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+using System;
+using System.Collections.Generic;
+using System.Text;
+
+namespace FilterProvider.Common.Platform
+{
+    /// <summary>
+    /// What ITextTriggerIndex.LoadSnapshot made of a warm start snapshot. Anything but Loaded means the lists have to be
+    /// loaded the slow way.
+    /// </summary>
+    public enum WarmStartStatus
+    {
+        Loaded,
+        Missing,
+
+        /// <summary>
+        /// Damaged, or cut short while it was written.
+        /// </summary>
+        Corrupt,
+
+        /// <summary>
+        /// Written by a build with another snapshot layout.
+        /// </summary>
+        Incompatible,
+
+        /// <summary>
+        /// Written for other lists.
+        /// </summary>
+        Stale,
+
+        /// <summary>
+        /// Bigger than the trigger index's memory budget allows.
+        /// </summary>
+        OverBudget,
+
+        /// <summary>
+        /// Not sealed with this build's key, or changed since. Never handed to the index.
+        /// </summary>
+        Unauthenticated
+    }
+}
@@ -0,0 +1,192 @@
+/*
+* Copyright © 2019 Cloudveil Technology Inc.
+* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+using Filter.Platform.Common.Util;
+using Org.BouncyCastle.Crypto;
+using Org.BouncyCastle.Crypto.Parameters;
+using Org.BouncyCastle.OpenSsl;
+using System;
+using System.Collections.Generic;
+using System.IO;
+using System.Threading;
+
+namespace FilterProvider.Common.Proxy.Certificate
+{
+    /// <summary>
+    /// RSA key pairs generated in the background and kept on disk for the next start, so that making the root and
+    /// localhost certificates doesn't wait on key generation. A pair is removed from the file before it is handed out, so
+    /// none is ever used twice.
+    /// </summary>
+    public class KeyPairPool
+    {
+        private object sync = new object();
+
+        private string path;
+        private int keyStrength;
+        private int capacity;
+
+        // Null until the file has been read.
+        private Queue<AsymmetricCipherKeyPair> stored;
+
+        private int takenFromPool;
+        private int generatedOnDemand;
+
+        private NLog.Logger logger;
+
+        /// <param name="capacity">Pairs to keep stored. One per key a start needs.</param>
+        public KeyPairPool(string path, int keyStrength, int capacity)
+        {
+            this.path = path;
+            this.keyStrength = keyStrength;
+            this.capacity = capacity;
+
+            logger = LoggerUtil.GetAppWideLogger();
+        }
+
+        /// <summary>
+        /// Pairs handed out from the pool, and pairs that had to be generated because it was empty.
+        /// </summary>
+        public int TakenFromPool => takenFromPool;
+        public int GeneratedOnDemand => generatedOnDemand;
+
+        /// <summary>
+        /// A stored pair if there is one, otherwise a new one. Pairs are generated outside the lock, so callers on
+        /// different threads generate theirs at the same time.
+        /// </summary>
+        public AsymmetricCipherKeyPair Take()
+        {
+            lock (sync)
+            {
+                load();
+
+                if (stored.Count > 0)
+                {
+                    AsymmetricCipherKeyPair pair = stored.Dequeue();
+                    save();
+
+                    Interlocked.Increment(ref takenFromPool);
+                    return pair;
+                }
+            }
+
+            Interlocked.Increment(ref generatedOnDemand);
+            return BCCertificateMaker.CreateKeyPair(keyStrength);
+        }
+
+        /// <summary>
+        /// Generates pairs until the pool is full again. Each one takes a good share of a second of CPU, so this is for a
+        /// background thread once startup is done.
+        /// </summary>
+        /// <returns>How many pairs were generated.</returns>
+        public int Refill()
+        {
+            int generated = 0;
+
+            while (true)
+            {
+                lock (sync)
+                {
+                    load();
+
+                    if (stored.Count >= capacity)
+                    {
+                        return generated;
+                    }
+                }
+
+                AsymmetricCipherKeyPair pair = BCCertificateMaker.CreateKeyPair(keyStrength);
+                generated++;
+
+                lock (sync)
+                {
+                    stored.Enqueue(pair);
+                    save();
+                }
+            }
+        }
+
+        private void load()
+        {
+            if (stored != null)
+            {
+                return;
+            }
+
+            stored = new Queue<AsymmetricCipherKeyPair>();
+
+            if (!File.Exists(path))
+            {
+                return;
+            }
+
+            try
+            {
+                using (StreamReader reader = new StreamReader(path))
+                {
+                    PemReader pem = new PemReader(reader);
+                    object item;
+
+                    while ((item = pem.ReadObject()) != null)
+                    {
+                        AsymmetricCipherKeyPair pair = item as AsymmetricCipherKeyPair;
+                        RsaKeyParameters key = pair?.Private as RsaKeyParameters;
+
+                        // Pairs from a run that used another key strength are left to be overwritten.
+                        if (key != null && key.Modulus.BitLength == keyStrength)
+                        {
+                            stored.Enqueue(pair);
+                        }
+                    }
+                }
+            }
+            catch (Exception ex)
+            {
+                logger.Warn(ex, "Unable to read the pregenerated key pairs. They will be generated again.");
+                stored.Clear();
+            }
+        }
+
+        private void save()
+        {
+            // Written beside the file and moved over it, so that a crash never leaves part of a key behind.
+            string temporary = path + ".tmp";
+
+            try
+            {
+                using (StreamWriter writer = new StreamWriter(new FileStream(temporary, FileMode.Create, FileAccess.Write)))
+                {
+                    foreach (AsymmetricCipherKeyPair pair in stored)
+                    {
+                        BCCertificateMaker.ExportPrivateKey(pair.Private, writer);
+                    }
+                }
+
+                if (File.Exists(path))
+                {
+                    File.Replace(temporary, path, null);
+                }
+                else
+                {
+                    File.Move(temporary, path);
+                }
+            }
+            catch (Exception ex)
+            {
+                logger.Warn(ex, "Unable to save the pregenerated key pairs.");
+
+                // A pair that has been handed out mustn't still be in the file next time.
+                try
+                {
+                    File.Delete(path);
+                }
+                catch (Exception)
+                {
+                }
+            }
+        }
+    }
+}
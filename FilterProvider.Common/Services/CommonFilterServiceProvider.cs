@@ -233,7 +233,13 @@ namespace FilterProvider.Common.Services
 
         private IProxyServer filteringEngine;
 
-        private BackgroundWorker filterEngineStartupBgWorker;
+        /// <summary>
+        /// Keys for the root and localhost certificates, generated in the background for the next start.
+        /// </summary>
+        private KeyPairPool keyPairs;
+
+        private AsymmetricCipherKeyPair rootKeyPair;
+        private AsymmetricCipherKeyPair serverKeyPair;
 
         private static readonly DateTime epoch = new DateTime(1970, 1, 1);
 
@@ -251,14 +257,61 @@ namespace FilterProvider.Common.Services
         private UpdateSystem updateSystem;
 
         /// <summary>
-        /// Timer used to query for filter list changes every X minutes, as well as application updates. 
+        /// Runs the periodic work below from one timer wheel instead of a thread pool timer each.
         /// </summary>
-        private Timer updateCheckTimer;
+        private IServiceScheduler scheduler;
 
         /// <summary>
-        /// Timer used to cleanup logs every 12 hours.
+        /// Job used to query for filter list changes every X minutes, as well as application updates. 
         /// </summary>
-        private Timer cleanupLogsTimer;
+        private int updateCheckJob;
+
+        /// <summary>
+        /// Job used to cleanup logs every 12 hours.
+        /// </summary>
+        private int cleanupLogsJob;
+
+        /// <summary>
+        /// Drains the hot path trace every traceIdleDrainPeriod, so that events reach the trace log even when it is quiet.
+        /// </summary>
+        private int traceDrainJob;
+
+        /// <summary>
+        /// Drains the hot path trace straight away when HotPathTrace.FillMarkReached says it is filling up. No slack, since
+        /// the buffers could fill before a shared wakeup came round.
+        /// </summary>
+        private int traceFillDrainJob;
+
+        /// <summary>
+        /// Logs the service's memory use every 30 seconds.
+        /// </summary>
+        private int memoryMonitorJob;
+
+        /// <summary>
+        /// Saves the warm start snapshot every AppSettings.WarmStartSnapshotIntervalMinutes, so that a crash doesn't lose
+        /// the verdicts cached since the last one.
+        /// </summary>
+        private int warmStartSnapshotJob;
+
+        /// <summary>
+        /// Drains the hot path trace into the trace log. Null if the platform has no trace.
+        /// </summary>
+        private TraceDrainer traceDrainer;
+
+        /// <summary>
+        /// Keeps the native subsystems to AppSettings.MemoryBudgets. Null if the platform doesn't account for them.
+        /// </summary>
+        private IMemoryBudget memoryBudget;
+
+        /// <summary>
+        /// Refused allocations per MemoryTag as of the last memory log, so that only new ones are warned about.
+        /// </summary>
+        private long[] memoryRefusals;
+
+        /// <summary>
+        /// When each startup phase ran. Null until they have all finished.
+        /// </summary>
+        private StartupTrace startupTrace;
 
         /// <summary>
         /// Keep track of the last time we printed the username of the current user so we can output it
@@ -307,26 +360,42 @@ namespace FilterProvider.Common.Services
         RelaxedPolicy relaxedPolicy;
 
         /// <summary>
-        /// This int stores the number of block actions that have elapsed within the given threshold timespan.
+        /// Counts the block actions within the last threshold trigger period. Older ones drop out on their own.
+        /// </summary>
+        private ISlidingWindowCounter thresholdCounter;
+
+        /// <summary>
+        /// This job is used when the threshold has been hit. It is used to set an expiry period
+        /// for the internet lockout once the threshold has been hit.
         /// </summary>
-        private long thresholdTicks;
+        private int thresholdEnforcementJob;
 
         /// <summary>
-        /// This timer resets the threshold tick count. 
+        /// Wakes up when time restrictions next start or stop applying, to tell the GUI.
         /// </summary>
-        private Timer thresholdCountTimer;
+        private int timeRestrictionsJob;
 
         /// <summary>
-        /// This timer is used when the threshold has been hit. It is used to set an expiry period
-        /// for the internet lockout once the threshold has been hit.
+        /// Longest the time restrictions job sleeps. TimeDetection only notices a zone change when something asks it
+        /// for the time, so with no traffic this is how long one can go unnoticed.
+        /// </summary>
+        private static readonly TimeSpan maxTimeRestrictionsWait = TimeSpan.FromMinutes(5);
+
+        /// <summary>
+        /// Longest a trace event waits to reach the trace log while the trace is quiet. A busy trace is drained as it
+        /// fills up instead.
         /// </summary>
-        private Timer thresholdEnforcementTimer;
+        private static readonly TimeSpan traceIdleDrainPeriod = TimeSpan.FromSeconds(10);
+
+        private object timeRestrictionsLock = new object();
 
         /// <summary>
-        /// Allows us to periodically check status of time restrictions.
+        /// What the GUI was last told: null when no restrictions are set up, otherwise whether they're blocking access.
         /// </summary>
-        private Timer timeRestrictionsTimer;
-        private Timer retrieveTokenTimer;
+        private bool? timeRestrictionsActive;
+        private bool timeRestrictionsStateSent;
+
+        private int retrieveTokenJob;
 
         private SiteFiltering siteFiltering;
 
@@ -350,6 +419,19 @@ namespace FilterProvider.Common.Services
 
         public event PortsChangedDelegate OnPortsChanged;
 
+        /// <summary>
+        /// The startup phases, while the extension delegate runs, so that it can add its own. They can depend on the
+        /// phases named in StartupPhases. The service only reports itself running once all of them have finished, so
+        /// nothing that waits on the server belongs here.
+        /// </summary>
+        public IStartupGraph Startup { get; private set; }
+
+        /// <summary>
+        /// Phases that start once every phase in Startup has finished, and that the service doesn't wait for before it
+        /// reports itself running. Set while the extension delegate runs, like Startup.
+        /// </summary>
+        public IStartupGraph BackgroundStartup { get; private set; }
+
         /// <summary>
         /// Default ctor. 
         /// </summary>
@@ -371,13 +453,16 @@ namespace FilterProvider.Common.Services
             public string userEmail { get; set; }
         }
 
-        private void onRetrieveTokenTimeout(object state)
+        private bool onRetrieveTokenTimeout()
         {
             if(RetrieveToken())
             {
                 onAuthSuccess();
-                retrieveTokenTimer.Change(Timeout.Infinite, Timeout.Infinite);
+                scheduler.Stop(retrieveTokenJob);
             }
+
+            // Not having a token yet is expected until the user follows the link in the email.
+            return true;
         }
 
         public bool RetrieveToken()
@@ -408,38 +493,168 @@ namespace FilterProvider.Common.Services
         {
             StopFiltering();
             controlServer.Dispose(); 
-            InitEngine();
+
+            // New keys for the new certificates, as on a fresh start.
+            rootKeyPair = keyPairs.Take();
+            serverKeyPair = keyPairs.Take();
+
+            startProxy();
+            StartFiltering();
+
+            try
+            {
+                startControlServer();
+            }
+            catch (Exception ex)
+            {
+                logger.Error(ex, "An error occurred while attempting to start the control server. " + ex.Message);
+            }
+
+            try
+            {
+                establishTrust();
+            }
+            catch (Exception ex)
+            {
+                LoggerUtil.RecursivelyLogException(logger, ex);
+            }
         }
 
         bool exiting = false;
-        private void MonitoringThread()
+        private bool logMemoryUsage()
         {
-            var process = Process.GetCurrentProcess();
-            while(!exiting)
+            if (exiting)
             {
-                try
+                scheduler.Stop(memoryMonitorJob);
+                return true;
+            }
+
+            try
+            {
+                var process = Process.GetCurrentProcess();
+
+                PerformanceCounter pc = new PerformanceCounter();
+                pc.CategoryName = "Process";
+                pc.CounterName = "Working Set - Private";
+                pc.InstanceName = process.ProcessName;
+                var memsize = Convert.ToInt32(pc.NextValue()) / (int)(1024);
+                pc.Close();
+                pc.Dispose(); 
+                if (logger != null)
                 {
-                    PerformanceCounter pc = new PerformanceCounter();
-                    pc.CategoryName = "Process";
-                    pc.CounterName = "Working Set - Private";
-                    pc.InstanceName = process.ProcessName;
-                    var memsize = Convert.ToInt32(pc.NextValue()) / (int)(1024);
-                    pc.Close();
-                    pc.Dispose(); 
-                    if (logger != null)
-                    {
-                        logger.Info("MEMORY CONSUMPTION IS " + memsize + "KB");
-                    }
+                    logger.Info("MEMORY CONSUMPTION IS " + memsize + "KB");
                 }
-                catch(Exception e) {
-                    if(logger != null) { 
-                        logger.Error("Can't get mem counter");
-                        logger.Error(e);
-                    }
+            }
+            catch(Exception e) {
+                if(logger != null) { 
+                    logger.Error("Can't get mem counter");
+                    logger.Error(e);
+                }
+            }
+
+            try
+            {
+                checkMemoryBudgets();
+            }
+            catch (Exception e)
+            {
+                logger?.Error(e, "Can't check native memory budgets.");
+            }
+
+            return true;
+        }
+
+        private void applyMemoryBudgets()
+        {
+            try
+            {
+                memoryBudget = PlatformTypes.New<IMemoryBudget>();
+            }
+            catch (Exception ex)
+            {
+                logger?.Warn(ex, "Native memory accounting is not available on this platform.");
+                return;
+            }
+
+            MemoryBudgets budgets = AppSettings.Default.MemoryBudgets;
+
+            foreach (MemoryTag tag in Enum.GetValues(typeof(MemoryTag)))
+            {
+                MemoryLimit limit = budgets != null && budgets.Enabled ? budgets.For(tag) : null;
+
+                // A soft limit above the hard one would never be reached.
+                long hard = Math.Max(0, limit?.Hard ?? 0);
+                long soft = Math.Max(0, limit?.Soft ?? 0);
+                if (hard > 0 && soft > hard)
+                {
+                    soft = hard;
                 }
-               
-                Thread.Sleep(30000);
+
+                memoryBudget.SetLimits(tag, soft, hard);
+            }
+        }
+
+        /// <summary>
+        /// Asks subsystems past their soft limit to give memory back, and logs what the native subsystems hold.
+        /// </summary>
+        private void checkMemoryBudgets()
+        {
+            if (memoryBudget == null)
+            {
+                return;
             }
+
+            int relieved = memoryBudget.Relieve();
+            MemoryUsageSnapshot usage = memoryBudget.Snapshot();
+
+            if (memoryRefusals == null)
+            {
+                memoryRefusals = new long[usage.Tags.Length];
+            }
+
+            StringBuilder live = new StringBuilder();
+
+            foreach (MemoryTagUsage tag in usage.Tags)
+            {
+                live.AppendFormat(" {0}={1}KB", tag.Tag, tag.LiveBytes / 1024);
+
+                int index = (int)tag.Tag;
+                if (index < memoryRefusals.Length && tag.Refused > memoryRefusals[index])
+                {
+                    logger?.Warn("{0} is at its hard memory limit of {1}KB. {2} allocations were refused since the last check.", tag.Tag, tag.HardLimit / 1024, tag.Refused - memoryRefusals[index]);
+                    memoryRefusals[index] = tag.Refused;
+                }
+            }
+
+            logger?.Info("NATIVE MEMORY{0}{1}", live, relieved > 0 ? $", compacted {relieved} over their soft limit" : "");
+        }
+
+        /// <summary>
+        /// Sets up every periodic job the service runs. None of them start until something asks.
+        /// </summary>
+        private void createScheduler()
+        {
+            try
+            {
+                scheduler = PlatformTypes.New<IServiceScheduler>();
+            }
+            catch (Exception ex)
+            {
+                logger?.Warn(ex, "No native service scheduler. Periodic jobs will run on thread pool timers.");
+                scheduler = new TimerServiceScheduler();
+            }
+
+            // Slack lets jobs share wakeups with each other. Jobs that call our servers are jittered, so that clients don't
+            // all arrive at once, and back off while they fail.
+            traceDrainJob = scheduler.AddJob(() => { traceDrainer?.Flush(); return true; }, traceIdleDrainPeriod, TimeSpan.FromSeconds(5));
+            traceFillDrainJob = scheduler.AddJob(() => { traceDrainer?.Flush(); return true; }, TimeSpan.Zero, TimeSpan.Zero);
+            memoryMonitorJob = scheduler.AddJob(logMemoryUsage, TimeSpan.FromSeconds(30), TimeSpan.FromSeconds(5));
+            timeRestrictionsJob = scheduler.AddJob(timeRestrictionsCheck, maxTimeRestrictionsWait, TimeSpan.FromSeconds(1));
+            thresholdEnforcementJob = scheduler.AddJob(OnThresholdTimeoutPeriodElapsed, TimeSpan.Zero, TimeSpan.FromSeconds(1));
+            cleanupLogsJob = scheduler.AddJob(OnCleanupLogsElapsed, TimeSpan.FromHours(LogCleanupIntervalInHours), TimeSpan.FromMinutes(1));
+            retrieveTokenJob = scheduler.AddJob(onRetrieveTokenTimeout, TimeSpan.FromMilliseconds(RETRIEVE_TOKEN_TIMEOUT), TimeSpan.FromMilliseconds(500), 0.1);
+            updateCheckJob = scheduler.AddJob(() => runUpdateCheck(true), TimeSpan.FromMinutes(5), TimeSpan.FromSeconds(10), 0.1, TimeSpan.FromHours(1));
+            warmStartSnapshotJob = scheduler.AddJob(() => policyConfiguration?.SaveWarmStartSnapshot() ?? false, TimeSpan.FromMinutes(Math.Max(1, AppSettings.Default.WarmStartSnapshotIntervalMinutes)), TimeSpan.FromMinutes(1));
         }
 
         private CertificateExemptionsController createControlServerCertificateExemptionsController()
@@ -459,7 +674,6 @@ namespace FilterProvider.Common.Services
             }
 
             exiting = false;
-            new Thread(MonitoringThread).Start();
 
             // We spawn a new thread to initialize all this code so that we can start the service and return control to the Service Control Manager.
             bool consoleOutStatus = false;
@@ -475,6 +689,9 @@ namespace FilterProvider.Common.Services
                 File.AppendAllText(Path.Combine(platformPaths.ApplicationDataFolder, "FatalCrashLog.log"), $"Fatal crash. {ex.ToString()}");
             }
 
+            createScheduler();
+            scheduler.Start(memoryMonitorJob, TimeSpan.Zero);
+
             try
             {
                 Console.SetOut(new ConsoleLogWriter());
@@ -500,6 +717,30 @@ namespace FilterProvider.Common.Services
                 logger.Error(ex, "Unable to set proxy log file.");
             }
 
+            try
+            {
+                IHotPathTrace trace = HotPathTrace.Default;
+
+                if (trace != null)
+                {
+                    trace.Overflow = AppSettings.Default.TraceOverflow;
+
+                    traceDrainer = new TraceDrainer(trace);
+                    traceDrainer.WriteToLog = AppSettings.Default.TraceToLog;
+
+                    // Start() during a drain is held until it finishes, so a burst doesn't stack up drains.
+                    HotPathTrace.FillMarkReached += (sender, e) => scheduler.Start(traceFillDrainJob, TimeSpan.Zero);
+                    scheduler.Start(traceDrainJob, traceIdleDrainPeriod);
+                }
+            }
+            catch (Exception ex)
+            {
+                logger.Warn(ex, "Unable to start the hot path trace drainer.");
+            }
+
+            // Before anything that allocates native memory, since limits don't take back what is already allocated.
+            applyMemoryBudgets();
+
             string appVerStr = System.Diagnostics.Process.GetCurrentProcess().ProcessName;
 
             IVersionProvider versionProvider = PlatformTypes.New<IVersionProvider>();
@@ -545,31 +786,6 @@ namespace FilterProvider.Common.Services
             systemServices.SessionEnding += OnAppSessionEnding;
             //SystemEvents.SessionEnding += OnAppSessionEnding;
 
-            systemServices.OnStartProxy += (sender, e) =>
-            {
-                try
-                {
-                    BCCertificateMaker maker = new BCCertificateMaker();
-
-                    AsymmetricCipherKeyPair keyPair = BCCertificateMaker.CreateKeyPair(2048);
-
-                    X509Certificate2 cert = maker.MakeCertificate("localhost", false, systemServices.RootCertificate, keyPair, alternateNames: new Asn1Encodable[] {
-                        new GeneralName(GeneralName.DnsName, "localhost"),
-                        new GeneralName(GeneralName.IPAddress, "127.0.0.1"),
-                        new GeneralName(GeneralName.IPAddress, "::1")
-                        });
-
-                    controlServer = new Server(AppSettings.Default.ConfigServerPort, cert);
-                    controlServer.RegisterController(typeof(CertificateExemptionsController), createControlServerCertificateExemptionsController);
-                    controlServer.RegisterController(typeof(RelaxedPolicyController), createControlServerRelaxedPolicyController);
-                    controlServer.Start();
-                }
-                catch(Exception ex)
-                {
-                    logger.Error(ex, "An error occurred while attempting to start the control server. " + ex.Message);
-                }
-            };
-
 //            Swan.Terminal. += Terminal_OnLogMessageReceived;
 
             // Hook app exiting function. This must be done on this main app thread.
@@ -601,7 +817,7 @@ namespace FilterProvider.Common.Services
 
                 relaxedPolicy = new RelaxedPolicy(ipcServer, policyConfiguration);
 
-                dnsEnforcement = new DnsEnforcement(policyConfiguration, logger);
+                dnsEnforcement = new DnsEnforcement(policyConfiguration, logger, scheduler);
 
                 dnsEnforcement.OnCaptivePortalMode += (isCaptivePortal, isActive) =>
                 {
@@ -612,15 +828,16 @@ namespace FilterProvider.Common.Services
 
                 timeDetection = new TimeDetection(SystemClock.Instance);
                 timeDetection.ZoneTamperingDetected += OnZoneTampering;
+                timeDetection.TimeTamperingDetected += (sender, e) => wakeTimeRestrictionsCheck();
 
-                timeRestrictionsTimer = new Timer(timeRestrictionsCheck, null, 0, 1000);
-                retrieveTokenTimer = new Timer(onRetrieveTokenTimeout, null, Timeout.Infinite, Timeout.Infinite);
+                wakeTimeRestrictionsCheck();
 
                 siteFiltering = new SiteFiltering(ipcServer, timeDetection, PolicyConfiguration, certificateExemptions);
                 siteFiltering.RequestBlocked += OnRequestBlocked;
 
                 policyConfiguration.OnConfigurationLoaded += configureThreshold;
                 policyConfiguration.OnConfigurationLoaded += updateTimerFrequency;
+                policyConfiguration.OnConfigurationLoaded += (sender, e) => wakeTimeRestrictionsCheck();
 
                 ipcServer.AttemptAuthentication = (args) =>
                 {
@@ -650,7 +867,7 @@ namespace FilterProvider.Common.Services
                                         {
                                             if (authOverEmail)
                                             {
-                                                retrieveTokenTimer.Change(RETRIEVE_TOKEN_TIMEOUT, RETRIEVE_TOKEN_TIMEOUT);
+                                                scheduler.Start(retrieveTokenJob, TimeSpan.FromMilliseconds(RETRIEVE_TOKEN_TIMEOUT));
                                             }
                                             else
                                             {
@@ -832,6 +1049,37 @@ namespace FilterProvider.Common.Services
                     return true;
                 });
 
+                ipcServer.RegisterRequestHandler(IpcCall.HotPathMetrics, (message) =>
+                {
+                    // Reply even when there is nothing to report so that the requester isn't left waiting.
+                    HotPathMetricsSnapshot snapshot = HotPathMetrics.Default?.Snapshot();
+                    message.SendReply(ipcServer, IpcCall.HotPathMetrics, snapshot);
+                    return true;
+                });
+
+                ipcServer.RegisterRequestHandler(IpcCall.MemoryUsage, (message) =>
+                {
+                    MemoryUsageSnapshot usage = memoryBudget?.Snapshot();
+                    message.SendReply(ipcServer, IpcCall.MemoryUsage, usage);
+                    return true;
+                });
+
+                ipcServer.RegisterRequestHandler(IpcCall.StartupTrace, (message) =>
+                {
+                    // Null while startup is still running.
+                    message.SendReply(ipcServer, IpcCall.StartupTrace, startupTrace);
+                    return true;
+                });
+
+                ipcServer.RegisterRequestHandler(IpcCall.TraceEvents, (message) =>
+                {
+                    int count = message.DataObject is int ? (int)message.DataObject : 1000;
+
+                    List<string> events = traceDrainer?.Recent(count) ?? new List<string>();
+                    message.SendReply(ipcServer, IpcCall.TraceEvents, events);
+                    return true;
+                });
+
                 ipcServer.DeactivationRequested = (args) =>
                 {
                     Status = FilterStatus.Synchronizing;
@@ -977,6 +1225,14 @@ namespace FilterProvider.Common.Services
 
                         ipcServer.NotifyStatus(Status);
 
+                        lock (timeRestrictionsLock)
+                        {
+                            if (timeRestrictionsStateSent)
+                            {
+                                ipcServer.Send<bool?>(IpcCall.TimeRestrictionsEnabled, timeRestrictionsActive);
+                            }
+                        }
+
                         dnsEnforcement.Trigger();
 
                         if (ipcServer.WaitingForAuth)
@@ -1073,10 +1329,6 @@ namespace FilterProvider.Common.Services
 
             LogTime("Done with OnStartup initialization.");
 
-            // Before we do any network stuff, ensure we have windows firewall access.            
-            systemServices.EnsureFirewallAccess();
-
-            LogTime("EnsureWindowsFirewallAccess() is done");
             // Run the background init worker for non-UI related initialization.
             backgroundInitWorker = new BackgroundWorker();
             backgroundInitWorker.DoWork += DoBackgroundInit;
@@ -1142,57 +1394,77 @@ namespace FilterProvider.Common.Services
         }
 
          
-        private void timeRestrictionsCheck(object state)
+        private void wakeTimeRestrictionsCheck()
+        {
+            // If the check is running, the scheduler runs it again as soon as it finishes.
+            scheduler?.Start(timeRestrictionsJob, TimeSpan.Zero);
+        }
+
+        /// <summary>
+        /// Works out whether time restrictions apply right now, tells the GUI if that changed, and sleeps until the
+        /// schedule says it can next change. Configuration loads and time or zone tampering wake it early.
+        /// </summary>
+        private bool timeRestrictionsCheck()
         {
-            bool? areTimeRestrictionsActive = false;
+            TimeSpan wait = maxTimeRestrictionsWait;
+            bool succeeded = true;
+
             try
             {
-                try
+                lock (timeRestrictionsLock)
                 {
-                    if (policyConfiguration == null || policyConfiguration.Configuration == null)
-                    {
-                        timeRestrictionsTimer.Change(1000, 1000);
-                        return;
-                    }
+                    bool? active = null;
 
-                    TimeRestrictionModel currentDay = policyConfiguration?.TimeRestrictions?[(int)DateTime.Now.DayOfWeek];
+                    TimeRestrictionSchedule schedule = policyConfiguration?.TimeRestrictionSchedule;
 
-                    if (currentDay == null)
+                    if (schedule != null && schedule.AnyEnabled)
                     {
-                        timeRestrictionsTimer.Change(30000, 30000);
-                        return;
-                    }
+                        ZonedDateTime currentTime = timeDetection.GetRealTime();
 
-                    ZonedDateTime currentTime = timeDetection.GetRealTime();
+                        active = !schedule.IsAllowed(currentTime);
 
-                    if (timeDetection.IsDateTimeAllowed(timeDetection.GetRealTime(), currentDay))
-                    {
-                        areTimeRestrictionsActive = false;
-                    }
-                    else
-                    {
-                        areTimeRestrictionsActive = true;
+                        Instant? next = schedule.NextTransition(currentTime);
+                        if (next.HasValue)
+                        {
+                            // A little past the boundary, so the minute has turned over by the time we look again.
+                            TimeSpan untilNext = (next.Value - currentTime.ToInstant()).ToTimeSpan() + TimeSpan.FromMilliseconds(50);
+
+                            if (untilNext < wait)
+                            {
+                                wait = untilNext;
+                            }
+                        }
                     }
-                }
-                finally
-                {
-                    if (!(policyConfiguration?.TimeRestrictions?.Any(t => t?.RestrictionsEnabled ?? false) ?? false))
+
+                    if (!timeRestrictionsStateSent || active != timeRestrictionsActive)
                     {
-                        areTimeRestrictionsActive = null;
-                    }
+                        timeRestrictionsActive = active;
+                        timeRestrictionsStateSent = true;
 
-                    ipcServer.Send<bool?>(IpcCall.TimeRestrictionsEnabled, areTimeRestrictionsActive);
+                        ipcServer.Send<bool?>(IpcCall.TimeRestrictionsEnabled, active);
+                    }
                 }
             }
             catch(Exception ex)
             {
                 logger.Error("timeRestrictionsCheck error occurred.");
                 LoggerUtil.RecursivelyLogException(logger, ex);
+
+                succeeded = false;
             }
+            finally
+            {
+                // Next run at the next transition. A wake-up that came in while this ran still runs it again right away.
+                scheduler.SetPeriod(timeRestrictionsJob, wait);
+            }
+
+            return succeeded;
         }
 
         private void OnZoneTampering(object sender, ZoneTamperingEventArgs e)
         {
+            wakeTimeRestrictionsCheck();
+
             ZonedDateTime currentTime = timeDetection.GetRealTime();
 
             var date = currentTime.ToDateTimeOffset();
@@ -1221,7 +1493,8 @@ namespace FilterProvider.Common.Services
             {
                 // Put the new update frequence into effect.
                 logger.Info($"updateTimerFrequency Setting update timer to {policyConfiguration.Configuration.UpdateFrequency}"); ;
-                this.updateCheckTimer?.Change(policyConfiguration.Configuration.UpdateFrequency, Timeout.InfiniteTimeSpan);
+                scheduler.SetPeriod(updateCheckJob, policyConfiguration.Configuration.UpdateFrequency);
+                scheduler.Start(updateCheckJob, policyConfiguration.Configuration.UpdateFrequency);
             }
         }
 
@@ -1256,76 +1529,79 @@ namespace FilterProvider.Common.Services
         /// </summary>
         private void InitThresholdData()
         {
-            // If exists, stop it first.
-            if (thresholdCountTimer != null)
-            {
-                thresholdCountTimer.Change(Timeout.Infinite, Timeout.Infinite);
-            }
-
-            // Create the threshold count timer and start it with the configured timespan.
+            // Counts over the configured trigger period, replacing any counter from an older configuration. The old one
+            // is left to the finalizer, since a block on another thread may still be adding to it.
             var cfg = policyConfiguration.Configuration;
-            thresholdCountTimer = new Timer(OnThresholdTriggerPeriodElapsed, null, cfg != null ? cfg.ThresholdTriggerPeriod : TimeSpan.FromMinutes(1), Timeout.InfiniteTimeSpan);
+            TimeSpan window = cfg != null && cfg.ThresholdTriggerPeriod > TimeSpan.Zero ? cfg.ThresholdTriggerPeriod : TimeSpan.FromMinutes(1);
 
-            // Create the enforcement timer, but don't start it.
-            thresholdEnforcementTimer = new Timer(OnThresholdTimeoutPeriodElapsed, null, Timeout.Infinite, Timeout.Infinite);
+            thresholdCounter = scheduler.NewCounter(window);
         }
 
         /// <summary>
-        /// Sets up the filtering engine, calls establish trust with firefox, sets up callbacks for
-        /// classification and firewall checks, but does not start the engine.
+        /// Sets up the filtering engine and its callbacks, with the root certificate made from rootKeyPair.
         /// </summary>
-        private async void InitEngine()
+        private bool startProxy()
         {
-            LogTime("Starting InitEngine()");
-
             LogTime("Loading filtering engine.");
 
-            // Init the engine with our callbacks, the path to the ca-bundle, let it pick whatever
-            // ports it wants for listening, and give it our total processor count on this machine as
-            // a hint for how many threads to use.
-            //filteringEngine = new WindowsProxyServer(OnAppFirewallCheck, OnHttpMessageBegin, OnHttpMessageEnd, OnBadCertificate);
-
             // TODO: Code smell. Do we instantiate types with special functions, or do we use PlatformTypes.New<T>() ?
             filteringEngine = systemServices.StartProxyServer(new ProxyConfiguration()
             {
                 AuthorityName = "CloudVeil for Windows",
+                RootKeyPair = rootKeyPair,
                 BeforeRequest = siteFiltering.OnBeforeRequest,
                 BeforeResponse = siteFiltering.OnBeforeResponse,
                 Blacklisted = siteFiltering.OnBlacklist,
                 Whitelisted = siteFiltering.OnWhitelist
             });
 
-            // Setup general info, warning and error events.
+            return filteringEngine != null;
+        }
 
-            // Start filtering, always.
-            if (filteringEngine != null && !filteringEngine.IsRunning)
+        /// <summary>
+        /// Starts the local server the block page talks to, with a localhost certificate signed by the root.
+        /// </summary>
+        private bool startControlServer()
+        {
+            if (systemServices.RootCertificate == null)
             {
-                filterEngineStartupBgWorker = new BackgroundWorker();
-                filterEngineStartupBgWorker.DoWork += ((object sender, DoWorkEventArgs e) =>
-                {
-                    StartFiltering();
+                logger.Error("Unable to start the control server without a root certificate.");
+                return false;
+            }
+
+            BCCertificateMaker maker = new BCCertificateMaker();
+
+            AsymmetricCipherKeyPair keyPair = serverKeyPair ?? keyPairs.Take();
+
+            X509Certificate2 cert = maker.MakeCertificate("localhost", false, systemServices.RootCertificate, keyPair, alternateNames: new Asn1Encodable[] {
+                new GeneralName(GeneralName.DnsName, "localhost"),
+                new GeneralName(GeneralName.IPAddress, "127.0.0.1"),
+                new GeneralName(GeneralName.IPAddress, "::1")
                 });
 
-                filterEngineStartupBgWorker.RunWorkerAsync();
-            }
+            controlServer = new Server(AppSettings.Default.ConfigServerPort, cert);
+            controlServer.RegisterController(typeof(CertificateExemptionsController), createControlServerCertificateExemptionsController);
+            controlServer.RegisterController(typeof(RelaxedPolicyController), createControlServerRelaxedPolicyController);
+            controlServer.Start();
 
-            // Now establish trust with FireFox. XXX TODO - This can actually be done elsewhere. We
-            // used to have to do this after the engine started up to wait for it to write the CA to
-            // disk and then use certutil to install it in FF. However, thanks to FireFox giving the
-            // option to trust the local certificate store, we don't have to do that anymore.
-            try
-            {
-                if (WebServiceUtil.Default.AuthToken.Length > 0)
-                {
-                    trustManager.EstablishTrust();
-                }
-            }
-            catch (Exception ffe)
+            return true;
+        }
+
+        /// <summary>
+        /// Has user apps like FireFox trust our root certificate. They can use the local certificate store now, so this no
+        /// longer has to wait for the engine to write the CA to disk.
+        /// </summary>
+        private bool establishTrust()
+        {
+            if (string.IsNullOrEmpty(WebServiceUtil.Default.AuthToken))
             {
-                LoggerUtil.RecursivelyLogException(logger, ffe);
+                return true;
             }
 
+            trustManager.EstablishTrust();
+
             LogTime("Trust established with user apps.");
+            return true;
         }
 
 #if WITH_NLP
@@ -1422,51 +1698,213 @@ namespace FilterProvider.Common.Services
         {
             LogTime("Starting DoBackgroundInit()");
 
-            // Init the Engine in the background.
+            keyPairs = new KeyPairPool(platformPaths.GetPath("keyPairs.pem"), 2048, 2);
+
+            Startup = newStartupGraph();
+            BackgroundStartup = newStartupGraph();
+
+            addStartupPhases(Startup, BackgroundStartup);
+
+            // Run our extension method if it exists. It can add phases of its own.
             try
             {
-                Task.Run(() => InitEngine());
+                extensionDelegate?.Invoke(this);
+            }
+            catch(Exception ex)
+            {
+                LoggerUtil.RecursivelyLogException(logger, ex);
             }
-            catch (Exception ie)
+
+            // Init update timer.
+            scheduler.Start(updateCheckJob, TimeSpan.FromMinutes(5));
+
+            scheduler.Start(cleanupLogsJob, TimeSpan.FromHours(LogCleanupIntervalInHours));
+
+            if (AppSettings.Default.WarmStartSnapshotIntervalMinutes > 0)
             {
-                LoggerUtil.RecursivelyLogException(logger, ie);
+                scheduler.Start(warmStartSnapshotJob, TimeSpan.FromMinutes(AppSettings.Default.WarmStartSnapshotIntervalMinutes));
             }
 
-            // Run our extension method if it exists.
+            IStartupGraph background = BackgroundStartup;
+            BackgroundStartup = null;
+
+            startupTrace = Startup.Run();
+            Startup = null;
+
+            logStartupTrace(startupTrace);
+
+            Task.Run(() =>
+            {
+                try
+                {
+                    StartupTrace backgroundTrace = background.Run();
+
+                    logger.Info("Background startup took {0:0} ms.", backgroundTrace.TotalMs);
+                    logStartupPhases(backgroundTrace);
+                }
+                catch (Exception ex)
+                {
+                    LoggerUtil.RecursivelyLogException(logger, ex);
+                }
+            });
+
+            // Replace the keys this start used, for the next one. Well after anything that needed the CPU at startup.
+            Thread refill = new Thread(() =>
+            {
+                try
+                {
+                    int generated = keyPairs.Refill();
+                    logger.Info("Pregenerated {0} key pairs for the next start.", generated);
+                }
+                catch (Exception ex)
+                {
+                    LoggerUtil.RecursivelyLogException(logger, ex);
+                }
+            });
+
+            refill.Name = "KeyPairPool";
+            refill.IsBackground = true;
+            refill.Priority = ThreadPriority.BelowNormal;
+            refill.Start();
+        }
+
+        private IStartupGraph newStartupGraph()
+        {
             try
             {
-                extensionDelegate?.Invoke(this);
+                return PlatformTypes.New<IStartupGraph>();
             }
-            catch(Exception ex)
+            catch (Exception ex)
             {
-                LoggerUtil.RecursivelyLogException(logger, ex);
+                logger.Warn(ex, "No native startup graph for this platform. Using the task based one instead.");
+                return new TaskStartupGraph();
             }
+        }
+
+        /// <summary>
+        /// Adds the service's own startup phases. Nothing that needs the network runs before the firewall lets us through,
+        /// and the engine doesn't start until the root key is ready, but everything else overlaps. The saved configuration
+        /// and lists load alongside the engine, so filtering is up without waiting on the server. Trust, the update check
+        /// and log cleanup go in the background graph, since filtering doesn't need them.
+        /// </summary>
+        private void addStartupPhases(IStartupGraph graph, IStartupGraph background)
+        {
+            graph.AddPhase(StartupPhases.Firewall, () =>
+            {
+                systemServices.EnsureFirewallAccess();
+                return true;
+            });
+
+            graph.AddPhase(StartupPhases.RootKey, () => (rootKeyPair = keyPairs.Take()) != null);
+            graph.AddPhase(StartupPhases.ServerKey, () => (serverKeyPair = keyPairs.Take()) != null);
+
+            graph.AddPhase(StartupPhases.Configuration, loadSavedConfiguration);
+            graph.AddPhase(StartupPhases.Lists, loadSavedLists, StartupPhases.Configuration);
 
+            graph.AddPhase(StartupPhases.Proxy, startProxy, StartupPhases.Firewall, StartupPhases.RootKey);
+
+            graph.AddPhase(StartupPhases.Filtering, () =>
+            {
+                StartFiltering();
+                return filteringEngine != null && filteringEngine.IsRunning;
+            }, StartupPhases.Proxy);
+
+            graph.AddPhase(StartupPhases.ControlServer, startControlServer, StartupPhases.Proxy, StartupPhases.ServerKey);
 
             // Force start our cascade of protective processes.
-            try
+            graph.AddPhase(StartupPhases.ProtectiveServices, () =>
             {
                 if (!isTestRun)
                 {
                     systemServices.RunProtectiveServices();
                 }
+
+                return true;
+            });
+
+            graph.AddPhase(StartupPhases.Dns, () =>
+            {
+                // Set up our network availability checks so we can run captive portal detection on a changed network.
+                NetworkChange.NetworkAddressChanged += dnsEnforcement.OnNetworkChange;
+
+                // Run on startup so we can get the network state right away.
+                dnsEnforcement.Trigger();
+                return true;
+            }, StartupPhases.Firewall);
+
+            // Everything in the foreground graph, the proxy included, has finished before these start.
+            background.AddPhase(StartupPhases.Trust, establishTrust);
+
+            // Only reloads what the server has changed since the saved copies were written. Platform phases that hook the
+            // auth token events, like the Windows diverter, are in the foreground graph, so they see what this raises.
+            background.AddPhase(StartupPhases.Update, () => runUpdateCheck(false));
+
+            background.AddPhase(StartupPhases.LogCleanup, () =>
+            {
+                CleanupLogs();
+                return true;
+            });
+        }
+
+        private bool loadSavedConfiguration()
+        {
+            updateRwLock.EnterWriteLock();
+
+            try
+            {
+                return policyConfiguration.Configuration != null || policyConfiguration.LoadConfiguration();
             }
-            catch (Exception se)
+            finally
             {
-                LoggerUtil.RecursivelyLogException(logger, se);
+                updateRwLock.ExitWriteLock();
             }
+        }
 
-            // Init update timer.
-            updateCheckTimer = new Timer(OnUpdateTimerElapsed, null, TimeSpan.FromMinutes(5), Timeout.InfiniteTimeSpan);
+        private bool loadSavedLists()
+        {
+            if (policyConfiguration.Configuration == null)
+            {
+                return false;
+            }
+
+            updateRwLock.EnterWriteLock();
+
+            try
+            {
+                bool loaded = AdBlockMatcherApi.AreListsLoaded() || policyConfiguration.LoadLists();
+                LogTime("Saved lists loaded.");
+
+                return loaded;
+            }
+            finally
+            {
+                updateRwLock.ExitWriteLock();
+            }
+        }
+
+        private void logStartupTrace(StartupTrace trace)
+        {
+            if (trace == null)
+            {
+                return;
+            }
 
-            // Run log cleanup and schedule for next run.
-            OnCleanupLogsElapsed(null);
+            StartupPhaseTiming filtering = trace.Phase(StartupPhases.Filtering);
+            StartupPhaseTiming lists = trace.Phase(StartupPhases.Lists);
 
-            // Set up our network availability checks so we can run captive portal detection on a changed network.
-            NetworkChange.NetworkAddressChanged += dnsEnforcement.OnNetworkChange;
+            logger.Info("Startup took {0:0} ms, {1:0} ms after the process started. Filtering at {2:0} ms, lists at {3:0} ms. Key pairs: {4} pregenerated, {5} generated.",
+                trace.TotalMs, trace.SinceProcessStartMs, filtering?.EndMs ?? 0, lists?.EndMs ?? 0, keyPairs.TakenFromPool, keyPairs.GeneratedOnDemand);
 
-            // Run on startup so we can get the network state right away.
-            dnsEnforcement.Trigger();
+            logStartupPhases(trace);
+        }
+
+        private void logStartupPhases(StartupTrace trace)
+        {
+            foreach (StartupPhaseTiming phase in trace.Phases)
+            {
+                logger.Info("Startup phase {0}{1}: {2}, {3:0}-{4:0} ms, {5:0} ms CPU, waited on {6}.",
+                    phase.Name, phase.Critical ? " (critical)" : "", phase.State, phase.StartMs, phase.EndMs, phase.CpuMs, phase.WaitedOn ?? "nothing");
+            }
         }
 
         /// <summary>
@@ -1540,8 +1978,6 @@ namespace FilterProvider.Common.Services
                 return;
             }
 
-            OnUpdateTimerElapsed(null);
-
             Status = FilterStatus.Running;
 
             systemServices.EnsureGuiRunning(runInTray: true);
@@ -1571,9 +2007,11 @@ namespace FilterProvider.Common.Services
 
             var cfg = policyConfiguration.Configuration;
 
-            if (cfg != null && cfg.UseThreshold)
+            ISlidingWindowCounter counter = thresholdCounter;
+
+            if (cfg != null && cfg.UseThreshold && counter != null)
             {
-                var currentTicks = Interlocked.Increment(ref thresholdTicks);
+                var currentTicks = counter.Add();
 
                 if (currentTicks >= cfg.ThresholdLimit)
                 {
@@ -1589,7 +2027,7 @@ namespace FilterProvider.Common.Services
                         LoggerUtil.RecursivelyLogException(logger, e);
                     }
 
-                    this.thresholdEnforcementTimer.Change(cfg.ThresholdTimeoutPeriod, Timeout.InfiniteTimeSpan);
+                    scheduler.Start(thresholdEnforcementJob, cfg.ThresholdTimeoutPeriod);
                 }
             }
 
@@ -1660,39 +2098,10 @@ namespace FilterProvider.Common.Services
 
         #endregion EngineCallbacks
 
-        /// <summary>
-        /// Called by the threshold trigger timer whenever it's set time has passed. Here we'll reset
-        /// the current count of block actions we're tracking.
-        /// </summary>
-        /// <param name="state">
-        /// Async state object. Not used. 
-        /// </param>
-        private void OnThresholdTriggerPeriodElapsed(object state)
-        {
-            try
-            {
-                // Reset count to zero.
-                Interlocked.Exchange(ref thresholdTicks, 0);
-
-                var cfg = policyConfiguration.Configuration;
-
-                this.thresholdCountTimer.Change(cfg != null ? cfg.ThresholdTriggerPeriod : TimeSpan.FromMinutes(5), Timeout.InfiniteTimeSpan);
-            }
-            catch (Exception ex)
-            {
-                LoggerUtil.RecursivelyLogException(logger, ex);
-                // TODO: Tell Sentry about this problem.
-            }
-
-        }
-
         /// <summary>
         /// Called whenever the threshold timeout period has elapsed. Here we'll restore internet access. 
         /// </summary>
-        /// <param name="state">
-        /// Async state object. Not used. 
-        /// </param>
-        private void OnThresholdTimeoutPeriodElapsed(object state)
+        private bool OnThresholdTimeoutPeriodElapsed()
         {
             try
             {
@@ -1706,8 +2115,10 @@ namespace FilterProvider.Common.Services
 
             Status = FilterStatus.Running;
 
-            // Disable the timer before we leave.
-            this.thresholdEnforcementTimer.Change(Timeout.Infinite, Timeout.Infinite);
+            // Forget the blocks that tripped it, so one more doesn't cut the internet off again straight away.
+            thresholdCounter?.Reset();
+
+            return true;
         }
 
         public UpdateCheckResult CheckForApplicationUpdate(bool isCheckButton)
@@ -1717,10 +2128,20 @@ namespace FilterProvider.Common.Services
         }
 
         public ConfigUpdateResult UpdateAndWriteList(bool isSyncButton)
+        {
+            return UpdateAndWriteList(isSyncButton, false);
+        }
+
+        /// <param name="scheduled">True when run by the update check job, whose next run the scheduler has already set up.
+        /// Any other update pushes the next scheduled one back a whole period.</param>
+        private ConfigUpdateResult UpdateAndWriteList(bool isSyncButton, bool scheduled)
         {
             LogTime("UpdateAndWriteList");
             if (!NetworkStatus.Default.HasConnection)
             {
+                // Checks resume when the connection comes back.
+                scheduler.Stop(updateCheckJob);
+
                 NetworkStatus.Default.ConnectionStateChanged += Default_ConnectionStateChanged;
                 return ConfigUpdateResult.NoInternet;
             }
@@ -1769,6 +2190,7 @@ namespace FilterProvider.Common.Services
                 if (doLoadLists)
                 {
                     policyConfiguration.LoadLists();
+                    LogTime("Lists loaded.");
                 }
                 else if (listsDownloaded == null && policyConfiguration.Configuration == null)
                 {
@@ -1801,20 +2223,30 @@ namespace FilterProvider.Common.Services
                     // Enable the timer again.
                     if (!NetworkStatus.Default.HasConnection)
                     {
+                        scheduler.Stop(updateCheckJob);
                         NetworkStatus.Default.ConnectionStateChanged += Default_ConnectionStateChanged;
                     }
                     else
                     {
+                        TimeSpan frequency;
+
                         var cfg = policyConfiguration.Configuration;
                         if (cfg != null)
                         {
                             logger.Info($"UpdateAndWriteList Setting update timer to {policyConfiguration.Configuration.UpdateFrequency}"); ;
-                            this.updateCheckTimer.Change(cfg.UpdateFrequency, Timeout.InfiniteTimeSpan);
+                            frequency = cfg.UpdateFrequency;
                         }
                         else
                         {
                             logger.Info($"Setting update timer to fallback"); ;
-                            this.updateCheckTimer.Change(TimeSpan.FromMinutes(5), Timeout.InfiniteTimeSpan);
+                            frequency = TimeSpan.FromMinutes(5);
+                        }
+
+                        scheduler.SetPeriod(updateCheckJob, frequency);
+
+                        if (!scheduled)
+                        {
+                            scheduler.Start(updateCheckJob, frequency);
                         }
                     }
 
@@ -1848,15 +2280,21 @@ namespace FilterProvider.Common.Services
         /// This is always null. Ignore it. 
         /// </param>
         private void OnUpdateTimerElapsed(object state)
+        {
+            runUpdateCheck(false);
+        }
+
+        /// <returns>False if the filter lists could not be checked, so that the job backs off.</returns>
+        private bool runUpdateCheck(bool scheduled)
         {
             logger.Info("Running OnUpdateTimerElapsed");
 
             if (ipcServer != null && ipcServer.WaitingForAuth)
             {
-                return;
+                return true;
             }
 
-            this.UpdateAndWriteList(false);
+            ConfigUpdateResult result = this.UpdateAndWriteList(false, scheduled);
             this.CheckForApplicationUpdate(false);
 
             this.CleanupLogs();
@@ -1866,23 +2304,26 @@ namespace FilterProvider.Common.Services
                 lastUsernamePrintTime = DateTime.Now;
                 logger.Info($"Currently logged in user is {WebServiceUtil.Default.UserEmail}");
             }
+
+            return result == ConfigUpdateResult.Updated || result == ConfigUpdateResult.UpToDate;
         }
 
         public const int LogCleanupIntervalInHours = 12;
         public const int MaxLogAgeInDays = 7;
 
-        private void OnCleanupLogsElapsed(object state)
+        private bool OnCleanupLogsElapsed()
         {
             this.CleanupLogs();
 
-            if (cleanupLogsTimer == null)
-            {
-                cleanupLogsTimer = new Timer(OnCleanupLogsElapsed, null, TimeSpan.FromHours(LogCleanupIntervalInHours), Timeout.InfiniteTimeSpan);
-            }
-            else
+            logger.Info("Service scheduler: {0}", scheduler.GetCounters());
+
+            TriggerScanCounters scanCounters = policyConfiguration?.TextTriggers?.GetScanCounters();
+            if (scanCounters != null)
             {
-                cleanupLogsTimer.Change(TimeSpan.FromHours(LogCleanupIntervalInHours), Timeout.InfiniteTimeSpan);
+                logger.Info("Trigger scans: {0}", scanCounters);
             }
+
+            return true;
         }
 
         Stopwatch logTimeStopwatch = null;
@@ -2054,6 +2495,9 @@ namespace FilterProvider.Common.Services
                         LoggerUtil.RecursivelyLogException(logger, e);
                     }
 
+                    // With filtering stopped, the snapshot has every verdict this run cached.
+                    policyConfiguration?.SaveWarmStartSnapshot();
+
                     if (installSafeguards)
                     {
                         try
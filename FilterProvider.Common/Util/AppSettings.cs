@@ -2,6 +2,7 @@
 using Filter.Platform.Common.IPC.Messages;
 using Filter.Platform.Common.Types;
 using Filter.Platform.Common.Util;
+using FilterProvider.Common.Platform;
 using FilterProvider.Common.Proxy;
 using Newtonsoft.Json;
 using System;
@@ -36,6 +37,62 @@ namespace FilterProvider.Common.Util
         public ushort HttpPort { get; set; } = DEFAULT_HTTP_PORT;
         public bool RandomizePorts { get; set; } = false;
 
+        /// <summary>
+        /// Response bodies larger than this many bytes are split into chunks that are scanned for text triggers in parallel.
+        /// Zero scans every body on the thread that handles its request.
+        /// </summary>
+        public int ParallelScanThreshold { get; set; } = 1024 * 1024;
+
+        /// <summary>
+        /// Approximate size in bytes of each chunk when a body is scanned in parallel.
+        /// </summary>
+        public int ParallelScanChunkSize { get; set; } = 256 * 1024;
+
+        /// <summary>
+        /// Memory in bytes for remembering the text trigger verdicts of bodies, and parts of bodies, that were scanned
+        /// before. Zero rescans everything.
+        /// </summary>
+        public int TriggerVerdictCacheSize { get; set; } = 8 * 1024 * 1024;
+
+        /// <summary>
+        /// How much of the processors text trigger scans may take, and what happens to bodies that would take more.
+        /// </summary>
+        public TriggerScanLimits TriggerScanLimits { get; set; } = new TriggerScanLimits();
+
+        /// <summary>
+        /// Whether compiled text triggers and the most used trigger verdicts are saved to disk, so that a restart with the
+        /// same lists can skip loading the triggers again.
+        /// </summary>
+        public bool WarmStartSnapshot { get; set; } = true;
+
+        /// <summary>
+        /// How often, in minutes, the warm start snapshot is saved while the service runs. It is also saved when the service
+        /// stops cleanly. Zero only saves it then.
+        /// </summary>
+        public int WarmStartSnapshotIntervalMinutes { get; set; } = 30;
+
+        /// <summary>
+        /// Most cached trigger verdicts saved with the warm start snapshot.
+        /// </summary>
+        public int WarmStartSnapshotVerdicts { get; set; } = 65536;
+
+        /// <summary>
+        /// Memory the native trigger index, verdict cache, scan buffers and warm start snapshots may hold. Takes effect
+        /// when the service starts.
+        /// </summary>
+        public MemoryBudgets MemoryBudgets { get; set; } = new MemoryBudgets();
+
+        /// <summary>
+        /// What a thread does with new hot path trace events when its trace buffer is full.
+        /// </summary>
+        public TraceOverflow TraceOverflow { get; set; } = TraceOverflow.DropNewest;
+
+        /// <summary>
+        /// If true, hot path trace events are written to the trace log as they are drained. They can always be fetched
+        /// over IPC either way.
+        /// </summary>
+        public bool TraceToLog { get; set; } = true;
+
         public static AppSettings Default { get; private set; }
         
 
@@ -6,10 +6,12 @@
 */
 
 using System;
+using System.Collections.Concurrent;
 using System.Collections.Generic;
 using System.Linq;
 using System.Security.Cryptography.X509Certificates;
 using System.Text;
+using System.Threading;
 using System.Threading.Tasks;
 using System.IO;
 using System.Net;
@@ -17,7 +19,9 @@ using System.Security.Cryptography;
 using CloudVeil.Core.Windows.Util;
 using Microsoft.Data.Sqlite;
 using System.Net.Security;
+using Filter.Platform.Common;
 using Filter.Platform.Common.Util;
+using FilterProvider.Common.Platform;
 
 namespace FilterProvider.Common.Util
 {
@@ -28,6 +32,13 @@ namespace FilterProvider.Common.Util
     /// <param name="certificate">The X509Certificate which caused this exemption request.</param>
     public delegate void AddExemptionRequestHandler(string host, string certHash, bool isTrusted);
 
+    /// <summary>
+    /// Certificates the user has trusted for particular hosts despite failing validation.
+    ///
+    /// When the platform provides an ICertificateExemptionIndex, every exemption is loaded into it once at startup and
+    /// checks never touch the database. TrustCertificate() updates the index right away and saves to the database in
+    /// the background, so an exemption made just before the service stops may not be saved.
+    /// </summary>
     public class CertificateExemptions
     {
         private static string dbPath;
@@ -61,6 +72,30 @@ namespace FilterProvider.Common.Util
             {
                 LoggerUtil.RecursivelyLogException(logger, ex);
             }
+
+            if (connection != null)
+            {
+                try
+                {
+                    index = PlatformTypes.New<ICertificateExemptionIndex>();
+                }
+                catch (Exception ex)
+                {
+                    index = null;
+                    logger?.Warn(ex, "No platform certificate exemption index available. Exemptions will be checked against the database.");
+                }
+
+                if (index != null)
+                {
+                    loadIndex();
+                }
+            }
+        }
+
+        private struct PendingExemption
+        {
+            public string Host;
+            public string Thumbprint;
         }
 
         private NLog.Logger logger;
@@ -68,6 +103,126 @@ namespace FilterProvider.Common.Util
         private SqliteConnection connection;
         private object connectionLock = new object();
 
+        private ICertificateExemptionIndex index;
+
+        // Exemptions already in the index that still have to be written to the database.
+        private ConcurrentQueue<PendingExemption> pendingWrites = new ConcurrentQueue<PendingExemption>();
+        private int flushScheduled = 0;
+
+        private void loadIndex()
+        {
+            try
+            {
+                lock (connectionLock)
+                {
+                    using (SqliteCommand command = connection.CreateCommand())
+                    {
+                        command.CommandText = "SELECT Thumbprint, Host, DateExempted, ExpireDate FROM cert_exemptions";
+
+                        using (SqliteDataReader reader = command.ExecuteReader())
+                        {
+                            while (reader.Read())
+                            {
+                                if (reader.IsDBNull(0) || reader.IsDBNull(1) || !isReaderRowCurrentlyExempted(reader))
+                                {
+                                    continue;
+                                }
+
+                                byte[] thumbprint = parseThumbprint(reader.GetString(0));
+                                if (thumbprint == null)
+                                {
+                                    continue;
+                                }
+
+                                // Already checked by isReaderRowCurrentlyExempted().
+                                DateTime? expires = null;
+                                if (!reader.IsDBNull(3))
+                                {
+                                    expires = DateTime.Parse(reader.GetString(3)).ToUniversalTime();
+                                }
+
+                                index.Set(thumbprint, reader.GetString(1), expires);
+                            }
+                        }
+                    }
+                }
+
+                logger.Info("Loaded {0} certificate exemptions.", index.Count);
+            }
+            catch (Exception ex)
+            {
+                // A partly loaded index would turn down exemptions the database has, so go back to the database instead.
+                LoggerUtil.RecursivelyLogException(logger, ex);
+
+                index.Dispose();
+                index = null;
+            }
+        }
+
+        /// <returns>Null if thumbprint is not a hex string.</returns>
+        private static byte[] parseThumbprint(string thumbprint)
+        {
+            if (thumbprint == null || thumbprint.Length == 0 || thumbprint.Length % 2 != 0)
+            {
+                return null;
+            }
+
+            byte[] bytes = new byte[thumbprint.Length / 2];
+
+            for (int i = 0; i < bytes.Length; i++)
+            {
+                int high = hexValue(thumbprint[i * 2]);
+                int low = hexValue(thumbprint[i * 2 + 1]);
+
+                if (high < 0 || low < 0)
+                {
+                    return null;
+                }
+
+                bytes[i] = (byte)((high << 4) | low);
+            }
+
+            return bytes;
+        }
+
+        private static int hexValue(char c)
+        {
+            if (c >= '0' && c <= '9') return c - '0';
+            if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+            if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+
+            return -1;
+        }
+
+        private void scheduleFlush()
+        {
+            if (Interlocked.CompareExchange(ref flushScheduled, 1, 0) == 0)
+            {
+                Task.Run(() => flushPendingWrites());
+            }
+        }
+
+        private void flushPendingWrites()
+        {
+            while (true)
+            {
+                PendingExemption pending;
+                while (pendingWrites.TryDequeue(out pending))
+                {
+                    TrustCertificateInternal(pending.Host, pending.Thumbprint, 1);
+                }
+
+                Volatile.Write(ref flushScheduled, 0);
+
+                // Anything queued between the last TryDequeue() and clearing the flag found the flag still set and
+                // left it to us.
+                if (pendingWrites.IsEmpty || Interlocked.CompareExchange(ref flushScheduled, 1, 0) != 0)
+                {
+                    return;
+                }
+            }
+        }
+
         private SqliteConnection openConnection(string dbPath)
         {
             SqliteConnectionStringBuilder cb = new SqliteConnectionStringBuilder();
@@ -121,12 +276,27 @@ namespace FilterProvider.Common.Util
         }
 
         public void TrustCertificate(string host, string thumbprint)
-            => TrustCertificateInternal(host, thumbprint, 1);
+        {
+            if (index != null && host != null)
+            {
+                byte[] thumbprintBytes = parseThumbprint(thumbprint);
+
+                if (thumbprintBytes != null && index.Set(thumbprintBytes, host, null))
+                {
+                    pendingWrites.Enqueue(new PendingExemption() { Host = host, Thumbprint = thumbprint });
+                    scheduleFlush();
+                    return;
+                }
+            }
+
+            TrustCertificateInternal(host, thumbprint, 1);
+        }
 
         private void TrustCertificateInternal(string host, string thumbprint, int triesLeft)
         {
             try
             {
+                lock (connectionLock)
                 using (SqliteCommand command = connection.CreateCommand())
                 {
                     bool createExemptionData = false;
@@ -164,13 +334,22 @@ namespace FilterProvider.Common.Util
                 if (triesLeft > 0)
                 {
                     attemptConnectionRecovery();
-                    TrustCertificateInternal(host, thumbprint, triesLeft--);
+                    TrustCertificateInternal(host, thumbprint, triesLeft - 1);
                 }
             }
         }
 
         public bool IsExempted(string host, X509Certificate2 certificate)
-            => IsExemptedInternal(host, certificate, 1);
+        {
+            ICertificateExemptionIndex exemptionIndex = index;
+
+            if (exemptionIndex != null)
+            {
+                return exemptionIndex.IsExempted(certificate.GetCertHash(), host);
+            }
+
+            return IsExemptedInternal(host, certificate, 1);
+        }
 
         private bool IsExemptedInternal(string host, X509Certificate2 certificate, int triesLeft)
         {
@@ -206,7 +385,7 @@ namespace FilterProvider.Common.Util
                 if (triesLeft > 0)
                 {
                     attemptConnectionRecovery();
-                    return IsExemptedInternal(host, certificate, triesLeft--);
+                    return IsExemptedInternal(host, certificate, triesLeft - 1);
                 }
                 else
                 {
@@ -34,16 +34,33 @@ namespace FilterProvider.Common.Util
     internal class DnsEnforcement
     {
         /// <summary>
-        /// This timer is used to monitor local NIC cards and enforce DNS settings when they are
+        /// Scheduler job used to monitor local NIC cards and enforce DNS settings when they are
         /// configured in the application config.
         /// </summary>
-        private Timer dnsEnforcementTimer;
+        private int dnsEnforcementJob;
 
-        internal DnsEnforcement(IPolicyConfiguration configuration, NLog.Logger logger)
+        private IServiceScheduler scheduler;
+
+        // Unreachable probes back the periodic check off up to this.
+        private static readonly TimeSpan maxEnforcementBackoff = TimeSpan.FromMinutes(5);
+
+        internal DnsEnforcement(IPolicyConfiguration configuration, NLog.Logger logger, IServiceScheduler scheduler)
         {
             this.logger = logger;
+            this.scheduler = scheduler;
             policyConfiguration = configuration;
             platformDns = PlatformTypes.New<IPlatformDns>();
+
+            try
+            {
+                dnsProbe = PlatformTypes.New<IDnsProbe>();
+            }
+            catch (Exception ex)
+            {
+                logger?.Warn(ex, "No DNS probe for this platform, checking DNS servers one at a time.");
+            }
+
+            dnsEnforcementJob = scheduler.AddJob(onEnforcementJob, TimeSpan.FromMilliseconds(60000), TimeSpan.FromSeconds(2), 0.1, maxEnforcementBackoff);
         }
 
         private object dnsEnforcementLock = new object();
@@ -51,6 +68,12 @@ namespace FilterProvider.Common.Util
         private IPolicyConfiguration policyConfiguration;
         private IPlatformDns platformDns;
 
+        // Null if the platform has none, in which case IsDnsUp() asks each server in turn.
+        private IDnsProbe dnsProbe;
+
+        private const string dnsTestHost = "testdns.cloudveil.org";
+        private static readonly TimeSpan dnsProbeTimeout = TimeSpan.FromSeconds(3);
+
         #region DnsEnforcement.Enforce
         
         IPAddress lastPrimaryV4 = null;
@@ -254,6 +277,7 @@ namespace FilterProvider.Common.Util
         public void InvalidateDnsResult()
         {
             lastDnsCheck = DateTime.MinValue;
+            dnsProbe?.FlushCache();
         }
 
         /// <summary>
@@ -262,10 +286,78 @@ namespace FilterProvider.Common.Util
         /// This one's a little sticky because we don't know whether internet is down for sure.
         /// I think it's easy enough to just assume that if we can't reach our DNS servers we should probably flip the switch.
         /// 
-        /// If first server checked is up, no more are checked, and so on.
+        /// All configured IPv4 and IPv6 servers are asked at once, and the first to answer settles it. The verdict is
+        /// reused for as long as the answer's TTL, or briefly if no server answered.
         /// </summary>
         /// <returns>Returns true if at least one of the servers in the configuration returns a response or if there are none configured. Returns false if all servers tried do not return a response.</returns>
         public async Task<bool> IsDnsUp()
+        {
+            if (dnsProbe != null)
+            {
+                try
+                {
+                    return await Task.Run(() => probeDnsServers());
+                }
+                catch (Exception ex)
+                {
+                    logger.Error("DNS probe failed, checking servers one at a time.");
+                    LoggerUtil.RecursivelyLogException(logger, ex);
+                }
+            }
+
+            return await lookupDnsServers();
+        }
+
+        private bool probeDnsServers()
+        {
+            var cfg = policyConfiguration.Configuration;
+
+            if (cfg == null)
+            {
+                // We can't really make a decision on enforcement here, but just return true anyway.
+                return true;
+            }
+
+            List<IPAddress> servers = new List<IPAddress>();
+
+            foreach (string server in new string[] { cfg.PrimaryDns, cfg.SecondaryDns, cfg.PrimaryDnsV6, cfg.SecondaryDnsV6 })
+            {
+                IPAddress address = server.TryParseAsIpAddress();
+
+                if (address != null && !servers.Contains(address))
+                {
+                    servers.Add(address);
+                }
+            }
+
+            if (servers.Count == 0)
+            {
+                return true;
+            }
+
+            dnsProbe.SetServers(servers);
+
+            DnsProbeResult result = dnsProbe.Resolve(dnsTestHost, dnsProbeTimeout);
+
+            if (!result.FromCache)
+            {
+                if (result.IsUp)
+                {
+                    logger.Info("DNS server {0} answered in {1} ms.", result.Server, (int)result.Elapsed.TotalMilliseconds);
+                }
+                else
+                {
+                    logger.Error("No DNS server answered in {0} ms: {1}", (int)result.Elapsed.TotalMilliseconds, string.Join(", ", servers));
+                }
+            }
+
+            return result.IsUp;
+        }
+
+        /// <summary>
+        /// Asks the configured IPv4 servers one after another, for platforms without an IDnsProbe.
+        /// </summary>
+        private async Task<bool> lookupDnsServers()
         {
             if(lastDnsCheck.AddMinutes(5) > DateTime.Now)
             {
@@ -310,7 +402,7 @@ namespace FilterProvider.Common.Util
                     {
                         DnsClient client = new DnsClient(dnsServer);
 
-                        IList<IPAddress> ips = await client.Lookup("testdns.cloudveil.org");
+                        IList<IPAddress> ips = await client.Lookup(dnsTestHost);
 
                         if (ips != null && ips.Count > 0)
                         {
@@ -422,12 +514,20 @@ namespace FilterProvider.Common.Util
         private bool isCaptivePortalActive = false;
 
         public async void Trigger(bool sendDnsChangeEvents = false)
+        {
+            await trigger(sendDnsChangeEvents, false);
+        }
+
+        /// <returns>False if the DNS or captive portal probes failed with an error.</returns>
+        private async Task<bool> trigger(bool sendDnsChangeEvents, bool scheduled)
         {
             if(!NetworkStatus.Default.HasConnection)
             {
-                return;
+                return true;
             }
 
+            bool succeeded = true;
+
             logger.Info("Triggering DNS Enforcement Code (sendDnsChangeEvents={0})", sendDnsChangeEvents);
 
             try
@@ -439,7 +539,7 @@ namespace FilterProvider.Common.Util
                     logger.Info("DNS is down.");
 
                     TryEnforce(sendDnsChangeEvents, enableDnsFiltering: false);
-                    return;
+                    return true;
                 }
 
                 bool isCaptivePortal = await IsBehindCaptivePortal();
@@ -453,12 +553,17 @@ namespace FilterProvider.Common.Util
             {
                 logger.Error("Failed to trigger DnsEnforcement");
                 LoggerUtil.RecursivelyLogException(logger, ex);
+
+                succeeded = false;
             }
 
-            SetupTimers();
+            SetupTimers(scheduled);
+            return succeeded;
         }
 
-        public void SetupTimers()
+        /// <param name="scheduled">True when called from the scheduled check itself, whose next run the scheduler has
+        /// already set up. Any other check pushes the next scheduled one back a whole period.</param>
+        public void SetupTimers(bool scheduled = false)
         {
             int timerTime = isBehindCaptivePortal ? 30000 : 60000;
             if(isCaptivePortalActive)
@@ -466,18 +571,12 @@ namespace FilterProvider.Common.Util
                 timerTime = 5000;
             }
 
-            lock(dnsEnforcementLock)
+            scheduler.SetPeriod(dnsEnforcementJob, TimeSpan.FromMilliseconds(timerTime));
+
+            if (!scheduled)
             {
-                if (dnsEnforcementTimer == null)
-                {
-                    dnsEnforcementTimer = new Timer(TriggerTimer, null, timerTime, timerTime);
-                }
-                else
-                {
-                    dnsEnforcementTimer.Change(TimeSpan.FromMilliseconds(timerTime), TimeSpan.FromMilliseconds(timerTime));
-                }
+                scheduler.Start(dnsEnforcementJob, TimeSpan.FromMilliseconds(timerTime));
             }
-            
         }
 
         public void OnNetworkChange(object sender, EventArgs e)
@@ -508,15 +607,17 @@ namespace FilterProvider.Common.Util
         public event CaptivePortalModeHandler OnCaptivePortalMode;
         #endregion
 
-        private void TriggerTimer(object state)
+        private bool onEnforcementJob()
         {
             try
             {
-                Trigger();
+                // Waits for the probes, so that the scheduler never starts another check while this one is running.
+                return trigger(false, true).GetAwaiter().GetResult();
             }
             catch(Exception ex)
             {
                 LoggerUtil.RecursivelyLogException(logger, ex);
+                return false;
             }
         }
     }
@@ -20,6 +20,12 @@ namespace FilterProvider.Common.Util
 
         private static NLog.Logger logger;
 
+        private const int sealIvLength = 16;
+        private const int sealMacLength = 32;
+
+        // Keeps the MAC key apart from the list key it is made from.
+        private static readonly byte[] sealMacLabel = Encoding.UTF8.GetBytes("CloudVeil sealed file authentication");
+
         public static CryptoStream DecryptionStream(Stream stream)
         {
             try
@@ -95,6 +101,111 @@ namespace FilterProvider.Common.Util
             }
         }
 
+        /// <summary>
+        /// Encrypts with the list key under a new IV, and appends an HMAC of the IV and cipher text keyed from the list
+        /// key too. Unseal only takes back what this build sealed, unchanged.
+        /// </summary>
+        /// <returns>Null if it could not be encrypted.</returns>
+        public static byte[] Seal(byte[] plainBytes)
+        {
+            try
+            {
+                using (RijndaelManaged rijndael = new RijndaelManaged())
+                using (MemoryStream output = new MemoryStream())
+                {
+                    rijndael.Key = CompileSecrets.ListEncryptionKey;
+                    rijndael.Padding = PaddingMode.PKCS7;
+                    rijndael.GenerateIV();
+
+                    output.Write(rijndael.IV, 0, rijndael.IV.Length);
+
+                    using (CryptoStream cs = new CryptoStream(output, rijndael.CreateEncryptor(), CryptoStreamMode.Write))
+                    {
+                        cs.Write(plainBytes, 0, plainBytes.Length);
+                        cs.FlushFinalBlock();
+
+                        byte[] mac = sealMac(output.GetBuffer(), (int)output.Length);
+                        output.Write(mac, 0, mac.Length);
+
+                        return output.ToArray();
+                    }
+                }
+            }
+            catch (Exception ex)
+            {
+                logger.Error($"Failed to seal data: {ex}");
+                return null;
+            }
+        }
+
+        /// <summary>
+        /// Checks the HMAC Seal appended and decrypts what it covers.
+        /// </summary>
+        /// <returns>Null if the data was not sealed with this build's key, or was changed since.</returns>
+        public static byte[] Unseal(byte[] sealedBytes)
+        {
+            if (sealedBytes == null || sealedBytes.Length < sealIvLength + sealMacLength)
+            {
+                return null;
+            }
+
+            int macOffset = sealedBytes.Length - sealMacLength;
+            byte[] expected = sealMac(sealedBytes, macOffset);
+
+            // Every byte is compared, so the time taken doesn't say how much of a forged MAC was right.
+            int difference = 0;
+            for (int i = 0; i < sealMacLength; i++)
+            {
+                difference |= expected[i] ^ sealedBytes[macOffset + i];
+            }
+
+            if (difference != 0)
+            {
+                return null;
+            }
+
+            try
+            {
+                byte[] iv = new byte[sealIvLength];
+                Array.Copy(sealedBytes, iv, sealIvLength);
+
+                using (RijndaelManaged rijndael = new RijndaelManaged())
+                using (MemoryStream output = new MemoryStream())
+                {
+                    rijndael.Padding = PaddingMode.PKCS7;
+
+                    using (ICryptoTransform decryptor = rijndael.CreateDecryptor(CompileSecrets.ListEncryptionKey, iv))
+                    using (CryptoStream cs = new CryptoStream(output, decryptor, CryptoStreamMode.Write))
+                    {
+                        cs.Write(sealedBytes, sealIvLength, macOffset - sealIvLength);
+                        cs.FlushFinalBlock();
+
+                        return output.ToArray();
+                    }
+                }
+            }
+            catch (Exception ex)
+            {
+                logger.Error($"Failed to unseal data: {ex}");
+                return null;
+            }
+        }
+
+        private static byte[] sealMac(byte[] data, int length)
+        {
+            byte[] key;
+
+            using (HMACSHA256 derive = new HMACSHA256(CompileSecrets.ListEncryptionKey))
+            {
+                key = derive.ComputeHash(sealMacLabel);
+            }
+
+            using (HMACSHA256 hmac = new HMACSHA256(key))
+            {
+                return hmac.ComputeHash(data, 0, length);
+            }
+        }
+
         public static byte[] Encrypt(byte[] textBytes)
         {
             try
@@ -1,9 +1,12 @@
 ﻿using CloudVeil.IPC;
 using CloudVeil.IPC.Messages;
+using Filter.Platform.Common;
 using Filter.Platform.Common.Data.Models;
+using Filter.Platform.Common.Types;
 using Filter.Platform.Common.Util;
 using FilterProvider.Common.Configuration;
 using FilterProvider.Common.Data;
+using FilterProvider.Common.Platform;
 using GoproxyWrapper;
 using NodaTime;
 using System;
@@ -13,6 +16,7 @@ using System.Text;
 using System.Linq;
 using System.Threading;
 using System.Net;
+using System.Runtime.InteropServices;
 using CloudVeil;
 using System.Diagnostics;
 using GoProxyWrapper;
@@ -34,6 +38,11 @@ namespace FilterProvider.Common.Util
 
             this.certificateExemptions = certificateExemptions;
 
+            // Passing the method group straight to ContainsTrigger would allocate a new delegate for every response.
+            isCategoryEnabled = policyConfiguration.CategoryIndex.GetIsCategoryEnabled;
+
+            metrics = HotPathMetrics.Default;
+
             policyConfiguration.ListsReloaded += OnListsReloaded;
         }
 
@@ -47,10 +56,19 @@ namespace FilterProvider.Common.Util
 
         private Templates templates;
 
+        private Func<short, bool> isCategoryEnabled;
+
+        private IHotPathMetrics metrics;
+
         private object filterCacheLock = new object();
 
         private IPolicyConfiguration policyConfiguration;
 
+        /// <summary>
+        /// Set by the first response scanned for text triggers, which is when startup is over as far as filtering goes.
+        /// </summary>
+        private int firstScanLogged;
+
         public event RequestBlockedHandler RequestBlocked;
 
         private void OnListsReloaded(object sender, EventArgs e)
@@ -82,15 +100,12 @@ namespace FilterProvider.Common.Util
                 return 0;
             }
 
+            long start = Stopwatch.GetTimestamp();
+
             try
             {
                 ZonedDateTime date = timeDetection.GetRealTime();
-                TimeRestrictionModel todayRestriction = null;
-
-                if (policyConfiguration != null && policyConfiguration.TimeRestrictions != null && date != null)
-                {
-                    todayRestriction = policyConfiguration.TimeRestrictions[(int)date.ToDateTimeOffset().DayOfWeek];
-                }
+                TimeRestrictionSchedule schedule = policyConfiguration?.TimeRestrictionSchedule;
 
                 string urlString = args.Request.Url;
                 Uri url = new Uri(urlString);
@@ -100,9 +115,10 @@ namespace FilterProvider.Common.Util
                 {
                     return 0;
                 }
-                else if (todayRestriction != null && todayRestriction.RestrictionsEnabled && !timeDetection.IsDateTimeAllowed(date, todayRestriction))
+                else if (schedule != null && schedule.AnyEnabled && !schedule.IsAllowed(date))
                 {
                     sendBlockResponse(args, urlString, null, BlockType.TimeRestriction);
+                    metrics?.Add(HotPathCounter.UrlsBlocked, 1);
                     return 1;
                 }
               
@@ -111,6 +127,10 @@ namespace FilterProvider.Common.Util
             {
                 LoggerUtil.RecursivelyLogException(logger, e);
             }
+            finally
+            {
+                metrics?.Record(HotPathMetric.UrlLookup, Stopwatch.GetTimestamp() - start);
+            }
 
             return 0;
         }
@@ -147,6 +167,22 @@ namespace FilterProvider.Common.Util
             return useHtmlBlockPage;
         }
 
+        /// <summary>
+        /// True if the response is for a page the user navigated to, rather than something a page loaded.
+        /// </summary>
+        private bool isDocumentRequest(Session args)
+        {
+            Header fetchDestination = args.Request.Headers.GetFirstHeader("Sec-Fetch-Dest");
+
+            if (fetchDestination != null)
+            {
+                return string.Equals(fetchDestination.Value, "document", StringComparison.OrdinalIgnoreCase);
+            }
+
+            // Older browsers don't say, but a navigation has no referer.
+            return !args.Request.Headers.HeaderExists("Referer");
+        }
+
         private void sendBlockResponse(Session args, string url, int[] categories, BlockType blockType = BlockType.None, string triggerCategory = "", string textTrigger="")
         {
             bool useHtmlBlockPage = this.useHtmlBlockPage(args);
@@ -210,6 +246,7 @@ namespace FilterProvider.Common.Util
                 RequestBlocked?.Invoke((short)categories[0], BlockType.None, new Uri(url), "NOT AVAILABLE", "");
 
                 sendBlockResponse(args, url, categories);
+                metrics?.Add(HotPathCounter.UrlsBlocked, 1);
             }
             catch(Exception ex)
             {
@@ -284,9 +321,13 @@ namespace FilterProvider.Common.Util
                     string textCategory;
 
                     byte[] responseBody = args.Response.Body;
-                    var contentClassResult = OnClassifyContent(responseBody, contentType, out blockType, out textTrigger, out textCategory);
+                    var contentClassResult = OnClassifyContent(responseBody, contentType, isDocumentRequest(args), out blockType, out textTrigger, out textCategory);
+
+                    // Bodies that couldn't be scanned within budget are blocked under a fail closed policy, but
+                    // don't count towards the block threshold since nothing was found in them.
+                    bool unscanned = contentClassResult == UnscannedContent;
 
-                    if (contentClassResult > 0)
+                    if (contentClassResult > 0 || unscanned)
                     {
                         shouldBlock = true;
 
@@ -295,7 +336,7 @@ namespace FilterProvider.Common.Util
                         if (contentType.IndexOf("html") != -1)
                         {
                             customBlockResponseContentType = "text/html";
-                            customBlockResponse = templates.ResolveBlockedSiteTemplate(new Uri(args.Request.Url), contentClassResult, categories, blockType, textCategory, textTrigger);
+                            customBlockResponse = templates.ResolveBlockedSiteTemplate(new Uri(args.Request.Url), unscanned ? 0 : contentClassResult, categories, blockType, textCategory, textTrigger);
                         }
                         else if (contentType.IndexOf("application/json", StringComparison.InvariantCultureIgnoreCase) != -1)
                         {
@@ -303,7 +344,11 @@ namespace FilterProvider.Common.Util
                             customBlockResponse = new byte[0];
                         }
 
-                        RequestBlocked?.Invoke(contentClassResult, blockType, new Uri(args.Request.Url), "", textTrigger);
+                        if (!unscanned)
+                        {
+                            RequestBlocked?.Invoke(contentClassResult, blockType, new Uri(args.Request.Url), "", textTrigger);
+                        }
+
                         logger.Info("Response blocked by content classification.");
                     }
                 }
@@ -347,6 +392,11 @@ namespace FilterProvider.Common.Util
             return categories;
         }
 
+        /// <summary>
+        /// Returned by OnClassifyContent for content that has to be blocked because it couldn't be scanned within budget.
+        /// </summary>
+        private const short UnscannedContent = -1;
+
         /// <summary>
         /// Called by the engine when the engine fails to classify a request or response by its
         /// metadata. The engine provides a full byte array of the content of the request or
@@ -359,20 +409,24 @@ namespace FilterProvider.Common.Util
         /// <param name="contentType">
         /// The declared content type of the data. 
         /// </param>
+        /// <param name="isDocument">
+        /// True for a top-level page, which is scanned ahead of what pages load.
+        /// </param>
         /// <returns>
         /// A numeric category ID that the content was deemed to belong to. Zero is returned here if
         /// the content is not deemed to be part of any known category, which is a general indication
-        /// to the engine that the content should not be blocked.
+        /// to the engine that the content should not be blocked. UnscannedContent (-1) is returned
+        /// if the content couldn't be scanned within the scan budget and has to be blocked anyway.
         /// </returns>
-        private short OnClassifyContent(Memory<byte> data, string contentType, out BlockType blockedBecause, out string textTrigger, out string triggerCategory)
+        private short OnClassifyContent(Memory<byte> data, string contentType, bool isDocument, out BlockType blockedBecause, out string textTrigger, out string triggerCategory)
         {
-            Stopwatch stopwatch = null;
+            long start = 0;
 
             try
             {
                 policyConfiguration.PolicyLock.EnterReadLock();
 
-                stopwatch = Stopwatch.StartNew();
+                start = Stopwatch.GetTimestamp();
 
                 if (policyConfiguration.TextTriggers != null && policyConfiguration.TextTriggers.HasTriggers)
                 {
@@ -380,7 +434,12 @@ namespace FilterProvider.Common.Util
                     var isJson = contentType.IndexOf("json") != -1;
                     if (isHtml || isJson)
                     {
-                        var dataToAnalyzeStr = Encoding.UTF8.GetString(data.ToArray());
+                        ArraySegment<byte> segment;
+                        if (!MemoryMarshal.TryGetArray((ReadOnlyMemory<byte>)data, out segment))
+                        {
+                            segment = new ArraySegment<byte>(data.ToArray());
+                        }
+
                         if (isHtml)
                         {
                             // This doesn't work anymore because google has started sending bad stuff directly
@@ -394,9 +453,33 @@ namespace FilterProvider.Common.Util
                         string trigger = null;
                         var cfg = policyConfiguration.Configuration;
 
-                        if (policyConfiguration.TextTriggers.ContainsTrigger(dataToAnalyzeStr, out matchedCategory, out trigger, policyConfiguration.CategoryIndex.GetIsCategoryEnabled, cfg != null && cfg.MaxTextTriggerScanningSize > 1, cfg != null ? cfg.MaxTextTriggerScanningSize : -1))
+                        metrics?.Add(HotPathCounter.BytesScanned, segment.Count);
+
+                        TriggerScanOutcome outcome = policyConfiguration.TextTriggers.ScanForTrigger(segment, isJson && !isHtml, isDocument, out matchedCategory, out trigger, isCategoryEnabled, cfg != null && cfg.MaxTextTriggerScanningSize > 1, cfg != null ? cfg.MaxTextTriggerScanningSize : -1);
+
+                        if (firstScanLogged == 0 && Interlocked.Exchange(ref firstScanLogged, 1) == 0)
+                        {
+                            logger.Info("First response scanned for text triggers {0:F0} ms after the service started.", (DateTime.Now - Process.GetCurrentProcess().StartTime).TotalMilliseconds);
+                        }
+
+                        if (outcome == TriggerScanOutcome.Truncated)
+                        {
+                            // The scheduler counts these in ScansTruncated as well.
+                            HotPathTrace.Write(TraceEventId.TriggerScanTruncated, segment.Count);
+                        }
+
+                        if (outcome == TriggerScanOutcome.Refused)
+                        {
+                            blockedBecause = BlockType.OtherContentClassification;
+                            textTrigger = "";
+                            triggerCategory = "";
+                            return UnscannedContent;
+                        }
+
+                        if (outcome == TriggerScanOutcome.Matched)
                         {
-                            logger.Info("Triggers successfully run. matchedCategory = {0}, trigger = '{1}'", matchedCategory, trigger);
+                            metrics?.Add(HotPathCounter.TriggerMatches, 1);
+                            HotPathTrace.Write(TraceEventId.TriggerMatched, matchedCategory, segment.Count);
 
                             var mappedCategory = policyConfiguration.GeneratedCategoriesMap.Values.Where(xx => xx.CategoryId == matchedCategory).FirstOrDefault();
 
@@ -412,11 +495,8 @@ namespace FilterProvider.Common.Util
                     } 
                 } else
                 {
-                    logger.Info("No text triggers loaded");
+                    HotPathTrace.Write(TraceEventId.NoTriggersLoaded);
                 }
-                stopwatch.Stop();
-
-                //logger.Info("Text triggers took {0} on {1}", stopwatch.ElapsedMilliseconds, url);
             }
             catch (Exception e)
             {
@@ -424,6 +504,11 @@ namespace FilterProvider.Common.Util
             }
             finally
             {
+                if (start != 0)
+                {
+                    metrics?.Record(HotPathMetric.TriggerScan, Stopwatch.GetTimestamp() - start);
+                }
+
                 policyConfiguration.PolicyLock.ExitReadLock();
             }
 
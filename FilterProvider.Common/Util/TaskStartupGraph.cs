@@ -0,0 +1,192 @@
+/*
+* Copyright © 2019 Cloudveil Technology Inc.
+* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+
+using Filter.Platform.Common.Types;
+using Filter.Platform.Common.Util;
+using FilterProvider.Common.Platform;
+using System;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.Linq;
+using System.Threading.Tasks;
+
+namespace FilterProvider.Common.Util
+{
+    /// <summary>
+    /// IStartupGraph for platforms without a native one. Phases run as tasks that continue from their dependencies, so
+    /// they overlap the same way, but no CPU time is recorded.
+    /// </summary>
+    public class TaskStartupGraph : IStartupGraph
+    {
+        private class Phase
+        {
+            public string Name;
+            public Func<bool> Run;
+            public Phase[] DependsOn;
+
+            public Task Task;
+            public StartupPhaseTiming Timing = new StartupPhaseTiming();
+        }
+
+        private object sync = new object();
+        private List<Phase> phases = new List<Phase>();
+        private Dictionary<string, Phase> byName = new Dictionary<string, Phase>(StringComparer.OrdinalIgnoreCase);
+        private bool started;
+
+        public void AddPhase(string name, Func<bool> run, params string[] dependsOn)
+        {
+            if (string.IsNullOrEmpty(name))
+            {
+                throw new ArgumentNullException(nameof(name));
+            }
+
+            if (run == null)
+            {
+                throw new ArgumentNullException(nameof(run));
+            }
+
+            lock (sync)
+            {
+                if (started)
+                {
+                    throw new InvalidOperationException("Phases can't be added once the graph has run.");
+                }
+
+                if (byName.ContainsKey(name))
+                {
+                    throw new ArgumentException($"There is already a phase named {name}.", nameof(name));
+                }
+
+                List<Phase> dependencies = new List<Phase>();
+
+                foreach (string dependency in dependsOn ?? new string[0])
+                {
+                    Phase phase;
+                    if (dependency == null || !byName.TryGetValue(dependency, out phase))
+                    {
+                        throw new ArgumentException($"{name} depends on {dependency}, which hasn't been added.", nameof(dependsOn));
+                    }
+
+                    if (!dependencies.Contains(phase))
+                    {
+                        dependencies.Add(phase);
+                    }
+                }
+
+                Phase added = new Phase()
+                {
+                    Name = name,
+                    Run = run,
+                    DependsOn = dependencies.ToArray()
+                };
+
+                phases.Add(added);
+                byName.Add(name, added);
+            }
+        }
+
+        public StartupTrace Run()
+        {
+            lock (sync)
+            {
+                if (started)
+                {
+                    throw new InvalidOperationException("The graph has already run.");
+                }
+
+                started = true;
+            }
+
+            DateTime startedAt = DateTime.Now;
+            Stopwatch clock = Stopwatch.StartNew();
+
+            // Phases only depend on phases added before them, so each one's dependencies already have tasks.
+            foreach (Phase phase in phases)
+            {
+                Phase current = phase;
+
+                if (current.DependsOn.Length == 0)
+                {
+                    current.Task = Task.Run(() => runPhase(current, clock));
+                }
+                else
+                {
+                    current.Task = Task.Factory.ContinueWhenAll(current.DependsOn.Select(d => d.Task).ToArray(), (done) => runPhase(current, clock),
+                        TaskScheduler.Default);
+                }
+            }
+
+            Task.WaitAll(phases.Select(p => p.Task).ToArray());
+
+            markCriticalPath();
+
+            return new StartupTrace()
+            {
+                StartedAt = startedAt,
+                SinceProcessStartMs = sinceProcessStart(startedAt),
+                TotalMs = phases.Count > 0 ? phases.Max(p => p.Timing.EndMs) : 0,
+                Phases = phases.Select(p => p.Timing).ToArray()
+            };
+        }
+
+        private void runPhase(Phase phase, Stopwatch clock)
+        {
+            StartupPhaseTiming timing = phase.Timing;
+
+            timing.Name = phase.Name;
+            timing.DependsOn = phase.DependsOn.Select(d => d.Name).ToArray();
+            timing.StartMs = clock.Elapsed.TotalMilliseconds;
+
+            bool succeeded = false;
+
+            try
+            {
+                succeeded = phase.Run();
+            }
+            catch (Exception ex)
+            {
+                LoggerUtil.GetAppWideLogger()?.Error(ex, "Startup phase {0} failed.", phase.Name);
+            }
+
+            timing.EndMs = clock.Elapsed.TotalMilliseconds;
+            timing.State = succeeded ? StartupPhaseState.Succeeded : StartupPhaseState.Failed;
+        }
+
+        private void markCriticalPath()
+        {
+            foreach (Phase phase in phases)
+            {
+                Phase waitedOn = phase.DependsOn.OrderByDescending(d => d.Timing.EndMs).FirstOrDefault();
+                phase.Timing.WaitedOn = waitedOn?.Name;
+            }
+
+            Phase last = phases.OrderByDescending(p => p.Timing.EndMs).FirstOrDefault();
+
+            while (last != null)
+            {
+                last.Timing.Critical = true;
+                last = last.Timing.WaitedOn != null ? byName[last.Timing.WaitedOn] : null;
+            }
+        }
+
+        private static double sinceProcessStart(DateTime startedAt)
+        {
+            try
+            {
+                using (Process process = Process.GetCurrentProcess())
+                {
+                    return Math.Max(0, (startedAt - process.StartTime).TotalMilliseconds);
+                }
+            }
+            catch (Exception)
+            {
+                return 0;
+            }
+        }
+    }
+}
@@ -2,17 +2,32 @@
 using CloudVeil;
 using Filter.Platform.Common.Data.Models;
 using System;
+using System.Collections.Concurrent;
 using System.Collections.Generic;
 using System.Text;
 using System.Linq;
 using FilterProvider.Common.Configuration;
+using FilterProvider.Common.Platform;
 using HandlebarsDotNet;
+using Filter.Platform.Common;
 using Filter.Platform.Common.Util;
 
 namespace FilterProvider.Common.Util
 {
     public class Templates
     {
+        // Names the compiled pages use, in the order their Resolve methods pass values.
+        private static readonly string[] blockedPageSlots =
+        {
+            "url_text", "friendly_url_text", "message", "matching_category", "other_categories", "showUnblockRequestButton",
+            "passcodeSetupUrl", "unblockRequest", "isRelaxedPolicy", "isRelaxedPolicyPasscodeRequired", "serverPort"
+        };
+
+        private static readonly string[] badSslPageSlots =
+        {
+            "url_text", "friendly_url_text", "host", "certThumbprintExists", "certThumbprint", "serverPort"
+        };
+
         public Templates(IPolicyConfiguration configuration)
         {
             logger = LoggerUtil.GetAppWideLogger();
@@ -21,11 +36,17 @@ namespace FilterProvider.Common.Util
 
             // Get our blocked HTML page
             byte[] htmlBytes = ResourceStreams.Get("FilterProvider.Common.Resources.BlockedPage.html");
-            blockedHtmlPage = Handlebars.Compile(Encoding.UTF8.GetString(htmlBytes));
-
             badSslHtmlPage = ResourceStreams.Get("FilterProvider.Common.Resources.BadCertPage.html");
 
-            if (blockedHtmlPage == null)
+            compiledBlockedPage = compile(htmlBytes, blockedPageSlots);
+            compiledBadSslPage = compile(badSslHtmlPage, badSslPageSlots);
+
+            if (compiledBlockedPage == null && htmlBytes != null)
+            {
+                blockedHtmlPage = Handlebars.Compile(Encoding.UTF8.GetString(htmlBytes));
+            }
+
+            if (compiledBlockedPage == null && blockedHtmlPage == null)
             {
                 logger.Error("Could not load packed HTML block page.");
             }
@@ -34,10 +55,63 @@ namespace FilterProvider.Common.Util
             {
                 logger.Error("Could not load packed HTML bad SSL page.");
             }
+
+            if (policyConfiguration != null)
+            {
+                // Category names and relaxed policy membership can change with either.
+                policyConfiguration.OnConfigurationLoaded += (sender, e) => fragments.Clear();
+                policyConfiguration.ListsReloaded += (sender, e) => fragments.Clear();
+            }
+        }
+
+        /// <summary>
+        /// The parts of a block page that depend only on why the page was blocked.
+        /// </summary>
+        private class BlockPageFragment
+        {
+            // Short name of the matched category for the unblock request, from before it was replaced by a block reason.
+            public string CategoryName;
+
+            public string Message;
+            public string MatchingCategory;
+
+            // The same two, encoded once for the compiled page.
+            public byte[] MessageBytes;
+            public byte[] MatchingCategoryBytes;
+
+            public bool IsRelaxedPolicy;
+            public bool ShowUnblockRequestButton;
+            public bool ListsOtherCategories;
+        }
+
+        private struct FragmentKey : IEquatable<FragmentKey>
+        {
+            public int Category;
+            public BlockType BlockType;
+            public string TriggerCategory;
+
+            public bool Equals(FragmentKey other)
+            {
+                return Category == other.Category && BlockType == other.BlockType && TriggerCategory == other.TriggerCategory;
+            }
+
+            public override bool Equals(object obj)
+            {
+                return obj is FragmentKey && Equals((FragmentKey)obj);
+            }
+
+            public override int GetHashCode()
+            {
+                return (Category * 31 + (int)BlockType) * 31 + (TriggerCategory?.GetHashCode() ?? 0);
+            }
         }
 
         private NLog.Logger logger;
 
+        // Native templates, or null if the platform doesn't have them or they failed to compile.
+        private IPageTemplate compiledBlockedPage;
+        private IPageTemplate compiledBadSslPage;
+
         // Uses Handlebars.Net for compilation of this template function.
         private Func<object, string> blockedHtmlPage;
 
@@ -45,10 +119,49 @@ namespace FilterProvider.Common.Util
 
         private IPolicyConfiguration policyConfiguration;
 
-        public byte[] ResolveBadSslTemplate(Uri requestUri, string certThumbprint)
+        private ConcurrentDictionary<FragmentKey, BlockPageFragment> fragments = new ConcurrentDictionary<FragmentKey, BlockPageFragment>();
+
+        private Tuple<ushort, string> serverPort;
+
+        private IPageTemplate compile(byte[] source, string[] slotNames)
         {
-            string pageTemplate = Encoding.UTF8.GetString(badSslHtmlPage);
+            if (source == null)
+            {
+                return null;
+            }
+
+            IPageTemplate page = null;
 
+            try
+            {
+                page = PlatformTypes.New<IPageTemplate>();
+                page.Compile(source, slotNames);
+                return page;
+            }
+            catch (Exception ex)
+            {
+                page?.Dispose();
+                logger?.Warn(ex, "Could not compile a block page natively. It will be rendered by string replacement and Handlebars.");
+                return null;
+            }
+        }
+
+        private string serverPortText()
+        {
+            ushort port = AppSettings.Default.ConfigServerPort;
+            Tuple<ushort, string> cached = serverPort;
+
+            if (cached == null || cached.Item1 != port)
+            {
+                cached = Tuple.Create(port, port.ToString());
+                serverPort = cached;
+            }
+
+            return cached.Item2;
+        }
+
+        public byte[] ResolveBadSslTemplate(Uri requestUri, string certThumbprint)
+        {
             // Produces something that looks like "www.badsite.com/example?arg=0" instead of "http://www.badsite.com/example?arg=0"
             // IMO this looks slightly more friendly to a user than the entire URI.
             string friendlyUrlText = (requestUri.Host + requestUri.PathAndQuery + requestUri.Fragment).TrimEnd('/');
@@ -56,52 +169,120 @@ namespace FilterProvider.Common.Util
 
             urlText = urlText == null ? "" : urlText;
 
+            if (compiledBadSslPage != null)
+            {
+                return compiledBadSslPage.Render(new object[]
+                {
+                    urlText, friendlyUrlText, requestUri.Host, certThumbprint == null ? "false" : "true", certThumbprint, serverPortText()
+                });
+            }
+
+            string pageTemplate = Encoding.UTF8.GetString(badSslHtmlPage);
+
             pageTemplate = pageTemplate.Replace("{{url_text}}", urlText);
             pageTemplate = pageTemplate.Replace("{{friendly_url_text}}", friendlyUrlText);
             pageTemplate = pageTemplate.Replace("{{host}}", requestUri.Host);
             pageTemplate = pageTemplate.Replace("{{certThumbprintExists}}", certThumbprint == null ? "false" : "true");
             pageTemplate = pageTemplate.Replace("{{certThumbprint}}", certThumbprint);
-            pageTemplate = pageTemplate.Replace("{{serverPort}}", AppSettings.Default.ConfigServerPort.ToString());
+            pageTemplate = pageTemplate.Replace("{{serverPort}}", serverPortText());
 
             return Encoding.UTF8.GetBytes(pageTemplate);
         }
 
         public byte[] ResolveBlockedSiteTemplate(Uri requestUri, int matchingCategory, List<MappedFilterListCategoryModel> appliedCategories, BlockType blockType = BlockType.None, string triggerCategory = "", string triggerText = "")
         {
-            Dictionary<string, object> blockPageContext = new Dictionary<string, object>();
-
             // Produces something that looks like "www.badsite.com/example?arg=0" instead of "http://www.badsite.com/example?arg=0"
             // In my opninion this looks slightly more friendly to a user than the entire URI.
             string friendlyUrlText = (requestUri.Host + requestUri.PathAndQuery + requestUri.Fragment).TrimEnd('/');
             string urlText = requestUri.ToString();
 
+            BlockPageFragment fragment = getFragment(matchingCategory, blockType, triggerCategory);
+
+            List<string> otherCategories = null;
+            if (fragment.ListsOtherCategories)
+            {
+                otherCategories = appliedCategories?
+                    .Where(c => c.CategoryId != matchingCategory)
+                    .Select(c => c.ShortCategoryName)
+                    .Distinct()
+                    .ToList();
+            }
+
+            string unblockRequest = getUnblockRequestUrl(urlText, triggerText, fragment.CategoryName);
+
+            string url_text = urlText == null ? "" : urlText;
+
+            if (compiledBlockedPage != null)
+            {
+                return compiledBlockedPage.Render(new object[]
+                {
+                    url_text, friendlyUrlText, fragment.MessageBytes, fragment.MatchingCategoryBytes, otherCategories,
+                    fragment.ShowUnblockRequestButton, CompileSecrets.ServiceProviderUserRelaxedPolicyPath, unblockRequest,
+                    fragment.IsRelaxedPolicy, policyConfiguration?.Configuration?.EnableRelaxedPolicyPasscode == true, serverPortText()
+                });
+            }
+
+            Dictionary<string, object> blockPageContext = new Dictionary<string, object>();
+
+            blockPageContext.Add("url_text", url_text);
+            blockPageContext.Add("friendly_url_text", friendlyUrlText);
+            blockPageContext.Add("message", fragment.Message);
+            blockPageContext.Add("matching_category", fragment.MatchingCategory);
+            blockPageContext.Add("other_categories", otherCategories);
+            blockPageContext.Add("showUnblockRequestButton", fragment.ShowUnblockRequestButton);
+            blockPageContext.Add("passcodeSetupUrl", CompileSecrets.ServiceProviderUserRelaxedPolicyPath);
+            blockPageContext.Add("unblockRequest", unblockRequest);
+            blockPageContext.Add("isRelaxedPolicy", fragment.IsRelaxedPolicy);
+            blockPageContext.Add("isRelaxedPolicyPasscodeRequired", policyConfiguration?.Configuration?.EnableRelaxedPolicyPasscode);
+            blockPageContext.Add("serverPort", AppSettings.Default.ConfigServerPort);
+
+            return Encoding.UTF8.GetBytes(blockedHtmlPage(blockPageContext));
+        }
+
+        private BlockPageFragment getFragment(int matchingCategory, BlockType blockType, string triggerCategory)
+        {
+            bool usesTriggerCategory = blockType == BlockType.TextClassification || blockType == BlockType.TextTrigger;
+
+            FragmentKey key = new FragmentKey()
+            {
+                Category = matchingCategory,
+                BlockType = blockType,
+                TriggerCategory = usesTriggerCategory ? triggerCategory : null
+            };
+
+            BlockPageFragment fragment;
+            if (!fragments.TryGetValue(key, out fragment))
+            {
+                fragment = describeBlock(matchingCategory, blockType, triggerCategory);
+                fragments[key] = fragment;
+            }
+
+            return fragment;
+        }
+
+        private BlockPageFragment describeBlock(int matchingCategory, BlockType blockType, string triggerCategory)
+        {
             bool showUnblockRequestButton = true;
+            bool listsOtherCategories = true;
 
             string message = "was blocked because it was in the following category:";
 
-            // Collect category information: Blocked category, other categories, and whether the blocked category is in the relaxed policy.
+            // Collect category information: Blocked category and whether the blocked category is in the relaxed policy.
             MappedFilterListCategoryModel matchingCategoryModel = policyConfiguration.GeneratedCategoriesMap.Values.FirstOrDefault(m => m.CategoryId == matchingCategory);
             string matchingCatergoryName = matchingCategoryModel?.ShortCategoryName;
 
-            List<string> otherCategories = appliedCategories?
-                .Where(c => c.CategoryId != matchingCategory)
-                .Select(c => c.ShortCategoryName)
-                .Distinct()
-                .ToList();
-
             bool isRelaxedPolicy = (matchingCategoryModel is MappedBypassListCategoryModel);
 
-            string unblockRequest = getUnblockRequestUrl(urlText, triggerText, matchingCatergoryName);
+            string categoryName = matchingCatergoryName;
 
             // Get category or block type.
-            string url_text = urlText == null ? "" : urlText;
             if (matchingCategory > 0 && blockType == BlockType.None)
             {
                 // matching_category name already set.
             }
             else
             {
-                otherCategories = null;
+                listsOtherCategories = false;
                 switch (blockType)
                 {
                     case BlockType.None:
@@ -133,20 +314,18 @@ namespace FilterProvider.Common.Util
                         break;
                 }
             }
-            
-            blockPageContext.Add("url_text", url_text);
-            blockPageContext.Add("friendly_url_text", friendlyUrlText);
-            blockPageContext.Add("message", message);
-            blockPageContext.Add("matching_category", matchingCatergoryName);
-            blockPageContext.Add("other_categories", otherCategories);
-            blockPageContext.Add("showUnblockRequestButton", showUnblockRequestButton);
-            blockPageContext.Add("passcodeSetupUrl", CompileSecrets.ServiceProviderUserRelaxedPolicyPath);
-            blockPageContext.Add("unblockRequest", unblockRequest);
-            blockPageContext.Add("isRelaxedPolicy", isRelaxedPolicy);
-            blockPageContext.Add("isRelaxedPolicyPasscodeRequired", policyConfiguration?.Configuration?.EnableRelaxedPolicyPasscode);
-            blockPageContext.Add("serverPort", AppSettings.Default.ConfigServerPort);
 
-            return Encoding.UTF8.GetBytes(blockedHtmlPage(blockPageContext));
+            return new BlockPageFragment()
+            {
+                CategoryName = categoryName,
+                Message = message,
+                MatchingCategory = matchingCatergoryName,
+                MessageBytes = Encoding.UTF8.GetBytes(message),
+                MatchingCategoryBytes = Encoding.UTF8.GetBytes(matchingCatergoryName ?? ""),
+                IsRelaxedPolicy = isRelaxedPolicy,
+                ShowUnblockRequestButton = showUnblockRequestButton,
+                ListsOtherCategories = listsOtherCategories
+            };
         }
 
         public static string getUnblockRequestUrl(string blockedUrl, string blockedTerm, string category)
@@ -160,6 +160,11 @@ namespace FilterProvider.Common.Util
 
         public event EventHandler<ZoneTamperingEventArgs> ZoneTamperingDetected;
 
+        /// <summary>
+        /// Raised when the local clock has jumped against the server time by more than a minute.
+        /// </summary>
+        public event EventHandler TimeTamperingDetected;
+
         public ZonedDateTime GetRealTime()
         {
             try
@@ -181,6 +186,10 @@ namespace FilterProvider.Common.Util
                     {
                         ZoneTamperingDetected?.Invoke(this, new ZoneTamperingEventArgs(oldZone, lastDetectedZone));
                     }
+                    else if (tamperingResult == TamperDetection.TimeTampering)
+                    {
+                        TimeTamperingDetected?.Invoke(this, EventArgs.Empty);
+                    }
 
                     if (timeSinceLastServerMeasurement.ElapsedMilliseconds > ServerTimeRefreshMilliseconds)
                     {
@@ -0,0 +1,216 @@
+/*
+* Copyright © 2019 Cloudveil Technology Inc.
+* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+using Filter.Platform.Common.Data.Models;
+using NodaTime;
+using System;
+
+namespace FilterProvider.Common.Util
+{
+    /// <summary>
+    /// A week of time restrictions compiled into one bit per wall clock minute, set where internet access is allowed.
+    /// Checking a moment is a single bit test. The next moment the answer can change is found by scanning the bitmap a
+    /// word at a time.
+    /// </summary>
+    /// <remarks>
+    /// The bitmap is in local time, so it follows the zone of whatever time it is asked about. NextTransition() deals
+    /// with the local times a DST change skips or repeats.
+    /// </remarks>
+    public class TimeRestrictionSchedule
+    {
+        private const int MinutesPerDay = 24 * 60;
+        private const int MinutesPerWeek = 7 * MinutesPerDay;
+
+        private readonly ulong[] allowed = new ulong[(MinutesPerWeek + 63) / 64];
+
+        /// <param name="restrictions">Indexed by DayOfWeek, like IPolicyConfiguration.TimeRestrictions. Missing days are unrestricted.</param>
+        public TimeRestrictionSchedule(TimeRestrictionModel[] restrictions)
+        {
+            for (int day = 0; day < 7; day++)
+            {
+                TimeRestrictionModel model = restrictions != null && day < restrictions.Length ? restrictions[day] : null;
+                int dayStart = day * MinutesPerDay;
+
+                if (model == null || !model.RestrictionsEnabled)
+                {
+                    setRange(dayStart, dayStart + MinutesPerDay);
+                    continue;
+                }
+
+                AnyEnabled = true;
+
+                if (model.EnabledThrough == null)
+                {
+                    continue;
+                }
+
+                for (int i = 0; i + 1 < model.EnabledThrough.Length; i += 2)
+                {
+                    setRange(dayStart + minuteOfDay(model.EnabledThrough[i]), dayStart + minuteOfDay(model.EnabledThrough[i + 1]));
+                }
+            }
+        }
+
+        /// <summary>
+        /// False if no day has restrictions turned on, in which case everything is allowed.
+        /// </summary>
+        public bool AnyEnabled { get; private set; }
+
+        public bool IsAllowed(ZonedDateTime time)
+        {
+            return isSet(minuteOfWeek(time.LocalDateTime));
+        }
+
+        /// <summary>
+        /// The first moment after time at which IsAllowed() may give a different answer, or null if it never will.
+        /// This is either a restriction boundary or the next change of the zone's offset, since a repeated hour can
+        /// cross a boundary twice.
+        /// </summary>
+        public Instant? NextTransition(ZonedDateTime time)
+        {
+            Instant now = time.ToInstant();
+            DateTimeZone zone = time.Zone;
+
+            ZoneInterval interval = zone.GetZoneInterval(now);
+            Instant? offsetChange = interval.HasEnd ? interval.End : (Instant?)null;
+
+            LocalDateTime minuteStart = time.LocalDateTime.With(TimeAdjusters.TruncateToMinute);
+            int position = minuteOfWeek(minuteStart);
+            bool state = isSet(position);
+
+            long ahead = 0;
+
+            // Two weeks covers every boundary at least once, even if the first few map to moments already past.
+            while (ahead < 2 * MinutesPerWeek)
+            {
+                int distance = distanceToChange(position, state);
+                if (distance < 0)
+                {
+                    break;
+                }
+
+                ahead += distance;
+                position = (position + distance) % MinutesPerWeek;
+                state = !state;
+
+                Instant candidate = firstInstantAt(zone, minuteStart.PlusMinutes(ahead), now);
+
+                if (offsetChange.HasValue && candidate >= offsetChange.Value)
+                {
+                    break;
+                }
+
+                if (candidate > now)
+                {
+                    return candidate;
+                }
+            }
+
+            return offsetChange;
+        }
+
+        // Whole minutes into the day from the decimal hours the server sends, dropping seconds the way
+        // TimeDetection.GetTimeSpanFromDecimal() does. 24 means the end of the day.
+        private static int minuteOfDay(decimal hours)
+        {
+            decimal minutes = Math.Truncate(hours * 60);
+
+            return (int)Math.Max(0, Math.Min(MinutesPerDay, minutes));
+        }
+
+        private static int minuteOfWeek(LocalDateTime local)
+        {
+            // IsoDayOfWeek runs from Monday = 1 to Sunday = 7, and DayOfWeek from Sunday = 0.
+            int day = (int)local.DayOfWeek % 7;
+            return day * MinutesPerDay + local.Hour * 60 + local.Minute;
+        }
+
+        // The earliest moment after the given one that local maps to. A local time skipped by a gap maps to the end of
+        // the gap, since that's when the wall clock passes it.
+        private static Instant firstInstantAt(DateTimeZone zone, LocalDateTime local, Instant after)
+        {
+            ZoneLocalMapping mapping = zone.MapLocal(local);
+
+            if (mapping.Count == 0)
+            {
+                return mapping.LateInterval.Start;
+            }
+
+            Instant first = mapping.First().ToInstant();
+            if (mapping.Count == 2 && first <= after)
+            {
+                return mapping.Last().ToInstant();
+            }
+
+            return first;
+        }
+
+        private bool isSet(int minute)
+        {
+            return (allowed[minute >> 6] & (1UL << (minute & 63))) != 0;
+        }
+
+        // Sets the minutes from start up to but not including end.
+        private void setRange(int start, int end)
+        {
+            for (int minute = start; minute < end; minute++)
+            {
+                allowed[minute >> 6] |= 1UL << (minute & 63);
+            }
+        }
+
+        /// <returns>Minutes from position to the next minute whose bit differs from state, wrapping round the week, or -1 if there is none.</returns>
+        private int distanceToChange(int position, bool state)
+        {
+            ulong flip = state ? ulong.MaxValue : 0;
+
+            int found = findDifferent(position + 1, MinutesPerWeek, flip);
+            if (found >= 0)
+            {
+                return found - position;
+            }
+
+            found = findDifferent(0, position, flip);
+            return found >= 0 ? found + MinutesPerWeek - position : -1;
+        }
+
+        // First minute in [begin, end) whose bit is not the one repeated in flip, or -1.
+        private int findDifferent(int begin, int end, ulong flip)
+        {
+            int minute = begin;
+
+            while (minute < end)
+            {
+                int word = minute >> 6;
+                ulong bits = (allowed[word] ^ flip) & (ulong.MaxValue << (minute & 63));
+
+                if (bits != 0)
+                {
+                    int found = (word << 6) + trailingZeros(bits);
+                    return found < end ? found : -1;
+                }
+
+                minute = (word + 1) << 6;
+            }
+
+            return -1;
+        }
+
+        private static int trailingZeros(ulong bits)
+        {
+            int count = 0;
+
+            while ((bits & 1) == 0)
+            {
+                bits >>= 1;
+                count++;
+            }
+
+            return count;
+        }
+    }
+}
@@ -0,0 +1,354 @@
+/*
+* Copyright © 2019 Cloudveil Technology Inc.
+* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+
+using Filter.Platform.Common.Util;
+using FilterProvider.Common.Platform;
+using System;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.Threading;
+
+namespace FilterProvider.Common.Util
+{
+    /// <summary>
+    /// IServiceScheduler for platforms without a native one. Each job still gets its own thread pool timer, so there is no
+    /// coalescing, and periodic jobs are re-armed when a run ends rather than when it starts. Jobs keep the same
+    /// no-overlap, backoff and jitter behavior.
+    /// </summary>
+    public class TimerServiceScheduler : IServiceScheduler
+    {
+        private const int MaxBackoffDoublings = 16;
+
+        private class Job
+        {
+            public Func<bool> Run;
+            public TimeSpan Period;
+            public double Jitter;
+            public TimeSpan MaxBackoff;
+
+            public Timer Timer;
+
+            public int Failures;
+
+            // Cleared by Stop(), so a callback that was already on its way does nothing.
+            public bool Armed;
+            public bool Running;
+
+            // What Start() and Stop() asked for while the job was running.
+            public TimeSpan? PendingStart;
+            public bool StopPending;
+        }
+
+        private object sync = new object();
+        private List<Job> jobs = new List<Job>();
+        private Random random = new Random();
+        private SchedulerCounters counters = new SchedulerCounters();
+        private bool disposed;
+
+        public int AddJob(Func<bool> job, TimeSpan period, TimeSpan slack, double jitter = 0, TimeSpan maxBackoff = default(TimeSpan))
+        {
+            if (job == null)
+            {
+                throw new ArgumentNullException(nameof(job));
+            }
+
+            if (jitter < 0 || jitter >= 1)
+            {
+                throw new ArgumentOutOfRangeException(nameof(jitter));
+            }
+
+            lock (sync)
+            {
+                if (disposed)
+                {
+                    throw new ObjectDisposedException(nameof(TimerServiceScheduler));
+                }
+
+                Job state = new Job()
+                {
+                    Run = job,
+                    Period = period,
+                    Jitter = jitter,
+                    MaxBackoff = maxBackoff
+                };
+
+                state.Timer = new Timer(onTimer, state, Timeout.Infinite, Timeout.Infinite);
+
+                jobs.Add(state);
+                return jobs.Count - 1;
+            }
+        }
+
+        public void Start(int job, TimeSpan delay)
+        {
+            lock (sync)
+            {
+                Job state = jobs[job];
+
+                if (state.Running)
+                {
+                    if (!state.PendingStart.HasValue)
+                    {
+                        counters.Deferred++;
+                    }
+
+                    state.PendingStart = delay;
+                    state.StopPending = false;
+                    return;
+                }
+
+                arm(state, delay);
+            }
+        }
+
+        public void Stop(int job)
+        {
+            lock (sync)
+            {
+                Job state = jobs[job];
+
+                state.Armed = false;
+                state.Timer.Change(Timeout.Infinite, Timeout.Infinite);
+
+                if (state.Running)
+                {
+                    state.PendingStart = null;
+                    state.StopPending = true;
+                }
+            }
+        }
+
+        public void SetPeriod(int job, TimeSpan period)
+        {
+            lock (sync)
+            {
+                jobs[job].Period = period;
+            }
+        }
+
+        public ISlidingWindowCounter NewCounter(TimeSpan window)
+        {
+            return new WindowCounter(window);
+        }
+
+        public SchedulerCounters GetCounters()
+        {
+            lock (sync)
+            {
+                return new SchedulerCounters()
+                {
+                    Wakeups = counters.Wakeups,
+                    IdleWakeups = counters.IdleWakeups,
+                    Runs = counters.Runs,
+                    Failures = counters.Failures,
+                    Coalesced = counters.Coalesced,
+                    Deferred = counters.Deferred
+                };
+            }
+        }
+
+        public void Dispose()
+        {
+            lock (sync)
+            {
+                disposed = true;
+
+                foreach (Job job in jobs)
+                {
+                    job.Armed = false;
+                    job.Timer.Dispose();
+                }
+            }
+        }
+
+        private void onTimer(object obj)
+        {
+            Job state = (Job)obj;
+
+            lock (sync)
+            {
+                counters.Wakeups++;
+
+                if (!state.Armed || state.Running || disposed)
+                {
+                    counters.IdleWakeups++;
+                    return;
+                }
+
+                state.Armed = false;
+                state.Running = true;
+                counters.Runs++;
+            }
+
+            bool succeeded = false;
+
+            try
+            {
+                succeeded = state.Run();
+            }
+            catch (Exception ex)
+            {
+                LoggerUtil.GetAppWideLogger()?.Error(ex, "Scheduled job failed.");
+            }
+            finally
+            {
+                complete(state, succeeded);
+            }
+        }
+
+        private void complete(Job state, bool succeeded)
+        {
+            lock (sync)
+            {
+                state.Running = false;
+
+                if (succeeded)
+                {
+                    state.Failures = 0;
+                }
+                else
+                {
+                    counters.Failures++;
+                    state.Failures = Math.Min(state.Failures + 1, MaxBackoffDoublings);
+                }
+
+                if (disposed)
+                {
+                    return;
+                }
+
+                if (state.StopPending)
+                {
+                    state.StopPending = false;
+                    return;
+                }
+
+                if (state.PendingStart.HasValue)
+                {
+                    TimeSpan delay = state.PendingStart.Value;
+                    state.PendingStart = null;
+
+                    arm(state, delay);
+                    return;
+                }
+
+                if (state.Period <= TimeSpan.Zero)
+                {
+                    return;
+                }
+
+                TimeSpan next = state.Period;
+
+                if (state.Failures > 0 && state.MaxBackoff > state.Period)
+                {
+                    long ticks = state.Period.Ticks << state.Failures;
+                    next = ticks <= 0 || ticks > state.MaxBackoff.Ticks ? state.MaxBackoff : TimeSpan.FromTicks(ticks);
+                }
+
+                arm(state, next);
+            }
+        }
+
+        // Called with sync held.
+        private void arm(Job state, TimeSpan delay)
+        {
+            if (delay < TimeSpan.Zero)
+            {
+                delay = TimeSpan.Zero;
+            }
+
+            if (state.Jitter > 0)
+            {
+                delay -= TimeSpan.FromTicks((long)(delay.Ticks * state.Jitter * random.NextDouble()));
+            }
+
+            state.Armed = true;
+            state.Timer.Change(delay, Timeout.InfiniteTimeSpan);
+        }
+
+        private class WindowCounter : ISlidingWindowCounter
+        {
+            private const int BucketCount = 16;
+
+            private object sync = new object();
+            private Stopwatch clock = Stopwatch.StartNew();
+            private long bucketMs;
+
+            private long[] epochs = new long[BucketCount];
+            private long[] counts = new long[BucketCount];
+
+            public WindowCounter(TimeSpan window)
+            {
+                if (window <= TimeSpan.Zero)
+                {
+                    throw new ArgumentOutOfRangeException(nameof(window));
+                }
+
+                bucketMs = Math.Max(1, (long)window.TotalMilliseconds / BucketCount);
+            }
+
+            public long Total
+            {
+                get
+                {
+                    lock (sync)
+                    {
+                        return total(clock.ElapsedMilliseconds / bucketMs);
+                    }
+                }
+            }
+
+            public long Add(long amount = 1)
+            {
+                lock (sync)
+                {
+                    long epoch = clock.ElapsedMilliseconds / bucketMs;
+                    int index = (int)(epoch % BucketCount);
+
+                    if (epochs[index] != epoch)
+                    {
+                        epochs[index] = epoch;
+                        counts[index] = 0;
+                    }
+
+                    counts[index] += amount;
+
+                    return total(epoch);
+                }
+            }
+
+            public void Reset()
+            {
+                lock (sync)
+                {
+                    Array.Clear(epochs, 0, BucketCount);
+                    Array.Clear(counts, 0, BucketCount);
+                }
+            }
+
+            public void Dispose()
+            {
+            }
+
+            private long total(long epoch)
+            {
+                long sum = 0;
+
+                for (int i = 0; i < BucketCount; i++)
+                {
+                    if (epochs[i] + BucketCount > epoch)
+                    {
+                        sum += counts[i];
+                    }
+                }
+
+                return sum;
+            }
+        }
+    }
+}
@@ -0,0 +1,63 @@
+#include "AllocationCounter.h"
+
+#include <cstdlib>
+#include <new>
+
+static thread_local AllocationCount counted;
+
+AllocationCount CurrentThreadAllocations() {
+    return counted;
+}
+
+static void* allocate(std::size_t size) {
+    counted.allocations++;
+    counted.bytes += size;
+
+    return malloc(size == 0 ? 1 : size);
+}
+
+void* operator new(std::size_t size) {
+    void* block = allocate(size);
+
+    if (block == NULL) {
+        throw std::bad_alloc();
+    }
+
+    return block;
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size);
+}
+
+void operator delete(void* block) noexcept {
+    free(block);
+}
+
+void operator delete[](void* block) noexcept {
+    free(block);
+}
+
+void operator delete(void* block, std::size_t) noexcept {
+    free(block);
+}
+
+void operator delete[](void* block, std::size_t) noexcept {
+    free(block);
+}
+
+void operator delete(void* block, const std::nothrow_t&) noexcept {
+    free(block);
+}
+
+void operator delete[](void* block, const std::nothrow_t&) noexcept {
+    free(block);
+}
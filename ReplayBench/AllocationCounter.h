@@ -0,0 +1,14 @@
+#pragma once
+
+typedef struct AllocationCount {
+    unsigned long long allocations;
+    unsigned long long bytes;
+} AllocationCount;
+
+/// Heap allocations made through operator new on the calling thread since it started. Linking
+/// AllocationCounter.cpp replaces the global operator new and delete to keep these counts, so a
+/// stage can be charged for what it allocated by reading them before and after.
+///
+/// Only the calling thread is counted. Work a stage hands to the shared pool shows up in the
+/// scan allocation totals instead.
+AllocationCount CurrentThreadAllocations();
@@ -0,0 +1,899 @@
+#include "BenchJson.h"
+#include "ConnectionAttribution.h"
+#include "HotPathMetrics.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Bumped whenever a field of the report changes meaning, so that comparisons don't mix them up.
+#define REPORT_VERSION 1
+
+#define DEFAULT_DURATION_S 30
+#define DEFAULT_CONNECTIONS_PER_SECOND 5000
+#define DEFAULT_LIFETIME_MS 200
+#define DEFAULT_RESIDENT_PROCESSES 50
+#define DEFAULT_SPAWNS_PER_SECOND 50
+#define DEFAULT_PROCESS_LIFETIME_MS 2000
+#define DEFAULT_APPS 40
+#define DEFAULT_PORTS 16384
+#define DEFAULT_ROW_LAG_US 50
+#define DEFAULT_REDIRECT_LAG_US 100
+#define DEFAULT_ACCEPT_LAG_US 1000
+#define DEFAULT_RETRY_US 1000
+#define DEFAULT_REFRESH_MS 1000
+#define DEFAULT_SEED 1
+
+#define FIRST_EPHEMERAL_PORT 49152
+
+// Event types, in the order events at the same moment are handled.
+#define EVENT_PROCESS_START 0
+#define EVENT_CONNECT 1
+#define EVENT_ROW_VISIBLE 2
+#define EVENT_REDIRECT 3
+#define EVENT_ACCEPT 4
+#define EVENT_RETRY 5
+#define EVENT_CLOSE 6
+#define EVENT_PROCESS_EXIT 7
+#define EVENT_REFRESH 8
+#define EVENT_READ 9
+
+static const double percentiles[] = { 50, 90, 99, 99.9 };
+static const char* const percentileKeys[] = { "p50Ns", "p90Ns", "p99Ns", "p999Ns" };
+
+#define PERCENTILE_COUNT (sizeof(percentiles) / sizeof(percentiles[0]))
+
+typedef struct ChurnOptions {
+    unsigned long long durationUs;
+    unsigned long long connectionsPerSecond;
+    unsigned long long lifetimeUs;
+    unsigned long long residentProcesses;
+    unsigned long long spawnsPerSecond;
+    unsigned long long processLifetimeUs;
+    unsigned long long apps;
+    unsigned long long ports;
+    unsigned long long rowLagUs;
+    unsigned long long redirectLagUs;
+    unsigned long long acceptLagUs;
+    unsigned long long retryUs;
+    unsigned long long refreshUs;
+    unsigned long long graceUs;
+    unsigned long long minRefreshUs;
+    unsigned long long recheckUs;
+    unsigned long long seed;
+
+    std::string label;
+    std::string output;
+} ChurnOptions;
+
+typedef struct Event {
+    unsigned long long atUs;
+    int type;
+
+    // Connection or process, depending on the type.
+    size_t id;
+
+    // Breaks ties so that the order is the same on every run.
+    unsigned long long sequence;
+
+    bool operator>(const Event& other) const {
+        if (atUs != other.atUs) {
+            return atUs > other.atUs;
+        }
+
+        if (type != other.type) {
+            return type > other.type;
+        }
+
+        return sequence > other.sequence;
+    }
+} Event;
+
+typedef struct SimProcess {
+    unsigned int pid;
+    unsigned long long startTime;
+    size_t app;
+    bool alive;
+
+    // Open connections, which close when it exits.
+    std::vector<size_t> connections;
+} SimProcess;
+
+typedef struct SimConnection {
+    size_t process;
+    unsigned short port;
+    unsigned long long connectUs;
+    bool open;
+
+    // Looked up since the accept and found, rightly or not.
+    bool resolved;
+} SimConnection;
+
+typedef struct ChurnResults {
+    unsigned long long connections;
+    unsigned long long closedBeforeAccept;
+
+    // At the proxy's accept.
+    unsigned long long correct;
+    unsigned long long wrong;
+    unsigned long long unknown;
+
+    // The same, only for connections from applications a rule matches.
+    unsigned long long ruled;
+    unsigned long long ruledCorrect;
+
+    // Verdicts from the PID lists filled in once when the policy was loaded.
+    unsigned long long baselineCorrect;
+    unsigned long long baselineRuledCorrect;
+
+    unsigned long long attributedAtRedirect;
+
+    // How connections that were still unknown at accept ended up, after retrying.
+    unsigned long long resolvedLater;
+    unsigned long long wrongLater;
+    unsigned long long neverResolved;
+
+    // From the connect to the first lookup that found the owner, on the simulated clock.
+    HotPathHistogram attribution;
+
+    // Time spent in the index, on the real clock.
+    HotPathHistogram redirectCalls;
+    HotPathHistogram lookupCalls;
+    HotPathHistogram refreshCalls;
+} ChurnResults;
+
+/// The OS as the simulation has it: the TCP table shows the rows that are visible by now, and
+/// processes can be queried while they are alive.
+class SyntheticBackend : public AttributionBackend {
+public:
+    SyntheticBackend(const std::vector<SimProcess>& processes, const std::vector<std::wstring>& images)
+        : processes(processes), images(images) {
+    }
+
+    virtual bool ReadTcpTable(std::vector<TcpOwnerRow>& table) {
+        table.reserve(rows.size());
+
+        for (std::unordered_map<unsigned short, unsigned int>::const_iterator i = rows.begin(); i != rows.end(); ++i) {
+            TcpOwnerRow row;
+            row.localPort = i->first;
+            row.pid = i->second;
+            table.push_back(row);
+        }
+
+        return true;
+    }
+
+    virtual bool QueryProcess(unsigned int pid, unsigned long long* startTime, std::wstring& imagePath) {
+        std::unordered_map<unsigned int, size_t>::const_iterator found = byPid.find(pid);
+        if (found == byPid.end()) {
+            return false;
+        }
+
+        const SimProcess& process = processes[found->second];
+
+        *startTime = process.startTime;
+        imagePath = images[process.app];
+        return true;
+    }
+
+    // Visible rows, by local port.
+    std::unordered_map<unsigned short, unsigned int> rows;
+
+    // Live processes.
+    std::unordered_map<unsigned int, size_t> byPid;
+
+private:
+    const std::vector<SimProcess>& processes;
+    const std::vector<std::wstring>& images;
+};
+
+static void usage() {
+    fprintf(stderr,
+        "Usage: attribution-replay [options]\n"
+        "\n"
+        "Replays a synthetic stream of process starts and exits, connections, TCP table rows, redirects and\n"
+        "proxy accepts through ConnectionAttribution, on a simulated clock, and writes how often the owner\n"
+        "and verdict were right at accept, how long attribution took and what the index cost as JSON.\n"
+        "\n"
+        "  --duration-s N               Simulated seconds. Default %d.\n"
+        "  --connections-per-second N   New connections. Default %d.\n"
+        "  --lifetime-ms N              Mean connection lifetime. Default %d.\n"
+        "  --resident-processes N       Processes running from the start to the end. Default %d.\n"
+        "  --spawns-per-second N        Short-lived processes started. Default %d.\n"
+        "  --process-lifetime-ms N      Mean lifetime of those. Default %d.\n"
+        "  --apps N                     Distinct applications; every 8 has one blocked, one whitelisted and one\n"
+        "                               blacklisted. Default %d.\n"
+        "  --ports N                    Ephemeral ports to go round. Fewer means more reuse. Default %d.\n"
+        "  --row-lag-us N               From connect until the TCP table shows the row. Default %d.\n"
+        "  --redirect-lag-us N          From connect until the redirect event. Default %d.\n"
+        "  --accept-lag-us N            From connect until the proxy accepts and looks it up. Default %d.\n"
+        "  --retry-us N                 Lookups after a miss are retried this often. Default %d.\n"
+        "  --refresh-ms N               Periodic Refresh() when nothing misses. 0 for none. Default %d.\n"
+        "  --min-refresh-us N           Least time between two reads a miss asked for. Default the service's.\n"
+        "  --grace-ms N, --recheck-ms N The index's settings. Default the service's.\n"
+        "  --seed N                     Default %d.\n"
+        "  --label TEXT                 Stored in the report, e.g. the commit being measured.\n"
+        "  --output FILE                Write the report here instead of to stdout.\n",
+        DEFAULT_DURATION_S, DEFAULT_CONNECTIONS_PER_SECOND, DEFAULT_LIFETIME_MS, DEFAULT_RESIDENT_PROCESSES, DEFAULT_SPAWNS_PER_SECOND,
+        DEFAULT_PROCESS_LIFETIME_MS, DEFAULT_APPS, DEFAULT_PORTS, DEFAULT_ROW_LAG_US, DEFAULT_REDIRECT_LAG_US, DEFAULT_ACCEPT_LAG_US,
+        DEFAULT_RETRY_US, DEFAULT_REFRESH_MS, DEFAULT_SEED);
+}
+
+static bool parseCount(const char* text, unsigned long long* value) {
+    char* end = NULL;
+    unsigned long long parsed = strtoull(text, &end, 10);
+
+    if (end == text || *end != '\0' || text[0] == '-') {
+        return false;
+    }
+
+    *value = parsed;
+    return true;
+}
+
+static bool parseOptions(int argc, char** argv, ChurnOptions* options) {
+    options->durationUs = DEFAULT_DURATION_S * 1000000ULL;
+    options->connectionsPerSecond = DEFAULT_CONNECTIONS_PER_SECOND;
+    options->lifetimeUs = DEFAULT_LIFETIME_MS * 1000ULL;
+    options->residentProcesses = DEFAULT_RESIDENT_PROCESSES;
+    options->spawnsPerSecond = DEFAULT_SPAWNS_PER_SECOND;
+    options->processLifetimeUs = DEFAULT_PROCESS_LIFETIME_MS * 1000ULL;
+    options->apps = DEFAULT_APPS;
+    options->ports = DEFAULT_PORTS;
+    options->rowLagUs = DEFAULT_ROW_LAG_US;
+    options->redirectLagUs = DEFAULT_REDIRECT_LAG_US;
+    options->acceptLagUs = DEFAULT_ACCEPT_LAG_US;
+    options->retryUs = DEFAULT_RETRY_US;
+    options->refreshUs = DEFAULT_REFRESH_MS * 1000ULL;
+    options->graceUs = ATTRIBUTION_DEFAULT_GRACE_US;
+    options->minRefreshUs = ATTRIBUTION_DEFAULT_MIN_REFRESH_US;
+    options->recheckUs = ATTRIBUTION_DEFAULT_RECHECK_US;
+    options->seed = DEFAULT_SEED;
+
+    for (int i = 1; i < argc; i++) {
+        std::string name = argv[i];
+
+        if (name == "--help" || name == "-h") {
+            return false;
+        }
+
+        if (i + 1 >= argc) {
+            fprintf(stderr, "%s needs a value.\n", name.c_str());
+            return false;
+        }
+
+        const char* value = argv[++i];
+        unsigned long long count = 0;
+
+        if (name == "--label") {
+            options->label = value;
+            continue;
+        }
+        else if (name == "--output") {
+            options->output = value;
+            continue;
+        }
+
+        if (!parseCount(value, &count)) {
+            fprintf(stderr, "%s takes a number.\n", name.c_str());
+            return false;
+        }
+
+        if (name == "--duration-s" && count >= 1) {
+            options->durationUs = count * 1000000ULL;
+        }
+        else if (name == "--connections-per-second" && count >= 1) {
+            options->connectionsPerSecond = count;
+        }
+        else if (name == "--lifetime-ms" && count >= 1) {
+            options->lifetimeUs = count * 1000ULL;
+        }
+        else if (name == "--resident-processes" && count >= 1) {
+            options->residentProcesses = count;
+        }
+        else if (name == "--spawns-per-second") {
+            options->spawnsPerSecond = count;
+        }
+        else if (name == "--process-lifetime-ms" && count >= 1) {
+            options->processLifetimeUs = count * 1000ULL;
+        }
+        else if (name == "--apps" && count >= 1 && count <= 1000) {
+            options->apps = count;
+        }
+        else if (name == "--ports" && count >= 16 && count <= 65536 - FIRST_EPHEMERAL_PORT) {
+            options->ports = count;
+        }
+        else if (name == "--row-lag-us") {
+            options->rowLagUs = count;
+        }
+        else if (name == "--redirect-lag-us") {
+            options->redirectLagUs = count;
+        }
+        else if (name == "--accept-lag-us") {
+            options->acceptLagUs = count;
+        }
+        else if (name == "--retry-us" && count >= 1) {
+            options->retryUs = count;
+        }
+        else if (name == "--refresh-ms") {
+            options->refreshUs = count * 1000ULL;
+        }
+        else if (name == "--grace-ms") {
+            options->graceUs = count * 1000ULL;
+        }
+        else if (name == "--min-refresh-us") {
+            options->minRefreshUs = count;
+        }
+        else if (name == "--recheck-ms") {
+            options->recheckUs = count * 1000ULL;
+        }
+        else if (name == "--seed") {
+            options->seed = count;
+        }
+        else {
+            fprintf(stderr, "Unknown option or value out of range: %s %s\n", name.c_str(), value);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void recordSample(HotPathHistogram& histogram, unsigned long long nanoseconds) {
+    histogram.count++;
+    histogram.totalNanoseconds += nanoseconds;
+
+    if (nanoseconds > histogram.maxNanoseconds) {
+        histogram.maxNanoseconds = nanoseconds;
+    }
+
+    histogram.buckets[HotPathMetrics::BucketIndex(nanoseconds)]++;
+}
+
+static unsigned long long now() {
+    return (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// What the rules give each application. The same as SetPolicy() should work out from the patterns.
+static int appVerdict(size_t app) {
+    switch (app % 8) {
+    case 0:
+        return APP_VERDICT_BLOCKED;
+    case 1:
+        return APP_VERDICT_WHITELISTED;
+    case 2:
+        return APP_VERDICT_BLACKLISTED;
+    default:
+        return APP_VERDICT_FILTER;
+    }
+}
+
+static void writeHistogram(JsonWriter& report, const char* key, const HotPathHistogram& histogram) {
+    report.BeginObject(key);
+    report.Integer("count", histogram.count);
+    report.Number("meanNs", histogram.count > 0 ? (double)histogram.totalNanoseconds / histogram.count : 0);
+
+    for (size_t p = 0; p < PERCENTILE_COUNT; p++) {
+        report.Integer(percentileKeys[p], HotPathMetrics::ValueAtPercentile(histogram, percentiles[p]));
+    }
+
+    report.Integer("maxNs", histogram.maxNanoseconds);
+    report.EndObject();
+}
+
+static double ratio(unsigned long long part, unsigned long long whole) {
+    return whole > 0 ? (double)part / whole : 0;
+}
+
+int main(int argc, char** argv) {
+    ChurnOptions options;
+
+    if (!parseOptions(argc, argv, &options)) {
+        usage();
+        return 1;
+    }
+
+    std::mt19937_64 random(options.seed);
+    std::exponential_distribution<double> unit(1.0);
+
+    std::vector<std::wstring> images;
+    std::vector<std::wstring> patterns;
+    std::vector<int> verdicts;
+
+    for (size_t app = 0; app < options.apps; app++) {
+        wchar_t image[128];
+        wchar_t pattern[32];
+
+        // Zero padded so that no name is part of another, since rules match anywhere in the path.
+        swprintf(image, sizeof(image) / sizeof(image[0]), L"C:\\Program Files\\Vendor %03u\\App%03u.exe", (unsigned int)app, (unsigned int)app);
+        swprintf(pattern, sizeof(pattern) / sizeof(pattern[0]), L"app%03u.exe", (unsigned int)app);
+
+        images.push_back(image);
+
+        if (appVerdict(app) != APP_VERDICT_FILTER) {
+            patterns.push_back(pattern);
+            verdicts.push_back(appVerdict(app));
+        }
+    }
+
+    std::vector<SimProcess> processes;
+    std::vector<SimConnection> connections;
+
+    SyntheticBackend backend(processes, images);
+    ConnectionAttribution index(&backend, options.graceUs, options.recheckUs);
+
+    index.SetPolicy(patterns, verdicts);
+
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event> > events;
+    unsigned long long sequence = 0;
+
+    std::function<void(unsigned long long, int, size_t)> schedule = [&](unsigned long long atUs, int type, size_t id) {
+        Event event;
+        event.atUs = atUs;
+        event.type = type;
+        event.id = id;
+        event.sequence = sequence++;
+        events.push(event);
+    };
+
+    // PIDs are handed out again as soon as they are free, newest first, the way Windows tends to.
+    std::vector<unsigned int> freePids;
+    unsigned int nextPid = 1000;
+
+    std::vector<size_t> liveProcesses;
+    std::vector<bool> portInUse(options.ports, false);
+    size_t nextPort = 0;
+
+    ChurnResults results;
+    memset(&results, 0, sizeof(results));
+
+    std::function<void(size_t, unsigned long long)> close = [&](size_t id, unsigned long long atUs) {
+        SimConnection& connection = connections[id];
+
+        if (!connection.open) {
+            return;
+        }
+
+        connection.open = false;
+
+        std::unordered_map<unsigned short, unsigned int>::iterator row = backend.rows.find(connection.port);
+        if (row != backend.rows.end() && row->second == processes[connection.process].pid) {
+            backend.rows.erase(row);
+        }
+
+        portInUse[connection.port - FIRST_EPHEMERAL_PORT] = false;
+
+        if (!connection.resolved && connection.connectUs + options.acceptLagUs <= atUs) {
+            results.neverResolved++;
+        }
+    };
+
+    // The thread that reads the table for the service: a miss wakes it, unless it is already due to
+    // read, and it reads no sooner than minRefreshUs after its last read.
+    bool readDue = false;
+    unsigned long long nextReadUs = 0;
+
+    std::function<void(unsigned long long)> missed = [&](unsigned long long atUs) {
+        if (!readDue) {
+            readDue = true;
+            schedule(std::max(atUs, nextReadUs), EVENT_READ, 0);
+        }
+    };
+
+    // PID -> verdict, as the lists were filled when the policy was loaded at the start.
+    std::unordered_map<unsigned int, int> pushedPids;
+
+    for (size_t i = 0; i < options.residentProcesses; i++) {
+        schedule(0, EVENT_PROCESS_START, i);
+    }
+
+    if (options.spawnsPerSecond > 0) {
+        unsigned long long at = 0;
+
+        while (true) {
+            at += (unsigned long long)(unit(random) * 1000000.0 / options.spawnsPerSecond) + 1;
+
+            if (at >= options.durationUs) {
+                break;
+            }
+
+            schedule(at, EVENT_PROCESS_START, 0);
+        }
+    }
+
+    {
+        unsigned long long at = 0;
+
+        while (true) {
+            at += (unsigned long long)(unit(random) * 1000000.0 / options.connectionsPerSecond) + 1;
+
+            if (at >= options.durationUs) {
+                break;
+            }
+
+            schedule(at, EVENT_CONNECT, 0);
+        }
+    }
+
+    for (unsigned long long at = options.refreshUs; options.refreshUs > 0 && at < options.durationUs; at += options.refreshUs) {
+        schedule(at, EVENT_REFRESH, 0);
+    }
+
+    bool policyLoaded = false;
+    unsigned long long startedAt = now();
+
+    while (!events.empty()) {
+        Event event = events.top();
+        events.pop();
+
+        switch (event.type) {
+        case EVENT_PROCESS_START: {
+            SimProcess process;
+
+            if (!freePids.empty()) {
+                process.pid = freePids.back();
+                freePids.pop_back();
+            }
+            else {
+                process.pid = nextPid;
+                nextPid += 4;
+            }
+
+            process.startTime = event.atUs + 1;
+            process.app = (size_t)(random() % options.apps);
+            process.alive = true;
+
+            processes.push_back(process);
+
+            size_t id = processes.size() - 1;
+            backend.byPid[process.pid] = id;
+            liveProcesses.push_back(id);
+
+            if (id >= options.residentProcesses) {
+                schedule(event.atUs + (unsigned long long)(unit(random) * options.processLifetimeUs) + 1, EVENT_PROCESS_EXIT, id);
+            }
+
+            break;
+        }
+
+        case EVENT_PROCESS_EXIT: {
+            SimProcess& process = processes[event.id];
+            process.alive = false;
+
+            // close() leaves the list alone, so it can be walked while they close.
+            for (size_t i = 0; i < process.connections.size(); i++) {
+                close(process.connections[i], event.atUs);
+            }
+
+            process.connections.clear();
+
+            backend.byPid.erase(process.pid);
+            freePids.push_back(process.pid);
+
+            for (size_t i = 0; i < liveProcesses.size(); i++) {
+                if (liveProcesses[i] == event.id) {
+                    liveProcesses[i] = liveProcesses.back();
+                    liveProcesses.pop_back();
+                    break;
+                }
+            }
+
+            break;
+        }
+
+        case EVENT_CONNECT: {
+            // The lists are filled once the resident processes are up, as the service does on start.
+            if (!policyLoaded) {
+                for (size_t i = 0; i < liveProcesses.size(); i++) {
+                    const SimProcess& process = processes[liveProcesses[i]];
+                    pushedPids[process.pid] = appVerdict(process.app);
+                }
+
+                policyLoaded = true;
+            }
+
+            if (liveProcesses.empty()) {
+                break;
+            }
+
+            // Ports go round in order, skipping those in use, so they are reused once the range wraps.
+            size_t port = nextPort;
+            size_t tried = 0;
+
+            while (portInUse[port] && tried < options.ports) {
+                port = (port + 1) % options.ports;
+                tried++;
+            }
+
+            if (portInUse[port]) {
+                break;
+            }
+
+            nextPort = (port + 1) % options.ports;
+            portInUse[port] = true;
+
+            SimConnection connection;
+            connection.process = liveProcesses[(size_t)(random() % liveProcesses.size())];
+            connection.port = (unsigned short)(FIRST_EPHEMERAL_PORT + port);
+            connection.connectUs = event.atUs;
+            connection.open = true;
+            connection.resolved = false;
+
+            connections.push_back(connection);
+
+            size_t id = connections.size() - 1;
+            processes[connection.process].connections.push_back(id);
+            unsigned long long lifetime = (unsigned long long)(unit(random) * options.lifetimeUs) + 1;
+
+            results.connections++;
+
+            schedule(event.atUs + options.rowLagUs, EVENT_ROW_VISIBLE, id);
+            schedule(event.atUs + options.redirectLagUs, EVENT_REDIRECT, id);
+            schedule(event.atUs + options.acceptLagUs, EVENT_ACCEPT, id);
+            schedule(event.atUs + lifetime, EVENT_CLOSE, id);
+            break;
+        }
+
+        case EVENT_ROW_VISIBLE: {
+            SimConnection& connection = connections[event.id];
+
+            if (connection.open) {
+                backend.rows[connection.port] = processes[connection.process].pid;
+            }
+
+            break;
+        }
+
+        case EVENT_REDIRECT: {
+            SimConnection& connection = connections[event.id];
+
+            if (!connection.open) {
+                break;
+            }
+
+            unsigned long long callStart = now();
+            ConnectionOwner owner = index.OnRedirect(connection.port, event.atUs);
+            recordSample(results.redirectCalls, now() - callStart);
+
+            const SimProcess& process = processes[connection.process];
+
+            if (owner.pid == process.pid && owner.processStartTime == process.startTime) {
+                results.attributedAtRedirect++;
+            }
+
+            if (owner.pid == 0) {
+                missed(event.atUs);
+            }
+
+            break;
+        }
+
+        case EVENT_ACCEPT:
+        case EVENT_RETRY: {
+            SimConnection& connection = connections[event.id];
+
+            if (!connection.open) {
+                if (event.type == EVENT_ACCEPT) {
+                    results.closedBeforeAccept++;
+                }
+
+                break;
+            }
+
+            const SimProcess& process = processes[connection.process];
+            int expected = appVerdict(process.app);
+
+            ConnectionOwner owner;
+
+            unsigned long long callStart = now();
+            bool found = index.Lookup(connection.port, &owner);
+            recordSample(results.lookupCalls, now() - callStart);
+
+            if (!found) {
+                missed(event.atUs);
+            }
+
+            bool correct = found && owner.pid == process.pid && owner.processStartTime == process.startTime && owner.verdict == expected;
+
+            if (event.type == EVENT_ACCEPT) {
+                if (correct) {
+                    results.correct++;
+                }
+                else if (found) {
+                    results.wrong++;
+                }
+                else {
+                    results.unknown++;
+                }
+
+                std::unordered_map<unsigned int, int>::const_iterator pushed = pushedPids.find(process.pid);
+                int baseline = pushed != pushedPids.end() ? pushed->second : APP_VERDICT_FILTER;
+
+                if (baseline == expected) {
+                    results.baselineCorrect++;
+                }
+
+                if (expected != APP_VERDICT_FILTER) {
+                    results.ruled++;
+
+                    if (correct) {
+                        results.ruledCorrect++;
+                    }
+
+                    if (baseline == expected) {
+                        results.baselineRuledCorrect++;
+                    }
+                }
+            }
+
+            else if (found) {
+                if (correct) {
+                    results.resolvedLater++;
+                }
+                else {
+                    results.wrongLater++;
+                }
+            }
+
+            if (found) {
+                connection.resolved = true;
+
+                if (correct) {
+                    recordSample(results.attribution, (event.atUs - connection.connectUs) * 1000);
+                }
+            }
+            else {
+                schedule(event.atUs + options.retryUs, EVENT_RETRY, event.id);
+            }
+
+            break;
+        }
+
+        case EVENT_CLOSE: {
+            close(event.id, event.atUs);
+
+            // Dropped from its process's list here rather than in close(), which runs for them all
+            // when the process exits.
+            std::vector<size_t>& open = processes[connections[event.id].process].connections;
+
+            for (size_t i = 0; i < open.size(); i++) {
+                if (open[i] == event.id) {
+                    open[i] = open.back();
+                    open.pop_back();
+                    break;
+                }
+            }
+
+            break;
+        }
+
+        case EVENT_REFRESH:
+        case EVENT_READ: {
+            if (event.type == EVENT_READ) {
+                readDue = false;
+                index.WaitForMiss(0);
+            }
+
+            unsigned long long callStart = now();
+            index.Refresh(event.atUs);
+            recordSample(results.refreshCalls, now() - callStart);
+
+            nextReadUs = event.atUs + options.minRefreshUs;
+            break;
+        }
+        }
+    }
+
+    double elapsed = (now() - startedAt) / 1e9;
+    ConnectionAttributionStats stats = index.Stats();
+
+    unsigned long long accepted = results.correct + results.wrong + results.unknown;
+
+    JsonWriter report;
+    report.BeginObject();
+    report.Integer("version", REPORT_VERSION);
+
+    if (!options.label.empty()) {
+        report.String("label", options.label);
+    }
+
+    report.BeginObject("churn");
+    report.Number("durationSeconds", options.durationUs / 1e6);
+    report.Integer("connectionsPerSecond", options.connectionsPerSecond);
+    report.Number("lifetimeMs", options.lifetimeUs / 1e3);
+    report.Integer("residentProcesses", options.residentProcesses);
+    report.Integer("spawnsPerSecond", options.spawnsPerSecond);
+    report.Number("processLifetimeMs", options.processLifetimeUs / 1e3);
+    report.Integer("ports", options.ports);
+    report.Integer("rowLagUs", options.rowLagUs);
+    report.Integer("redirectLagUs", options.redirectLagUs);
+    report.Integer("acceptLagUs", options.acceptLagUs);
+    report.Number("refreshMs", options.refreshUs / 1e3);
+    report.Integer("seed", options.seed);
+    report.Integer("processes", processes.size());
+    report.Integer("connections", results.connections);
+    report.Integer("closedBeforeAccept", results.closedBeforeAccept);
+    report.EndObject();
+
+    report.BeginObject("accuracy");
+    report.Integer("accepted", accepted);
+    report.Number("correct", ratio(results.correct, accepted));
+    report.Number("wrong", ratio(results.wrong, accepted));
+    report.Number("unknown", ratio(results.unknown, accepted));
+    report.Integer("ruled", results.ruled);
+    report.Number("ruledCorrect", ratio(results.ruledCorrect, results.ruled));
+    report.Number("atRedirect", ratio(results.attributedAtRedirect, results.connections));
+    report.Integer("resolvedLater", results.resolvedLater);
+    report.Integer("wrongLater", results.wrongLater);
+    report.Integer("neverResolved", results.neverResolved);
+    report.EndObject();
+
+    report.BeginObject("baseline");
+    report.Number("correct", ratio(results.baselineCorrect, accepted));
+    report.Number("ruledCorrect", ratio(results.baselineRuledCorrect, results.ruled));
+    report.EndObject();
+
+    // Simulated time from connect to attribution, and real time spent in the index.
+    writeHistogram(report, "attribution", results.attribution);
+
+    report.BeginObject("calls");
+    writeHistogram(report, "redirect", results.redirectCalls);
+    writeHistogram(report, "lookup", results.lookupCalls);
+    writeHistogram(report, "refresh", results.refreshCalls);
+    report.EndObject();
+
+    report.BeginObject("index");
+    report.Integer("redirects", stats.redirects);
+    report.Integer("lookups", stats.lookups);
+    report.Integer("hits", stats.hits);
+    report.Integer("misses", stats.misses);
+    report.Integer("portReuses", stats.portReuses);
+    report.Integer("refreshes", stats.refreshes);
+    report.Integer("rowsRead", stats.rowsRead);
+    report.Integer("coalescedRefreshes", stats.coalescedRefreshes);
+    report.Integer("processQueries", stats.processQueries);
+    report.Integer("processQueryFailures", stats.processQueryFailures);
+    report.Integer("evictedConnections", stats.evictedConnections);
+    report.Integer("evictedProcesses", stats.evictedProcesses);
+    report.Integer("connections", stats.connections);
+    report.Integer("processes", stats.processes);
+    report.EndObject();
+
+    report.EndObject();
+
+    if (options.output.empty()) {
+        fputs(report.Text().c_str(), stdout);
+    }
+    else {
+        FILE* file = fopen(options.output.c_str(), "wb");
+
+        if (file == NULL || fwrite(report.Text().data(), 1, report.Text().size(), file) != report.Text().size()) {
+            fprintf(stderr, "Could not write %s.\n", options.output.c_str());
+
+            if (file != NULL) {
+                fclose(file);
+            }
+
+            return 1;
+        }
+
+        fclose(file);
+    }
+
+    fprintf(stderr, "%llu connections in %.3f s: %.2f%% right at accept (%.2f%% of ruled apps, %.2f%% with the lists alone), "
+        "%.2f%% wrong, %.2f%% unknown, attribution p99 %.2f ms, lookup p99 %.2f us\n",
+        results.connections, elapsed, ratio(results.correct, accepted) * 100, ratio(results.ruledCorrect, results.ruled) * 100,
+        ratio(results.baselineRuledCorrect, results.ruled) * 100, ratio(results.wrong, accepted) * 100, ratio(results.unknown, accepted) * 100,
+        HotPathMetrics::ValueAtPercentile(results.attribution, 99) / 1e6, HotPathMetrics::ValueAtPercentile(results.lookupCalls, 99) / 1e3);
+
+    return 0;
+}
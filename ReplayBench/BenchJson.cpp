@@ -0,0 +1,316 @@
+#include "BenchJson.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#define JSON_MAX_DEPTH 32
+
+JsonWriter::JsonWriter() {
+}
+
+void JsonWriter::beginValue(const char* key) {
+    if (!open.empty()) {
+        if (open.back()) {
+            text += ",";
+        }
+
+        open.back() = true;
+        text += "\n";
+        text.append(open.size() * 2, ' ');
+    }
+
+    if (key != NULL) {
+        appendString(key);
+        text += ": ";
+    }
+}
+
+void JsonWriter::appendString(const std::string& value) {
+    text += '"';
+
+    for (size_t i = 0; i < value.size(); i++) {
+        unsigned char c = (unsigned char)value[i];
+
+        if (c == '"' || c == '\\') {
+            text += '\\';
+            text += (char)c;
+        }
+        else if (c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            text += escaped;
+        }
+        else {
+            text += (char)c;
+        }
+    }
+
+    text += '"';
+}
+
+void JsonWriter::BeginObject(const char* key) {
+    beginValue(key);
+    text += "{";
+    open.push_back(false);
+}
+
+void JsonWriter::EndObject() {
+    bool any = open.back();
+    open.pop_back();
+
+    if (any) {
+        text += "\n";
+        text.append(open.size() * 2, ' ');
+    }
+
+    text += "}";
+
+    if (open.empty()) {
+        text += "\n";
+    }
+}
+
+void JsonWriter::BeginArray(const char* key) {
+    beginValue(key);
+    text += "[";
+    open.push_back(false);
+}
+
+void JsonWriter::EndArray() {
+    bool any = open.back();
+    open.pop_back();
+
+    if (any) {
+        text += "\n";
+        text.append(open.size() * 2, ' ');
+    }
+
+    text += "]";
+}
+
+void JsonWriter::Number(const char* key, double value) {
+    beginValue(key);
+
+    // JSON has no infinities or NaN.
+    if (!std::isfinite(value)) {
+        text += "null";
+        return;
+    }
+
+    char formatted[32];
+    snprintf(formatted, sizeof(formatted), "%.6g", value);
+    text += formatted;
+}
+
+void JsonWriter::Integer(const char* key, unsigned long long value) {
+    beginValue(key);
+
+    char formatted[32];
+    snprintf(formatted, sizeof(formatted), "%llu", value);
+    text += formatted;
+}
+
+void JsonWriter::Bool(const char* key, bool value) {
+    beginValue(key);
+    text += value ? "true" : "false";
+}
+
+void JsonWriter::String(const char* key, const std::string& value) {
+    beginValue(key);
+    appendString(value);
+}
+
+namespace {
+    class NumberReader {
+    public:
+        NumberReader(const std::string& text, std::map<std::string, double>& numbers) : text(text), numbers(numbers), position(0) {
+        }
+
+        bool Read() {
+            if (!value(std::string(), 0)) {
+                return false;
+            }
+
+            skipSpace();
+            return position == text.size();
+        }
+
+    private:
+        void skipSpace() {
+            while (position < text.size() && (text[position] == ' ' || text[position] == '\t' || text[position] == '\r' || text[position] == '\n')) {
+                position++;
+            }
+        }
+
+        bool literal(const char* word) {
+            size_t length = strlen(word);
+
+            if (text.compare(position, length, word) != 0) {
+                return false;
+            }
+
+            position += length;
+            return true;
+        }
+
+        // Only keys need decoding, and the reports never escape anything in them but quotes and backslashes.
+        bool string(std::string* decoded) {
+            if (position >= text.size() || text[position] != '"') {
+                return false;
+            }
+
+            position++;
+
+            while (position < text.size() && text[position] != '"') {
+                if (text[position] == '\\') {
+                    position++;
+
+                    if (position >= text.size()) {
+                        return false;
+                    }
+                }
+
+                decoded->push_back(text[position]);
+                position++;
+            }
+
+            if (position >= text.size()) {
+                return false;
+            }
+
+            position++;
+            return true;
+        }
+
+        static std::string child(const std::string& path, const std::string& key) {
+            return path.empty() ? key : path + "." + key;
+        }
+
+        bool value(const std::string& path, int depth) {
+            if (depth > JSON_MAX_DEPTH) {
+                return false;
+            }
+
+            skipSpace();
+
+            if (position >= text.size()) {
+                return false;
+            }
+
+            char c = text[position];
+
+            if (c == '{') {
+                position++;
+                skipSpace();
+
+                if (position < text.size() && text[position] == '}') {
+                    position++;
+                    return true;
+                }
+
+                while (true) {
+                    std::string key;
+
+                    skipSpace();
+                    if (!string(&key)) {
+                        return false;
+                    }
+
+                    skipSpace();
+                    if (position >= text.size() || text[position] != ':') {
+                        return false;
+                    }
+
+                    position++;
+
+                    if (!value(child(path, key), depth + 1)) {
+                        return false;
+                    }
+
+                    skipSpace();
+                    if (position < text.size() && text[position] == ',') {
+                        position++;
+                    }
+                    else if (position < text.size() && text[position] == '}') {
+                        position++;
+                        return true;
+                    }
+                    else {
+                        return false;
+                    }
+                }
+            }
+
+            if (c == '[') {
+                position++;
+                skipSpace();
+
+                if (position < text.size() && text[position] == ']') {
+                    position++;
+                    return true;
+                }
+
+                for (int index = 0; ; index++) {
+                    char number[16];
+                    snprintf(number, sizeof(number), "%d", index);
+
+                    if (!value(child(path, number), depth + 1)) {
+                        return false;
+                    }
+
+                    skipSpace();
+                    if (position < text.size() && text[position] == ',') {
+                        position++;
+                    }
+                    else if (position < text.size() && text[position] == ']') {
+                        position++;
+                        return true;
+                    }
+                    else {
+                        return false;
+                    }
+                }
+            }
+
+            if (c == '"') {
+                std::string ignored;
+                return string(&ignored);
+            }
+
+            if (c == 't') {
+                return literal("true");
+            }
+
+            if (c == 'f') {
+                return literal("false");
+            }
+
+            if (c == 'n') {
+                return literal("null");
+            }
+
+            const char* start = text.c_str() + position;
+            char* end = NULL;
+            double number = strtod(start, &end);
+
+            if (end == start) {
+                return false;
+            }
+
+            position += (size_t)(end - start);
+            numbers[path] = number;
+            return true;
+        }
+
+        const std::string& text;
+        std::map<std::string, double>& numbers;
+        size_t position;
+    };
+}
+
+bool ReadJsonNumbers(const std::string& text, std::map<std::string, double>& numbers) {
+    NumberReader reader(text, numbers);
+    return reader.Read();
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+/// Writes indented JSON into a string. Keys and values are written in the order they're added, so
+/// reports from different runs line up when diffed.
+class JsonWriter {
+public:
+    JsonWriter();
+
+    void BeginObject(const char* key = NULL);
+    void EndObject();
+
+    void BeginArray(const char* key = NULL);
+    void EndArray();
+
+    void Number(const char* key, double value);
+    void Integer(const char* key, unsigned long long value);
+    void Bool(const char* key, bool value);
+
+    // key may be NULL inside an array.
+    void String(const char* key, const std::string& value);
+
+    const std::string& Text() const { return text; }
+
+private:
+    void beginValue(const char* key);
+    void appendString(const std::string& value);
+
+    std::string text;
+
+    // Whether each open object or array already has something in it.
+    std::vector<bool> open;
+};
+
+/// Reads the numbers out of a JSON document into path -> value, where a path is the keys down to
+/// the number joined by dots, with array items numbered from zero: "stages.triggers.p99Ns".
+/// Strings, booleans and nulls are skipped. Returns false if the document isn't valid JSON.
+bool ReadJsonNumbers(const std::string& text, std::map<std::string, double>& numbers);
@@ -0,0 +1,447 @@
+#include "ScanContext.h"
+#include "TriggerScanner.h"
+#include "VerdictCache.h"
+#include "WorkPool.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#define DEFAULT_BODIES 150
+#define DEFAULT_SEED 1
+
+// Every word is this long, so that a trigger can be written over any two or three neighbouring
+// words without moving a byte, and so without moving where chunks start.
+#define WORD_LENGTH 6
+
+#define TRIGGER_WORDS 24
+#define FILLER_WORDS 400
+#define CATEGORIES 4
+
+#define POOL_THREADS 3
+#define CACHE_BYTES (4 * 1024 * 1024)
+#define CACHE_CHUNK 256
+
+static const size_t chunkSizes[] = { 64, 100, 256, 1000 };
+
+#define CHUNK_SIZE_COUNT (sizeof(chunkSizes) / sizeof(chunkSizes[0]))
+
+typedef struct Word {
+    size_t offset;
+
+    // Only spaces between it and the word before, so that the two can be one phrase.
+    bool joined;
+} Word;
+
+typedef struct Body {
+    std::string text;
+    std::vector<Word> words;
+} Body;
+
+typedef struct Expected {
+    bool found;
+    size_t offset;
+    size_t length;
+} Expected;
+
+typedef struct CheckResults {
+    unsigned long long bodies;
+    unsigned long long scans;
+    unsigned long long straddling;
+    unsigned long long matched;
+    unsigned long long mismatches;
+} CheckResults;
+
+static std::string makeWord(std::mt19937_64& random, char first) {
+    std::string word(1, first);
+
+    while (word.size() < WORD_LENGTH) {
+        word += (char)('a' + random() % 26);
+    }
+
+    return word;
+}
+
+// Filler words start with a letter no trigger word starts with, so they never match by accident.
+static void makeVocabulary(std::mt19937_64& random, std::vector<std::string>& triggerWords, std::vector<std::string>& fillerWords) {
+    for (int i = 0; i < TRIGGER_WORDS; i++) {
+        triggerWords.push_back(makeWord(random, 'q'));
+    }
+
+    for (int i = 0; i < FILLER_WORDS; i++) {
+        fillerWords.push_back(makeWord(random, (char)('a' + random() % 16)));
+    }
+}
+
+// Triggers of one to three words, some of them the start of a longer one, so that the shortest of
+// several starting at the same word has to win.
+static void makeTriggers(std::mt19937_64& random, const std::vector<std::string>& words, std::vector<std::string>& triggers) {
+    for (int i = 0; i < 40; i++) {
+        int count = 1 + (int)(random() % 3);
+        std::string trigger;
+
+        for (int w = 0; w < count; w++) {
+            trigger += (w > 0 ? " " : "") + words[random() % words.size()];
+        }
+
+        triggers.push_back(trigger);
+
+        if (count > 1 && random() % 3 == 0) {
+            triggers.push_back(trigger + " " + words[random() % words.size()]);
+        }
+    }
+}
+
+// HTML-ish text of filler words, with tags, attributes and a script that has trigger words in it,
+// none of which may match.
+static Body makeBody(std::mt19937_64& random, const std::vector<std::string>& fillerWords, const std::vector<std::string>& triggerWords, size_t length) {
+    Body body;
+    bool joined = false;
+
+    body.text = "<html><body><p>";
+
+    while (body.text.size() < length) {
+        unsigned int roll = (unsigned int)(random() % 100);
+
+        if (roll < 3) {
+            body.text += "</p><p>";
+            joined = false;
+        }
+        else if (roll < 5) {
+            body.text += "<a href=\"https://example.com/" + fillerWords[random() % fillerWords.size()] + "\">";
+            joined = false;
+        }
+        else if (roll < 6) {
+            body.text += "<script>var " + triggerWords[random() % triggerWords.size()] + " = 1;</script>";
+            joined = false;
+        }
+        else if (roll < 8) {
+            body.text += ", ";
+            joined = false;
+        }
+        else if (roll < 9) {
+            body.text += "\n";
+        }
+
+        if (!body.text.empty() && body.text[body.text.size() - 1] != ' ' && body.text[body.text.size() - 1] != '\n' && body.text[body.text.size() - 1] != '>') {
+            body.text += ' ';
+        }
+
+        Word word;
+        word.offset = body.text.size();
+        word.joined = joined && !body.words.empty();
+        body.words.push_back(word);
+
+        body.text += fillerWords[random() % fillerWords.size()];
+        body.text += ' ';
+        joined = true;
+    }
+
+    body.text += "</p></body></html>";
+    return body;
+}
+
+// Writes the trigger over words starting at first, if they are joined into one phrase.
+static bool writeTrigger(Body& body, size_t first, const std::string& trigger) {
+    size_t count = (trigger.size() + 1) / (WORD_LENGTH + 1);
+
+    if (first + count > body.words.size()) {
+        return false;
+    }
+
+    for (size_t w = 1; w < count; w++) {
+        if (!body.words[first + w].joined || body.words[first + w].offset != body.words[first + w - 1].offset + WORD_LENGTH + 1) {
+            return false;
+        }
+    }
+
+    for (size_t w = 0; w < count; w++) {
+        memcpy(&body.text[body.words[first + w].offset], &trigger[w * (WORD_LENGTH + 1)], WORD_LENGTH);
+    }
+
+    return true;
+}
+
+static bool sameMatch(bool foundA, const TriggerMatch& a, bool foundB, const TriggerMatch& b) {
+    if (foundA != foundB) {
+        return false;
+    }
+
+    return !foundA || (a.category == b.category && a.trigger == b.trigger && a.offset == b.offset && a.length == b.length);
+}
+
+static void describe(const char* what, bool found, const TriggerMatch& match) {
+    if (found) {
+        fprintf(stderr, "  %s: trigger %d, category %d, bytes %zu-%zu\n", what, match.trigger, match.category, match.offset, match.offset + match.length);
+    }
+    else {
+        fprintf(stderr, "  %s: no match\n", what);
+    }
+}
+
+static TriggerScanOptions sequentialOptions(const std::vector<unsigned char>& enabled) {
+    TriggerScanOptions options;
+    options.enabledCategories = enabled.data();
+    options.enabledCategoriesLength = enabled.size();
+    options.maxPhraseWords = 4;
+    options.parallelThreshold = 0;
+    options.chunkSize = 0;
+    options.pool = NULL;
+    options.cache = NULL;
+    return options;
+}
+
+// Scans one body every way there is, and checks each against the sequential scan and, if given,
+// the sequential scan against what was written into it.
+static void check(const TriggerScanner& scanner, const Body& body, bool json, const std::vector<unsigned char>& enabled, WorkPool* pool, VerdictCache* cache,
+    const Expected* expected, const char* label, CheckResults* results) {
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(body.text.data());
+    size_t length = body.text.size();
+
+    TriggerScanOptions sequential = sequentialOptions(enabled);
+
+    TriggerMatch reference;
+    bool referenceFound = json ? scanner.ScanJsonStrings(data, length, sequential, &reference) : scanner.Scan(data, length, sequential, &reference);
+    results->scans++;
+
+    if (referenceFound) {
+        results->matched++;
+    }
+
+    if (expected != NULL) {
+        bool right = expected->found == referenceFound && (!referenceFound || (reference.offset == expected->offset && reference.length == expected->length));
+
+        if (!right) {
+            results->mismatches++;
+            fprintf(stderr, "%s: the sequential scan missed what was written at bytes %zu-%zu of %zu.\n", label, expected->offset, expected->offset + expected->length, length);
+            describe("sequential", referenceFound, reference);
+        }
+    }
+
+    for (size_t c = 0; c < CHUNK_SIZE_COUNT; c++) {
+        // Without the cache, then with it cold, then warm, for both ways of scanning.
+        for (int variant = 0; variant < 5; variant++) {
+            TriggerScanOptions options = sequential;
+            const char* name = "sequential";
+
+            if (variant == 0 || variant == 3 || variant == 4) {
+                options.parallelThreshold = chunkSizes[c];
+                options.chunkSize = chunkSizes[c];
+                options.pool = pool;
+                name = variant == 0 ? "chunked" : "chunked, cached";
+            }
+
+            if (variant >= 1) {
+                options.cache = cache;
+
+                if (variant <= 2) {
+                    name = "sequential, cached";
+                }
+            }
+
+            // The sequential scans with the cache don't depend on the chunk size.
+            if (c > 0 && (variant == 1 || variant == 2)) {
+                continue;
+            }
+
+            TriggerMatch match;
+            bool found = json ? scanner.ScanJsonStrings(data, length, options, &match) : scanner.Scan(data, length, options, &match);
+            results->scans++;
+
+            if (!sameMatch(referenceFound, reference, found, match)) {
+                results->mismatches++;
+                fprintf(stderr, "%s: %s scan with %zu byte chunks differs from the sequential one on %zu bytes.\n", label, name, chunkSizes[c], length);
+                describe("sequential", referenceFound, reference);
+                describe(name, found, match);
+            }
+        }
+    }
+}
+
+static void usage() {
+    fprintf(stderr,
+        "Usage: chunk-check [--bodies N] [--seed N]\n"
+        "\n"
+        "Checks that chunked trigger scans, with and without the verdict cache, find exactly what a\n"
+        "sequential scan finds, on generated bodies with triggers written across chunk starts. Exits\n"
+        "with 1 if any scan differs.\n"
+        "\n"
+        "  --bodies N    Bodies of each kind. Default %d.\n"
+        "  --seed N      Default %d.\n",
+        DEFAULT_BODIES, DEFAULT_SEED);
+}
+
+int main(int argc, char** argv) {
+    unsigned long long bodies = DEFAULT_BODIES;
+    unsigned long long seed = DEFAULT_SEED;
+
+    for (int i = 1; i < argc; i++) {
+        std::string name = argv[i];
+        char* end = NULL;
+        unsigned long long value = i + 1 < argc ? strtoull(argv[i + 1], &end, 10) : 0;
+
+        if (i + 1 >= argc || end == argv[i + 1] || *end != '\0') {
+            usage();
+            return 1;
+        }
+
+        if (name == "--bodies" && value >= 1) {
+            bodies = value;
+        }
+        else if (name == "--seed") {
+            seed = value;
+        }
+        else {
+            usage();
+            return 1;
+        }
+
+        i++;
+    }
+
+    std::mt19937_64 random(seed);
+
+    std::vector<std::string> triggerWords;
+    std::vector<std::string> fillerWords;
+    makeVocabulary(random, triggerWords, fillerWords);
+
+    std::vector<std::string> triggers;
+    makeTriggers(random, triggerWords, triggers);
+
+    TriggerScanner scanner;
+
+    for (size_t i = 0; i < triggers.size(); i++) {
+        scanner.AddTrigger(reinterpret_cast<const unsigned char*>(triggers[i].data()), triggers[i].size(), (short)(1 + i % CATEGORIES));
+    }
+
+    std::vector<unsigned char> allEnabled(1, 0);
+    for (int category = 1; category <= CATEGORIES; category++) {
+        allEnabled[0] |= (unsigned char)(1 << category);
+    }
+
+    WorkPool pool(POOL_THREADS);
+    VerdictCache cache(CACHE_BYTES, CACHE_CHUNK);
+
+    CheckResults results;
+    memset(&results, 0, sizeof(results));
+
+    ScanScope scope;
+
+    for (unsigned long long b = 0; b < bodies; b++) {
+        size_t length = 200 + (size_t)(random() % 6000);
+        Body clean = makeBody(random, fillerWords, triggerWords, length);
+        const unsigned char* cleanData = reinterpret_cast<const unsigned char*>(clean.text.data());
+
+        Expected none;
+        none.found = false;
+        none.offset = 0;
+        none.length = 0;
+
+        check(scanner, clean, false, allEnabled, &pool, &cache, &none, "clean body", &results);
+        results.bodies++;
+
+        size_t chunkSize = chunkSizes[random() % CHUNK_SIZE_COUNT];
+        std::vector<size_t> starts(clean.text.size() / chunkSize + 1);
+        size_t chunks = TriggerScanner::PlanChunks(cleanData, clean.text.size(), chunkSize, starts.data(), starts.size());
+
+        // A trigger written across each chunk start that has a phrase across it, split after each
+        // of its words but the last.
+        for (size_t k = 1; k < chunks; k++) {
+            size_t next = 0;
+            while (next < clean.words.size() && clean.words[next].offset < starts[k]) {
+                next++;
+            }
+
+            if (next == 0 || next >= clean.words.size() || !clean.words[next].joined) {
+                continue;
+            }
+
+            const std::string& trigger = triggers[random() % triggers.size()];
+            size_t count = (trigger.size() + 1) / (WORD_LENGTH + 1);
+
+            for (size_t before = 1; before < count || (count == 1 && before == 1); before++) {
+                Body body = clean;
+                size_t first = next - std::min(before, next);
+
+                if (!writeTrigger(body, first, trigger)) {
+                    continue;
+                }
+
+                // A shorter trigger that this one starts with matches first.
+                Expected expected;
+                expected.found = true;
+                expected.offset = body.words[first].offset;
+                expected.length = trigger.size();
+
+                for (size_t t = 0; t < triggers.size(); t++) {
+                    if (triggers[t].size() < expected.length && trigger.compare(0, triggers[t].size() + 1, triggers[t] + " ") == 0) {
+                        expected.length = triggers[t].size();
+                    }
+                }
+
+                bool straddles = expected.offset < starts[k] && expected.offset + expected.length > starts[k];
+                if (straddles) {
+                    results.straddling++;
+                }
+
+                check(scanner, body, false, allEnabled, &pool, &cache, &expected, "straddling trigger", &results);
+
+                // The same body with a trigger further on as well, which must not win, and with
+                // some categories off, where only the scans are compared.
+                if (first + count + 8 < body.words.size()) {
+                    Body twice = body;
+                    writeTrigger(twice, body.words.size() - 4, triggers[random() % triggers.size()]);
+                    check(scanner, twice, false, allEnabled, &pool, &cache, &expected, "straddling trigger with a later one", &results);
+
+                    std::vector<unsigned char> someEnabled(1, (unsigned char)(allEnabled[0] & (random() % 256)));
+                    check(scanner, twice, false, someEnabled, &pool, &cache, NULL, "some categories off", &results);
+                }
+            }
+
+            // A three word trigger broken across the start by a wrong last word matches nothing
+            // new.
+            for (size_t t = 0; t < triggers.size(); t++) {
+                if ((triggers[t].size() + 1) / (WORD_LENGTH + 1) == 3 && next >= 2 && next + 1 < clean.words.size()) {
+                    Body body = clean;
+                    std::string broken = triggers[t].substr(0, 2 * (WORD_LENGTH + 1)) + fillerWords[0];
+
+                    if (writeTrigger(body, next - 1, broken)) {
+                        check(scanner, body, false, allEnabled, &pool, &cache, NULL, "broken trigger", &results);
+                    }
+
+                    break;
+                }
+            }
+        }
+
+        // JSON with the same text split into string values, which is scanned after extraction.
+        std::string json = "{\"items\":[";
+        for (size_t w = 0; w < clean.words.size(); w++) {
+            std::string word = clean.text.substr(clean.words[w].offset, WORD_LENGTH);
+
+            if (random() % 40 == 0) {
+                word = triggerWords[random() % triggerWords.size()];
+            }
+
+            json += (w == 0 ? "\"" : (random() % 8 == 0 ? "\",\"" : " ")) + word;
+        }
+        json += "\"]}";
+
+        Body document;
+        document.text = json;
+        check(scanner, document, true, allEnabled, &pool, &cache, NULL, "JSON document", &results);
+    }
+
+    printf("%llu bodies, %llu scans, %llu triggers across chunk starts, %llu matched, %llu mismatches\n",
+        results.bodies, results.scans, results.straddling, results.matched, results.mismatches);
+
+    if (results.straddling == 0) {
+        fprintf(stderr, "No trigger was written across a chunk start, so nothing was checked there.\n");
+        return 1;
+    }
+
+    return results.mismatches > 0 ? 1 : 0;
+}
@@ -0,0 +1,239 @@
+#include "DnsMessage.h"
+#include "DnsProbe.h"
+#include "DnsStandIn.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#define DEFAULT_PORT 15354
+#define DEFAULT_RUNS 200
+#define DEFAULT_SEQUENTIAL_RUNS 3
+#define DEFAULT_CLIENT_TIMEOUT_MS 5000
+#define DEFAULT_SECONDARY_DELAY_MS 10
+
+#define TEST_NAME "testdns.cloudveil.org"
+
+#define PRIMARY "127.0.0.20"
+#define SECONDARY "127.0.0.21"
+
+#define PROBE_TIMEOUT_MS 3000
+
+typedef struct BenchOptions {
+    unsigned short port;
+    unsigned int runs;
+    unsigned int sequentialRuns;
+    unsigned int clientTimeoutMs;
+    unsigned int secondaryDelayMs;
+} BenchOptions;
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// What IsDnsUp() did before DnsProbe: ask each server in turn and wait out the client's timeout
+// before trying the next.
+static bool sequentialCheck(const BenchOptions& options) {
+    const char* servers[] = { PRIMARY, SECONDARY };
+
+    for (size_t i = 0; i < sizeof(servers) / sizeof(servers[0]); i++) {
+        int handle = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (handle < 0) {
+            return false;
+        }
+
+        timeval timeout;
+        timeout.tv_sec = options.clientTimeoutMs / 1000;
+        timeout.tv_usec = (options.clientTimeoutMs % 1000) * 1000;
+        setsockopt(handle, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        sockaddr_in remote;
+        memset(&remote, 0, sizeof(remote));
+        remote.sin_family = AF_INET;
+        remote.sin_port = htons(options.port);
+        inet_pton(AF_INET, servers[i], &remote.sin_addr);
+
+        unsigned char query[DNS_MAX_MESSAGE];
+        unsigned char response[DNS_MAX_MESSAGE];
+        size_t length = DnsMessage::BuildQuery(7, TEST_NAME, DNS_TYPE_A, query, sizeof(query));
+
+        sendto(handle, query, length, 0, (sockaddr*)&remote, sizeof(remote));
+        ssize_t received = recv(handle, response, sizeof(response), 0);
+        close(handle);
+
+        DnsAnswer answer;
+        if (received > 0 && DnsMessage::ParseResponse(response, (size_t)received, 7, DNS_TYPE_A, &answer) && answer.addressCount > 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void report(const char* label, std::vector<double>& times, unsigned int down) {
+    std::sort(times.begin(), times.end());
+
+    size_t p99 = (times.size() * 99) / 100;
+    if (p99 >= times.size()) {
+        p99 = times.size() - 1;
+    }
+
+    printf("  %-24s median %9.3f ms, p99 %9.3f ms, max %9.3f ms over %zu runs", label, times[times.size() / 2], times[p99], times.back(), times.size());
+
+    if (down > 0) {
+        printf(", %u down", down);
+    }
+
+    printf("\n");
+}
+
+static void usage() {
+    fprintf(stderr,
+        "Usage: dns-bench [options]\n"
+        "\n"
+        "Times how long a DNS health check takes to reach a verdict when the primary server drops\n"
+        "every query, with stand-in servers on " PRIMARY " (blackholed) and " SECONDARY " (answering):\n"
+        "asking them in turn as IsDnsUp() used to, probing both at once with DnsProbe, and resolving\n"
+        "through DnsProbe's cache.\n"
+        "\n"
+        "  --port N                  UDP port the stand-ins listen on. Default %d.\n"
+        "  --runs N                  Probes and cached lookups to time. Default %d.\n"
+        "  --sequential-runs N       Sequential checks to time. Default %d.\n"
+        "  --client-timeout-ms N     How long a sequential check waits on each server. Default %d.\n"
+        "  --secondary-delay-ms N    How long the secondary takes to answer. Default %d.\n",
+        DEFAULT_PORT, DEFAULT_RUNS, DEFAULT_SEQUENTIAL_RUNS, DEFAULT_CLIENT_TIMEOUT_MS, DEFAULT_SECONDARY_DELAY_MS);
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    options.port = DEFAULT_PORT;
+    options.runs = DEFAULT_RUNS;
+    options.sequentialRuns = DEFAULT_SEQUENTIAL_RUNS;
+    options.clientTimeoutMs = DEFAULT_CLIENT_TIMEOUT_MS;
+    options.secondaryDelayMs = DEFAULT_SECONDARY_DELAY_MS;
+
+    for (int i = 1; i < argc; i++) {
+        std::string name = argv[i];
+        char* end = NULL;
+        unsigned long long value = i + 1 < argc ? strtoull(argv[i + 1], &end, 10) : 0;
+
+        if (i + 1 >= argc || end == argv[i + 1] || *end != '\0') {
+            usage();
+            return 1;
+        }
+
+        if (name == "--port" && value > 0 && value <= 0xFFFF) {
+            options.port = (unsigned short)value;
+        }
+        else if (name == "--runs" && value > 0 && value <= 1000000) {
+            options.runs = (unsigned int)value;
+        }
+        else if (name == "--sequential-runs" && value <= 1000) {
+            options.sequentialRuns = (unsigned int)value;
+        }
+        else if (name == "--client-timeout-ms" && value > 0 && value <= 60000) {
+            options.clientTimeoutMs = (unsigned int)value;
+        }
+        else if (name == "--secondary-delay-ms" && value <= 10000) {
+            options.secondaryDelayMs = (unsigned int)value;
+        }
+        else {
+            usage();
+            return 1;
+        }
+
+        i++;
+    }
+
+    DnsStandIn primary(DNS_STAND_IN_BLACKHOLE, 0, 60);
+    DnsStandIn secondary(DNS_STAND_IN_ANSWER, options.secondaryDelayMs, 60);
+    std::string error;
+
+    if (!primary.Listen(PRIMARY, options.port, &error) || !secondary.Listen(SECONDARY, options.port, &error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+
+    printf("Primary blackholed, secondary answering in %u ms:\n", options.secondaryDelayMs);
+
+    std::vector<double> times;
+    unsigned int down = 0;
+
+    if (options.sequentialRuns > 0) {
+        for (unsigned int i = 0; i < options.sequentialRuns; i++) {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+            if (!sequentialCheck(options)) {
+                down++;
+            }
+
+            times.push_back(millisecondsSince(start));
+        }
+
+        report("servers in turn:", times, down);
+    }
+
+    DnsAddress servers[2];
+    const char* addresses[] = { PRIMARY, SECONDARY };
+
+    for (size_t i = 0; i < 2; i++) {
+        memset(&servers[i], 0, sizeof(servers[i]));
+        servers[i].length = 4;
+        inet_pton(AF_INET, addresses[i], servers[i].bytes);
+    }
+
+    DnsProbe probe(300000, 30000);
+    if (!probe.SetServers(servers, 2, options.port)) {
+        fprintf(stderr, "The stand-ins weren't taken as servers.\n");
+        return 1;
+    }
+
+    times.clear();
+    down = 0;
+
+    for (unsigned int i = 0; i < options.runs; i++) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        DnsProbeResult result;
+
+        if (!probe.Probe(TEST_NAME, DNS_TYPE_A, PROBE_TIMEOUT_MS, &result) || !result.up) {
+            down++;
+        }
+
+        times.push_back(millisecondsSince(start));
+    }
+
+    report("both at once:", times, down);
+
+    times.clear();
+    down = 0;
+
+    for (unsigned int i = 0; i < options.runs; i++) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        DnsProbeResult result;
+
+        if (!probe.Resolve(TEST_NAME, DNS_TYPE_A, PROBE_TIMEOUT_MS, &result) || !result.up) {
+            down++;
+        }
+
+        times.push_back(millisecondsSince(start));
+    }
+
+    report("cached after the first:", times, down);
+
+    DnsServerStats stats;
+    if (probe.GetStats(1, &stats)) {
+        printf("  secondary srtt %u ms, rto %u ms\n", stats.srttMs, stats.rtoMs);
+    }
+
+    return 0;
+}
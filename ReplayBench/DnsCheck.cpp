@@ -0,0 +1,354 @@
+#include "DnsCache.h"
+#include "DnsMessage.h"
+#include "DnsProbe.h"
+#include "DnsStandIn.h"
+
+#include <arpa/inet.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define DEFAULT_PORT 15353
+
+#define TEST_NAME "testdns.cloudveil.org"
+
+#define MAX_CACHE_TTL_MS 300000
+#define FAILURE_CACHE_TTL_MS 30000
+
+// Loose bounds on how long a verdict may take on loopback, so that a busy machine doesn't fail the
+// check. The probe itself only waits when a server is silent.
+#define FAST_VERDICT_MS 200
+
+#define CONCURRENT_THREADS 8
+#define CONCURRENT_PROBES 50
+
+typedef struct CheckResults {
+    unsigned int checks;
+    unsigned int failed;
+} CheckResults;
+
+static void expect(CheckResults* results, bool condition, const char* scenario, const char* what) {
+    results->checks++;
+
+    if (!condition) {
+        results->failed++;
+        fprintf(stderr, "%s: %s\n", scenario, what);
+    }
+}
+
+static DnsAddress address(const char* text) {
+    DnsAddress parsed;
+    memset(&parsed, 0, sizeof(parsed));
+
+    if (strchr(text, ':') != NULL) {
+        parsed.length = 16;
+        inet_pton(AF_INET6, text, parsed.bytes);
+    }
+    else {
+        parsed.length = 4;
+        inet_pton(AF_INET, text, parsed.bytes);
+    }
+
+    return parsed;
+}
+
+static bool listen(DnsStandIn& standIn, const char* at, unsigned short port) {
+    std::string error;
+
+    if (!standIn.Listen(at, port, &error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+static void checkMessages(CheckResults* results) {
+    const char* scenario = "messages";
+    unsigned char query[DNS_MAX_MESSAGE];
+    DnsAnswer answer;
+
+    expect(results, DnsMessage::BuildQuery(1, "", DNS_TYPE_A, query, sizeof(query)) == 0, scenario, "an empty name made a query");
+    expect(results, DnsMessage::BuildQuery(1, "a..b", DNS_TYPE_A, query, sizeof(query)) == 0, scenario, "an empty label made a query");
+    expect(results, DnsMessage::BuildQuery(1, std::string(64, 'a').c_str(), DNS_TYPE_A, query, sizeof(query)) == 0, scenario, "a 64 byte label made a query");
+
+    size_t length = DnsMessage::BuildQuery(0x1234, TEST_NAME ".", DNS_TYPE_A, query, sizeof(query));
+    expect(results, length == 12 + 23 + 4, scenario, "the query is the wrong length");
+    expect(results, !DnsMessage::ParseResponse(query, length, 0x1234, DNS_TYPE_A, &answer), scenario, "a query was read as a response");
+
+    query[2] |= 0x80;
+    expect(results, DnsMessage::ParseResponse(query, length, 0x1234, DNS_TYPE_A, &answer) && answer.addressCount == 0, scenario, "an empty response wasn't read");
+    expect(results, !DnsMessage::ParseResponse(query, length, 0x1235, DNS_TYPE_A, &answer), scenario, "a response to another id was read");
+
+    // Claims an answer that isn't there.
+    query[7] = 1;
+    expect(results, !DnsMessage::ParseResponse(query, length, 0x1234, DNS_TYPE_A, &answer), scenario, "a truncated response was read");
+}
+
+static void checkCache(CheckResults* results) {
+    const char* scenario = "cache";
+    DnsCache cache(MAX_CACHE_TTL_MS, FAILURE_CACHE_TTL_MS);
+    DnsAnswer answer;
+    DnsAnswer found;
+    bool up = false;
+
+    memset(&answer, 0, sizeof(answer));
+    answer.addressCount = 1;
+    answer.ttl = 10;
+
+    cache.Store("Foo.Example.", DNS_TYPE_A, answer, 1000);
+    expect(results, cache.Find("foo.example", DNS_TYPE_A, 5000, &up, &found) && up && found.ttl == 6, scenario, "an answer wasn't found with its TTL counted down");
+    expect(results, !cache.Find("foo.example", DNS_TYPE_AAAA, 5000, &up, &found), scenario, "an A answer was found for AAAA");
+    expect(results, !cache.Find("foo.example", DNS_TYPE_A, 11000, &up, &found), scenario, "an answer outlived its TTL");
+
+    answer.ttl = 100000;
+    cache.Store("long", DNS_TYPE_A, answer, 0);
+    expect(results, cache.Find("long", DNS_TYPE_A, MAX_CACHE_TTL_MS - 1, &up, &found), scenario, "a long TTL wasn't kept up to the cap");
+    expect(results, !cache.Find("long", DNS_TYPE_A, MAX_CACHE_TTL_MS, &up, &found), scenario, "a long TTL outlived the cap");
+
+    cache.StoreFailure("down", DNS_TYPE_A, 0);
+    expect(results, cache.Find("down", DNS_TYPE_A, FAILURE_CACHE_TTL_MS - 1, &up, &found) && !up, scenario, "a failure wasn't kept");
+    expect(results, !cache.Find("down", DNS_TYPE_A, FAILURE_CACHE_TTL_MS, &up, &found), scenario, "a failure was kept too long");
+
+    answer.ttl = 0;
+    cache.Store("zero", DNS_TYPE_A, answer, 0);
+    expect(results, !cache.Find("zero", DNS_TYPE_A, 0, &up, &found), scenario, "an answer with no TTL was kept");
+
+    answer.ttl = 5;
+    for (int i = 0; i < 1000; i++) {
+        cache.Store(("n" + std::to_string(i)).c_str(), DNS_TYPE_A, answer, 0);
+    }
+
+    expect(results, cache.Count() <= DNS_CACHE_CAPACITY, scenario, "the cache grew past its capacity");
+}
+
+static bool checkProbes(CheckResults* results, unsigned short port) {
+    DnsProbeResult result;
+    DnsServerStats stats;
+
+    {
+        const char* scenario = "one server";
+        DnsStandIn server(DNS_STAND_IN_ANSWER, 0, 60);
+        if (!listen(server, "127.0.0.2", port)) {
+            return false;
+        }
+
+        DnsAddress servers[] = { address("127.0.0.2") };
+        DnsProbe probe(MAX_CACHE_TTL_MS, FAILURE_CACHE_TTL_MS);
+
+        expect(results, probe.SetServers(servers, 1, port), scenario, "the server wasn't taken");
+        expect(results, probe.Probe(TEST_NAME, DNS_TYPE_A, 2000, &result), scenario, "the probe didn't run");
+        expect(results, result.up && result.server == 0 && result.answer.addressCount == 1, scenario, "the server's answer wasn't taken");
+        expect(results, result.answer.addresses[0].bytes[3] == DNS_STAND_IN_ADDRESS && result.answer.ttl == 60, scenario, "the answer was misread");
+        expect(results, probe.GetStats(0, &stats) && stats.answers == 1 && stats.srttMs >= 1 && stats.rtoMs == DNS_PROBE_MIN_RTO_MS, scenario, "the round trip wasn't timed");
+    }
+
+    {
+        const char* scenario = "blackholed primary";
+        DnsStandIn primary(DNS_STAND_IN_BLACKHOLE, 0, 60);
+        DnsStandIn secondary(DNS_STAND_IN_ANSWER, 20, 60);
+        if (!listen(primary, "127.0.0.3", port) || !listen(secondary, "127.0.0.4", port)) {
+            return false;
+        }
+
+        DnsAddress servers[] = { address("127.0.0.3"), address("127.0.0.4") };
+        DnsProbe probe(MAX_CACHE_TTL_MS, FAILURE_CACHE_TTL_MS);
+
+        expect(results, probe.SetServers(servers, 2, port), scenario, "the servers weren't taken");
+        expect(results, probe.Probe(TEST_NAME, DNS_TYPE_A, 3000, &result), scenario, "the probe didn't run");
+        expect(results, result.up && result.server == 1, scenario, "the secondary's answer wasn't taken");
+        expect(results, result.elapsedMs < FAST_VERDICT_MS, scenario, "the verdict waited on the primary");
+    }
+
+    {
+        const char* scenario = "refused";
+        DnsAddress servers[] = { address("127.0.0.5"), address("::1") };
+        DnsProbe probe(MAX_CACHE_TTL_MS, FAILURE_CACHE_TTL_MS);
+
+        expect(results, probe.SetServers(servers, 2, port), scenario, "the servers weren't taken");
+        expect(results, probe.Probe(TEST_NAME, DNS_TYPE_A, 3000, &result), scenario, "the probe didn't run");
+        expect(results, !result.up && result.elapsedMs < FAST_VERDICT_MS, scenario, "closed ports weren't down at once");
+        expect(results, probe.GetStats(1, &stats) && stats.failures == 1, scenario, "the IPv6 server's failure wasn't counted");
+    }
+
+    {
+        const char* scenario = "all blackholed";
+        DnsStandIn server(DNS_STAND_IN_BLACKHOLE, 0, 60);
+        if (!listen(server, "127.0.0.6", port)) {
+            return false;
+        }
+
+        DnsAddress servers[] = { address("127.0.0.6") };
+        DnsProbe probe(MAX_CACHE_TTL_MS, FAILURE_CACHE_TTL_MS);
+
+        expect(results, probe.SetServers(servers, 1, port), scenario, "the server wasn't taken");
+        expect(results, probe.Probe(TEST_NAME, DNS_TYPE_A, 10000, &result), scenario, "the probe didn't run");
+        expect(results, !result.up && server.Queries() == DNS_PROBE_MAX_ATTEMPTS, scenario, "the query wasn't sent the most times before giving up");
+        expect(results, probe.GetStats(0, &stats) && stats.retransmits == DNS_PROBE_MAX_ATTEMPTS - 1 && stats.failures == 1, scenario, "the resends weren't counted");
+        expect(results, stats.rtoMs == DNS_PROBE_MAX_RTO_MS, scenario, "the timeout didn't back off to its limit");
+
+        // With the timeout backed off, a short deadline is what ends the next probe.
+        expect(results, probe.Probe(TEST_NAME, DNS_TYPE_A, 300, &result), scenario, "the second probe didn't run");
+        expect(results, !result.up && result.elapsedMs >= 300 && result.elapsedMs < 300 + FAST_VERDICT_MS, scenario, "the deadline wasn't kept");
+    }
+
+    {
+        const char* scenario = "lost query";
+        DnsStandIn server(DNS_STAND_IN_DROP_FIRST, 0, 60);
+        if (!listen(server, "127.0.0.7", port)) {
+            return false;
+        }
+
+        DnsAddress servers[] = { address("127.0.0.7") };
+        DnsProbe probe(MAX_CACHE_TTL_MS, FAILURE_CACHE_TTL_MS);
+
+        expect(results, probe.SetServers(servers, 1, port), scenario, "the server wasn't taken");
+        expect(results, probe.Probe(TEST_NAME, DNS_TYPE_A, 3000, &result), scenario, "the probe didn't run");
+        expect(results, result.up && result.elapsedMs >= DNS_PROBE_INITIAL_RTO_MS, scenario, "the resent query wasn't answered");
+
+        // Karn's rule: the answer can't be matched to a send, so it isn't timed.
+        expect(results, probe.GetStats(0, &stats) && stats.retransmits == 1 && stats.srttMs == 0, scenario, "a resent query was timed");
+    }
+
+    {
+        const char* scenario = "failed answers";
+        DnsStandIn failing(DNS_STAND_IN_SERVFAIL, 0, 60);
+        DnsStandIn empty(DNS_STAND_IN_EMPTY, 0, 60);
+        if (!listen(failing, "127.0.0.8", port) || !listen(empty, "127.0.0.9", port)) {
+            return false;
+        }
+
+        DnsAddress servers[] = { address("127.0.0.8"), address("127.0.0.9") };
+        DnsProbe probe(MAX_CACHE_TTL_MS, FAILURE_CACHE_TTL_MS);
+
+        expect(results, probe.SetServers(servers, 2, port), scenario, "the servers weren't taken");
+        expect(results, probe.Probe(TEST_NAME, DNS_TYPE_A, 3000, &result), scenario, "the probe didn't run");
+        expect(results, !result.up && result.elapsedMs < FAST_VERDICT_MS, scenario, "SERVFAIL and an empty answer weren't down at once");
+    }
+
+    {
+        const char* scenario = "cached CNAME over IPv6";
+        DnsStandIn server(DNS_STAND_IN_CNAME, 0, 2);
+        if (!listen(server, "::1", port)) {
+            return false;
+        }
+
+        DnsAddress servers[] = { address("::1") };
+        DnsProbe probe(MAX_CACHE_TTL_MS, FAILURE_CACHE_TTL_MS);
+
+        expect(results, probe.SetServers(servers, 1, port), scenario, "the server wasn't taken");
+        expect(results, probe.Resolve(TEST_NAME, DNS_TYPE_A, 3000, &result), scenario, "the lookup didn't run");
+        expect(results, result.up && !result.fromCache && result.answer.addressCount == 1, scenario, "the CNAME's target wasn't taken");
+        expect(results, result.answer.addresses[0].bytes[3] == DNS_STAND_IN_CNAME_ADDRESS && result.answer.ttl == 2, scenario, "the answer under the CNAME was misread");
+
+        expect(results, probe.Resolve("TESTDNS.cloudveil.org", DNS_TYPE_A, 3000, &result) && result.up && result.fromCache, scenario, "the answer wasn't cached");
+        expect(results, server.Queries() == 1, scenario, "a cached lookup went to the server");
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(2100));
+        expect(results, probe.Resolve(TEST_NAME, DNS_TYPE_A, 3000, &result) && result.up && !result.fromCache, scenario, "the answer outlived its TTL");
+        expect(results, server.Queries() == 2, scenario, "the expired answer wasn't asked for again");
+
+        expect(results, probe.SetServers(servers, 1, port), scenario, "the same servers weren't taken");
+        expect(results, probe.Resolve(TEST_NAME, DNS_TYPE_A, 3000, &result) && result.fromCache, scenario, "setting the same servers cleared the cache");
+
+        DnsAddress changed[] = { address("::1"), address("127.0.0.10") };
+        expect(results, probe.SetServers(changed, 2, port), scenario, "the changed servers weren't taken");
+        expect(results, probe.GetStats(0, &stats) && stats.answers == 2, scenario, "a server's timing was lost when the list changed");
+        expect(results, probe.Resolve(TEST_NAME, DNS_TYPE_A, 3000, &result) && !result.fromCache, scenario, "changing the servers didn't clear the cache");
+    }
+
+    {
+        const char* scenario = "concurrent probes";
+        DnsStandIn answering(DNS_STAND_IN_ANSWER, 1, 60);
+        DnsStandIn silent(DNS_STAND_IN_BLACKHOLE, 0, 60);
+        if (!listen(answering, "127.0.0.11", port) || !listen(silent, "127.0.0.12", port)) {
+            return false;
+        }
+
+        DnsAddress servers[] = { address("127.0.0.12"), address("127.0.0.11") };
+        DnsProbe probe(MAX_CACHE_TTL_MS, FAILURE_CACHE_TTL_MS);
+        expect(results, probe.SetServers(servers, 2, port), scenario, "the servers weren't taken");
+
+        std::atomic<unsigned int> ups(0);
+        std::vector<std::thread> threads;
+
+        for (int t = 0; t < CONCURRENT_THREADS; t++) {
+            threads.push_back(std::thread([&]() {
+                for (int i = 0; i < CONCURRENT_PROBES; i++) {
+                    DnsProbeResult each;
+
+                    if (probe.Probe(TEST_NAME, DNS_TYPE_A, 2000, &each) && each.up) {
+                        ups++;
+                    }
+                }
+            }));
+        }
+
+        for (size_t t = 0; t < threads.size(); t++) {
+            threads[t].join();
+        }
+
+        unsigned int total = CONCURRENT_THREADS * CONCURRENT_PROBES;
+        expect(results, ups == total, scenario, "a probe came back down");
+        expect(results, probe.GetStats(1, &stats) && stats.answers == total && stats.queries == total, scenario, "answers were lost between probes");
+    }
+
+    return true;
+}
+
+static void usage() {
+    fprintf(stderr,
+        "Usage: dns-check [--port N]\n"
+        "\n"
+        "Checks DnsMessage and DnsCache, then DnsProbe against stand-in DNS servers on 127.0.0.2-12\n"
+        "and ::1: answering, blackholed, refusing, dropping the first query, failing and answering\n"
+        "through a CNAME. Exits with 1 if any check fails.\n"
+        "\n"
+        "  --port N    UDP port the stand-ins listen on. Default %d.\n",
+        DEFAULT_PORT);
+}
+
+int main(int argc, char** argv) {
+    unsigned short port = DEFAULT_PORT;
+
+    for (int i = 1; i < argc; i++) {
+        std::string name = argv[i];
+        char* end = NULL;
+        unsigned long long value = i + 1 < argc ? strtoull(argv[i + 1], &end, 10) : 0;
+
+        if (i + 1 >= argc || end == argv[i + 1] || *end != '\0') {
+            usage();
+            return 1;
+        }
+
+        if (name == "--port" && value > 0 && value <= 0xFFFF) {
+            port = (unsigned short)value;
+        }
+        else {
+            usage();
+            return 1;
+        }
+
+        i++;
+    }
+
+    CheckResults results;
+    results.checks = 0;
+    results.failed = 0;
+
+    checkMessages(&results);
+    checkCache(&results);
+
+    if (!checkProbes(&results, port)) {
+        return 1;
+    }
+
+    printf("%u checks, %u failed\n", results.checks, results.failed);
+    return results.failed > 0 ? 1 : 0;
+}
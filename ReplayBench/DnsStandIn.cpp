@@ -0,0 +1,168 @@
+#include "DnsStandIn.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+
+// How often the serving thread looks up from poll() to see whether it should stop.
+#define STOP_POLL_MS 20
+
+#define HEADER_LENGTH 12
+
+DnsStandIn::DnsStandIn(DnsStandInMode mode, unsigned int delayMs, unsigned int ttl)
+    : mode(mode), delayMs(delayMs), ttl(ttl), socket(-1), stopping(false), queries(0) {
+}
+
+DnsStandIn::~DnsStandIn() {
+    stopping = true;
+
+    if (thread.joinable()) {
+        thread.join();
+    }
+
+    if (socket >= 0) {
+        close(socket);
+    }
+}
+
+bool DnsStandIn::Listen(const char* address, unsigned short port, std::string* error) {
+    sockaddr_storage local;
+    socklen_t localLength;
+    memset(&local, 0, sizeof(local));
+
+    if (strchr(address, ':') != NULL) {
+        sockaddr_in6* v6 = (sockaddr_in6*)&local;
+        v6->sin6_family = AF_INET6;
+        v6->sin6_port = htons(port);
+        localLength = sizeof(sockaddr_in6);
+
+        if (inet_pton(AF_INET6, address, &v6->sin6_addr) != 1) {
+            *error = std::string(address) + " isn't an address.";
+            return false;
+        }
+    }
+    else {
+        sockaddr_in* v4 = (sockaddr_in*)&local;
+        v4->sin_family = AF_INET;
+        v4->sin_port = htons(port);
+        localLength = sizeof(sockaddr_in);
+
+        if (inet_pton(AF_INET, address, &v4->sin_addr) != 1) {
+            *error = std::string(address) + " isn't an address.";
+            return false;
+        }
+    }
+
+    socket = ::socket(local.ss_family, SOCK_DGRAM, IPPROTO_UDP);
+    if (socket < 0) {
+        *error = std::string("Couldn't open a socket: ") + strerror(errno);
+        return false;
+    }
+
+    int reuse = 1;
+    setsockopt(socket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    if (bind(socket, (sockaddr*)&local, localLength) != 0) {
+        *error = std::string("Couldn't listen on ") + address + ": " + strerror(errno);
+        return false;
+    }
+
+    thread = std::thread(&DnsStandIn::serve, this);
+    return true;
+}
+
+static unsigned char* putRecord(unsigned char* at, unsigned char nameHigh, unsigned char nameLow, unsigned short type, unsigned int ttl) {
+    at[0] = nameHigh;
+    at[1] = nameLow;
+    at[2] = (unsigned char)(type >> 8);
+    at[3] = (unsigned char)type;
+
+    // Class IN.
+    at[4] = 0;
+    at[5] = 1;
+
+    at[6] = (unsigned char)(ttl >> 24);
+    at[7] = (unsigned char)(ttl >> 16);
+    at[8] = (unsigned char)(ttl >> 8);
+    at[9] = (unsigned char)ttl;
+
+    return at + 10;
+}
+
+void DnsStandIn::serve() {
+    unsigned char query[512];
+    unsigned char response[512];
+
+    while (!stopping) {
+        pollfd descriptor;
+        descriptor.fd = socket;
+        descriptor.events = POLLIN;
+        descriptor.revents = 0;
+
+        if (poll(&descriptor, 1, STOP_POLL_MS) <= 0) {
+            continue;
+        }
+
+        sockaddr_storage from;
+        socklen_t fromLength = sizeof(from);
+        ssize_t length = recvfrom(socket, query, sizeof(query), 0, (sockaddr*)&from, &fromLength);
+
+        if (length < HEADER_LENGTH) {
+            continue;
+        }
+
+        unsigned int count = ++queries;
+
+        if (mode == DNS_STAND_IN_BLACKHOLE || (mode == DNS_STAND_IN_DROP_FIRST && count == 1)) {
+            continue;
+        }
+
+        if (delayMs > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(delayMs));
+        }
+
+        // The question goes back as it came, with the header turned into a response: QR, RD and RA
+        // set, and the rcode in the low bits.
+        memcpy(response, query, (size_t)length);
+        response[2] = 0x81;
+        response[3] = mode == DNS_STAND_IN_SERVFAIL ? 0x82 : 0x80;
+
+        unsigned char* at = response + length;
+        unsigned char answers = 0;
+
+        if (mode == DNS_STAND_IN_ANSWER || mode == DNS_STAND_IN_DROP_FIRST) {
+            // Owner name is a pointer back to the question at offset 12.
+            at = putRecord(at, 0xC0, HEADER_LENGTH, 1, ttl);
+            const unsigned char address[] = { 0, 4, 10, 0, 0, DNS_STAND_IN_ADDRESS };
+            memcpy(at, address, sizeof(address));
+            at += sizeof(address);
+            answers = 1;
+        }
+        else if (mode == DNS_STAND_IN_CNAME && length + 32 <= (ssize_t)sizeof(response)) {
+            // The CNAME's target starts at its rdata, which the A record's owner points to.
+            size_t target = (size_t)(at - response) + 12;
+
+            at = putRecord(at, 0xC0, HEADER_LENGTH, 5, ttl);
+            const unsigned char alias[] = { 0, 4, 1, 'x', 0xC0, HEADER_LENGTH };
+            memcpy(at, alias, sizeof(alias));
+            at += sizeof(alias);
+
+            at = putRecord(at, (unsigned char)(0xC0 | (target >> 8)), (unsigned char)target, 1, ttl);
+            const unsigned char address[] = { 0, 4, 10, 0, 0, DNS_STAND_IN_CNAME_ADDRESS };
+            memcpy(at, address, sizeof(address));
+            at += sizeof(address);
+            answers = 2;
+        }
+
+        response[6] = 0;
+        response[7] = answers;
+
+        sendto(socket, response, (size_t)(at - response), 0, (sockaddr*)&from, fromLength);
+    }
+}
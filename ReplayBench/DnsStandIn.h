@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+typedef enum DnsStandInMode {
+    // Answers every query with one A record for DNS_STAND_IN_ADDRESS.
+    DNS_STAND_IN_ANSWER,
+
+    // Reads queries and never answers, like a server behind a firewall that drops them.
+    DNS_STAND_IN_BLACKHOLE,
+
+    // Ignores the first query it gets and answers the rest.
+    DNS_STAND_IN_DROP_FIRST,
+
+    DNS_STAND_IN_SERVFAIL,
+
+    // A NOERROR response with no records.
+    DNS_STAND_IN_EMPTY,
+
+    // Answers with a CNAME to x.<name> and an A record for DNS_STAND_IN_CNAME_ADDRESS under it.
+    DNS_STAND_IN_CNAME
+} DnsStandInMode;
+
+// Last byte of 10.0.0.x in the answers, so that a check can tell which kind of answer it got.
+#define DNS_STAND_IN_ADDRESS 1
+#define DNS_STAND_IN_CNAME_ADDRESS 9
+
+/// A DNS server on a loopback address, for checking and timing DnsProbe without a network. It
+/// answers any question the same way, as its mode says, after waiting delayMs, and counts the
+/// queries it has read.
+///
+/// Linux routes all of 127.0.0.0/8 to loopback, so several can listen on the same port at
+/// 127.0.0.2, 127.0.0.3 and so on, the way a primary and secondary server would.
+class DnsStandIn {
+public:
+    DnsStandIn(DnsStandInMode mode, unsigned int delayMs, unsigned int ttl);
+    ~DnsStandIn();
+
+    /// Binds address, IPv4 or IPv6, and starts answering on a thread of its own. Returns false with
+    /// a description in error if the address can't be bound.
+    bool Listen(const char* address, unsigned short port, std::string* error);
+
+    unsigned int Queries() const { return queries; }
+
+private:
+    DnsStandIn(const DnsStandIn&);
+    DnsStandIn& operator=(const DnsStandIn&);
+
+    void serve();
+
+    DnsStandInMode mode;
+    unsigned int delayMs;
+    unsigned int ttl;
+
+    int socket;
+    std::thread thread;
+    std::atomic<bool> stopping;
+    std::atomic<unsigned int> queries;
+};
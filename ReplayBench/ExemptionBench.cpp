@@ -0,0 +1,347 @@
+#include "ExemptionTable.h"
+
+#include <time.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#define DEFAULT_ENTRIES 5000
+#define DEFAULT_LOOKUPS 2000000
+#define DEFAULT_HIT_PERCENT 50
+#define DEFAULT_SEED 11
+
+#define THUMBPRINT_LENGTH 20
+
+// Keys each thread cycles through, so that they come from memory the way they would from handshakes
+// on many connections rather than from one cache line.
+#define KEYS_PER_THREAD 4096
+
+// How often the writer moves an expiry while lookups run, roughly as often as a busy user could
+// trust certificates.
+#define WRITER_PERIOD_US 200
+
+typedef struct Key {
+    unsigned char thumbprint[THUMBPRINT_LENGTH];
+    unsigned long long hostHash;
+    bool exempted;
+} Key;
+
+typedef struct BenchOptions {
+    unsigned int threads;
+    unsigned long long entries;
+    unsigned long long lookups;
+    unsigned int hitPercent;
+    bool writer;
+    unsigned long long seed;
+} BenchOptions;
+
+// What CertificateExemptions did before ExemptionTable, without the SQLite query it ran under the
+// lock: one lock taken by every check.
+class LockedExemptions {
+public:
+    bool IsExempted(const unsigned char* thumbprint, unsigned long long hostHash, long long now) const {
+        std::lock_guard<std::mutex> guard(lock);
+
+        std::map<std::pair<std::string, unsigned long long>, long long>::const_iterator found =
+            entries.find(std::make_pair(std::string((const char*)thumbprint, THUMBPRINT_LENGTH), hostHash));
+
+        return found != entries.end() && now < found->second;
+    }
+
+    void Set(const unsigned char* thumbprint, unsigned long long hostHash, long long expiresAt) {
+        std::lock_guard<std::mutex> guard(lock);
+        entries[std::make_pair(std::string((const char*)thumbprint, THUMBPRINT_LENGTH), hostHash)] = expiresAt;
+    }
+
+private:
+    mutable std::mutex lock;
+    std::map<std::pair<std::string, unsigned long long>, long long> entries;
+};
+
+typedef struct RunResult {
+    double seconds;
+
+    // Mean over threads of the processor time each spent per lookup. Unlike the wall time, it doesn't
+    // grow when there are more threads than processors to run them.
+    double cpuNsPerLookup;
+
+    unsigned long long hits;
+    unsigned long long expectedHits;
+} RunResult;
+
+static double threadCpuNanoseconds() {
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+
+    return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+static Key randomKey(std::mt19937_64& random) {
+    Key key;
+
+    for (size_t i = 0; i < THUMBPRINT_LENGTH; i += 8) {
+        unsigned long long bits = random();
+        memcpy(key.thumbprint + i, &bits, THUMBPRINT_LENGTH - i < 8 ? THUMBPRINT_LENGTH - i : 8);
+    }
+
+    key.hostHash = random();
+    key.exempted = false;
+    return key;
+}
+
+// Runs lookups on threads that all start together, and times them from the start to the last one
+// finishing.
+template <typename Table>
+static RunResult run(const Table& table, const std::vector<std::vector<Key> >& keys, const BenchOptions& options, unsigned int threads, Table* writerTable, const std::vector<Key>& exempted) {
+    std::mutex lock;
+    std::condition_variable started;
+    bool go = false;
+    unsigned int ready = 0;
+
+    std::atomic<bool> stopWriter(false);
+    std::vector<double> threadNs(threads);
+    std::vector<unsigned long long> threadHits(threads);
+
+    std::vector<std::thread> workers;
+
+    for (unsigned int t = 0; t < threads; t++) {
+        workers.push_back(std::thread([&, t]() {
+            const std::vector<Key>& mine = keys[t];
+
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                ready++;
+                started.notify_all();
+                started.wait(guard, [&]() { return go; });
+            }
+
+            double start = threadCpuNanoseconds();
+            unsigned long long hits = 0;
+
+            for (unsigned long long i = 0; i < options.lookups; i++) {
+                const Key& key = mine[i % KEYS_PER_THREAD];
+
+                if (table.IsExempted(key.thumbprint, key.hostHash, 1000)) {
+                    hits++;
+                }
+            }
+
+            threadNs[t] = (threadCpuNanoseconds() - start) / options.lookups;
+            threadHits[t] = hits;
+        }));
+    }
+
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        started.wait(guard, [&]() { return ready == threads; });
+    }
+
+    // Moves expiries between two times that are both in the future, so the answers don't change.
+    std::thread writer;
+    if (writerTable != NULL) {
+        writer = std::thread([&]() {
+            size_t next = 0;
+
+            while (!stopWriter) {
+                const Key& key = exempted[next++ % exempted.size()];
+                writerTable->Set(key.thumbprint, key.hostHash, next % 2 == 0 ? EXEMPTION_NEVER_EXPIRES : 1000000);
+
+                std::this_thread::sleep_for(std::chrono::microseconds(WRITER_PERIOD_US));
+            }
+        });
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        go = true;
+    }
+
+    started.notify_all();
+
+    for (size_t t = 0; t < workers.size(); t++) {
+        workers[t].join();
+    }
+
+    RunResult result;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    stopWriter = true;
+    if (writer.joinable()) {
+        writer.join();
+    }
+
+    result.cpuNsPerLookup = 0;
+    result.hits = 0;
+    result.expectedHits = 0;
+
+    for (unsigned int t = 0; t < threads; t++) {
+        result.cpuNsPerLookup += threadNs[t] / threads;
+        result.hits += threadHits[t];
+
+        for (unsigned long long i = 0; i < options.lookups; i++) {
+            if (keys[t][i % KEYS_PER_THREAD].exempted) {
+                result.expectedHits++;
+            }
+        }
+    }
+
+    return result;
+}
+
+static void usage() {
+    fprintf(stderr,
+        "Usage: exemption-bench [options]\n"
+        "\n"
+        "Times certificate exemption lookups from 1, 2, 4 and so on up to N threads at once, in\n"
+        "ExemptionTable and behind one lock the way CertificateExemptions checked before it, and\n"
+        "checks that both give the expected answers.\n"
+        "\n"
+        "  --threads N        Most threads. Default the number of processors.\n"
+        "  --entries N        Exemptions in the table. Default %d.\n"
+        "  --lookups N        Lookups per thread. Default %d.\n"
+        "  --hit-percent N    Lookups that find an exemption. Default %d.\n"
+        "  --writer           Keep changing expiries from another thread while lookups run.\n"
+        "  --seed N           Default %d.\n",
+        DEFAULT_ENTRIES, DEFAULT_LOOKUPS, DEFAULT_HIT_PERCENT, DEFAULT_SEED);
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    options.threads = std::thread::hardware_concurrency();
+    options.entries = DEFAULT_ENTRIES;
+    options.lookups = DEFAULT_LOOKUPS;
+    options.hitPercent = DEFAULT_HIT_PERCENT;
+    options.writer = false;
+    options.seed = DEFAULT_SEED;
+
+    if (options.threads == 0) {
+        options.threads = 1;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        std::string name = argv[i];
+
+        if (name == "--writer") {
+            options.writer = true;
+            continue;
+        }
+
+        char* end = NULL;
+        unsigned long long value = i + 1 < argc ? strtoull(argv[i + 1], &end, 10) : 0;
+
+        if (i + 1 >= argc || end == argv[i + 1] || *end != '\0') {
+            usage();
+            return 1;
+        }
+
+        if (name == "--threads" && value >= 1 && value <= 256) {
+            options.threads = (unsigned int)value;
+        }
+        else if (name == "--entries" && value >= 1 && value <= 10000000) {
+            options.entries = value;
+        }
+        else if (name == "--lookups" && value >= 1) {
+            options.lookups = value;
+        }
+        else if (name == "--hit-percent" && value <= 100) {
+            options.hitPercent = (unsigned int)value;
+        }
+        else if (name == "--seed") {
+            options.seed = value;
+        }
+        else {
+            usage();
+            return 1;
+        }
+
+        i++;
+    }
+
+    std::mt19937_64 random(options.seed);
+
+    ExemptionTable table;
+    LockedExemptions locked;
+    std::vector<Key> exempted;
+
+    for (unsigned long long i = 0; i < options.entries; i++) {
+        Key key = randomKey(random);
+        key.exempted = true;
+
+        table.Set(key.thumbprint, THUMBPRINT_LENGTH, key.hostHash, EXEMPTION_NEVER_EXPIRES);
+        locked.Set(key.thumbprint, key.hostHash, EXEMPTION_NEVER_EXPIRES);
+        exempted.push_back(key);
+    }
+
+    // Every thread gets its own mix of exempted certificates and ones that aren't.
+    std::vector<std::vector<Key> > keys(options.threads);
+
+    for (unsigned int t = 0; t < options.threads; t++) {
+        for (size_t k = 0; k < KEYS_PER_THREAD; k++) {
+            if (random() % 100 < options.hitPercent) {
+                keys[t].push_back(exempted[random() % exempted.size()]);
+            }
+            else {
+                keys[t].push_back(randomKey(random));
+            }
+        }
+    }
+
+    // ExemptionTable::IsExempted() takes the length too.
+    struct IndexedTable {
+        ExemptionTable* table;
+
+        bool IsExempted(const unsigned char* thumbprint, unsigned long long hostHash, long long now) const {
+            return table->IsExempted(thumbprint, THUMBPRINT_LENGTH, hostHash, now);
+        }
+
+        void Set(const unsigned char* thumbprint, unsigned long long hostHash, long long expiresAt) {
+            table->Set(thumbprint, THUMBPRINT_LENGTH, hostHash, expiresAt);
+        }
+    };
+
+    IndexedTable indexed;
+    indexed.table = &table;
+
+    printf("%llu exemptions, %u%% hits, %llu lookups per thread%s, %u processors\n",
+        options.entries, options.hitPercent, options.lookups, options.writer ? ", writer running" : "", std::thread::hardware_concurrency());
+    printf("  %-8s %26s %26s\n", "threads", "ExemptionTable", "one lock");
+
+    std::vector<unsigned int> threadCounts;
+    for (unsigned int threads = 1; threads < options.threads; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+
+    threadCounts.push_back(options.threads);
+
+    bool wrong = false;
+
+    for (size_t c = 0; c < threadCounts.size(); c++) {
+        unsigned int threads = threadCounts[c];
+        RunResult lockFree = run(indexed, keys, options, threads, options.writer ? &indexed : NULL, exempted);
+        RunResult serialized = run(locked, keys, options, threads, options.writer ? &locked : NULL, exempted);
+
+        printf("  %-8u %7.1f M/s %7.1f cpu ns %7.1f M/s %7.1f cpu ns\n", threads,
+            threads * options.lookups / lockFree.seconds / 1e6, lockFree.cpuNsPerLookup,
+            threads * options.lookups / serialized.seconds / 1e6, serialized.cpuNsPerLookup);
+
+        if (lockFree.hits != lockFree.expectedHits || serialized.hits != serialized.expectedHits) {
+            fprintf(stderr, "%u threads: %llu and %llu hits, but should have been %llu.\n", threads, lockFree.hits, serialized.hits, lockFree.expectedHits);
+            wrong = true;
+        }
+    }
+
+    return wrong ? 1 : 0;
+}
@@ -0,0 +1,297 @@
+#include "HotPathMetrics.h"
+
+#include <time.h>
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define DEFAULT_SAMPLES 20000000
+#define DEFAULT_SEED 5
+
+// Latencies each thread cycles through, spread evenly over the powers of two between these so that
+// samples land all over the histogram rather than in one bucket.
+#define VALUES_PER_THREAD 4096
+#define SMALLEST_VALUE_NS 100.0
+#define LARGEST_VALUE_NS 10000000.0
+
+// How often the reader takes a snapshot with --snapshots, the way DiagnosticsCollector's "metrics"
+// command would if someone kept running it.
+#define SNAPSHOT_PERIOD_MS 10
+
+typedef struct BenchOptions {
+    unsigned int threads;
+    unsigned long long samples;
+    bool snapshots;
+    unsigned long long seed;
+} BenchOptions;
+
+typedef enum SampleKind {
+    SAMPLE_RECORD,
+    SAMPLE_ADD,
+    SAMPLE_TIMED
+} SampleKind;
+
+typedef struct RunResult {
+    // Mean over threads of the processor time each spent per sample.
+    double cpuNsPerSample;
+
+    unsigned long long snapshots;
+} RunResult;
+
+static double threadCpuNanoseconds() {
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+
+    return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+// Records samples on threads that all start together, each from its own list of values. A timed
+// sample reads the clock twice and records the difference, which is what a caller timing its own
+// work pays on top of the work.
+static RunResult run(const std::vector<std::vector<unsigned long long> >& values, const BenchOptions& options, unsigned int threads, SampleKind kind) {
+    std::mutex lock;
+    std::condition_variable started;
+    bool go = false;
+    unsigned int ready = 0;
+
+    std::atomic<bool> stopReader(false);
+    std::atomic<unsigned long long> snapshots(0);
+    std::vector<double> threadNs(threads);
+
+    std::vector<std::thread> workers;
+
+    for (unsigned int t = 0; t < threads; t++) {
+        workers.push_back(std::thread([&, t]() {
+            const std::vector<unsigned long long>& mine = values[t];
+
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                ready++;
+                started.notify_all();
+                started.wait(guard, [&]() { return go; });
+            }
+
+            double start = threadCpuNanoseconds();
+
+            for (unsigned long long i = 0; i < options.samples; i++) {
+                unsigned long long value = mine[i % VALUES_PER_THREAD];
+
+                if (kind == SAMPLE_RECORD) {
+                    HotPathMetrics::Record(HOT_PATH_TRIGGER_SCAN, value);
+                }
+                else if (kind == SAMPLE_ADD) {
+                    HotPathMetrics::Add(HOT_PATH_BYTES_SCANNED, value);
+                }
+                else {
+                    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+                    unsigned long long elapsed = (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+
+                    HotPathMetrics::Record(HOT_PATH_SCAN_WAIT, elapsed);
+                }
+            }
+
+            threadNs[t] = (threadCpuNanoseconds() - start) / options.samples;
+        }));
+    }
+
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        started.wait(guard, [&]() { return ready == threads; });
+    }
+
+    std::thread reader;
+    if (options.snapshots) {
+        reader = std::thread([&]() {
+            HotPathSnapshot snapshot;
+
+            while (!stopReader) {
+                HotPathMetrics::Snapshot(&snapshot);
+                snapshots++;
+
+                std::this_thread::sleep_for(std::chrono::milliseconds(SNAPSHOT_PERIOD_MS));
+            }
+        });
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        go = true;
+    }
+
+    started.notify_all();
+
+    for (size_t t = 0; t < workers.size(); t++) {
+        workers[t].join();
+    }
+
+    stopReader = true;
+    if (reader.joinable()) {
+        reader.join();
+    }
+
+    RunResult result;
+    result.cpuNsPerSample = 0;
+    result.snapshots = snapshots;
+
+    for (unsigned int t = 0; t < threads; t++) {
+        result.cpuNsPerSample += threadNs[t] / threads;
+    }
+
+    return result;
+}
+
+static void usage() {
+    fprintf(stderr,
+        "Usage: metrics-bench [options]\n"
+        "\n"
+        "Times HotPathMetrics::Record() and Add() from 1, 2, 4 and so on up to N threads at once, and\n"
+        "a sample timed with steady_clock on top, and checks that snapshots add up to what was recorded.\n"
+        "\n"
+        "  --threads N        Most threads. Default the number of processors.\n"
+        "  --samples N        Samples per thread for each kind. Default %d.\n"
+        "  --snapshots        Keep taking snapshots from another thread while samples are recorded.\n"
+        "  --seed N           Default %d.\n",
+        DEFAULT_SAMPLES, DEFAULT_SEED);
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    options.threads = std::thread::hardware_concurrency();
+    options.samples = DEFAULT_SAMPLES;
+    options.snapshots = false;
+    options.seed = DEFAULT_SEED;
+
+    if (options.threads == 0) {
+        options.threads = 1;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        std::string name = argv[i];
+
+        if (name == "--snapshots") {
+            options.snapshots = true;
+            continue;
+        }
+
+        char* end = NULL;
+        unsigned long long value = i + 1 < argc ? strtoull(argv[i + 1], &end, 10) : 0;
+
+        if (i + 1 >= argc || end == argv[i + 1] || *end != '\0') {
+            usage();
+            return 1;
+        }
+
+        if (name == "--threads" && value >= 1 && value <= 256) {
+            options.threads = (unsigned int)value;
+        }
+        else if (name == "--samples" && value >= 1) {
+            options.samples = value;
+        }
+        else if (name == "--seed") {
+            options.seed = value;
+        }
+        else {
+            usage();
+            return 1;
+        }
+
+        i++;
+    }
+
+    std::mt19937_64 random(options.seed);
+    std::uniform_real_distribution<double> exponent(std::log2(SMALLEST_VALUE_NS), std::log2(LARGEST_VALUE_NS));
+
+    std::vector<std::vector<unsigned long long> > values(options.threads);
+
+    for (unsigned int t = 0; t < options.threads; t++) {
+        for (size_t v = 0; v < VALUES_PER_THREAD; v++) {
+            values[t].push_back((unsigned long long)std::exp2(exponent(random)));
+        }
+    }
+
+    printf("%llu samples per thread and kind%s, %u processors\n",
+        options.samples, options.snapshots ? ", snapshots running" : "", std::thread::hardware_concurrency());
+    printf("  %-8s %16s %16s %16s\n", "threads", "Record()", "Add()", "timed sample");
+
+    std::vector<unsigned int> threadCounts;
+    for (unsigned int threads = 1; threads < options.threads; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+
+    threadCounts.push_back(options.threads);
+
+    bool wrong = false;
+
+    for (size_t c = 0; c < threadCounts.size(); c++) {
+        unsigned int threads = threadCounts[c];
+
+        // Every thread records the same number of times, so the sums to expect come from the
+        // values each thread goes round.
+        unsigned long long expectedCount = threads * options.samples;
+        unsigned long long expectedTotal = 0;
+
+        for (unsigned int t = 0; t < threads; t++) {
+            for (unsigned long long i = 0; i < options.samples % VALUES_PER_THREAD; i++) {
+                expectedTotal += values[t][i];
+            }
+
+            unsigned long long round = 0;
+            for (size_t v = 0; v < VALUES_PER_THREAD; v++) {
+                round += values[t][v];
+            }
+
+            expectedTotal += round * (options.samples / VALUES_PER_THREAD);
+        }
+
+        HotPathSnapshot before;
+        HotPathSnapshot after;
+        HotPathMetrics::Snapshot(&before);
+
+        RunResult record = run(values, options, threads, SAMPLE_RECORD);
+        RunResult add = run(values, options, threads, SAMPLE_ADD);
+        RunResult timed = run(values, options, threads, SAMPLE_TIMED);
+
+        HotPathMetrics::Snapshot(&after);
+
+        printf("  %-8u %9.1f cpu ns %9.1f cpu ns %9.1f cpu ns", threads, record.cpuNsPerSample, add.cpuNsPerSample, timed.cpuNsPerSample);
+
+        if (options.snapshots) {
+            printf(", %llu snapshots", record.snapshots + add.snapshots + timed.snapshots);
+        }
+
+        printf("\n");
+
+        // The threads have exited by now, so everything they recorded has been retired into the
+        // snapshot and none of it can be missing.
+        const HotPathHistogram& scans = after.metrics[HOT_PATH_TRIGGER_SCAN];
+        const HotPathHistogram& scansBefore = before.metrics[HOT_PATH_TRIGGER_SCAN];
+        unsigned long long bucketed = 0;
+
+        for (size_t b = 0; b < HOT_PATH_HISTOGRAM_BUCKETS; b++) {
+            bucketed += scans.buckets[b] - scansBefore.buckets[b];
+        }
+
+        unsigned long long count = scans.count - scansBefore.count;
+        unsigned long long total = scans.totalNanoseconds - scansBefore.totalNanoseconds;
+        unsigned long long added = after.counters[HOT_PATH_BYTES_SCANNED] - before.counters[HOT_PATH_BYTES_SCANNED];
+        unsigned long long timedCount = after.metrics[HOT_PATH_SCAN_WAIT].count - before.metrics[HOT_PATH_SCAN_WAIT].count;
+
+        if (count != expectedCount || bucketed != expectedCount || total != expectedTotal || added != expectedTotal || timedCount != expectedCount) {
+            fprintf(stderr, "%u threads: %llu samples in %llu buckets totalling %llu ns, %llu added and %llu timed, but should have been %llu samples totalling %llu.\n",
+                threads, count, bucketed, total, added, timedCount, expectedCount, expectedTotal);
+            wrong = true;
+        }
+    }
+
+    return wrong ? 1 : 0;
+}
@@ -0,0 +1,1040 @@
+#include "BenchJson.h"
+#include "MemoryBudget.h"
+#include "ReplayCorpus.h"
+#include "ReplayPipeline.h"
+#include "ScanContext.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Bumped whenever a field of the report changes meaning, so that comparisons don't mix them up.
+#define REPORT_VERSION 1
+
+// The same defaults TextTriggerIndex starts with.
+#define DEFAULT_PARALLEL_THRESHOLD (1024 * 1024)
+#define DEFAULT_CHUNK_SIZE (256 * 1024)
+
+// The same defaults TriggerScanLimits has.
+#define DEFAULT_HEAD_SIZE (64 * 1024)
+#define DEFAULT_WINDOW_MS 250
+
+#define NANOSECONDS_PER_MICROSECOND 1000ULL
+#define NANOSECONDS_PER_MILLISECOND 1000000ULL
+
+#define DEFAULT_ITERATIONS 3
+#define DEFAULT_WARMUP 1
+#define DEFAULT_TOLERANCE 10.0
+
+#define EXIT_REGRESSED 2
+#define EXIT_OVER_MEMORY_LIMIT 3
+
+// The same default AppSettings has for WarmStartSnapshotVerdicts.
+#define DEFAULT_SNAPSHOT_VERDICTS 65536
+
+#define SNAPSHOT_POLICY_SEED 0x7265706c6179ULL
+
+static const char* const snapshotStatusNames[] = { "loaded", "missing", "corrupt", "incompatible", "stale", "overBudget" };
+
+static const double percentiles[] = { 50, 90, 99, 99.9 };
+static const char* const percentileKeys[] = { "p50Ns", "p90Ns", "p99Ns", "p999Ns" };
+
+#define PERCENTILE_COUNT (sizeof(percentiles) / sizeof(percentiles[0]))
+
+typedef struct BenchOptions {
+    std::string corpus;
+    std::vector<std::string> triggerLists;
+    std::string pageTemplate;
+    std::string label;
+    std::string output;
+    std::string baseline;
+    std::string snapshot;
+
+    unsigned int threads;
+    unsigned int iterations;
+    unsigned int warmup;
+    unsigned int burst;
+    double tolerance;
+    size_t snapshotVerdicts;
+
+    // By MEMORY_TAG_*. Zero for no limit.
+    size_t softLimits[MEMORY_TAG_COUNT];
+    size_t hardLimits[MEMORY_TAG_COUNT];
+
+    ReplayOptions replay;
+} BenchOptions;
+
+// Shared by the replaying threads. Records are handed out one at a time from a single counter, so
+// a thread that draws a large body doesn't hold up the rest.
+typedef struct ReplayRun {
+    const ReplayPipeline* pipeline;
+    const std::vector<ReplayRecord>* records;
+
+    unsigned long long warmupTotal;
+    unsigned long long measuredTotal;
+
+    // With bursts, measured records are released this many at a time, and the next ones only once
+    // all of them are done, the way a restored session's tabs load.
+    unsigned int burst;
+
+    std::atomic<unsigned long long> nextWarmup;
+    std::atomic<unsigned long long> nextMeasured;
+
+    // Records finished and bursts released so far. Threads that wait for a burst sleep, so that
+    // they don't take processor time from the ones scanning.
+    std::mutex burstLock;
+    std::condition_variable burstReleased;
+    unsigned long long finished;
+    unsigned long long released;
+    unsigned long long releasedAt;
+
+    std::atomic<unsigned int> warmedUp;
+    std::atomic<bool> go;
+} ReplayRun;
+
+static void usage() {
+    fprintf(stderr,
+        "Usage: replay-bench [options] <capture directory, segment or directory of bodies>\n"
+        "\n"
+        "Replays captured response bodies through JSON extraction, trigger matching and block page\n"
+        "rendering, and writes throughput, latency percentiles and allocations as JSON.\n"
+        "\n"
+        "  --triggers FILE            Trigger list, one trigger per line. Repeat for more categories;\n"
+        "                             each list gets the next category id, starting at 1.\n"
+        "  --template FILE            Block page to render, e.g. FilterProvider.Common/Resources/BlockedPage.html.\n"
+        "  --render-all               Render a page for every record, not only the ones that matched.\n"
+        "  --threads N                Replaying threads. Default 1.\n"
+        "  --iterations N             Measured passes over the corpus. Default %d.\n"
+        "  --warmup N                 Unmeasured passes first. Default %d.\n"
+        "  --phrase-words N           Longest phrase to look for, in words. Default 1.\n"
+        "  --parallel-threshold BYTES Scan bodies larger than this in chunks on the shared pool. 0 disables. Default %d.\n"
+        "  --chunk-size BYTES         Size of each chunk. Default %d.\n"
+        "  --verdict-cache BYTES      Cache trigger verdicts by content fingerprint in this much memory.\n"
+        "  --verdict-chunk BYTES      Size of the chunks that are fingerprinted. Default %d.\n"
+        "  --scan-slots N             Schedule scans through this many slots. 0, the default, scans every\n"
+        "                             record in full as it comes. HTML records are scheduled as top-level pages.\n"
+        "  --head-size BYTES          Scanned ahead of everything else and never cut short. Default %d.\n"
+        "  --request-budget-us N      Scan time one record may use. 0 for no limit.\n"
+        "  --global-budget CORES      Scan time all records together may use, in processors. 0 for no limit.\n"
+        "  --window-ms N              What the global budget is averaged over. Default %d.\n"
+        "  --max-wait-ms N            How long a part past the head may wait for a slot. 0 for no limit.\n"
+        "  --max-queued N             How many parts past the head may wait. 0 for no limit.\n"
+        "  --over-budget POLICY       head-only, defer or fail-closed. Default defer.\n"
+        "  --max-defer-ms N           How long deferred parts wait before the body is refused. 0 for no limit.\n"
+        "  --burst N                  Release measured records N at a time, the next N once those are done.\n"
+        "                             Use with --threads N.\n"
+        "  --snapshot FILE            Start from this warm start snapshot if it was saved for the same trigger\n"
+        "                             lists, and save one there at the end. Adds a startup section to the report.\n"
+        "  --snapshot-verdicts N      Cached verdicts to save with the snapshot. Default %d.\n"
+        "  --memory-limit TAG=BYTES   Hard memory limit for triggerIndex, verdictCache, scanBuffers or warmStart.\n"
+        "                             Exits with %d if a tag went over it with memory it could have refused.\n"
+        "  --memory-soft-limit TAG=BYTES\n"
+        "                             Soft limit. Tags over it are compacted after the measured passes.\n"
+        "  --label TEXT               Stored in the report, e.g. the commit being measured.\n"
+        "  --output FILE              Write the report here instead of to stdout.\n"
+        "  --baseline FILE            Compare with an earlier report and exit with %d on a regression.\n"
+        "  --tolerance PERCENT        How much worse a metric may get before it counts. Default %g.\n"
+        "\n"
+        "SQLite diagnostics files have to be converted with DiagnosticsCollector's import-diag first.\n",
+        DEFAULT_ITERATIONS, DEFAULT_WARMUP, DEFAULT_PARALLEL_THRESHOLD, DEFAULT_CHUNK_SIZE, VERDICT_CACHE_DEFAULT_CHUNK_SIZE,
+        DEFAULT_HEAD_SIZE, DEFAULT_WINDOW_MS, DEFAULT_SNAPSHOT_VERDICTS, EXIT_OVER_MEMORY_LIMIT, EXIT_REGRESSED, DEFAULT_TOLERANCE);
+}
+
+static bool parseCount(const char* text, unsigned long long* value) {
+    char* end = NULL;
+    unsigned long long parsed = strtoull(text, &end, 10);
+
+    if (end == text || *end != '\0' || text[0] == '-') {
+        return false;
+    }
+
+    *value = parsed;
+    return true;
+}
+
+// TAG=BYTES, with the tag named the way MemoryBudget::TagName() names it.
+static bool parseMemoryLimit(const char* text, size_t* limits) {
+    const char* equals = strchr(text, '=');
+    unsigned long long bytes = 0;
+
+    if (equals == NULL || !parseCount(equals + 1, &bytes)) {
+        return false;
+    }
+
+    std::string name(text, equals - text);
+
+    for (int tag = 0; tag < MEMORY_TAG_COUNT; tag++) {
+        if (name == MemoryBudget::TagName(tag)) {
+            limits[tag] = (size_t)bytes;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool parseOptions(int argc, char** argv, BenchOptions* options) {
+    options->threads = 1;
+    options->iterations = DEFAULT_ITERATIONS;
+    options->warmup = DEFAULT_WARMUP;
+    options->tolerance = DEFAULT_TOLERANCE;
+    options->snapshotVerdicts = DEFAULT_SNAPSHOT_VERDICTS;
+    memset(options->softLimits, 0, sizeof(options->softLimits));
+    memset(options->hardLimits, 0, sizeof(options->hardLimits));
+
+    memset(&options->replay, 0, sizeof(options->replay));
+    options->replay.maxPhraseWords = 1;
+    options->replay.parallelThreshold = DEFAULT_PARALLEL_THRESHOLD;
+    options->replay.chunkSize = DEFAULT_CHUNK_SIZE;
+    options->replay.verdictChunkSize = VERDICT_CACHE_DEFAULT_CHUNK_SIZE;
+    options->replay.scanLimits.headBytes = DEFAULT_HEAD_SIZE;
+    options->replay.scanLimits.window = DEFAULT_WINDOW_MS * NANOSECONDS_PER_MILLISECOND;
+    options->replay.scanLimits.overBudget = SCAN_OVER_BUDGET_DEFER;
+    options->burst = 0;
+
+    for (int i = 1; i < argc; i++) {
+        std::string name = argv[i];
+
+        if (name == "--render-all") {
+            options->replay.renderAll = true;
+            continue;
+        }
+
+        if (name == "--help" || name == "-h") {
+            return false;
+        }
+
+        if (name.compare(0, 2, "--") != 0) {
+            if (!options->corpus.empty()) {
+                fprintf(stderr, "Only one corpus can be replayed at a time.\n");
+                return false;
+            }
+
+            options->corpus = name;
+            continue;
+        }
+
+        if (i + 1 >= argc) {
+            fprintf(stderr, "%s needs a value.\n", name.c_str());
+            return false;
+        }
+
+        const char* value = argv[++i];
+        unsigned long long count = 0;
+
+        if (name == "--triggers") {
+            options->triggerLists.push_back(value);
+        }
+        else if (name == "--template") {
+            options->pageTemplate = value;
+        }
+        else if (name == "--label") {
+            options->label = value;
+        }
+        else if (name == "--output") {
+            options->output = value;
+        }
+        else if (name == "--baseline") {
+            options->baseline = value;
+        }
+        else if (name == "--snapshot") {
+            options->snapshot = value;
+        }
+        else if (name == "--tolerance") {
+            char* end = NULL;
+            options->tolerance = strtod(value, &end);
+
+            if (end == value || *end != '\0' || options->tolerance < 0) {
+                fprintf(stderr, "--tolerance takes a percentage.\n");
+                return false;
+            }
+        }
+        else if (name == "--global-budget") {
+            char* end = NULL;
+            options->replay.scanLimits.globalBudget = strtod(value, &end);
+
+            if (end == value || *end != '\0' || options->replay.scanLimits.globalBudget < 0) {
+                fprintf(stderr, "--global-budget takes a number of processors.\n");
+                return false;
+            }
+        }
+        else if (name == "--memory-limit" || name == "--memory-soft-limit") {
+            if (!parseMemoryLimit(value, name == "--memory-limit" ? options->hardLimits : options->softLimits)) {
+                fprintf(stderr, "%s takes TAG=BYTES, with TAG one of triggerIndex, verdictCache, scanBuffers or warmStart.\n", name.c_str());
+                return false;
+            }
+        }
+        else if (name == "--over-budget") {
+            std::string policy = value;
+
+            if (policy == "head-only") {
+                options->replay.scanLimits.overBudget = SCAN_OVER_BUDGET_HEAD_ONLY;
+            }
+            else if (policy == "defer") {
+                options->replay.scanLimits.overBudget = SCAN_OVER_BUDGET_DEFER;
+            }
+            else if (policy == "fail-closed") {
+                options->replay.scanLimits.overBudget = SCAN_OVER_BUDGET_FAIL_CLOSED;
+            }
+            else {
+                fprintf(stderr, "--over-budget takes head-only, defer or fail-closed.\n");
+                return false;
+            }
+        }
+        else if (!parseCount(value, &count)) {
+            fprintf(stderr, "%s takes a whole number.\n", name.c_str());
+            return false;
+        }
+        else if (name == "--threads" && count >= 1 && count <= 1024) {
+            options->threads = (unsigned int)count;
+        }
+        else if (name == "--iterations" && count >= 1) {
+            options->iterations = (unsigned int)count;
+        }
+        else if (name == "--warmup") {
+            options->warmup = (unsigned int)count;
+        }
+        else if (name == "--phrase-words" && count <= 64) {
+            options->replay.maxPhraseWords = (int)count;
+        }
+        else if (name == "--parallel-threshold") {
+            options->replay.parallelThreshold = (size_t)count;
+        }
+        else if (name == "--chunk-size" && count >= 1) {
+            options->replay.chunkSize = (size_t)count;
+        }
+        else if (name == "--verdict-cache") {
+            options->replay.verdictCacheSize = (size_t)count;
+        }
+        else if (name == "--verdict-chunk" && count >= 1) {
+            options->replay.verdictChunkSize = (size_t)count;
+        }
+        else if (name == "--scan-slots" && count <= 1024) {
+            options->replay.scanLimits.slots = (unsigned int)count;
+        }
+        else if (name == "--head-size") {
+            options->replay.scanLimits.headBytes = (size_t)count;
+        }
+        else if (name == "--request-budget-us") {
+            options->replay.scanLimits.requestBudget = count * NANOSECONDS_PER_MICROSECOND;
+        }
+        else if (name == "--window-ms" && count >= 1) {
+            options->replay.scanLimits.window = count * NANOSECONDS_PER_MILLISECOND;
+        }
+        else if (name == "--max-wait-ms") {
+            options->replay.scanLimits.maxWait = count * NANOSECONDS_PER_MILLISECOND;
+        }
+        else if (name == "--max-queued") {
+            options->replay.scanLimits.maxQueued = (size_t)count;
+        }
+        else if (name == "--max-defer-ms") {
+            options->replay.scanLimits.maxDefer = count * NANOSECONDS_PER_MILLISECOND;
+        }
+        else if (name == "--snapshot-verdicts") {
+            options->snapshotVerdicts = (size_t)count;
+        }
+        else if (name == "--burst" && count <= 1024) {
+            options->burst = (unsigned int)count;
+        }
+        else {
+            fprintf(stderr, "Unknown option or value out of range: %s %s\n", name.c_str(), value);
+            return false;
+        }
+    }
+
+    if (options->corpus.empty()) {
+        fprintf(stderr, "No corpus given.\n");
+        return false;
+    }
+
+    return true;
+}
+
+static void replayThread(ReplayRun* run, ReplayThreadStats* stats) {
+    const std::vector<ReplayRecord>& records = *run->records;
+
+    // Warming up fills this thread's scan and render buffers, so the measured passes see the steady state.
+    ReplayThreadStats discarded;
+
+    while (true) {
+        unsigned long long index = run->nextWarmup.fetch_add(1, std::memory_order_relaxed);
+
+        if (index >= run->warmupTotal) {
+            break;
+        }
+
+        memset(&discarded, 0, sizeof(discarded));
+        run->pipeline->Replay(records[index % records.size()], &discarded);
+    }
+
+    run->warmedUp.fetch_add(1, std::memory_order_release);
+
+    while (!run->go.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+    }
+
+    while (true) {
+        unsigned long long index = run->nextMeasured.fetch_add(1, std::memory_order_relaxed);
+
+        if (index >= run->measuredTotal) {
+            break;
+        }
+
+        if (run->burst == 0) {
+            run->pipeline->Replay(records[index % records.size()], stats);
+            continue;
+        }
+
+        // A record waits for the burst it belongs to, and the record that finishes a burst releases
+        // the next. Pages are timed from the release, so time spent waiting for a processor counts.
+        unsigned long long burst = index / run->burst;
+        unsigned long long arrived;
+
+        {
+            std::unique_lock<std::mutex> guard(run->burstLock);
+
+            while (run->released < burst) {
+                run->burstReleased.wait(guard);
+            }
+
+            arrived = run->releasedAt;
+        }
+
+        run->pipeline->Replay(records[index % records.size()], stats, arrived);
+
+        std::lock_guard<std::mutex> guard(run->burstLock);
+        run->finished++;
+
+        if (run->finished == (burst + 1) * run->burst || run->finished == run->measuredTotal) {
+            run->released = burst + 1;
+            run->releasedAt = ReplayPipeline::Now();
+            run->burstReleased.notify_all();
+        }
+    }
+}
+
+static void addStats(ReplayThreadStats& total, const ReplayThreadStats& stats) {
+    for (int s = 0; s < REPLAY_STAGE_COUNT; s++) {
+        ReplayStageStats& into = total.stages[s];
+        const ReplayStageStats& from = stats.stages[s];
+
+        into.latency.count += from.latency.count;
+        into.latency.totalNanoseconds += from.latency.totalNanoseconds;
+
+        if (from.latency.maxNanoseconds > into.latency.maxNanoseconds) {
+            into.latency.maxNanoseconds = from.latency.maxNanoseconds;
+        }
+
+        for (size_t b = 0; b < HOT_PATH_HISTOGRAM_BUCKETS; b++) {
+            into.latency.buckets[b] += from.latency.buckets[b];
+        }
+
+        into.allocations += from.allocations;
+        into.allocatedBytes += from.allocatedBytes;
+    }
+
+    total.documents.count += stats.documents.count;
+    total.documents.totalNanoseconds += stats.documents.totalNanoseconds;
+
+    if (stats.documents.maxNanoseconds > total.documents.maxNanoseconds) {
+        total.documents.maxNanoseconds = stats.documents.maxNanoseconds;
+    }
+
+    for (size_t b = 0; b < HOT_PATH_HISTOGRAM_BUCKETS; b++) {
+        total.documents.buckets[b] += stats.documents.buckets[b];
+    }
+
+    total.records += stats.records;
+    total.bytes += stats.bytes;
+    total.matches += stats.matches;
+    total.renderedBytes += stats.renderedBytes;
+    total.truncated += stats.truncated;
+    total.refused += stats.refused;
+}
+
+static bool readText(const std::string& path, std::string& text) {
+    FILE* file = fopen(path.c_str(), "rb");
+
+    if (file == NULL) {
+        return false;
+    }
+
+    char buffer[16 * 1024];
+    size_t read;
+
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        text.append(buffer, read);
+    }
+
+    fclose(file);
+    return true;
+}
+
+// What the compiled triggers were built from. The order of the lists matters too, since it picks
+// the category ids.
+static bool listsFingerprint(const std::vector<std::string>& lists, ContentHash* policy) {
+    ContentHash hash = HashContent(NULL, 0, SNAPSHOT_POLICY_SEED);
+
+    for (size_t i = 0; i < lists.size(); i++) {
+        std::string text;
+
+        if (!readText(lists[i], text)) {
+            return false;
+        }
+
+        hash = HashContent(reinterpret_cast<const unsigned char*>(text.data()), text.size(), hash.low ^ hash.high ^ (i + 1));
+    }
+
+    *policy = hash;
+    return true;
+}
+
+// Adds the comparison to the report and returns how many metrics regressed.
+static int compareWithBaseline(JsonWriter& report, const std::map<std::string, double>& current, const std::map<std::string, double>& baseline, const BenchOptions& options) {
+    typedef struct Rule {
+        const char* suffix;
+        bool higherIsBetter;
+    } Rule;
+
+    // Per-call allocation counts are compared like everything else but need to grow by at least one
+    // every other call, so that a stage that allocates nothing doesn't trip on rounding.
+    static const Rule rules[] = {
+        { "throughput.bytesPerSecond", true },
+        { "throughput.recordsPerSecond", true },
+        { ".p50Ns", false },
+        { ".p99Ns", false },
+        { ".allocationsPerCall", false }
+    };
+
+    int regressions = 0;
+
+    report.BeginObject("comparison");
+    report.Number("tolerancePercent", options.tolerance);
+
+    std::map<std::string, double>::const_iterator version = baseline.find("version");
+    std::map<std::string, double>::const_iterator baselineBytes = baseline.find("corpus.bodyBytes");
+    std::map<std::string, double>::const_iterator baselineThreads = baseline.find("config.threads");
+
+    bool comparable = version != baseline.end() && version->second == REPORT_VERSION &&
+        baselineBytes != baseline.end() && baselineBytes->second == current.find("corpus.bodyBytes")->second &&
+        baselineThreads != baseline.end() && baselineThreads->second == current.find("config.threads")->second;
+
+    report.Bool("sameCorpusAndThreads", comparable);
+
+    if (!comparable) {
+        fprintf(stderr, "warning: the baseline was taken with another report version, corpus or thread count.\n");
+    }
+
+    report.BeginArray("metrics");
+
+    for (std::map<std::string, double>::const_iterator i = current.begin(); i != current.end(); ++i) {
+        const Rule* rule = NULL;
+
+        for (size_t r = 0; r < sizeof(rules) / sizeof(rules[0]); r++) {
+            size_t length = strlen(rules[r].suffix);
+
+            if (i->first.size() >= length && i->first.compare(i->first.size() - length, length, rules[r].suffix) == 0) {
+                rule = &rules[r];
+                break;
+            }
+        }
+
+        std::map<std::string, double>::const_iterator before = baseline.find(i->first);
+
+        if (rule == NULL || before == baseline.end()) {
+            continue;
+        }
+
+        double change = before->second == 0 ? (i->second == 0 ? 0 : 100) : (i->second - before->second) * 100 / before->second;
+        double worse = rule->higherIsBetter ? -change : change;
+
+        bool regressed = worse > options.tolerance;
+        if (regressed && strcmp(rule->suffix, ".allocationsPerCall") == 0) {
+            regressed = i->second - before->second >= 0.5;
+        }
+
+        report.BeginObject();
+        report.String("metric", i->first);
+        report.Number("baseline", before->second);
+        report.Number("current", i->second);
+        report.Number("changePercent", change);
+        report.Bool("regressed", regressed);
+        report.EndObject();
+
+        if (regressed) {
+            regressions++;
+            fprintf(stderr, "regressed: %s %g -> %g (%+.1f%%)\n", i->first.c_str(), before->second, i->second, change);
+        }
+    }
+
+    report.EndArray();
+    report.Integer("regressions", (unsigned long long)regressions);
+    report.EndObject();
+
+    return regressions;
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+
+    if (!parseOptions(argc, argv, &options)) {
+        usage();
+        return 1;
+    }
+
+    // Before anything is built, the way the service sets them before it loads the lists.
+    for (int tag = 0; tag < MEMORY_TAG_COUNT; tag++) {
+        MemoryBudget::SetLimits(tag, options.softLimits[tag], options.hardLimits[tag]);
+    }
+
+    std::string error;
+    std::chrono::steady_clock::time_point loadStart = std::chrono::steady_clock::now();
+
+    ReplayCorpus corpus;
+    if (!corpus.Load(options.corpus, &error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+
+    double loadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - loadStart).count();
+
+    ReplayPipeline pipeline;
+
+    // Startup is timed the way the service goes through it: from reading the lists to the first
+    // record scanned with them.
+    bool warmStart = !options.snapshot.empty();
+    unsigned long long startupStart = ReplayPipeline::Now();
+
+    ContentHash policy;
+    memset(&policy, 0, sizeof(policy));
+
+    int snapshotStatus = WARM_START_MISSING;
+    size_t snapshotBytes = 0;
+    size_t restoredVerdicts = 0;
+
+    if (warmStart) {
+        if (!listsFingerprint(options.triggerLists, &policy)) {
+            fprintf(stderr, "Could not read the trigger lists.\n");
+            return 1;
+        }
+
+        // Verdicts are restored into the cache, so it has to exist first.
+        pipeline.Configure(options.replay);
+        snapshotStatus = pipeline.RestoreSnapshot(options.snapshot, policy, &restoredVerdicts, &snapshotBytes);
+    }
+
+    if (snapshotStatus != WARM_START_LOADED) {
+        for (size_t i = 0; i < options.triggerLists.size(); i++) {
+            size_t added = 0;
+
+            if (!pipeline.LoadTriggers(options.triggerLists[i], (short)(i + 1), &added, &error)) {
+                fprintf(stderr, "%s\n", error.c_str());
+                return 1;
+            }
+        }
+
+        pipeline.Configure(options.replay);
+    }
+
+    if (!options.pageTemplate.empty() && !pipeline.LoadTemplate(options.pageTemplate, &error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+
+    unsigned long long triggersReady = ReplayPipeline::Now();
+
+    const std::vector<ReplayRecord>& records = corpus.Records();
+
+    // One pass on this thread before anything else, so that what the snapshot's verdicts save shows
+    // up before the warmup passes cache everything anyway.
+    std::vector<ReplayThreadStats> startupStats(1);
+    memset(startupStats.data(), 0, sizeof(ReplayThreadStats));
+
+    unsigned long long firstRecordAt = triggersReady;
+    unsigned long long firstPassAt = triggersReady;
+
+    if (warmStart) {
+        for (size_t i = 0; i < records.size(); i++) {
+            pipeline.Replay(records[i], &startupStats[0]);
+
+            if (i == 0) {
+                firstRecordAt = ReplayPipeline::Now();
+            }
+        }
+
+        firstPassAt = ReplayPipeline::Now();
+    }
+
+    unsigned long long expectedMatches = 0;
+
+    for (size_t i = 0; i < records.size(); i++) {
+        if (pipeline.FullScanMatches(records[i])) {
+            expectedMatches += options.iterations;
+        }
+    }
+
+    ReplayRun run;
+    run.pipeline = &pipeline;
+    run.records = &records;
+    run.warmupTotal = (unsigned long long)options.warmup * records.size();
+    run.measuredTotal = (unsigned long long)options.iterations * records.size();
+    run.burst = options.burst;
+    run.nextWarmup.store(0);
+    run.nextMeasured.store(0);
+    run.finished = 0;
+    run.released = 0;
+    run.warmedUp.store(0);
+    run.go.store(false);
+
+    // Each one is several kilobytes of histograms, too much for the stack of a thread.
+    std::vector<ReplayThreadStats> threadStats(options.threads);
+    memset(threadStats.data(), 0, threadStats.size() * sizeof(ReplayThreadStats));
+
+    std::vector<std::thread> threads;
+    for (unsigned int i = 0; i < options.threads; i++) {
+        threads.push_back(std::thread(replayThread, &run, &threadStats[i]));
+    }
+
+    while (run.warmedUp.load(std::memory_order_acquire) < options.threads) {
+        std::this_thread::yield();
+    }
+
+    // Verdicts cached while warming up would turn the first measured pass into a replay of content
+    // the cache has already seen.
+    if (pipeline.Cache() != NULL) {
+        pipeline.Cache()->Clear();
+    }
+
+    if (pipeline.Scheduler() != NULL) {
+        pipeline.Scheduler()->ResetStats();
+    }
+
+    ScanAllocationStats scanBefore;
+    ScanContext::GetStats(&scanBefore);
+
+    std::clock_t cpuStart = std::clock();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    run.releasedAt = ReplayPipeline::Now();
+    run.go.store(true, std::memory_order_release);
+
+    for (size_t i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double cpuSeconds = (double)(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+
+    // Where the service's memory monitor would do it. Scan buffers are only trimmed by the thread
+    // that holds them, after its next scan, so this shows in compactions rather than live bytes.
+    int relievedTags = MemoryBudget::Relieve();
+
+    ScanAllocationStats scanAfter;
+    ScanContext::GetStats(&scanAfter);
+
+    ReplayThreadStats total;
+    memset(&total, 0, sizeof(total));
+
+    for (size_t i = 0; i < threadStats.size(); i++) {
+        addStats(total, threadStats[i]);
+    }
+
+    const ReplayCorpusStats& corpusStats = corpus.Stats();
+
+    JsonWriter report;
+    report.BeginObject();
+    report.String("format", "cloudveil-replay-bench");
+    report.Integer("version", REPORT_VERSION);
+    report.String("label", options.label);
+
+    report.BeginObject("config");
+    report.Integer("threads", options.threads);
+    report.Integer("iterations", options.iterations);
+    report.Integer("warmup", options.warmup);
+    report.Integer("maxPhraseWords", (unsigned long long)options.replay.maxPhraseWords);
+    report.Integer("parallelThreshold", options.replay.parallelThreshold);
+    report.Integer("chunkSize", options.replay.chunkSize);
+    report.Integer("verdictCacheSize", options.replay.verdictCacheSize);
+    report.Integer("verdictChunkSize", options.replay.verdictChunkSize);
+    report.Integer("burst", options.burst);
+
+    const ScanSchedulerLimits& limits = options.replay.scanLimits;
+    report.Integer("scanSlots", limits.slots);
+    report.Integer("headSize", limits.headBytes);
+    report.Integer("requestBudgetNs", limits.requestBudget);
+    report.Number("globalBudget", limits.globalBudget);
+    report.Integer("windowNs", limits.window);
+    report.Integer("maxWaitNs", limits.maxWait);
+    report.Integer("maxQueued", limits.maxQueued);
+    report.Integer("overBudget", (unsigned long long)limits.overBudget);
+    report.Integer("maxDeferNs", limits.maxDefer);
+    report.Bool("renderAll", options.replay.renderAll);
+    report.Integer("triggers", pipeline.TriggerCount());
+    report.Bool("template", pipeline.HasTemplate());
+    report.Integer("hardwareThreads", std::thread::hardware_concurrency());
+    report.EndObject();
+
+    if (warmStart) {
+        report.BeginObject("startup");
+        report.String("snapshot", snapshotStatusNames[snapshotStatus]);
+        report.Integer("snapshotBytes", snapshotBytes);
+        report.Integer("restoredVerdicts", restoredVerdicts);
+        report.Number("triggersReadySeconds", (triggersReady - startupStart) / 1e9);
+        report.Number("firstRecordSeconds", (firstRecordAt - startupStart) / 1e9);
+        report.Number("firstPassSeconds", (firstPassAt - triggersReady) / 1e9);
+        report.Integer("firstPassMatches", startupStats[0].matches);
+        report.EndObject();
+    }
+
+    report.BeginObject("corpus");
+    report.String("path", options.corpus);
+    report.Integer("segments", corpusStats.segments);
+    report.Integer("incompleteSegments", corpusStats.incompleteSegments);
+    report.Integer("files", corpusStats.files);
+    report.Integer("records", corpusStats.records);
+    report.Integer("html", corpusStats.html);
+    report.Integer("json", corpusStats.json);
+    report.Integer("skipped", corpusStats.skipped);
+    report.Integer("bodyBytes", corpusStats.bodyBytes);
+    report.Number("loadSeconds", loadSeconds);
+    report.EndObject();
+
+    report.Number("elapsedSeconds", elapsed);
+
+    // Of the whole process, so it includes the shared pool's threads.
+    report.Number("cpuSeconds", cpuSeconds);
+
+    report.BeginObject("throughput");
+    report.Number("recordsPerSecond", elapsed > 0 ? total.records / elapsed : 0);
+    report.Number("bytesPerSecond", elapsed > 0 ? total.bytes / elapsed : 0);
+    report.EndObject();
+
+    report.BeginObject("results");
+    report.Integer("records", total.records);
+    report.Integer("bytes", total.bytes);
+    report.Integer("matches", total.matches);
+    report.Integer("renderedBytes", total.renderedBytes);
+    report.Integer("truncated", total.truncated);
+    report.Integer("refused", total.refused);
+    report.Number("completeRatio", total.records > 0 ? (double)(total.records - total.truncated - total.refused) / total.records : 0);
+
+    // Against full scans of every record, so matches the scheduler's limits lost show up as a
+    // recall below 1.
+    report.Integer("expectedMatches", expectedMatches);
+    report.Number("matchRecall", expectedMatches > 0 ? (double)total.matches / expectedMatches : 1);
+    report.EndObject();
+
+    // TOTAL of the HTML records alone, which is how long a page takes.
+    report.BeginObject("documents");
+    report.Integer("count", total.documents.count);
+
+    for (size_t p = 0; p < PERCENTILE_COUNT; p++) {
+        report.Integer(percentileKeys[p], HotPathMetrics::ValueAtPercentile(total.documents, percentiles[p]));
+    }
+
+    report.Integer("maxNs", total.documents.maxNanoseconds);
+    report.EndObject();
+
+    report.BeginObject("stages");
+
+    for (int s = 0; s < REPLAY_STAGE_COUNT; s++) {
+        const ReplayStageStats& stage = total.stages[s];
+
+        report.BeginObject(ReplayPipeline::StageName(s));
+        report.Integer("count", stage.latency.count);
+        report.Number("meanNs", stage.latency.count > 0 ? (double)stage.latency.totalNanoseconds / stage.latency.count : 0);
+
+        for (size_t p = 0; p < PERCENTILE_COUNT; p++) {
+            report.Integer(percentileKeys[p], HotPathMetrics::ValueAtPercentile(stage.latency, percentiles[p]));
+        }
+
+        report.Integer("maxNs", stage.latency.maxNanoseconds);
+        report.Integer("allocations", stage.allocations);
+        report.Integer("allocatedBytes", stage.allocatedBytes);
+        report.Number("allocationsPerCall", stage.latency.count > 0 ? (double)stage.allocations / stage.latency.count : 0);
+        report.EndObject();
+    }
+
+    report.EndObject();
+
+    // From every thread that scanned, including the shared pool's, while the measured passes ran.
+    report.BeginObject("scanAllocations");
+    report.Integer("scans", scanAfter.scans - scanBefore.scans);
+    report.Integer("arenaAllocations", scanAfter.arenaAllocations - scanBefore.arenaAllocations);
+    report.Integer("arenaBytes", scanAfter.arenaBytes - scanBefore.arenaBytes);
+    report.Integer("heapAllocations", scanAfter.heapAllocations - scanBefore.heapAllocations);
+    report.Integer("oversizedScans", scanAfter.oversizedScans - scanBefore.oversizedScans);
+    report.EndObject();
+
+    VerdictCacheStats cacheStats;
+    memset(&cacheStats, 0, sizeof(cacheStats));
+
+    if (pipeline.Cache() != NULL) {
+        pipeline.Cache()->GetStats(&cacheStats);
+
+        report.BeginObject("verdictCache");
+        report.Integer("capacity", cacheStats.capacity);
+        report.Integer("memoryBytes", cacheStats.memoryBytes);
+        report.Integer("entries", cacheStats.entries);
+        report.Integer("lookups", cacheStats.lookups);
+        report.Integer("hits", cacheStats.hits);
+        report.Number("hitRatio", cacheStats.lookups > 0 ? (double)cacheStats.hits / cacheStats.lookups : 0);
+        report.Integer("inserts", cacheStats.inserts);
+        report.Integer("evictions", cacheStats.evictions);
+        report.Integer("ghostHits", cacheStats.ghostHits);
+        report.Integer("bytesSkipped", cacheStats.bytesSkipped);
+        report.Number("bytesSkippedRatio", total.bytes > 0 ? (double)cacheStats.bytesSkipped / total.bytes : 0);
+        report.EndObject();
+    }
+
+    ScanSchedulerStats schedulerStats;
+    memset(&schedulerStats, 0, sizeof(schedulerStats));
+
+    if (pipeline.Scheduler() != NULL) {
+        pipeline.Scheduler()->GetStats(&schedulerStats);
+
+        report.BeginObject("scanScheduler");
+        report.Integer("bodies", schedulerStats.bodies);
+        report.Integer("parts", schedulerStats.parts);
+        report.Integer("clean", schedulerStats.clean);
+        report.Integer("matched", schedulerStats.matched);
+        report.Integer("truncated", schedulerStats.truncated);
+        report.Integer("refused", schedulerStats.refused);
+        report.Integer("overRequestBudget", schedulerStats.overRequestBudget);
+        report.Integer("overGlobalBudget", schedulerStats.overGlobalBudget);
+        report.Integer("overQueueLimit", schedulerStats.overQueueLimit);
+        report.Integer("overWaitLimit", schedulerStats.overWaitLimit);
+        report.Integer("deferred", schedulerStats.deferred);
+        report.Integer("deferExpired", schedulerStats.deferExpired);
+        report.Integer("maxQueued", schedulerStats.maxQueued);
+        report.Number("meanWaitNs", schedulerStats.parts > 0 ? (double)schedulerStats.waitNanoseconds / schedulerStats.parts : 0);
+        report.Integer("maxWaitNs", schedulerStats.maxWaitNanoseconds);
+        report.Integer("scanNs", schedulerStats.scanNanoseconds);
+        report.EndObject();
+    }
+
+    // Saved last, like the service does when it shuts down, with the verdicts the measured passes
+    // cached.
+    bool snapshotSaved = false;
+
+    if (warmStart) {
+        unsigned long long saveStart = ReplayPipeline::Now();
+        snapshotSaved = pipeline.SaveSnapshot(options.snapshot, policy, options.snapshotVerdicts);
+
+        report.BeginObject("snapshotSave");
+        report.Bool("saved", snapshotSaved);
+        report.Number("seconds", (ReplayPipeline::Now() - saveStart) / 1e9);
+        report.EndObject();
+    }
+
+    // Last, so that saving the snapshot counts too.
+    bool overMemoryLimit = false;
+
+    report.BeginObject("memory");
+    report.Integer("relievedTags", (unsigned long long)relievedTags);
+
+    for (int tag = 0; tag < MEMORY_TAG_COUNT; tag++) {
+        MemoryTagStats stats;
+        MemoryBudget::GetStats(tag, &stats);
+
+        // Memory a subsystem can't do without, like a thread's scan arena, is charged past the limit
+        // and counted. Going over without any of it means a charge that should have been refused wasn't.
+        bool over = stats.hardLimit != 0 && stats.peakBytes > stats.hardLimit;
+        if (over && stats.forcedOver == 0) {
+            overMemoryLimit = true;
+            fprintf(stderr, "over the memory limit: %s peaked at %llu bytes, limit %llu\n", MemoryBudget::TagName(tag), stats.peakBytes, stats.hardLimit);
+        }
+        else if (over) {
+            fprintf(stderr, "warning: the %s limit of %llu bytes is too tight for memory it can't do without\n", MemoryBudget::TagName(tag), stats.hardLimit);
+        }
+
+        report.BeginObject(MemoryBudget::TagName(tag));
+        report.Integer("liveBytes", stats.liveBytes);
+        report.Integer("peakBytes", stats.peakBytes);
+        report.Integer("softLimit", stats.softLimit);
+        report.Integer("hardLimit", stats.hardLimit);
+        report.Integer("refused", stats.refused);
+        report.Integer("forcedOver", stats.forcedOver);
+        report.Integer("compactions", stats.compactions);
+        report.Bool("overHardLimit", over);
+        report.EndObject();
+    }
+
+    report.EndObject();
+
+    int regressions = 0;
+
+    if (!options.baseline.empty()) {
+        std::string baselineText;
+        std::map<std::string, double> baseline;
+
+        if (!readText(options.baseline, baselineText) || !ReadJsonNumbers(baselineText, baseline)) {
+            fprintf(stderr, "Could not read a report from %s.\n", options.baseline.c_str());
+            return 1;
+        }
+
+        // Compare against this run's numbers as they'll appear in the file.
+        JsonWriter sofar = report;
+        sofar.EndObject();
+
+        std::map<std::string, double> current;
+        ReadJsonNumbers(sofar.Text(), current);
+
+        regressions = compareWithBaseline(report, current, baseline, options);
+    }
+
+    report.EndObject();
+
+    if (options.output.empty()) {
+        fputs(report.Text().c_str(), stdout);
+    }
+    else {
+        FILE* file = fopen(options.output.c_str(), "wb");
+
+        if (file == NULL || fwrite(report.Text().data(), 1, report.Text().size(), file) != report.Text().size()) {
+            fprintf(stderr, "Could not write %s.\n", options.output.c_str());
+
+            if (file != NULL) {
+                fclose(file);
+            }
+
+            return 1;
+        }
+
+        fclose(file);
+    }
+
+    fprintf(stderr, "%llu records, %.1f MB in %.3f s (%.3f s CPU): %.0f records/s, %.1f MB/s, %llu matched\n",
+        total.records, total.bytes / 1e6, elapsed, cpuSeconds, elapsed > 0 ? total.records / elapsed : 0, elapsed > 0 ? total.bytes / 1e6 / elapsed : 0, total.matches);
+
+    if (cacheStats.lookups > 0) {
+        fprintf(stderr, "verdict cache: %.1f%% of %llu lookups hit, %.1f MB not scanned\n",
+            cacheStats.hits * 100.0 / cacheStats.lookups, cacheStats.lookups, cacheStats.bytesSkipped / 1e6);
+    }
+
+    if (warmStart) {
+        fprintf(stderr, "startup: snapshot %s, triggers ready in %.1f ms, first record in %.1f ms%s\n",
+            snapshotStatusNames[snapshotStatus], (triggersReady - startupStart) / 1e6, (firstRecordAt - startupStart) / 1e6,
+            snapshotSaved ? "" : ", could not save the snapshot");
+    }
+
+    if (schedulerStats.bodies > 0) {
+        fprintf(stderr, "scan scheduler: page p99 %.2f ms, %llu truncated, %llu refused, %llu of %llu expected matches, longest wait %.2f ms\n",
+            HotPathMetrics::ValueAtPercentile(total.documents, 99) / 1e6, total.truncated, total.refused, total.matches, expectedMatches,
+            schedulerStats.maxWaitNanoseconds / 1e6);
+    }
+
+    if (regressions > 0) {
+        return EXIT_REGRESSED;
+    }
+
+    return overMemoryLimit ? EXIT_OVER_MEMORY_LIMIT : 0;
+}
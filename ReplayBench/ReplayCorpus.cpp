@@ -0,0 +1,598 @@
+#include "ReplayCorpus.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#if defined(_MSC_VER)
+#include <Windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+// See CaptureFormat in DiagnosticsCollector.
+#define SEGMENT_MAGIC 0x50414356
+#define BLOCK_MAGIC 0x4B4C4256
+#define FOOTER_MAGIC 0x54465456
+#define FORMAT_VERSION 1
+#define SEGMENT_HEADER_SIZE 8
+#define BLOCK_HEADER_SIZE 16
+#define SEGMENT_EXTENSION ".cvcap"
+
+#define LZ4_MIN_MATCH 4
+
+namespace {
+    // Reads the fields BinaryWriter wrote, little endian. Any read past the end fails the reader
+    // for good, so a record can be parsed without checking every field.
+    class FieldReader {
+    public:
+        FieldReader(const unsigned char* data, size_t length) : data(data), length(length), position(0), failed(false) {
+        }
+
+        bool Failed() const { return failed; }
+
+        void Fail() { failed = true; }
+
+        unsigned int Byte() {
+            if (!has(1)) {
+                return 0;
+            }
+
+            return data[position++];
+        }
+
+        int Int32() {
+            if (!has(4)) {
+                return 0;
+            }
+
+            unsigned int value = (unsigned int)data[position] | ((unsigned int)data[position + 1] << 8) |
+                ((unsigned int)data[position + 2] << 16) | ((unsigned int)data[position + 3] << 24);
+            position += 4;
+            return (int)value;
+        }
+
+        void Skip(size_t count) {
+            if (has(count)) {
+                position += count;
+            }
+        }
+
+        // A string prefixed with its UTF-8 length as a 7-bit encoded integer.
+        bool String(std::string* value) {
+            unsigned int count = 0;
+
+            for (int shift = 0; ; shift += 7) {
+                if (shift > 28) {
+                    failed = true;
+                    return false;
+                }
+
+                unsigned int part = Byte();
+                if (failed) {
+                    return false;
+                }
+
+                count |= (part & 0x7F) << shift;
+
+                if ((part & 0x80) == 0) {
+                    break;
+                }
+            }
+
+            if (!has(count)) {
+                return false;
+            }
+
+            if (value != NULL) {
+                value->assign(reinterpret_cast<const char*>(data + position), count);
+            }
+
+            position += count;
+            return true;
+        }
+
+        // A string behind a flag saying whether it is null.
+        void OptionalString(std::string* value) {
+            if (Byte() != 0) {
+                String(value);
+            }
+        }
+
+        // Length plus one, so that zero means null.
+        void Bytes(std::vector<unsigned char>* value) {
+            int count = Int32();
+
+            if (count <= 0 || !has((size_t)count - 1)) {
+                return;
+            }
+
+            if (value != NULL) {
+                value->assign(data + position, data + position + count - 1);
+            }
+
+            position += (size_t)count - 1;
+        }
+
+    private:
+        bool has(size_t count) {
+            if (failed || count > length - position) {
+                failed = true;
+                return false;
+            }
+
+            return true;
+        }
+
+        const unsigned char* data;
+        size_t length;
+        size_t position;
+        bool failed;
+    };
+}
+
+static unsigned int readUInt32(const unsigned char* data) {
+    return (unsigned int)data[0] | ((unsigned int)data[1] << 8) | ((unsigned int)data[2] << 16) | ((unsigned int)data[3] << 24);
+}
+
+static void lowercase(std::string& text) {
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] >= 'A' && text[i] <= 'Z') {
+            text[i] += 'a' - 'A';
+        }
+    }
+}
+
+static bool endsWith(const std::string& text, const char* suffix) {
+    size_t length = strlen(suffix);
+
+    if (text.size() < length) {
+        return false;
+    }
+
+    for (size_t i = 0; i < length; i++) {
+        char c = text[text.size() - length + i];
+
+        if (c >= 'A' && c <= 'Z') {
+            c += 'a' - 'A';
+        }
+
+        if (c != suffix[i]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool readFile(const std::string& path, std::vector<unsigned char>& contents) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == NULL) {
+        return false;
+    }
+
+    contents.clear();
+
+    unsigned char buffer[64 * 1024];
+    size_t read;
+
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        contents.insert(contents.end(), buffer, buffer + read);
+    }
+
+    bool ok = ferror(file) == 0;
+    fclose(file);
+
+    return ok;
+}
+
+// Files under path, recursively, sorted so that segments replay in the order they were written.
+// Returns false if path isn't a directory.
+static bool listFiles(const std::string& path, std::vector<std::string>& files) {
+#if defined(_MSC_VER)
+    WIN32_FIND_DATAA found;
+    HANDLE search = FindFirstFileA((path + "\\*").c_str(), &found);
+
+    if (search == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    std::vector<std::string> names;
+
+    do {
+        if (strcmp(found.cFileName, ".") != 0 && strcmp(found.cFileName, "..") != 0) {
+            names.push_back(found.cFileName);
+        }
+    } while (FindNextFileA(search, &found));
+
+    FindClose(search);
+
+    std::sort(names.begin(), names.end());
+
+    for (size_t i = 0; i < names.size(); i++) {
+        std::string child = path + "\\" + names[i];
+
+        if (!listFiles(child, files)) {
+            files.push_back(child);
+        }
+    }
+#else
+    DIR* directory = opendir(path.c_str());
+
+    if (directory == NULL) {
+        return false;
+    }
+
+    std::vector<std::string> names;
+    struct dirent* entry;
+
+    while ((entry = readdir(directory)) != NULL) {
+        if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) {
+            names.push_back(entry->d_name);
+        }
+    }
+
+    closedir(directory);
+
+    std::sort(names.begin(), names.end());
+
+    for (size_t i = 0; i < names.size(); i++) {
+        std::string child = path + "/" + names[i];
+
+        struct stat info;
+        if (stat(child.c_str(), &info) != 0) {
+            continue;
+        }
+
+        if (S_ISDIR(info.st_mode)) {
+            listFiles(child, files);
+        }
+        else if (S_ISREG(info.st_mode)) {
+            files.push_back(child);
+        }
+    }
+#endif
+
+    return true;
+}
+
+// Reads a header block stored as dictionary ids, picking out the value of its Content-Type line.
+static bool readContentType(FieldReader& reader, const std::vector<std::string>& dictionary, std::string* contentType) {
+    int count = reader.Int32();
+
+    for (int i = 0; i < count && !reader.Failed(); i++) {
+        int id = reader.Int32();
+
+        if (id < 0 || (size_t)id >= dictionary.size()) {
+            reader.Fail();
+            return false;
+        }
+
+        const std::string& line = dictionary[(size_t)id];
+
+        if (line.size() > 13 && contentType->empty()) {
+            std::string name = line.substr(0, 13);
+            lowercase(name);
+
+            if (name == "content-type:") {
+                size_t begin = line.find_first_not_of(" \t", 13);
+                size_t end = line.find_last_not_of(" \t\r");
+
+                if (begin != std::string::npos && end >= begin) {
+                    contentType->assign(line, begin, end - begin + 1);
+                }
+            }
+        }
+    }
+
+    return !reader.Failed();
+}
+
+static bool skipHeaders(FieldReader& reader) {
+    int count = reader.Int32();
+
+    for (int i = 0; i < count && !reader.Failed(); i++) {
+        reader.Int32();
+    }
+
+    return !reader.Failed();
+}
+
+ReplayCorpus::ReplayCorpus() {
+    memset(&stats, 0, sizeof(stats));
+}
+
+bool ReplayCorpus::Load(const std::string& path, std::string* error) {
+    std::vector<std::string> files;
+
+    if (!listFiles(path, files)) {
+        files.push_back(path);
+    }
+
+    for (size_t i = 0; i < files.size(); i++) {
+        bool loaded = endsWith(files[i], SEGMENT_EXTENSION) ? loadSegment(files[i], error) : loadBody(files[i], error);
+
+        if (!loaded) {
+            return false;
+        }
+    }
+
+    if (records.empty()) {
+        *error = "Found nothing to replay in " + path + ".";
+        return false;
+    }
+
+    return true;
+}
+
+bool ReplayCorpus::loadSegment(const std::string& path, std::string* error) {
+    std::vector<unsigned char> file;
+
+    if (!readFile(path, file)) {
+        *error = "Could not read " + path + ".";
+        return false;
+    }
+
+    if (file.size() < SEGMENT_HEADER_SIZE || readUInt32(file.data()) != SEGMENT_MAGIC) {
+        *error = path + " is not a diagnostics capture segment.";
+        return false;
+    }
+
+    if (readUInt32(file.data() + 4) != FORMAT_VERSION) {
+        *error = path + " has a capture format version this replay cannot read.";
+        return false;
+    }
+
+    stats.segments++;
+
+    std::vector<std::string> dictionary;
+    std::vector<unsigned char> raw;
+
+    size_t offset = SEGMENT_HEADER_SIZE;
+    bool complete = false;
+
+    while (file.size() - offset >= BLOCK_HEADER_SIZE) {
+        unsigned int magic = readUInt32(file.data() + offset);
+
+        if (magic == FOOTER_MAGIC) {
+            complete = true;
+            break;
+        }
+
+        size_t compressedLength = readUInt32(file.data() + offset + 4);
+        size_t rawLength = readUInt32(file.data() + offset + 8);
+
+        if (magic != BLOCK_MAGIC || compressedLength > 0x7FFFFFFF || rawLength > 0x7FFFFFFF ||
+            compressedLength > file.size() - offset - BLOCK_HEADER_SIZE) {
+            break;
+        }
+
+        raw.resize(rawLength);
+        if (!DecompressLz4(file.data() + offset + BLOCK_HEADER_SIZE, compressedLength, raw.data(), rawLength)) {
+            break;
+        }
+
+        FieldReader reader(raw.data(), raw.size());
+
+        size_t dictionaryCount = dictionary.size();
+
+        int added = reader.Int32();
+        for (int i = 0; i < added && !reader.Failed(); i++) {
+            dictionary.push_back(std::string());
+            reader.String(&dictionary.back());
+        }
+
+        int count = reader.Int32();
+        std::vector<ReplayRecord> block;
+
+        for (int i = 0; i < count && !reader.Failed(); i++) {
+            ReplayRecord record;
+            std::string clientUri;
+            std::string serverUri;
+            std::string requestUri;
+
+            reader.Byte();
+            reader.Int32();
+            reader.Skip(16);
+
+            int hostId = reader.Int32();
+            if (hostId >= 0 && (size_t)hostId < dictionary.size()) {
+                record.host = dictionary[(size_t)hostId];
+            }
+
+            reader.OptionalString(&clientUri);
+            reader.OptionalString(&serverUri);
+            reader.OptionalString(&requestUri);
+
+            record.uri = !serverUri.empty() ? serverUri : !clientUri.empty() ? clientUri : requestUri;
+
+            if (!skipHeaders(reader) || !skipHeaders(reader) || !readContentType(reader, dictionary, &record.contentType)) {
+                break;
+            }
+
+            reader.Bytes(NULL);
+            reader.Bytes(NULL);
+            reader.Bytes(&record.body);
+
+            if (!reader.Failed()) {
+                record.content = ClassifyContentType(record.contentType);
+                block.push_back(record);
+            }
+        }
+
+        if (reader.Failed()) {
+            // Where the writer was cut off. Forget whatever this block added.
+            dictionary.resize(dictionaryCount);
+            break;
+        }
+
+        for (size_t i = 0; i < block.size(); i++) {
+            add(block[i]);
+        }
+
+        offset += BLOCK_HEADER_SIZE + compressedLength;
+    }
+
+    if (!complete) {
+        stats.incompleteSegments++;
+    }
+
+    return true;
+}
+
+bool ReplayCorpus::loadBody(const std::string& path, std::string* error) {
+    ReplayRecord record;
+
+    if (!readFile(path, record.body)) {
+        *error = "Could not read " + path + ".";
+        return false;
+    }
+
+    stats.files++;
+
+    if (endsWith(path, ".json")) {
+        record.contentType = "application/json";
+    }
+    else if (endsWith(path, ".html") || endsWith(path, ".htm")) {
+        record.contentType = "text/html";
+    }
+    else {
+        size_t first = 0;
+        while (first < record.body.size() && (record.body[first] == ' ' || record.body[first] == '\t' || record.body[first] == '\r' || record.body[first] == '\n')) {
+            first++;
+        }
+
+        bool looksLikeJson = first < record.body.size() && (record.body[first] == '{' || record.body[first] == '[');
+
+        // Bodies saved without a type are scanned raw, the way HTML is.
+        record.contentType = looksLikeJson ? "application/json" : "text/html";
+    }
+
+    record.uri = path;
+    record.content = ClassifyContentType(record.contentType);
+
+    add(record);
+    return true;
+}
+
+void ReplayCorpus::add(ReplayRecord& record) {
+    stats.records++;
+
+    if (record.body.empty()) {
+        record.content = REPLAY_CONTENT_OTHER;
+    }
+
+    switch (record.content) {
+    case REPLAY_CONTENT_HTML:
+        stats.html++;
+        break;
+
+    case REPLAY_CONTENT_JSON:
+        stats.json++;
+        break;
+
+    default:
+        // Kept out of the corpus: the filter never looks inside them.
+        stats.skipped++;
+        return;
+    }
+
+    stats.bodyBytes += record.body.size();
+
+    records.push_back(ReplayRecord());
+    records.back().host.swap(record.host);
+    records.back().uri.swap(record.uri);
+    records.back().contentType.swap(record.contentType);
+    records.back().content = record.content;
+    records.back().body.swap(record.body);
+}
+
+bool ReplayCorpus::DecompressLz4(const unsigned char* input, size_t inputLength, unsigned char* output, size_t outputLength) {
+    size_t in = 0;
+    size_t out = 0;
+
+    while (in < inputLength) {
+        unsigned int token = input[in++];
+
+        size_t literalLength = token >> 4;
+        if (literalLength == 15) {
+            unsigned int part;
+
+            do {
+                if (in == inputLength) {
+                    return false;
+                }
+
+                part = input[in++];
+                literalLength += part;
+            } while (part == 255);
+        }
+
+        if (literalLength > inputLength - in || literalLength > outputLength - out) {
+            return false;
+        }
+
+        memcpy(output + out, input + in, literalLength);
+        in += literalLength;
+        out += literalLength;
+
+        if (in == inputLength) {
+            // The last sequence has no match.
+            break;
+        }
+
+        if (inputLength - in < 2) {
+            return false;
+        }
+
+        size_t offset = (size_t)input[in] | ((size_t)input[in + 1] << 8);
+        in += 2;
+
+        size_t matchLength = token & 0xF;
+        if (matchLength == 15) {
+            unsigned int part;
+
+            do {
+                if (in == inputLength) {
+                    return false;
+                }
+
+                part = input[in++];
+                matchLength += part;
+            } while (part == 255);
+        }
+
+        matchLength += LZ4_MIN_MATCH;
+
+        if (offset == 0 || offset > out || matchLength > outputLength - out) {
+            return false;
+        }
+
+        // Overlapping matches are how runs are encoded, so this has to go byte by byte.
+        const unsigned char* match = output + out - offset;
+        for (size_t i = 0; i < matchLength; i++) {
+            output[out + i] = match[i];
+        }
+
+        out += matchLength;
+    }
+
+    return out == outputLength;
+}
+
+int ReplayCorpus::ClassifyContentType(const std::string& contentType) {
+    std::string lower = contentType;
+    lowercase(lower);
+
+    if (lower.find("html") != std::string::npos) {
+        return REPLAY_CONTENT_HTML;
+    }
+
+    // JSON that claims to be HTML as well is scanned as HTML, like OnClassifyContent does.
+    if (lower.find("json") != std::string::npos) {
+        return REPLAY_CONTENT_JSON;
+    }
+
+    return REPLAY_CONTENT_OTHER;
+}
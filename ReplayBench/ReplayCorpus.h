@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// How the filter treats a response body. Mirrors the content type checks in SiteFiltering.
+#define REPLAY_CONTENT_OTHER 0
+#define REPLAY_CONTENT_HTML 1
+#define REPLAY_CONTENT_JSON 2
+
+typedef struct ReplayRecord {
+    std::string host;
+    std::string uri;
+    std::string contentType;
+
+    int content;
+    std::vector<unsigned char> body;
+} ReplayRecord;
+
+typedef struct ReplayCorpusStats {
+    size_t segments;
+    size_t files;
+
+    // Records read, including the ones the filter would not scan.
+    size_t records;
+    size_t html;
+    size_t json;
+    size_t skipped;
+
+    // Segments the writer never closed, read up to their last whole block.
+    size_t incompleteSegments;
+
+    unsigned long long bodyBytes;
+} ReplayCorpusStats;
+
+/// Response bodies to replay, loaded from a DiagnosticsCollector capture directory or from a
+/// directory of saved bodies.
+///
+/// Capture segments (*.cvcap) are read block by block, the same way CaptureSegment rebuilds the
+/// index of a segment that was never closed, so a capture that is still being written can be
+/// replayed too. SQLite files written by export-diag or older collectors have to be converted with
+/// import-diag first.
+///
+/// Anything in a directory that isn't a capture segment is taken as one response body. Its type
+/// comes from the extension (.json, .html, .htm) or failing that from its first character.
+class ReplayCorpus {
+public:
+    ReplayCorpus();
+
+    /// Loads every segment or body under path, which may also name a single segment. Returns false
+    /// with a description in error if nothing could be read.
+    bool Load(const std::string& path, std::string* error);
+
+    const std::vector<ReplayRecord>& Records() const { return records; }
+    const ReplayCorpusStats& Stats() const { return stats; }
+
+    /// Decompresses an LZ4 block into exactly outputLength bytes. Returns false if the block is
+    /// malformed or decompresses to some other length.
+    static bool DecompressLz4(const unsigned char* input, size_t inputLength, unsigned char* output, size_t outputLength);
+
+    /// REPLAY_CONTENT_* for a Content-Type header value.
+    static int ClassifyContentType(const std::string& contentType);
+
+private:
+    bool loadSegment(const std::string& path, std::string* error);
+    bool loadBody(const std::string& path, std::string* error);
+    void add(ReplayRecord& record);
+
+    std::vector<ReplayRecord> records;
+    ReplayCorpusStats stats;
+};
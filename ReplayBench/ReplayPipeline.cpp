@@ -0,0 +1,366 @@
+#include "ReplayPipeline.h"
+
+#include "AllocationCounter.h"
+#include "ScanContext.h"
+#include "WorkPool.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+// Slot names in the order Templates passes them to the compiled BlockedPage.html.
+static const char* const blockedPageSlots[] = {
+    "url_text", "friendly_url_text", "message", "matching_category", "other_categories", "showUnblockRequestButton",
+    "passcodeSetupUrl", "unblockRequest", "isRelaxedPolicy", "isRelaxedPolicyPasscodeRequired", "serverPort"
+};
+
+#define BLOCKED_PAGE_SLOT_COUNT (sizeof(blockedPageSlots) / sizeof(blockedPageSlots[0]))
+
+static const char* const stageNames[REPLAY_STAGE_COUNT] = { "extract", "triggers", "render", "total" };
+
+static const char blockMessage[] = "was blocked because it was in the following category:";
+static const char blockCategory[] = "offensive text";
+static const char serverPort[] = "8081";
+
+static unsigned long long now() {
+    return (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static PageValue textValue(const unsigned char* text, size_t length) {
+    PageValue value;
+    memset(&value, 0, sizeof(value));
+
+    value.text = text;
+    value.length = length;
+    value.truthy = length > 0;
+    return value;
+}
+
+static PageValue textValue(const std::string& text) {
+    return textValue(reinterpret_cast<const unsigned char*>(text.data()), text.size());
+}
+
+static PageValue flagValue(bool truthy) {
+    PageValue value;
+    memset(&value, 0, sizeof(value));
+
+    value.truthy = truthy;
+    return value;
+}
+
+namespace {
+    // Charges a stage with the time and allocations between its construction and End().
+    class StageTimer {
+    public:
+        explicit StageTimer(ReplayStageStats& stage) : stage(stage) {
+            allocations = CurrentThreadAllocations();
+            start = now();
+        }
+
+        unsigned long long End() {
+            unsigned long long elapsed = now() - start;
+            AllocationCount after = CurrentThreadAllocations();
+
+            ReplayPipeline::RecordSample(stage.latency, elapsed);
+            stage.allocations += after.allocations - allocations.allocations;
+            stage.allocatedBytes += after.bytes - allocations.bytes;
+            return elapsed;
+        }
+
+    private:
+        ReplayStageStats& stage;
+        AllocationCount allocations;
+        unsigned long long start;
+    };
+}
+
+ReplayPipeline::ReplayPipeline() : hasTemplate(false), cache(NULL), scheduler(NULL) {
+    memset(&options, 0, sizeof(options));
+}
+
+ReplayPipeline::~ReplayPipeline() {
+    delete cache;
+    delete scheduler;
+}
+
+bool ReplayPipeline::LoadTriggers(const std::string& path, short category, size_t* added, std::string* error) {
+    FILE* file = fopen(path.c_str(), "rb");
+
+    if (file == NULL) {
+        *error = "Could not read " + path + ".";
+        return false;
+    }
+
+    *added = 0;
+
+    std::string line;
+    int c;
+
+    do {
+        c = fgetc(file);
+
+        if (c == '\n' || c == EOF) {
+            if (!line.empty() && triggers.AddTrigger(reinterpret_cast<const unsigned char*>(line.data()), line.size(), category)) {
+                (*added)++;
+            }
+
+            line.clear();
+        }
+        else if (c != '\r') {
+            line.push_back((char)c);
+        }
+    } while (c != EOF);
+
+    fclose(file);
+    return true;
+}
+
+bool ReplayPipeline::LoadTemplate(const std::string& path, std::string* error) {
+    FILE* file = fopen(path.c_str(), "rb");
+
+    if (file == NULL) {
+        *error = "Could not read " + path + ".";
+        return false;
+    }
+
+    std::vector<unsigned char> source;
+    unsigned char buffer[16 * 1024];
+    size_t read;
+
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        source.insert(source.end(), buffer, buffer + read);
+    }
+
+    fclose(file);
+
+    const char* compileError = NULL;
+
+    if (!page.Compile(source.data(), source.size(), blockedPageSlots, BLOCKED_PAGE_SLOT_COUNT, &compileError)) {
+        *error = path + ": " + compileError;
+        return false;
+    }
+
+    hasTemplate = true;
+    return true;
+}
+
+void ReplayPipeline::Configure(const ReplayOptions& options) {
+    this->options = options;
+
+    delete cache;
+    cache = options.verdictCacheSize > 0 ? new VerdictCache(options.verdictCacheSize, options.verdictChunkSize) : NULL;
+
+    delete scheduler;
+    scheduler = options.scanLimits.slots > 0 ? new ScanScheduler(options.scanLimits) : NULL;
+
+    enableCategories();
+}
+
+int ReplayPipeline::RestoreSnapshot(const std::string& path, const ContentHash& policy, size_t* verdicts, size_t* fileLength) {
+    *verdicts = 0;
+    *fileLength = 0;
+
+    WarmStartSnapshot snapshot;
+    int status = snapshot.Open(path.c_str(), policy);
+
+    if (status != WARM_START_LOADED) {
+        return status;
+    }
+
+    *fileLength = snapshot.FileLength();
+
+    status = triggers.Restore(snapshot);
+    enableCategories();
+
+    if (status != WARM_START_LOADED) {
+        return status;
+    }
+
+    if (cache != NULL) {
+        *verdicts = cache->Restore(snapshot);
+    }
+
+    return WARM_START_LOADED;
+}
+
+bool ReplayPipeline::SaveSnapshot(const std::string& path, const ContentHash& policy, size_t maxVerdicts) const {
+    // Same as the service: an index the memory budget cut short isn't saved as if it were whole.
+    if (triggers.RefusedTriggers() > 0) {
+        return false;
+    }
+
+    WarmStartWriter writer;
+    triggers.Save(&writer);
+
+    if (cache != NULL && maxVerdicts > 0) {
+        cache->Save(&writer, maxVerdicts);
+    }
+
+    return writer.Write(path.c_str(), policy);
+}
+
+void ReplayPipeline::enableCategories() {
+    const std::vector<short>& categories = triggers.Categories();
+    short maxCategory = 0;
+
+    for (size_t i = 0; i < categories.size(); i++) {
+        if (categories[i] > maxCategory) {
+            maxCategory = categories[i];
+        }
+    }
+
+    enabled.assign((size_t)(maxCategory >> 3) + 1, 0);
+
+    for (size_t i = 0; i < categories.size(); i++) {
+        if (categories[i] >= 0) {
+            enabled[(size_t)(categories[i] >> 3)] |= (unsigned char)(1 << (categories[i] & 7));
+        }
+    }
+}
+
+void ReplayPipeline::Replay(const ReplayRecord& record, ReplayThreadStats* stats, unsigned long long arrived) const {
+    StageTimer total(stats->stages[REPLAY_STAGE_TOTAL]);
+
+    stats->records++;
+    stats->bytes += record.body.size();
+
+    // Everything below runs inside one scope, like TextTriggerIndex.ContainsTrigger.
+    ScanScope scope;
+
+    const unsigned char* text = record.body.data();
+    size_t length = record.body.size();
+
+    // With a cache, JSON goes through TriggerScanner::ScanJsonStrings, which only extracts the
+    // values of documents it hasn't seen, and with a scheduler extracting happens once the record
+    // is let in, so in both cases extracting is part of the triggers stage.
+    bool json = record.content == REPLAY_CONTENT_JSON;
+    bool document = record.content == REPLAY_CONTENT_HTML;
+    bool extractFirst = json && cache == NULL && scheduler == NULL;
+
+    if (extractFirst) {
+        StageTimer extract(stats->stages[REPLAY_STAGE_EXTRACT]);
+
+        const std::vector<unsigned char>& values = scope.Context().ExtractJson(text, length);
+        text = values.data();
+        length = values.size();
+
+        extract.End();
+    }
+
+    TriggerMatch match;
+    int outcome = SCAN_OUTCOME_CLEAN;
+
+    if (length > 0 && triggers.TriggerCount() > 0) {
+        StageTimer scan(stats->stages[REPLAY_STAGE_TRIGGERS]);
+        TriggerScanOptions triggerOptions = scanOptions();
+
+        if (scheduler != NULL) {
+            outcome = triggers.ScanScheduled(text, length, json, triggerOptions, scheduler, document ? SCAN_PRIORITY_DOCUMENT : SCAN_PRIORITY_SUBRESOURCE, &match);
+        }
+        else if (json && !extractFirst) {
+            outcome = triggers.ScanJsonStrings(text, length, triggerOptions, &match) ? SCAN_OUTCOME_MATCHED : SCAN_OUTCOME_CLEAN;
+        }
+        else {
+            outcome = triggers.Scan(text, length, triggerOptions, &match) ? SCAN_OUTCOME_MATCHED : SCAN_OUTCOME_CLEAN;
+        }
+
+        scan.End();
+    }
+
+    switch (outcome) {
+    case SCAN_OUTCOME_MATCHED:
+        stats->matches++;
+        break;
+
+    case SCAN_OUTCOME_TRUNCATED:
+        stats->truncated++;
+        break;
+
+    case SCAN_OUTCOME_REFUSED:
+        stats->refused++;
+        break;
+    }
+
+    // A refused record gets a block page, the same as one that matched.
+    bool blocked = outcome == SCAN_OUTCOME_MATCHED || outcome == SCAN_OUTCOME_REFUSED;
+
+    if (hasTemplate && (blocked || options.renderAll)) {
+        StageTimer render(stats->stages[REPLAY_STAGE_RENDER]);
+
+        PageScratch& scratch = PageTemplate::Scratch();
+        scratch.values.resize(BLOCKED_PAGE_SLOT_COUNT);
+
+        scratch.values[0] = textValue(record.uri);
+        scratch.values[1] = textValue(record.host);
+        scratch.values[2] = textValue(reinterpret_cast<const unsigned char*>(blockMessage), sizeof(blockMessage) - 1);
+        scratch.values[3] = textValue(reinterpret_cast<const unsigned char*>(blockCategory), sizeof(blockCategory) - 1);
+        scratch.values[4] = flagValue(false);
+        scratch.values[5] = flagValue(true);
+        scratch.values[6] = textValue(NULL, 0);
+        scratch.values[7] = textValue(record.uri);
+        scratch.values[8] = flagValue(false);
+        scratch.values[9] = flagValue(false);
+        scratch.values[10] = textValue(reinterpret_cast<const unsigned char*>(serverPort), sizeof(serverPort) - 1);
+
+        page.Render(scratch.values.data(), scratch.output);
+        stats->renderedBytes += scratch.output.size();
+
+        render.End();
+    }
+
+    unsigned long long elapsed = total.End();
+
+    if (document) {
+        RecordSample(stats->documents, arrived != 0 ? now() - arrived : elapsed);
+    }
+}
+
+bool ReplayPipeline::FullScanMatches(const ReplayRecord& record) const {
+    if (record.body.empty() || triggers.TriggerCount() == 0) {
+        return false;
+    }
+
+    ScanScope scope;
+
+    TriggerScanOptions triggerOptions = scanOptions();
+    triggerOptions.cache = NULL;
+
+    TriggerMatch match;
+
+    if (record.content == REPLAY_CONTENT_JSON) {
+        return triggers.ScanJsonStrings(record.body.data(), record.body.size(), triggerOptions, &match);
+    }
+
+    return triggers.Scan(record.body.data(), record.body.size(), triggerOptions, &match);
+}
+
+TriggerScanOptions ReplayPipeline::scanOptions() const {
+    TriggerScanOptions scan;
+    scan.enabledCategories = enabled.data();
+    scan.enabledCategoriesLength = enabled.size();
+    scan.maxPhraseWords = options.maxPhraseWords;
+    scan.parallelThreshold = options.parallelThreshold;
+    scan.chunkSize = options.chunkSize;
+    scan.pool = options.parallelThreshold > 0 ? WorkPool::Shared() : NULL;
+    scan.cache = cache;
+    return scan;
+}
+
+const char* ReplayPipeline::StageName(int stage) {
+    return stage >= 0 && stage < REPLAY_STAGE_COUNT ? stageNames[stage] : "unknown";
+}
+
+unsigned long long ReplayPipeline::Now() {
+    return now();
+}
+
+void ReplayPipeline::RecordSample(HotPathHistogram& histogram, unsigned long long nanoseconds) {
+    histogram.count++;
+    histogram.totalNanoseconds += nanoseconds;
+
+    if (nanoseconds > histogram.maxNanoseconds) {
+        histogram.maxNanoseconds = nanoseconds;
+    }
+
+    histogram.buckets[HotPathMetrics::BucketIndex(nanoseconds)]++;
+}
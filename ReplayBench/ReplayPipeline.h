@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "HotPathMetrics.h"
+#include "PageTemplate.h"
+#include "ReplayCorpus.h"
+#include "ScanScheduler.h"
+#include "TriggerScanner.h"
+#include "VerdictCache.h"
+#include "WarmStartSnapshot.h"
+
+// Stages a record goes through. TOTAL covers all of them, including the ones a record skips.
+#define REPLAY_STAGE_EXTRACT 0
+#define REPLAY_STAGE_TRIGGERS 1
+#define REPLAY_STAGE_RENDER 2
+#define REPLAY_STAGE_TOTAL 3
+#define REPLAY_STAGE_COUNT 4
+
+typedef struct ReplayStageStats {
+    HotPathHistogram latency;
+
+    // Made on the replaying thread while the stage ran.
+    unsigned long long allocations;
+    unsigned long long allocatedBytes;
+} ReplayStageStats;
+
+/// What one replaying thread measured. Threads keep their own and they are added up at the end,
+/// so recording never contends.
+typedef struct ReplayThreadStats {
+    ReplayStageStats stages[REPLAY_STAGE_COUNT];
+
+    // From arrival to the end of TOTAL for the records scanned as top-level pages, which is how
+    // long the user waits for a page.
+    HotPathHistogram documents;
+
+    unsigned long long records;
+    unsigned long long bytes;
+    unsigned long long matches;
+    unsigned long long renderedBytes;
+
+    // Records the scan scheduler cut short or refused.
+    unsigned long long truncated;
+    unsigned long long refused;
+} ReplayThreadStats;
+
+typedef struct ReplayOptions {
+    // Longest phrase to look for, in words. Anything below 1 means single words only.
+    int maxPhraseWords;
+
+    // As TextTriggerIndex.ParallelThreshold and ChunkSize. A zero threshold scans every body on
+    // the replaying thread.
+    size_t parallelThreshold;
+    size_t chunkSize;
+
+    // Renders a block page for every record, not only the ones a trigger matched, so the render
+    // stage gets the same number of samples on every corpus.
+    bool renderAll;
+
+    // As TextTriggerIndex.VerdictCacheSize. Zero scans every record in full.
+    size_t verdictCacheSize;
+    size_t verdictChunkSize;
+
+    // As TextTriggerIndex.SetScanLimits. No slots scans every record in full as it comes. HTML
+    // records are scheduled as top-level pages, JSON ones as what pages load.
+    ScanSchedulerLimits scanLimits;
+} ReplayOptions;
+
+/// The content classification path of SiteFiltering, minus the managed parts: JSON bodies have
+/// their string values extracted, the text is scanned for triggers, and a block page is rendered
+/// for a match.
+///
+/// The engines are the ones the service links, built from Filter.Native.Windows. Configure it,
+/// then call Replay() from any number of threads.
+class ReplayPipeline {
+public:
+    ReplayPipeline();
+    ~ReplayPipeline();
+
+    /// Adds every line of a trigger list under category. Lines with no words in them are skipped.
+    bool LoadTriggers(const std::string& path, short category, size_t* added, std::string* error);
+
+    /// Compiles a block page with the slots Templates passes to BlockedPage.html.
+    bool LoadTemplate(const std::string& path, std::string* error);
+
+    void Configure(const ReplayOptions& options);
+
+    /// Replaces the triggers with the ones in a snapshot SaveSnapshot() wrote for the same policy,
+    /// and adds its verdicts to the cache. Call after Configure(). Returns a WARM_START_*.
+    int RestoreSnapshot(const std::string& path, const ContentHash& policy, size_t* verdicts, size_t* fileLength);
+
+    /// Saves the triggers and up to maxVerdicts of the hottest cached verdicts, as the service does
+    /// when it shuts down.
+    bool SaveSnapshot(const std::string& path, const ContentHash& policy, size_t maxVerdicts) const;
+
+    /// Runs one record through every stage, adding the timings and allocations to stats. Records
+    /// that arrived earlier than they are replayed, as Now() had it, count that wait in documents.
+    void Replay(const ReplayRecord& record, ReplayThreadStats* stats, unsigned long long arrived = 0) const;
+
+    /// Whether a full scan of the record, with no scheduler, finds a trigger. For telling how many
+    /// matches the scheduler's limits cost.
+    bool FullScanMatches(const ReplayRecord& record) const;
+
+    size_t TriggerCount() const { return triggers.TriggerCount(); }
+    bool HasTemplate() const { return hasTemplate; }
+
+    // NULL unless Configure() was given a verdict cache size.
+    VerdictCache* Cache() const { return cache; }
+
+    // NULL unless Configure() was given scan slots.
+    ScanScheduler* Scheduler() const { return scheduler; }
+
+    static const char* StageName(int stage);
+
+    /// The clock stages are timed with, in nanoseconds.
+    static unsigned long long Now();
+
+    /// Adds one sample to a histogram laid out the way HotPathMetrics lays them out.
+    static void RecordSample(HotPathHistogram& histogram, unsigned long long nanoseconds);
+
+private:
+    ReplayPipeline(const ReplayPipeline&);
+    ReplayPipeline& operator=(const ReplayPipeline&);
+
+    TriggerScanOptions scanOptions() const;
+    void enableCategories();
+
+    TriggerScanner triggers;
+    PageTemplate page;
+    bool hasTemplate;
+
+    ReplayOptions options;
+    VerdictCache* cache;
+    ScanScheduler* scheduler;
+
+    // Every category that has triggers, as the bitmap TriggerScanOptions takes.
+    std::vector<unsigned char> enabled;
+};
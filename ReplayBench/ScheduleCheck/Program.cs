@@ -0,0 +1,230 @@
+/*
+* Copyright © 2019 Cloudveil Technology Inc.
+* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+using Filter.Platform.Common.Data.Models;
+using FilterProvider.Common.Util;
+using NodaTime;
+using System;
+using System.Diagnostics;
+
+namespace ScheduleCheck
+{
+    /// <summary>
+    /// Checks TimeRestrictionSchedule across DST changes in real tzdb zones, then measures what its queries cost.
+    /// Exits with 1 if any check fails.
+    /// </summary>
+    class Program
+    {
+        private static int checks = 0;
+        private static int failures = 0;
+
+        static int Main(string[] args)
+        {
+            DateTimeZone newYork = DateTimeZoneProviders.Tzdb["America/New_York"];
+            DateTimeZone lordHowe = DateTimeZoneProviders.Tzdb["Australia/Lord_Howe"];
+
+            springForward(newYork);
+            fallBack(newYork);
+            offsetCap(newYork);
+
+            // Every moment around the changes, with boundaries inside, at the edges of and away from the skipped and
+            // repeated hours.
+            sweep("New York spring, edge in the gap", everyDay(2.5m, 22m), newYork, Instant.FromUtc(2020, 3, 7, 12, 0), 48);
+            sweep("New York spring, edges at the gap", everyDay(2m, 3m), newYork, Instant.FromUtc(2020, 3, 7, 12, 0), 48);
+            sweep("New York fall, edge in the overlap", everyDay(1.5m, 22m), newYork, Instant.FromUtc(2020, 10, 31, 12, 0), 48);
+            sweep("New York fall, two ranges in the overlap", everyDay(0m, 1.25m, 1.75m, 24m), newYork, Instant.FromUtc(2020, 10, 31, 12, 0), 48);
+            sweep("Lord Howe, half hour shift", everyDay(1.75m, 2.25m), lordHowe, Instant.FromUtc(2020, 4, 4, 0, 0), 48);
+            sweep("UTC, mixed week", mixedWeek(), DateTimeZone.Utc, Instant.FromUtc(2020, 6, 1, 0, 0), 24 * 8);
+
+            measure(newYork);
+
+            Console.WriteLine($"{checks} checks, {failures} failed");
+            return failures > 0 ? 1 : 0;
+        }
+
+        // 2020-03-08 in New York: 02:00 EST jumps to 03:00 EDT, at 07:00 UTC.
+        private static void springForward(DateTimeZone zone)
+        {
+            Instant midnight = Instant.FromUtc(2020, 3, 8, 5, 0);
+            Instant gapEnd = Instant.FromUtc(2020, 3, 8, 7, 0);
+
+            // A restriction edge inside the gap happens when the wall clock passes it, at the end of the gap.
+            TimeRestrictionSchedule opensInGap = new TimeRestrictionSchedule(everyDay(2.5m, 22m));
+            expect("opens in the gap", opensInGap, zone, midnight, false, gapEnd);
+            expect("opens in the gap, just before", opensInGap, zone, gapEnd - Duration.FromSeconds(1), false, gapEnd);
+            expect("opens in the gap, after", opensInGap, zone, gapEnd, true, Instant.FromUtc(2020, 3, 9, 2, 0));
+
+            TimeRestrictionSchedule closesInGap = new TimeRestrictionSchedule(everyDay(0m, 2.5m));
+            expect("closes in the gap", closesInGap, zone, midnight, true, gapEnd);
+            expect("closes in the gap, after", closesInGap, zone, gapEnd, false, Instant.FromUtc(2020, 3, 9, 4, 0));
+
+            TimeRestrictionSchedule opensAtGap = new TimeRestrictionSchedule(everyDay(2m, 22m));
+            expect("opens at the gap", opensAtGap, zone, midnight, false, gapEnd);
+
+            // Past the gap, the change of offset comes first.
+            TimeRestrictionSchedule opensAfterGap = new TimeRestrictionSchedule(everyDay(3.5m, 22m));
+            expect("opens after the gap", opensAfterGap, zone, midnight, false, gapEnd);
+            expect("opens after the gap, in EDT", opensAfterGap, zone, gapEnd, false, Instant.FromUtc(2020, 3, 8, 7, 30));
+        }
+
+        // 2020-11-01 in New York: 02:00 EDT falls back to 01:00 EST, at 06:00 UTC, so 01:00 to 02:00 happens twice.
+        private static void fallBack(DateTimeZone zone)
+        {
+            Instant midnight = Instant.FromUtc(2020, 11, 1, 4, 0);
+            Instant change = Instant.FromUtc(2020, 11, 1, 6, 0);
+
+            // An edge in the repeated hour is crossed once in each offset.
+            TimeRestrictionSchedule opensInOverlap = new TimeRestrictionSchedule(everyDay(1.5m, 22m));
+            expect("opens in the overlap", opensInOverlap, zone, midnight, false, Instant.FromUtc(2020, 11, 1, 5, 30));
+            expect("opens in the overlap, first time", opensInOverlap, zone, Instant.FromUtc(2020, 11, 1, 5, 30), true, change);
+            expect("opens in the overlap, back to 01:00", opensInOverlap, zone, change, false, Instant.FromUtc(2020, 11, 1, 6, 30));
+            expect("opens in the overlap, second time", opensInOverlap, zone, Instant.FromUtc(2020, 11, 1, 6, 30), true, Instant.FromUtc(2020, 11, 2, 3, 0));
+
+            TimeRestrictionSchedule closesInOverlap = new TimeRestrictionSchedule(everyDay(0m, 1.5m));
+            expect("closes in the overlap", closesInOverlap, zone, midnight, true, Instant.FromUtc(2020, 11, 1, 5, 30));
+            expect("closes in the overlap, first time", closesInOverlap, zone, Instant.FromUtc(2020, 11, 1, 5, 30), false, change);
+            expect("closes in the overlap, back to 01:00", closesInOverlap, zone, change, true, Instant.FromUtc(2020, 11, 1, 6, 30));
+
+            // 02:00 is only reached in EST. The change at 06:00 UTC is still reported, since the schedule can't tell
+            // from the wall clock alone that nothing happens there.
+            TimeRestrictionSchedule opensAfterOverlap = new TimeRestrictionSchedule(everyDay(2m, 22m));
+            expect("opens after the overlap", opensAfterOverlap, zone, midnight, false, change);
+            expect("opens after the overlap, in EST", opensAfterOverlap, zone, change, false, Instant.FromUtc(2020, 11, 1, 7, 0));
+        }
+
+        // With nothing to change in the schedule, the next transition is the zone's next offset change, if there is one.
+        private static void offsetCap(DateTimeZone zone)
+        {
+            TimeRestrictionSchedule allDay = new TimeRestrictionSchedule(everyDay(0m, 24m));
+            expect("all day, before spring", allDay, zone, Instant.FromUtc(2020, 3, 1, 0, 0), true, Instant.FromUtc(2020, 3, 8, 7, 0));
+            expect("all day, before fall", allDay, zone, Instant.FromUtc(2020, 10, 1, 0, 0), true, Instant.FromUtc(2020, 11, 1, 6, 0));
+            expect("all day, UTC", allDay, DateTimeZone.Utc, Instant.FromUtc(2020, 3, 1, 0, 0), true, null);
+
+            TimeRestrictionSchedule never = new TimeRestrictionSchedule(everyDay());
+            expect("never, before spring", never, zone, Instant.FromUtc(2020, 3, 1, 0, 0), false, Instant.FromUtc(2020, 3, 8, 7, 0));
+
+            // A boundary further away than the offset change waits for it.
+            TimeRestrictionSchedule evenings = new TimeRestrictionSchedule(everyDay(20m, 22m));
+            expect("evenings, across spring", evenings, zone, Instant.FromUtc(2020, 3, 8, 3, 0), false, Instant.FromUtc(2020, 3, 8, 7, 0));
+            expect("evenings, after spring", evenings, zone, Instant.FromUtc(2020, 3, 8, 7, 0), false, Instant.FromUtc(2020, 3, 9, 0, 0));
+        }
+
+        private static void expect(string name, TimeRestrictionSchedule schedule, DateTimeZone zone, Instant now, bool allowed, Instant? next)
+        {
+            ZonedDateTime time = now.InZone(zone);
+            bool actualAllowed = schedule.IsAllowed(time);
+            Instant? actualNext = schedule.NextTransition(time);
+
+            checks++;
+
+            if (actualAllowed != allowed || actualNext != next)
+            {
+                failures++;
+                Console.WriteLine($"{name}: at {time} expected {(allowed ? "allowed" : "restricted")} until {describe(next, zone)}, got {(actualAllowed ? "allowed" : "restricted")} until {describe(actualNext, zone)}");
+            }
+        }
+
+        // Asks about a moment every 97 seconds, and checks that the answer holds at every minute before the reported
+        // transition and changes there unless it is an offset change.
+        private static void sweep(string name, TimeRestrictionModel[] restrictions, DateTimeZone zone, Instant start, int hours)
+        {
+            TimeRestrictionSchedule schedule = new TimeRestrictionSchedule(restrictions);
+            Instant end = start + Duration.FromHours(hours);
+
+            for (Instant now = start; now < end; now += Duration.FromSeconds(97))
+            {
+                ZonedDateTime time = now.InZone(zone);
+                bool allowed = schedule.IsAllowed(time);
+                Instant? next = schedule.NextTransition(time);
+
+                checks++;
+
+                if (next.HasValue && next.Value <= now)
+                {
+                    failures++;
+                    Console.WriteLine($"{name}: at {time} the next transition {describe(next, zone)} isn't after now");
+                    continue;
+                }
+
+                Instant limit = now + Duration.FromDays(8);
+                Instant until = next.HasValue && next.Value < limit ? next.Value : limit;
+
+                for (Instant minute = Instant.FromUnixTimeSeconds((now.ToUnixTimeSeconds() / 60 + 1) * 60); minute < until; minute += Duration.FromMinutes(1))
+                {
+                    if (schedule.IsAllowed(minute.InZone(zone)) != allowed)
+                    {
+                        failures++;
+                        Console.WriteLine($"{name}: at {time} the answer changes at {minute.InZone(zone)}, before the reported {describe(next, zone)}");
+                        break;
+                    }
+                }
+
+                if (next.HasValue && next.Value < limit && zone.GetZoneInterval(next.Value).Start != next.Value && schedule.IsAllowed(next.Value.InZone(zone)) == allowed)
+                {
+                    failures++;
+                    Console.WriteLine($"{name}: at {time} nothing changes at the reported {describe(next, zone)}");
+                }
+            }
+        }
+
+        // Query cost against a ZonedDateTime made beforehand, so that only the schedule is measured.
+        private static void measure(DateTimeZone zone)
+        {
+            TimeRestrictionSchedule schedule = new TimeRestrictionSchedule(mixedWeek());
+            ZonedDateTime time = Instant.FromUtc(2020, 6, 3, 16, 0).InZone(zone);
+
+            const int queries = 20000000;
+            bool any = false;
+
+            Stopwatch stopwatch = Stopwatch.StartNew();
+            for (int i = 0; i < queries; i++)
+            {
+                any ^= schedule.IsAllowed(time);
+            }
+            double isAllowed = stopwatch.Elapsed.TotalMilliseconds * 1000000 / queries;
+
+            const int transitions = 1000000;
+            long sum = 0;
+
+            stopwatch.Restart();
+            for (int i = 0; i < transitions; i++)
+            {
+                sum += schedule.NextTransition(time)?.ToUnixTimeTicks() ?? 0;
+            }
+            double nextTransition = stopwatch.Elapsed.TotalMilliseconds * 1000000 / transitions;
+
+            Console.WriteLine($"IsAllowed: {isAllowed:F1} ns, NextTransition: {nextTransition:F0} ns ({any}, {sum != 0})");
+        }
+
+        private static TimeRestrictionModel[] everyDay(params decimal[] enabledThrough)
+        {
+            TimeRestrictionModel[] week = new TimeRestrictionModel[7];
+
+            for (int day = 0; day < 7; day++)
+            {
+                week[day] = new TimeRestrictionModel { RestrictionsEnabled = true, EnabledThrough = enabledThrough };
+            }
+
+            return week;
+        }
+
+        // Unrestricted on Sunday, no access at all on Saturday, and 07:00 to 21:30 the rest of the week.
+        private static TimeRestrictionModel[] mixedWeek()
+        {
+            TimeRestrictionModel[] week = everyDay(7m, 21.5m);
+            week[(int)DayOfWeek.Sunday] = null;
+            week[(int)DayOfWeek.Saturday] = new TimeRestrictionModel { RestrictionsEnabled = true, EnabledThrough = new decimal[0] };
+
+            return week;
+        }
+
+        private static string describe(Instant? instant, DateTimeZone zone)
+        {
+            return instant.HasValue ? instant.Value.InZone(zone).ToString() : "never";
+        }
+    }
+}
@@ -0,0 +1,379 @@
+#include "SessionTable.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define CONCURRENT_ROUNDS 2000
+
+// Win32 errors the stand-in backend returns: ERROR_ACCESS_DENIED from OpenToken() and
+// ERROR_INVALID_HANDLE from Launch().
+#define ACCESS_DENIED 5
+#define INVALID_HANDLE 6
+
+typedef struct CheckResults {
+    unsigned int checks;
+    unsigned int failed;
+} CheckResults;
+
+static void expect(CheckResults* results, bool condition, const char* scenario, const char* what) {
+    results->checks++;
+
+    if (!condition) {
+        results->failed++;
+        fprintf(stderr, "%s: %s\n", scenario, what);
+    }
+}
+
+// Sessions and winlogons as a script sets them up. A token is the winlogon PID it was opened from,
+// so a launch can tell a stale one.
+class ScriptedBackend : public SessionBackend {
+public:
+    ScriptedBackend() : enumerations(0), tokensOpened(0), tokensOpen(0), launches(0), listing(true) {
+    }
+
+    virtual bool EnumerateSessions(std::vector<SessionInfo>& sessions) {
+        std::lock_guard<std::mutex> guard(lock);
+
+        enumerations++;
+        sessions = listed;
+        return listing;
+    }
+
+    virtual unsigned int FindWinlogon(unsigned int sessionId) {
+        std::lock_guard<std::mutex> guard(lock);
+
+        std::map<unsigned int, unsigned int>::const_iterator found = winlogons.find(sessionId);
+        return found == winlogons.end() ? 0 : found->second;
+    }
+
+    virtual void* OpenToken(unsigned int pid, unsigned int* error) {
+        std::lock_guard<std::mutex> guard(lock);
+
+        if (refused.count(pid) > 0) {
+            *error = ACCESS_DENIED;
+            return NULL;
+        }
+
+        tokensOpened++;
+        tokensOpen++;
+        return new unsigned int(pid);
+    }
+
+    virtual void CloseToken(void* token) {
+        std::lock_guard<std::mutex> guard(lock);
+
+        tokensOpen--;
+        delete (unsigned int*)token;
+    }
+
+    virtual unsigned int Launch(void* token, const wchar_t*, const wchar_t*) {
+        std::lock_guard<std::mutex> guard(lock);
+
+        unsigned int pid = *(unsigned int*)token;
+        launches++;
+        launchedFrom.push_back(pid);
+
+        if (failing.count(pid) > 0) {
+            return INVALID_HANDLE;
+        }
+
+        // A winlogon that has gone, or been restarted, leaves its token unable to launch.
+        for (std::map<unsigned int, unsigned int>::const_iterator i = winlogons.begin(); i != winlogons.end(); ++i) {
+            if (i->second == pid) {
+                return 0;
+            }
+        }
+
+        return INVALID_HANDLE;
+    }
+
+    void List(unsigned int id, bool active, bool console, bool loggedOn) {
+        SessionInfo session;
+        session.id = id;
+        session.active = active;
+        session.console = console;
+        session.loggedOn = loggedOn;
+
+        listed.push_back(session);
+    }
+
+    std::mutex lock;
+
+    std::vector<SessionInfo> listed;
+    std::map<unsigned int, unsigned int> winlogons;
+    std::map<unsigned int, bool> refused;
+    std::map<unsigned int, bool> failing;
+
+    unsigned int enumerations;
+    unsigned int tokensOpened;
+    int tokensOpen;
+    unsigned int launches;
+    std::vector<unsigned int> launchedFrom;
+
+    bool listing;
+};
+
+static unsigned int launch(SessionTable& table) {
+    return table.Launch(L"CloudVeil.exe", L"CloudVeil.exe /autostart");
+}
+
+// A user on the console and another over Remote Desktop when the service starts. Both are WTSActive;
+// only the console tells them apart.
+static void checkSeeding(CheckResults* results) {
+    {
+        const char* scenario = "seeding, console and remote";
+        ScriptedBackend backend;
+        backend.List(0, false, false, false);
+        backend.List(2, true, false, true);
+        backend.List(1, true, true, true);
+        backend.List(3, true, false, true);
+
+        SessionTable table(&backend);
+        expect(results, table.ActiveSession() == 1, scenario, "a remote session was taken for the console");
+        expect(results, backend.enumerations == 1, scenario, "the sessions weren't listed once");
+
+        // The console user switches away, leaving the remote users.
+        table.OnEvent(SESSION_EVENT_CONSOLE_DISCONNECT, 1);
+        unsigned int active = table.ActiveSession();
+        expect(results, active == 2 || active == 3, scenario, "a remote session wasn't taken once the console left");
+        expect(results, backend.enumerations == 1, scenario, "the sessions were listed again");
+    }
+
+    {
+        const char* scenario = "seeding, remote only";
+        ScriptedBackend backend;
+        backend.List(0, false, false, false);
+        backend.List(1, false, false, false);
+        backend.List(4, true, false, true);
+
+        SessionTable table(&backend);
+        expect(results, table.ActiveSession() == 4, scenario, "the remote session wasn't taken");
+
+        // Someone signs in at the console, which takes over.
+        table.OnEvent(SESSION_EVENT_CONSOLE_CONNECT, 5);
+        table.OnEvent(SESSION_EVENT_LOGON, 5);
+        expect(results, table.ActiveSession() == 5, scenario, "the console didn't take over from the remote session");
+
+        table.OnEvent(SESSION_EVENT_CONSOLE_DISCONNECT, 5);
+        expect(results, table.ActiveSession() == 4, scenario, "the remote session wasn't taken back");
+        expect(results, backend.enumerations == 1, scenario, "the sessions were listed again");
+    }
+
+    {
+        const char* scenario = "seeding, nobody";
+        ScriptedBackend backend;
+        backend.List(0, false, false, false);
+        backend.listing = false;
+
+        SessionTable table(&backend);
+        expect(results, table.ActiveSession() == SESSION_NONE, scenario, "a session was made up");
+        expect(results, launch(table) == SESSION_ERROR_NO_SESSION, scenario, "a launch didn't fail without a session");
+
+        // Nothing was seeded, so the next question goes to the backend again.
+        backend.listed.clear();
+        backend.List(6, true, true, true);
+        backend.listing = true;
+        expect(results, table.ActiveSession() == 6 && backend.enumerations == 3, scenario, "the sessions weren't listed again");
+    }
+}
+
+// Two users on one machine taking turns at the console.
+static void checkFastUserSwitching(CheckResults* results) {
+    const char* scenario = "fast user switching";
+    ScriptedBackend backend;
+    backend.List(0, false, false, false);
+    backend.List(1, true, true, true);
+    backend.winlogons[1] = 100;
+    backend.winlogons[2] = 200;
+
+    {
+        SessionTable table(&backend);
+
+        expect(results, launch(table) == 0 && backend.tokensOpened == 1, scenario, "the first launch didn't open a token");
+        expect(results, launch(table) == 0 && backend.tokensOpened == 1, scenario, "the second launch opened another token");
+
+        table.OnEvent(SESSION_EVENT_CONSOLE_DISCONNECT, 1);
+        table.OnEvent(SESSION_EVENT_CONSOLE_CONNECT, 2);
+        table.OnEvent(SESSION_EVENT_LOGON, 2);
+        expect(results, table.ActiveSession() == 2, scenario, "the second user wasn't active after switching");
+        expect(results, table.Prepare() == 0 && backend.tokensOpened == 2, scenario, "the second user's token wasn't opened ahead");
+        expect(results, launch(table) == 0 && backend.launchedFrom.back() == 200, scenario, "the launch didn't go to the second user");
+
+        table.OnEvent(SESSION_EVENT_LOCK, 2);
+        expect(results, table.IsLocked(2) && !table.IsLocked(1), scenario, "the lock wasn't kept to its session");
+        table.OnEvent(SESSION_EVENT_UNLOCK, 2);
+        expect(results, !table.IsLocked(2), scenario, "unlocking didn't stick");
+
+        // Back to the first user, whose token is still open.
+        table.OnEvent(SESSION_EVENT_CONSOLE_DISCONNECT, 2);
+        table.OnEvent(SESSION_EVENT_CONSOLE_CONNECT, 1);
+        expect(results, launch(table) == 0 && backend.launchedFrom.back() == 100 && backend.tokensOpened == 2, scenario, "switching back opened another token");
+
+        table.OnEvent(SESSION_EVENT_LOGOFF, 2);
+        expect(results, backend.tokensOpen == 1, scenario, "signing out didn't drop the token");
+
+        table.OnEvent(SESSION_EVENT_TERMINATE, 2);
+        expect(results, table.ActiveSession() == 1 && backend.enumerations == 1, scenario, "the sessions were listed again");
+
+        SessionTableStats stats = table.Stats();
+        expect(results, stats.launches == 4 && stats.preparedLaunches == 3 && stats.tokensOpened == 2 && stats.tokensDropped == 1, scenario, "the counts are off");
+    }
+
+    expect(results, backend.tokensOpen == 0, scenario, "a token was left open");
+}
+
+// Remote sessions only win while nobody is at the console, and then the newest does.
+static void checkRemotePrecedence(CheckResults* results) {
+    const char* scenario = "remote precedence";
+    ScriptedBackend backend;
+    backend.List(1, true, true, true);
+    backend.winlogons[1] = 100;
+    backend.winlogons[4] = 400;
+    backend.winlogons[5] = 500;
+
+    SessionTable table(&backend);
+    expect(results, table.ActiveSession() == 1, scenario, "the console wasn't active");
+
+    table.OnEvent(SESSION_EVENT_REMOTE_CONNECT, 4);
+    table.OnEvent(SESSION_EVENT_LOGON, 4);
+    expect(results, table.ActiveSession() == 1, scenario, "a remote connection took over from the console");
+
+    table.OnEvent(SESSION_EVENT_CONSOLE_DISCONNECT, 1);
+    expect(results, table.ActiveSession() == 4, scenario, "the remote session wasn't taken once the console left");
+
+    table.OnEvent(SESSION_EVENT_REMOTE_CONNECT, 5);
+    expect(results, table.ActiveSession() == 5, scenario, "the newest remote session wasn't taken");
+    expect(results, launch(table) == 0 && backend.launchedFrom.back() == 500, scenario, "the launch didn't go to the newest remote session");
+
+    table.OnEvent(SESSION_EVENT_REMOTE_DISCONNECT, 5);
+    expect(results, table.ActiveSession() == 4, scenario, "the older remote session wasn't taken back");
+
+    // Reconnecting makes it the newest again.
+    table.OnEvent(SESSION_EVENT_REMOTE_CONNECT, 5);
+    table.OnEvent(SESSION_EVENT_REMOTE_CONNECT, 4);
+    expect(results, table.ActiveSession() == 4, scenario, "a reconnected session wasn't the newest");
+
+    table.OnEvent(SESSION_EVENT_CONSOLE_CONNECT, 1);
+    expect(results, table.ActiveSession() == 1, scenario, "the console didn't take over again");
+
+    table.OnEvent(SESSION_EVENT_TERMINATE, 1);
+    expect(results, table.ActiveSession() == 4, scenario, "ending the console's session didn't leave the remote one");
+    expect(results, backend.enumerations == 1, scenario, "the sessions were listed again");
+}
+
+// Winlogon restarts behind a cached token, and tokens that can't be had at all.
+static void checkStaleTokens(CheckResults* results) {
+    const char* scenario = "stale token";
+    ScriptedBackend backend;
+    backend.List(1, true, true, true);
+    backend.winlogons[1] = 100;
+
+    SessionTable table(&backend);
+    expect(results, table.Prepare() == 0 && backend.tokensOpened == 1, scenario, "the token wasn't opened ahead");
+
+    backend.winlogons[1] = 101;
+    expect(results, launch(table) == 0, scenario, "the launch wasn't retried with a new token");
+    expect(results, backend.tokensOpened == 2 && backend.launches == 2, scenario, "the retry didn't open one token and launch once more");
+    expect(results, backend.launchedFrom.back() == 101 && backend.tokensOpen == 1, scenario, "the stale token wasn't replaced");
+
+    // A token opened for this launch that fails isn't retried.
+    table.OnEvent(SESSION_EVENT_LOGOFF, 1);
+    backend.failing[101] = true;
+
+    unsigned int launches = backend.launches;
+    expect(results, launch(table) == INVALID_HANDLE && backend.launches == launches + 1, scenario, "a fresh token was retried");
+
+    backend.failing.erase(101);
+
+    table.OnEvent(SESSION_EVENT_LOGOFF, 1);
+    backend.winlogons.erase(1);
+    expect(results, launch(table) == SESSION_ERROR_NO_WINLOGON, scenario, "a session without winlogon didn't fail");
+
+    backend.winlogons[1] = 104;
+    backend.refused[104] = true;
+    expect(results, launch(table) == ACCESS_DENIED, scenario, "a refused token didn't fail with the backend's error");
+
+    backend.refused.erase(104);
+    expect(results, launch(table) == 0 && backend.launchedFrom.back() == 104, scenario, "the token wasn't tried again after it was refused");
+
+    SessionTableStats stats = table.Stats();
+    expect(results, stats.failedLaunches == 3 && stats.tokensDropped == 3, scenario, "the counts are off");
+}
+
+// Events from the service's control handler while the GUI is being launched.
+static void checkConcurrent(CheckResults* results) {
+    const char* scenario = "concurrent events";
+    ScriptedBackend backend;
+    backend.List(1, true, true, true);
+    backend.winlogons[1] = 100;
+    backend.winlogons[2] = 200;
+
+    {
+        SessionTable table(&backend);
+        std::atomic<unsigned int> failures(0);
+
+        std::thread events([&]() {
+            for (unsigned int i = 0; i < CONCURRENT_ROUNDS; i++) {
+                unsigned int id = 1 + (i & 1);
+
+                table.OnEvent(SESSION_EVENT_CONSOLE_CONNECT, id);
+                table.OnEvent(SESSION_EVENT_LOGON, id);
+
+                if (i % 7 == 0) {
+                    table.OnEvent(SESSION_EVENT_LOGOFF, id);
+                }
+            }
+        });
+
+        std::thread launches([&]() {
+            for (unsigned int i = 0; i < CONCURRENT_ROUNDS; i++) {
+                if (launch(table) != 0) {
+                    failures++;
+                }
+            }
+        });
+
+        events.join();
+        launches.join();
+
+        expect(results, failures == 0, scenario, "a launch failed while sessions switched");
+    }
+
+    expect(results, backend.tokensOpen == 0, scenario, "a token was left open");
+}
+
+static void usage() {
+    fprintf(stderr,
+        "Usage: session-check\n"
+        "\n"
+        "Runs SessionTable through scripted session events against a stand-in backend: seeding from\n"
+        "a console and remote sessions, fast user switching, remote sessions with and without the\n"
+        "console, winlogon restarting behind a cached token, and events during launches. Exits with 1\n"
+        "if any check fails.\n");
+}
+
+int main(int argc, char**) {
+    if (argc > 1) {
+        usage();
+        return 1;
+    }
+
+    CheckResults results;
+    results.checks = 0;
+    results.failed = 0;
+
+    checkSeeding(&results);
+    checkFastUserSwitching(&results);
+    checkRemotePrecedence(&results);
+    checkStaleTokens(&results);
+    checkConcurrent(&results);
+
+    printf("%u checks, %u failed\n", results.checks, results.failed);
+    return results.failed > 0 ? 1 : 0;
+}
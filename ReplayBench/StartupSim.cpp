@@ -0,0 +1,320 @@
+#include "StartupPlan.h"
+
+#include <sched.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define DEFAULT_THREADS 8
+#define DEFAULT_KEY_MS 450
+
+// Reading a pregenerated key pair from keyPairs.pem.
+#define POOLED_KEY_MS 5
+
+typedef struct MockPhase {
+    const char* name;
+    unsigned int ms;
+
+    // Spins for its time when CPU bound phases are on, and sleeps like I/O otherwise.
+    bool cpu;
+
+    std::vector<std::string> dependsOn;
+} MockPhase;
+
+typedef struct SimOptions {
+    unsigned int threads;
+    unsigned int keyMs;
+    bool cpu;
+    bool oneCore;
+    bool pregenerated;
+    bool phases;
+} SimOptions;
+
+// Filtering is up with the lists loaded once both of these have finished.
+static const char* const milestones[] = { "filtering", "lists" };
+
+#define MILESTONE_COUNT (sizeof(milestones) / sizeof(milestones[0]))
+
+// Startup before the graph, as the chain it ran in. The firewall check, then the engine, which
+// generated the root key, started the proxy and generated the control server's key before
+// filtering. The configuration and lists only came from the server after that.
+static std::vector<MockPhase> chainPhases(const SimOptions& options) {
+    std::vector<MockPhase> phases;
+
+    phases.push_back({ "firewall", 120, false, {} });
+    phases.push_back({ "rootKey", options.keyMs, true, { "firewall" } });
+    phases.push_back({ "proxy", 150, false, { "rootKey" } });
+    phases.push_back({ "serverKey", options.keyMs, true, { "proxy" } });
+    phases.push_back({ "controlServer", 30, false, { "serverKey" } });
+    phases.push_back({ "filtering", 50, false, { "controlServer" } });
+    phases.push_back({ "trust", 80, false, { "controlServer" } });
+    phases.push_back({ "conflicts", 700, false, { "firewall" } });
+    phases.push_back({ "connectivity", 300, false, { "conflicts" } });
+    phases.push_back({ "diverter", 20, false, { "connectivity" } });
+    phases.push_back({ "protectiveServices", 200, false, { "firewall" } });
+    phases.push_back({ "dns", 50, false, { "protectiveServices" } });
+    phases.push_back({ "downloadConfig", 400, false, { "dns" } });
+    phases.push_back({ "configuration", 60, true, { "downloadConfig" } });
+    phases.push_back({ "downloadLists", 600, false, { "configuration" } });
+    phases.push_back({ "lists", 900, true, { "downloadLists" } });
+
+    return phases;
+}
+
+// The foreground graph as CommonFilterServiceProvider.addStartupPhases() and the Windows service
+// add it. The configuration and lists are the copies the last run saved.
+static std::vector<MockPhase> graphPhases(const SimOptions& options) {
+    std::vector<MockPhase> phases;
+    unsigned int keyMs = options.pregenerated ? POOLED_KEY_MS : options.keyMs;
+
+    phases.push_back({ "firewall", 120, false, {} });
+    phases.push_back({ "rootKey", keyMs, !options.pregenerated, {} });
+    phases.push_back({ "serverKey", keyMs, !options.pregenerated, {} });
+    phases.push_back({ "configuration", 60, true, {} });
+    phases.push_back({ "lists", 900, true, { "configuration" } });
+    phases.push_back({ "proxy", 150, false, { "firewall", "rootKey" } });
+    phases.push_back({ "filtering", 50, false, { "proxy" } });
+    phases.push_back({ "controlServer", 30, false, { "proxy", "serverKey" } });
+    phases.push_back({ "protectiveServices", 200, false, {} });
+    phases.push_back({ "dns", 50, false, { "firewall" } });
+    phases.push_back({ "conflicts", 700, false, {} });
+    phases.push_back({ "connectivity", 300, false, { "firewall" } });
+    phases.push_back({ "diverter", 20, false, { "connectivity" } });
+
+    return phases;
+}
+
+// What runs once the foreground graph is done. The update check only downloads what changed.
+static std::vector<MockPhase> backgroundPhases() {
+    std::vector<MockPhase> phases;
+
+    phases.push_back({ "trust", 80, false, {} });
+    phases.push_back({ "update", 1000, false, {} });
+    phases.push_back({ "logCleanup", 40, false, {} });
+
+    return phases;
+}
+
+static void spin(unsigned int ms) {
+    unsigned long long start = StartupPlan::ThreadCpuMicroseconds();
+    volatile unsigned long long sink = 0;
+
+    while (StartupPlan::ThreadCpuMicroseconds() - start < ms * 1000ULL) {
+        sink = sink * 31 + 7;
+    }
+}
+
+// Runs the phases on a pool of threads, the way StartupGraph does, and returns the plan's
+// timings by phase name.
+static std::map<std::string, StartupPhaseTiming> run(const std::vector<MockPhase>& phases, const SimOptions& options, unsigned long long* totalUs) {
+    StartupPlan plan;
+    std::map<std::string, int> ids;
+
+    for (size_t i = 0; i < phases.size(); i++) {
+        std::vector<int> dependsOn;
+
+        for (size_t d = 0; d < phases[i].dependsOn.size(); d++) {
+            dependsOn.push_back(ids.at(phases[i].dependsOn[d]));
+        }
+
+        ids[phases[i].name] = plan.AddPhase(dependsOn.empty() ? NULL : dependsOn.data(), dependsOn.size());
+    }
+
+    std::mutex lock;
+    std::condition_variable changed;
+    std::vector<int> ready;
+    bool done = false;
+
+    plan.Begin(StartupPlan::MonotonicMicroseconds());
+    plan.TakeReady(ready);
+
+    std::vector<std::thread> threads;
+
+    for (unsigned int t = 0; t < options.threads; t++) {
+        threads.push_back(std::thread([&]() {
+            std::unique_lock<std::mutex> guard(lock);
+
+            while (true) {
+                changed.wait(guard, [&]() { return done || !ready.empty(); });
+
+                if (ready.empty()) {
+                    return;
+                }
+
+                int phase = ready.back();
+                ready.pop_back();
+                guard.unlock();
+
+                unsigned long long startUs = StartupPlan::MonotonicMicroseconds();
+                unsigned long long cpuStartUs = StartupPlan::ThreadCpuMicroseconds();
+
+                if (phases[phase].cpu && options.cpu) {
+                    spin(phases[phase].ms);
+                }
+                else {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(phases[phase].ms));
+                }
+
+                unsigned long long cpuUs = StartupPlan::ThreadCpuMicroseconds() - cpuStartUs;
+                unsigned long long endUs = StartupPlan::MonotonicMicroseconds();
+
+                guard.lock();
+                plan.Complete(phase, true, startUs, endUs, cpuUs);
+                plan.TakeReady(ready);
+
+                if (plan.Finished()) {
+                    done = true;
+                }
+
+                changed.notify_all();
+            }
+        }));
+    }
+
+    for (size_t t = 0; t < threads.size(); t++) {
+        threads[t].join();
+    }
+
+    std::map<std::string, StartupPhaseTiming> timings;
+    for (size_t i = 0; i < phases.size(); i++) {
+        timings[phases[i].name] = plan.Timing((int)i);
+    }
+
+    *totalUs = plan.TotalUs();
+    return timings;
+}
+
+static void printPhases(const std::vector<MockPhase>& phases, const std::map<std::string, StartupPhaseTiming>& timings, unsigned long long offsetUs) {
+    for (size_t i = 0; i < phases.size(); i++) {
+        const StartupPhaseTiming& timing = timings.at(phases[i].name);
+
+        printf("    %-20s %6.0f %6.0f ms  cpu %5.0f ms  %s\n", phases[i].name, (offsetUs + timing.startUs) / 1000.0, (offsetUs + timing.endUs) / 1000.0,
+            timing.cpuUs / 1000.0, timing.critical ? "critical" : "");
+    }
+}
+
+static double untilFiltering(const std::map<std::string, StartupPhaseTiming>& timings) {
+    double ms = 0;
+
+    for (size_t m = 0; m < MILESTONE_COUNT; m++) {
+        double end = timings.at(milestones[m]).endUs / 1000.0;
+        ms = end > ms ? end : ms;
+    }
+
+    return ms;
+}
+
+static void usage() {
+    fprintf(stderr,
+        "Usage: startup-sim [options]\n"
+        "\n"
+        "Runs mocked startup phases through StartupPlan on a pool of threads, first in the chain the\n"
+        "service used to start in and then as the startup graph, and prints how long each took until\n"
+        "filtering was up with the lists loaded.\n"
+        "\n"
+        "  --threads N       Pool threads. Default %d.\n"
+        "  --key-ms N        Time to generate a 2048 bit key pair. Default %d.\n"
+        "  --cpu             Spin in CPU bound phases (key generation, loading configuration and\n"
+        "                    lists) rather than sleep, so that they compete for the processors.\n"
+        "  --one-core        Run every thread on one processor. Implies --cpu.\n"
+        "  --pregenerated    The graph takes its keys from the pool rather than generating them.\n"
+        "  --phases          Print when each phase ran.\n",
+        DEFAULT_THREADS, DEFAULT_KEY_MS);
+}
+
+int main(int argc, char** argv) {
+    SimOptions options;
+    options.threads = DEFAULT_THREADS;
+    options.keyMs = DEFAULT_KEY_MS;
+    options.cpu = false;
+    options.oneCore = false;
+    options.pregenerated = false;
+    options.phases = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string name = argv[i];
+
+        if (name == "--cpu") {
+            options.cpu = true;
+            continue;
+        }
+        else if (name == "--one-core") {
+            options.oneCore = true;
+            options.cpu = true;
+            continue;
+        }
+        else if (name == "--pregenerated") {
+            options.pregenerated = true;
+            continue;
+        }
+        else if (name == "--phases") {
+            options.phases = true;
+            continue;
+        }
+
+        char* end = NULL;
+        unsigned long value = i + 1 < argc ? strtoul(argv[i + 1], &end, 10) : 0;
+
+        if (i + 1 >= argc || end == argv[i + 1] || *end != '\0') {
+            usage();
+            return 1;
+        }
+
+        if (name == "--threads" && value >= 1 && value <= 64) {
+            options.threads = (unsigned int)value;
+        }
+        else if (name == "--key-ms" && value <= 60000) {
+            options.keyMs = (unsigned int)value;
+        }
+        else {
+            usage();
+            return 1;
+        }
+
+        i++;
+    }
+
+    if (options.oneCore) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(sched_getcpu(), &cpus);
+
+        if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0) {
+            fprintf(stderr, "Couldn't keep to one processor.\n");
+            return 1;
+        }
+    }
+
+    std::vector<MockPhase> chain = chainPhases(options);
+    unsigned long long chainUs = 0;
+    std::map<std::string, StartupPhaseTiming> chainTimings = run(chain, options, &chainUs);
+
+    printf("Chain: filtering up with lists %.0f ms, everything %.0f ms\n", untilFiltering(chainTimings), chainUs / 1000.0);
+    if (options.phases) {
+        printPhases(chain, chainTimings, 0);
+    }
+
+    std::vector<MockPhase> graph = graphPhases(options);
+    unsigned long long graphUs = 0;
+    std::map<std::string, StartupPhaseTiming> graphTimings = run(graph, options, &graphUs);
+
+    std::vector<MockPhase> background = backgroundPhases();
+    unsigned long long backgroundUs = 0;
+    std::map<std::string, StartupPhaseTiming> backgroundTimings = run(background, options, &backgroundUs);
+
+    printf("Graph: filtering up with lists %.0f ms, foreground %.0f ms, everything %.0f ms\n",
+        untilFiltering(graphTimings), graphUs / 1000.0, (graphUs + backgroundUs) / 1000.0);
+    if (options.phases) {
+        printPhases(graph, graphTimings, 0);
+        printPhases(background, backgroundTimings, graphUs);
+    }
+
+    return 0;
+}
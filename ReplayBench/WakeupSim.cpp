@@ -0,0 +1,233 @@
+#include "JobSchedule.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#define DEFAULT_DURATION_S 3600
+#define DEFAULT_TRACE_DRAIN_MS 10000
+#define DEFAULT_SEED 7
+
+#define SCHEDULE_SEED 12345
+
+// Services start their timers at different points while starting up.
+#define START_OFFSET_MIN_MS 200
+#define START_OFFSET_SPREAD_MS 3000
+
+typedef struct SimJob {
+    const char* name;
+    unsigned int periodMs;
+    unsigned int slackMs;
+    double jitter;
+    unsigned int maxBackoffMs;
+
+    // How long a run takes, which the old timers waited out before counting the next period.
+    unsigned int runMs;
+
+    // Only had a timer before the schedule: the threshold counter reset, which a SlidingWindow
+    // replaced.
+    bool timerOnly;
+} SimJob;
+
+// The periodic work of an idle service that is signed in, as CommonFilterServiceProvider and
+// DnsEnforcement set it up. The trace drain comes first so that it can be changed or left out. Its
+// other job only runs when a busy trace fills up, which an idle service never does.
+static SimJob serviceJobs[] = {
+    { "trace drain", DEFAULT_TRACE_DRAIN_MS, DEFAULT_TRACE_DRAIN_MS / 2, 0, 0, 1, false },
+    { "memory monitor", 30000, 5000, 0, 0, 20, false },
+    { "DNS enforcement", 60000, 2000, 0.1, 300000, 150, false },
+    { "update check", 300000, 10000, 0.1, 3600000, 2000, false },
+    { "time restrictions", 300000, 1000, 0, 0, 1, false },
+    { "threshold reset", 60000, 0, 0, 0, 0, true },
+    { "log cleanup", 43200000, 60000, 0, 0, 50, false },
+};
+
+#define SERVICE_JOB_COUNT (sizeof(serviceJobs) / sizeof(serviceJobs[0]))
+
+typedef struct SimOptions {
+    unsigned long long durationMs;
+    unsigned long long traceDrainMs;
+    unsigned long long seed;
+} SimOptions;
+
+static std::vector<unsigned long long> startOffsets(const SimOptions& options, size_t count) {
+    std::vector<unsigned long long> offsets;
+
+    srand((unsigned int)options.seed);
+    for (size_t i = 0; i < count; i++) {
+        offsets.push_back(START_OFFSET_MIN_MS + rand() % START_OFFSET_SPREAD_MS);
+    }
+
+    return offsets;
+}
+
+// One timer per job, each fired on its own a period after its last run ended.
+static void simulateTimers(const SimOptions& options, const std::vector<SimJob>& jobs) {
+    std::vector<unsigned long long> offsets = startOffsets(options, jobs.size());
+    unsigned long long callbacks = 0;
+    unsigned long long idle = 0;
+
+    // Distinct 16 ms scheduler ticks with a callback in them, in case the OS happened to batch some.
+    std::set<unsigned long long> ticks;
+
+    for (size_t i = 0; i < jobs.size(); i++) {
+        if (jobs[i].periodMs == 0) {
+            continue;
+        }
+
+        for (unsigned long long at = offsets[i] + jobs[i].periodMs; at <= options.durationMs; at += jobs[i].runMs + jobs[i].periodMs) {
+            callbacks++;
+            ticks.insert(at / 16);
+
+            if (jobs[i].timerOnly) {
+                idle++;
+            }
+        }
+    }
+
+    printf("  %-20s %6llu wakeups (%llu did nothing), %zu distinct 16 ms ticks\n", "timers:", callbacks, idle, ticks.size());
+}
+
+// The same jobs on one JobSchedule, with the dispatcher only woken when the earliest deadline is due
+// or moves earlier.
+static void simulateSchedule(const SimOptions& options, const std::vector<SimJob>& jobs, bool slack) {
+    std::vector<unsigned long long> offsets = startOffsets(options, jobs.size());
+    JobSchedule schedule(0, SCHEDULE_SEED);
+    std::vector<unsigned int> ids(jobs.size());
+    std::vector<size_t> jobOf;
+
+    for (size_t i = 0; i < jobs.size(); i++) {
+        if (jobs[i].timerOnly) {
+            continue;
+        }
+
+        ids[i] = schedule.AddJob(jobs[i].periodMs, slack ? jobs[i].slackMs : 0, jobs[i].jitter, jobs[i].maxBackoffMs);
+
+        jobOf.resize(ids[i] + 1);
+        jobOf[ids[i]] = i;
+    }
+
+    for (size_t i = 0; i < jobs.size(); i++) {
+        if (!jobs[i].timerOnly && jobs[i].periodMs > 0) {
+            schedule.Start(ids[i], jobs[i].periodMs, offsets[i]);
+        }
+    }
+
+    // Runs in progress on the pool, by when they finish.
+    std::multiset<std::pair<unsigned long long, unsigned int> > running;
+    std::vector<unsigned int> due;
+    unsigned long long sleepUntil = schedule.NextDeadline();
+
+    while (true) {
+        // A run completing wakes the dispatcher only if it moves the earliest deadline forward.
+        if (!running.empty() && running.begin()->first < sleepUntil) {
+            std::pair<unsigned long long, unsigned int> done = *running.begin();
+            running.erase(running.begin());
+
+            if (done.first > options.durationMs) {
+                break;
+            }
+
+            schedule.Complete(done.second, true, done.first);
+
+            if (schedule.NextDeadline() < sleepUntil) {
+                schedule.CountWakeup(true);
+                sleepUntil = schedule.NextDeadline();
+            }
+
+            continue;
+        }
+
+        if (sleepUntil > options.durationMs) {
+            break;
+        }
+
+        due.clear();
+        schedule.Expire(sleepUntil, due);
+        schedule.CountWakeup(due.empty());
+
+        for (size_t i = 0; i < due.size(); i++) {
+            running.insert(std::make_pair(sleepUntil + jobs[jobOf[due[i]]].runMs, due[i]));
+        }
+
+        sleepUntil = schedule.NextDeadline();
+    }
+
+    JobScheduleStats stats = schedule.Stats();
+    printf("  %-20s %6llu wakeups (%llu idle), %llu runs, %llu coalesced\n",
+        slack ? "schedule, slack:" : "schedule, no slack:", stats.wakeups, stats.idleWakeups, stats.runs, stats.coalesced);
+}
+
+static void simulate(const SimOptions& options, unsigned long long traceDrainMs) {
+    std::vector<SimJob> jobs(serviceJobs, serviceJobs + SERVICE_JOB_COUNT);
+    jobs[0].periodMs = (unsigned int)traceDrainMs;
+    jobs[0].slackMs = (unsigned int)(traceDrainMs / 2);
+
+    if (traceDrainMs > 0) {
+        printf("Trace drain every %llu ms:\n", traceDrainMs);
+    }
+    else {
+        printf("No trace drain:\n");
+    }
+
+    simulateTimers(options, jobs);
+    simulateSchedule(options, jobs, false);
+    simulateSchedule(options, jobs, true);
+}
+
+static void usage() {
+    fprintf(stderr,
+        "Usage: wakeup-sim [--duration-s N] [--trace-drain-ms N] [--seed N]\n"
+        "\n"
+        "Counts how often an idle service wakes up for its periodic work on a simulated clock: with a\n"
+        "timer per job, and with every job on one JobSchedule, with and without slack. Runs once with\n"
+        "the trace drain and once without.\n"
+        "\n"
+        "  --duration-s N       Default %d.\n"
+        "  --trace-drain-ms N   How often the trace ring is drained while it is quiet. Default %d.\n"
+        "  --seed N             Seeds the start offsets. Default %d.\n",
+        DEFAULT_DURATION_S, DEFAULT_TRACE_DRAIN_MS, DEFAULT_SEED);
+}
+
+int main(int argc, char** argv) {
+    SimOptions options;
+    options.durationMs = DEFAULT_DURATION_S * 1000ULL;
+    options.traceDrainMs = DEFAULT_TRACE_DRAIN_MS;
+    options.seed = DEFAULT_SEED;
+
+    for (int i = 1; i < argc; i++) {
+        std::string name = argv[i];
+        char* end = NULL;
+        unsigned long long value = i + 1 < argc ? strtoull(argv[i + 1], &end, 10) : 0;
+
+        if (i + 1 >= argc || end == argv[i + 1] || *end != '\0') {
+            usage();
+            return 1;
+        }
+
+        if (name == "--duration-s" && value > 0) {
+            options.durationMs = value * 1000;
+        }
+        else if (name == "--trace-drain-ms" && value > 0 && value <= 0xFFFFFFFFULL) {
+            options.traceDrainMs = value;
+        }
+        else if (name == "--seed") {
+            options.seed = value;
+        }
+        else {
+            usage();
+            return 1;
+        }
+
+        i++;
+    }
+
+    simulate(options, options.traceDrainMs);
+    printf("\n");
+    simulate(options, 0);
+
+    return 0;
+}
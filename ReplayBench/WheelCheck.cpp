@@ -0,0 +1,185 @@
+#include "TimerWheel.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#define DEFAULT_OPERATIONS 200000
+#define DEFAULT_SEED 3
+
+#define TIMER_IDS 300
+
+// Past the top level of the wheel, so that timers go through the overflow list.
+#define FAR_TICKS 20000000000ULL
+
+static void usage() {
+    fprintf(stderr,
+        "Usage: wheel-check [--operations N] [--seed N]\n"
+        "\n"
+        "Arms, disarms and advances a TimerWheel at random, and checks every answer against a sorted\n"
+        "map of the same timers. Exits with 1 on the first difference.\n"
+        "\n"
+        "  --operations N    Default %d.\n"
+        "  --seed N          Default %d.\n",
+        DEFAULT_OPERATIONS, DEFAULT_SEED);
+}
+
+int main(int argc, char** argv) {
+    unsigned long long operations = DEFAULT_OPERATIONS;
+    unsigned long long seed = DEFAULT_SEED;
+
+    for (int i = 1; i < argc; i++) {
+        std::string name = argv[i];
+        char* end = NULL;
+        unsigned long long value = i + 1 < argc ? strtoull(argv[i + 1], &end, 10) : 0;
+
+        if (i + 1 >= argc || end == argv[i + 1] || *end != '\0') {
+            usage();
+            return 1;
+        }
+
+        if (name == "--operations") {
+            operations = value;
+        }
+        else if (name == "--seed") {
+            seed = value;
+        }
+        else {
+            usage();
+            return 1;
+        }
+
+        i++;
+    }
+
+    std::mt19937_64 random(seed);
+
+    unsigned long long now = 1000;
+    TimerWheel wheel(now);
+
+    // Expiry of every armed timer, as the wheel should have it.
+    std::map<unsigned int, unsigned long long> armed;
+
+    std::vector<unsigned int> expired;
+    unsigned long long advances = 0;
+    unsigned long long expiries = 0;
+
+    for (unsigned long long op = 0; op < operations; op++) {
+        unsigned int id = (unsigned int)(random() % TIMER_IDS);
+        unsigned int kind = (unsigned int)(random() % 8);
+
+        if (kind < 4) {
+            unsigned long long expiry;
+
+            switch (random() % 4) {
+            case 0:
+                expiry = now + random() % 100;
+                break;
+            case 1:
+                expiry = now + random() % 100000;
+                break;
+            case 2:
+                expiry = now + random() % FAR_TICKS;
+                break;
+            default:
+                // Already due, so it expires on the next tick.
+                expiry = now - random() % 5;
+                break;
+            }
+
+            wheel.Arm(id, expiry);
+            armed[id] = expiry > now ? expiry : now + 1;
+        }
+        else if (kind < 6) {
+            wheel.Disarm(id);
+            armed.erase(id);
+        }
+        else {
+            unsigned long long earliest = TIMER_WHEEL_NEVER;
+            for (std::map<unsigned int, unsigned long long>::const_iterator it = armed.begin(); it != armed.end(); ++it) {
+                earliest = std::min(earliest, it->second);
+            }
+
+            if (wheel.NextExpiry() != earliest) {
+                fprintf(stderr, "Operation %llu: the next expiry is %llu, but should be %llu.\n", op, wheel.NextExpiry(), earliest);
+                return 1;
+            }
+
+            // Sometimes exactly to the next expiry, sometimes a little way, and sometimes far past
+            // the top level.
+            unsigned long long to;
+
+            switch (random() % 8) {
+            case 0:
+            case 1:
+            case 2:
+                to = earliest == TIMER_WHEEL_NEVER ? now + 5 : earliest;
+                break;
+            case 3:
+                to = now + random() % (3 * FAR_TICKS / 2);
+                break;
+            default:
+                to = now + random() % 200000;
+                break;
+            }
+
+            expired.clear();
+            wheel.Advance(to, expired);
+            advances++;
+
+            // Due timers in expiry order, ties by id so that they compare in any order.
+            std::vector<std::pair<unsigned long long, unsigned int> > want;
+            for (std::map<unsigned int, unsigned long long>::const_iterator it = armed.begin(); it != armed.end(); ++it) {
+                if (it->second <= to) {
+                    want.push_back(std::make_pair(it->second, it->first));
+                }
+            }
+
+            std::sort(want.begin(), want.end());
+
+            std::vector<std::pair<unsigned long long, unsigned int> > got;
+            for (size_t i = 0; i < expired.size(); i++) {
+                std::map<unsigned int, unsigned long long>::const_iterator it = armed.find(expired[i]);
+                got.push_back(std::make_pair(it == armed.end() ? TIMER_WHEEL_NEVER : it->second, expired[i]));
+            }
+
+            for (size_t i = 1; i < got.size(); i++) {
+                if (got[i].first < got[i - 1].first) {
+                    fprintf(stderr, "Operation %llu: timer %u expired after timer %u, which is due later.\n", op, got[i].second, got[i - 1].second);
+                    return 1;
+                }
+            }
+
+            std::sort(got.begin(), got.end());
+
+            if (got != want) {
+                fprintf(stderr, "Operation %llu: advancing from %llu to %llu expired %zu timers, but should have expired %zu.\n", op, now, to, got.size(), want.size());
+                return 1;
+            }
+
+            for (size_t i = 0; i < want.size(); i++) {
+                armed.erase(want[i].second);
+            }
+
+            expiries += want.size();
+            now = to;
+        }
+
+        if (wheel.ArmedCount() != armed.size()) {
+            fprintf(stderr, "Operation %llu: %zu timers armed, but should be %zu.\n", op, wheel.ArmedCount(), armed.size());
+            return 1;
+        }
+
+        if (wheel.IsArmed(id) != (armed.find(id) != armed.end()) || (wheel.IsArmed(id) && wheel.ExpiryOf(id) != armed[id])) {
+            fprintf(stderr, "Operation %llu: timer %u is out of step.\n", op, id);
+            return 1;
+        }
+    }
+
+    printf("%llu operations, %llu advances, %llu expiries, no differences\n", operations, advances, expiries);
+    return 0;
+}